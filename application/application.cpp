@@ -44,6 +44,11 @@ bool Application::init_wsi(std::unique_ptr<WSIPlatform> new_platform)
 	if (!platform->has_external_swapchain() && !application_wsi.init(Global::thread_group()->get_num_threads() + 1))
 		return false;
 
+	// If GRANITE_TIMESTAMP_TRACE is active, let worker tasks record CPU zones
+	// into the same trace as the GPU timestamps.
+	Global::thread_group()->set_timeline_trace_file(
+			application_wsi.get_device().get_timeline_trace_file());
+
 	return true;
 }
 
@@ -89,10 +94,49 @@ bool Application::poll()
 	return true;
 }
 
+void Application::set_frame_pipelining(bool enable)
+{
+	if (enable && !Global::thread_group())
+	{
+		LOGE("No thread group, cannot pipeline frames.\n");
+		enable = false;
+	}
+
+	pipelining = enable;
+	if (!enable)
+		has_pipelined_state = false;
+}
+
 void Application::run_frame()
 {
 	application_wsi.begin_frame();
-	render_frame(application_wsi.get_smooth_frame_time(), application_wsi.get_smooth_elapsed_time());
+	double frame_time = application_wsi.get_smooth_frame_time();
+	double elapsed_time = application_wsi.get_smooth_elapsed_time();
+
+	if (pipelining)
+	{
+		// Simulate frame N on the workers while frame N - 1's state records
+		// and submits on this thread. The first pipelined frame has nothing
+		// to render yet, so it only runs its update.
+		auto update_task = Global::thread_group()->create_task([this, frame_time, elapsed_time]() {
+			update_frame(frame_time, elapsed_time);
+		});
+		update_task->flush();
+
+		if (has_pipelined_state)
+			render_frame(pipelined_frame_time, pipelined_elapsed_time);
+
+		update_task->wait();
+		has_pipelined_state = true;
+		pipelined_frame_time = frame_time;
+		pipelined_elapsed_time = elapsed_time;
+	}
+	else
+	{
+		update_frame(frame_time, elapsed_time);
+		render_frame(frame_time, elapsed_time);
+	}
+
 	application_wsi.end_frame();
 }
 }
@@ -34,6 +34,13 @@ public:
 	Application();
 	virtual ~Application() = default;
 	virtual void render_frame(double frame_time, double elapsed_time) = 0;
+
+	// Optional update phase for frame pipelining, see set_frame_pipelining().
+	// Applications which do not opt in keep all their work in render_frame().
+	virtual void update_frame(double, double)
+	{
+	}
+
 	bool init_wsi(std::unique_ptr<Vulkan::WSIPlatform> platform);
 
 	Vulkan::WSI &get_wsi()
@@ -69,6 +76,20 @@ public:
 	bool poll();
 	void run_frame();
 
+	// When enabled, run_frame() kicks update_frame() for frame N onto the
+	// thread group workers while render_frame() records frame N - 1 on the
+	// calling thread, overlapping simulation with command recording at the
+	// cost of one frame of latency. The application must split its work so
+	// update_frame() only writes state which render_frame() does not read,
+	// i.e. double-buffer anything shared between the two phases. Toggling
+	// is only safe between frames.
+	void set_frame_pipelining(bool enable);
+
+	bool get_frame_pipelining() const
+	{
+		return pipelining;
+	}
+
 protected:
 	void request_shutdown()
 	{
@@ -79,6 +100,10 @@ private:
 	std::unique_ptr<Vulkan::WSIPlatform> platform;
 	Vulkan::WSI application_wsi;
 	bool requested_shutdown = false;
+	bool pipelining = false;
+	bool has_pipelined_state = false;
+	double pipelined_frame_time = 0.0;
+	double pipelined_elapsed_time = 0.0;
 };
 
 int application_main(Application *(*create_application)(int, char **), int argc, char **argv);
@@ -76,11 +76,15 @@ void ApplicationCLIWrapper::render_frame(double, double elapsed_time)
 	}
 
 	auto *queue = Global::message_queue();
-	while (queue->available_read_messages())
+	Util::MessageQueuePayload payloads[64];
+	size_t count;
+	while ((count = queue->read_messages(payloads, 64)) != 0)
 	{
-		auto message = queue->read_message();
-		messages.emplace_back(static_cast<const char *>(message.get_payload_data()));
-		queue->recycle_payload(std::move(message));
+		for (size_t i = 0; i < count; i++)
+		{
+			messages.emplace_back(static_cast<const char *>(payloads[i].get_payload_data()));
+			queue->recycle_payload(std::move(payloads[i]));
+		}
 	}
 
 	auto cmd = device.request_command_buffer();
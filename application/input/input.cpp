@@ -23,6 +23,7 @@
 #include "input.hpp"
 #include "ui_manager.hpp"
 #include "event.hpp"
+#include "timer.hpp"
 #include <algorithm>
 #include <string.h>
 
@@ -378,8 +379,27 @@ void InputTracker::mouse_leave()
 	mouse_active = false;
 }
 
+void InputTracker::publish_snapshot()
+{
+	InputSnapshot snapshot;
+	snapshot.timestamp_nsecs = Util::get_current_time_nsecs();
+	snapshot.key_mask = key_state;
+	snapshot.button_mask = mouse_button_state;
+	snapshot.mouse_x = last_mouse_x;
+	snapshot.mouse_y = last_mouse_y;
+	snapshot.mouse_active = mouse_active;
+	snapshot.active_joypads = active_joypads;
+	for (unsigned i = 0; i < Joypads; i++)
+		snapshot.joypads[i] = joypads[i];
+	snapshots.publish(snapshot);
+}
+
 void InputTracker::dispatch_current_state(double delta_time)
 {
+	// Publish even when there is no event manager so snapshot samplers
+	// are decoupled from event dispatch entirely.
+	publish_snapshot();
+
 	auto *event_manager = Global::event_manager();
 	if (event_manager)
 	{
@@ -26,6 +26,7 @@
 #include "event.hpp"
 #include <stdint.h>
 #include "math.hpp"
+#include <atomic>
 #include <limits>
 
 namespace Granite
@@ -138,6 +139,71 @@ struct JoypadState
 };
 static_assert(Util::ecast(JoypadKey::Count) <= 32, "Cannot have more than 32 joypad buttons.");
 
+// Timestamped, self-contained copy of the tracker state.
+// Published with InputTracker::publish_snapshot() and sampled lock-free from
+// another thread, so simulation can run at its own cadence and the render
+// thread can late-latch pointer state just before view setup.
+struct InputSnapshot
+{
+	enum { Joypads = 8 };
+
+	bool is_key_pressed(Key key) const
+	{
+		return (key_mask & (1ull << Util::ecast(key))) != 0;
+	}
+
+	bool is_mouse_button_pressed(MouseButton button) const
+	{
+		return (button_mask & (1u << Util::ecast(button))) != 0;
+	}
+
+	int64_t timestamp_nsecs = 0;
+	uint64_t key_mask = 0;
+	double mouse_x = 0.0;
+	double mouse_y = 0.0;
+	JoypadState joypads[Joypads] = {};
+	uint8_t active_joypads = 0;
+	uint8_t button_mask = 0;
+	bool mouse_active = false;
+};
+
+// Single-writer, single-reader triple buffer. The writer always has a free
+// slot to fill and the reader always sees the most recently published
+// snapshot; neither side ever blocks the other.
+class InputSnapshotBuffer
+{
+public:
+	void publish(const InputSnapshot &snapshot)
+	{
+		slots[write_index] = snapshot;
+		unsigned previous = middle.exchange(write_index | FreshBit, std::memory_order_acq_rel);
+		write_index = previous & IndexMask;
+	}
+
+	// Latches the most recent snapshot into the argument.
+	// Returns true if the snapshot has not been seen by the reader before.
+	bool sample(InputSnapshot &snapshot)
+	{
+		bool fresh = (middle.load(std::memory_order_acquire) & FreshBit) != 0;
+		if (fresh)
+		{
+			// Only the reader clears the fresh bit, so if the writer races in
+			// another publish here we just pick up the even newer snapshot.
+			unsigned previous = middle.exchange(read_index, std::memory_order_acq_rel);
+			read_index = previous & IndexMask;
+		}
+		snapshot = slots[read_index];
+		return fresh;
+	}
+
+private:
+	enum : unsigned { IndexMask = 3, FreshBit = 4 };
+	InputSnapshot slots[3];
+	std::atomic<unsigned> middle { 1 };
+	unsigned write_index = 0;
+	unsigned read_index = 2;
+};
+
 class InputTracker;
 
 class JoypadRemapper
@@ -245,8 +311,20 @@ public:
 		return remappers[index];
 	}
 
+	// Publishes the current state to the snapshot buffer. Called from
+	// dispatch_current_state(), but platform backends pumping input at a
+	// higher rate than the frame loop may also call it directly after
+	// each poll so samplers see sub-frame updates.
+	void publish_snapshot();
+
+	// Lock-free sampling of the latest published state from one other thread.
+	InputSnapshotBuffer &get_snapshot_buffer()
+	{
+		return snapshots;
+	}
+
 	enum { TouchCount = 16 };
-	enum { Joypads = 8 };
+	enum { Joypads = InputSnapshot::Joypads };
 
 private:
 	uint64_t key_state = 0;
@@ -266,6 +344,7 @@ private:
 	JoypadState joypads[Joypads] = {};
 	JoypadRemapper remappers[Joypads];
 	TouchState touch;
+	InputSnapshotBuffer snapshots;
 
 	float axis_deadzone = 0.3f;
 };
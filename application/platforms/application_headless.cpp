@@ -33,6 +33,7 @@
 #include "rapidjson_wrapper.hpp"
 #include <limits.h>
 #include <cmath>
+#include <algorithm>
 #include "dynamic_library.hpp"
 #include "hw_counters/hw_counter_interface.h"
 #include "thread_group.hpp"
@@ -475,7 +476,7 @@ static void print_help()
 	LOGI("[--png-path <path>] [--stat <output.json>]\n"
 	     "[--audio-dump <sample rate> <data path (fp32 interleaved stereo raw)>]\n"
 	     "[--fs-assets <path>] [--fs-cache <path>] [--fs-builtin <path>]\n"
-	     "[--png-reference-path <path>] [--frames <frames>] [--width <width>] [--height <height>] [--time-step <step>] [--hw-counter-lib <lib>].\n");
+	     "[--png-reference-path <path>] [--frames <frames>] [--warmup-frames <frames>] [--width <width>] [--height <height>] [--time-step <step>] [--hw-counter-lib <lib>].\n");
 }
 
 namespace Granite
@@ -495,6 +496,7 @@ int application_main_headless(Application *(*create_application)(int, char **),
 		string builtin;
 		string hw_counter_lib;
 		unsigned max_frames = UINT_MAX;
+		unsigned warmup_frames = 1;
 		unsigned width = 1280;
 		unsigned height = 720;
 		double time_step = 0.01;
@@ -508,6 +510,7 @@ int application_main_headless(Application *(*create_application)(int, char **),
 
 	CLICallbacks cbs;
 	cbs.add("--frames", [&](CLIParser &parser) { args.max_frames = parser.next_uint(); });
+	cbs.add("--warmup-frames", [&](CLIParser &parser) { args.warmup_frames = parser.next_uint(); });
 	cbs.add("--width", [&](CLIParser &parser) { args.width = parser.next_uint(); });
 	cbs.add("--height", [&](CLIParser &parser) { args.height = parser.next_uint(); });
 	cbs.add("--time-step", [&](CLIParser &parser) { args.time_step = parser.next_double(); });
@@ -596,8 +599,9 @@ int application_main_headless(Application *(*create_application)(int, char **),
 		Global::start_audio_system();
 #endif
 
-		// Run warm-up frame.
-		if (app->poll())
+		// Run warm-up frames outside the timed region so pipeline compilation
+		// and allocator growth do not pollute the statistics.
+		for (unsigned i = 0; i < args.warmup_frames && app->poll(); i++)
 		{
 			p->begin_frame();
 			app->run_frame();
@@ -614,7 +618,12 @@ int application_main_headless(Application *(*create_application)(int, char **),
 		hw_counter start_counter, end_counter;
 		bool has_start_counters = p->get_counters(start_counter);
 
+		std::vector<double> frame_times_us;
+		if (args.max_frames != UINT_MAX)
+			frame_times_us.reserve(args.max_frames);
+
 		auto start_time = get_current_time_nsecs();
+		auto last_time = start_time;
 		unsigned rendered_frames = 0;
 		while (app->poll())
 		{
@@ -622,6 +631,10 @@ int application_main_headless(Application *(*create_application)(int, char **),
 			app->run_frame();
 			p->end_frame();
 			rendered_frames++;
+
+			auto current_time = get_current_time_nsecs();
+			frame_times_us.push_back(1e-3 * double(current_time - last_time));
+			last_time = current_time;
 #ifdef HAVE_GRANITE_AUDIO
 			if (audio_dumper)
 				audio_dumper->frame();
@@ -642,7 +655,22 @@ int application_main_headless(Application *(*create_application)(int, char **),
 		if (rendered_frames)
 		{
 			double usec = 1e-3 * double(end_time - start_time) / rendered_frames;
+
+			auto sorted_times = frame_times_us;
+			sort(sorted_times.begin(), sorted_times.end());
+			const auto percentile = [&](double p) -> double {
+				size_t index = std::min(size_t(p * double(sorted_times.size())), sorted_times.size() - 1);
+				return sorted_times[index];
+			};
+
+			double stddev = 0.0;
+			for (auto &t : frame_times_us)
+				stddev += (t - usec) * (t - usec);
+			stddev = std::sqrt(stddev / double(frame_times_us.size()));
+
 			LOGI("Average frame time: %.3f usec\n", usec);
+			LOGI("  stddev: %.3f usec, p50: %.3f usec, p95: %.3f usec, p99: %.3f usec\n",
+			     stddev, percentile(0.50), percentile(0.95), percentile(0.99));
 
 			if (!args.stat.empty())
 			{
@@ -651,9 +679,30 @@ int application_main_headless(Application *(*create_application)(int, char **),
 				auto &allocator = doc.GetAllocator();
 
 				doc.AddMember("averageFrameTimeUs", usec, allocator);
+				doc.AddMember("stddevFrameTimeUs", stddev, allocator);
+				doc.AddMember("p50FrameTimeUs", percentile(0.50), allocator);
+				doc.AddMember("p95FrameTimeUs", percentile(0.95), allocator);
+				doc.AddMember("p99FrameTimeUs", percentile(0.99), allocator);
 				doc.AddMember("gpu", StringRef(app->get_wsi().get_context().get_gpu_props().deviceName), allocator);
 				doc.AddMember("driverVersion", app->get_wsi().get_context().get_gpu_props().driverVersion, allocator);
 
+				// GPU timings only show up here if the application registered
+				// timestamp intervals, e.g. through RenderGraph::enable_timestamps().
+				Value timestamps(kArrayType);
+				app->get_wsi().get_device().get_timestamp_interval_manager().enumerate_intervals(
+						[&](const TimestampInterval &interval) {
+							if (!interval.get_total_frame_iterations())
+								return;
+							Value ts(kObjectType);
+							ts.AddMember("tag", Value(interval.get_tag().c_str(), allocator), allocator);
+							ts.AddMember("avgUs", 1e6 * interval.get_time_per_iteration(), allocator);
+							ts.AddMember("minUs", 1e6 * interval.get_min_time_per_iteration(), allocator);
+							ts.AddMember("maxUs", 1e6 * interval.get_max_time_per_iteration(), allocator);
+							timestamps.PushBack(ts, allocator);
+						});
+				if (!timestamps.Empty())
+					doc.AddMember("timestamps", timestamps, allocator);
+
 				if (has_start_counters && has_end_counters)
 				{
 					doc.AddMember("gpuCycles", (end_counter.gpu_cycles - start_counter.gpu_cycles) / rendered_frames,
@@ -158,6 +158,11 @@ void SceneViewerApplication::read_config(const std::string &path)
 	if (doc.HasMember("cameraIndex"))
 		config.camera_index = doc["cameraIndex"].GetInt();
 
+	if (doc.HasMember("cameraPlayback"))
+		config.camera_playback_path = doc["cameraPlayback"].GetString();
+	if (doc.HasMember("cameraPlaybackInterval"))
+		config.camera_playback_interval = doc["cameraPlaybackInterval"].GetFloat();
+
 	if (doc.HasMember("renderTargetFp16"))
 		config.rt_fp16 = doc["renderTargetFp16"].GetBool();
 
@@ -173,6 +178,9 @@ void SceneViewerApplication::read_config(const std::string &path)
 	if (doc.HasMember("directionalLightShadowsForceUpdate"))
 		config.force_shadow_map_update = doc["directionalLightShadowsForceUpdate"].GetBool();
 
+	if (doc.HasMember("shadowMapFarFollowRadius"))
+		config.shadow_map_far_follow_radius = doc["shadowMapFarFollowRadius"].GetFloat();
+
 	if (doc.HasMember("postAA"))
 	{
 		auto *aa = doc["postAA"].GetString();
@@ -251,6 +259,20 @@ SceneViewerApplication::SceneViewerApplication(const std::string &path, const st
 		}
 	}
 
+	// Camera-path playback overrides any scene camera. Benchmarks use this
+	// together with the exported cameras.json to get reproducible flythroughs.
+	if (!config.camera_playback_path.empty())
+	{
+		string json;
+		if (Global::filesystem()->read_file_to_string(config.camera_playback_path, json))
+			playback_cameras = import_cameras_from_json(json);
+
+		if (playback_cameras.empty())
+			LOGE("Failed to load camera playback file, using normal camera.\n");
+		else
+			selected_camera = &cam;
+	}
+
 	// Pick a directional light.
 	default_directional_light.color = vec3(6.0f, 5.5f, 4.5f);
 	default_directional_light.direction = light_direction();
@@ -1042,6 +1064,22 @@ void SceneViewerApplication::update_shadow_map()
 
 	// Project the scene AABB into the light and find our ortho ranges.
 	AABB ortho_range = shadow_scene_aabb.transform(view);
+
+	if (config.shadow_map_far_follow_radius > 0.0f && has_shadow_cell)
+	{
+		// Camera-following far field. Clamp the XY window to a radius around
+		// the snapped camera cell; the full depth range is kept so every
+		// static caster in the window can still occlude.
+		float radius = config.shadow_map_far_follow_radius;
+		vec3 lo = ortho_range.get_minimum();
+		vec3 hi = ortho_range.get_maximum();
+		lo.x = muglm::max(lo.x, last_shadow_cell.x - radius);
+		lo.y = muglm::max(lo.y, last_shadow_cell.y - radius);
+		hi.x = muglm::min(hi.x, last_shadow_cell.x + radius);
+		hi.y = muglm::min(hi.y, last_shadow_cell.y + radius);
+		ortho_range = AABB(lo, hi);
+	}
+
 	mat4 proj = ortho(ortho_range);
 
 	// Standard scale/bias.
@@ -1054,6 +1092,26 @@ void SceneViewerApplication::update_shadow_map()
 	depth_renderer.push_depth_renderables(depth_context, depth_visible);
 }
 
+void SceneViewerApplication::update_far_cascade_cell()
+{
+	if (config.shadow_map_far_follow_radius <= 0.0f || !selected_directional || !selected_camera)
+		return;
+
+	// Snap the camera's light-space position to a coarse grid so the cached
+	// far cascade is only invalidated on cell crossings, not every camera move.
+	mat4 view = mat4_cast(look_at(-selected_directional->direction, vec3(0.0f, 1.0f, 0.0f)));
+	float cell_size = 0.25f * config.shadow_map_far_follow_radius;
+	vec2 center = (view * vec4(selected_camera->get_position(), 1.0f)).xy();
+	vec2 snapped = round(center / cell_size) * cell_size;
+
+	if (!has_shadow_cell || any(notEqual(snapped, last_shadow_cell)))
+	{
+		last_shadow_cell = snapped;
+		has_shadow_cell = true;
+		need_shadow_map_update = true;
+	}
+}
+
 void SceneViewerApplication::render_shadow_map_far(CommandBuffer &cmd)
 {
 	update_shadow_map();
@@ -1092,11 +1150,37 @@ void SceneViewerApplication::render_shadow_map_near(CommandBuffer &cmd)
 	depth_renderer.flush(cmd, depth_context, Renderer::DEPTH_BIAS_BIT);
 }
 
+void SceneViewerApplication::apply_camera_playback(double elapsed_time)
+{
+	// Recorded cameras are treated as waypoints spaced evenly in time.
+	// Linear interpolation within each segment is enough for benchmark
+	// flythroughs and keeps the playback a pure function of elapsed time,
+	// so fixed time-step headless runs replay the exact same path.
+	size_t last = playback_cameras.size() - 1;
+	double t = elapsed_time / config.camera_playback_interval;
+	size_t index = std::min(size_t(std::max(t, 0.0)), last);
+	size_t next = std::min(index + 1, last);
+	float l = clamp(float(t - double(index)), 0.0f, 1.0f);
+
+	auto &a = playback_cameras[index];
+	auto &b = playback_cameras[next];
+
+	vec3 pos = mix(a.position, b.position, l);
+	vec3 dir = normalize(mix(a.direction, b.direction, l));
+	vec3 up = normalize(mix(a.up, b.up, l));
+	cam.look_at(pos, pos + dir, up);
+	cam.set_fovy(mix(a.fovy, b.fovy, l));
+	cam.set_depth_range(mix(a.znear, b.znear, l), mix(a.zfar, b.zfar, l));
+}
+
 void SceneViewerApplication::update_scene(double frame_time, double elapsed_time)
 {
 	last_frame_times[last_frame_index++ & FrameWindowSizeMask] = float(frame_time);
 	auto &scene = scene_loader.get_scene();
 
+	if (!playback_cameras.empty())
+		apply_camera_playback(elapsed_time);
+
 	animation_system->animate(frame_time, elapsed_time);
 	scene.update_cached_transforms();
 
@@ -1172,6 +1256,8 @@ void SceneViewerApplication::render_scene()
 	if (config.force_shadow_map_update)
 		need_shadow_map_update = true;
 
+	update_far_cascade_cell();
+
 	if (need_shadow_map_update)
 		update_shadow_scene_aabb();
 
@@ -88,6 +88,9 @@ protected:
 	std::string skydome_irradiance;
 	float skydome_intensity = 1.0f;
 	AABB shadow_scene_aabb;
+	vec2 last_shadow_cell = vec2(0.0f);
+	bool has_shadow_cell = false;
+	void update_far_cascade_cell();
 
 	std::unique_ptr<LightClusterer> cluster;
 	std::unique_ptr<VolumetricFog> volumetric_fog;
@@ -116,6 +119,8 @@ protected:
 	std::vector<RecordedCamera> recorded_cameras;
 
 private:
+	std::vector<RecordedCamera> playback_cameras;
+	void apply_camera_playback(double elapsed_time);
 	void read_config(const std::string &path);
 	void read_quirks(const std::string &path);
 	struct Config
@@ -126,7 +131,13 @@ private:
 		float shadow_map_resolution_near = 1024.0f;
 		unsigned clustered_lights_shadow_resolution = 512;
 		float cascade_cutoff_distance = 10.0f;
+		// When > 0, the far cascade follows the camera with this light-space
+		// radius instead of covering the whole scene, and only re-renders when
+		// the camera crosses a cell of the snapping grid.
+		float shadow_map_far_follow_radius = 0.0f;
 		int camera_index = -1;
+		std::string camera_playback_path;
+		float camera_playback_interval = 1.0f;
 
 		unsigned max_spot_lights = 32;
 		unsigned max_point_lights = 32;
@@ -27,6 +27,21 @@ layout(set = 2, binding = 4) uniform mediump sampler2DArray uBaseColor;
 layout(set = 2, binding = 5) uniform mediump sampler2D uSplatMap;
 layout(set = 2, binding = 6) uniform mediump sampler2D uDeepRoughNormals;
 
+#if defined(VARIANT_BIT_2) && VARIANT_BIT_2
+#define DETAIL_STREAM 1
+#else
+#define DETAIL_STREAM 0
+#endif
+
+#if DETAIL_STREAM
+// Streamed full-resolution terrain normal / splat tiles. They share the
+// heightmap tile residency: same layer map, same atlas layer per patch.
+layout(set = 2, binding = 3) uniform mediump sampler2D uLodMap;
+layout(set = 2, binding = 8) uniform usampler2D uTileLayerMap;
+layout(set = 2, binding = 9) uniform mediump sampler2DArray uNormalTiles;
+layout(set = 2, binding = 10) uniform mediump sampler2DArray uSplatTiles;
+#endif
+
 layout(std140, set = 3, binding = 1) uniform GroundData
 {
     vec2 uInvHeightmapSize;
@@ -34,6 +49,10 @@ layout(std140, set = 3, binding = 1) uniform GroundData
     vec2 uUVTilingScale;
     vec2 uTangentScale;
     vec4 uColorSize;
+    // (num patches x, num patches z, tile payload texels, 1 / padded tile size)
+    vec4 uTileInfo;
+    // Same layout for the streamed normal/splat detail tiles.
+    vec4 uDetailTileInfo;
 };
 
 mediump float horiz_max(mediump vec4 v)
@@ -42,11 +61,41 @@ mediump float horiz_max(mediump vec4 v)
     return max(x.x, x.y);
 }
 
+#if DETAIL_STREAM
+// Mirror of the vertex heightmap tile fade: full detail below LOD 0, back on
+// the fallback from LOD 1, so tile handoff and eviction never pop.
+// Returns 0 when no tile is resident for this patch.
+mediump float detail_fade(out highp vec3 tile_uv)
+{
+    tile_uv = vec3(0.0);
+    mediump float level = textureLod(uLodMap, vUV, 0.0).x;
+    if (level >= 1.0)
+        return 0.0;
+
+    highp vec2 patch_coord = vUV * uTileInfo.xy;
+    highp vec2 patch_base = floor(patch_coord);
+    uint layer = textureLod(uTileLayerMap, (patch_base + 0.5) / uTileInfo.xy, 0.0).x;
+    if (layer == 0xffffu)
+        return 0.0;
+
+    highp vec2 tile_texel = (patch_coord - patch_base) * uDetailTileInfo.z + 1.0;
+    tile_uv = vec3(tile_texel * uDetailTileInfo.w, float(layer));
+    return 1.0 - clamp(level, 0.0, 1.0);
+}
+#endif
+
 void main()
 {
     highp vec2 uv = vUV * uUVTilingScale;
 
-    mediump vec4 types = vec4(textureLod(uSplatMap, vUV, 0.0).rgb, 0.25);
+    mediump vec3 splat = textureLod(uSplatMap, vUV, 0.0).rgb;
+#if DETAIL_STREAM
+    highp vec3 detail_uv;
+    mediump float fade = detail_fade(detail_uv);
+    if (fade > 0.0)
+        splat = mix(splat, textureLod(uSplatTiles, detail_uv, 0.0).rgb, fade);
+#endif
+    mediump vec4 types = vec4(splat, 0.25);
     mediump float max_weight = horiz_max(types);
     types = types / max_weight;
     types = clamp(2.0 * (types - 0.5), vec4(0.0), vec4(1.0));
@@ -68,7 +117,12 @@ void main()
         types.w * texture(uBaseColor, vec3(uv, 3.0)).rgb;
 #endif
 
-    mediump vec3 terrain = two_component_normal(texture(uNormalsTerrain, vUV).xy * 2.0 - 1.0);
+    mediump vec2 terrain_xy = texture(uNormalsTerrain, vUV).xy;
+#if DETAIL_STREAM
+    if (fade > 0.0)
+        terrain_xy = mix(terrain_xy, textureLod(uNormalTiles, detail_uv, 0.0).xy, fade);
+#endif
+    mediump vec3 terrain = two_component_normal(terrain_xy * 2.0 - 1.0);
     terrain.xy += types.w * 0.5 * (texture(uDeepRoughNormals, uv).xy * 2.0 - 1.0);
     mediump vec3 normal = normalize(mat3(registers.Normal) * terrain.xzy); // Normal is +Y, Bitangent is +Z.
 
@@ -12,6 +12,21 @@ layout(location = 1) out highp vec2 vUV;
 layout(set = 2, binding = 0) uniform sampler2D uHeightmap;
 layout(set = 2, binding = 3) uniform sampler2D uLodMap;
 
+#if defined(VARIANT_BIT_1) && VARIANT_BIT_1
+#define HEIGHTMAP_STREAM 1
+#else
+#define HEIGHTMAP_STREAM 0
+#endif
+
+#if HEIGHTMAP_STREAM
+// Streamed full-resolution heightmap tiles, one layer per resident patch.
+// Each tile has a one texel apron shared with its neighbors so filtering
+// stays seamless across patch borders. uTileLayerMap holds the atlas layer
+// per patch, 0xffff when the tile is not resident.
+layout(set = 2, binding = 7) uniform sampler2DArray uHeightmapTiles;
+layout(set = 2, binding = 8) uniform usampler2D uTileLayerMap;
+#endif
+
 struct PatchData
 {
     vec2 Offsets;
@@ -31,6 +46,11 @@ layout(std140, set = 3, binding = 1) uniform GroundData
     vec2 uUVShift;
     vec2 uUVTilingScale;
     vec2 uTangentScale;
+    vec4 uColorSize;
+    // (num patches x, num patches z, tile payload texels, 1 / padded tile size)
+    vec4 uTileInfo;
+    // Same layout for the streamed normal/splat detail tiles.
+    vec4 uDetailTileInfo;
 };
 
 layout(push_constant, std430) uniform Constants
@@ -85,6 +105,27 @@ void main()
 #endif
     float height_displacement = sample_height_displacement(uv, off, lod);
 
+#if HEIGHTMAP_STREAM
+    // When the full-resolution tile for this patch is resident and the patch
+    // is close enough that LOD 0 detail matters, override the fallback
+    // heightmap. Fade back towards the fallback as the patch LODs out so the
+    // handoff (and later eviction) never pops.
+    if (lod.x < 1.0)
+    {
+        vec2 patch_coord = uv * uTileInfo.xy;
+        vec2 patch_base = floor(patch_coord);
+        uint layer = textureLod(uTileLayerMap, (patch_base + 0.5) / uTileInfo.xy, 0.0).x;
+        if (layer != 0xffffu)
+        {
+            vec2 tile_texel = (patch_coord - patch_base) * uTileInfo.z + 1.0;
+            float tile_height = clamp(
+                    textureLod(uHeightmapTiles, vec3(tile_texel * uTileInfo.w, float(layer)), 0.0).x,
+                    -1.0, 1.0);
+            height_displacement = mix(tile_height, height_displacement, clamp(lod.x, 0.0, 1.0));
+        }
+    }
+#endif
+
     vec4 world = registers.Model * vec4(pos.x, height_displacement, pos.y, 1.0);
 #ifndef RENDERER_DEPTH
     vPos = world.xyz;
@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) out mediump vec4 FragColor;
+layout(location = 0) in highp vec2 vUV;
+layout(set = 2, binding = 0) uniform mediump sampler2D uImpostor;
+
+void main()
+{
+    mediump vec4 color = texture(uImpostor, vUV);
+    if (color.a < 0.5)
+        discard;
+    FragColor = color;
+}
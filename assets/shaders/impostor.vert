@@ -0,0 +1,22 @@
+#version 450
+
+#include "inc/render_parameters.h"
+
+layout(location = 0) out highp vec2 vUV;
+
+layout(push_constant, std430) uniform Registers
+{
+    vec3 center;
+    float radius;
+    vec2 uv_offset;
+    vec2 uv_scale;
+} registers;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+    vec3 pos = registers.center +
+        (corner.x * global.camera_right + corner.y * global.camera_up) * registers.radius;
+    gl_Position = global.view_projection * vec4(pos, 1.0);
+    vUV = registers.uv_offset + (corner * vec2(0.5, -0.5) + 0.5) * registers.uv_scale;
+}
@@ -0,0 +1,30 @@
+#ifndef TELEMETRY_CHANNEL_H_
+#define TELEMETRY_CHANNEL_H_
+
+// Aggregate telemetry counter table, bound by
+// CommandBuffer::begin_aggregate_channel(). Slot layout is a contract
+// between the shader and the DebugChannelInterface consumer.
+layout(set = 7, binding = 14, std430) buffer TelemetryChannelSSBO
+{
+	uint counters[];
+} telemetry_channel;
+
+void telemetry_add(uint slot, uint v)
+{
+	if (slot < telemetry_channel.counters.length())
+		atomicAdd(telemetry_channel.counters[slot], v);
+}
+
+void telemetry_increment(uint slot)
+{
+	telemetry_add(slot, 1u);
+}
+
+// Histogram over count buckets starting at slot base, out-of-range values
+// land in the last bucket.
+void telemetry_histogram(uint base, uint count, uint bucket)
+{
+	telemetry_add(base + min(bucket, count - 1u), 1u);
+}
+
+#endif
@@ -24,9 +24,47 @@ layout(std430, set = 0, binding = 5) readonly buffer ClustererRanges
 	uvec2 cluster_range[];
 };
 
+#ifdef CLUSTERER_VOLUMES
+// Decals and reflection probes share the froxel grid with the lights.
+// Their masks live in a separate buffer, packed per cluster as
+// num_decals_32 decal words followed by num_probes_32 probe words.
+// Volumes are binned in XY only (no per-volume Z range), so the masks are
+// conservative along depth and shaders must still test the fetched volume
+// against the world position.
+layout(std430, set = 0, binding = 6) readonly buffer ClustererVolumeMasks
+{
+	uint cluster_volume_bitmask[];
+};
+
+layout(std430, set = 0, binding = 7) readonly buffer ClustererVolumeData
+{
+	ClustererBindlessVolumes cluster_volumes;
+};
+
+int compute_cluster_volume_base(vec2 inv_resolution)
+{
+	ivec2 cluster_coord = ivec2(gl_FragCoord.xy * inv_resolution * cluster.xy_scale);
+	cluster_coord = clamp(cluster_coord, ivec2(0), cluster.resolution_xy - 1);
+	int cluster_index = cluster_coord.y * cluster.resolution_xy.x + cluster_coord.x;
+	return cluster_index * (cluster.num_decals_32 + cluster.num_probes_32);
+}
+
+uint cluster_decal_mask(int volume_base, int chunk)
+{
+	return cluster_volume_bitmask[volume_base + chunk];
+}
+
+uint cluster_probe_mask(int volume_base, int chunk)
+{
+	return cluster_volume_bitmask[volume_base + cluster.num_decals_32 + chunk];
+}
+#endif
+
 #include "spot.h"
 #include "point.h"
-//#define CLUSTERING_DEBUG
+
+// Runtime debug visualization toggle, shares the module with normal shading.
+layout(constant_id = 3) const bool CLUSTERING_DEBUG = false;
 
 uint cluster_mask_range(uint mask, uvec2 range, uint start_index)
 {
@@ -86,17 +124,15 @@ mediump vec3 compute_cluster_light(
 			{
 				result += compute_point_light(index, material_base_color, material_normal,
 						material_metallic, material_roughness, world_pos, camera_pos);
-#ifdef CLUSTERING_DEBUG
-				result += vec3(0.1, 0.0, 0.0);
-#endif
+				if (CLUSTERING_DEBUG)
+					result += vec3(0.1, 0.0, 0.0);
 			}
 			else
 			{
 				result += compute_spot_light(index, material_base_color, material_normal,
 						material_metallic, material_roughness, world_pos, camera_pos);
-#ifdef CLUSTERING_DEBUG
-				result += vec3(0.0, 0.1, 0.0);
-#endif
+				if (CLUSTERING_DEBUG)
+					result += vec3(0.0, 0.1, 0.0);
 			}
 			mask &= ~uint(1 << bit_index);
 		}
@@ -160,4 +196,33 @@ mediump vec3 compute_cluster_scatter_light(vec3 world_pos, vec3 camera_pos)
 }
 #endif
 
+// Occupancy-only query used by the volumetric fog classifier.
+// Reports whether any positional light covers this position at all,
+// without evaluating the lights themselves.
+bool cluster_has_lights(vec3 world_pos)
+{
+	vec4 clip_coord = cluster.transform * vec4(world_pos, 1.0);
+	if (clip_coord.w <= 0.0)
+		return false;
+	ivec2 cluster_coord = ivec2((clip_coord.xy * cluster.xy_scale) / clip_coord.w);
+
+	cluster_coord = clamp(cluster_coord, ivec2(0), cluster.resolution_xy - 1);
+	int cluster_index = cluster_coord.y * cluster.resolution_xy.x + cluster_coord.x;
+	int cluster_base = cluster_index * cluster.num_lights_32;
+
+	float z = dot(world_pos - cluster.camera_base, cluster.camera_front);
+	int z_index = int(z * cluster.z_scale);
+	z_index = clamp(z_index, 0, cluster.z_max_index);
+	uvec2 z_range = cluster_range[z_index];
+
+	int z_start = int(z_range.x >> 5u);
+	int z_end = int(z_range.y >> 5u);
+
+	for (int i = z_start; i <= z_end; i++)
+		if (cluster_mask_range(cluster_bitmask[cluster_base + i], z_range, 32u * i) != 0u)
+			return true;
+
+	return false;
+}
+
 #endif
\ No newline at end of file
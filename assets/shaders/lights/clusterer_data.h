@@ -34,6 +34,11 @@ struct ClustererParametersBindless
 	int num_lights_32;
 	int z_max_index;
 	float z_scale;
+
+	int num_decals;
+	int num_decals_32;
+	int num_probes;
+	int num_probes_32;
 };
 
 struct ClustererBindlessTransforms
@@ -43,6 +48,28 @@ struct ClustererBindlessTransforms
 	mat4 model[CLUSTERER_MAX_LIGHTS];
 	uint type_mask[CLUSTERER_MAX_LIGHTS / 32];
 };
+
+#define CLUSTERER_MAX_DECALS 256
+#define CLUSTERER_MAX_PROBES 128
+
+struct ClusteredDecalInfo
+{
+	mat4 world_to_decal;
+	uvec4 payload;
+};
+
+struct ClusteredProbeInfo
+{
+	mat4 world_to_probe;
+	vec4 position_radius;
+	uvec4 payload;
+};
+
+struct ClustererBindlessVolumes
+{
+	ClusteredDecalInfo decals[CLUSTERER_MAX_DECALS];
+	ClusteredProbeInfo probes[CLUSTERER_MAX_PROBES];
+};
 #else
 struct PointShadowData
 {
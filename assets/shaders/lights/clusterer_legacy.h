@@ -22,7 +22,8 @@ layout(std430, set = 0, binding = 6) readonly buffer ClusterList
 } cluster_list;
 #endif
 
-//#define CLUSTERING_DEBUG
+// Runtime debug visualization toggle, shares the module with normal shading.
+layout(constant_id = 3) const bool CLUSTERING_DEBUG = false;
 
 const float NUM_CLUSTER_HIERARCHIES = 8.0;
 const float MAX_CLUSTER_HIERARCHY = NUM_CLUSTER_HIERARCHIES - 1.0;
@@ -71,11 +72,12 @@ mediump vec3 compute_cluster_scatter_light(vec3 world_pos, vec3 camera_pos)
 	uint point_start = elements.z;
 	uint point_count = elements.w;
 
-#ifdef CLUSTERING_DEBUG
-	result.x = 0.1 * float(spot_count);
-	result.y = 0.1 * float(point_count);
-	return result;
-#endif
+	if (CLUSTERING_DEBUG)
+	{
+		result.x = 0.1 * float(spot_count);
+		result.y = 0.1 * float(point_count);
+		return result;
+	}
 
 	for (uint i = 0u; i < spot_count; i++)
 		result += compute_spot_scatter_light(cluster_list.elements[spot_start + i], world_pos, camera_pos);
@@ -85,11 +87,12 @@ mediump vec3 compute_cluster_scatter_light(vec3 world_pos, vec3 camera_pos)
 
 	uvec2 bits = textureLod(uCluster, cluster_pos, 0.0).xy;
 
-#ifdef CLUSTERING_DEBUG
-	result.x = 0.1 * float(bitCount(bits.x));
-	result.y = 0.1 * float(bitCount(bits.y));
-	return result;
-#endif
+	if (CLUSTERING_DEBUG)
+	{
+		result.x = 0.1 * float(bitCount(bits.x));
+		result.y = 0.1 * float(bitCount(bits.y));
+		return result;
+	}
 
 #ifdef CLUSTERING_WAVE_UNIFORM
 	// Make cluster mask wave uniform for some load optimizations! :D
@@ -140,11 +143,12 @@ mediump vec3 compute_cluster_light(
 	uint point_start = elements.z;
 	uint point_count = elements.w;
 
-#ifdef CLUSTERING_DEBUG
-	result.x = 0.1 * float(spot_count);
-	result.y = 0.1 * float(point_count);
-	return result;
-#endif
+	if (CLUSTERING_DEBUG)
+	{
+		result.x = 0.1 * float(spot_count);
+		result.y = 0.1 * float(point_count);
+		return result;
+	}
 
 	for (uint i = 0u; i < spot_count; i++)
 	{
@@ -168,11 +172,12 @@ mediump vec3 compute_cluster_light(
 	uvec2 bits = textureLod(uCluster, cluster_pos, 0.0).xy;
 #endif
 
-#ifdef CLUSTERING_DEBUG
-	result.x = 0.1 * float(bitCount(bits.x));
-	result.y = 0.1 * float(bitCount(bits.y));
-	return result;
-#endif
+	if (CLUSTERING_DEBUG)
+	{
+		result.x = 0.1 * float(bitCount(bits.x));
+		result.y = 0.1 * float(bitCount(bits.y));
+		return result;
+	}
 
 #ifdef CLUSTERING_WAVE_UNIFORM
 	// Make cluster mask wave uniform for some UBO load optimizations! :D
@@ -208,4 +213,19 @@ mediump vec3 compute_cluster_light(
 }
 #endif
 
+// Occupancy-only query used by the volumetric fog classifier.
+// Reports whether any positional light covers this position at all,
+// without evaluating the lights themselves.
+bool cluster_has_lights(vec3 world_pos)
+{
+	vec3 cluster_pos = to_cluster_pos(world_pos);
+#ifdef CLUSTER_LIST
+	uvec4 elements = textureLod(uCluster, cluster_pos, 0.0);
+	return (elements.y | elements.w) != 0u;
+#else
+	uvec2 bits = textureLod(uCluster, cluster_pos, 0.0).xy;
+	return (bits.x | bits.y) != 0u;
+#endif
+}
+
 #endif
\ No newline at end of file
@@ -1,6 +1,10 @@
 #ifndef LIGHTING_H_
 #define LIGHTING_H_
 
+#if defined(MATERIAL_FAST_PATHS) && defined(SUBGROUP_VOTE)
+#extension GL_KHR_shader_subgroup_vote : require
+#endif
+
 #include "lighting_resources.h"
 
 mediump vec3 compute_lighting(
@@ -36,6 +40,43 @@ mediump vec3 compute_lighting(
 	mediump const float shadow_term = 1.0;
 #endif
 
+#if defined(MATERIAL_FAST_PATHS) && defined(SUBGROUP_VOTE)
+	// In-shader tile classification. Sky never reaches us (the resolve quad
+	// sits at the far plane with a GREATER depth test), and flat fully rough
+	// dielectrics only need diffuse: when the whole subgroup agrees, skip the
+	// GGX chain, the BRDF LUT fetch and the reflection probe sample. Voting
+	// keeps the branch subgroup-uniform, so the full path never pays for
+	// divergence and flat tiles retire early.
+	bool simple_material = material_metallic < 0.004 && material_roughness > 0.996;
+	if (subgroupAll(simple_material))
+	{
+		mediump float NoL_simple = clamp(dot(material_normal, light_direction), 0.001, 1.0);
+		// Dielectric F0 is 0.04; fold the lost specular into a constant
+		// diffuse scale rather than evaluating fresnel.
+		mediump vec3 diffuse = light_color * NoL_simple * shadow_term * (0.96 / PI);
+#ifdef ENVIRONMENT
+		mediump vec3 envdiff_simple = environment_intensity * textureLod(uIrradiance, material_normal, 0.0).rgb;
+		diffuse += envdiff_simple * material_ambient_factor * 0.96;
+#else
+		diffuse += 0.1 * material_ambient_factor;
+#endif
+		mediump vec3 simple_lighting = diffuse * material_base_color;
+#ifdef POSITIONAL_LIGHTS
+		simple_lighting += compute_cluster_light(
+			material_base_color,
+			material_normal,
+			material_metallic,
+			material_roughness,
+			light_world_pos, light_camera_pos
+#ifdef CLUSTERER_BINDLESS
+			, resolution.inv_resolution
+#endif
+			);
+#endif
+		return simple_lighting;
+	}
+#endif
+
 	mediump float roughness = material_roughness * 0.75 + 0.25;
 
 	// Compute directional light.
@@ -1,126 +1,49 @@
 #ifndef PCF_H_
 #define PCF_H_
 
-#ifndef SHADOW_MAP_PCF_KERNEL_WIDTH
-#define SHADOW_MAP_PCF_KERNEL_WIDTH 1
-#endif
+// The kernel width is a specialization constant rather than a define, so
+// all widths share one SPIR-V module and a width change only costs a
+// pipeline permutation instead of a full shader variant.
+layout(constant_id = 2) const int SHADOW_MAP_PCF_KERNEL_WIDTH = 1;
 
 #ifdef CLUSTERER_BINDLESS
 layout(set = 1, binding = 15) uniform sampler LinearShadowSampler;
 #endif
 
-#define SAMPLE_PCF_BINDLESS(tex, index, uv, x, y) \
-	textureLodOffset(sampler2DShadow(tex[nonuniformEXT(index)], LinearShadowSampler), uv, 0.0, ivec2(x, y))
-#define SAMPLE_PCF(tex, uv, x, y) \
-	textureLodOffset(tex, uv, 0.0, ivec2(x, y))
-
-#if SHADOW_MAP_PCF_KERNEL_WIDTH == 5
-#define SAMPLE_PCF_KERNEL_BINDLESS(var, tex, index, uv) \
-{ \
-	vec3 clip_uv = (uv).xyz / (uv).w; \
-	const mediump float weight = 0.1177491; \
-	const mediump float w00 = weight * 1.000000; \
-	const mediump float w01 = weight * 0.707106; \
-	const mediump float w02 = weight * 0.250000; \
-	const mediump float w11 = weight * 0.5; \
-	const mediump float w12 = weight * 0.176776; \
-	const mediump float w22 = weight * 0.0625; \
-	var = w22 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -2, -2); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, -2); \
-	var += w02 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, -2); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, -2); \
-	var += w22 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +2, -2); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -2, -1); \
-	var += w11 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, -1); \
-	var += w01 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, -1); \
-	var += w11 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, -1); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +2, -1); \
-	var += w02 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -2, +0); \
-	var += w01 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, +0); \
-	var += w00 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, +0); \
-	var += w01 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, +0); \
-	var += w02 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +2, +0); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -2, +1); \
-	var += w11 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, +1); \
-	var += w01 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, +1); \
-	var += w11 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, +1); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +2, +1); \
-	var += w22 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -2, +2); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, +2); \
-	var += w02 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, +2); \
-	var += w12 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, +2); \
-	var += w22 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +2, +2); \
+mediump float pcf_kernel_weight_1d(int x)
+{
+	if (SHADOW_MAP_PCF_KERNEL_WIDTH == 5)
+		return x == 0 ? 1.0 : (abs(x) == 1 ? 0.707106 : 0.25);
+	else
+		return x == 0 ? 0.5 : 0.25;
 }
 
-#define SAMPLE_PCF_KERNEL(var, tex, uv) \
-{ \
-	vec3 clip_uv = (uv).xyz / (uv).w; \
-	const mediump float weight = 0.1177491; \
-	const mediump float w00 = weight * 1.000000; \
-	const mediump float w01 = weight * 0.707106; \
-	const mediump float w02 = weight * 0.250000; \
-	const mediump float w11 = weight * 0.5; \
-	const mediump float w12 = weight * 0.176776; \
-	const mediump float w22 = weight * 0.0625; \
-	var = w22 * SAMPLE_PCF(tex, clip_uv, -2, -2); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, -1, -2); \
-	var += w02 * SAMPLE_PCF(tex, clip_uv, +0, -2); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, +1, -2); \
-	var += w22 * SAMPLE_PCF(tex, clip_uv, +2, -2); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, -2, -1); \
-	var += w11 * SAMPLE_PCF(tex, clip_uv, -1, -1); \
-	var += w01 * SAMPLE_PCF(tex, clip_uv, +0, -1); \
-	var += w11 * SAMPLE_PCF(tex, clip_uv, +1, -1); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, +2, -1); \
-	var += w02 * SAMPLE_PCF(tex, clip_uv, -2, +0); \
-	var += w01 * SAMPLE_PCF(tex, clip_uv, -1, +0); \
-	var += w00 * SAMPLE_PCF(tex, clip_uv, +0, +0); \
-	var += w01 * SAMPLE_PCF(tex, clip_uv, +1, +0); \
-	var += w02 * SAMPLE_PCF(tex, clip_uv, +2, +0); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, -2, +1); \
-	var += w11 * SAMPLE_PCF(tex, clip_uv, -1, +1); \
-	var += w01 * SAMPLE_PCF(tex, clip_uv, +0, +1); \
-	var += w11 * SAMPLE_PCF(tex, clip_uv, +1, +1); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, +2, +1); \
-	var += w22 * SAMPLE_PCF(tex, clip_uv, -2, +2); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, -1, +2); \
-	var += w02 * SAMPLE_PCF(tex, clip_uv, +0, +2); \
-	var += w12 * SAMPLE_PCF(tex, clip_uv, +1, +2); \
-	var += w22 * SAMPLE_PCF(tex, clip_uv, +2, +2); \
-}
-#elif SHADOW_MAP_PCF_KERNEL_WIDTH == 3
-#define SAMPLE_PCF_KERNEL_BINDLESS(var, tex, index, uv) \
+// Texel offsets to textureLodOffset must be literal constants, so the
+// variable width kernel offsets the UV manually instead.
+// The loop bounds are specialization constants, so drivers can fully
+// unroll and constant-fold the weights after specialization.
+#define SAMPLE_PCF_KERNEL_IMPL(var, combined, uv) \
 { \
 	vec3 clip_uv = (uv).xyz / (uv).w; \
-	var = 0.0625 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, -1); \
-	var += 0.1250 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, -1); \
-	var += 0.0625 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, -1); \
-	var += 0.1250 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, +0); \
-	var += 0.2500 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, +0); \
-	var += 0.1250 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, +0); \
-	var += 0.0625 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, -1, +1); \
-	var += 0.1250 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +0, +1); \
-	var += 0.0625 * SAMPLE_PCF_BINDLESS(tex, index, clip_uv, +1, +1); \
+	vec2 pcf_inv_size = 1.0 / vec2(textureSize(combined, 0)); \
+	int pcf_radius = SHADOW_MAP_PCF_KERNEL_WIDTH >> 1; \
+	mediump float pcf_total_weight = 0.0; \
+	var = 0.0; \
+	for (int pcf_y = -pcf_radius; pcf_y <= pcf_radius; pcf_y++) \
+	{ \
+		mediump float pcf_weight_y = pcf_kernel_weight_1d(pcf_y); \
+		for (int pcf_x = -pcf_radius; pcf_x <= pcf_radius; pcf_x++) \
+		{ \
+			mediump float pcf_weight = pcf_weight_y * pcf_kernel_weight_1d(pcf_x); \
+			pcf_total_weight += pcf_weight; \
+			var += pcf_weight * textureLod(combined, vec3(clip_uv.xy + vec2(pcf_x, pcf_y) * pcf_inv_size, clip_uv.z), 0.0); \
+		} \
+	} \
+	var /= pcf_total_weight; \
 }
 
-#define SAMPLE_PCF_KERNEL(var, tex, uv) \
-{ \
-	vec3 clip_uv = (uv).xyz / (uv).w; \
-	var = 0.0625 * SAMPLE_PCF(tex, clip_uv, -1, -1); \
-	var += 0.1250 * SAMPLE_PCF(tex, clip_uv, +0, -1); \
-	var += 0.0625 * SAMPLE_PCF(tex, clip_uv, +1, -1); \
-	var += 0.1250 * SAMPLE_PCF(tex, clip_uv, -1, +0); \
-	var += 0.2500 * SAMPLE_PCF(tex, clip_uv, +0, +0); \
-	var += 0.1250 * SAMPLE_PCF(tex, clip_uv, +1, +0); \
-	var += 0.0625 * SAMPLE_PCF(tex, clip_uv, -1, +1); \
-	var += 0.1250 * SAMPLE_PCF(tex, clip_uv, +0, +1); \
-	var += 0.0625 * SAMPLE_PCF(tex, clip_uv, +1, +1); \
-}
-#elif SHADOW_MAP_PCF_KERNEL_WIDTH == 1
-#define SAMPLE_PCF_KERNEL_BINDLESS(var, tex, index, uv) var = textureProjLod(sampler2DShadow(tex[nonuniformEXT(index)], LinearShadowSampler), uv, 0.0)
-#define SAMPLE_PCF_KERNEL(var, tex, uv) var = textureProjLod(tex, uv, 0.0)
-#else
-#error "Unsupported PCF kernel width."
-#endif
+#define SAMPLE_PCF_KERNEL(var, tex, uv) SAMPLE_PCF_KERNEL_IMPL(var, tex, uv)
+#define SAMPLE_PCF_KERNEL_BINDLESS(var, tex, index, uv) \
+	SAMPLE_PCF_KERNEL_IMPL(var, sampler2DShadow(tex[nonuniformEXT(index)], LinearShadowSampler), uv)
 
 #endif
@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) out mediump vec4 FragColor;
+layout(location = 0) in mediump vec4 vColor;
+layout(location = 1) in highp vec2 vLocal;
+
+void main()
+{
+    // Soft, round sprite.
+    mediump float falloff = clamp(1.0 - dot(vLocal, vLocal), 0.0, 1.0);
+    FragColor = vec4(vColor.rgb, vColor.a * falloff * falloff);
+}
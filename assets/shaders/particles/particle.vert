@@ -0,0 +1,44 @@
+#version 450
+
+#include "../inc/render_parameters.h"
+#include "particle.inc"
+
+layout(set = 2, binding = 0, std430) readonly buffer ParticleData
+{
+    Particle particles[];
+};
+
+layout(set = 2, binding = 1, std430) readonly buffer ParticleLists
+{
+    uint alive_count[2];
+    uint dead_count;
+    uint pad_;
+    uint list_data[];
+} lists;
+
+layout(push_constant, std430) uniform Registers
+{
+    uint write_list;
+} registers;
+
+layout(location = 0) out mediump vec4 vColor;
+layout(location = 1) out highp vec2 vLocal;
+
+void main()
+{
+    uint index = lists.list_data[PARTICLE_LIST_OFFSET(registers.write_list) + gl_InstanceIndex];
+    Particle p = particles[index];
+
+    const int corner_lut[6] = int[](0, 1, 2, 3, 2, 1);
+    int c = corner_lut[gl_VertexIndex];
+    vec2 corner = vec2(c & 1, c >> 1) * 2.0 - 1.0;
+
+    vec3 pos = p.position_life.xyz +
+        (corner.x * global.camera_right + corner.y * global.camera_up) * p.velocity_size.w;
+
+    gl_Position = global.view_projection * vec4(pos, 1.0);
+    vLocal = corner;
+    vColor = p.color;
+    // Fade out over the final part of the lifetime.
+    vColor.a *= clamp(p.position_life.w * 4.0, 0.0, 1.0);
+}
@@ -492,6 +492,14 @@
 #define SMAA_INCLUDE_PS 1
 #endif
 
+/**
+ * Compute shader ports cannot use discard; they override this to return a
+ * zero edge mask from the edge detection functions instead.
+ */
+#ifndef SMAA_EDGE_DISCARD
+#define SMAA_EDGE_DISCARD discard
+#endif
+
 //-----------------------------------------------------------------------------
 // Texture Access Defines
 
@@ -714,7 +722,7 @@ float2 SMAALumaEdgeDetectionPS(float2 texcoord,
 
     // Then discard if there is no edge:
     if (dot(edges, float2(1.0, 1.0)) == 0.0)
-        discard;
+        SMAA_EDGE_DISCARD;
 
     // Calculate right and bottom deltas:
     float Lright = dot(SMAASamplePoint(colorTex, offset[1].xy).rgb, weights);
@@ -776,7 +784,7 @@ float2 SMAAColorEdgeDetectionPS(float2 texcoord,
 
     // Then discard if there is no edge:
     if (dot(edges, float2(1.0, 1.0)) == 0.0)
-        discard;
+        SMAA_EDGE_DISCARD;
 
     // Calculate right and bottom deltas:
     float3 Cright = SMAASamplePoint(colorTex, offset[1].xy).rgb;
@@ -820,7 +828,7 @@ float2 SMAADepthEdgeDetectionPS(float2 texcoord,
     float2 edges = step(SMAA_DEPTH_THRESHOLD, delta);
 
     if (dot(edges, float2(1.0, 1.0)) == 0.0)
-        discard;
+        SMAA_EDGE_DISCARD;
 
     return edges;
 }
@@ -5,7 +5,9 @@ precision highp int;
 #define REPROJECTION_YCgCo 1
 #define REPROJECTION_HDR 0
 #define REPROJECTION_CLAMP_HISTORY 1
+#ifndef REPROJECTION_MOTION_VECTORS
 #define REPROJECTION_MOTION_VECTORS 0
+#endif
 
 layout(set = 0, binding = 0) uniform mediump sampler2D CurrentFrame;
 #if REPROJECTION_HISTORY
@@ -60,7 +60,9 @@ precision highp int;
 #error "Unknown TAA quality."
 #endif
 
+#ifndef REPROJECTION_MOTION_VECTORS
 #define REPROJECTION_MOTION_VECTORS 0
+#endif
 
 layout(set = 0, binding = 0) uniform mediump sampler2D CurrentFrame;
 #if REPROJECTION_HISTORY
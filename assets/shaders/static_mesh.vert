@@ -54,6 +54,9 @@ layout(std140, set = 3, binding = 1) uniform BonesWorld
 struct StaticMeshInfo
 {
     mat4 Model;
+    // Position dequantization as (scale, offset), applied before Model.
+    // Identity unless positions are unorm16 relative to the mesh AABB.
+    vec4 Dequant[2];
 };
 
 layout(set = 3, binding = 0, std140) uniform PerVertexData
@@ -91,16 +94,21 @@ void main()
         BoneWorldTransforms[BoneIndices.z][3].xyz * BoneWeights.z +
         BoneWorldTransforms[BoneIndices.w][3].xyz * BoneWeights.w;
 
+    // Skinned positions are never quantized.
+    vec3 MeshPos = Position;
 #else
     vec3 world_col0 = infos[gl_InstanceIndex].Model[0].xyz;
     vec3 world_col1 = infos[gl_InstanceIndex].Model[1].xyz;
     vec3 world_col2 = infos[gl_InstanceIndex].Model[2].xyz;
     vec3 world_col3 = infos[gl_InstanceIndex].Model[3].xyz;
+    vec3 MeshPos = Position *
+        infos[gl_InstanceIndex].Dequant[0].xyz +
+        infos[gl_InstanceIndex].Dequant[1].xyz;
 #endif
     vec3 World =
-        world_col0 * Position.x +
-        world_col1 * Position.y +
-        world_col2 * Position.z +
+        world_col0 * MeshPos.x +
+        world_col1 * MeshPos.y +
+        world_col2 * MeshPos.z +
         world_col3;
     gl_Position = global.view_projection * vec4(World, 1.0);
 
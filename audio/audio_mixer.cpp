@@ -25,6 +25,7 @@
 #include "audio_events.hpp"
 #include "timer.hpp"
 #include "logging.hpp"
+#include "bitops.hpp"
 #include <string.h>
 #include <cmath>
 
@@ -103,6 +104,8 @@ Mixer::Mixer()
 		gain = f32_to_u32(1.0f);
 	for (auto &active : active_channel_mask)
 		active = 0;
+	for (auto &gen : stream_generation)
+		gen = 0;
 	latency = 0;
 }
 
@@ -128,7 +131,7 @@ unsigned Mixer::get_stream_index(StreamID id)
 
 StreamID Mixer::generate_stream_id(unsigned index)
 {
-	uint64_t generation = ++stream_generation[index];
+	uint64_t generation = stream_generation[index].fetch_add(1, memory_order_relaxed) + 1;
 	return generation * MaxSources + index;
 }
 
@@ -144,7 +147,7 @@ bool Mixer::verify_stream_id(StreamID id)
 
 	unsigned index = get_stream_index(id);
 	uint64_t generation = get_stream_generation(id);
-	uint64_t actual_generation = stream_generation[index];
+	uint64_t actual_generation = stream_generation[index].load(memory_order_acquire);
 	return actual_generation == generation;
 }
 
@@ -162,17 +165,24 @@ void Mixer::kill_stream(StreamID id)
 
 double Mixer::get_play_cursor(StreamID id)
 {
-	NON_CRITICAL_THREAD_LOCK();
+	// Read-only queries are lock-free so they cannot stall behind
+	// add_mixer_stream, which holds the lock while setting up a stream.
+	// Re-verifying the generation after the snapshot catches the slot
+	// getting recycled mid-query.
 	if (!verify_stream_id(id))
 		return -1.0;
 
 	unsigned index = get_stream_index(id);
-	return stream_adjusted_play_cursors_usec[index].load(memory_order_acquire) * 1e-6;
+	double cursor = stream_adjusted_play_cursors_usec[index].load(memory_order_acquire) * 1e-6;
+
+	if (!verify_stream_id(id))
+		return -1.0;
+	return cursor;
 }
 
 Mixer::StreamState Mixer::get_stream_state(Granite::Audio::StreamID id)
 {
-	NON_CRITICAL_THREAD_LOCK();
+	// Lock-free, see get_play_cursor.
 	if (!verify_stream_id(id))
 		return StreamState::Dead;
 
@@ -180,7 +190,11 @@ Mixer::StreamState Mixer::get_stream_state(Granite::Audio::StreamID id)
 	if ((active_channel_mask[index / 32].load(memory_order_acquire) & (1u << (index & 31))) == 0)
 		return StreamState::Dead;
 
-	return stream_playing[index].load(memory_order_relaxed) ? StreamState::Playing : StreamState::Paused;
+	bool playing = stream_playing[index].load(memory_order_relaxed);
+
+	if (!verify_stream_id(id))
+		return StreamState::Dead;
+	return playing ? StreamState::Playing : StreamState::Paused;
 }
 
 void Mixer::update_stream_play_cursor(unsigned index, double new_latency) noexcept
@@ -281,6 +295,19 @@ StreamID Mixer::add_mixer_stream(MixerStream *stream, bool start_playing,
 		return StreamID(-1);
 	}
 
+	// Stream setup can be arbitrarily expensive (decode-ahead priming, filter
+	// tables), so run it before taking the lock; other threads keep querying
+	// and mutating streams meanwhile.
+	MixerStream *inner_stream = stream;
+	stream->setup(sample_rate, num_channels, max_num_samples);
+
+	if (stream->get_sample_rate() != sample_rate)
+	{
+		auto *resample_stream = new ResampledStream(stream);
+		stream = resample_stream;
+		stream->setup(sample_rate, num_channels, max_num_samples);
+	}
+
 	// add_mixer_stream is only called by non-critical threads,
 	// so it's fine to lock.
 	// It is unsafe for multiple threads to create a stream here, since they might allocate
@@ -301,16 +328,7 @@ StreamID Mixer::add_mixer_stream(MixerStream *stream, bool start_playing,
 
 		MixerStream *old_stream = mixer_streams[index];
 		StreamID id = generate_stream_id(index);
-		stream->install_message_queue(id, &message_queue);
-
-		stream->setup(sample_rate, num_channels, max_num_samples);
-
-		if (stream->get_sample_rate() != sample_rate)
-		{
-			auto *resample_stream = new ResampledStream(stream);
-			stream = resample_stream;
-			stream->setup(sample_rate, num_channels, max_num_samples);
-		}
+		inner_stream->install_message_queue(id, &message_queue);
 
 		// Can all be relaxed here.
 		// The mixer thread will be dependent on the active_channel_mask having been kicked.
@@ -345,7 +363,7 @@ void Mixer::dispose_dead_streams()
 			if (old_stream)
 				old_stream->dispose();
 			mixer_streams[bit + 32 * i] = nullptr;
-			stream_generation[bit + 32 * i] = 0;
+			stream_generation[bit + 32 * i].store(0, memory_order_relaxed);
 		});
 	}
 }
@@ -133,7 +133,7 @@ private:
 	uint64_t stream_raw_play_cursors[MaxSources];
 	std::atomic<uint64_t> stream_adjusted_play_cursors_usec[MaxSources];
 
-	uint64_t stream_generation[MaxSources] = {};
+	std::atomic<uint64_t> stream_generation[MaxSources];
 	std::mutex non_critical_lock;
 
 	size_t max_num_samples = 0;
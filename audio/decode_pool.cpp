@@ -0,0 +1,393 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "decode_pool.hpp"
+#include "dsp/dsp.hpp"
+#include "logging.hpp"
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace Granite
+{
+namespace Audio
+{
+struct PooledCompressedStream;
+
+// A fixed pool of decode workers shared by every pooled compressed stream.
+// Each worker repeatedly claims the registered stream whose ring is closest
+// to underrun (buffered seconds, i.e. the deadline by which the mixer runs
+// dry), tops that ring up to its high watermark and goes back for more.
+// The stream count no longer dictates the thread count, and the stream
+// about to glitch is always the one being serviced.
+struct DecodePool
+{
+	DecodePool();
+	~DecodePool();
+	static DecodePool &get();
+
+	void add_stream(PooledCompressedStream *stream);
+	void remove_stream(PooledCompressedStream *stream);
+
+	void worker_loop();
+	PooledCompressedStream *claim_stream();
+
+	vector<PooledCompressedStream *> streams;
+	vector<thread> workers;
+	mutex lock;
+	condition_variable cond;
+	bool teardown = false;
+};
+
+// Decoded PCM travels through a lock-free SPSC ring, so the mixer callback
+// only copies samples and never runs a codec; a cache-missy decode burst
+// can otherwise blow the callback deadline on low-end targets. The single
+// producer is whichever pool worker has the stream claimed; the pool lock
+// guarantees at most one claim at a time.
+struct PooledCompressedStream : MixerStream
+{
+	~PooledCompressedStream();
+
+	size_t accumulate_samples(float * const *channels, const float *gains, size_t num_frames) noexcept override;
+
+	float get_sample_rate() const override
+	{
+		return sample_rate;
+	}
+
+	unsigned get_num_channels() const override
+	{
+		return num_channels;
+	}
+
+	void setup(float, unsigned, size_t max_num_frames) override;
+	bool decode_block();
+	void refill();
+	double buffered_seconds() const;
+	bool wants_decode() const;
+
+	unique_ptr<CompressedDecoder> decoder;
+
+	float sample_rate = 0.0f;
+	unsigned num_channels = 0;
+	bool looping = false;
+
+	enum : size_t { BlockFrames = 256, MinRingFrames = 16 * 1024 };
+
+	// Planar PCM ring. Counters are monotonic frame counts,
+	// ring_frames is a power of two.
+	std::vector<float> ring[Backend::MaxAudioChannels];
+	size_t ring_frames = 0;
+	std::atomic<uint64_t> write_count{0};
+	std::atomic<uint64_t> read_count{0};
+	std::atomic<bool> decode_done{false};
+
+	// Owned by the pool lock.
+	bool in_flight = false;
+	bool registered = false;
+
+	// Guards against spinning forever on a looping stream with no audio.
+	bool rewound_without_data = false;
+
+	// Gains as applied at the end of the previous callback. Each callback
+	// ramps from these towards the mixer's current targets.
+	float prev_gains[Backend::MaxAudioChannels] = {};
+	bool has_prev_gains = false;
+};
+
+DecodePool::DecodePool()
+{
+	// A couple of workers keep dozens of streams fed; the rings hold
+	// hundreds of milliseconds so decode is nowhere near real time.
+	unsigned count = std::max(1u, std::min(4u, thread::hardware_concurrency() / 2u));
+	for (unsigned i = 0; i < count; i++)
+		workers.emplace_back(&DecodePool::worker_loop, this);
+}
+
+DecodePool::~DecodePool()
+{
+	{
+		lock_guard<mutex> holder{lock};
+		teardown = true;
+	}
+	cond.notify_all();
+	for (auto &worker : workers)
+		worker.join();
+}
+
+DecodePool &DecodePool::get()
+{
+	static DecodePool pool;
+	return pool;
+}
+
+void DecodePool::add_stream(PooledCompressedStream *stream)
+{
+	{
+		lock_guard<mutex> holder{lock};
+		streams.push_back(stream);
+		stream->registered = true;
+	}
+	cond.notify_one();
+}
+
+void DecodePool::remove_stream(PooledCompressedStream *stream)
+{
+	unique_lock<mutex> holder{lock};
+	auto itr = find(begin(streams), end(streams), stream);
+	if (itr != end(streams))
+		streams.erase(itr);
+	stream->registered = false;
+
+	// Workers touch the stream without the lock while decoding,
+	// so wait out any claim before the stream is torn down.
+	cond.wait(holder, [stream]() { return !stream->in_flight; });
+}
+
+PooledCompressedStream *DecodePool::claim_stream()
+{
+	// Earliest deadline first. The deadline is when the mixer drains the
+	// ring, so buffered seconds is the whole priority function.
+	PooledCompressedStream *best = nullptr;
+	double best_deadline = 0.0;
+	for (auto *stream : streams)
+	{
+		if (stream->in_flight || !stream->wants_decode())
+			continue;
+
+		double deadline = stream->buffered_seconds();
+		if (!best || deadline < best_deadline)
+		{
+			best = stream;
+			best_deadline = deadline;
+		}
+	}
+	return best;
+}
+
+void DecodePool::worker_loop()
+{
+	unique_lock<mutex> holder{lock};
+	for (;;)
+	{
+		if (teardown)
+			return;
+
+		auto *stream = claim_stream();
+		if (!stream)
+		{
+			// The mixer side cannot signal from the critical thread,
+			// so poll. The rings hold hundreds of milliseconds,
+			// short naps are fine.
+			cond.wait_for(holder, chrono::milliseconds(2));
+			continue;
+		}
+
+		stream->in_flight = true;
+		holder.unlock();
+		stream->refill();
+		holder.lock();
+		stream->in_flight = false;
+		// remove_stream() may be waiting out our claim.
+		cond.notify_all();
+	}
+}
+
+double PooledCompressedStream::buffered_seconds() const
+{
+	uint64_t read = read_count.load(memory_order_acquire);
+	uint64_t write = write_count.load(memory_order_relaxed);
+	return double(write - read) / double(sample_rate);
+}
+
+bool PooledCompressedStream::wants_decode() const
+{
+	if (decode_done.load(memory_order_relaxed))
+		return false;
+	uint64_t read = read_count.load(memory_order_acquire);
+	uint64_t write = write_count.load(memory_order_relaxed);
+	return size_t(write - read) < ring_frames / 2;
+}
+
+bool PooledCompressedStream::decode_block()
+{
+	float block[Backend::MaxAudioChannels][BlockFrames];
+	float *block_channels[Backend::MaxAudioChannels];
+	for (unsigned c = 0; c < num_channels; c++)
+		block_channels[c] = block[c];
+
+	int ret = decoder->decode(block_channels, BlockFrames);
+	if (ret <= 0)
+	{
+		if (looping && ret == 0 && !rewound_without_data)
+		{
+			rewound_without_data = true;
+			if (decoder->rewind())
+				return true;
+		}
+
+		decode_done.store(true, memory_order_release);
+		return false;
+	}
+	rewound_without_data = false;
+
+	uint64_t write = write_count.load(memory_order_relaxed);
+	size_t mask = ring_frames - 1;
+	size_t offset = 0;
+	while (offset < size_t(ret))
+	{
+		size_t pos = size_t(write + offset) & mask;
+		size_t run = min(size_t(ret) - offset, ring_frames - pos);
+		for (unsigned c = 0; c < num_channels; c++)
+			memcpy(ring[c].data() + pos, block[c] + offset, run * sizeof(float));
+		offset += run;
+	}
+	write_count.store(write + ret, memory_order_release);
+	return true;
+}
+
+void PooledCompressedStream::refill()
+{
+	// Top the ring up to its high watermark in one claim; re-taking the
+	// pool lock per 256 frame block would otherwise dominate.
+	while (wants_decode())
+	{
+		uint64_t read = read_count.load(memory_order_acquire);
+		uint64_t write = write_count.load(memory_order_relaxed);
+		if (ring_frames - size_t(write - read) < BlockFrames)
+			break;
+		if (!decode_block())
+			break;
+	}
+}
+
+void PooledCompressedStream::setup(float, unsigned, size_t max_num_frames)
+{
+	// When the mixer wraps the stream in a ResampledStream, setup runs a
+	// second time through the wrapper. Pull the stream from the pool and
+	// start over from the top of the file; nothing has been consumed yet.
+	if (registered)
+	{
+		DecodePool::get().remove_stream(this);
+		decoder->rewind();
+		write_count.store(0, memory_order_relaxed);
+		read_count.store(0, memory_order_relaxed);
+		decode_done.store(false, memory_order_relaxed);
+		rewound_without_data = false;
+	}
+
+	ring_frames = MinRingFrames;
+	while (ring_frames < 4 * max_num_frames)
+		ring_frames *= 2;
+	for (unsigned c = 0; c < num_channels; c++)
+		ring[c].resize(ring_frames);
+
+	// Prime the full decode-ahead margin up front so playback cannot
+	// underrun before a worker gets around to us.
+	while (!decode_done.load(memory_order_relaxed) &&
+	       ring_frames - size_t(write_count.load(memory_order_relaxed) - read_count.load(memory_order_relaxed)) >= BlockFrames)
+	{
+		if (!decode_block())
+			break;
+	}
+
+	DecodePool::get().add_stream(this);
+}
+
+size_t PooledCompressedStream::accumulate_samples(float * const *channels, const float *gains, size_t num_frames) noexcept
+{
+	// Order matters: observing decode_done before loading write_count
+	// guarantees write_count is final if done is seen.
+	bool done = decode_done.load(memory_order_acquire);
+	uint64_t read = read_count.load(memory_order_relaxed);
+	uint64_t write = write_count.load(memory_order_acquire);
+	size_t to_write = min(size_t(write - read), num_frames);
+
+	if (!has_prev_gains)
+	{
+		for (unsigned c = 0; c < num_channels; c++)
+			prev_gains[c] = gains[c];
+		has_prev_gains = true;
+	}
+
+	float gain_steps[Backend::MaxAudioChannels];
+	for (unsigned c = 0; c < num_channels; c++)
+		gain_steps[c] = num_frames ? (gains[c] - prev_gains[c]) / float(num_frames) : 0.0f;
+
+	size_t mask = ring_frames - 1;
+	size_t offset = 0;
+	while (offset < to_write)
+	{
+		size_t pos = size_t(read + offset) & mask;
+		size_t run = min(to_write - offset, ring_frames - pos);
+		for (unsigned c = 0; c < num_channels; c++)
+		{
+			if (gain_steps[c] != 0.0f)
+			{
+				DSP::accumulate_channel_ramp(channels[c] + offset, ring[c].data() + pos,
+				                             prev_gains[c] + float(offset) * gain_steps[c], gain_steps[c], run);
+			}
+			else
+				DSP::accumulate_channel(channels[c] + offset, ring[c].data() + pos, gains[c], run);
+		}
+		offset += run;
+	}
+
+	for (unsigned c = 0; c < num_channels; c++)
+		prev_gains[c] += gain_steps[c] * float(to_write);
+
+	read_count.store(read + to_write, memory_order_release);
+
+	// A transient underrun while the decoder is still running contributes
+	// silence instead of ending the stream.
+	if (to_write < num_frames && !done)
+		return num_frames;
+	return to_write;
+}
+
+PooledCompressedStream::~PooledCompressedStream()
+{
+	if (registered)
+		DecodePool::get().remove_stream(this);
+}
+
+MixerStream *create_pooled_compressed_stream(unique_ptr<CompressedDecoder> decoder, bool looping)
+{
+	if (!decoder)
+		return nullptr;
+
+	auto *stream = new PooledCompressedStream;
+	stream->decoder = move(decoder);
+	stream->sample_rate = stream->decoder->get_sample_rate();
+	stream->num_channels = stream->decoder->get_num_channels();
+	stream->looping = looping;
+	return stream;
+}
+}
+}
@@ -0,0 +1,60 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "audio_mixer.hpp"
+#include <memory>
+#include <stddef.h>
+
+namespace Granite
+{
+namespace Audio
+{
+// Codec-agnostic planar PCM decoder. Implementations only run on a shared
+// decode worker, never on the critical mixer thread, so they are free to
+// allocate, hit the filesystem cache or burn cycles in a codec.
+class CompressedDecoder
+{
+public:
+	virtual ~CompressedDecoder() = default;
+
+	virtual float get_sample_rate() const = 0;
+	virtual unsigned get_num_channels() const = 0;
+
+	// Decodes up to num_frames planar frames into channels.
+	// Returns the number of frames produced, 0 at end of stream,
+	// negative on a decode error.
+	virtual int decode(float *const *channels, size_t num_frames) = 0;
+
+	// Seeks back to the first audio frame; used by looping streams.
+	virtual bool rewind() = 0;
+};
+
+// Wraps a decoder in a MixerStream serviced by the shared decode pool.
+// Instead of spawning a thread per stream, a fixed set of workers tops up
+// the per-stream PCM rings, always picking the stream closest to underrun,
+// so 40+ simultaneous compressed streams do not oversubscribe the CPU.
+// The stream takes ownership of the decoder.
+MixerStream *create_pooled_compressed_stream(std::unique_ptr<CompressedDecoder> decoder, bool looping = false);
+}
+}
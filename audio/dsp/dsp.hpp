@@ -73,6 +73,72 @@ static inline void accumulate_channel(float * __restrict output, const float * _
 #endif
 }
 
+// Like accumulate_channel, but the gain moves by gain_step every sample.
+// Ramping towards a new gain over the course of a callback de-zippers
+// gain and panning changes instead of stepping them between callbacks.
+static inline void accumulate_channel_ramp(float * __restrict output, const float * __restrict input,
+                                           float gain, float gain_step, size_t count) noexcept
+{
+#ifdef __ARM_NEON
+	static const float lane_offsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	float32x4_t gain_lane = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(lane_offsets), gain_step);
+	float32x4_t step4 = vdupq_n_f32(gain_step * 4.0f);
+	float32x4_t step8 = vdupq_n_f32(gain_step * 8.0f);
+
+	size_t rounded_count = count & ~7;
+	for (size_t i = 0; i < rounded_count; i += 8)
+	{
+		float32x4_t acc0 = vld1q_f32(output);
+		float32x4_t acc1 = vld1q_f32(output + 4);
+		float32x4_t in0 = vld1q_f32(input);
+		float32x4_t in1 = vld1q_f32(input + 4);
+		acc0 = vmlaq_f32(acc0, in0, gain_lane);
+		acc1 = vmlaq_f32(acc1, in1, vaddq_f32(gain_lane, step4));
+		vst1q_f32(output, acc0);
+		vst1q_f32(output + 4, acc1);
+		gain_lane = vaddq_f32(gain_lane, step8);
+
+		output += 8;
+		input += 8;
+	}
+
+	gain += float(rounded_count) * gain_step;
+	size_t overflow_count = count & 7;
+	for (size_t i = 0; i < overflow_count; i++)
+		output[i] += input[i] * (gain + float(i) * gain_step);
+#elif defined(__SSE__)
+	__m128 gain_lane = _mm_add_ps(_mm_set1_ps(gain),
+	                              _mm_mul_ps(_mm_set1_ps(gain_step), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+	__m128 step4 = _mm_set1_ps(gain_step * 4.0f);
+	__m128 step8 = _mm_set1_ps(gain_step * 8.0f);
+
+	size_t rounded_count = count & ~7;
+	for (size_t i = 0; i < rounded_count; i += 8)
+	{
+		__m128 acc0 = _mm_loadu_ps(output);
+		__m128 acc1 = _mm_loadu_ps(output + 4);
+		__m128 in0 = _mm_loadu_ps(input);
+		__m128 in1 = _mm_loadu_ps(input + 4);
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(in0, gain_lane));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(in1, _mm_add_ps(gain_lane, step4)));
+		_mm_storeu_ps(output, acc0);
+		_mm_storeu_ps(output + 4, acc1);
+		gain_lane = _mm_add_ps(gain_lane, step8);
+
+		output += 8;
+		input += 8;
+	}
+
+	gain += float(rounded_count) * gain_step;
+	size_t overflow_count = count & 7;
+	for (size_t i = 0; i < overflow_count; i++)
+		output[i] += input[i] * (gain + float(i) * gain_step);
+#else
+	for (size_t i = 0; i < count; i++)
+		output[i] += input[i] * (gain + float(i) * gain_step);
+#endif
+}
+
 static inline void replace_channel(float * __restrict output, const float * __restrict input, float gain, size_t count) noexcept
 {
 #ifdef __ARM_NEON
@@ -239,6 +305,34 @@ static inline void interleave_stereo_f32_i16(int16_t * __restrict target,
 		target += 8;
 	}
 
+	for (size_t i = rounded_count; i < count; i++)
+	{
+		*target++ = f32_to_i16(*left++);
+		*target++ = f32_to_i16(*right++);
+	}
+#elif defined(__SSE2__)
+	size_t rounded_count = count & ~3;
+	__m128 scale = _mm_set1_ps(float(0x8000));
+	for (size_t i = 0; i < rounded_count; i += 4)
+	{
+		// Clamp the positive side before conversion. cvtps returns INT32_MIN
+		// for out-of-range inputs, which packs would saturate to the wrong sign.
+		// packs handles the negative side like the scalar path.
+		__m128 limit = _mm_set1_ps(float(0x7fff));
+		__m128 l = _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(left), scale), limit);
+		__m128 r = _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(right), scale), limit);
+
+		__m128i il = _mm_cvtps_epi32(l);
+		__m128i ir = _mm_cvtps_epi32(r);
+		__m128i lo = _mm_unpacklo_epi32(il, ir);
+		__m128i hi = _mm_unpackhi_epi32(il, ir);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(target), _mm_packs_epi32(lo, hi));
+
+		left += 4;
+		right += 4;
+		target += 8;
+	}
+
 	for (size_t i = rounded_count; i < count; i++)
 	{
 		*target++ = f32_to_i16(*left++);
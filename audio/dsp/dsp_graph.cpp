@@ -0,0 +1,279 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "dsp_graph.hpp"
+#include "dsp.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+using namespace std;
+
+namespace Granite
+{
+namespace Audio
+{
+namespace DSP
+{
+DSPGraph::~DSPGraph()
+{
+	for (auto &n : nodes)
+		if (n.source)
+			n.source->dispose();
+}
+
+DSPGraph::NodeID DSPGraph::add_node(unique_ptr<DSPNode> node)
+{
+	assert(node);
+	Node n;
+	n.node = move(node);
+	nodes.push_back(move(n));
+	return NodeID(nodes.size() - 1);
+}
+
+DSPGraph::NodeID DSPGraph::add_source(MixerStream *stream)
+{
+	assert(stream);
+	Node n;
+	n.source = stream;
+	nodes.push_back(move(n));
+	return NodeID(nodes.size() - 1);
+}
+
+void DSPGraph::add_dependency(NodeID to, NodeID from)
+{
+	assert(to < nodes.size() && from < nodes.size() && to != from);
+	assert(!nodes[to].source && "Source nodes cannot have inputs.");
+	nodes[to].inputs.push_back(from);
+	nodes[from].num_consumers++;
+}
+
+void DSPGraph::set_output(NodeID node)
+{
+	assert(node < nodes.size());
+	output_node = node;
+}
+
+bool DSPGraph::build_schedule()
+{
+	vector<vector<NodeID>> consumers(nodes.size());
+	vector<unsigned> remaining_inputs(nodes.size());
+	for (NodeID i = 0; i < NodeID(nodes.size()); i++)
+	{
+		remaining_inputs[i] = unsigned(nodes[i].inputs.size());
+		for (auto input : nodes[i].inputs)
+			consumers[input].push_back(i);
+	}
+
+	schedule.clear();
+	schedule.reserve(nodes.size());
+	for (NodeID i = 0; i < NodeID(nodes.size()); i++)
+		if (remaining_inputs[i] == 0)
+			schedule.push_back(i);
+
+	for (size_t head = 0; head < schedule.size(); head++)
+		for (auto consumer : consumers[schedule[head]])
+			if (--remaining_inputs[consumer] == 0)
+				schedule.push_back(consumer);
+
+	return schedule.size() == nodes.size();
+}
+
+void DSPGraph::assign_buffers()
+{
+	// The schedule is static, so buffer liveness is too; walk the schedule
+	// once and reuse pooled blocks as their last consumer retires.
+	vector<uint32_t> free_buffers;
+	vector<unsigned> pending(nodes.size());
+	uint32_t num_buffers = 0;
+
+	for (NodeID i = 0; i < NodeID(nodes.size()); i++)
+		pending[i] = nodes[i].num_consumers;
+	// The output buffer is read after the whole schedule has run.
+	pending[output_node]++;
+
+	for (auto id : schedule)
+	{
+		auto &n = nodes[id];
+		n.in_place = n.inputs.size() == 1 && nodes[n.inputs[0]].num_consumers == 1;
+
+		if (n.in_place)
+		{
+			// Single-consumer edge, filter directly in the producer's block.
+			n.buffer_index = nodes[n.inputs[0]].buffer_index;
+		}
+		else if (!free_buffers.empty())
+		{
+			n.buffer_index = free_buffers.back();
+			free_buffers.pop_back();
+		}
+		else
+			n.buffer_index = num_buffers++;
+
+		for (auto input : n.inputs)
+		{
+			// When aliased in place, the block lives on as our own output.
+			if (--pending[input] == 0 && !n.in_place)
+				free_buffers.push_back(nodes[input].buffer_index);
+		}
+	}
+
+	buffer_pool.resize(size_t(num_buffers) * num_channels * BlockFrames);
+}
+
+float *DSPGraph::get_block(uint32_t buffer_index, unsigned channel) noexcept
+{
+	return buffer_pool.data() + (size_t(buffer_index) * num_channels + channel) * BlockFrames;
+}
+
+bool DSPGraph::bake(float sample_rate_, unsigned num_channels_, size_t max_num_frames)
+{
+	if (nodes.empty() || output_node == NoNode)
+		return false;
+	if (!build_schedule())
+	{
+		LOGE("DSP graph has a cycle.\n");
+		return false;
+	}
+
+	sample_rate = sample_rate_;
+	num_channels = min(num_channels_, unsigned(Backend::MaxAudioChannels));
+	assign_buffers();
+
+	has_sources = false;
+	for (auto &n : nodes)
+		if (n.source)
+			has_sources = true;
+
+	size_t block_frames = min(max_num_frames, size_t(BlockFrames));
+	for (auto &n : nodes)
+	{
+		if (n.source)
+			n.source->setup(sample_rate, num_channels, block_frames);
+		else
+			n.node->setup(sample_rate, num_channels, block_frames);
+	}
+
+	return true;
+}
+
+size_t DSPGraph::render(float *const *channels, const float *gain, size_t num_frames) noexcept
+{
+	float *ptrs[Backend::MaxAudioChannels];
+	float unity_gain[Backend::MaxAudioChannels];
+	for (unsigned c = 0; c < num_channels; c++)
+		unity_gain[c] = 1.0f;
+
+	size_t done = 0;
+	size_t alive = 0;
+
+	while (done < num_frames)
+	{
+		size_t block = min(num_frames - done, size_t(BlockFrames));
+		// A pure generator graph never runs dry.
+		size_t block_alive = has_sources ? 0 : block;
+
+		for (auto id : schedule)
+		{
+			auto &n = nodes[id];
+			for (unsigned c = 0; c < num_channels; c++)
+				ptrs[c] = get_block(n.buffer_index, c);
+
+			if (n.source)
+			{
+				for (unsigned c = 0; c < num_channels; c++)
+					memset(ptrs[c], 0, block * sizeof(float));
+				size_t ret = n.source->accumulate_samples(ptrs, unity_gain, block);
+				if (ret > block_alive)
+					block_alive = ret;
+			}
+			else
+			{
+				if (!n.in_place)
+				{
+					for (unsigned c = 0; c < num_channels; c++)
+						memset(ptrs[c], 0, block * sizeof(float));
+					for (auto input : n.inputs)
+						for (unsigned c = 0; c < num_channels; c++)
+							accumulate_channel(ptrs[c], get_block(nodes[input].buffer_index, c), 1.0f, block);
+				}
+				n.node->process(ptrs, num_channels, block);
+			}
+		}
+
+		for (unsigned c = 0; c < num_channels; c++)
+			accumulate_channel(channels[c] + done, get_block(nodes[output_node].buffer_index, c), gain[c], block);
+
+		alive += block_alive;
+		done += block;
+		if (block_alive < block)
+			break;
+	}
+
+	return alive;
+}
+
+struct DSPGraphStream : MixerStream
+{
+	explicit DSPGraphStream(unique_ptr<DSPGraph> graph_)
+		: graph(move(graph_))
+	{
+	}
+
+	void setup(float mixer_output_rate, unsigned mixer_channels, size_t max_num_frames) override
+	{
+		baked = graph->bake(mixer_output_rate, mixer_channels, max_num_frames);
+		if (!baked)
+			LOGE("Failed to bake DSP graph, stream will die immediately.\n");
+	}
+
+	size_t accumulate_samples(float *const *channels, const float *gain, size_t num_frames) noexcept override
+	{
+		if (!baked)
+			return 0;
+		return graph->render(channels, gain, num_frames);
+	}
+
+	unsigned get_num_channels() const override
+	{
+		return graph->get_num_channels();
+	}
+
+	float get_sample_rate() const override
+	{
+		return graph->get_sample_rate();
+	}
+
+	unique_ptr<DSPGraph> graph;
+	bool baked = false;
+};
+
+MixerStream *create_dsp_graph_stream(unique_ptr<DSPGraph> graph)
+{
+	if (!graph)
+		return nullptr;
+	return new DSPGraphStream(move(graph));
+}
+}
+}
+}
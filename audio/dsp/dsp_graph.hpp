@@ -0,0 +1,141 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "audio_mixer.hpp"
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Granite
+{
+namespace Audio
+{
+namespace DSP
+{
+// A node in a DSPGraph. Effects process whole blocks in place over pooled
+// buffers instead of being called per sample, so the virtual dispatch cost
+// amortizes over the block and the inner loops can stay SIMD-friendly
+// (see accumulate_channel and friends in dsp.hpp).
+class DSPNode
+{
+public:
+	virtual ~DSPNode() = default;
+
+	// Called once from a non-critical thread before any processing.
+	// Allocate any state here, process() must not allocate.
+	virtual void setup(float sample_rate, unsigned num_channels, size_t block_frames)
+	{
+		(void)sample_rate;
+		(void)num_channels;
+		(void)block_frames;
+	}
+
+	// Runs on the critical mixer thread.
+	// channels hold the summed outputs of the input nodes; process in place.
+	// num_frames is DSPGraph::BlockFrames except for the tail block of a
+	// mixer callback, which may be shorter.
+	virtual void process(float *const *channels, unsigned num_channels, size_t num_frames) noexcept = 0;
+};
+
+// A graph of DSPNodes, topologically scheduled over a pool of block buffers.
+// Build the graph on a non-critical thread, then hand it to
+// create_dsp_graph_stream() which bakes it and lets the mixer pull the
+// output node. Nodes with multiple inputs see them summed; single-consumer
+// edges are processed in place without a copy.
+class DSPGraph
+{
+public:
+	enum : size_t { BlockFrames = 256 };
+	using NodeID = uint32_t;
+	enum : uint32_t { NoNode = ~0u };
+
+	NodeID add_node(std::unique_ptr<DSPNode> node);
+
+	// Adds a MixerStream as a source node.
+	// The graph takes ownership and dispose()s the stream.
+	NodeID add_source(MixerStream *stream);
+
+	// The output of "from" feeds into "to". Must be called before bake().
+	void add_dependency(NodeID to, NodeID from);
+
+	// The node whose output the mixer hears.
+	void set_output(NodeID node);
+
+	// Topologically schedules the graph, assigns pooled block buffers and
+	// calls setup() on every node. Returns false if the graph has a cycle
+	// or no output node was set. Called from MixerStream::setup().
+	bool bake(float sample_rate, unsigned num_channels, size_t max_num_frames);
+
+	// Renders the graph in BlockFrames chunks, accumulating the output node
+	// into channels with per-channel gain. Runs on the critical mixer
+	// thread, does not allocate. Returns the number of frames any source
+	// could still deliver, i.e. the MixerStream::accumulate_samples contract.
+	size_t render(float *const *channels, const float *gain, size_t num_frames) noexcept;
+
+	unsigned get_num_channels() const
+	{
+		return num_channels;
+	}
+
+	float get_sample_rate() const
+	{
+		return sample_rate;
+	}
+
+	~DSPGraph();
+
+private:
+	struct Node
+	{
+		std::unique_ptr<DSPNode> node;
+		MixerStream *source = nullptr;
+		std::vector<NodeID> inputs;
+		unsigned num_consumers = 0;
+		// Baked state.
+		uint32_t buffer_index = 0;
+		bool in_place = false;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<NodeID> schedule;
+	std::vector<float> buffer_pool;
+	NodeID output_node = NoNode;
+
+	unsigned num_channels = 0;
+	float sample_rate = 0.0f;
+	bool has_sources = false;
+
+	float *get_block(uint32_t buffer_index, unsigned channel) noexcept;
+	bool build_schedule();
+	void assign_buffers();
+};
+
+// Wraps a graph in a MixerStream which bakes it in setup() and pulls the
+// output node from the mixer callback. If baking fails (cycle, empty graph
+// or no output node) the stream delivers no samples and dies immediately.
+MixerStream *create_dsp_graph_stream(std::unique_ptr<DSPGraph> graph);
+}
+}
+}
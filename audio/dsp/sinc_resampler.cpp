@@ -198,8 +198,8 @@ SincResampler::SincResampler(float out_rate, float in_rate, Quality quality)
 		taps = unsigned(ceil(taps / bandwidth_mod));
 	}
 
-	/* Be SIMD-friendly. */
-	taps = (taps + 3) & ~3;
+	/* Be SIMD-friendly. The inner loops run two 4-wide accumulators. */
+	taps = (taps + 7) & ~7;
 
 	unsigned phase_elems = ((1u << phase_bits) * taps);
 	phase_elems = phase_elems * 2;
@@ -258,15 +258,21 @@ size_t SincResampler::process_and_accumulate(float *output, const float *input,
 			const float *delta_table = sample_phase_table + num_taps;
 
 #ifdef __SSE__
-			__m128 sum = _mm_setzero_ps();
+			__m128 sum0 = _mm_setzero_ps();
+			__m128 sum1 = _mm_setzero_ps();
 			__m128 delta = _mm_set1_ps(float(time & subphase_mask) * subphase_mod);
-			for (unsigned i = 0; i < num_taps; i += 4)
+			for (unsigned i = 0; i < num_taps; i += 8)
 			{
-				__m128 buf = _mm_loadu_ps(buffer + i);
-				__m128 deltas = _mm_load_ps(delta_table + i);
-				__m128 _sinc  = _mm_add_ps(_mm_load_ps(sample_phase_table + i), _mm_mul_ps(deltas, delta));
-				sum = _mm_add_ps(sum, _mm_mul_ps(buf, _sinc));
+				__m128 buf0 = _mm_loadu_ps(buffer + i);
+				__m128 buf1 = _mm_loadu_ps(buffer + i + 4);
+				__m128 sinc0 = _mm_add_ps(_mm_load_ps(sample_phase_table + i),
+				                          _mm_mul_ps(_mm_load_ps(delta_table + i), delta));
+				__m128 sinc1 = _mm_add_ps(_mm_load_ps(sample_phase_table + i + 4),
+				                          _mm_mul_ps(_mm_load_ps(delta_table + i + 4), delta));
+				sum0 = _mm_add_ps(sum0, _mm_mul_ps(buf0, sinc0));
+				sum1 = _mm_add_ps(sum1, _mm_mul_ps(buf1, sinc1));
 			}
+			__m128 sum = _mm_add_ps(sum0, sum1);
 
 			// Horizontal add.
 			sum = _mm_add_ps(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 2, 3)), sum);
@@ -274,15 +280,18 @@ size_t SincResampler::process_and_accumulate(float *output, const float *input,
 			_mm_store_ss(output, _mm_add_ss(_mm_load_ss(output), sum));
 #elif defined(__ARM_NEON)
 			float delta = float(time & subphase_mask) * subphase_mod;
-			float32x4_t sum = vdupq_n_f32(0.0f);
-			for (unsigned i = 0; i < taps; i += 4)
+			float32x4_t sum0 = vdupq_n_f32(0.0f);
+			float32x4_t sum1 = vdupq_n_f32(0.0f);
+			for (unsigned i = 0; i < num_taps; i += 8)
 			{
-				float32x4_t phases = vld1q_f32(phase_table + i);
-				float32x4_t deltas = vld1q_f32(delta_table + i);
-				float32x4_t buf = vld1q_f32(buffer + i);
-				float32x4_t _sinc = vmlaq_n_f32(phases, deltas, delta);
-				sum = vmlaq_f32(sum, buf, _sinc);
+				float32x4_t sinc0 = vmlaq_n_f32(vld1q_f32(sample_phase_table + i),
+				                                vld1q_f32(delta_table + i), delta);
+				float32x4_t sinc1 = vmlaq_n_f32(vld1q_f32(sample_phase_table + i + 4),
+				                                vld1q_f32(delta_table + i + 4), delta);
+				sum0 = vmlaq_f32(sum0, vld1q_f32(buffer + i), sinc0);
+				sum1 = vmlaq_f32(sum1, vld1q_f32(buffer + i + 4), sinc1);
 			}
+			float32x4_t sum = vaddq_f32(sum0, sum1);
 
 			float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
 			float32x2_t res = vpadd_f32(half, half);
@@ -292,9 +301,9 @@ size_t SincResampler::process_and_accumulate(float *output, const float *input,
 #else
 			float delta = float(time & subphase_mask) * subphase_mod;
 			float sum = 0.0f;
-			for (unsigned i = 0; i < taps; i++)
+			for (unsigned i = 0; i < num_taps; i++)
 			{
-				float sinc_val = phase_table[i] + delta_table[i] * delta;
+				float sinc_val = sample_phase_table[i] + delta_table[i] * delta;
 				sum += buffer[i] * sinc_val;
 			}
 			*output += sum;
@@ -21,6 +21,7 @@
  */
 
 #include "vorbis_stream.hpp"
+#include "decode_pool.hpp"
 #include "filesystem.hpp"
 #include "dsp/dsp.hpp"
 #include "stb_vorbis.h"
@@ -34,13 +35,15 @@ namespace Granite
 {
 namespace Audio
 {
-struct VorbisStream : MixerStream
+// Feeds the shared decode pool (see decode_pool.cpp); decoding runs on the
+// pool workers, never on the critical mixer thread. Looping also happens on
+// a worker. stb_vorbis in memory mode seeks straight back to the first
+// audio page, so a loop restart does not re-parse headers.
+struct VorbisDecoder : CompressedDecoder
 {
-	~VorbisStream();
+	~VorbisDecoder() override;
 	bool init(const string &path);
 
-	size_t accumulate_samples(float * const *channels, const float *gains, size_t num_frames) noexcept override;
-
 	float get_sample_rate() const override
 	{
 		return sample_rate;
@@ -51,16 +54,18 @@ struct VorbisStream : MixerStream
 		return num_channels;
 	}
 
-	void setup(float, unsigned, size_t num_frames) override
+	int decode(float *const *channels, size_t num_frames) override
 	{
-		for (auto &mix : mix_buffer)
-			mix.clear();
-
+		float *mutable_channels[Backend::MaxAudioChannels];
 		for (unsigned c = 0; c < num_channels; c++)
-		{
-			mix_buffer[c].resize(num_frames);
-			mix_channels[c] = mix_buffer[c].data();
-		}
+			mutable_channels[c] = channels[c];
+		return stb_vorbis_get_samples_float(file, int(num_channels), mutable_channels, int(num_frames));
+	}
+
+	bool rewind() override
+	{
+		stb_vorbis_seek_start(file);
+		return true;
 	}
 
 	stb_vorbis *file = nullptr;
@@ -68,10 +73,6 @@ struct VorbisStream : MixerStream
 
 	float sample_rate = 0.0f;
 	unsigned num_channels = 0;
-	bool looping = false;
-
-	std::vector<float> mix_buffer[Backend::MaxAudioChannels];
-	float *mix_channels[Backend::MaxAudioChannels] = {};
 };
 
 struct DecodedVorbisStream : MixerStream
@@ -95,9 +96,14 @@ struct DecodedVorbisStream : MixerStream
 	float sample_rate = 0.0f;
 	unsigned num_channels = 0;
 	bool looping = false;
+
+	// Gains as applied at the end of the previous callback. Each callback
+	// ramps from these towards the mixer's current targets.
+	float prev_gains[Backend::MaxAudioChannels] = {};
+	bool has_prev_gains = false;
 };
 
-bool VorbisStream::init(const string &path)
+bool VorbisDecoder::init(const string &path)
 {
 	filesystem_file = Global::filesystem()->open(path, FileMode::ReadOnly);
 	if (!filesystem_file)
@@ -174,10 +180,26 @@ error:
 
 size_t DecodedVorbisStream::accumulate_samples(float *const *channels, const float *gains, size_t num_frames) noexcept
 {
+	if (!has_prev_gains)
+	{
+		for (unsigned c = 0; c < num_channels; c++)
+			prev_gains[c] = gains[c];
+		has_prev_gains = true;
+	}
+
 	size_t to_write = std::min(decoded_audio[0].size() - offset, num_frames);
 
 	for (unsigned c = 0; c < num_channels; c++)
-		DSP::accumulate_channel(channels[c], decoded_audio[c].data() + offset, gains[c], to_write);
+	{
+		float step = num_frames ? (gains[c] - prev_gains[c]) / float(num_frames) : 0.0f;
+		if (step != 0.0f)
+		{
+			DSP::accumulate_channel_ramp(channels[c], decoded_audio[c].data() + offset, prev_gains[c], step, to_write);
+			prev_gains[c] += step * float(to_write);
+		}
+		else
+			DSP::accumulate_channel(channels[c], decoded_audio[c].data() + offset, gains[c], to_write);
+	}
 
 	offset += to_write;
 
@@ -202,28 +224,7 @@ size_t DecodedVorbisStream::accumulate_samples(float *const *channels, const flo
 		return to_write;
 }
 
-size_t VorbisStream::accumulate_samples(float * const *channels, const float *gains, size_t num_frames) noexcept
-{
-	auto actual_frames = stb_vorbis_get_samples_float(file, num_channels, mix_channels, int(num_frames));
-	if (actual_frames < 0)
-		return 0;
-
-	for (unsigned c = 0; c < num_channels; c++)
-		DSP::accumulate_channel(channels[c], mix_channels[c], gains[c], size_t(actual_frames));
-
-	if (looping && size_t(actual_frames) < num_frames)
-	{
-		stb_vorbis_seek_start(file);
-		float *moved_channels[Backend::MaxAudioChannels];
-		for (unsigned c = 0; c < num_channels; c++)
-			moved_channels[c] = channels[c] + actual_frames;
-
-		actual_frames += accumulate_samples(moved_channels, gains, num_frames - actual_frames);
-	}
-	return size_t(actual_frames);
-}
-
-VorbisStream::~VorbisStream()
+VorbisDecoder::~VorbisDecoder()
 {
 	if (file)
 		stb_vorbis_close(file);
@@ -231,15 +232,11 @@ VorbisStream::~VorbisStream()
 
 MixerStream *create_vorbis_stream(const string &path, bool looping)
 {
-	auto vorbis = new VorbisStream;
-	if (!vorbis->init(path))
-	{
-		vorbis->dispose();
+	auto decoder = make_unique<VorbisDecoder>();
+	if (!decoder->init(path))
 		return nullptr;
-	}
 
-	vorbis->looping = looping;
-	return vorbis;
+	return create_pooled_compressed_stream(move(decoder), looping);
 }
 
 MixerStream *create_decoded_vorbis_stream(const string &path, bool looping)
@@ -255,4 +252,4 @@ MixerStream *create_decoded_vorbis_stream(const string &path, bool looping)
 	return vorbis;
 }
 }
-}
\ No newline at end of file
+}
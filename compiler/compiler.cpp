@@ -26,6 +26,7 @@
 #include "logging.hpp"
 #include "filesystem.hpp"
 #include "string_helpers.hpp"
+#include "hash.hpp"
 
 #include "spirv-tools/libspirv.hpp"
 
@@ -34,6 +35,33 @@ using namespace std;
 namespace Granite
 {
 
+bool IncludeCache::read_file(const std::string &path, std::string &output)
+{
+	FileStat s;
+	if (!Global::filesystem()->stat(path, s))
+	{
+		// Cannot validate, so don't cache.
+		return Global::filesystem()->read_file_to_string(path, output);
+	}
+
+	{
+		lock_guard<mutex> holder{lock};
+		auto itr = entries.find(path);
+		if (itr != end(entries) && itr->second.last_modified == s.last_modified)
+		{
+			output = itr->second.source;
+			return true;
+		}
+	}
+
+	if (!Global::filesystem()->read_file_to_string(path, output))
+		return false;
+
+	lock_guard<mutex> holder{lock};
+	entries[path] = { output, s.last_modified };
+	return true;
+}
+
 Stage GLSLCompiler::stage_from_path(const std::string &path)
 {
 	auto ext = Path::ext(path);
@@ -71,11 +99,18 @@ void GLSLCompiler::set_include_directories(const std::vector<std::string> *inclu
 	include_directories = include_directories_;
 }
 
+bool GLSLCompiler::read_include(const string &path, string &output) const
+{
+	if (include_cache)
+		return include_cache->read_file(path, output);
+	return Global::filesystem()->read_file_to_string(path, output);
+}
+
 bool GLSLCompiler::find_include_path(const string &source_path_, const string &include_path,
                                      string &included_path, string &included_source)
 {
 	auto relpath = Path::relpath(source_path_, include_path);
-	if (Global::filesystem()->read_file_to_string(relpath, included_source))
+	if (read_include(relpath, included_source))
 	{
 		included_path = relpath;
 		return true;
@@ -86,7 +121,7 @@ bool GLSLCompiler::find_include_path(const string &source_path_, const string &i
 		for (auto &include_dir : *include_directories)
 		{
 			auto path = Path::join(include_dir, include_path);
-			if (Global::filesystem()->read_file_to_string(path, included_source))
+			if (read_include(path, included_source))
 			{
 				included_path = path;
 				return true;
@@ -162,10 +197,21 @@ bool GLSLCompiler::parse_variants(const string &source_, const string &path)
 bool GLSLCompiler::preprocess()
 {
 	preprocessed_source.clear();
-	return parse_variants(source, source_path);
+	if (!parse_variants(source, source_path))
+		return false;
+
+	Util::Hasher h;
+	h.string(preprocessed_source);
+	source_hash = h.get();
+	return true;
 }
 
 vector<uint32_t> GLSLCompiler::compile(const vector<pair<string, int>> *defines)
+{
+	return compile(error_message, defines);
+}
+
+vector<uint32_t> GLSLCompiler::compile(string &error, const vector<pair<string, int>> *defines) const
 {
 	shaderc::Compiler compiler;
 	shaderc::CompileOptions options;
@@ -233,10 +279,10 @@ vector<uint32_t> GLSLCompiler::compile(const vector<pair<string, int>> *defines)
 	}
 	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(preprocessed_source, kind, source_path.c_str(), options);
 
-	error_message.clear();
+	error.clear();
 	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
 	{
-		error_message = result.GetErrorMessage();
+		error = result.GetErrorMessage();
 		return {};
 	}
 
@@ -244,8 +290,8 @@ vector<uint32_t> GLSLCompiler::compile(const vector<pair<string, int>> *defines)
 
 	spvtools::SpirvTools core(target == Target::Vulkan11 ? SPV_ENV_VULKAN_1_1 : SPV_ENV_VULKAN_1_0);
 
-	core.SetMessageConsumer([this](spv_message_level_t, const char *, const spv_position_t&, const char *message) {
-		error_message = message;
+	core.SetMessageConsumer([&error](spv_message_level_t, const char *, const spv_position_t&, const char *message) {
+		error = message;
 	});
 
 	spvtools::ValidatorOptions opts;
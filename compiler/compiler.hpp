@@ -26,6 +26,7 @@
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
+#include <mutex>
 #include <stdint.h>
 
 namespace Granite
@@ -47,6 +48,25 @@ enum class Target
 	Vulkan11
 };
 
+// Shares include file contents across compiles. Entries are validated against
+// file modification times, so hot-reloads pick up edited includes while
+// unchanged include graphs skip the Filesystem entirely. Thread-safe, intended
+// to be shared by all shader templates in a manager.
+class IncludeCache
+{
+public:
+	bool read_file(const std::string &path, std::string &output);
+
+private:
+	struct Entry
+	{
+		std::string source;
+		uint64_t last_modified = 0;
+	};
+	std::unordered_map<std::string, Entry> entries;
+	std::mutex lock;
+};
+
 class GLSLCompiler
 {
 public:
@@ -68,11 +88,27 @@ public:
 
 	void set_include_directories(const std::vector<std::string> *include_directories);
 
+	void set_include_cache(IncludeCache *cache)
+	{
+		include_cache = cache;
+	}
+
 	bool set_source_from_file(const std::string &path);
 	bool preprocess();
 
+	// Hash of the fully preprocessed source. Equal hashes mean the include
+	// graph resolved to identical contents, so existing variants are still valid.
+	uint64_t get_source_hash() const
+	{
+		return source_hash;
+	}
+
 	std::vector<uint32_t> compile(const std::vector<std::pair<std::string, int>> *defines = nullptr);
 
+	// Writes diagnostics to error instead of the shared error message, so
+	// batches of variants can compile in parallel on one compiler instance.
+	std::vector<uint32_t> compile(std::string &error, const std::vector<std::pair<std::string, int>> *defines) const;
+
 	const std::unordered_set<std::string> &get_dependencies() const
 	{
 		return dependencies;
@@ -104,7 +140,9 @@ private:
 	std::string source;
 	std::string source_path;
 	const std::vector<std::string> *include_directories = nullptr;
+	IncludeCache *include_cache = nullptr;
 	Stage stage = Stage::Unknown;
+	uint64_t source_hash = 0;
 
 	std::unordered_set<std::string> dependencies;
 	std::string preprocessed_source;
@@ -120,5 +158,6 @@ private:
 
 	bool find_include_path(const std::string &source_path, const std::string &include_path,
 	                       std::string &included_path, std::string &included_source);
+	bool read_include(const std::string &path, std::string &output) const;
 };
 }
@@ -34,6 +34,20 @@ Entity *EntityPool::create_entity()
 	return entity;
 }
 
+void EntityPool::create_entities_inner(unsigned count, Entity **out_entities)
+{
+	entities.reserve(entities.size() + count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		Util::Hasher hasher;
+		hasher.u64(++cookie);
+		auto *entity = entity_pool.allocate(this, hasher.get());
+		entity->pool_offset = entities.size();
+		entities.push_back(entity);
+		out_entities[i] = entity;
+	}
+}
+
 void EntityPool::free_component(Entity &entity, ComponentType id, ComponentNode *component)
 {
 	auto *c = component_types.find(id);
@@ -41,6 +55,12 @@ void EntityPool::free_component(Entity &entity, ComponentType id, ComponentNode
 	c->free_component(component->get());
 	component_nodes.free(component);
 
+	if (batched_group_updates)
+	{
+		pending_group_ops.push_back({ nullptr, entity.get_hash(), id, false });
+		return;
+	}
+
 	auto *component_groups = component_to_groups.find(id);
 	if (component_groups)
 	{
@@ -48,12 +68,43 @@ void EntityPool::free_component(Entity &entity, ComponentType id, ComponentNode
 		{
 			auto *g = groups.find(group.get_hash());
 			if (g)
-				g->remove_entity(entity);
+				g->remove_entity(entity.get_hash());
 		}
 	}
 }
 
 void EntityPool::delete_entity(Entity *entity)
+{
+	if (parallel_iteration_depth.load(std::memory_order_acquire) != 0)
+	{
+		// A worker dropped the last reference during parallel group iteration.
+		// The group vectors are being walked, so queue the removal.
+		std::lock_guard<std::mutex> holder{deferred_op_lock};
+		deferred_deletions.push_back(entity);
+		return;
+	}
+
+	delete_entity_inner(entity);
+}
+
+void EntityPool::delete_entity_inner(Entity *entity)
+{
+	if (batched_group_updates)
+	{
+		// The entity memory is recycled below, so any queued adds which still
+		// reference it must be dropped. The queued removals go by hash and
+		// remain valid.
+		auto hash = entity->get_hash();
+		auto itr = std::remove_if(pending_group_ops.begin(), pending_group_ops.end(), [hash](const PendingGroupOp &op) {
+			return op.add && op.hash == hash;
+		});
+		pending_group_ops.erase(itr, pending_group_ops.end());
+	}
+
+	release_entity(entity);
+}
+
+void EntityPool::release_entity(Entity *entity)
 {
 	{
 		auto &components = entity->get_components();
@@ -76,6 +127,132 @@ void EntityPool::delete_entity(Entity *entity)
 	entity_pool.free(entity);
 }
 
+void EntityPool::delete_entities(Entity *const *to_delete, unsigned count)
+{
+	if (parallel_iteration_depth.load(std::memory_order_acquire) != 0)
+	{
+		std::lock_guard<std::mutex> holder{deferred_op_lock};
+		deferred_deletions.insert(deferred_deletions.end(), to_delete, to_delete + count);
+		return;
+	}
+
+	// Queued adds which reference the dying entities must be dropped before
+	// the memory is recycled. One pass over the queue with a sorted hash set
+	// replaces the per-entity scan delete_entity_inner() would do.
+	if (!pending_group_ops.empty())
+	{
+		std::vector<Util::Hash> dying;
+		dying.reserve(count);
+		for (unsigned i = 0; i < count; i++)
+			dying.push_back(to_delete[i]->get_hash());
+		std::sort(dying.begin(), dying.end());
+
+		auto itr = std::remove_if(pending_group_ops.begin(), pending_group_ops.end(), [&](const PendingGroupOp &op) {
+			return op.add && std::binary_search(dying.begin(), dying.end(), op.hash);
+		});
+		pending_group_ops.erase(itr, pending_group_ops.end());
+	}
+
+	// Queue the removals so every group is maintained in one pass at the end
+	// instead of once per freed component.
+	bool was_batched = batched_group_updates;
+	batched_group_updates = true;
+	for (unsigned i = 0; i < count; i++)
+		release_entity(to_delete[i]);
+	batched_group_updates = was_batched;
+
+	if (!was_batched)
+		flush_group_updates();
+}
+
+void EntityPool::set_batched_group_updates(bool enable)
+{
+	if (batched_group_updates && !enable)
+		flush_group_updates();
+	batched_group_updates = enable;
+}
+
+void EntityPool::flush_group_updates()
+{
+	if (pending_group_ops.empty())
+		return;
+
+	// Process the queue in runs of the same component type so one
+	// component_to_groups lookup covers the whole run and each group's
+	// structures are touched back to back. The sort must be stable:
+	// membership correctness relies on add/remove order per type.
+	std::stable_sort(pending_group_ops.begin(), pending_group_ops.end(),
+	                 [](const PendingGroupOp &a, const PendingGroupOp &b) {
+		                 return a.id < b.id;
+	                 });
+
+	size_t count = pending_group_ops.size();
+	size_t i = 0;
+	while (i < count)
+	{
+		ComponentType id = pending_group_ops[i].id;
+		size_t run_end = i + 1;
+		while (run_end < count && pending_group_ops[run_end].id == id)
+			run_end++;
+
+		auto *component_groups = component_to_groups.find(id);
+		if (component_groups)
+		{
+			for (auto &group : *component_groups)
+			{
+				auto *g = groups.find(group.get_hash());
+				if (!g)
+					continue;
+
+				for (size_t j = i; j < run_end; j++)
+				{
+					auto &op = pending_group_ops[j];
+					if (op.add)
+						g->add_entity(*op.entity);
+					else
+						g->remove_entity(op.hash);
+				}
+			}
+		}
+
+		i = run_end;
+	}
+
+	pending_group_ops.clear();
+}
+
+void EntityPool::defer(std::function<void ()> op)
+{
+	if (parallel_iteration_depth.load(std::memory_order_acquire) != 0)
+	{
+		std::lock_guard<std::mutex> holder{deferred_op_lock};
+		deferred_ops.push_back(std::move(op));
+	}
+	else
+		op();
+}
+
+void EntityPool::begin_parallel_iteration()
+{
+	parallel_iteration_depth.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void EntityPool::end_parallel_iteration()
+{
+	if (parallel_iteration_depth.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	// The workers are done by the time the outermost iteration ends,
+	// so the queues can be drained without holding the lock.
+	for (auto *entity : deferred_deletions)
+		delete_entity_inner(entity);
+	deferred_deletions.clear();
+
+	for (auto &op : deferred_ops)
+		op();
+	deferred_ops.clear();
+}
+
 EntityPool::~EntityPool()
 {
 	{
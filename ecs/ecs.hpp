@@ -26,6 +26,11 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include "thread_group.hpp"
 #include "object_pool.hpp"
 #include "intrusive.hpp"
 #include "intrusive_hash_map.hpp"
@@ -116,7 +121,9 @@ class EntityGroupBase : public Util::IntrusiveHashMapEnabled<EntityGroupBase>
 public:
 	virtual ~EntityGroupBase() = default;
 	virtual void add_entity(Entity &entity) = 0;
-	virtual void remove_entity(const Entity &entity) = 0;
+	// Removal goes by hash since with batched group updates the entity may
+	// already have been freed by the time the queue is flushed.
+	virtual void remove_entity(Util::Hash hash) = 0;
 	virtual void reset() = 0;
 };
 
@@ -211,6 +218,12 @@ class EntityGroup : public EntityGroupBase
 public:
 	void add_entity(Entity &entity) override final
 	{
+		// With batched group updates an add may race against the lazy
+		// backfill in get_component_group_holder(), so adding twice
+		// must be a no-op.
+		if (entity_to_index.find(entity.get_hash()))
+			return;
+
 		if (has_all_components<Ts...>(entity))
 		{
 			entity_to_index[entity.get_hash()].get() = entities.size();
@@ -219,16 +232,16 @@ public:
 		}
 	}
 
-	void remove_entity(const Entity &entity) override final
+	void remove_entity(Util::Hash hash) override final
 	{
 		size_t offset;
-		if (entity_to_index.find_and_consume_pod(entity.get_hash(), offset))
+		if (entity_to_index.find_and_consume_pod(hash, offset))
 		{
 			entities[offset] = entities.back();
 			groups[offset] = groups.back();
 			entity_to_index[entities[offset]->get_hash()].get() = offset;
 
-			entity_to_index.erase(entity.get_hash());
+			entity_to_index.erase(hash);
 			entities.pop_back();
 			groups.pop_back();
 		}
@@ -251,6 +264,53 @@ public:
 		entity_to_index.clear();
 	}
 
+	// Components of one type live in contiguous ObjectPool blocks, but after
+	// enough entity churn the group iterates them in scrambled order.
+	// Sorting the group on the first component's address makes hot loops walk
+	// the pools linearly again. The group is maintained with swap-and-pop, so
+	// the order only degrades as entities are added or removed afterwards.
+	void optimize_order()
+	{
+		size_t count = entities.size();
+		std::vector<size_t> order(count);
+		for (size_t i = 0; i < count; i++)
+			order[i] = i;
+
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return std::get<0>(groups[a]) < std::get<0>(groups[b]);
+		});
+
+		ComponentGroupVector<Ts...> sorted_groups;
+		std::vector<Entity *> sorted_entities;
+		sorted_groups.reserve(count);
+		sorted_entities.reserve(count);
+		for (auto index : order)
+		{
+			sorted_groups.push_back(groups[index]);
+			sorted_entities.push_back(entities[index]);
+		}
+		groups = std::move(sorted_groups);
+		entities = std::move(sorted_entities);
+
+		for (size_t i = 0; i < count; i++)
+			entity_to_index[entities[i]->get_hash()].get() = i;
+	}
+
+	// Partitions the group across the worker threads and blocks until every
+	// entity has been visited. func is called as func(Entity *, Ts *...).
+	// While the loop runs, structural changes to the pool are deferred:
+	// dropping an EntityHandle queues the deletion instead of modifying the
+	// group mid-iteration, and other modifications can be queued explicitly
+	// with EntityPool::defer(). The queue runs once iteration completes.
+	template <typename Func>
+	void for_each_parallel(ThreadGroup &workers, size_t grain, const Func &func);
+
+	// Deferred variant which returns an unflushed TaskGroup so the loop can
+	// be chained with add_dependency() like any other task. Deferred
+	// structural changes run on a worker once the loop completes.
+	template <typename Func>
+	TaskGroup create_for_each_task(ThreadGroup &workers, size_t grain, Func func);
+
 private:
 	ComponentGroupVector<Ts...> groups;
 	std::vector<Entity *> entities;
@@ -283,6 +343,12 @@ private:
 	{
 		return HasAllComponents<Us...>::has_component(entity);
 	}
+
+	template <typename Func, size_t... Indices>
+	void call_with_components(const Func &func, size_t index, std::index_sequence<Indices...>)
+	{
+		func(entities[index], std::get<Indices>(groups[index])...);
+	}
 };
 
 class ComponentAllocatorBase : public Util::IntrusiveHashMapEnabled<ComponentAllocatorBase>
@@ -315,6 +381,29 @@ public:
 	Entity *create_entity();
 	void delete_entity(Entity *entity);
 
+	// Bulk spawn path for streaming. Creates count entities in one pass with a
+	// default-constructed component of each type in the pack. The bookkeeping
+	// is reserved up front and each type's components are allocated back to
+	// back from their pool, so the new components land contiguously in memory
+	// and hot loops over them iterate linearly without a later
+	// optimize_component_group() pass. Group registration happens once at the
+	// end, ordered by component type, instead of walking the registered groups
+	// per allocation. out_entities receives the entities in creation order.
+	template <typename U, typename... Us>
+	void create_entities(unsigned count, Entity **out_entities)
+	{
+		create_entities_inner(count, out_entities);
+		ComponentBulkAllocators<U, Us...>::allocate(*this, out_entities, count);
+		if (!batched_group_updates)
+			flush_group_updates();
+	}
+
+	// Symmetric bulk teardown for sector unload. Frees the entities'
+	// components and applies all group removals once at the end, ordered by
+	// component type. During parallel group iteration the whole batch is
+	// queued like delete_entity() would queue a single entity.
+	void delete_entities(Entity *const *to_delete, unsigned count);
+
 	template <typename... Ts>
 	EntityGroup<Ts...> *get_component_group_holder()
 	{
@@ -350,6 +439,15 @@ public:
 		return group->get_entities();
 	}
 
+	// Repacks a component group so iteration touches component memory in
+	// linear order. Intended to be called once after bulk entity creation,
+	// e.g. after a scene has finished loading. O(n log n) in group size.
+	template <typename... Ts>
+	void optimize_component_group()
+	{
+		get_component_group_holder<Ts...>()->optimize_order();
+	}
+
 	template <typename T, typename... Ts>
 	T *allocate_component(Entity &entity, Ts&&... ts)
 	{
@@ -380,10 +478,15 @@ public:
 			node->set_hash(id);
 			entity.components.insert_replace(node);
 
-			auto *component_groups = component_to_groups.find(id);
-			if (component_groups)
-				for (auto &group : *component_groups)
-					groups.find(group.get_hash())->add_entity(entity);
+			if (batched_group_updates)
+				pending_group_ops.push_back({ &entity, entity.get_hash(), id, true });
+			else
+			{
+				auto *component_groups = component_to_groups.find(id);
+				if (component_groups)
+					for (auto &group : *component_groups)
+						groups.find(group.get_hash())->add_entity(entity);
+			}
 
 			return comp;
 		}
@@ -393,6 +496,26 @@ public:
 	void reset_groups();
 	void reset_groups_for_component_type(ComponentType id);
 
+	// While a parallel group iteration runs, structural changes to the pool
+	// cannot happen concurrently. delete_entity() detects this case itself and
+	// queues the deletion; other modifications (entity creation, component
+	// allocation) must be queued here by the worker. The queue runs in
+	// submission order once the outermost iteration completes. Outside
+	// iteration the op runs immediately.
+	void defer(std::function<void ()> op);
+
+	void begin_parallel_iteration();
+	void end_parallel_iteration();
+
+	// Batches group membership maintenance. While enabled, allocating or
+	// freeing components queues the group updates instead of walking every
+	// registered group per call, and flush_group_updates() applies the queue
+	// in one pass ordered by component type, so each run of updates hits the
+	// same group lookup structures back to back. Call flush once per frame
+	// before the groups are iterated. Disabling flushes any pending updates.
+	void set_batched_group_updates(bool enable);
+	void flush_group_updates();
+
 private:
 	Util::ObjectPool<Entity> entity_pool;
 	Util::IntrusiveHashMapHolder<EntityGroupBase> groups;
@@ -402,6 +525,75 @@ private:
 	std::vector<Entity *> entities;
 	uint64_t cookie = 0;
 
+	void create_entities_inner(unsigned count, Entity **out_entities);
+	void delete_entity_inner(Entity *entity);
+	void release_entity(Entity *entity);
+
+	// Queues the group registrations unconditionally; the bulk paths flush
+	// once at the end when batching is not otherwise enabled.
+	template <typename T>
+	void allocate_components_bulk(Entity *const *ents, unsigned count)
+	{
+		ComponentType id = ComponentIDMapping::get_id<T>();
+		auto *t = component_types.find(id);
+		if (!t)
+		{
+			t = new ComponentAllocator<T>();
+			t->set_hash(id);
+			component_types.insert_yield(t);
+		}
+
+		auto *allocator = static_cast<ComponentAllocator<T> *>(t);
+		pending_group_ops.reserve(pending_group_ops.size() + count);
+		for (unsigned i = 0; i < count; i++)
+		{
+			auto *comp = allocator->pool.allocate();
+			auto *node = component_nodes.allocate(comp);
+			node->set_hash(id);
+			ents[i]->components.insert_replace(node);
+			pending_group_ops.push_back({ ents[i], ents[i]->get_hash(), id, true });
+		}
+	}
+
+	template <typename... Us>
+	struct ComponentBulkAllocators;
+
+	template <typename U, typename... Us>
+	struct ComponentBulkAllocators<U, Us...>
+	{
+		static void allocate(EntityPool &pool, Entity *const *ents, unsigned count)
+		{
+			pool.allocate_components_bulk<U>(ents, count);
+			ComponentBulkAllocators<Us...>::allocate(pool, ents, count);
+		}
+	};
+
+	template <typename U>
+	struct ComponentBulkAllocators<U>
+	{
+		static void allocate(EntityPool &pool, Entity *const *ents, unsigned count)
+		{
+			pool.allocate_components_bulk<U>(ents, count);
+		}
+	};
+
+	struct PendingGroupOp
+	{
+		// Only valid for adds. Removals go by hash since the entity may be
+		// freed before the flush.
+		Entity *entity;
+		Util::Hash hash;
+		ComponentType id;
+		bool add;
+	};
+	bool batched_group_updates = false;
+	std::vector<PendingGroupOp> pending_group_ops;
+
+	std::atomic_uint parallel_iteration_depth{0};
+	std::mutex deferred_op_lock;
+	std::vector<Entity *> deferred_deletions;
+	std::vector<std::function<void ()>> deferred_ops;
+
 	template <typename... Us>
 	struct GroupRegisters;
 
@@ -453,4 +645,42 @@ void Entity::free_component()
 	}
 }
 
+template <typename... Ts>
+template <typename Func>
+void EntityGroup<Ts...>::for_each_parallel(ThreadGroup &workers, size_t grain, const Func &func)
+{
+	if (entities.empty())
+		return;
+
+	auto *pool = entities.front()->get_pool();
+	pool->begin_parallel_iteration();
+	workers.parallel_for(entities.size(), grain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			call_with_components(func, i, std::index_sequence_for<Ts...>());
+	});
+	pool->end_parallel_iteration();
+}
+
+template <typename... Ts>
+template <typename Func>
+TaskGroup EntityGroup<Ts...>::create_for_each_task(ThreadGroup &workers, size_t grain, Func func)
+{
+	EntityPool *pool = entities.empty() ? nullptr : entities.front()->get_pool();
+	if (pool)
+		pool->begin_parallel_iteration();
+
+	auto loop = workers.create_parallel_for_task(entities.size(), grain, [this, func](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			call_with_components(func, i, std::index_sequence_for<Ts...>());
+	});
+
+	auto flush = workers.create_task([pool]() {
+		if (pool)
+			pool->end_parallel_iteration();
+	});
+	workers.add_dependency(flush, loop);
+	loop->flush();
+	return flush;
+}
+
 }
\ No newline at end of file
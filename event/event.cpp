@@ -50,27 +50,44 @@ void EventManager::dispatch()
 	for (auto &event_type : events)
 	{
 		auto &handlers = event_type.handlers;
+		auto &batch_handlers = event_type.batch_handlers;
 		auto &queued_events = event_type.queued_events;
+		if (queued_events.empty())
+			continue;
+
+		// Batch handlers consume the frame's events of a type in one call.
+		auto batch_itr = remove_if(begin(batch_handlers), end(batch_handlers), [&](const BatchHandler &handler) {
+			return !handler.mem_fn(handler.handler, queued_events.data(), queued_events.size());
+		});
+		batch_handlers.erase(batch_itr, end(batch_handlers));
+
 		auto itr = remove_if(begin(handlers), end(handlers), [&](const Handler &handler) {
-			for (auto &event : queued_events)
+			for (auto *event : queued_events)
 				if (!handler.mem_fn(handler.handler, *event))
 					return true;
 			return false;
 		});
 
 		handlers.erase(itr, end(handlers));
-		queued_events.clear();
+		event_type.clear_queued_events();
 	}
 }
 
-void EventManager::dispatch_event(std::vector<Handler> &handlers, const Event &e)
+void EventManager::dispatch_event(EventTypeData &event_type, const Event &e)
 {
-	auto itr = remove_if(begin(handlers), end(handlers), [&](const Handler &handler) {
+	const Event *ptr = &e;
+	auto batch_itr = remove_if(begin(event_type.batch_handlers), end(event_type.batch_handlers),
+	                           [&](const BatchHandler &handler) {
+		return !handler.mem_fn(handler.handler, &ptr, 1);
+	});
+	event_type.batch_handlers.erase(batch_itr, end(event_type.batch_handlers));
+
+	auto itr = remove_if(begin(event_type.handlers), end(event_type.handlers), [&](const Handler &handler) {
 		bool keep_event = handler.mem_fn(handler.handler, e);
 		return !keep_event;
 	});
 
-	handlers.erase(itr, end(handlers));
+	event_type.handlers.erase(itr, end(event_type.handlers));
 }
 
 void EventManager::dispatch_up_events(std::vector<std::unique_ptr<Event>> &up_events, const LatchHandler &handler)
@@ -97,6 +114,13 @@ void EventManager::EventTypeData::flush_recursive_handlers()
 	recursive_handlers.clear();
 }
 
+void EventManager::EventTypeData::clear_queued_events()
+{
+	for (auto *event : queued_events)
+		pool->free_event(event);
+	queued_events.clear();
+}
+
 void EventManager::dispatch_up_event(LatchEventTypeData &event_type, const Event &event)
 {
 	event_type.dispatching = true;
@@ -128,6 +152,17 @@ void EventManager::unregister_handler(EventHandler *handler)
 
 		if (itr != end(event_type.handlers))
 			event_type.handlers.erase(itr, end(event_type.handlers));
+
+		auto batch_itr = remove_if(begin(event_type.batch_handlers), end(event_type.batch_handlers),
+		                           [&](const BatchHandler &h) {
+			return h.unregister_key == handler;
+		});
+
+		if (batch_itr != end(event_type.batch_handlers) && event_type.dispatching)
+			throw logic_error("Unregistering handlers while dispatching events.");
+
+		if (batch_itr != end(event_type.batch_handlers))
+			event_type.batch_handlers.erase(batch_itr, end(event_type.batch_handlers));
 	}
 }
 
@@ -184,23 +219,28 @@ void EventManager::unregister_latch_handler(const LatchHandler &handler)
 
 void EventManager::dequeue_latched(uint64_t cookie)
 {
-	for (auto &event_type : latched_events)
-	{
-		auto &queued_events = event_type.queued_events;
-		if (event_type.enqueueing)
-			throw logic_error("Dequeueing latched while queueing events.");
-		event_type.enqueueing = true;
+	// The cookie index takes us straight to the owning event type instead of
+	// scanning every type's queue.
+	auto index_itr = latched_cookie_index.find(cookie);
+	if (index_itr == end(latched_cookie_index))
+		return;
+
+	auto &event_type = *index_itr->second;
+	auto &queued_events = event_type.queued_events;
+	if (event_type.enqueueing)
+		throw logic_error("Dequeueing latched while queueing events.");
+	event_type.enqueueing = true;
 
-		auto itr = remove_if(begin(queued_events), end(queued_events), [&](const unique_ptr<Event> &event) {
-			bool signal = event->get_cookie() == cookie;
-			if (signal)
-				dispatch_down_event(event_type, *event);
-			return signal;
-		});
+	auto itr = remove_if(begin(queued_events), end(queued_events), [&](const unique_ptr<Event> &event) {
+		bool signal = event->get_cookie() == cookie;
+		if (signal)
+			dispatch_down_event(event_type, *event);
+		return signal;
+	});
 
-		event_type.enqueueing = false;
-		queued_events.erase(itr, end(queued_events));
-	}
+	event_type.enqueueing = false;
+	queued_events.erase(itr, end(queued_events));
+	latched_cookie_index.erase(index_itr);
 }
 
 void EventManager::dequeue_all_latched(EventType type)
@@ -211,7 +251,10 @@ void EventManager::dequeue_all_latched(EventType type)
 
 	event_type.enqueueing = true;
 	for (auto &event : event_type.queued_events)
+	{
 		dispatch_down_event(event_type, *event);
+		latched_cookie_index.erase(event->get_cookie());
+	}
 	event_type.queued_events.clear();
 	event_type.enqueueing = false;
 }
@@ -26,12 +26,16 @@
 #include <memory>
 #include <stdexcept>
 #include <utility>
+#include <unordered_map>
 #include "global_managers.hpp"
 #include "compile_time_hash.hpp"
 #include "intrusive_hash_map.hpp"
+#include "object_pool.hpp"
 
 #define EVENT_MANAGER_REGISTER(clazz, member, event) \
 	::Granite::Global::event_manager()->register_handler<clazz, event, &clazz::member>(this)
+#define EVENT_MANAGER_REGISTER_BATCH(clazz, member, event) \
+	::Granite::Global::event_manager()->register_batch_handler<clazz, event, &clazz::member>(this)
 #define EVENT_MANAGER_REGISTER_LATCH(clazz, up_event, down_event, event) \
 	::Granite::Global::event_manager()->register_latch_handler<clazz, event, &clazz::up_event, &clazz::down_event>(this)
 
@@ -45,6 +49,14 @@ Return member_function_invoker(void *object, const Event &e)
 	return (static_cast<T *>(object)->*callback)(static_cast<const EventType &>(e));
 }
 
+template <typename T, typename EventType, bool (T::*callback)(const EventType *const *events, size_t count)>
+bool member_function_batch_invoker(void *object, const Event *const *events, size_t count)
+{
+	// Derived event types use single inheritance from Event,
+	// so the pointer values can be reinterpreted in place.
+	return (static_cast<T *>(object)->*callback)(reinterpret_cast<const EventType *const *>(events), count);
+}
+
 #define GRANITE_EVENT_TYPE_HASH(x) ::Util::compile_time_fnv1(#x)
 using EventType = uint64_t;
 
@@ -114,8 +126,11 @@ public:
 		static constexpr auto type = T::get_type_id();
 		auto &l = events[type];
 
-		auto ptr = std::unique_ptr<Event>(new T(std::forward<P>(p)...));
-		l.queued_events.emplace_back(std::move(ptr));
+		if (!l.pool)
+			l.pool.reset(new EventPool<T>);
+		auto *event = static_cast<EventPool<T> *>(l.pool.get())->pool.allocate(std::forward<P>(p)...);
+		if (event)
+			l.queued_events.push_back(event);
 	}
 
 	template<typename T, typename... P>
@@ -133,6 +148,7 @@ public:
 
 		auto *event = ptr.get();
 		l.queued_events.emplace_back(std::move(ptr));
+		latched_cookie_index[cookie] = &l;
 		dispatch_up_event(l, *event);
 		l.enqueueing = false;
 		return cookie;
@@ -146,14 +162,14 @@ public:
 	{
 		static constexpr auto type = T::get_type_id();
 		auto &l = events[type];
-		dispatch_event(l.handlers, t);
+		dispatch_event(l, t);
 	}
 
 	void dispatch_inline(const Event &e)
 	{
 		assert(e.get_type_id() != 0);
 		auto &l = events[e.get_type_id()];
-		dispatch_event(l.handlers, e);
+		dispatch_event(l, e);
 	}
 
 	void dispatch();
@@ -169,6 +185,18 @@ public:
 			l.handlers.push_back({ member_function_invoker<bool, T, EventType, mem_fn>, handler, handler });
 	}
 
+	// Like register_handler, but the handler is invoked once per dispatch()
+	// with the whole frame's worth of queued events of the type, so heavy
+	// consumers can process them in one pass. Inline dispatches arrive as
+	// spans of one. Returning false unregisters, as with per-event handlers.
+	template<typename T, typename EventType, bool (T::*mem_fn)(const EventType *const *, size_t)>
+	void register_batch_handler(T *handler)
+	{
+		static constexpr auto type_id = EventType::get_type_id();
+		auto &l = events[type_id];
+		l.batch_handlers.push_back({ member_function_batch_invoker<T, EventType, mem_fn>, handler, handler });
+	}
+
 	void unregister_handler(EventHandler *handler);
 
 #if 0
@@ -189,10 +217,9 @@ public:
 			handler, handler };
 
 		static constexpr auto type_id = EventType::get_type_id();
-		auto &levents = latched_events[type_id];
-		dispatch_up_events(levents.queued_events, h);
-
 		auto &l = latched_events[type_id];
+		dispatch_up_events(l.queued_events, h);
+
 		if (l.dispatching)
 			l.recursive_handlers.push_back(h);
 		else
@@ -224,6 +251,32 @@ private:
 		EventHandler *unregister_key;
 	};
 
+	struct BatchHandler
+	{
+		bool (*mem_fn)(void *object, const Event *const *events, size_t count);
+		void *handler;
+		EventHandler *unregister_key;
+	};
+
+	// Events of one type are recycled through a per-type object pool,
+	// so steady-state enqueues never hit the heap.
+	struct EventPoolBase
+	{
+		virtual ~EventPoolBase() = default;
+		virtual void free_event(Event *event) = 0;
+	};
+
+	template <typename T>
+	struct EventPool final : EventPoolBase
+	{
+		Util::ObjectPool<T> pool;
+
+		void free_event(Event *event) override
+		{
+			pool.free(static_cast<T *>(event));
+		}
+	};
+
 	struct LatchHandler
 	{
 		void (*up_fn)(void *object, const Event &event);
@@ -234,13 +287,21 @@ private:
 
 	struct EventTypeData : Util::IntrusiveHashMapEnabled<EventTypeData>
 	{
-		std::vector<std::unique_ptr<Event>> queued_events;
+		~EventTypeData()
+		{
+			clear_queued_events();
+		}
+
+		std::vector<Event *> queued_events;
+		std::unique_ptr<EventPoolBase> pool;
 		std::vector<Handler> handlers;
+		std::vector<BatchHandler> batch_handlers;
 		std::vector<Handler> recursive_handlers;
 		bool enqueueing = false;
 		bool dispatching = false;
 
 		void flush_recursive_handlers();
+		void clear_queued_events();
 	};
 
 	struct LatchEventTypeData : Util::IntrusiveHashMapEnabled<LatchEventTypeData>
@@ -254,7 +315,7 @@ private:
 		void flush_recursive_handlers();
 	};
 
-	void dispatch_event(std::vector<Handler> &handlers, const Event &e);
+	void dispatch_event(EventTypeData &event_type, const Event &e);
 	void dispatch_up_events(std::vector<std::unique_ptr<Event>> &events, const LatchHandler &handler);
 	void dispatch_down_events(std::vector<std::unique_ptr<Event>> &events, const LatchHandler &handler);
 	void dispatch_up_event(LatchEventTypeData &event_type, const Event &event);
@@ -267,6 +328,10 @@ private:
 
 	Util::IntrusiveHashMap<EventTypeData> events;
 	Util::IntrusiveHashMap<LatchEventTypeData> latched_events;
+	// Maps a latched cookie straight to its event type so dequeue does not
+	// have to scan every type's queue. Latched scene events come in bursts
+	// during streaming, which made those scans show up.
+	std::unordered_map<uint64_t, LatchEventTypeData *> latched_cookie_index;
 	uint64_t cookie_counter = 0;
 };
 }
@@ -0,0 +1,453 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "async_io.hpp"
+#include "logging.hpp"
+#include "timeline_trace_file.hpp"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+using namespace std;
+
+namespace Granite
+{
+bool AsyncReadRequest::wait()
+{
+	if (complete.load(memory_order_acquire))
+		return success;
+
+	unique_lock<mutex> holder{lock};
+	cond.wait(holder, [this]() {
+		return complete.load(memory_order_acquire);
+	});
+	return success;
+}
+
+void AsyncReadRequest::on_completion(function<void (AsyncReadRequest &)> func)
+{
+	{
+		lock_guard<mutex> holder{lock};
+		if (!complete.load(memory_order_acquire))
+		{
+			callbacks.push_back(move(func));
+			return;
+		}
+	}
+	func(*this);
+}
+
+void AsyncReadRequest::add_dependency(TaskGroup &dependee)
+{
+	auto *group = dependee->get_thread_group();
+	auto gate = group->create_task();
+	group->add_dependency(dependee, gate);
+
+	{
+		lock_guard<mutex> holder{lock};
+		if (!complete.load(memory_order_acquire))
+		{
+			gates.push_back(move(gate));
+			return;
+		}
+	}
+	gate->flush();
+}
+
+void AsyncReadRequest::set_complete(bool success_)
+{
+	vector<function<void (AsyncReadRequest &)>> pending_callbacks;
+	vector<TaskGroup> pending_gates;
+
+	{
+		lock_guard<mutex> holder{lock};
+		success = success_;
+		complete.store(true, memory_order_release);
+		pending_callbacks.swap(callbacks);
+		pending_gates.swap(gates);
+		cond.notify_all();
+	}
+
+	for (auto &func : pending_callbacks)
+		func(*this);
+	for (auto &gate : pending_gates)
+		gate->flush();
+}
+
+#ifdef __linux__
+// One outstanding io_uring read. user_data in the SQE points here, and the
+// node also keeps the request alive until the read retires.
+struct AsyncIOService::Submission
+{
+	AsyncReadRequestHandle request;
+	int fd = -1;
+	size_t offset = 0;
+};
+
+bool AsyncIOService::init_uring()
+{
+	io_uring_params params = {};
+	ring.fd = int(syscall(__NR_io_uring_setup, 64, &params));
+	if (ring.fd < 0)
+	{
+		LOGI("io_uring not available, falling back to IO thread.\n");
+		return false;
+	}
+
+	ring.sq_entries = params.sq_entries;
+	ring.sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring.cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (ring.cq_map_size > ring.sq_map_size)
+			ring.sq_map_size = ring.cq_map_size;
+		ring.cq_map_size = 0;
+	}
+
+	ring.sq_ptr = mmap(nullptr, ring.sq_map_size, PROT_READ | PROT_WRITE,
+	                   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+	if (ring.sq_ptr == MAP_FAILED)
+	{
+		ring.sq_ptr = nullptr;
+		destroy_uring();
+		return false;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		ring.cq_ptr = ring.sq_ptr;
+	else
+	{
+		ring.cq_ptr = mmap(nullptr, ring.cq_map_size, PROT_READ | PROT_WRITE,
+		                   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+		if (ring.cq_ptr == MAP_FAILED)
+		{
+			ring.cq_ptr = nullptr;
+			destroy_uring();
+			return false;
+		}
+	}
+
+	ring.sqe_map_size = params.sq_entries * sizeof(io_uring_sqe);
+	ring.sqe_ptr = mmap(nullptr, ring.sqe_map_size, PROT_READ | PROT_WRITE,
+	                    MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+	if (ring.sqe_ptr == MAP_FAILED)
+	{
+		ring.sqe_ptr = nullptr;
+		destroy_uring();
+		return false;
+	}
+
+	auto *sq_base = static_cast<uint8_t *>(ring.sq_ptr);
+	ring.sq_head = reinterpret_cast<unsigned *>(sq_base + params.sq_off.head);
+	ring.sq_tail = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+	ring.sq_mask = reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+	ring.sq_array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+
+	auto *cq_base = static_cast<uint8_t *>(ring.cq_ptr);
+	ring.cq_head = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+	ring.cq_tail = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+	ring.cq_mask = reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+	ring.cqes = cq_base + params.cq_off.cqes;
+	ring.sqes = ring.sqe_ptr;
+	return true;
+}
+
+void AsyncIOService::destroy_uring()
+{
+	if (ring.sqe_ptr)
+		munmap(ring.sqe_ptr, ring.sqe_map_size);
+	if (ring.cq_ptr && ring.cq_ptr != ring.sq_ptr)
+		munmap(ring.cq_ptr, ring.cq_map_size);
+	if (ring.sq_ptr)
+		munmap(ring.sq_ptr, ring.sq_map_size);
+	ring.sq_ptr = nullptr;
+	ring.cq_ptr = nullptr;
+	ring.sqe_ptr = nullptr;
+
+	if (ring.fd >= 0)
+		close(ring.fd);
+	ring.fd = -1;
+}
+
+void AsyncIOService::submit_uring_locked(Submission *sub)
+{
+	unsigned tail = *ring.sq_tail;
+	unsigned index = tail & *ring.sq_mask;
+	auto &sqe = static_cast<io_uring_sqe *>(ring.sqes)[index];
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_READ;
+	sqe.fd = sub->fd;
+	sqe.addr = uint64_t(uintptr_t(sub->request->buffer.data() + sub->offset));
+	// Cap single submissions at 1 GiB, the short-read path picks up the rest.
+	sqe.len = uint32_t(min<size_t>(sub->request->size - sub->offset, 1u << 30));
+	sqe.off = sub->offset;
+	sqe.user_data = uint64_t(uintptr_t(sub));
+
+	ring.sq_array[index] = index;
+	__atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+	in_flight++;
+
+	if (syscall(__NR_io_uring_enter, ring.fd, 1, 0, 0, nullptr, 0) < 0)
+		LOGE("io_uring_enter failed: %s\n", strerror(errno));
+}
+
+void AsyncIOService::submit_uring(Submission *sub)
+{
+	lock_guard<mutex> holder{submit_lock};
+	if (in_flight >= ring.sq_entries)
+		overflow.push_back(sub);
+	else
+		submit_uring_locked(sub);
+}
+
+void AsyncIOService::submit_nop_locked()
+{
+	unsigned tail = *ring.sq_tail;
+	unsigned index = tail & *ring.sq_mask;
+	auto &sqe = static_cast<io_uring_sqe *>(ring.sqes)[index];
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_NOP;
+	sqe.fd = -1;
+	sqe.user_data = 0;
+
+	ring.sq_array[index] = index;
+	__atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+	in_flight++;
+
+	if (syscall(__NR_io_uring_enter, ring.fd, 1, 0, 0, nullptr, 0) < 0)
+		LOGE("io_uring_enter failed: %s\n", strerror(errno));
+}
+
+void AsyncIOService::uring_looper()
+{
+	Util::TimelineTraceFile::set_tid("async-io");
+	bool dead = false;
+
+	for (;;)
+	{
+		if (dead)
+		{
+			// Tear down only once every read submitted before the sentinel has
+			// retired, so no Submission node or fd is left dangling.
+			lock_guard<mutex> holder{submit_lock};
+			if (in_flight == 0 && overflow.empty())
+				return;
+		}
+
+		unsigned head = *ring.cq_head;
+		while (head == __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE))
+		{
+			if (syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+			    errno != EINTR)
+			{
+				LOGE("io_uring_enter failed: %s\n", strerror(errno));
+				return;
+			}
+		}
+
+		unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail)
+		{
+			auto &cqe = static_cast<io_uring_cqe *>(ring.cqes)[head & *ring.cq_mask];
+			auto *sub = reinterpret_cast<Submission *>(uintptr_t(cqe.user_data));
+			int res = cqe.res;
+			head++;
+
+			// A NOP with null user_data is the shutdown sentinel.
+			if (!sub)
+			{
+				lock_guard<mutex> holder{submit_lock};
+				in_flight--;
+				dead = true;
+				continue;
+			}
+
+			if (res > 0 && sub->offset + size_t(res) < sub->request->size)
+			{
+				// Short read, resubmit the remainder.
+				sub->offset += size_t(res);
+				lock_guard<mutex> holder{submit_lock};
+				in_flight--;
+				submit_uring_locked(sub);
+				continue;
+			}
+
+			if (res < 0)
+				LOGE("io_uring read failed: %s\n", strerror(-res));
+			else if (res == 0 && sub->request->size != 0)
+				LOGE("io_uring read hit unexpected EOF.\n");
+
+			close(sub->fd);
+			sub->request->set_complete(res > 0);
+			delete sub;
+
+			lock_guard<mutex> holder{submit_lock};
+			in_flight--;
+			while (!overflow.empty() && in_flight < ring.sq_entries)
+			{
+				submit_uring_locked(overflow.front());
+				overflow.erase(overflow.begin());
+			}
+		}
+
+		__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+	}
+}
+
+bool AsyncIOService::read_uring(const string &path, AsyncReadRequestHandle &request)
+{
+	if (ring.fd < 0)
+		return false;
+
+	auto fs_path = fs.get_filesystem_path(path);
+	if (fs_path.empty())
+		return false;
+
+	int fd = ::open(fs_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat s;
+	if (fstat(fd, &s) < 0 || !S_ISREG(s.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+
+	request->size = size_t(s.st_size);
+	if (request->size == 0)
+	{
+		close(fd);
+		request->set_complete(true);
+		return true;
+	}
+
+	request->buffer.resize(request->size);
+	auto *sub = new Submission;
+	sub->request = request;
+	sub->fd = fd;
+	submit_uring(sub);
+	return true;
+}
+#endif
+
+AsyncIOService::AsyncIOService(Filesystem &fs_)
+	: fs(fs_)
+{
+#ifdef __linux__
+	if (init_uring())
+		uring_thread = thread(&AsyncIOService::uring_looper, this);
+#endif
+	fallback_thread = thread(&AsyncIOService::fallback_looper, this);
+}
+
+AsyncIOService::~AsyncIOService()
+{
+#ifdef __linux__
+	if (uring_thread.joinable())
+	{
+		{
+			lock_guard<mutex> holder{submit_lock};
+			submit_nop_locked();
+		}
+		uring_thread.join();
+	}
+	destroy_uring();
+#endif
+
+	{
+		lock_guard<mutex> holder{fallback_lock};
+		fallback_dead = true;
+		fallback_cond.notify_one();
+	}
+	fallback_thread.join();
+}
+
+void AsyncIOService::fallback_looper()
+{
+	Util::TimelineTraceFile::set_tid("async-io-fallback");
+	for (;;)
+	{
+		FallbackItem item;
+		{
+			unique_lock<mutex> holder{fallback_lock};
+			fallback_cond.wait(holder, [this]() {
+				return fallback_dead || !fallback_queue.empty();
+			});
+
+			if (fallback_queue.empty())
+				return;
+			item = move(fallback_queue.front());
+			fallback_queue.pop();
+		}
+		read_fallback(item.path, move(item.request));
+	}
+}
+
+void AsyncIOService::read_fallback(const string &path, AsyncReadRequestHandle request)
+{
+	auto file = fs.open(path);
+	if (!file)
+	{
+		request->set_complete(false);
+		return;
+	}
+
+	void *mapped = file->map();
+	if (!mapped && file->get_size() != 0)
+	{
+		request->set_complete(false);
+		return;
+	}
+
+	request->mapped = mapped;
+	request->size = file->get_size();
+	request->file = move(file);
+	request->set_complete(true);
+}
+
+AsyncReadRequestHandle AsyncIOService::read(const string &path)
+{
+	auto request = make_shared<AsyncReadRequest>();
+
+#ifdef __linux__
+	if (read_uring(path, request))
+		return request;
+#endif
+
+	{
+		lock_guard<mutex> holder{fallback_lock};
+		fallback_queue.push({ request, path });
+		fallback_cond.notify_one();
+	}
+	return request;
+}
+}
@@ -0,0 +1,176 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "filesystem.hpp"
+#include "thread_group.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Granite
+{
+// Handle for one in-flight asynchronous file read. The data pointer is valid
+// from the moment the request completes successfully until the handle dies.
+// Completion can be observed by polling, blocking, a callback, or by gating a
+// TaskGroup on it, so streaming code can pick whatever fits its scheduling.
+class AsyncReadRequest
+{
+public:
+	AsyncReadRequest() = default;
+	AsyncReadRequest(const AsyncReadRequest &) = delete;
+	void operator=(const AsyncReadRequest &) = delete;
+
+	bool is_complete() const
+	{
+		return complete.load(std::memory_order_acquire);
+	}
+
+	// Blocks until the request completes. Returns false if the read failed.
+	bool wait();
+
+	// Only valid once is_complete() returns true.
+	bool get_success() const
+	{
+		return success;
+	}
+
+	const void *get_data() const
+	{
+		return mapped ? mapped : (buffer.empty() ? nullptr : buffer.data());
+	}
+
+	size_t get_size() const
+	{
+		return size;
+	}
+
+	// Runs func on the IO thread when the request completes, or inline if it
+	// already has. Used by cooperative tasks to signal their Awaiter.
+	void on_completion(std::function<void (AsyncReadRequest &)> func);
+
+	// Blocks dependee from running until the request has completed, through an
+	// empty gate TaskGroup which is flushed by the IO thread. This is how
+	// parse/upload tasks chain onto reads without any thread blocking.
+	void add_dependency(TaskGroup &dependee);
+
+private:
+	friend class AsyncIOService;
+
+	void set_complete(bool success_);
+
+	std::vector<uint8_t> buffer;
+	// Fallback path pins the mapped File instead of copying it.
+	std::unique_ptr<File> file;
+	const void *mapped = nullptr;
+	size_t size = 0;
+	bool success = false;
+	std::atomic<bool> complete{false};
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::vector<std::function<void (AsyncReadRequest &)>> callbacks;
+	std::vector<TaskGroup> gates;
+};
+
+// Owned by Filesystem, created on first read_async().
+// On Linux, files which resolve to a real filesystem path are read through
+// io_uring, so any number of requests stay in flight from a single submission
+// site and one completion thread. Other protocols (and other platforms) fall
+// back to a dedicated IO thread which opens and maps files one by one.
+class AsyncIOService
+{
+public:
+	explicit AsyncIOService(Filesystem &fs);
+	~AsyncIOService();
+	AsyncIOService(const AsyncIOService &) = delete;
+	void operator=(const AsyncIOService &) = delete;
+
+	AsyncReadRequestHandle read(const std::string &path);
+
+private:
+	Filesystem &fs;
+
+#ifdef __linux__
+	struct Submission;
+
+	// Raw io_uring instance. Submissions can come from any thread and are
+	// serialized under submit_lock; completions are reaped by uring_thread.
+	struct
+	{
+		int fd = -1;
+		void *sq_ptr = nullptr;
+		size_t sq_map_size = 0;
+		void *cq_ptr = nullptr;
+		size_t cq_map_size = 0;
+		void *sqe_ptr = nullptr;
+		size_t sqe_map_size = 0;
+
+		unsigned *sq_head = nullptr;
+		unsigned *sq_tail = nullptr;
+		unsigned *sq_mask = nullptr;
+		unsigned *sq_array = nullptr;
+		unsigned *cq_head = nullptr;
+		unsigned *cq_tail = nullptr;
+		unsigned *cq_mask = nullptr;
+		void *sqes = nullptr;
+		void *cqes = nullptr;
+		unsigned sq_entries = 0;
+	} ring;
+
+	std::mutex submit_lock;
+	unsigned in_flight = 0;
+	std::vector<Submission *> overflow;
+	std::thread uring_thread;
+
+	bool init_uring();
+	void destroy_uring();
+	// Takes ownership of sub; queues it in overflow if the SQ is full.
+	void submit_uring(Submission *sub);
+	void submit_uring_locked(Submission *sub);
+	void submit_nop_locked();
+	void uring_looper();
+	bool read_uring(const std::string &path, AsyncReadRequestHandle &request);
+#endif
+
+	struct FallbackItem
+	{
+		AsyncReadRequestHandle request;
+		std::string path;
+	};
+	std::mutex fallback_lock;
+	std::condition_variable fallback_cond;
+	std::queue<FallbackItem> fallback_queue;
+	std::thread fallback_thread;
+	bool fallback_dead = false;
+
+	void fallback_looper();
+	void read_fallback(const std::string &path, AsyncReadRequestHandle request);
+};
+}
@@ -21,6 +21,7 @@
  */
 
 #include "filesystem.hpp"
+#include "async_io.hpp"
 #include "os_filesystem.hpp"
 #include "fs-netfs.hpp"
 #include "path.hpp"
@@ -182,10 +183,59 @@ Filesystem::Filesystem()
 #endif
 		if (cache_dir)
 			register_protocol("cache", unique_ptr<FilesystemBackend>(new OSFilesystem(cache_dir)));
+
+		// Shipped deployments can point the read-only protocols at a single
+		// pack file instead of a directory tree. Registered last so a pack
+		// takes precedence over the directory fallbacks above.
+		const char *asset_pack = getenv("GRANITE_DEFAULT_ASSET_PACK");
+		if (asset_pack)
+			register_pack_file("assets", asset_pack);
+
+		const char *builtin_pack = getenv("GRANITE_DEFAULT_BUILTIN_PACK");
+		if (builtin_pack)
+			register_pack_file("builtin", builtin_pack);
 	}
 #endif
 }
 
+bool Filesystem::register_pack_file(const std::string &proto, const std::string &pack_path)
+{
+	auto file = open(pack_path, FileMode::ReadOnly);
+	if (!file)
+	{
+		LOGE("Failed to open pack file: %s\n", pack_path.c_str());
+		return false;
+	}
+
+	try
+	{
+		register_protocol(proto, unique_ptr<FilesystemBackend>(new BlobFilesystem(move(file), "")));
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("Failed to parse pack file %s (%s).\n", pack_path.c_str(), e.what());
+		return false;
+	}
+	return true;
+}
+
+Filesystem::~Filesystem()
+{
+	// Joins the IO threads, and thus any in-flight request, before the
+	// backends they read through die.
+	async_service.reset();
+}
+
+AsyncReadRequestHandle Filesystem::read_async(const std::string &path)
+{
+	{
+		lock_guard<mutex> holder{async_lock};
+		if (!async_service)
+			async_service.reset(new AsyncIOService(*this));
+	}
+	return async_service->read(path);
+}
+
 void Filesystem::register_protocol(const std::string &proto, std::unique_ptr<FilesystemBackend> fs)
 {
 	fs->set_protocol(proto);
@@ -193,6 +243,94 @@ void Filesystem::register_protocol(const std::string &proto, std::unique_ptr<Fil
 	if (em)
 		em->dispatch_inline(FilesystemProtocolEvent(proto, *fs));
 	protocols[proto] = move(fs);
+
+	// Interned paths cache their backend pointer, so a protocol registered
+	// (or replaced) after interning has to refresh them.
+	lock_guard<mutex> holder{intern_lock};
+	for (auto &interned : interned_paths)
+		if (interned->protocol == proto || (interned->protocol.empty() && proto == "file"))
+			interned->backend = protocols[proto].get();
+}
+
+Filesystem::PathID Filesystem::intern_path(const std::string &path)
+{
+	lock_guard<mutex> holder{intern_lock};
+	auto itr = path_to_id.find(path);
+	if (itr != end(path_to_id))
+		return itr->second;
+
+	auto paths = Path::protocol_split(path);
+	unique_ptr<InternedPath> interned{new InternedPath};
+	interned->protocol = move(paths.first);
+	// canonicalize_path() drops a leading slash, which is meaningful for
+	// protocols rooted in the OS filesystem, so put it back.
+	interned->path = Path::canonicalize_path(paths.second);
+	if (!paths.second.empty() && paths.second.front() == '/')
+		interned->path.insert(begin(interned->path), '/');
+	interned->backend = get_backend(interned->protocol);
+
+	auto id = PathID(interned_paths.size());
+	interned_paths.push_back(move(interned));
+	path_to_id[path] = id;
+	return id;
+}
+
+Filesystem::InternedPath *Filesystem::resolve_path_id(PathID id)
+{
+	// Entries are stable once created; only the table itself needs the lock.
+	lock_guard<mutex> holder{intern_lock};
+	if (id >= interned_paths.size())
+		return nullptr;
+	return interned_paths[id].get();
+}
+
+std::unique_ptr<File> Filesystem::open(PathID id, FileMode mode)
+{
+	auto *interned = resolve_path_id(id);
+	if (!interned || !interned->backend)
+		return {};
+
+	return interned->backend->open(interned->path, mode);
+}
+
+bool Filesystem::stat(PathID id, FileStat &stat)
+{
+	auto *interned = resolve_path_id(id);
+	if (!interned || !interned->backend)
+		return false;
+
+	return interned->backend->stat(interned->path, stat);
+}
+
+std::string Filesystem::get_filesystem_path(PathID id)
+{
+	auto *interned = resolve_path_id(id);
+	if (!interned || !interned->backend)
+		return "";
+
+	return interned->backend->get_filesystem_path(interned->path);
+}
+
+FileNotifyHandle Filesystem::install_notification(PathID id, std::function<void(const FileNotifyInfo &)> func)
+{
+	auto *interned = resolve_path_id(id);
+	if (!interned || !interned->backend)
+		return -1;
+
+	return interned->backend->install_notification(interned->path, move(func));
+}
+
+FilesystemBackend *Filesystem::get_backend_for_path(PathID id)
+{
+	auto *interned = resolve_path_id(id);
+	return interned ? interned->backend : nullptr;
+}
+
+const std::string &Filesystem::get_interned_path(PathID id)
+{
+	static const string empty;
+	auto *interned = resolve_path_id(id);
+	return interned ? interned->path : empty;
 }
 
 FilesystemBackend *Filesystem::get_backend(const std::string &proto)
@@ -617,4 +755,196 @@ int BlobFilesystem::get_notification_fd() const
 	return -1;
 }
 
+ManifestFilesystem::ManifestFilesystem(std::unique_ptr<File> manifest_, std::unique_ptr<FilesystemBackend> fallback_)
+	: manifest(std::move(manifest_)), fallback(std::move(fallback_))
+{
+	if (!manifest)
+		return;
+
+	try
+	{
+		parse();
+	}
+	catch (const std::exception &e)
+	{
+		// Shipping manifests are validated at build time; a broken one in a
+		// development tree just means we take the syscall path.
+		LOGE("Failed to parse filesystem manifest (%s), falling back to live directory.\n", e.what());
+		files.clear();
+		directories.clear();
+	}
+}
+
+uint8_t ManifestFilesystem::read_u8(const uint8_t *&buf, size_t &size)
+{
+	if (size < 1)
+		throw std::range_error("Manifest EOF.");
+
+	uint8_t ret = *buf++;
+	size--;
+	return ret;
+}
+
+uint64_t ManifestFilesystem::read_u64(const uint8_t *&buf, size_t &size)
+{
+	if (size < 8)
+		throw std::range_error("Manifest EOF.");
+
+	uint64_t ret = 0;
+	for (unsigned i = 0; i < 8; i++)
+		ret |= uint64_t(buf[i]) << (8 * i);
+	size -= 8;
+	buf += 8;
+	return ret;
+}
+
+std::string ManifestFilesystem::read_string(const uint8_t *&buf, size_t &size, size_t len)
+{
+	if (size < len)
+		throw std::range_error("Manifest EOF.");
+
+	std::string ret;
+	ret.insert(ret.end(), reinterpret_cast<const char *>(buf), reinterpret_cast<const char *>(buf) + len);
+	size -= len;
+	buf += len;
+	return ret;
+}
+
+void ManifestFilesystem::add_entry(const std::string &path, const ManifestEntry &entry)
+{
+	files[path] = entry;
+
+	// Register the whole parent chain so list() resolves from the index too.
+	std::string child = path;
+	PathType type = PathType::File;
+	for (;;)
+	{
+		auto split = Path::split(child);
+		std::string parent = split.first == "." ? "" : std::move(split.first);
+
+		auto &listing = directories[parent];
+		auto itr = std::find_if(listing.begin(), listing.end(), [&](const ListEntry &e) {
+			return e.path == split.second;
+		});
+		if (itr == listing.end())
+			listing.push_back({ std::move(split.second), type });
+
+		if (parent.empty())
+			break;
+		child = std::move(parent);
+		type = PathType::Directory;
+	}
+}
+
+void ManifestFilesystem::parse()
+{
+	size_t mapped_size = manifest->get_size();
+	if (mapped_size < 8)
+		throw std::runtime_error("Manifest too small.");
+	auto *mapped = static_cast<const uint8_t *>(manifest->map());
+	if (!mapped)
+		throw std::runtime_error("Failed to map manifest.");
+
+	if (memcmp(mapped, "MANIFS01", 8) != 0)
+		throw std::runtime_error("Invalid magic.");
+	mapped += 8;
+	mapped_size -= 8;
+
+	while (mapped_size >= 4 && memcmp(mapped, "ENTR", 4) == 0)
+	{
+		mapped += 4;
+		mapped_size -= 4;
+
+		uint8_t len = read_u8(mapped, mapped_size);
+		std::string path = Path::canonicalize_path(read_string(mapped, mapped_size, len));
+		ManifestEntry entry;
+		entry.size = read_u64(mapped, mapped_size);
+		entry.last_modified = read_u64(mapped, mapped_size);
+		entry.content_hash = read_u64(mapped, mapped_size);
+		add_entry(path, entry);
+	}
+}
+
+std::vector<ListEntry> ManifestFilesystem::list(const std::string &path)
+{
+	auto canon_path = Path::canonicalize_path(path);
+	auto itr = directories.find(canon_path);
+	if (itr == directories.end())
+		return fallback ? fallback->list(path) : std::vector<ListEntry>{};
+
+	std::vector<ListEntry> entries;
+	entries.reserve(itr->second.size());
+	for (auto &e : itr->second)
+		entries.push_back({ Path::join(path, e.path), e.type });
+	return entries;
+}
+
+bool ManifestFilesystem::stat(const std::string &path, FileStat &stat)
+{
+	auto canon_path = Path::canonicalize_path(path);
+
+	auto file_itr = files.find(canon_path);
+	if (file_itr != files.end())
+	{
+		stat.size = file_itr->second.size;
+		stat.type = PathType::File;
+		stat.last_modified = file_itr->second.last_modified;
+		return true;
+	}
+
+	if (directories.count(canon_path))
+	{
+		stat.size = 0;
+		stat.last_modified = 0;
+		stat.type = PathType::Directory;
+		return true;
+	}
+
+	return fallback && fallback->stat(path, stat);
+}
+
+bool ManifestFilesystem::get_content_hash(const std::string &path, uint64_t &hash) const
+{
+	auto itr = files.find(Path::canonicalize_path(path));
+	if (itr == files.end())
+		return false;
+	hash = itr->second.content_hash;
+	return true;
+}
+
+std::unique_ptr<File> ManifestFilesystem::open(const std::string &path, FileMode mode)
+{
+	// Actual data always comes from the live backend;
+	// the manifest only short-circuits metadata.
+	return fallback ? fallback->open(path, mode) : nullptr;
+}
+
+std::string ManifestFilesystem::get_filesystem_path(const std::string &path)
+{
+	return fallback ? fallback->get_filesystem_path(path) : "";
+}
+
+FileNotifyHandle ManifestFilesystem::install_notification(const std::string &path,
+                                                          std::function<void(const FileNotifyInfo &)> func)
+{
+	return fallback ? fallback->install_notification(path, std::move(func)) : -1;
+}
+
+void ManifestFilesystem::uninstall_notification(FileNotifyHandle handle)
+{
+	if (fallback)
+		fallback->uninstall_notification(handle);
+}
+
+void ManifestFilesystem::poll_notifications()
+{
+	if (fallback)
+		fallback->poll_notifications();
+}
+
+int ManifestFilesystem::get_notification_fd() const
+{
+	return fallback ? fallback->get_notification_fd() : -1;
+}
+
 }
\ No newline at end of file
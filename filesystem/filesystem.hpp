@@ -27,10 +27,15 @@
 #include <unordered_map>
 #include "event.hpp"
 #include <functional>
+#include <mutex>
 #include <stdio.h>
 
 namespace Granite
 {
+class AsyncReadRequest;
+class AsyncIOService;
+using AsyncReadRequestHandle = std::shared_ptr<AsyncReadRequest>;
+
 class File
 {
 public:
@@ -181,9 +186,17 @@ class Filesystem
 {
 public:
 	Filesystem();
+	~Filesystem();
 
 	void register_protocol(const std::string &proto, std::unique_ptr<FilesystemBackend> fs);
 
+	// Mounts a Blobby pack file (see tools/blobify.py) as a protocol.
+	// All members share one mapping and thus one set of OS page cache
+	// entries; opening a member is an offset computation, not a file open,
+	// which is what thousands-of-small-opens startup paths need. Build the
+	// pack with --align 4096 so members start page-aligned in the mapping.
+	bool register_pack_file(const std::string &proto, const std::string &pack_path);
+
 	FilesystemBackend *get_backend(const std::string &proto);
 
 	std::vector<ListEntry> walk(const std::string &path);
@@ -192,6 +205,29 @@ public:
 
 	std::unique_ptr<File> open(const std::string &path, FileMode mode = FileMode::ReadOnly);
 
+	// Interned canonical paths. intern_path() splits off the protocol and
+	// canonicalizes the path exactly once; the ID-based overloads below reach
+	// the backend without any splitting or string allocation. Asset-heavy
+	// loads hit the same paths over and over, and the transient strings from
+	// protocol_split() add up to real churn there.
+	using PathID = uint64_t;
+	enum : uint64_t { InvalidPathID = ~0ull };
+
+	PathID intern_path(const std::string &path);
+	std::unique_ptr<File> open(PathID id, FileMode mode = FileMode::ReadOnly);
+	bool stat(PathID id, FileStat &stat);
+	std::string get_filesystem_path(PathID id);
+	FileNotifyHandle install_notification(PathID id, std::function<void(const FileNotifyInfo &)> func);
+	// For uninstall_notification and other backend-level calls.
+	FilesystemBackend *get_backend_for_path(PathID id);
+	// Backend-relative canonical form, mainly for logging.
+	const std::string &get_interned_path(PathID id);
+
+	// Starts reading path in the background and returns immediately, see
+	// async_io.hpp for how completion is observed. The first call spins up the
+	// async IO service (io_uring on Linux, an IO thread elsewhere).
+	AsyncReadRequestHandle read_async(const std::string &path);
+
 	std::string get_filesystem_path(const std::string &path);
 
 	bool read_file_to_string(const std::string &path, std::string &str);
@@ -209,6 +245,23 @@ public:
 
 private:
 	std::unordered_map<std::string, std::unique_ptr<FilesystemBackend>> protocols;
+	std::mutex async_lock;
+	std::unique_ptr<AsyncIOService> async_service;
+
+	// Entries are heap allocated so their paths stay stable while another
+	// thread grows the table; the backend pointer is refreshed by
+	// register_protocol() under intern_lock.
+	struct InternedPath
+	{
+		FilesystemBackend *backend;
+		std::string protocol;
+		std::string path;
+	};
+	std::vector<std::unique_ptr<InternedPath>> interned_paths;
+	std::unordered_map<std::string, PathID> path_to_id;
+	std::mutex intern_lock;
+
+	InternedPath *resolve_path_id(PathID id);
 };
 
 class ScratchFilesystem : public FilesystemBackend
@@ -320,4 +373,56 @@ private:
 	void add_entry(const std::string &path, size_t offset, size_t size);
 };
 
+// Serves stat() and list() from a prebuilt binary manifest of an asset root,
+// so metadata queries during scene load never hit the OS. open() and any
+// path the manifest does not know about fall through to the wrapped live
+// backend, which keeps a development tree with freshly added files working.
+// Manifests are built with tools/manifestify.py.
+class ManifestFilesystem : public FilesystemBackend
+{
+public:
+	// A null or malformed manifest degrades to a plain pass-through.
+	ManifestFilesystem(std::unique_ptr<File> manifest, std::unique_ptr<FilesystemBackend> fallback);
+
+	std::vector<ListEntry> list(const std::string &path) override;
+
+	std::unique_ptr<File> open(const std::string &path, FileMode mode = FileMode::ReadOnly) override;
+
+	bool stat(const std::string &path, FileStat &stat) override;
+
+	FileNotifyHandle install_notification(const std::string &path, std::function<void(const FileNotifyInfo &)> func) override;
+
+	void uninstall_notification(FileNotifyHandle handle) override;
+
+	void poll_notifications() override;
+
+	int get_notification_fd() const override;
+
+	std::string get_filesystem_path(const std::string &path) override;
+
+	// Content hash (FNV-1a) recorded at manifest build time,
+	// e.g. for shader/pipeline cache validation. False if not indexed.
+	bool get_content_hash(const std::string &path, uint64_t &hash) const;
+
+private:
+	std::unique_ptr<File> manifest;
+	std::unique_ptr<FilesystemBackend> fallback;
+
+	struct ManifestEntry
+	{
+		uint64_t size;
+		uint64_t last_modified;
+		uint64_t content_hash;
+	};
+	std::unordered_map<std::string, ManifestEntry> files;
+	// Child names and types per directory; "" keys the root.
+	std::unordered_map<std::string, std::vector<ListEntry>> directories;
+
+	void parse();
+	void add_entry(const std::string &path, const ManifestEntry &entry);
+	static uint8_t read_u8(const uint8_t *&buf, size_t &size);
+	static uint64_t read_u64(const uint8_t *&buf, size_t &size);
+	static std::string read_string(const uint8_t *&buf, size_t &size, size_t len);
+};
+
 }
\ No newline at end of file
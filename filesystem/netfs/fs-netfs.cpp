@@ -23,8 +23,15 @@
 #include "fs-netfs.hpp"
 #include "../path.hpp"
 #include "logging.hpp"
+#include "string_helpers.hpp"
+#include "global_managers.hpp"
+#include "lz4.hpp"
+#include "hash.hpp"
 #include <queue>
+#include <unordered_set>
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #define HOST_IP "localhost"
 using namespace std;
@@ -60,7 +67,9 @@ struct FSNotifyCommand : LooperHandler
 			terminate();
 	}
 
-	void set_notify_cb(function<void (const FileNotifyInfo &)> func)
+	// The callback receives a span of decoded notifications; batched chunks
+	// from the server arrive as one call instead of one call per file.
+	void set_notify_cb(function<void (const FileNotifyInfo *, size_t)> func)
 	{
 		notify_cb = move(func);
 	}
@@ -104,26 +113,36 @@ struct FSNotifyCommand : LooperHandler
 		auto ret = command_reader.process(*socket);
 		if (command_reader.complete())
 		{
-			if (last_cmd == NETFS_BEGIN_CHUNK_NOTIFICATION)
+			if (last_cmd == NETFS_BEGIN_CHUNK_NOTIFICATION || last_cmd == NETFS_BEGIN_CHUNK_NOTIFICATION_BATCH)
 			{
-				FileNotifyInfo info;
-				info.path = result_reply.read_string();
-				info.handle = FileNotifyHandle(result_reply.read_u64());
-				auto type = result_reply.read_u32();
-				switch (type)
+				uint32_t count = 1;
+				if (last_cmd == NETFS_BEGIN_CHUNK_NOTIFICATION_BATCH)
+					count = result_reply.read_u32();
+
+				batch.clear();
+				batch.reserve(count);
+				for (uint32_t i = 0; i < count; i++)
 				{
-				case NETFS_FILE_CHANGED:
-					info.type = FileNotifyType::FileChanged;
-					break;
-				case NETFS_FILE_DELETED:
-					info.type = FileNotifyType::FileDeleted;
-					break;
-				case NETFS_FILE_CREATED:
-					info.type = FileNotifyType::FileCreated;
-					break;
+					FileNotifyInfo info;
+					info.path = result_reply.read_string();
+					info.handle = FileNotifyHandle(result_reply.read_u64());
+					auto type = result_reply.read_u32();
+					switch (type)
+					{
+					case NETFS_FILE_CHANGED:
+						info.type = FileNotifyType::FileChanged;
+						break;
+					case NETFS_FILE_DELETED:
+						info.type = FileNotifyType::FileDeleted;
+						break;
+					case NETFS_FILE_CREATED:
+						info.type = FileNotifyType::FileCreated;
+						break;
+					}
+					batch.push_back(move(info));
 				}
 
-				notify_cb(info);
+				notify_cb(batch.data(), batch.size());
 				result_reply.begin(4 * sizeof(uint32_t));
 				command_reader.start(result_reply.get_buffer());
 				modify_looper(looper);
@@ -187,7 +206,8 @@ struct FSNotifyCommand : LooperHandler
 			if (command_reader.complete())
 			{
 				auto cmd = result_reply.read_u32();
-				if (cmd == NETFS_BEGIN_CHUNK_NOTIFICATION || cmd == NETFS_BEGIN_CHUNK_REPLY)
+				if (cmd == NETFS_BEGIN_CHUNK_NOTIFICATION || cmd == NETFS_BEGIN_CHUNK_NOTIFICATION_BATCH ||
+				    cmd == NETFS_BEGIN_CHUNK_REPLY)
 				{
 					if (result_reply.read_u32() != NETFS_ERROR_OK)
 						return false;
@@ -262,7 +282,354 @@ struct FSNotifyCommand : LooperHandler
 	};
 	queue<NotificationReply> reply_queue;
 	queue<promise<FileNotifyHandle>> replies;
-	function<void (const FileNotifyInfo &info)> notify_cb;
+	function<void (const FileNotifyInfo *infos, size_t count)> notify_cb;
+	vector<FileNotifyInfo> batch;
+	atomic_bool expected;
+};
+
+// One persistent connection carrying any number of in-flight read/stat/
+// list-stat requests. Requests are written back to back and replies are
+// matched by request ID, so a batch of N small operations costs one
+// roundtrip instead of N connect + request-reply cycles.
+struct FSPipelineCommand : LooperHandler
+{
+	FSPipelineCommand(NetworkFilesystem &fs_, unique_ptr<Socket> socket_)
+		: LooperHandler(move(socket_)), fs(&fs_), expected(false)
+	{
+		reply_queue.emplace();
+		auto &reply = reply_queue.back();
+		reply.builder.add_u32(NETFS_PIPELINE);
+		reply.writer.start(reply.builder.get_buffer());
+
+		// Ask for LZ4 transport compression up front. Servers which do not
+		// support it fail the request and keep sending plain replies; either
+		// way replies are tagged per frame so no further handshake is needed.
+		if (!getenv("GRANITE_NETFS_DISABLE_COMPRESSION"))
+		{
+			reply_queue.emplace();
+			auto &nego = reply_queue.back();
+			nego.builder.add_u32(NETFS_SET_COMPRESSION);
+			nego.builder.add_u32(NETFS_BEGIN_CHUNK_REQUEST);
+			nego.builder.add_u64(8 + 4);
+			nego.builder.add_u64(next_request_id);
+			nego.builder.add_u32(NETFS_COMPRESSION_LZ4);
+			nego.writer.start(nego.builder.get_buffer());
+
+			PendingRequest request;
+			request.command = NETFS_SET_COMPRESSION;
+			pending_requests[next_request_id++] = move(request);
+		}
+
+		result_reply.begin(4 * sizeof(uint32_t));
+		command_reader.start(result_reply.get_buffer());
+		state = PipelineLoop;
+	}
+
+	void expected_destruction()
+	{
+		expected = true;
+	}
+
+	~FSPipelineCommand()
+	{
+		if (!expected)
+			terminate();
+		// Pending promises are broken on destruction, which fails the futures.
+	}
+
+	struct PendingRequest
+	{
+		uint32_t command = 0;
+		uint64_t known_hash = 0;
+		std::string path;
+		promise<vector<uint8_t>> read_result;
+		promise<FileStat> stat_result;
+		promise<vector<ListStatEntry>> list_stat_result;
+	};
+
+	// Called on the looper thread.
+	void push_request(const string &path, PendingRequest request)
+	{
+		if (reply_queue.empty() && socket->get_parent_looper())
+			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
+
+		uint64_t id = next_request_id++;
+		reply_queue.emplace();
+		auto &reply = reply_queue.back();
+		reply.builder.add_u32(request.command);
+		reply.builder.add_u32(NETFS_BEGIN_CHUNK_REQUEST);
+		if (request.command == NETFS_READ_FILE_CACHED)
+		{
+			reply.builder.add_u64(16 + path.size());
+			reply.builder.add_u64(id);
+			reply.builder.add_u64(request.known_hash);
+		}
+		else
+		{
+			reply.builder.add_u64(8 + path.size());
+			reply.builder.add_u64(id);
+		}
+		auto &buffer = reply.builder.get_buffer();
+		buffer.insert(end(buffer), reinterpret_cast<const uint8_t *>(path.data()),
+		              reinterpret_cast<const uint8_t *>(path.data()) + path.size());
+		reply.writer.start(reply.builder.get_buffer());
+
+		request.path = path;
+		pending_requests[id] = move(request);
+	}
+
+	void modify_looper(Looper &looper)
+	{
+		uint32_t mask = reply_queue.empty() ? EVENT_IN : (EVENT_IN | EVENT_OUT);
+		looper.modify_handler(mask, *this);
+	}
+
+	static PathType netfs_to_file_type(uint32_t type)
+	{
+		switch (type)
+		{
+		case NETFS_FILE_TYPE_DIRECTORY:
+			return PathType::Directory;
+		case NETFS_FILE_TYPE_SPECIAL:
+			return PathType::Special;
+		default:
+			return PathType::File;
+		}
+	}
+
+	void complete_request()
+	{
+		uint64_t id = result_reply.read_u64();
+		auto itr = pending_requests.find(id);
+		if (itr == end(pending_requests))
+			return;
+		auto request = move(itr->second);
+		pending_requests.erase(itr);
+
+		try
+		{
+			if (last_error != NETFS_ERROR_OK)
+			{
+				// Negotiation is fire and forget, the server just keeps
+				// sending plain replies.
+				if (request.command == NETFS_SET_COMPRESSION)
+					return;
+
+				auto e = make_exception_ptr(runtime_error("netfs pipeline request failed"));
+				if (request.command == NETFS_READ_FILE || request.command == NETFS_READ_FILE_CACHED)
+					request.read_result.set_exception(e);
+				else if (request.command == NETFS_STAT)
+					request.stat_result.set_exception(e);
+				else
+					request.list_stat_result.set_exception(e);
+				return;
+			}
+
+			switch (request.command)
+			{
+			case NETFS_READ_FILE:
+			{
+				auto buffer = result_reply.consume_buffer();
+				buffer.erase(begin(buffer), begin(buffer) + 8);
+				request.read_result.set_value(move(buffer));
+				break;
+			}
+
+			case NETFS_READ_FILE_CACHED:
+			{
+				uint64_t hash = result_reply.read_u64();
+				uint32_t cache_result = result_reply.read_u32();
+				if (cache_result == NETFS_CACHE_VALID)
+				{
+					vector<uint8_t> blob;
+					if (fs->load_cache_blob(hash, blob))
+					{
+						request.read_result.set_value(move(blob));
+					}
+					else
+					{
+						// The blob went missing from the cache directory.
+						// Drop the index entry and refetch with no known hash
+						// so the server sends content again.
+						fs->invalidate_cache_entry(request.path);
+						PendingRequest retry;
+						retry.command = NETFS_READ_FILE_CACHED;
+						retry.read_result = move(request.read_result);
+						push_request(request.path, move(retry));
+					}
+				}
+				else
+				{
+					auto buffer = result_reply.consume_buffer();
+					buffer.erase(begin(buffer), begin(buffer) + 20);
+					fs->update_cache_entry(request.path, hash, buffer.data(), buffer.size());
+					request.read_result.set_value(move(buffer));
+				}
+				break;
+			}
+
+			case NETFS_STAT:
+			{
+				FileStat s;
+				s.size = result_reply.read_u64();
+				s.type = netfs_to_file_type(result_reply.read_u32());
+				s.last_modified = result_reply.read_u64();
+				request.stat_result.set_value(s);
+				break;
+			}
+
+			case NETFS_SET_COMPRESSION:
+				break;
+
+			case NETFS_LIST_STAT:
+			{
+				uint32_t entries = result_reply.read_u32();
+				vector<ListStatEntry> list;
+				list.reserve(entries);
+				for (uint32_t i = 0; i < entries; i++)
+				{
+					ListStatEntry e;
+					e.entry.path = result_reply.read_string();
+					e.entry.type = netfs_to_file_type(result_reply.read_u32());
+					e.stat.size = result_reply.read_u64();
+					e.stat.last_modified = result_reply.read_u64();
+					e.stat.type = e.entry.type;
+					list.push_back(move(e));
+				}
+				request.list_stat_result.set_value(move(list));
+				break;
+			}
+			}
+		}
+		catch (...)
+		{
+		}
+	}
+
+	// Turns an LZ4 frame back into the plain payload layout so
+	// complete_request() can stay oblivious to transport compression.
+	bool decompress_reply()
+	{
+		auto &buf = result_reply.get_buffer();
+		if (buf.size() < 16)
+			return false;
+
+		result_reply.read_u64();
+		uint64_t raw_size = result_reply.read_u64();
+
+		ReplyBuilder plain;
+		plain.begin(8 + raw_size);
+		auto &out = plain.get_buffer();
+		// The request ID is not part of the compressed payload.
+		memcpy(out.data(), buf.data(), 8);
+		if (!Util::LZ4::decompress(out.data() + 8, raw_size, buf.data() + 16, buf.size() - 16))
+			return false;
+
+		result_reply = move(plain);
+		return true;
+	}
+
+	bool read_reply_data(Looper &looper)
+	{
+		auto ret = command_reader.process(*socket);
+		if (command_reader.complete())
+		{
+			if (reply_compressed && !decompress_reply())
+				return false;
+			complete_request();
+			result_reply.begin(4 * sizeof(uint32_t));
+			command_reader.start(result_reply.get_buffer());
+			modify_looper(looper);
+			state = PipelineLoop;
+			return true;
+		}
+
+		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+	}
+
+	bool pipeline_loop(Looper &looper, EventFlags flags)
+	{
+		if (flags & EVENT_OUT)
+		{
+			if (reply_queue.empty())
+			{
+				looper.modify_handler(EVENT_IN, *this);
+				return true;
+			}
+
+			auto ret = reply_queue.front().writer.process(*socket);
+			if (reply_queue.front().writer.complete())
+				reply_queue.pop();
+
+			if (reply_queue.empty())
+			{
+				looper.modify_handler(EVENT_IN, *this);
+				return true;
+			}
+			else
+				return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+		}
+
+		if (flags & EVENT_IN)
+		{
+			auto ret = command_reader.process(*socket);
+			if (command_reader.complete())
+			{
+				auto tag = result_reply.read_u32();
+				if (tag != NETFS_BEGIN_CHUNK_REPLY && tag != NETFS_BEGIN_CHUNK_REPLY_LZ4)
+					return false;
+				reply_compressed = tag == NETFS_BEGIN_CHUNK_REPLY_LZ4;
+
+				last_error = result_reply.read_u32();
+				auto size = result_reply.read_u64();
+				// Replies always carry the request ID.
+				if (size < 8)
+					return false;
+
+				result_reply.begin(size);
+				command_reader.start(result_reply.get_buffer());
+				state = ReadReplyData;
+				looper.modify_handler(EVENT_IN, *this);
+				return true;
+			}
+
+			return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+		}
+
+		return true;
+	}
+
+	bool handle(Looper &looper, EventFlags flags) override
+	{
+		if (state == ReadReplyData)
+			return read_reply_data(looper);
+		else if (state == PipelineLoop)
+			return pipeline_loop(looper, flags);
+		else
+			return false;
+	}
+
+	enum State
+	{
+		ReadReplyData,
+		PipelineLoop
+	};
+
+	State state = PipelineLoop;
+	SocketReader command_reader;
+	ReplyBuilder result_reply;
+	uint32_t last_error = NETFS_ERROR_OK;
+	bool reply_compressed = false;
+
+	struct PipelineWrite
+	{
+		SocketWriter writer;
+		ReplyBuilder builder;
+	};
+	queue<PipelineWrite> reply_queue;
+	unordered_map<uint64_t, PendingRequest> pending_requests;
+	uint64_t next_request_id = 1;
+	NetworkFilesystem *fs;
 	atomic_bool expected;
 };
 
@@ -610,8 +977,8 @@ void NetworkFilesystem::setup_notification()
 	if (!socket)
 		return;
 	notify = new FSNotifyCommand(protocol, move(socket));
-	notify->set_notify_cb([this](const FileNotifyInfo &info) {
-		signal_notification(info);
+	notify->set_notify_cb([this](const FileNotifyInfo *infos, size_t count) {
+		signal_notification(infos, count);
 	});
 
 	// Move capture would be nice ...
@@ -620,6 +987,93 @@ void NetworkFilesystem::setup_notification()
 	});
 }
 
+void NetworkFilesystem::setup_pipeline()
+{
+	auto socket = Socket::connect(HOST_IP, 7070);
+	if (!socket)
+		return;
+	pipeline = new FSPipelineCommand(*this, move(socket));
+
+	looper.run_in_looper([this]() {
+		looper.register_handler(EVENT_OUT, unique_ptr<FSPipelineCommand>(pipeline));
+	});
+}
+
+future<vector<uint8_t>> NetworkFilesystem::pipelined_read(const string &joined_path)
+{
+	if (!pipeline)
+		setup_pipeline();
+	if (!pipeline)
+		return {};
+
+	auto *request = new FSPipelineCommand::PendingRequest;
+	if (cache_backend())
+	{
+		request->command = NETFS_READ_FILE_CACHED;
+		request->known_hash = cached_hash_for_path(joined_path);
+	}
+	else
+		request->command = NETFS_READ_FILE;
+	auto fut = request->read_result.get_future();
+
+	looper.run_in_looper([this, request, joined_path]() {
+		pipeline->push_request(joined_path, move(*request));
+		delete request;
+	});
+	return fut;
+}
+
+future<FileStat> NetworkFilesystem::pipelined_stat(const string &joined_path)
+{
+	if (!pipeline)
+		setup_pipeline();
+	if (!pipeline)
+		return {};
+
+	auto *request = new FSPipelineCommand::PendingRequest;
+	request->command = NETFS_STAT;
+	auto fut = request->stat_result.get_future();
+
+	looper.run_in_looper([this, request, joined_path]() {
+		pipeline->push_request(joined_path, move(*request));
+		delete request;
+	});
+	return fut;
+}
+
+future<vector<ListStatEntry>> NetworkFilesystem::pipelined_list_stat(const string &joined_path)
+{
+	if (!pipeline)
+		setup_pipeline();
+	if (!pipeline)
+		return {};
+
+	auto *request = new FSPipelineCommand::PendingRequest;
+	request->command = NETFS_LIST_STAT;
+	auto fut = request->list_stat_result.get_future();
+
+	looper.run_in_looper([this, request, joined_path]() {
+		pipeline->push_request(joined_path, move(*request));
+		delete request;
+	});
+	return fut;
+}
+
+future<vector<uint8_t>> NetworkFilesystem::read_file_pipelined(const string &path)
+{
+	return pipelined_read(protocol + "://" + path);
+}
+
+future<FileStat> NetworkFilesystem::stat_pipelined(const string &path)
+{
+	return pipelined_stat(protocol + "://" + path);
+}
+
+future<vector<ListStatEntry>> NetworkFilesystem::list_stat_pipelined(const string &path)
+{
+	return pipelined_list_stat(protocol + "://" + path);
+}
+
 void NetworkFilesystem::uninstall_notification(FileNotifyHandle handle)
 {
 	if (!notify)
@@ -648,10 +1102,149 @@ void NetworkFilesystem::uninstall_notification(FileNotifyHandle handle)
 	}
 }
 
-void NetworkFilesystem::signal_notification(const FileNotifyInfo &info)
+void NetworkFilesystem::signal_notification(const FileNotifyInfo *infos, size_t count)
 {
+	// A change on the server makes our cached blobs for the paths stale.
+	for (size_t i = 0; i < count; i++)
+		invalidate_cache_entry(infos[i].path);
+
 	lock_guard<mutex> holder{lock};
-	pending.push_back(info);
+	pending.insert(end(pending), infos, infos + count);
+}
+
+static string cache_blob_path(uint64_t hash)
+{
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+	return string("netfs-") + hex + ".blob";
+}
+
+FilesystemBackend *NetworkFilesystem::cache_backend()
+{
+	auto *backend = Global::filesystem()->get_backend("cache");
+	// The cache protocol can itself be backed by netfs (e.g. on Android),
+	// never try to cache through ourselves.
+	if (!backend || dynamic_cast<NetworkFilesystem *>(backend))
+		return nullptr;
+	return backend;
+}
+
+// Must hold cache_lock.
+void NetworkFilesystem::load_cache_index()
+{
+	if (cache_index_loaded)
+		return;
+	cache_index_loaded = true;
+
+	auto *backend = cache_backend();
+	if (!backend)
+		return;
+
+	auto file = backend->open("netfs-" + protocol + ".index");
+	auto *mapped = file ? static_cast<const char *>(file->map()) : nullptr;
+	if (!mapped)
+		return;
+
+	// One "<hex hash> <path>" line per entry.
+	auto lines = Util::split_no_empty(string(mapped, mapped + file->get_size()), "\n");
+	for (auto &line : lines)
+	{
+		auto sep = line.find(' ');
+		if (sep == string::npos)
+			continue;
+		cache_index[line.substr(sep + 1)] = strtoull(line.c_str(), nullptr, 16);
+	}
+	file->unmap();
+}
+
+// Must hold cache_lock. Written through on every mutation so the index
+// survives crashes without relying on teardown order.
+void NetworkFilesystem::save_cache_index()
+{
+	auto *backend = cache_backend();
+	if (!backend)
+		return;
+
+	string index;
+	for (auto &entry : cache_index)
+	{
+		char hex[17];
+		snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(entry.second));
+		index += hex;
+		index += ' ';
+		index += entry.first;
+		index += '\n';
+	}
+
+	auto file = backend->open("netfs-" + protocol + ".index", FileMode::WriteOnly);
+	void *mapped = file ? file->map_write(index.size()) : nullptr;
+	if (!mapped && !index.empty())
+	{
+		LOGE("Failed to write netfs cache index.\n");
+		return;
+	}
+	if (!index.empty())
+		memcpy(mapped, index.data(), index.size());
+	file->unmap();
+}
+
+uint64_t NetworkFilesystem::cached_hash_for_path(const string &joined_path)
+{
+	lock_guard<mutex> holder{cache_lock};
+	load_cache_index();
+	auto itr = cache_index.find(joined_path);
+	return itr != end(cache_index) ? itr->second : 0;
+}
+
+void NetworkFilesystem::update_cache_entry(const string &joined_path, uint64_t hash, const void *data, size_t size)
+{
+	auto *backend = cache_backend();
+	if (!backend)
+		return;
+
+	auto file = backend->open(cache_blob_path(hash), FileMode::WriteOnly);
+	void *mapped = file ? file->map_write(size) : nullptr;
+	if (!mapped && size != 0)
+	{
+		LOGE("Failed to write netfs cache blob.\n");
+		return;
+	}
+	if (size)
+		memcpy(mapped, data, size);
+	file->unmap();
+
+	lock_guard<mutex> holder{cache_lock};
+	load_cache_index();
+	cache_index[joined_path] = hash;
+	save_cache_index();
+}
+
+bool NetworkFilesystem::load_cache_blob(uint64_t hash, vector<uint8_t> &blob)
+{
+	auto *backend = cache_backend();
+	if (!backend || !hash)
+		return false;
+
+	auto file = backend->open(cache_blob_path(hash));
+	if (!file)
+		return false;
+
+	auto *mapped = static_cast<const uint8_t *>(file->map());
+	size_t size = file->get_size();
+	if (!mapped && size != 0)
+		return false;
+
+	blob.assign(mapped, mapped + size);
+	file->unmap();
+	return true;
+}
+
+void NetworkFilesystem::invalidate_cache_entry(const string &joined_path)
+{
+	lock_guard<mutex> holder{cache_lock};
+	load_cache_index();
+	if (cache_index.erase(joined_path))
+		save_cache_index();
 }
 
 void NetworkFilesystem::poll_notifications()
@@ -662,8 +1255,24 @@ void NetworkFilesystem::poll_notifications()
 		swap(tmp_pending, pending);
 	}
 
+	// Bulk saves deliver the same (path, handle, type) many times within one
+	// poll window; the handlers typically reload the file, so dispatch each
+	// distinct notification once, in arrival order.
+	unordered_set<Util::Hash> seen;
+	bool dedup = tmp_pending.size() > 1;
+
 	for (auto &notification : tmp_pending)
 	{
+		if (dedup)
+		{
+			Util::Hasher h;
+			h.string(notification.path);
+			h.s32(notification.handle);
+			h.u32(uint32_t(notification.type));
+			if (!seen.insert(h.get()).second)
+				continue;
+		}
+
 		auto &func = handlers[notification.handle];
 		if (func)
 			func(notification);
@@ -727,10 +1336,10 @@ NetworkFile::~NetworkFile()
 	unmap();
 }
 
-NetworkFile *NetworkFile::open(Granite::Looper &looper, const std::string &path, Granite::FileMode mode)
+NetworkFile *NetworkFile::open(NetworkFilesystem &fs, const std::string &path, Granite::FileMode mode)
 {
 	auto *file = new NetworkFile;
-	if (!file->init(looper, path, mode))
+	if (!file->init(fs, path, mode))
 	{
 		delete file;
 		return nullptr;
@@ -739,11 +1348,11 @@ NetworkFile *NetworkFile::open(Granite::Looper &looper, const std::string &path,
 		return file;
 }
 
-bool NetworkFile::init(Looper &looper_, const std::string &path_, FileMode mode_)
+bool NetworkFile::init(NetworkFilesystem &fs_, const std::string &path_, FileMode mode_)
 {
 	path = path_;
 	mode = mode_;
-	looper = &looper_;
+	fs = &fs_;
 
 	if (mode == FileMode::ReadWrite)
 	{
@@ -774,8 +1383,8 @@ void NetworkFile::unmap()
 
 		auto handler = unique_ptr<FSWriteCommand>(new FSWriteCommand(path, buffer, move(socket)));
 		auto reply = handler->result.get_future();
-		looper->run_in_looper([&handler, this]() {
-			looper->register_handler(EVENT_OUT | EVENT_IN, move(handler));
+		fs->looper.run_in_looper([&handler, this]() {
+			fs->looper.register_handler(EVENT_OUT | EVENT_IN, move(handler));
 		});
 
 		try
@@ -796,6 +1405,14 @@ bool NetworkFile::reopen()
 	if (mode == FileMode::ReadOnly)
 	{
 		has_buffer = false;
+
+		// Reads go over the pipelined connection so opening many files up
+		// front batches their roundtrips; map() blocks on the future later.
+		future = fs->pipelined_read(path);
+		if (future.valid())
+			return true;
+
+		// Fall back to one connection per request for old servers.
 		auto socket = Socket::connect(HOST_IP, 7070);
 		if (!socket)
 			return false;
@@ -804,8 +1421,8 @@ bool NetworkFile::reopen()
 		future = handler->result.get_future();
 
 		// Capture-by-move would be nice here.
-		looper->run_in_looper([handler, this]() {
-			looper->register_handler(EVENT_OUT, unique_ptr<FSReader>(handler));
+		fs->looper.run_in_looper([handler, this]() {
+			fs->looper.register_handler(EVENT_OUT, unique_ptr<FSReader>(handler));
 		});
 	}
 	return true;
@@ -856,18 +1473,33 @@ size_t NetworkFile::get_size()
 unique_ptr<File> NetworkFilesystem::open(const std::string &path, FileMode mode)
 {
 	auto joined = protocol + "://" + path;
-	return unique_ptr<File>(NetworkFile::open(looper, move(joined), mode));
+	return unique_ptr<File>(NetworkFile::open(*this, move(joined), mode));
 }
 
 bool NetworkFilesystem::stat(const std::string &path, FileStat &stat)
 {
 	auto joined = protocol + "://" + path;
+
+	auto fut = pipelined_stat(joined);
+	if (fut.valid())
+	{
+		try
+		{
+			stat = fut.get();
+			return true;
+		}
+		catch (...)
+		{
+			return false;
+		}
+	}
+
 	auto socket = Socket::connect(HOST_IP, 7070);
 	if (!socket)
 		return false;
 
 	unique_ptr<FSStat> handler(new FSStat(joined, move(socket)));
-	auto fut = handler->result.get_future();
+	auto legacy_fut = handler->result.get_future();
 
 	looper.run_in_looper([&]() {
 		looper.register_handler(EVENT_OUT, move(handler));
@@ -875,7 +1507,7 @@ bool NetworkFilesystem::stat(const std::string &path, FileStat &stat)
 
 	try
 	{
-		stat = fut.get();
+		stat = legacy_fut.get();
 		return true;
 	}
 	catch (...)
@@ -888,6 +1520,8 @@ NetworkFilesystem::~NetworkFilesystem()
 {
 	if (notify)
 		notify->expected_destruction();
+	if (pipeline)
+		pipeline->expected_destruction();
 
 	looper.kill();
 	if (looper_thread.joinable())
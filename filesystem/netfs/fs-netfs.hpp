@@ -32,10 +32,20 @@
 namespace Granite
 {
 struct FSReader;
+class NetworkFilesystem;
+
+// Directory entry together with its stat, from the combined
+// readdir-with-stat request.
+struct ListStatEntry
+{
+	ListEntry entry;
+	FileStat stat;
+};
+
 class NetworkFile : public File
 {
 public:
-	static NetworkFile *open(Looper &looper, const std::string &path, FileMode mode);
+	static NetworkFile *open(NetworkFilesystem &fs, const std::string &path, FileMode mode);
 	~NetworkFile();
 	void *map() override;
 	void *map_write(size_t size) override;
@@ -45,10 +55,10 @@ public:
 
 private:
 	NetworkFile() = default;
-	bool init(Looper &looper, const std::string &path, FileMode mode);
+	bool init(NetworkFilesystem &fs, const std::string &path, FileMode mode);
 	std::string path;
 	FileMode mode;
-	Looper *looper = nullptr;
+	NetworkFilesystem *fs = nullptr;
 	std::future<std::vector<uint8_t>> future;
 	std::vector<uint8_t> buffer;
 	bool has_buffer = false;
@@ -56,6 +66,7 @@ private:
 };
 
 struct FSNotifyCommand;
+struct FSPipelineCommand;
 class NetworkFilesystem : public FilesystemBackend
 {
 public:
@@ -65,6 +76,14 @@ public:
 	std::unique_ptr<File> open(const std::string &path, FileMode mode) override;
 	bool stat(const std::string &path, FileStat &stat) override;
 
+	// Pipelined requests, multiplexed over one persistent connection with
+	// reply matching by request ID. Submitting a batch of reads/stats before
+	// waiting for any of them costs one network roundtrip rather than N.
+	// Returns an invalid future if the pipelined connection cannot be made.
+	std::future<std::vector<uint8_t>> read_file_pipelined(const std::string &path);
+	std::future<FileStat> stat_pipelined(const std::string &path);
+	std::future<std::vector<ListStatEntry>> list_stat_pipelined(const std::string &path);
+
 	FileNotifyHandle install_notification(const std::string &path, std::function<void (const FileNotifyInfo &)> func) override;
 
 	void uninstall_notification(FileNotifyHandle handle) override;
@@ -77,16 +96,42 @@ public:
 	}
 
 private:
+	friend class NetworkFile;
+	friend struct FSPipelineCommand;
 	std::thread looper_thread;
 	Looper looper;
 	void looper_entry();
 	FSNotifyCommand *notify = nullptr;
+	FSPipelineCommand *pipeline = nullptr;
+	void setup_pipeline();
+	std::future<std::vector<uint8_t>> pipelined_read(const std::string &joined_path);
+	std::future<FileStat> pipelined_stat(const std::string &joined_path);
+	std::future<std::vector<ListStatEntry>> pipelined_list_stat(const std::string &joined_path);
 
 	std::unordered_map<FileNotifyHandle, std::function<void (const FileNotifyInfo &)>> handlers;
 	std::mutex lock;
 	std::vector<FileNotifyInfo> pending;
 
 	void setup_notification();
-	void signal_notification(const FileNotifyInfo &info);
+	// Receives decoded notification spans from the looper thread; batched
+	// chunks from the server land here as one call and one lock acquisition.
+	void signal_notification(const FileNotifyInfo *infos, size_t count);
+
+	// Content-addressed local cache for pipelined reads, stored under the
+	// cache:// protocol. Blobs are keyed by content hash and the path -> hash
+	// index is revalidated against the server on every read, so a warm start
+	// only transfers files which actually changed. Change notifications from
+	// the server drop the affected index entries.
+	FilesystemBackend *cache_backend();
+	uint64_t cached_hash_for_path(const std::string &joined_path);
+	void update_cache_entry(const std::string &joined_path, uint64_t hash, const void *data, size_t size);
+	bool load_cache_blob(uint64_t hash, std::vector<uint8_t> &blob);
+	void invalidate_cache_entry(const std::string &joined_path);
+	void load_cache_index();
+	void save_cache_index();
+
+	std::mutex cache_lock;
+	std::unordered_map<std::string, uint64_t> cache_index;
+	bool cache_index_loaded = false;
 };
 }
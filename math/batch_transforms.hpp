@@ -0,0 +1,223 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "simd.hpp"
+
+// Batch variants of the hot transform operations in simd.hpp.
+// muglm itself stays scalar and portable; callers which have arrays of
+// transforms (bone hierarchies, skinning palettes, per-instance AABBs)
+// should convert to these array forms once and stay there rather than
+// calling the single-element operations in a loop.
+
+namespace Granite
+{
+namespace SIMD
+{
+// c[i] = a[i] * b[i]. With AVX available two columns are computed per
+// 256-bit op, otherwise this falls back to the 128-bit path per matrix.
+static inline void mul_batch(mat4 *c, const mat4 *a, const mat4 *b, size_t count)
+{
+#if defined(__AVX__)
+	for (size_t i = 0; i < count; i++)
+	{
+		__m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a[i][0].data));
+		__m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a[i][1].data));
+		__m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a[i][2].data));
+		__m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a[i][3].data));
+
+		// Columns 0/1 in the low/high lanes, then columns 2/3.
+		__m256 b01 = _mm256_loadu_ps(b[i][0].data);
+		__m256 b23 = _mm256_loadu_ps(b[i][2].data);
+
+		__m256 c01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55)));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a2, _mm256_shuffle_ps(b01, b01, 0xaa)));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, 0xff)));
+
+		__m256 c23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, 0x00));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a1, _mm256_shuffle_ps(b23, b23, 0x55)));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a2, _mm256_shuffle_ps(b23, b23, 0xaa)));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a3, _mm256_shuffle_ps(b23, b23, 0xff)));
+
+		_mm256_storeu_ps(c[i][0].data, c01);
+		_mm256_storeu_ps(c[i][2].data, c23);
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		mul(c[i], a[i], b[i]);
+#endif
+}
+
+// c[i] = a * b[i]. The shared left matrix stays resident in registers,
+// which is the skinning palette case (world * inverse_bind[i]).
+static inline void mul_batch(mat4 *c, const mat4 &a, const mat4 *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		mul(c[i], a, b[i]);
+}
+
+// output[i] = transform of aabb[i] by m[i].
+static inline void transform_aabb_batch(AABB *output, const AABB *aabb, const mat4 *m, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		transform_aabb(output[i], aabb[i], m[i]);
+}
+
+// output[i] = transform of aabb[i] by the shared matrix m.
+static inline void transform_aabb_batch(AABB *output, const AABB *aabb, const mat4 &m, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		transform_aabb(output[i], aabb[i], m);
+}
+
+// Batched muglm::mat4_cast over SoA quaternion components.
+// Four quaternions are converted per iteration; the nine rotation elements
+// are computed in SoA form and transposed into column-major mat4s on store.
+// Matches mat3_cast in muglm.cpp element for element.
+static inline void mat4_cast_batch(mat4 *out,
+                                   const float *qx, const float *qy, const float *qz, const float *qw,
+                                   size_t count)
+{
+	size_t i = 0;
+
+#if defined(__SSE__)
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 col3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(qx + i);
+		__m128 y = _mm_loadu_ps(qy + i);
+		__m128 z = _mm_loadu_ps(qz + i);
+		__m128 w = _mm_loadu_ps(qw + i);
+
+		__m128 xx = _mm_mul_ps(x, x);
+		__m128 yy = _mm_mul_ps(y, y);
+		__m128 zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y);
+		__m128 xz = _mm_mul_ps(x, z);
+		__m128 yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x);
+		__m128 wy = _mm_mul_ps(w, y);
+		__m128 wz = _mm_mul_ps(w, z);
+
+		__m128 m00 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+		__m128 m01 = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+		__m128 m02 = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+		__m128 m10 = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+		__m128 m11 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+		__m128 m12 = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+		__m128 m20 = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+		__m128 m21 = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+		__m128 m22 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+#define STORE_COLUMN(col, e0, e1, e2) \
+	do \
+	{ \
+		__m128 r0 = e0, r1 = e1, r2 = e2, r3 = zero; \
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3); \
+		_mm_storeu_ps(out[i + 0][col].data, r0); \
+		_mm_storeu_ps(out[i + 1][col].data, r1); \
+		_mm_storeu_ps(out[i + 2][col].data, r2); \
+		_mm_storeu_ps(out[i + 3][col].data, r3); \
+	} while (0)
+		STORE_COLUMN(0, m00, m01, m02);
+		STORE_COLUMN(1, m10, m11, m12);
+		STORE_COLUMN(2, m20, m21, m22);
+#undef STORE_COLUMN
+
+		_mm_storeu_ps(out[i + 0][3].data, col3);
+		_mm_storeu_ps(out[i + 1][3].data, col3);
+		_mm_storeu_ps(out[i + 2][3].data, col3);
+		_mm_storeu_ps(out[i + 3][3].data, col3);
+	}
+#elif defined(__ARM_NEON)
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t two = vdupq_n_f32(2.0f);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	static const float col3_data[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float32x4_t col3 = vld1q_f32(col3_data);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t x = vld1q_f32(qx + i);
+		float32x4_t y = vld1q_f32(qy + i);
+		float32x4_t z = vld1q_f32(qz + i);
+		float32x4_t w = vld1q_f32(qw + i);
+
+		float32x4_t xx = vmulq_f32(x, x);
+		float32x4_t yy = vmulq_f32(y, y);
+		float32x4_t zz = vmulq_f32(z, z);
+		float32x4_t xy = vmulq_f32(x, y);
+		float32x4_t xz = vmulq_f32(x, z);
+		float32x4_t yz = vmulq_f32(y, z);
+		float32x4_t wx = vmulq_f32(w, x);
+		float32x4_t wy = vmulq_f32(w, y);
+		float32x4_t wz = vmulq_f32(w, z);
+
+		float32x4_t m00 = vsubq_f32(one, vmulq_f32(two, vaddq_f32(yy, zz)));
+		float32x4_t m01 = vmulq_f32(two, vaddq_f32(xy, wz));
+		float32x4_t m02 = vmulq_f32(two, vsubq_f32(xz, wy));
+		float32x4_t m10 = vmulq_f32(two, vsubq_f32(xy, wz));
+		float32x4_t m11 = vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, zz)));
+		float32x4_t m12 = vmulq_f32(two, vaddq_f32(yz, wx));
+		float32x4_t m20 = vmulq_f32(two, vaddq_f32(xz, wy));
+		float32x4_t m21 = vmulq_f32(two, vsubq_f32(yz, wx));
+		float32x4_t m22 = vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, yy)));
+
+#define STORE_COLUMN(col, e0, e1, e2) \
+	do \
+	{ \
+		float32x4x2_t t01 = vtrnq_f32(e0, e1); \
+		float32x4x2_t t23 = vtrnq_f32(e2, zero); \
+		vst1q_f32(out[i + 0][col].data, vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]))); \
+		vst1q_f32(out[i + 1][col].data, vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]))); \
+		vst1q_f32(out[i + 2][col].data, vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]))); \
+		vst1q_f32(out[i + 3][col].data, vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]))); \
+	} while (0)
+		STORE_COLUMN(0, m00, m01, m02);
+		STORE_COLUMN(1, m10, m11, m12);
+		STORE_COLUMN(2, m20, m21, m22);
+#undef STORE_COLUMN
+
+		vst1q_f32(out[i + 0][3].data, col3);
+		vst1q_f32(out[i + 1][3].data, col3);
+		vst1q_f32(out[i + 2][3].data, col3);
+		vst1q_f32(out[i + 3][3].data, col3);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+		out[i] = mat4(vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f),
+		              vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f),
+		              vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f),
+		              vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+}
+}
+}
@@ -21,6 +21,7 @@
  */
 
 #include "frustum.hpp"
+#include "simd.hpp"
 
 namespace Granite
 {
@@ -58,6 +59,17 @@ bool Frustum::intersects_fast(const AABB &aabb) const
 	return true;
 }
 
+void Frustum::intersects_soa(uint32_t *visibility,
+                             const float *center_x, const float *center_y, const float *center_z,
+                             const float *extent_x, const float *extent_y, const float *extent_z,
+                             size_t count) const
+{
+	SIMD::frustum_cull_soa(visibility,
+	                       center_x, center_y, center_z,
+	                       extent_x, extent_y, extent_z,
+	                       count, planes);
+}
+
 vec3 Frustum::get_coord(float dx, float dy, float dz) const
 {
 	vec4 clip = vec4(2.0f * dx - 1.0f, 2.0f * dy - 1.0f, dz, 1.0f);
@@ -97,6 +109,14 @@ vec4 Frustum::get_bounding_sphere(const mat4 &inv_projection, const mat4 &inv_vi
 	return vec4(center, radius);
 }
 
+void Frustum::expand(float distance)
+{
+	// Planes store normalized normals with positive halfspace inside,
+	// so pushing a plane outward is just biasing the w term.
+	for (auto &p : planes)
+		p.w += distance;
+}
+
 void Frustum::build_planes(const mat4 &inv_view_projection_)
 {
 	inv_view_projection = inv_view_projection_;
@@ -31,9 +31,20 @@ class Frustum
 {
 public:
 	void build_planes(const mat4& inv_view_projection);
+
+	// Pushes each plane outward by distance, making culling conservative.
+	// Used for predicted frustums where the camera may move slightly after culling.
+	void expand(float distance);
 	bool intersects(const AABB &aabb) const;
 	bool intersects_fast(const AABB &aabb) const;
 
+	// Batched cull over SoA center/half-extent arrays.
+	// Writes one bit per box, see SIMD::frustum_cull_soa.
+	void intersects_soa(uint32_t *visibility,
+	                    const float *center_x, const float *center_y, const float *center_z,
+	                    const float *extent_x, const float *extent_y, const float *extent_z,
+	                    size_t count) const;
+
 	vec3 get_coord(float dx, float dy, float dz) const;
 
 	static vec4 get_bounding_sphere(const mat4 &inv_projection, const mat4 &inv_view);
@@ -118,6 +118,11 @@ struct ClustererParametersBindless
 	uint32_t num_lights_32;
 	uint32_t z_max_index;
 	float z_scale;
+
+	uint32_t num_decals;
+	uint32_t num_decals_32;
+	uint32_t num_probes;
+	uint32_t num_probes_32;
 };
 
 #define CLUSTERER_MAX_LIGHTS_BINDLESS 4096
@@ -129,6 +134,14 @@ struct ClustererBindlessTransforms
 	uint32_t type_mask[CLUSTERER_MAX_LIGHTS_BINDLESS / 32];
 };
 
+#define CLUSTERER_MAX_DECALS_BINDLESS 256
+#define CLUSTERER_MAX_PROBES_BINDLESS 128
+struct ClustererBindlessVolumes
+{
+	ClusteredDecalInfo decals[CLUSTERER_MAX_DECALS_BINDLESS];
+	ClusteredProbeInfo probes[CLUSTERER_MAX_PROBES_BINDLESS];
+};
+
 struct CombinedRenderParameters
 {
 	FogParameters fog;
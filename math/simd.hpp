@@ -103,6 +103,129 @@ static inline bool frustum_cull(const AABB &aabb, const vec4 *planes)
 #endif
 }
 
+// Batched variant of frustum_cull. Takes SoA arrays of AABB centers and half-extents
+// and writes one visibility bit per box to the bitmask (bit (i & 31) of visibility[i >> 5]).
+// A box is visible if dot(plane.xyz, center) + dot(abs(plane.xyz), extent) + plane.w >= 0
+// for all six planes, which matches the corner test in frustum_cull.
+// The arrays do not need any particular alignment.
+static inline void frustum_cull_soa(uint32_t *visibility,
+                                    const float *center_x, const float *center_y, const float *center_z,
+                                    const float *extent_x, const float *extent_y, const float *extent_z,
+                                    size_t count, const vec4 *planes)
+{
+	size_t num_words = (count + 31) / 32;
+	for (size_t word = 0; word < num_words; word++)
+		visibility[word] = 0;
+
+	size_t i = 0;
+
+#if defined(__SSE__)
+	__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	__m128 abs_x[6], abs_y[6], abs_z[6];
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	for (unsigned p = 0; p < 6; p++)
+	{
+		plane_x[p] = _mm_set1_ps(planes[p].x);
+		plane_y[p] = _mm_set1_ps(planes[p].y);
+		plane_z[p] = _mm_set1_ps(planes[p].z);
+		plane_w[p] = _mm_set1_ps(planes[p].w);
+		abs_x[p] = _mm_andnot_ps(sign_mask, plane_x[p]);
+		abs_y[p] = _mm_andnot_ps(sign_mask, plane_y[p]);
+		abs_z[p] = _mm_andnot_ps(sign_mask, plane_z[p]);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(center_x + i);
+		__m128 cy = _mm_loadu_ps(center_y + i);
+		__m128 cz = _mm_loadu_ps(center_z + i);
+		__m128 ex = _mm_loadu_ps(extent_x + i);
+		__m128 ey = _mm_loadu_ps(extent_y + i);
+		__m128 ez = _mm_loadu_ps(extent_z + i);
+
+		__m128 inside = _mm_cmpeq_ps(cx, cx);
+		for (unsigned p = 0; p < 6; p++)
+		{
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], cx), _mm_mul_ps(plane_y[p], cy)),
+			                         _mm_add_ps(_mm_mul_ps(plane_z[p], cz), plane_w[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_x[p], ex), _mm_mul_ps(abs_y[p], ey)),
+			                           _mm_mul_ps(abs_z[p], ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+		}
+
+		visibility[i >> 5] |= uint32_t(_mm_movemask_ps(inside)) << (i & 31);
+	}
+#elif defined(__ARM_NEON)
+	float32x4_t plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	float32x4_t abs_x[6], abs_y[6], abs_z[6];
+	for (unsigned p = 0; p < 6; p++)
+	{
+		plane_x[p] = vdupq_n_f32(planes[p].x);
+		plane_y[p] = vdupq_n_f32(planes[p].y);
+		plane_z[p] = vdupq_n_f32(planes[p].z);
+		plane_w[p] = vdupq_n_f32(planes[p].w);
+		abs_x[p] = vabsq_f32(plane_x[p]);
+		abs_y[p] = vabsq_f32(plane_y[p]);
+		abs_z[p] = vabsq_f32(plane_z[p]);
+	}
+
+	static const uint32_t lane_bit_data[4] = { 1u, 2u, 4u, 8u };
+	uint32x4_t lane_bits = vld1q_u32(lane_bit_data);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t cx = vld1q_f32(center_x + i);
+		float32x4_t cy = vld1q_f32(center_y + i);
+		float32x4_t cz = vld1q_f32(center_z + i);
+		float32x4_t ex = vld1q_f32(extent_x + i);
+		float32x4_t ey = vld1q_f32(extent_y + i);
+		float32x4_t ez = vld1q_f32(extent_z + i);
+
+		uint32x4_t inside = vdupq_n_u32(~0u);
+		for (unsigned p = 0; p < 6; p++)
+		{
+			float32x4_t dist = vmlaq_f32(plane_w[p], plane_x[p], cx);
+			dist = vmlaq_f32(dist, plane_y[p], cy);
+			dist = vmlaq_f32(dist, plane_z[p], cz);
+			dist = vmlaq_f32(dist, abs_x[p], ex);
+			dist = vmlaq_f32(dist, abs_y[p], ey);
+			dist = vmlaq_f32(dist, abs_z[p], ez);
+			inside = vandq_u32(inside, vcgeq_f32(dist, vdupq_n_f32(0.0f)));
+		}
+
+		uint32x4_t bits = vandq_u32(inside, lane_bits);
+#if defined(__aarch64__)
+		uint32_t mask = vaddvq_u32(bits);
+#else
+		uint32x2_t merged = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+		merged = vpadd_u32(merged, merged);
+		uint32_t mask = vget_lane_u32(merged, 0);
+#endif
+		visibility[i >> 5] |= mask << (i & 31);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		bool inside = true;
+		for (unsigned p = 0; p < 6; p++)
+		{
+			float dist = planes[p].x * center_x[i] + planes[p].y * center_y[i] + planes[p].z * center_z[i] + planes[p].w;
+			float radius = muglm::abs(planes[p].x) * extent_x[i] +
+			               muglm::abs(planes[p].y) * extent_y[i] +
+			               muglm::abs(planes[p].z) * extent_z[i];
+			if (dist + radius < 0.0f)
+			{
+				inside = false;
+				break;
+			}
+		}
+
+		if (inside)
+			visibility[i >> 5] |= 1u << (i & 31);
+	}
+}
+
 static inline void mul(vec4 &c, const mat4 &a, const vec4 &b)
 {
 #if defined(__SSE__)
@@ -100,13 +100,14 @@ bool compute_plane_refraction(mat4 &projection, mat4 &view, vec3 camera_pos, vec
 
 void compute_model_transform(mat4 &world, vec3 s, quat rot, vec3 trans, const mat4 &parent)
 {
-	mat4 S = scale(s);
-	mat4 R = mat4_cast(rot);
-	mat4 T = translate(trans);
-
-	mat4 model;
-	SIMD::mul(model, R, S);
-	SIMD::mul(model, T, model);
+	// Fold T * R * S directly by scaling the rotation columns and setting
+	// the translation column. Only one full multiply against the parent
+	// remains, which matters for deep bone hierarchies.
+	mat3 R = mat3_cast(rot);
+	mat4 model(vec4(R[0] * s.x, 0.0f),
+	           vec4(R[1] * s.y, 0.0f),
+	           vec4(R[2] * s.z, 0.0f),
+	           vec4(trans, 1.0f));
 	SIMD::mul(world, parent, model);
 }
 
@@ -133,6 +133,50 @@ void Looper::unregister_handler(Socket &sock)
 #endif
 }
 
+namespace
+{
+struct ExternalFDHandler : LooperHandler
+{
+	ExternalFDHandler(int external_fd, std::function<bool (Looper &, EventFlags)> callback_)
+		: callback(move(callback_))
+	{
+		socket.reset(new Socket(external_fd, false));
+	}
+
+	bool handle(Looper &looper, EventFlags flags) override
+	{
+		return callback(looper, flags);
+	}
+
+	std::function<bool (Looper &, EventFlags)> callback;
+};
+}
+
+bool Looper::register_external_fd(EventFlags events, int external_fd,
+                                  std::function<bool (Looper &, EventFlags)> callback)
+{
+#ifdef __linux__
+	return register_handler(events, unique_ptr<LooperHandler>(
+			new ExternalFDHandler(external_fd, move(callback))));
+#else
+	(void)events;
+	(void)external_fd;
+	(void)callback;
+	return false;
+#endif
+}
+
+void Looper::unregister_external_fd(int external_fd)
+{
+#ifdef __linux__
+	auto itr = handlers.find(external_fd);
+	if (itr != end(handlers))
+		unregister_handler(itr->second->get_socket());
+#else
+	(void)external_fd;
+#endif
+}
+
 void Looper::run_in_looper(std::function<void()> func)
 {
 #ifdef __linux__
@@ -182,11 +226,13 @@ int Looper::wait_idle(int timeout)
 	if (dead)
 		return -1;
 
-	epoll_event events[64];
+	// Large batches keep the number of epoll_wait syscalls down when many
+	// clients are active at the same time.
+	epoll_event events[256];
 	int ret;
 	int handled = 0;
 
-	while ((ret = epoll_wait(fd, events, 64, handled ? 0 : timeout)) > 0)
+	while ((ret = epoll_wait(fd, events, 256, handled ? 0 : timeout)) > 0)
 	{
 		handled += ret;
 		for (int i = 0; i < ret; i++)
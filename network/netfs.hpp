@@ -45,7 +45,23 @@ enum NetFSCommand
 	NETFS_UNREGISTER_NOTIFICATION = 8,
 	NETFS_BEGIN_CHUNK_REQUEST = 9,
 	NETFS_BEGIN_CHUNK_REPLY = 10,
-	NETFS_BEGIN_CHUNK_NOTIFICATION = 11
+	NETFS_BEGIN_CHUNK_NOTIFICATION = 11,
+	NETFS_PIPELINE = 12,
+	NETFS_LIST_STAT = 13,
+	NETFS_READ_FILE_CACHED = 14,
+	NETFS_SET_COMPRESSION = 15,
+	// Reply chunk whose payload (beyond the request ID) is an LZ4 block.
+	NETFS_BEGIN_CHUNK_REPLY_LZ4 = 16,
+	// Notification chunk carrying a u32 count followed by count
+	// (path, handle, type) entries, so a storm of changes coalesces into
+	// one framed message instead of one chunk per file.
+	NETFS_BEGIN_CHUNK_NOTIFICATION_BATCH = 17
+};
+
+enum NetFSCompressionScheme
+{
+	NETFS_COMPRESSION_NONE = 0,
+	NETFS_COMPRESSION_LZ4 = 1
 };
 
 enum NetFSError
@@ -54,6 +70,16 @@ enum NetFSError
 	NETFS_ERROR_IO = 1
 };
 
+enum NetFSCacheResult
+{
+	// The hash the client sent matches the current file content,
+	// no content follows and the client serves its local blob.
+	NETFS_CACHE_VALID = 1,
+	// The content changed (or the client had nothing cached),
+	// the new content follows the header.
+	NETFS_CACHE_UPDATE = 2
+};
+
 enum NetFSNotification
 {
 	NETFS_FILE_DELETED = 1,
@@ -25,8 +25,16 @@
 #include "netfs.hpp"
 #include "filesystem.hpp"
 #include "event.hpp"
+#include "hash.hpp"
+#include "lz4.hpp"
 #include <unordered_set>
 #include <queue>
+#include <algorithm>
+#ifdef __linux__
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace Granite;
 using namespace std;
@@ -62,29 +70,31 @@ struct NotificationSystem : EventHandler
 		: looper(looper_)
 	{
 		EVENT_MANAGER_REGISTER(NotificationSystem, on_filesystem, FilesystemProtocolEvent);
+		// Protocols registered while the filesystem was brought up have
+		// already arrived through on_filesystem, don't register them twice.
 		for (auto &proto : Global::filesystem()->get_protocols())
 		{
 			auto &fs = proto.second;
-			if (fs->get_notification_fd() >= 0)
+			if (!protocols.count(proto.first) && fs->get_notification_fd() >= 0)
 			{
 				auto socket = unique_ptr<Socket>(new Socket(fs->get_notification_fd(), false));
 				auto handler = unique_ptr<FilesystemHandler>(new FilesystemHandler(move(socket), *fs));
 				auto *ptr = handler.get();
-				looper.register_handler(EVENT_IN, move(handler));
-				protocols[proto.first] = ptr;
+				if (looper.register_handler(EVENT_IN, move(handler)))
+					protocols[proto.first] = ptr;
 			}
 		}
 	}
 
 	bool on_filesystem(const FilesystemProtocolEvent &fs)
 	{
-		if (fs.get_backend().get_notification_fd() >= 0)
+		if (!protocols.count(fs.get_protocol()) && fs.get_backend().get_notification_fd() >= 0)
 		{
 			auto socket = unique_ptr<Socket>(new Socket(fs.get_backend().get_notification_fd(), false));
 			auto handler = unique_ptr<FilesystemHandler>(new FilesystemHandler(move(socket), fs.get_backend()));
 			auto *ptr = handler.get();
-			looper.register_handler(EVENT_IN, move(handler));
-			protocols[fs.get_protocol()] = ptr;
+			if (looper.register_handler(EVENT_IN, move(handler)))
+				protocols[fs.get_protocol()] = ptr;
 		}
 		return true;
 	}
@@ -119,6 +129,49 @@ struct NotificationSystem : EventHandler
 
 struct FSHandler : LooperHandler
 {
+	struct NotificationReply
+	{
+		NotificationReply() = default;
+		~NotificationReply()
+		{
+#ifdef __linux__
+			if (file_fd >= 0)
+				::close(file_fd);
+#endif
+		}
+
+		NotificationReply(NotificationReply &&other) noexcept
+		{
+			*this = move(other);
+		}
+
+		NotificationReply &operator=(NotificationReply &&other) noexcept
+		{
+			if (this != &other)
+			{
+#ifdef __linux__
+				if (file_fd >= 0)
+					::close(file_fd);
+#endif
+				writer = other.writer;
+				builder = move(other.builder);
+				file_fd = other.file_fd;
+				file_offset = other.file_offset;
+				file_size = other.file_size;
+				other.file_fd = -1;
+			}
+			return *this;
+		}
+
+		SocketWriter writer;
+		ReplyBuilder builder;
+
+		// When set, the payload follows the framed header with sendfile().
+		int file_fd = -1;
+		uint64_t file_offset = 0;
+		uint64_t file_size = 0;
+	};
+
 	FSHandler(NotificationSystem &notify_system_, unique_ptr<Socket> socket_)
 		: LooperHandler(move(socket_)), notify_system(notify_system_)
 	{
@@ -129,6 +182,10 @@ struct FSHandler : LooperHandler
 
 	~FSHandler()
 	{
+#ifdef __linux__
+		if (read_fd >= 0)
+			::close(read_fd);
+#endif
 		if (is_notify_fs)
 		{
 			LOGE("Tearing down Notification system ...\n");
@@ -136,33 +193,66 @@ struct FSHandler : LooperHandler
 		}
 	}
 
+	static uint32_t notify_type_to_netfs(FileNotifyType type)
+	{
+		switch (type)
+		{
+		case FileNotifyType::FileCreated:
+			return NETFS_FILE_CREATED;
+		case FileNotifyType::FileDeleted:
+			return NETFS_FILE_DELETED;
+		default:
+			return NETFS_FILE_CHANGED;
+		}
+	}
+
 	void notify(const FileNotifyInfo &info)
 	{
-		LOGI("Notification for path: %s\n", info.path.c_str());
 		if (reply_queue.empty() && socket->get_parent_looper())
 			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
 
+		// Coalesce notification storms. While a reply is in flight on the
+		// socket, further notifications append to one batch chunk at the back
+		// of the queue instead of framing a chunk each; the transmit window of
+		// the in-flight reply is the coalescing window, so a bulk save from
+		// the art tools collapses into a handful of framed messages. Only the
+		// front of the queue ever touches the socket, so appending to the back
+		// and restarting its writer is safe.
+		if (batch_open && reply_queue.size() > 1)
+		{
+			// Editors write files in several syscalls; drop back to back
+			// duplicates for the same watch outright.
+			if (info.path == batch_last.path && info.handle == batch_last.handle && info.type == batch_last.type)
+				return;
+
+			auto &reply = reply_queue.back();
+			reply.builder.add_string(info.path);
+			reply.builder.add_u64(uint64_t(info.handle));
+			reply.builder.add_u32(notify_type_to_netfs(info.type));
+			batch_count++;
+			reply.builder.poke_u32(batch_count_offset, batch_count);
+			reply.builder.poke_u64(batch_size_offset, reply.builder.get_buffer().size() - batch_payload_offset);
+			reply.writer.start(reply.builder.get_buffer());
+			batch_last = info;
+			return;
+		}
+
 		reply_queue.emplace();
 		auto &reply = reply_queue.back();
-		reply.builder.add_u32(NETFS_BEGIN_CHUNK_NOTIFICATION);
+		reply.builder.add_u32(NETFS_BEGIN_CHUNK_NOTIFICATION_BATCH);
 		reply.builder.add_u32(NETFS_ERROR_OK);
-		reply.builder.add_u64(info.path.size() + 8 + 8 + 4);
+		batch_size_offset = reply.builder.add_u64(0);
+		batch_payload_offset = reply.builder.get_buffer().size();
+		batch_count_offset = reply.builder.add_u32(1);
 		reply.builder.add_string(info.path);
 		reply.builder.add_u64(uint64_t(info.handle));
-
-		switch (info.type)
-		{
-		case FileNotifyType::FileCreated:
-			reply.builder.add_u32(NETFS_FILE_CREATED);
-			break;
-		case FileNotifyType::FileDeleted:
-			reply.builder.add_u32(NETFS_FILE_DELETED);
-			break;
-		case FileNotifyType::FileChanged:
-			reply.builder.add_u32(NETFS_FILE_CHANGED);
-			break;
-		}
+		reply.builder.add_u32(notify_type_to_netfs(info.type));
+		reply.builder.poke_u64(batch_size_offset, reply.builder.get_buffer().size() - batch_payload_offset);
 		reply.writer.start(reply.builder.get_buffer());
+
+		batch_open = true;
+		batch_count = 1;
+		batch_last = info;
 	}
 
 	bool parse_command(Looper &)
@@ -185,6 +275,12 @@ struct FSHandler : LooperHandler
 			command_reader.start(reply_builder.get_buffer());
 			return true;
 
+		case NETFS_PIPELINE:
+			state = PipelineLoop;
+			reply_builder.begin(4 * sizeof(uint32_t));
+			command_reader.start(reply_builder.get_buffer());
+			return true;
+
 		default:
 			return false;
 		}
@@ -298,14 +394,56 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
+	// Opens a file which is backed by a real path in the OS filesystem,
+	// so the reply payload can go out with sendfile() straight from the
+	// page cache. Returns a plain fd, or -1 for backends without native paths.
+	static int open_native_readonly(const string &path, uint64_t &size)
+	{
+#ifdef __linux__
+		auto native = Global::filesystem()->get_filesystem_path(path);
+		if (native.empty())
+			return -1;
+
+		int fd = ::open(native.c_str(), O_RDONLY);
+		if (fd < 0)
+			return -1;
+
+		struct stat s;
+		if (fstat(fd, &s) < 0 || !S_ISREG(s.st_mode))
+		{
+			::close(fd);
+			return -1;
+		}
+
+		size = uint64_t(s.st_size);
+		return fd;
+#else
+		(void)path;
+		(void)size;
+		return -1;
+#endif
+	}
+
 	bool begin_read_file(const string &arg)
 	{
+		read_header_offset = 0;
+		read_payload_offset = 0;
+		read_fd = open_native_readonly(arg, read_fd_size);
+
+		reply_builder.begin();
+		if (read_fd >= 0)
+		{
+			reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+			reply_builder.add_u32(NETFS_ERROR_OK);
+			reply_builder.add_u64(read_fd_size);
+			return true;
+		}
+
 		file = Global::filesystem()->open(arg);
 		mapped = nullptr;
 		if (file)
 			mapped = file->map();
 
-		reply_builder.begin();
 		if (mapped)
 		{
 			reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
@@ -318,7 +456,6 @@ struct FSHandler : LooperHandler
 			reply_builder.add_u32(NETFS_ERROR_IO);
 			reply_builder.add_u64(0);
 		}
-		command_writer.start(reply_builder.get_buffer());
 		return true;
 	}
 
@@ -407,7 +544,7 @@ struct FSHandler : LooperHandler
 			{
 			case NETFS_READ_FILE:
 				looper.modify_handler(EVENT_OUT, *this);
-				state = WriteReplyChunk;
+				state = ReadFileReply;
 				begin_read_file(str);
 				break;
 
@@ -467,16 +604,6 @@ struct FSHandler : LooperHandler
 		{
 			switch (command_id)
 			{
-			case NETFS_READ_FILE:
-				if (mapped)
-				{
-					command_writer.start(mapped, file->get_size());
-					state = WriteReplyData;
-					return true;
-				}
-				else
-					return false;
-
 			case NETFS_WRITE_FILE:
 				if (file && mapped)
 					file->unmap();
@@ -490,13 +617,62 @@ struct FSHandler : LooperHandler
 		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
 	}
 
-	bool write_reply_data(Looper &)
+	// Pushes the read reply. While the chunk header is in flight the payload
+	// rides along in the same vectored send, after that the payload goes out
+	// with sendfile() when we hold a native fd, plain writes otherwise.
+	bool read_file_reply(Looper &)
 	{
-		auto ret = command_writer.process(*socket);
-		if (command_writer.complete())
-			return false;
+		auto &header = reply_builder.get_buffer();
+		uint64_t payload_size = 0;
+		if (read_fd >= 0)
+			payload_size = read_fd_size;
+		else if (mapped)
+			payload_size = file->get_size();
+
+		while (read_header_offset < header.size())
+		{
+			size_t header_remain = header.size() - read_header_offset;
+			int ret;
+			if (mapped && read_payload_offset < payload_size)
+			{
+				ret = socket->write_vectored(header.data() + read_header_offset, header_remain,
+				                             static_cast<const uint8_t *>(mapped) + read_payload_offset,
+				                             size_t(payload_size - read_payload_offset));
+			}
+			else
+				ret = socket->write(header.data() + read_header_offset, header_remain);
 
-		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+			if (ret == Socket::ErrorWouldBlock)
+				return true;
+			if (ret <= 0)
+				return false;
+
+			size_t header_bytes = std::min(size_t(ret), header_remain);
+			read_header_offset += header_bytes;
+			read_payload_offset += size_t(ret) - header_bytes;
+		}
+
+		while (read_payload_offset < payload_size)
+		{
+			int ret;
+			if (read_fd >= 0)
+				ret = socket->send_file(read_fd, read_payload_offset, size_t(payload_size - read_payload_offset));
+			else
+			{
+				ret = socket->write(static_cast<const uint8_t *>(mapped) + read_payload_offset,
+				                    size_t(payload_size - read_payload_offset));
+				if (ret > 0)
+					read_payload_offset += ret;
+			}
+
+			if (ret == Socket::ErrorWouldBlock)
+				return true;
+			if (ret <= 0)
+				return false;
+		}
+
+		// Reply fully sent, and legacy connections serve one request each.
+		return false;
 	}
 
 	bool notification_loop_register_notification(Looper &looper)
@@ -507,6 +683,7 @@ struct FSHandler : LooperHandler
 			auto path = reply_builder.read_string_implicit_count();
 			auto handle = notify_system.install_notification(this, protocol, path);
 
+			batch_open = false;
 			reply_queue.emplace();
 			auto &reply = reply_queue.back();
 			reply.builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
@@ -534,6 +711,7 @@ struct FSHandler : LooperHandler
 			LOGI("Got unregister request for handle %d.\n", int(handle));
 			notify_system.uninstall_notification(this, protocol, handle);
 
+			batch_open = false;
 			reply_queue.emplace();
 			auto &reply = reply_queue.back();
 			reply.builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
@@ -557,6 +735,336 @@ struct FSHandler : LooperHandler
 		looper.modify_handler(mask, *this);
 	}
 
+	static uint32_t file_type_to_netfs(PathType type)
+	{
+		switch (type)
+		{
+		case PathType::Directory:
+			return NETFS_FILE_TYPE_DIRECTORY;
+		case PathType::Special:
+			return NETFS_FILE_TYPE_SPECIAL;
+		default:
+			return NETFS_FILE_TYPE_PLAIN;
+		}
+	}
+
+	static void pipeline_error(ReplyBuilder &builder, uint64_t id)
+	{
+		builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+		builder.add_u32(NETFS_ERROR_IO);
+		builder.add_u64(8);
+		builder.add_u64(id);
+	}
+
+	void pipeline_read_file(NotificationReply &reply, uint64_t id, const string &path)
+	{
+		auto &builder = reply.builder;
+
+		// Zero-copy path. Only when the transport is uncompressed, LZ4 frames
+		// have to pass through memory anyway.
+		if (pipeline_compression == NETFS_COMPRESSION_NONE)
+		{
+			uint64_t size = 0;
+			int fd = open_native_readonly(path, size);
+			if (fd >= 0)
+			{
+				builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+				builder.add_u32(NETFS_ERROR_OK);
+				builder.add_u64(8 + size);
+				builder.add_u64(id);
+				reply.file_fd = fd;
+				reply.file_size = size;
+				return;
+			}
+		}
+
+		auto f = Global::filesystem()->open(path);
+		void *mapped_data = f ? f->map() : nullptr;
+		if (!f || (!mapped_data && f->get_size() != 0))
+		{
+			pipeline_error(builder, id);
+			return;
+		}
+
+		size_t size = f->get_size();
+		builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+		builder.add_u32(NETFS_ERROR_OK);
+		builder.add_u64(8 + size);
+		builder.add_u64(id);
+		auto &buf = builder.get_buffer();
+		buf.insert(end(buf), static_cast<const uint8_t *>(mapped_data),
+		           static_cast<const uint8_t *>(mapped_data) + size);
+	}
+
+	void pipeline_read_file_cached(ReplyBuilder &builder, uint64_t id, uint64_t known_hash, const string &path)
+	{
+		FileStat s;
+		if (!Global::filesystem()->stat(path, s))
+		{
+			hash_cache.erase(path);
+			pipeline_error(builder, id);
+			return;
+		}
+
+		// Fast path: if the stat matches what we hashed earlier and the client
+		// already holds that content, revalidate without touching the file.
+		auto itr = hash_cache.find(path);
+		if (itr != end(hash_cache) &&
+		    itr->second.size == s.size && itr->second.last_modified == s.last_modified &&
+		    itr->second.hash == known_hash)
+		{
+			builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+			builder.add_u32(NETFS_ERROR_OK);
+			builder.add_u64(8 + 8 + 4);
+			builder.add_u64(id);
+			builder.add_u64(known_hash);
+			builder.add_u32(NETFS_CACHE_VALID);
+			return;
+		}
+
+		auto f = Global::filesystem()->open(path);
+		void *mapped_data = f ? f->map() : nullptr;
+		if (!f || (!mapped_data && f->get_size() != 0))
+		{
+			pipeline_error(builder, id);
+			return;
+		}
+
+		// Hash the bytes we are actually serving so the client never files
+		// content under a stale hash.
+		size_t size = f->get_size();
+		Util::Hasher hasher;
+		hasher.data(static_cast<const uint8_t *>(mapped_data), size);
+		uint64_t hash = hasher.get();
+		hash_cache[path] = { s.size, s.last_modified, hash };
+
+		if (hash == known_hash)
+		{
+			builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+			builder.add_u32(NETFS_ERROR_OK);
+			builder.add_u64(8 + 8 + 4);
+			builder.add_u64(id);
+			builder.add_u64(hash);
+			builder.add_u32(NETFS_CACHE_VALID);
+			return;
+		}
+
+		builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+		builder.add_u32(NETFS_ERROR_OK);
+		builder.add_u64(8 + 8 + 4 + size);
+		builder.add_u64(id);
+		builder.add_u64(hash);
+		builder.add_u32(NETFS_CACHE_UPDATE);
+		auto &buf = builder.get_buffer();
+		buf.insert(end(buf), static_cast<const uint8_t *>(mapped_data),
+		           static_cast<const uint8_t *>(mapped_data) + size);
+	}
+
+	static void pipeline_stat(ReplyBuilder &builder, uint64_t id, const string &path)
+	{
+		FileStat s;
+		if (!Global::filesystem()->stat(path, s))
+		{
+			pipeline_error(builder, id);
+			return;
+		}
+
+		builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+		builder.add_u32(NETFS_ERROR_OK);
+		builder.add_u64(8 + 8 + 4 + 8);
+		builder.add_u64(id);
+		builder.add_u64(s.size);
+		builder.add_u32(file_type_to_netfs(s.type));
+		builder.add_u64(s.last_modified);
+	}
+
+	static void pipeline_list_stat(ReplyBuilder &builder, uint64_t id, const string &path)
+	{
+		auto list = Global::filesystem()->list(path);
+		builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+		builder.add_u32(NETFS_ERROR_OK);
+		auto offset = builder.add_u64(0);
+		builder.add_u64(id);
+		builder.add_u32(list.size());
+		for (auto &l : list)
+		{
+			FileStat s = {};
+			Global::filesystem()->stat(l.path, s);
+			builder.add_string(l.path);
+			builder.add_u32(file_type_to_netfs(l.type));
+			builder.add_u64(s.size);
+			builder.add_u64(s.last_modified);
+		}
+		builder.poke_u64(offset, builder.get_buffer().size() - (offset + 8));
+	}
+
+	void pipeline_set_compression(ReplyBuilder &builder, uint64_t id, uint32_t scheme)
+	{
+		if (scheme != NETFS_COMPRESSION_LZ4)
+			scheme = NETFS_COMPRESSION_NONE;
+		pipeline_compression = scheme;
+
+		builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
+		builder.add_u32(NETFS_ERROR_OK);
+		builder.add_u64(8 + 4);
+		builder.add_u64(id);
+		builder.add_u32(scheme);
+	}
+
+	// Replaces a plain reply with an LZ4 frame when the payload is large
+	// enough and actually shrinks. The request ID stays uncompressed so the
+	// client can match replies before touching the payload.
+	static void maybe_compress_pipeline_reply(ReplyBuilder &builder)
+	{
+		enum : size_t { CompressionThreshold = 128 };
+		auto &buf = builder.get_buffer();
+		if (buf.size() < 16 + 8 + CompressionThreshold)
+			return;
+
+		uint32_t err;
+		memcpy(&err, buf.data() + 4, sizeof(err));
+		if (ntohl(err) != NETFS_ERROR_OK)
+			return;
+
+		const uint8_t *content = buf.data() + 24;
+		size_t content_size = buf.size() - 24;
+		std::vector<uint8_t> compressed(Util::LZ4::compress_bound(content_size));
+		size_t compressed_size = Util::LZ4::compress(compressed.data(), compressed.size(), content, content_size);
+		if (!compressed_size || compressed_size >= content_size)
+			return;
+
+		ReplyBuilder lz4;
+		lz4.add_u32(NETFS_BEGIN_CHUNK_REPLY_LZ4);
+		lz4.add_u32(NETFS_ERROR_OK);
+		lz4.add_u64(8 + 8 + compressed_size);
+		auto &out = lz4.get_buffer();
+		out.insert(end(out), buf.data() + 16, buf.data() + 24);
+		lz4.add_u64(content_size);
+		out.insert(end(out), compressed.data(), compressed.data() + compressed_size);
+		builder = move(lz4);
+	}
+
+	bool pipeline_chunk_data(Looper &looper)
+	{
+		auto ret = command_reader.process(*socket);
+		if (command_reader.complete())
+		{
+			uint64_t id = reply_builder.read_u64();
+			uint64_t known_hash = 0;
+			uint32_t scheme = NETFS_COMPRESSION_NONE;
+			if (pipeline_command == NETFS_READ_FILE_CACHED)
+				known_hash = reply_builder.read_u64();
+			else if (pipeline_command == NETFS_SET_COMPRESSION)
+				scheme = reply_builder.read_u32();
+			auto path = reply_builder.read_string_implicit_count();
+
+			reply_queue.emplace();
+			auto &reply = reply_queue.back();
+			switch (pipeline_command)
+			{
+			case NETFS_READ_FILE:
+				pipeline_read_file(reply, id, path);
+				break;
+
+			case NETFS_READ_FILE_CACHED:
+				pipeline_read_file_cached(reply.builder, id, known_hash, path);
+				break;
+
+			case NETFS_STAT:
+				pipeline_stat(reply.builder, id, path);
+				break;
+
+			case NETFS_LIST_STAT:
+				pipeline_list_stat(reply.builder, id, path);
+				break;
+
+			case NETFS_SET_COMPRESSION:
+				pipeline_set_compression(reply.builder, id, scheme);
+				break;
+
+			default:
+				// Fail the request rather than the connection so newer
+				// clients can probe for commands we do not know about.
+				LOGE("Unsupported pipelined command %u.\n", pipeline_command);
+				pipeline_error(reply.builder, id);
+				break;
+			}
+			if (pipeline_compression == NETFS_COMPRESSION_LZ4)
+				maybe_compress_pipeline_reply(reply.builder);
+			reply.writer.start(reply.builder.get_buffer());
+			looper.modify_handler(EVENT_IN | EVENT_OUT, *this);
+
+			reply_builder.begin(4 * sizeof(uint32_t));
+			command_reader.start(reply_builder.get_buffer());
+			state = PipelineLoop;
+			return true;
+		}
+
+		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+	}
+
+	bool pipeline_loop(Looper &looper, EventFlags flags)
+	{
+		if (flags & EVENT_IN)
+		{
+			auto ret = command_reader.process(*socket);
+			if (command_reader.complete())
+			{
+				pipeline_command = reply_builder.read_u32();
+				if (reply_builder.read_u32() != NETFS_BEGIN_CHUNK_REQUEST)
+				{
+					LOGE("Wrong request type %u in pipeline loop.\n", pipeline_command);
+					return false;
+				}
+
+				uint64_t chunk_size = reply_builder.read_u64();
+				// Requests always carry the request ID.
+				if (chunk_size < 8)
+					return false;
+
+				reply_builder.begin(chunk_size);
+				command_reader.start(reply_builder.get_buffer());
+				state = PipelineChunkData;
+				looper.modify_handler(EVENT_IN, *this);
+				return true;
+			}
+
+			return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+		}
+
+		if (flags & EVENT_OUT)
+		{
+			// Flush as many queued replies as the socket accepts per wakeup
+			// rather than paying one EPOLLOUT round trip per reply.
+			int ret = 1;
+			while (!reply_queue.empty())
+			{
+				auto &front = reply_queue.front();
+				if (!front.writer.complete())
+					ret = front.writer.process(*socket);
+
+				// Framed header is out, push the sendfile() payload if the reply has one.
+				if (front.writer.complete() && front.file_fd >= 0 && front.file_offset < front.file_size)
+					ret = socket->send_file(front.file_fd, front.file_offset, size_t(front.file_size - front.file_offset));
+
+				if (front.writer.complete() && (front.file_fd < 0 || front.file_offset == front.file_size))
+					reply_queue.pop();
+				else
+					break;
+			}
+
+			if (reply_queue.empty())
+			{
+				looper.modify_handler(EVENT_IN, *this);
+				return true;
+			}
+			else
+				return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+		}
+
+		return true;
+	}
+
 	bool notification_loop(Looper &looper, EventFlags flags)
 	{
 		if (flags & EVENT_IN)
@@ -596,16 +1104,16 @@ struct FSHandler : LooperHandler
 
 		if (flags & EVENT_OUT)
 		{
-			if (reply_queue.empty())
+			int ret = 1;
+			while (!reply_queue.empty())
 			{
-				looper.modify_handler(EVENT_IN, *this);
-				return true;
+				ret = reply_queue.front().writer.process(*socket);
+				if (reply_queue.front().writer.complete())
+					reply_queue.pop();
+				else
+					break;
 			}
 
-			auto ret = reply_queue.front().writer.process(*socket);
-			if (reply_queue.front().writer.complete())
-				reply_queue.pop();
-
 			if (reply_queue.empty())
 			{
 				looper.modify_handler(EVENT_IN, *this);
@@ -632,14 +1140,18 @@ struct FSHandler : LooperHandler
 			return read_chunk_data2(looper);
 		else if (state == WriteReplyChunk)
 			return write_reply_chunk(looper);
-		else if (state == WriteReplyData)
-			return write_reply_data(looper);
+		else if (state == ReadFileReply)
+			return read_file_reply(looper);
 		else if (state == NotificationLoop)
 			return notification_loop(looper, flags);
 		else if (state == NotificationLoopRegister)
 			return notification_loop_register_notification(looper);
 		else if (state == NotificationLoopUnregister)
 			return notification_loop_unregister_notification(looper);
+		else if (state == PipelineLoop)
+			return pipeline_loop(looper, flags);
+		else if (state == PipelineChunkData)
+			return pipeline_chunk_data(looper);
 		else
 			return false;
 	}
@@ -652,10 +1164,12 @@ struct FSHandler : LooperHandler
 		ReadChunkSize2,
 		ReadChunkData2,
 		WriteReplyChunk,
-		WriteReplyData,
+		ReadFileReply,
 		NotificationLoop,
 		NotificationLoopRegister,
-		NotificationLoopUnregister
+		NotificationLoopUnregister,
+		PipelineLoop,
+		PipelineChunkData
 	};
 
 	NotificationSystem &notify_system;
@@ -664,18 +1178,40 @@ struct FSHandler : LooperHandler
 	SocketWriter command_writer;
 	ReplyBuilder reply_builder;
 	uint32_t command_id = 0;
+	uint32_t pipeline_command = 0;
+	uint32_t pipeline_compression = NETFS_COMPRESSION_NONE;
 
-	struct NotificationReply
-	{
-		SocketWriter writer;
-		ReplyBuilder builder;
-	};
 	std::queue<NotificationReply> reply_queue;
 	std::string protocol;
 
+	// Content hashes for cached reads, revalidated against size/mtime so an
+	// unchanged file is only hashed once per connection.
+	struct ContentHash
+	{
+		uint64_t size;
+		uint64_t last_modified;
+		uint64_t hash;
+	};
+	std::unordered_map<std::string, ContentHash> hash_cache;
+
 	unique_ptr<File> file;
 	void *mapped = nullptr;
 
+	// State for the zero-copy read reply.
+	int read_fd = -1;
+	uint64_t read_fd_size = 0;
+	uint64_t read_header_offset = 0;
+	uint64_t read_payload_offset = 0;
+
+	// Open coalescing batch at the back of reply_queue, see notify().
+	// Register/unregister replies push behind it and close it.
+	bool batch_open = false;
+	uint32_t batch_count = 0;
+	size_t batch_size_offset = 0;
+	size_t batch_count_offset = 0;
+	size_t batch_payload_offset = 0;
+	FileNotifyInfo batch_last;
+
 	bool is_notify_fs = false;
 };
 
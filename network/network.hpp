@@ -106,6 +106,20 @@ public:
 	int write(const void *data, size_t size);
 	int read(void *data, size_t size);
 
+	// Writes header followed by payload with a single vectored syscall.
+	// Returns the number of bytes consumed across both buffers,
+	// or an Error code like write().
+	int write_vectored(const void *header, size_t header_size, const void *payload, size_t payload_size);
+
+	// Zero-copy write of up to size bytes from input_fd starting at offset.
+	// offset is advanced by the number of bytes sent.
+	// Returns bytes sent, or an Error code like write().
+	int send_file(int input_fd, uint64_t &offset, size_t size);
+
+	// Disables Nagle. The netfs protocol exchanges many small framed
+	// messages, which should not sit in the kernel waiting for an ACK.
+	bool set_nodelay(bool enable);
+
 	enum Error
 	{
 		ErrorWouldBlock = -1,
@@ -173,6 +187,25 @@ public:
 	void run_in_looper(std::function<void ()> func);
 	void kill();
 
+	// The underlying poll fd. It polls readable whenever any registered source
+	// is ready, so a whole Looper can be nested into another poll site: hook
+	// it up with register_external_fd(EVENT_IN, ...) on an outer Looper and
+	// drain it with wait_idle(0) from the callback. One thread then blocks on
+	// a single poll covering every subsystem instead of paying one wakeup per
+	// event loop.
+	int get_fd() const
+	{
+		return fd;
+	}
+
+	// Hooks a non-socket fd (eventfd, timerfd, another Looper) into the poll
+	// set. The callback follows LooperHandler::handle() semantics: return
+	// false to drop the registration. The fd is not owned and stays open
+	// after unregistering.
+	bool register_external_fd(EventFlags events, int external_fd,
+	                          std::function<bool (Looper &, EventFlags)> callback);
+	void unregister_external_fd(int external_fd);
+
 private:
 	int fd;
 	std::unordered_map<int, std::unique_ptr<LooperHandler>> handlers;
@@ -30,6 +30,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #endif
 
 using namespace std;
@@ -52,24 +56,35 @@ void SocketWriter::start(const void *data_, size_t size_)
 
 int SocketReader::process(Socket &socket)
 {
-	size_t to_read = size - offset;
-	auto res = socket.read(static_cast<uint8_t *>(data) + offset, to_read);
-	if (res <= 0)
-		return res;
-
-	offset += res;
-	return offset;
+	// Drain until the buffer completes or the socket would block.
+	// Stopping after one partial recv costs a full event loop round trip
+	// per chunk, which adds up with many concurrent clients.
+	while (offset < size)
+	{
+		size_t to_read = size - offset;
+		auto res = socket.read(static_cast<uint8_t *>(data) + offset, to_read);
+		if (res == Socket::ErrorWouldBlock && offset)
+			break;
+		if (res <= 0)
+			return res;
+		offset += res;
+	}
+	return int(offset);
 }
 
 int SocketWriter::process(Socket &socket)
 {
-	size_t to_write = size - offset;
-	auto res = socket.write(static_cast<const uint8_t *>(data) + offset, to_write);
-	if (res <= 0)
-		return res;
-
-	offset += res;
-	return offset;
+	while (offset < size)
+	{
+		size_t to_write = size - offset;
+		auto res = socket.write(static_cast<const uint8_t *>(data) + offset, to_write);
+		if (res == Socket::ErrorWouldBlock && offset)
+			break;
+		if (res <= 0)
+			return res;
+		offset += res;
+	}
+	return int(offset);
 }
 
 Socket::Socket(int fd_, bool owned_)
@@ -123,7 +138,9 @@ unique_ptr<Socket> Socket::connect(const char *addr, uint16_t port)
 		return {};
 	}
 
-	return unique_ptr<Socket>(new Socket(fd));
+	auto sock = unique_ptr<Socket>(new Socket(fd));
+	sock->set_nodelay(true);
+	return sock;
 #else
 	return {};
 #endif
@@ -173,4 +190,68 @@ int Socket::write(const void *data, size_t size)
 	return -1;
 #endif
 }
+
+int Socket::write_vectored(const void *header, size_t header_size, const void *payload, size_t payload_size)
+{
+#ifdef __linux__
+	iovec iov[2] = {};
+	iov[0].iov_base = const_cast<void *>(header);
+	iov[0].iov_len = header_size;
+	iov[1].iov_base = const_cast<void *>(payload);
+	iov[1].iov_len = payload_size;
+
+	msghdr msg = {};
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	auto ret = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+	if (ret < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return ErrorWouldBlock;
+		else
+			return ErrorIO;
+	}
+	return ret;
+#else
+	(void)header;
+	(void)header_size;
+	(void)payload;
+	(void)payload_size;
+	return -1;
+#endif
+}
+
+bool Socket::set_nodelay(bool enable)
+{
+#ifdef __linux__
+	int yes = enable ? 1 : 0;
+	return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)) == 0;
+#else
+	(void)enable;
+	return false;
+#endif
+}
+
+int Socket::send_file(int input_fd, uint64_t &offset, size_t size)
+{
+#ifdef __linux__
+	off_t off = off_t(offset);
+	auto ret = ::sendfile(fd, input_fd, &off, size);
+	if (ret < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return ErrorWouldBlock;
+		else
+			return ErrorIO;
+	}
+	offset = uint64_t(off);
+	return ret;
+#else
+	(void)input_fd;
+	(void)offset;
+	(void)size;
+	return -1;
+#endif
+}
 }
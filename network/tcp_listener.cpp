@@ -83,7 +83,9 @@ unique_ptr<Socket> TCPListener::accept()
 		return {};
 	}
 
-	return unique_ptr<Socket>(new Socket(new_fd));
+	auto sock = unique_ptr<Socket>(new Socket(new_fd));
+	sock->set_nodelay(true);
+	return sock;
 }
 
 TCPListener::TCPListener(uint16_t port)
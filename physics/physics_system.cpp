@@ -21,6 +21,8 @@
  */
 
 #include "physics_system.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
 #include <btBulletDynamicsCommon.h>
 #include <btBulletCollisionCommon.h>
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
@@ -60,6 +62,9 @@ struct PhysicsHandle
 	Entity *entity = nullptr;
 	PhysicsSystem::InteractionType type = PhysicsSystem::InteractionType::Ghost;
 	bool copy_transform_from_node = false;
+	// Tracks activity across frames so a body gets one final transform sync
+	// when it goes to sleep, then stops dirtying its node.
+	bool was_active = true;
 
 	~PhysicsHandle()
 	{
@@ -104,19 +109,22 @@ void PhysicsSystem::tick_callback(float)
 			auto &pt = contact->getContactPoint(j);
 			if (pt.m_lifeTime == 1)
 			{
+				// A manifold owns every contact point for its pair, so
+				// emitting just the first new point de-duplicates the batch
+				// per pair.
 				new_collision_buffer.emplace_back(handle0 ? handle0->entity : nullptr,
 				                                  handle1 ? handle1->entity : nullptr,
 				                                  handle0, handle1,
 				                                  convert(pt.getPositionWorldOnB()),
 				                                  convert(pt.m_normalWorldOnB));
+				break;
 			}
 		}
 	}
 
 	auto *em = Global::event_manager();
-	if (em)
-		for (auto &collision : new_collision_buffer)
-			em->dispatch_inline(collision);
+	if (em && !new_collision_buffer.empty())
+		em->dispatch_inline(CollisionBatchEvent{ new_collision_buffer.data(), new_collision_buffer.size() });
 	new_collision_buffer.clear();
 }
 
@@ -167,8 +175,35 @@ RaycastResult PhysicsSystem::query_closest_hit_ray(const vec3 &from, const vec3
 	return result;
 }
 
+void PhysicsSystem::query_closest_hit_ray_batch(const RaycastQuery *queries, RaycastResult *results, unsigned count)
+{
+	if (!count)
+		return;
+
+	auto *group = Global::thread_group();
+	if (!group || count == 1)
+	{
+		for (unsigned i = 0; i < count; i++)
+			results[i] = query_closest_hit_ray(queries[i].from, queries[i].dir, queries[i].length, queries[i].mask);
+		return;
+	}
+
+	// rayTest() only reads the collision world, so independent queries can
+	// run concurrently between simulation steps.
+	group->parallel_for(count, 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			results[i] = query_closest_hit_ray(queries[i].from, queries[i].dir, queries[i].length, queries[i].mask);
+	});
+}
+
+void PhysicsSystem::set_tick_rate(float ticks_per_second)
+{
+	fixed_tick = 1.0f / ticks_per_second;
+}
+
 PhysicsSystem::PhysicsSystem()
 {
+	fixed_tick = PHYSICS_TICK;
 	collision_config = make_unique<btDefaultCollisionConfiguration>();
 	dispatcher = make_unique<btCollisionDispatcher>(collision_config.get());
 	broadphase = make_unique<btDbvtBroadphase>();
@@ -361,7 +396,10 @@ void PhysicsSystem::iterate(double frame_time)
 		}
 	}
 
-	world->stepSimulation(btScalar(frame_time), 20, PHYSICS_TICK);
+	// The simulation itself always runs at the fixed tick regardless of
+	// render rate; motion states interpolate the remainder so the handoff
+	// below sees alpha-blended transforms between ticks.
+	world->stepSimulation(btScalar(frame_time), 20, fixed_tick);
 
 	// Update node transforms from physics engine.
 	for (auto *handle : handles)
@@ -374,6 +412,15 @@ void PhysicsSystem::iterate(double frame_time)
 		if (ghost)
 			continue;
 
+		// Sleeping bodies hold their pose, so skip the node write and the
+		// transform invalidation which would dirty the subtree every frame.
+		// One extra sync happens on the frame the body deactivates to land
+		// exactly on the rest pose.
+		bool active = obj->isActive();
+		if (!active && !handle->was_active)
+			continue;
+		handle->was_active = active;
+
 		auto *body = btRigidBody::upcast(obj);
 		btTransform t;
 		if (body && body->getMotionState())
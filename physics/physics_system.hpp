@@ -134,6 +134,35 @@ private:
 	vec3 normal;
 };
 
+// Batched contact delivery: one event per simulation tick carrying every
+// pair which gained a new contact that tick, de-duplicated per pair.
+// Gameplay code walks the compact array instead of handling one dispatch
+// per contact point on contact-heavy frames. The span is only valid during
+// the dispatch.
+class CollisionBatchEvent : public Event
+{
+public:
+	GRANITE_EVENT_TYPE_DECL(CollisionBatchEvent)
+	CollisionBatchEvent(const CollisionEvent *contacts_, size_t count_)
+		: contacts(contacts_), count(count_)
+	{
+	}
+
+	const CollisionEvent *get_contacts() const
+	{
+		return contacts;
+	}
+
+	size_t get_count() const
+	{
+		return count;
+	}
+
+private:
+	const CollisionEvent *contacts;
+	size_t count;
+};
+
 struct RaycastResult
 {
 	Entity *entity;
@@ -241,6 +270,12 @@ public:
 	void iterate(double frame_time);
 	void tick_callback(float tick_time);
 
+	// The simulation steps at a fixed tick decoupled from the render rate and
+	// motion states interpolate transforms between ticks, so lowering the
+	// rate on high-refresh displays recovers CPU time at some accuracy cost.
+	// Defaults to 300 Hz.
+	void set_tick_rate(float ticks_per_second);
+
 	enum InteractionTypeFlagBits
 	{
 		INTERACTION_TYPE_STATIC_BIT = 1 << 0,
@@ -254,6 +289,19 @@ public:
 	RaycastResult query_closest_hit_ray(const vec3 &from, const vec3 &dir, float length,
 	                                    InteractionTypeFlags mask = INTERACTION_TYPE_ALL_BITS);
 
+	struct RaycastQuery
+	{
+		vec3 from;
+		vec3 dir;
+		float length;
+		InteractionTypeFlags mask = INTERACTION_TYPE_ALL_BITS;
+	};
+
+	// Runs a batch of closest-hit queries across the worker threads in one go.
+	// Ray tests only read the collision world, so the batch is safe to fan out
+	// as long as the world is not stepping, i.e. outside iterate().
+	void query_closest_hit_ray_batch(const RaycastQuery *queries, RaycastResult *results, unsigned count);
+
 	void add_point_constraint(PhysicsHandle *handle, const vec3 &local_pivot);
 	void add_point_constraint(PhysicsHandle *handle0, PhysicsHandle *handle1,
 	                          const vec3 &local_pivot0, const vec3 &local_pivot1,
@@ -285,6 +333,7 @@ private:
 	std::unique_ptr<btGhostPairCallback> ghost_callback;
 
 	btCollisionShape *create_shape(const ConvexMeshPart &part);
+	float fixed_tick;
 	Scene *scene = nullptr;
 	ComponentGroupVector<PhysicsComponent, ForceComponent> *forces = nullptr;
 };
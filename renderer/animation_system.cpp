@@ -29,13 +29,17 @@ namespace Granite
 template <typename T, typename Sampler>
 static void resample_channel(T *resampled, size_t count, const SceneFormats::AnimationChannel &channel, const Sampler &sampler, float inv_frame_rate)
 {
+	// Sample times increase monotonically, so let get_index_phase() resume its
+	// timeline scan from the previous key frame instead of rescanning from the
+	// start for every sample.
+	unsigned cursor = 0;
 	for (size_t i = 0; i < count; i++)
 	{
 		float t = float(i) * inv_frame_rate;
 		unsigned index;
 		float phase;
 		float dt;
-		channel.get_index_phase(t, index, phase, dt);
+		channel.get_index_phase(t, cursor, index, phase, dt);
 		resampled[i] = sampler.sample(index, phase, dt);
 	}
 }
@@ -180,4 +180,30 @@ void SSAOLookupTables::on_device_destroyed(const Vulkan::DeviceCreatedEvent &)
 	kernel.reset();
 	noise.reset();
 }
+
+BuiltinLutPrimer::BuiltinLutPrimer()
+{
+	EVENT_MANAGER_REGISTER_LATCH(BuiltinLutPrimer, on_device_created, on_device_destroyed, Vulkan::DeviceCreatedEvent);
+}
+
+void BuiltinLutPrimer::on_device_created(const Vulkan::DeviceCreatedEvent &e)
+{
+	// Manifest of constant LUT blobs any renderer configuration may end up
+	// sampling. They are tiny, so even configurations which never touch SMAA
+	// pay almost nothing for priming them.
+	static const char *manifest[] = {
+		"builtin://textures/ibl_brdf_lut.gtx",
+		"builtin://textures/smaa/area.gtx",
+		"builtin://textures/smaa/search.gtx",
+	};
+
+	// request_texture kicks the mmap + upload on worker threads immediately,
+	// so all manifest entries load in one batch during device bring-up.
+	for (auto *path : manifest)
+		e.get_device().get_texture_manager().request_texture(path);
+}
+
+void BuiltinLutPrimer::on_device_destroyed(const Vulkan::DeviceCreatedEvent &)
+{
+}
 }
@@ -77,11 +77,26 @@ private:
 	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
 };
 
+// Primes the constant lookup textures (IBL BRDF LUT, SMAA area/search) as soon
+// as the device exists. The blobs are pre-baked .gtx files which memory-map
+// with zero decode; requesting the whole manifest here batches their uploads
+// into device creation instead of stalling the first frame that samples them.
+class BuiltinLutPrimer : public EventHandler
+{
+public:
+	BuiltinLutPrimer();
+
+private:
+	void on_device_created(const Vulkan::DeviceCreatedEvent &e);
+	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
+};
+
 class CommonRendererData
 {
 public:
 	LightMesh light_mesh;
 	PersistentFrameEvent frame_tick;
 	SSAOLookupTables ssao_luts;
+	BuiltinLutPrimer lut_primer;
 };
 }
\ No newline at end of file
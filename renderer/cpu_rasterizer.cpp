@@ -56,6 +56,7 @@ struct TriangleSetup
 	vec3 base;
 	vec3 dx;
 	vec3 dy;
+	vec3 z;
 	vec2 lo;
 	vec2 hi;
 };
@@ -93,6 +94,9 @@ static bool setup_triangle(TriangleSetup &setup, const Triangle &tri, CullMode c
 	setup.dy.y = bc.x * inv_z;
 	setup.dy.z = ca.x * inv_z;
 
+	// Each edge function interpolates the vertex opposite to it.
+	setup.z = vec3(tri.vertices[2].z, tri.vertices[0].z, tri.vertices[1].z);
+
 	vec2 lo = min(min(tri.vertices[0].xy(), tri.vertices[1].xy()), tri.vertices[2].xy());
 	vec2 hi = max(max(tri.vertices[0].xy(), tri.vertices[1].xy()), tri.vertices[2].xy());
 	setup.lo = lo;
@@ -350,6 +354,70 @@ void rasterize_conservative_triangles(std::vector<uvec2> &coverage,
 	}
 }
 
+void rasterize_depth_triangles(float *depth, const vec4 *clip_positions,
+                               const unsigned *indices, unsigned num_indices,
+                               uvec2 resolution, CullMode cull)
+{
+	vec2 fresolution = vec2(resolution);
+	vec2 inv_resolution = 1.0f / fresolution;
+
+	TriangleSetup setups[4];
+	for (unsigned index = 0; index < num_indices; index += 3)
+	{
+		unsigned count = setup_clipped_triangles(setups,
+		                                         clip_positions[indices[index + 0]],
+		                                         clip_positions[indices[index + 1]],
+		                                         clip_positions[indices[index + 2]], cull);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			auto &setup = setups[i];
+			ivec2 lo = ivec2(setup.lo * fresolution);
+			ivec2 hi = ivec2(setup.hi * fresolution);
+			lo = max(lo, ivec2(0));
+			hi = min(hi, ivec2(resolution) - 1);
+
+			vec3 bary = setup.base +
+			            setup.dx * float(lo.x) * inv_resolution.x +
+			            setup.dy * float(lo.y) * inv_resolution.y;
+
+			const vec3 step_x = setup.dx * inv_resolution.x;
+			const vec3 step_y = setup.dy * inv_resolution.y;
+
+			// Unlike the conservative coverage rasterizer, sample the corner which
+			// minimizes the edge functions, so depth is only written for texels
+			// the triangle covers completely. A partially covered texel must not
+			// act as an occluder.
+			vec3 base = bary;
+			base += select(vec3(0.0f), step_x, lessThan(setup.dx, vec3(0.0f)));
+			base += select(vec3(0.0f), step_y, lessThan(setup.dy, vec3(0.0f)));
+
+			float z_row = dot(bary, setup.z);
+			float z_dx = dot(step_x, setup.z);
+			float z_dy = dot(step_y, setup.z);
+			// Take the farthest depth within the texel so the occluder depth
+			// is never closer than the actual surface.
+			float z_slack = muglm::max(z_dx, 0.0f) + muglm::max(z_dy, 0.0f);
+
+			for (int y = lo.y; y <= hi.y; y++)
+			{
+				vec3 step = base;
+				float z = z_row;
+				float *row = depth + y * int(resolution.x);
+				for (int x = lo.x; x <= hi.x; x++)
+				{
+					if (all(greaterThan(step, vec3(0.0f))))
+						row[x] = muglm::min(row[x], clamp(z + z_slack, 0.0f, 1.0f));
+					step += step_x;
+					z += z_dx;
+				}
+				base += step_y;
+				z_row += z_dy;
+			}
+		}
+	}
+}
+
 void transform_vertices(vec4 *clip_position, const vec4 *positions, unsigned num_positions, const mat4 &mvp)
 {
 	for (unsigned i = 0; i < num_positions; i++)
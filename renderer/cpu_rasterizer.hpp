@@ -41,6 +41,13 @@ void rasterize_conservative_triangles(std::vector<uvec2> &coverage,
                                       const unsigned *indices, unsigned num_indices,
                                       uvec2 resolution, CullMode cull);
 
+// Rasterizes the farthest in-texel depth of fully covered texels with depth-min test.
+// Texels which are only partially covered are left alone, so the result is safe
+// to use as an occlusion buffer. The depth buffer should be cleared to 1.0.
+void rasterize_depth_triangles(float *depth, const vec4 *clip_positions,
+                               const unsigned *indices, unsigned num_indices,
+                               uvec2 resolution, CullMode cull);
+
 void transform_vertices(vec4 *clip_position, const vec4 *positions, unsigned num_positions, const mat4 &mvp);
 }
 }
@@ -0,0 +1,88 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "gpu_draw_culler.hpp"
+#include "command_buffer.hpp"
+#include <string.h>
+
+using namespace std;
+
+namespace Granite
+{
+void GPUDrawCuller::set_draws(Vulkan::Device &device, const Draw *draws, unsigned count)
+{
+	num_draws = count;
+	if (!count)
+	{
+		scene_draws.reset();
+		culled_draws.reset();
+		culled_count.reset();
+		return;
+	}
+
+	Vulkan::BufferCreateInfo info = {};
+	info.domain = Vulkan::BufferDomain::Device;
+	info.size = count * sizeof(Draw);
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	scene_draws = device.create_buffer(info, draws);
+
+	info.size = count * sizeof(VkDrawIndexedIndirectCommand);
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	culled_draws = device.create_buffer(info);
+
+	info.size = sizeof(uint32_t);
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+	             VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	culled_count = device.create_buffer(info);
+}
+
+void GPUDrawCuller::cull(Vulkan::CommandBuffer &cmd, const Frustum &frustum)
+{
+	if (!num_draws)
+		return;
+
+	cmd.fill_buffer(*culled_count, 0);
+	cmd.barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	cmd.set_storage_buffer(0, 0, *scene_draws);
+	cmd.set_storage_buffer(0, 1, *culled_draws);
+	cmd.set_storage_buffer(0, 2, *culled_count);
+	memcpy(cmd.allocate_typed_constant_data<vec4>(0, 3, 6), frustum.get_planes(), sizeof(vec4) * 6);
+
+	uint32_t count = num_draws;
+	cmd.push_constants(&count, 0, sizeof(count));
+
+	cmd.set_program("builtin://shaders/util/cull_indexed_draws.comp");
+	cmd.dispatch((num_draws + 63) / 64, 1, 1);
+}
+
+void GPUDrawCuller::draw(Vulkan::CommandBuffer &cmd) const
+{
+	if (!num_draws)
+		return;
+
+	cmd.draw_indexed_multi_indirect(*culled_draws, 0, num_draws, sizeof(VkDrawIndexedIndirectCommand),
+	                                *culled_count, 0);
+}
+}
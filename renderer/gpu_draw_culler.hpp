@@ -0,0 +1,71 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "math.hpp"
+#include "frustum.hpp"
+#include "device.hpp"
+
+namespace Granite
+{
+// GPU-driven draw generation. Static draws live in a persistent device-local
+// buffer of indirect commands plus world-space AABBs, a compute pass
+// frustum-culls them and compacts survivors into an indirect draw buffer,
+// and the result is consumed in one vkCmdDrawIndexedIndirectCountKHR.
+// The caller owns all render state; draws which should merge must share
+// pipeline, vertex/index buffers and descriptor sets, e.g. through the
+// bindless material table.
+class GPUDrawCuller
+{
+public:
+	struct Draw
+	{
+		VkDrawIndexedIndirectCommand indirect;
+		uint32_t padding[3];
+		vec4 aabb_lo; // w is unused.
+		vec4 aabb_hi;
+	};
+
+	// Uploads the persistent scene draw buffer.
+	// Only needs to be called when the set of static draws changes.
+	void set_draws(Vulkan::Device &device, const Draw *draws, unsigned count);
+
+	// Records the culling dispatch in a compute context. The caller is
+	// responsible for the compute to indirect barrier before draw().
+	void cull(Vulkan::CommandBuffer &cmd, const Frustum &frustum);
+
+	// Issues the culled draws. Requires VK_KHR_draw_indirect_count.
+	void draw(Vulkan::CommandBuffer &cmd) const;
+
+	unsigned get_draw_count() const
+	{
+		return num_draws;
+	}
+
+private:
+	Vulkan::BufferHandle scene_draws;
+	Vulkan::BufferHandle culled_draws;
+	Vulkan::BufferHandle culled_count;
+	unsigned num_draws = 0;
+};
+}
@@ -26,6 +26,11 @@
 #include "render_context.hpp"
 #include "muglm/matrix_helper.hpp"
 #include "transforms.hpp"
+#include "filesystem.hpp"
+#include "path.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#include <string.h>
 
 using namespace Vulkan;
 using namespace std;
@@ -56,12 +61,18 @@ struct PatchInfo
 	const Vulkan::ImageView *base_color;
 	const Vulkan::ImageView *lod_map;
 	const Vulkan::ImageView *type_map;
+	const Vulkan::ImageView *heights_atlas;
+	const Vulkan::ImageView *tile_layer_map;
+	const Vulkan::ImageView *normal_atlas;
+	const Vulkan::ImageView *splat_atlas;
 
 	mat4 push[2];
 
 	vec2 inv_heightmap_size;
 	vec2 tiling_factor;
 	vec2 tangent_scale;
+	vec4 tile_info;
+	vec4 detail_tile_info;
 };
 
 struct GroundVertex
@@ -77,6 +88,8 @@ struct GroundData
 	vec2 uv_tiling_scale;
 	vec2 tangent_scale;
 	vec4 texture_info;
+	vec4 tile_info;
+	vec4 detail_tile_info;
 };
 
 struct PatchData
@@ -110,6 +123,16 @@ static void ground_patch_render(Vulkan::CommandBuffer &cmd, const RenderQueueDat
 	cmd.set_texture(2, 4, *patch.base_color, cmd.get_device().get_stock_sampler(StockSampler::TrilinearWrap));
 	cmd.set_texture(2, 5, *patch.type_map, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
 	cmd.set_texture(2, 6, *patch.normals_fine, cmd.get_device().get_stock_sampler(StockSampler::TrilinearWrap));
+	if (patch.heights_atlas)
+	{
+		cmd.set_texture(2, 7, *patch.heights_atlas, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
+		cmd.set_texture(2, 8, *patch.tile_layer_map, cmd.get_device().get_stock_sampler(StockSampler::NearestClamp));
+	}
+	if (patch.normal_atlas)
+	{
+		cmd.set_texture(2, 9, *patch.normal_atlas, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
+		cmd.set_texture(2, 10, *patch.splat_atlas, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
+	}
 
 	auto *data = static_cast<GroundData *>(cmd.allocate_constant_data(3, 1, sizeof(GroundData)));
 	data->inv_heightmap_size = patch.inv_heightmap_size;
@@ -120,6 +143,8 @@ static void ground_patch_render(Vulkan::CommandBuffer &cmd, const RenderQueueDat
 	data->texture_info.y = float(patch.base_color->get_image().get_height(0));
 	data->texture_info.z = 1.0f / float(patch.base_color->get_image().get_width(0));
 	data->texture_info.w = 1.0f / float(patch.base_color->get_image().get_height(0));
+	data->tile_info = patch.tile_info;
+	data->detail_tile_info = patch.detail_tile_info;
 
 	cmd.push_constants(patch.push, 0, sizeof(patch.push));
 
@@ -207,6 +232,287 @@ void Ground::on_device_created(const DeviceCreatedEvent &created)
 	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
 	image_info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
 	lod_map = device.create_image(image_info, nullptr);
+
+	if (!info.heightmap_tile_dir.empty() && info.heightmap_tile_size)
+		init_streaming(device);
+}
+
+void Ground::init_streaming(Device &device)
+{
+	stream.padded_size = info.heightmap_tile_size + 2;
+
+	ImageCreateInfo atlas_info = {};
+	atlas_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	atlas_info.domain = ImageDomain::Physical;
+	atlas_info.width = stream.padded_size;
+	atlas_info.height = stream.padded_size;
+	atlas_info.depth = 1;
+	atlas_info.layers = info.max_resident_tiles;
+	atlas_info.levels = 1;
+	atlas_info.format = VK_FORMAT_R16_SFLOAT;
+	atlas_info.type = VK_IMAGE_TYPE_2D;
+	atlas_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	atlas_info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// Tiles are written on the transfer queue while the graphics queue
+	// samples other layers, so don't rely on ownership transfers.
+	atlas_info.misc = IMAGE_MISC_CONCURRENT_QUEUE_GRAPHICS_BIT | IMAGE_MISC_CONCURRENT_QUEUE_ASYNC_TRANSFER_BIT;
+	stream.atlas = device.create_image(atlas_info, nullptr);
+
+	ImageCreateInfo layer_map_info = {};
+	layer_map_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	layer_map_info.domain = ImageDomain::Physical;
+	layer_map_info.width = num_patches_x;
+	layer_map_info.height = num_patches_z;
+	layer_map_info.depth = 1;
+	layer_map_info.levels = 1;
+	layer_map_info.format = VK_FORMAT_R16_UINT;
+	layer_map_info.type = VK_IMAGE_TYPE_2D;
+	layer_map_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	layer_map_info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	stream.layer_map = device.create_image(layer_map_info, nullptr);
+
+	// Detail layers ride on the same residency decisions and layer indices as
+	// the heightmap tiles, so the shared layer map stays authoritative.
+	stream.detail_enabled = false;
+	if (info.detail_tile_size && !info.normal_tile_dir.empty() && !info.splat_tile_dir.empty())
+	{
+		stream.detail_padded_size = info.detail_tile_size + 2;
+
+		auto detail_info = atlas_info;
+		detail_info.width = stream.detail_padded_size;
+		detail_info.height = stream.detail_padded_size;
+		detail_info.format = VK_FORMAT_R8G8_UNORM;
+		stream.normal_atlas = device.create_image(detail_info, nullptr);
+		detail_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+		stream.splat_atlas = device.create_image(detail_info, nullptr);
+		stream.detail_enabled = true;
+	}
+
+	stream.patches.clear();
+	stream.patches.resize(num_patches_x * num_patches_z);
+	stream.free_layers.clear();
+	for (unsigned i = 0; i < info.max_resident_tiles; i++)
+		stream.free_layers.push_back(uint16_t(info.max_resident_tiles - 1 - i));
+
+	{
+		lock_guard<mutex> holder{stream.lock};
+		stream.completed.clear();
+	}
+
+	stream.enabled = true;
+}
+
+void Ground::update_streaming(Device &device)
+{
+	// Number of frames a patch must stay beyond stream_out_lod before its
+	// tile is handed back, so a camera hovering at the boundary doesn't
+	// re-request the same tiles every few frames.
+	const unsigned release_frames = 60;
+
+	vector<StreamedTiles::CompletedLoad> ready;
+	{
+		lock_guard<mutex> holder{stream.lock};
+		ready = move(stream.completed);
+		stream.completed.clear();
+	}
+
+	CommandBufferHandle transfer_cmd;
+	for (auto &load : ready)
+	{
+		auto &patch = stream.patches[load.patch_index];
+		patch.loading = false;
+
+		// The read may have failed, the patch may have LODed out again while
+		// the read was in flight, or all layers may have been claimed by
+		// closer patches in the meantime. Drop the payload and let the next
+		// refresh retry if the tile is still wanted.
+		if (load.payload.empty())
+			continue;
+		if (patch_lods[load.patch_index] >= info.stream_out_lod)
+			continue;
+		if (patch.layer != StreamedTiles::NoLayer || stream.free_layers.empty())
+			continue;
+
+		uint16_t layer = stream.free_layers.back();
+		stream.free_layers.pop_back();
+
+		if (!transfer_cmd)
+			transfer_cmd = device.request_command_buffer(CommandBuffer::Type::AsyncTransfer);
+
+		BufferCreateInfo staging_info = {};
+		staging_info.domain = BufferDomain::Host;
+		staging_info.size = load.payload.size() * sizeof(uint16_t);
+		staging_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		auto staging = device.create_buffer(staging_info, load.payload.data());
+
+		// Per-layer barriers. The other layers stay in SHADER_READ_ONLY and
+		// must not be discarded by a whole-image transition.
+		VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		barrier.image = stream.atlas->get_image();
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, layer, 1 };
+		transfer_cmd->barrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                      0, nullptr, 0, nullptr, 1, &barrier);
+
+		transfer_cmd->copy_buffer_to_image(*stream.atlas, *staging, 0, {},
+		                                   { stream.padded_size, stream.padded_size, 1 },
+		                                   0, 0, { VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1 });
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		transfer_cmd->barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		                      0, nullptr, 0, nullptr, 1, &barrier);
+
+		if (stream.detail_enabled)
+		{
+			const struct
+			{
+				const Vulkan::ImageHandle *image;
+				const uint8_t *data;
+				size_t size;
+			} details[] = {
+				{ &stream.normal_atlas, load.normal_payload.data(), load.normal_payload.size() },
+				{ &stream.splat_atlas, load.splat_payload.data(), load.splat_payload.size() },
+			};
+
+			for (auto &detail : details)
+			{
+				BufferCreateInfo detail_staging_info = {};
+				detail_staging_info.domain = BufferDomain::Host;
+				detail_staging_info.size = detail.size;
+				detail_staging_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+				auto detail_staging = device.create_buffer(detail_staging_info, detail.data);
+
+				barrier.image = (*detail.image)->get_image();
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				transfer_cmd->barrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				                      0, nullptr, 0, nullptr, 1, &barrier);
+
+				transfer_cmd->copy_buffer_to_image(**detail.image, *detail_staging, 0, {},
+				                                   { stream.detail_padded_size, stream.detail_padded_size, 1 },
+				                                   0, 0, { VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1 });
+
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				transfer_cmd->barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				                      0, nullptr, 0, nullptr, 1, &barrier);
+			}
+		}
+
+		patch.layer = layer;
+		patch.release_counter = 0;
+	}
+
+	if (transfer_cmd)
+	{
+		// Don't care about dstAccessMask, semaphore takes care of everything.
+		// Heightmap tiles are sampled in vertex, detail tiles in fragment.
+		Semaphore sem;
+		device.submit(transfer_cmd, nullptr, 1, &sem);
+		device.add_wait_semaphore(CommandBuffer::Type::Generic, sem,
+		                          VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, true);
+	}
+
+	unsigned count = num_patches_x * num_patches_z;
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto &patch = stream.patches[i];
+		float lod = patch_lods[i];
+
+		if (lod < info.stream_in_lod)
+		{
+			patch.release_counter = 0;
+			if (patch.layer == StreamedTiles::NoLayer && !patch.loading && !stream.free_layers.empty())
+			{
+				patch.loading = true;
+				unsigned x = i % num_patches_x;
+				unsigned z = i / num_patches_x;
+				auto tile_name = to_string(x) + "_" + to_string(z) + ".raw";
+				auto path = Path::join(info.heightmap_tile_dir, tile_name);
+				size_t expected_size = stream.padded_size * stream.padded_size * sizeof(uint16_t);
+
+				string normal_path, splat_path;
+				size_t normal_size = 0, splat_size = 0;
+				if (stream.detail_enabled)
+				{
+					normal_path = Path::join(info.normal_tile_dir, tile_name);
+					splat_path = Path::join(info.splat_tile_dir, tile_name);
+					normal_size = stream.detail_padded_size * stream.detail_padded_size * 2;
+					splat_size = stream.detail_padded_size * stream.detail_padded_size * 4;
+				}
+
+				// The dropped TaskGroup handle flushes on destruction.
+				Global::thread_group()->create_task(
+						[this, self = reference_from_this(), i, path, expected_size,
+						 normal_path, splat_path, normal_size, splat_size]() {
+							const auto read_raw = [](const string &p, size_t expected, void *out) -> bool {
+								auto file = Global::filesystem()->open(p, FileMode::ReadOnly);
+								if (!file || file->get_size() != expected)
+									return false;
+								auto *mapped = file->map();
+								if (!mapped)
+									return false;
+								memcpy(out, mapped, expected);
+								file->unmap();
+								return true;
+							};
+
+							StreamedTiles::CompletedLoad load;
+							load.patch_index = i;
+							load.payload.resize(expected_size / sizeof(uint16_t));
+							bool ok = read_raw(path, expected_size, load.payload.data());
+
+							// All-or-nothing: the shared layer map cannot express a
+							// tile whose detail layers are missing.
+							if (ok && normal_size)
+							{
+								load.normal_payload.resize(normal_size);
+								load.splat_payload.resize(splat_size);
+								ok = read_raw(normal_path, normal_size, load.normal_payload.data()) &&
+								     read_raw(splat_path, splat_size, load.splat_payload.data());
+							}
+
+							if (!ok)
+							{
+								LOGE("Failed to read terrain tile: %s\n", path.c_str());
+								load.payload.clear();
+								load.normal_payload.clear();
+								load.splat_payload.clear();
+							}
+
+							lock_guard<mutex> holder{stream.lock};
+							stream.completed.push_back(move(load));
+						});
+			}
+		}
+		else if (patch.layer != StreamedTiles::NoLayer)
+		{
+			if (lod > info.stream_out_lod)
+			{
+				if (++patch.release_counter >= release_frames)
+				{
+					stream.free_layers.push_back(patch.layer);
+					patch.layer = StreamedTiles::NoLayer;
+					patch.release_counter = 0;
+				}
+			}
+			else
+			{
+				// Inside the hysteresis band, keep the tile resident.
+				patch.release_counter = 0;
+			}
+		}
+	}
 }
 
 void Ground::build_lod(Device &device, unsigned lod_size, unsigned stride)
@@ -292,6 +598,19 @@ void Ground::on_device_destroyed(const DeviceCreatedEvent &)
 	type_map = nullptr;
 	quad_lod.clear();
 	lod_map.reset();
+
+	stream.enabled = false;
+	stream.detail_enabled = false;
+	stream.atlas.reset();
+	stream.normal_atlas.reset();
+	stream.splat_atlas.reset();
+	stream.layer_map.reset();
+	stream.patches.clear();
+	stream.free_layers.clear();
+	{
+		lock_guard<mutex> holder{stream.lock};
+		stream.completed.clear();
+	}
 }
 
 void Ground::get_render_info(const RenderContext &context, const RenderInfoComponent *transform,
@@ -342,11 +661,41 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 	patch.inv_heightmap_size = vec2(1.0f / size);
 	patch.tiling_factor = tiling_factor;
 
+	if (stream.enabled)
+	{
+		patch.heights_atlas = &stream.atlas->get_view();
+		patch.tile_layer_map = &stream.layer_map->get_view();
+		patch.tile_info = vec4(float(num_patches_x), float(num_patches_z),
+		                       float(info.heightmap_tile_size), 1.0f / float(stream.padded_size));
+	}
+	else
+	{
+		patch.heights_atlas = nullptr;
+		patch.tile_layer_map = nullptr;
+		patch.tile_info = vec4(0.0f);
+	}
+
+	if (stream.detail_enabled)
+	{
+		patch.normal_atlas = &stream.normal_atlas->get_view();
+		patch.splat_atlas = &stream.splat_atlas->get_view();
+		patch.detail_tile_info = vec4(float(num_patches_x), float(num_patches_z),
+		                              float(info.detail_tile_size), 1.0f / float(stream.detail_padded_size));
+	}
+	else
+	{
+		patch.normal_atlas = nullptr;
+		patch.splat_atlas = nullptr;
+		patch.detail_tile_info = vec4(0.0f);
+	}
+
 	Util::Hasher hasher;
 	hasher.string("ground");
 	auto pipe_hash = hasher.get();
 	hasher.s32(base_lod);
 	hasher.s32(info.bandlimited_pixel);
+	hasher.s32(stream.enabled);
+	hasher.s32(stream.detail_enabled);
 	auto sorting_key = RenderInfo::get_sort_key(context, Queue::Opaque, pipe_hash, hasher.get(),
 	                                            transform->world_aabb.get_center(),
 	                                            StaticLayer::Last);
@@ -358,6 +707,16 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 	hasher.u64(base_color_image->get_cookie());
 	hasher.u64(splatmap_image->get_cookie());
 	hasher.u64(lod_map->get_cookie());
+	if (stream.enabled)
+	{
+		hasher.u64(stream.atlas->get_cookie());
+		hasher.u64(stream.layer_map->get_cookie());
+	}
+	if (stream.detail_enabled)
+	{
+		hasher.u64(stream.normal_atlas->get_cookie());
+		hasher.u64(stream.splat_atlas->get_cookie());
+	}
 
 	// Allow promotion to push constant for transforms.
 	// We'll instance a lot of patches belonging to the same ground.
@@ -374,6 +733,10 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 		uint32_t flags = 0;
 		if (info.bandlimited_pixel)
 			flags |= 1u << 0;
+		if (stream.enabled)
+			flags |= 1u << 1;
+		if (stream.detail_enabled)
+			flags |= 1u << 2;
 
 		patch.program = queue.get_shader_suites()[ecast(RenderableType::Ground)].get_program(DrawPipeline::Opaque,
 		                                                                                     MESH_ATTRIBUTE_POSITION_BIT,
@@ -387,6 +750,10 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 void Ground::refresh(RenderContext &context)
 {
 	auto &device = context.get_device();
+
+	if (stream.enabled)
+		update_streaming(device);
+
 	auto cmd = device.request_command_buffer();
 
 	cmd->image_barrier(*lod_map, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -404,6 +771,21 @@ void Ground::refresh(RenderContext &context)
 	cmd->image_barrier(*lod_map, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 	                   VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
 	                   VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	if (stream.enabled)
+	{
+		// Tiny per-patch layer map, rewritten every frame like the LOD map.
+		cmd->image_barrier(*stream.layer_map, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                   VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		                   VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		uint16_t *layers = static_cast<uint16_t *>(cmd->update_image(*stream.layer_map));
+		for (auto &patch : stream.patches)
+			*layers++ = patch.layer;
+		cmd->image_barrier(*stream.layer_map, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                   VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		                   VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
 	device.submit(cmd);
 }
 
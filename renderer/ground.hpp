@@ -25,6 +25,7 @@
 #include "abstract_renderable.hpp"
 #include "scene.hpp"
 #include "application_wsi_events.hpp"
+#include <mutex>
 
 namespace Granite
 {
@@ -98,6 +99,35 @@ public:
 		std::vector<float> patch_lod_bias;
 		std::vector<vec2> patch_range;
 		bool bandlimited_pixel = false;
+
+		// Streamed heightmap residency. When heightmap_tile_dir is non-empty,
+		// the heightmap above acts as an always-resident low-resolution
+		// fallback and full-resolution tiles are streamed in per patch based
+		// on its LOD. A tile is a raw FP16 file named "x_z.raw" holding
+		// heightmap_tile_size texels across plus a one texel apron shared
+		// with its neighbors, so tiles filter seamlessly at patch borders.
+		std::string heightmap_tile_dir;
+		unsigned heightmap_tile_size = 0;
+		unsigned max_resident_tiles = 128;
+		// Hysteresis band. A tile is requested when the patch LOD drops below
+		// stream_in_lod and only released again after the LOD has stayed
+		// above stream_out_lod for a while, so borderline patches don't
+		// thrash the filesystem.
+		float stream_in_lod = 1.0f;
+		float stream_out_lod = 2.0f;
+
+		// Streamed detail layers. When both directories are set alongside
+		// heightmap streaming, the terrain normal and splat layers stream
+		// per-patch tiles through the same residency machinery, with the
+		// always-resident textures as the low-resolution fallback. Tiles are
+		// raw files named like heightmap tiles with the same one texel apron:
+		// RG8 for normals, RGBA8 for splat. This bounds resident memory by
+		// max_resident_tiles without sparse binding; a sparse-residency
+		// virtual texture could replace the atlas indirection once the
+		// backend grows a vkQueueBindSparse path.
+		std::string normal_tile_dir;
+		std::string splat_tile_dir;
+		unsigned detail_tile_size = 0;
 	};
 	Ground(unsigned size, const TerrainInfo &info);
 
@@ -173,6 +203,42 @@ private:
 	unsigned num_patches_z = 0;
 	std::vector<float> patch_lods;
 
+	struct StreamedTiles
+	{
+		enum : uint16_t { NoLayer = 0xffffu };
+		struct Patch
+		{
+			uint16_t layer = NoLayer;
+			uint16_t release_counter = 0;
+			bool loading = false;
+		};
+		struct CompletedLoad
+		{
+			unsigned patch_index;
+			std::vector<uint16_t> payload;
+			// Detail layer payloads sharing the tile's atlas layer.
+			std::vector<uint8_t> normal_payload;
+			std::vector<uint8_t> splat_payload;
+		};
+
+		Vulkan::ImageHandle atlas;
+		Vulkan::ImageHandle normal_atlas;
+		Vulkan::ImageHandle splat_atlas;
+		Vulkan::ImageHandle layer_map;
+		std::vector<Patch> patches;
+		std::vector<uint16_t> free_layers;
+		// Loader tasks push here, update_streaming() drains on the main thread.
+		std::mutex lock;
+		std::vector<CompletedLoad> completed;
+		unsigned padded_size = 0;
+		unsigned detail_padded_size = 0;
+		bool enabled = false;
+		bool detail_enabled = false;
+	} stream;
+
+	void init_streaming(Vulkan::Device &device);
+	void update_streaming(Vulkan::Device &device);
+
 	vec2 tiling_factor = vec2(1.0f);
 };
 }
@@ -0,0 +1,189 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "impostor.hpp"
+#include "device.hpp"
+#include "render_context.hpp"
+#include "shader_suite.hpp"
+#include "transforms.hpp"
+#include "muglm/matrix_helper.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <cmath>
+
+using namespace Vulkan;
+using namespace Util;
+
+namespace Granite
+{
+struct ImpostorRenderInfo
+{
+	Program *program;
+	const ImageView *view;
+
+	struct Push
+	{
+		vec3 center;
+		float radius;
+		vec2 uv_offset;
+		vec2 uv_scale;
+	} push;
+};
+
+static void impostor_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
+{
+	for (unsigned i = 0; i < instances; i++)
+	{
+		auto *info = static_cast<const ImpostorRenderInfo *>(infos[i].render_info);
+
+		cmd.set_program(info->program);
+		cmd.set_texture(2, 0, *info->view, StockSampler::LinearClamp);
+		cmd.push_constants(&info->push, 0, sizeof(info->push));
+		cmd.set_primitive_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP);
+		cmd.draw(4);
+	}
+}
+
+void Impostor::set_atlas(ImageHandle atlas_, unsigned num_views_)
+{
+	atlas = std::move(atlas_);
+	num_views = num_views_ ? num_views_ : 1;
+}
+
+void Impostor::set_bounds(const AABB &aabb)
+{
+	static_aabb = aabb;
+}
+
+void Impostor::set_full_detail(AbstractRenderableHandle renderable, float transition_distance_)
+{
+	full_detail = std::move(renderable);
+	transition_distance = transition_distance_;
+}
+
+void Impostor::get_render_info(const RenderContext &context, const RenderInfoComponent *transform,
+                               RenderQueue &queue) const
+{
+	vec3 center = transform->world_aabb.get_center();
+	vec3 to_camera = context.get_render_parameters().camera_position - center;
+
+	if (full_detail && dot(to_camera, to_camera) < transition_distance * transition_distance)
+	{
+		full_detail->get_render_info(context, transform, queue);
+		return;
+	}
+
+	if (!atlas)
+		return;
+
+	// Pick the baked azimuthal view closest to the current viewing direction.
+	float angle = std::atan2(to_camera.x, to_camera.z);
+	float frac = angle * (0.5f / pi<float>());
+	frac -= muglm::floor(frac);
+	unsigned view_index = unsigned(frac * float(num_views) + 0.5f) % num_views;
+
+	ImpostorRenderInfo info;
+	info.view = &atlas->get_view();
+	info.push.center = center;
+	info.push.radius = transform->world_aabb.get_radius();
+	info.push.uv_scale = vec2(1.0f / float(num_views), 1.0f);
+	info.push.uv_offset = vec2(float(view_index) / float(num_views), 0.0f);
+
+	Hasher h;
+	h.pointer(info.view);
+	h.u32(view_index);
+	h.pointer(transform);
+
+	auto instance_key = h.get();
+	auto sorting_key = RenderInfo::get_sort_key(context, Queue::Transparent, h.get(), h.get(), center);
+
+	auto *impostor_info = queue.push<ImpostorRenderInfo>(Queue::Transparent, instance_key, sorting_key,
+	                                                     impostor_render, nullptr);
+
+	if (impostor_info)
+	{
+		info.program = queue.get_shader_suites()[ecast(RenderableType::Impostor)].get_program(
+				DrawPipeline::AlphaBlend, 0, 0);
+		*impostor_info = info;
+	}
+}
+
+ImageHandle bake_impostor_atlas(Device &device, Renderer &renderer,
+                                const RenderContext &lighting_context,
+                                const VisibilityList &visible, const AABB &aabb,
+                                unsigned num_views, unsigned resolution)
+{
+	ImageCreateInfo info = ImageCreateInfo::render_target(resolution * num_views, resolution,
+	                                                      VK_FORMAT_R8G8B8A8_SRGB);
+	info.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	info.initial_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	auto atlas = device.create_image(info, nullptr);
+	auto cmd = device.request_command_buffer();
+
+	RenderPassInfo rp = {};
+	rp.num_color_attachments = 1;
+	rp.color_attachments[0] = &atlas->get_view();
+	rp.depth_stencil = &device.get_transient_attachment(info.width, info.height,
+	                                                    device.get_default_depth_format());
+	rp.store_attachments = 1 << 0;
+	rp.clear_attachments = 1 << 0;
+	rp.op_flags = RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT;
+
+	cmd->begin_render_pass(rp);
+
+	vec3 center = aabb.get_center();
+	float radius = aabb.get_radius();
+
+	RenderContext view_context;
+	view_context.set_lighting_parameters(lighting_context.get_lighting_parameters());
+
+	for (unsigned i = 0; i < num_views; i++)
+	{
+		// Matches the view selection in get_render_info; tile i sees the group
+		// from azimuth 2pi * i / num_views.
+		float angle = 2.0f * pi<float>() * (float(i) / float(num_views));
+		vec3 dir = vec3(std::sin(angle), 0.0f, std::cos(angle));
+		vec3 eye = center + dir * (2.0f * radius);
+
+		mat4 view = mat4_cast(look_at(-dir, vec3(0.0f, 1.0f, 0.0f))) * translate(-eye);
+		mat4 proj = ortho(AABB(vec3(-radius, -radius, -3.0f * radius),
+		                       vec3(radius, radius, -radius)));
+		view_context.set_camera(proj, view);
+
+		cmd->set_viewport({ float(i * resolution), 0.0f, float(resolution), float(resolution), 0.0f, 1.0f });
+		cmd->set_scissor({{ int(i * resolution), 0 }, { resolution, resolution }});
+
+		renderer.begin();
+		renderer.push_renderables(view_context, visible);
+		renderer.flush(*cmd, view_context);
+	}
+
+	cmd->end_render_pass();
+
+	cmd->image_barrier(*atlas, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+	                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	device.submit(cmd);
+	return atlas;
+}
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "abstract_renderable.hpp"
+#include "renderer.hpp"
+#include "image.hpp"
+
+namespace Granite
+{
+// Flat-card proxy for a group of distant renderables.
+// The atlas holds the group pre-lit from num_views azimuthal directions,
+// and rendering picks the tile closest to the current viewing direction and
+// draws a single camera-facing quad. When a full-detail renderable and a
+// transition distance are set, the proxy forwards to the real geometry once
+// the camera gets close enough, mirroring how StaticMesh selects LODs per
+// draw rather than mutating the scene gather.
+// The proxy renders as alpha-tested blend in the transparent queue and does
+// not cast shadows; groups far enough to be impostors shouldn't be throwing
+// meaningful shadows into the view anyway.
+class Impostor : public AbstractRenderable
+{
+public:
+	void set_atlas(Vulkan::ImageHandle atlas, unsigned num_views);
+	void set_bounds(const AABB &aabb);
+	void set_full_detail(AbstractRenderableHandle renderable, float transition_distance);
+
+	void get_render_info(const RenderContext &context, const RenderInfoComponent *transform,
+	                     RenderQueue &queue) const override;
+
+	void get_depth_render_info(const RenderContext &, const RenderInfoComponent *,
+	                           RenderQueue &) const override
+	{
+	}
+
+	DrawPipeline get_mesh_draw_pipeline() const override
+	{
+		return DrawPipeline::AlphaBlend;
+	}
+
+private:
+	Vulkan::ImageHandle atlas;
+	unsigned num_views = 1;
+	AABB static_aabb = AABB(vec3(0.0f), vec3(0.0f));
+	AbstractRenderableHandle full_detail;
+	float transition_distance = 0.0f;
+
+	bool has_static_aabb() const override
+	{
+		return true;
+	}
+
+	const AABB *get_static_aabb() const override
+	{
+		return &static_aabb;
+	}
+};
+
+// Renders the visibility list pre-lit from num_views azimuthal directions into
+// a horizontal atlas strip (resolution x resolution per view) using a forward
+// renderer. Lighting state is taken from the passed context, so when lighting
+// changes the caller re-bakes dirty atlases incrementally - a few per frame is
+// plenty since impostors only represent distant geometry.
+Vulkan::ImageHandle bake_impostor_atlas(Vulkan::Device &device, Renderer &renderer,
+                                        const RenderContext &lighting_context,
+                                        const VisibilityList &visible, const AABB &aabb,
+                                        unsigned num_views, unsigned resolution);
+}
@@ -30,6 +30,7 @@
 #include "muglm/matrix_helper.hpp"
 #include "thread_group.hpp"
 #include "cpu_rasterizer.hpp"
+#include "simd.hpp"
 #include <string.h>
 
 using namespace Vulkan;
@@ -96,6 +97,8 @@ void LightClusterer::setup_render_pass_dependencies(RenderGraph &, RenderPass &t
 		target_.add_storage_read_only_input("cluster-bitmask");
 		target_.add_storage_read_only_input("cluster-range");
 		target_.add_storage_read_only_input("cluster-transforms");
+		target_.add_storage_read_only_input("cluster-volume-bitmask");
+		target_.add_storage_read_only_input("cluster-volumes");
 	}
 	else
 	{
@@ -115,11 +118,14 @@ void LightClusterer::setup_render_pass_resources(RenderGraph &graph)
 		bindless.bitmask_buffer = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-bitmask"));
 		bindless.range_buffer = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-range"));
 		bindless.transforms_buffer = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-transforms"));
+		bindless.volume_bitmask_buffer = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-volume-bitmask"));
+		bindless.volume_data_buffer = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-volumes"));
 
 		if (!ImplementationQuirks::get().clustering_force_cpu)
 		{
 			bindless.transformed_spots = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-transformed-spot"));
 			bindless.cull_data = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-cull-setup"));
+			bindless.light_z_range = &graph.get_physical_buffer_resource(graph.get_buffer_resource("cluster-light-z-range"));
 		}
 	}
 	else
@@ -190,6 +196,26 @@ const Vulkan::Buffer *LightClusterer::get_cluster_range_buffer() const
 	return bindless.range_buffer;
 }
 
+const Vulkan::Buffer *LightClusterer::get_cluster_volume_bitmask_buffer() const
+{
+	return bindless.volume_bitmask_buffer;
+}
+
+const Vulkan::Buffer *LightClusterer::get_cluster_volume_data_buffer() const
+{
+	return bindless.volume_data_buffer;
+}
+
+void LightClusterer::set_decal_volumes(const DecalVolume *decals, unsigned count)
+{
+	decal_volumes.assign(decals, decals + count);
+}
+
+void LightClusterer::set_reflection_probe_volumes(const ReflectionProbeVolume *probes, unsigned count)
+{
+	probe_volumes.assign(probes, probes + count);
+}
+
 VkDescriptorSet LightClusterer::get_cluster_shadow_map_bindless_set() const
 {
 	return bindless.desc_set;
@@ -245,6 +271,18 @@ const mat4 &LightClusterer::get_cluster_transform() const
 	return legacy.cluster_transform;
 }
 
+// Shadow map contents only depend on where the light sits and what it covers.
+// Color or bias tweaks on a light must not retrigger a shadow render.
+static Util::Hash shadow_state_hash(const PositionalFragmentInfo &light)
+{
+	Util::Hasher h;
+	h.data(&light.position.x, sizeof(light.position));
+	h.data(&light.direction.x, sizeof(light.direction));
+	h.f32(light.inv_radius);
+	h.f32(light.spot_scale);
+	return h.get();
+}
+
 template <typename T>
 static uint32_t reassign_indices_legacy(T &type)
 {
@@ -265,6 +303,7 @@ static uint32_t reassign_indices_legacy(T &type)
 				// Reuse the shadow data from the atlas.
 				swap(type.cookie[i], type.cookie[index]);
 				swap(type.shadow_transforms[i], type.shadow_transforms[index]);
+				swap(type.shadow_hash[i], type.shadow_hash[index]);
 				swap(type.index_remap[i], type.index_remap[index]);
 			}
 		}
@@ -282,17 +321,23 @@ static uint32_t reassign_indices_legacy(T &type)
 					// Reuse the shadow data from the atlas.
 					swap(type.cookie[i], type.cookie[index]);
 					swap(type.shadow_transforms[i], type.shadow_transforms[index]);
+					swap(type.shadow_hash[i], type.shadow_hash[index]);
 					swap(type.index_remap[i], type.index_remap[index]);
 				}
 			}
 		}
 
-		if (type.handles[i]->get_cookie() != type.cookie[i])
+		// A light which moved needs its atlas tile re-rendered even if it
+		// kept its slot; static lights keep hitting this path and their tile
+		// is left untouched.
+		Util::Hash hash = shadow_state_hash(type.lights[i]);
+		if (type.handles[i]->get_cookie() != type.cookie[i] || type.shadow_hash[i] != hash)
 			partial_mask |= 1u << i;
 		else
 			type.handles[i]->set_shadow_info(&type.atlas->get_view(), type.shadow_transforms[i]);
 
 		type.cookie[i] = type.handles[i]->get_cookie();
+		type.shadow_hash[i] = hash;
 	}
 
 	return partial_mask;
@@ -643,13 +688,16 @@ void LightClusterer::begin_bindless_barriers(Vulkan::CommandBuffer &cmd)
 	{
 		bool point = bindless_light_is_point(i);
 		auto cookie = bindless.handles[i]->get_cookie();
-		auto &image = *bindless.shadow_map_cache.allocate(cookie,
+		auto &entry = *bindless.shadow_map_cache.allocate(cookie,
 		                                                  shadow_resolution * shadow_resolution *
 		                                                  (point ? 6 : 1) *
 		                                                  (vsm ? 8 : 2));
+		auto &image = entry.image;
 
-		if (image && !force_update_shadows)
+		Util::Hash hash = shadow_state_hash(bindless.transforms.lights[i]);
+		if (image && entry.state_hash == hash && !force_update_shadows)
 			continue;
+		entry.state_hash = hash;
 
 		if (!image)
 		{
@@ -890,17 +938,13 @@ void LightClusterer::refresh_legacy(RenderContext& context_)
 {
 	legacy.points.count = 0;
 	legacy.spots.count = 0;
-	auto &frustum = context_.get_visibility_frustum();
 
+	// light_sort_cache was already frustum culled in refresh().
 	for (auto &light : light_sort_cache)
 	{
 		auto &l = *light.first;
 		auto *transform = light.second;
 
-		// Frustum cull lights here.
-		if (!frustum.intersects(transform->world_aabb))
-			continue;
-
 		if (l.get_type() == PositionalLight::Type::Spot)
 		{
 			auto &spot = static_cast<SpotLight &>(l);
@@ -963,19 +1007,15 @@ void LightClusterer::refresh_legacy(RenderContext& context_)
 void LightClusterer::refresh_bindless(RenderContext &context_)
 {
 	bindless.count = 0;
-	auto &frustum = context_.get_visibility_frustum();
 	unsigned index = 0;
 	memset(bindless.transforms.type_mask, 0, sizeof(bindless.transforms.type_mask));
 
+	// light_sort_cache was already frustum culled in refresh().
 	for (auto &light : light_sort_cache)
 	{
 		auto &l = *light.first;
 		auto *transform = light.second;
 
-		// Frustum cull lights here.
-		if (!frustum.intersects(transform->world_aabb))
-			continue;
-
 		if (l.get_type() == PositionalLight::Type::Spot)
 		{
 			auto &spot = static_cast<SpotLight &>(l);
@@ -1026,7 +1066,68 @@ void LightClusterer::refresh_bindless(RenderContext &context_)
 	bindless.parameters.num_lights = bindless.count;
 	bindless.parameters.num_lights_32 = (bindless.parameters.num_lights + 31) / 32;
 
-	bindless.shadow_map_cache.set_total_cost(64 * 1024 * 1024);
+	// Decals and reflection probes share the froxel grid with the lights.
+	// Counts are small, so they are culled and packed on the CPU every frame.
+	bindless.volume_models.clear();
+	static const AABB unit_cube(vec3(-1.0f), vec3(1.0f));
+
+	unsigned num_decals = 0;
+	for (auto &decal : decal_volumes)
+	{
+		if (num_decals >= MaxDecalsBindless)
+			break;
+		if (!frustum.intersects(unit_cube.transform(decal.model)))
+			continue;
+
+		auto &info = bindless.volumes.decals[num_decals];
+		info.world_to_decal = inverse(decal.model);
+		info.payload = decal.payload;
+		bindless.volume_models.push_back(decal.model);
+		num_decals++;
+	}
+
+	unsigned num_probes = 0;
+	for (auto &probe : probe_volumes)
+	{
+		if (num_probes >= MaxProbesBindless)
+			break;
+		if (!frustum.intersects(unit_cube.transform(probe.model)))
+			continue;
+
+		auto &info = bindless.volumes.probes[num_probes];
+		info.world_to_probe = inverse(probe.model);
+		// Bounding sphere of the transformed unit cube.
+		// Assumes an orthogonal basis, which box volumes always have.
+		info.position_radius = vec4(probe.model[3].xyz(),
+		                            muglm::sqrt(dot(probe.model[0].xyz(), probe.model[0].xyz()) +
+		                                        dot(probe.model[1].xyz(), probe.model[1].xyz()) +
+		                                        dot(probe.model[2].xyz(), probe.model[2].xyz())));
+		info.payload = probe.payload;
+		bindless.volume_models.push_back(probe.model);
+		num_probes++;
+	}
+
+	bindless.parameters.num_decals = num_decals;
+	bindless.parameters.num_decals_32 = (num_decals + 31) / 32;
+	bindless.parameters.num_probes = num_probes;
+	bindless.parameters.num_probes_32 = (num_probes + 31) / 32;
+
+	// Size the shadow map cache against what the device can actually spare
+	// rather than a fixed constant. The reported budget already shrinks when
+	// other processes or the driver take memory, so heavy scenes on small GPUs
+	// evict harder while big GPUs keep more maps resident across camera cuts.
+	auto &cache_device = context_.get_device();
+	const auto &mem_props = cache_device.get_memory_properties();
+	Vulkan::HeapBudget budget[VK_MAX_MEMORY_HEAPS] = {};
+	cache_device.get_memory_budget(budget);
+
+	uint64_t shadow_budget = 64 * 1024 * 1024;
+	for (uint32_t i = 0; i < mem_props.memoryHeapCount; i++)
+		if ((mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 &&
+		    budget[i].budget_size / 16 > shadow_budget)
+			shadow_budget = budget[i].budget_size / 16;
+
+	bindless.shadow_map_cache.set_total_cost(shadow_budget);
 	uint64_t total_pruned = bindless.shadow_map_cache.prune();
 	if (total_pruned)
 		LOGI("Clusterer pruned a total of %llu bytes.\n", static_cast<unsigned long long>(total_pruned));
@@ -1049,10 +1150,50 @@ void LightClusterer::refresh_bindless(RenderContext &context_)
 
 void LightClusterer::refresh(RenderContext &context_)
 {
-	light_sort_cache.clear();
-	light_sort_cache.reserve(lights->size());
+	size_t count = lights->size();
+
+	// Batched frustum precull. Testing candidate AABBs in SoA form amortizes
+	// the plane loads over whole SIMD registers, and culling before the sort
+	// means only surviving lights pay for the depth comparator.
+	precull.center_x.clear();
+	precull.center_y.clear();
+	precull.center_z.clear();
+	precull.extent_x.clear();
+	precull.extent_y.clear();
+	precull.extent_z.clear();
+	precull.center_x.reserve(count);
+	precull.center_y.reserve(count);
+	precull.center_z.reserve(count);
+	precull.extent_x.reserve(count);
+	precull.extent_y.reserve(count);
+	precull.extent_z.reserve(count);
+
 	for (auto &light : *lights)
 	{
+		auto &aabb = get_component<RenderInfoComponent>(light)->world_aabb;
+		vec3 center = aabb.get_center();
+		vec3 extent = 0.5f * (aabb.get_maximum() - aabb.get_minimum());
+		precull.center_x.push_back(center.x);
+		precull.center_y.push_back(center.y);
+		precull.center_z.push_back(center.z);
+		precull.extent_x.push_back(extent.x);
+		precull.extent_y.push_back(extent.y);
+		precull.extent_z.push_back(extent.z);
+	}
+
+	precull.visibility.resize((count + 31) / 32);
+	SIMD::frustum_cull_soa(precull.visibility.data(),
+	                       precull.center_x.data(), precull.center_y.data(), precull.center_z.data(),
+	                       precull.extent_x.data(), precull.extent_y.data(), precull.extent_z.data(),
+	                       count, context_.get_visibility_frustum().get_planes());
+
+	light_sort_cache.clear();
+	light_sort_cache.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if ((precull.visibility[i >> 5] & (1u << (i & 31u))) == 0)
+			continue;
+		auto &light = (*lights)[i];
 		light_sort_cache.emplace_back(get_component<PositionalLightComponent>(light)->light,
 		                              get_component<RenderInfoComponent>(light));
 	}
@@ -1158,9 +1299,9 @@ void LightClusterer::update_bindless_descriptors(Vulkan::CommandBuffer &cmd)
 	{
 		for (unsigned i = 0; i < bindless.count; i++)
 		{
-			auto *image = bindless.shadow_map_cache.find_and_mark_as_recent(bindless.handles[i]->get_cookie());
-			assert(image);
-			bindless.descriptor_pool->set_texture(i, (*image)->get_view());
+			auto *entry = bindless.shadow_map_cache.find_and_mark_as_recent(bindless.handles[i]->get_cookie());
+			assert(entry);
+			bindless.descriptor_pool->set_texture(i, entry->image->get_view());
 		}
 	}
 
@@ -1223,14 +1364,15 @@ void LightClusterer::update_bindless_range_buffer_gpu(Vulkan::CommandBuffer &cmd
 	if (bindless.light_index_range.empty())
 		bindless.light_index_range.push_back(uvec2(~0u, 0u));
 
-	BufferCreateInfo info;
-	info.domain = BufferDomain::Host;
-	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-	info.size = bindless.light_index_range.size() * sizeof(uvec2);
-	auto buffer = cmd.get_device().create_buffer(info, bindless.light_index_range.data());
+	VkDeviceSize upload_size = bindless.light_index_range.size() * sizeof(uvec2);
+	memcpy(cmd.update_buffer(*bindless.light_z_range, 0, upload_size),
+	       bindless.light_index_range.data(), upload_size);
+
+	cmd.barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
 
 	cmd.set_program("builtin://shaders/lights/clusterer_bindless_z_range.comp");
-	cmd.set_storage_buffer(0, 0, *buffer);
+	cmd.set_storage_buffer(0, 0, *bindless.light_z_range);
 	cmd.set_storage_buffer(0, 1, *bindless.range_buffer);
 
 	assert((resolution_z & 63) == 0);
@@ -1539,6 +1681,121 @@ void LightClusterer::update_bindless_mask_buffer_cpu(Vulkan::CommandBuffer &cmd)
 	}
 }
 
+void LightClusterer::update_bindless_volume_mask(uint32_t *masks, const mat4 &model, unsigned bit_index)
+{
+	unsigned stride_32 = bindless.parameters.num_decals_32 + bindless.parameters.num_probes_32;
+
+	static const vec4 cube_points[8] = {
+			vec4(-1.0f, -1.0f, -1.0f, 1.0f),
+			vec4(+1.0f, -1.0f, -1.0f, 1.0f),
+			vec4(-1.0f, +1.0f, -1.0f, 1.0f),
+			vec4(+1.0f, +1.0f, -1.0f, 1.0f),
+			vec4(-1.0f, -1.0f, +1.0f, 1.0f),
+			vec4(+1.0f, -1.0f, +1.0f, 1.0f),
+			vec4(-1.0f, +1.0f, +1.0f, 1.0f),
+			vec4(+1.0f, +1.0f, +1.0f, 1.0f),
+	};
+
+	auto &camera_pos = context->get_render_parameters().camera_position;
+	auto &camera_front = context->get_render_parameters().camera_front;
+
+	float lo = std::numeric_limits<float>::infinity();
+	float hi = -lo;
+	for (auto &p : cube_points)
+	{
+		float z = dot((model * p).xyz() - camera_pos, camera_front);
+		lo = muglm::min(lo, z);
+		hi = muglm::max(hi, z);
+	}
+
+	Rasterizer::CullMode cull;
+	if (lo <= context->get_render_parameters().z_near && hi >= context->get_render_parameters().z_far)
+		cull = Rasterizer::CullMode::Both;
+	else if (lo <= context->get_render_parameters().z_near)
+		cull = Rasterizer::CullMode::Back;
+	else
+		cull = Rasterizer::CullMode::Front;
+
+	if (cull != Rasterizer::CullMode::Both)
+	{
+		auto mvp = context->get_render_parameters().view_projection * model;
+		vec4 clip[8];
+		Rasterizer::transform_vertices(clip, cube_points, 8, mvp);
+
+		static const unsigned indices[12 * 3] = {
+				0, 2, 3, 0, 3, 1,
+				4, 5, 7, 4, 7, 6,
+				0, 4, 6, 0, 6, 2,
+				1, 3, 7, 1, 7, 5,
+				0, 1, 5, 0, 5, 4,
+				2, 6, 7, 2, 7, 3,
+		};
+
+		vector<uvec2> coverage;
+		Rasterizer::rasterize_conservative_triangles(coverage, clip,
+		                                             indices, sizeof(indices) / sizeof(indices[0]),
+		                                             uvec2(resolution_x, resolution_y),
+		                                             cull);
+
+		for (auto &cov : coverage)
+		{
+			unsigned linear_coord = cov.y * resolution_x + cov.x;
+			auto *tile_list = masks + linear_coord * stride_32;
+			tile_list[bit_index >> 5] |= 1u << (bit_index & 31);
+		}
+	}
+	else
+	{
+		for (unsigned y = 0; y < resolution_y; y++)
+		{
+			for (unsigned x = 0; x < resolution_x; x++)
+			{
+				unsigned linear_coord = y * resolution_x + x;
+				auto *tile_list = masks + linear_coord * stride_32;
+				tile_list[bit_index >> 5] |= 1u << (bit_index & 31);
+			}
+		}
+	}
+}
+
+void LightClusterer::update_bindless_volume_buffers(Vulkan::CommandBuffer &cmd)
+{
+	unsigned num_decals = bindless.parameters.num_decals;
+	unsigned num_probes = bindless.parameters.num_probes;
+	if (num_decals == 0 && num_probes == 0)
+		return;
+
+	if (num_decals != 0)
+	{
+		memcpy(cmd.update_buffer(*bindless.volume_data_buffer,
+		                         offsetof(ClustererBindlessVolumes, decals),
+		                         num_decals * sizeof(ClusteredDecalInfo)),
+		       bindless.volumes.decals, num_decals * sizeof(ClusteredDecalInfo));
+	}
+
+	if (num_probes != 0)
+	{
+		memcpy(cmd.update_buffer(*bindless.volume_data_buffer,
+		                         offsetof(ClustererBindlessVolumes, probes),
+		                         num_probes * sizeof(ClusteredProbeInfo)),
+		       bindless.volumes.probes, num_probes * sizeof(ClusteredProbeInfo));
+	}
+
+	// Volume counts are small compared to lights, so bin them on the CPU in
+	// both clustering paths rather than growing the GPU binning kernels.
+	// The masks are binned in XY only; there is no per-volume Z range.
+	unsigned stride_32 = bindless.parameters.num_decals_32 + bindless.parameters.num_probes_32;
+	size_t size = stride_32 * sizeof(uint32_t) * resolution_x * resolution_y;
+	auto *masks = static_cast<uint32_t *>(cmd.update_buffer(*bindless.volume_bitmask_buffer, 0, size));
+	memset(masks, 0, size);
+
+	for (unsigned i = 0; i < num_decals; i++)
+		update_bindless_volume_mask(masks, bindless.volume_models[i], i);
+	for (unsigned i = 0; i < num_probes; i++)
+		update_bindless_volume_mask(masks, bindless.volume_models[num_decals + i],
+		                            bindless.parameters.num_decals_32 * 32 + i);
+}
+
 void LightClusterer::update_bindless_mask_buffer_gpu(Vulkan::CommandBuffer &cmd)
 {
 	if (bindless.parameters.num_lights == 0)
@@ -1652,11 +1909,13 @@ void LightClusterer::build_cluster_bindless_cpu(Vulkan::CommandBuffer &cmd)
 	update_bindless_descriptors(cmd);
 	update_bindless_range_buffer_cpu(cmd);
 	update_bindless_mask_buffer_cpu(cmd);
+	update_bindless_volume_buffers(cmd);
 }
 
 void LightClusterer::build_cluster_bindless_gpu(Vulkan::CommandBuffer &cmd)
 {
 	update_bindless_descriptors(cmd);
+	update_bindless_volume_buffers(cmd);
 	update_bindless_mask_buffer_gpu(cmd);
 	update_bindless_range_buffer_gpu(cmd);
 }
@@ -1965,7 +2224,7 @@ void LightClusterer::add_render_passes_bindless(RenderGraph &graph)
 		att.persistent = true;
 		att.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-		auto &pass = graph.add_pass("clustering", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+		auto &pass = graph.add_pass("clustering", RenderGraph::get_default_compute_queue());
 
 		{
 			att.size = resolution_x * resolution_y * (MaxLightsBindless / 8);
@@ -1982,6 +2241,16 @@ void LightClusterer::add_render_passes_bindless(RenderGraph &graph)
 			pass.add_transfer_output("cluster-transforms", att);
 		}
 
+		{
+			att.size = resolution_x * resolution_y * ((MaxDecalsBindless + MaxProbesBindless) / 8);
+			pass.add_transfer_output("cluster-volume-bitmask", att);
+		}
+
+		{
+			att.size = sizeof(ClustererBindlessVolumes);
+			pass.add_transfer_output("cluster-volumes", att);
+		}
+
 		pass.set_build_render_pass([&](CommandBuffer &cmd) {
 			build_cluster_bindless_cpu(cmd);
 		});
@@ -1995,7 +2264,7 @@ void LightClusterer::add_render_passes_bindless(RenderGraph &graph)
 		att.persistent = true;
 		att.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-		auto &pass = graph.add_pass("clustering", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+		auto &pass = graph.add_pass("clustering", RenderGraph::get_default_compute_queue());
 
 		{
 			att.size = resolution_x * resolution_y * (MaxLightsBindless / 8);
@@ -2022,6 +2291,21 @@ void LightClusterer::add_render_passes_bindless(RenderGraph &graph)
 			pass.add_storage_output("cluster-transformed-spot", att);
 		}
 
+		{
+			att.size = sizeof(uvec2) * MaxLightsBindless;
+			pass.add_transfer_output("cluster-light-z-range", att);
+		}
+
+		{
+			att.size = resolution_x * resolution_y * ((MaxDecalsBindless + MaxProbesBindless) / 8);
+			pass.add_transfer_output("cluster-volume-bitmask", att);
+		}
+
+		{
+			att.size = sizeof(ClustererBindlessVolumes);
+			pass.add_transfer_output("cluster-volumes", att);
+		}
+
 		pass.set_build_render_pass([&](CommandBuffer &cmd) {
 			build_cluster_bindless_gpu(cmd);
 		});
@@ -2048,10 +2332,10 @@ void LightClusterer::add_render_passes_legacy(RenderGraph &graph)
 	if (ImplementationQuirks::get().clustering_list_iteration || ImplementationQuirks::get().clustering_force_cpu)
 	{
 #ifdef CLUSTERER_FORCE_TRANSFER_UPDATE
-		auto &pass = graph.add_pass("clustering", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+		auto &pass = graph.add_pass("clustering", RenderGraph::get_default_compute_queue());
 		pass.add_blit_texture_output("light-cluster", att);
 #else
-		auto &pass = graph.add_pass("clustering", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+		auto &pass = graph.add_pass("clustering", RenderGraph::get_default_compute_queue());
 		pass.add_storage_texture_output("light-cluster", att);
 #endif
 		pass.set_build_render_pass([this](Vulkan::CommandBuffer &cmd) {
@@ -2075,7 +2359,7 @@ void LightClusterer::add_render_passes_legacy(RenderGraph &graph)
 		att_prepass.size_y /= ClusterPrepassDownsample;
 		att_prepass.size_z /= ClusterPrepassDownsample;
 
-		auto &pass = graph.add_pass("clustering", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+		auto &pass = graph.add_pass("clustering", RenderGraph::get_default_compute_queue());
 		pass.add_storage_texture_output("light-cluster", att);
 		pass.add_storage_texture_output("light-cluster-prepass", att_prepass);
 		pass.set_build_render_pass([this](Vulkan::CommandBuffer &cmd) {
@@ -70,9 +70,32 @@ public:
 	const Vulkan::Buffer *get_cluster_transform_buffer() const;
 	const Vulkan::Buffer *get_cluster_bitmask_buffer() const;
 	const Vulkan::Buffer *get_cluster_range_buffer() const;
+	const Vulkan::Buffer *get_cluster_volume_bitmask_buffer() const;
+	const Vulkan::Buffer *get_cluster_volume_data_buffer() const;
 	VkDescriptorSet get_cluster_shadow_map_bindless_set() const;
 	bool clusterer_is_bindless() const;
 
+	// Decals and reflection probes are binned into the same froxel grid as
+	// the positional lights (bindless clustering only). There are no scene
+	// components for these yet, so volumes are registered explicitly and
+	// rebinned every frame alongside the lights.
+	struct DecalVolume
+	{
+		// Transforms the [-1, 1] unit cube into world space.
+		mat4 model;
+		// Passed through untouched, e.g. bindless texture indices.
+		uvec4 payload;
+	};
+
+	struct ReflectionProbeVolume
+	{
+		mat4 model;
+		uvec4 payload;
+	};
+
+	void set_decal_volumes(const DecalVolume *decals, unsigned count);
+	void set_reflection_probe_volumes(const ReflectionProbeVolume *probes, unsigned count);
+
 	void set_scene(Scene *scene) override;
 	void set_base_renderer(Renderer *forward_renderer, Renderer *deferred_renderer, Renderer *depth_renderer) override;
 	void set_base_render_context(const RenderContext *context) override;
@@ -80,6 +103,8 @@ public:
 	enum {
 		MaxLights = CLUSTERER_MAX_LIGHTS,
 		MaxLightsBindless = CLUSTERER_MAX_LIGHTS_BINDLESS,
+		MaxDecalsBindless = CLUSTERER_MAX_DECALS_BINDLESS,
+		MaxProbesBindless = CLUSTERER_MAX_PROBES_BINDLESS,
 		ClusterHierarchies = 8,
 		ClusterPrepassDownsample = 4
 	};
@@ -110,10 +135,21 @@ private:
 	const ComponentGroupVector<PositionalLightComponent, RenderInfoComponent> *lights = nullptr;
 	std::vector<std::pair<PositionalLight *, const RenderInfoComponent *>> light_sort_cache;
 
+	// Scratch SoA arrays for the batched frustum precull in refresh().
+	// Kept as members so their capacity persists across frames.
+	struct
+	{
+		std::vector<float> center_x, center_y, center_z;
+		std::vector<float> extent_x, extent_y, extent_z;
+		std::vector<uint32_t> visibility;
+	} precull;
+
 	unsigned resolution_x = 64, resolution_y = 32, resolution_z = 16;
 	unsigned shadow_resolution = 512;
 	unsigned max_spot_lights = MaxLights;
 	unsigned max_point_lights = MaxLights;
+	std::vector<DecalVolume> decal_volumes;
+	std::vector<ReflectionProbeVolume> probe_volumes;
 	void build_cluster(Vulkan::CommandBuffer &cmd, Vulkan::ImageView &view, const Vulkan::ImageView *pre_culled);
 	void build_cluster_cpu(Vulkan::CommandBuffer &cmd, Vulkan::ImageView &view);
 	void build_cluster_bindless_cpu(Vulkan::CommandBuffer &cmd);
@@ -130,6 +166,7 @@ private:
 			PointTransform shadow_transforms[MaxLights] = {};
 			vec4 model_transforms[MaxLights] = {};
 			unsigned cookie[MaxLights] = {};
+			Util::Hash shadow_hash[MaxLights] = {};
 			unsigned count = 0;
 			uint8_t index_remap[MaxLights];
 			Vulkan::ImageHandle atlas;
@@ -141,6 +178,7 @@ private:
 			SpotLight *handles[MaxLights] = {};
 			mat4 shadow_transforms[MaxLights] = {};
 			unsigned cookie[MaxLights] = {};
+			Util::Hash shadow_hash[MaxLights] = {};
 			unsigned count = 0;
 			uint8_t index_remap[MaxLights];
 			Vulkan::ImageHandle atlas;
@@ -211,17 +249,31 @@ private:
 		unsigned count = 0;
 		ClustererParametersBindless parameters;
 		ClustererBindlessTransforms transforms;
+		ClustererBindlessVolumes volumes;
+		// Models of the culled volumes, decals first, then probes.
+		std::vector<mat4> volume_models;
 		PositionalLight *handles[MaxLightsBindless] = {};
 
 		Vulkan::BindlessDescriptorPoolHandle descriptor_pool;
-		Util::LRUCache<Vulkan::ImageHandle> shadow_map_cache;
+
+		// Static lights render their shadow map once and keep hitting the
+		// cache; only lights whose shadow state actually changed re-render.
+		struct ShadowMapCacheEntry
+		{
+			Vulkan::ImageHandle image;
+			Util::Hash state_hash = 0;
+		};
+		Util::LRUCache<ShadowMapCacheEntry> shadow_map_cache;
 
 		const Vulkan::Buffer *bitmask_buffer = nullptr;
 		const Vulkan::Buffer *range_buffer = nullptr;
 		const Vulkan::Buffer *transforms_buffer = nullptr;
+		const Vulkan::Buffer *volume_bitmask_buffer = nullptr;
+		const Vulkan::Buffer *volume_data_buffer = nullptr;
 
 		const Vulkan::Buffer *transformed_spots = nullptr;
 		const Vulkan::Buffer *cull_data = nullptr;
+		const Vulkan::Buffer *light_z_range = nullptr;
 
 		VkDescriptorSet desc_set = VK_NULL_HANDLE;
 
@@ -240,6 +292,8 @@ private:
 	void update_bindless_mask_buffer_gpu(Vulkan::CommandBuffer &cmd);
 	void update_bindless_mask_buffer_spot(uint32_t *masks, unsigned index);
 	void update_bindless_mask_buffer_point(uint32_t *masks, unsigned index);
+	void update_bindless_volume_buffers(Vulkan::CommandBuffer &cmd);
+	void update_bindless_volume_mask(uint32_t *masks, const mat4 &model, unsigned bit_index);
 	void begin_bindless_barriers(Vulkan::CommandBuffer &cmd);
 	void end_bindless_barriers(Vulkan::CommandBuffer &cmd);
 	void render_bindless_spot(Vulkan::CommandBuffer &cmd, unsigned index);
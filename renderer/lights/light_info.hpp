@@ -42,4 +42,19 @@ struct PositionalFragmentInfo
 	float inv_radius;
 };
 static_assert(sizeof(PositionalFragmentInfo) == 48, "PositionFragmentInfo is not 48 bytes.");
+
+struct ClusteredDecalInfo
+{
+	mat4 world_to_decal;
+	uvec4 payload;
+};
+static_assert(sizeof(ClusteredDecalInfo) == 80, "ClusteredDecalInfo is not 80 bytes.");
+
+struct ClusteredProbeInfo
+{
+	mat4 world_to_probe;
+	vec4 position_radius;
+	uvec4 payload;
+};
+static_assert(sizeof(ClusteredProbeInfo) == 96, "ClusteredProbeInfo is not 96 bytes.");
 }
\ No newline at end of file
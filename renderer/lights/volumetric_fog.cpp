@@ -52,6 +52,8 @@ void VolumetricFog::on_device_created(const DeviceCreatedEvent &)
 void VolumetricFog::on_device_destroyed(const DeviceCreatedEvent &)
 {
 	dither_lut.reset();
+	worklist_buffer.reset();
+	worklist_max_blocks = 0;
 }
 
 void VolumetricFog::set_z_range(float range)
@@ -155,14 +157,15 @@ void VolumetricFog::build_light_density(CommandBuffer &cmd, ImageView &light_den
 	push.dither_offset = float(dither_offset & 1023);
 	dither_offset++;
 
-	cmd.push_constants(&push, 0, sizeof(push));
-
 	auto flags = Renderer::get_mesh_renderer_options_from_lighting(*context->get_lighting_parameters());
 	flags &= ~Renderer::VOLUMETRIC_FOG_ENABLE_BIT;
-	auto defines = Renderer::build_defines_from_renderer_options(RendererType::GeneralForward, flags);
+
+	vector<pair<string, int>> extra_defines;
 	if (light_density_history)
 	{
-		defines.emplace_back("TEMPORAL_REPROJECTION", 1);
+		extra_defines.emplace_back("TEMPORAL_REPROJECTION", 1);
+		if (temporal_subset_update)
+			extra_defines.emplace_back("SUBSET_UPDATE", 1);
 		cmd.set_texture(2, 5, *light_density_history, StockSampler::LinearClamp);
 
 		struct Temporal
@@ -177,32 +180,36 @@ void VolumetricFog::build_light_density(CommandBuffer &cmd, ImageView &light_den
 				context->get_render_parameters().inv_projection[3].zw());
 	}
 
-	if (flags & Renderer::POSITIONAL_LIGHT_ENABLE_BIT)
-	{
-		// Try to enable wave-optimizations.
-		static const VkSubgroupFeatureFlags required_subgroup =
-				VK_SUBGROUP_FEATURE_BALLOT_BIT |
-				VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
-
-		auto &subgroup = cmd.get_device().get_device_features().subgroup_properties;
-		if ((subgroup.supportedStages & VK_SHADER_STAGE_FRAGMENT_BIT) != 0 &&
-		    !ImplementationQuirks::get().force_no_subgroups &&
-		    (subgroup.supportedOperations & required_subgroup) == required_subgroup)
-		{
-			defines.emplace_back("CLUSTERING_WAVE_UNIFORM", 1);
-		}
-	}
-
 	old_projection = context->get_render_parameters().view_projection;
 
 	if (floor.input_view)
 	{
-		defines.emplace_back("FLOOR_LIGHTING", 1);
+		extra_defines.emplace_back("FLOOR_LIGHTING", 1);
 		cmd.set_texture(2, 7, *floor.input_view, Vulkan::StockSampler::TrilinearWrap);
 		*cmd.allocate_typed_constant_data<FloorLighting>(2, 8, 1) = floor.info;
 	}
 
-	cmd.set_program("builtin://shaders/lights/fog_light_density.comp", defines);
+	const auto build_defines = [&](Renderer::RendererOptionFlags variant_flags) {
+		auto defines = Renderer::build_defines_from_renderer_options(RendererType::GeneralForward, variant_flags);
+		if (variant_flags & Renderer::POSITIONAL_LIGHT_ENABLE_BIT)
+		{
+			// Try to enable wave-optimizations.
+			static const VkSubgroupFeatureFlags required_subgroup =
+					VK_SUBGROUP_FEATURE_BALLOT_BIT |
+					VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+
+			auto &subgroup = cmd.get_device().get_device_features().subgroup_properties;
+			if ((subgroup.supportedStages & VK_SHADER_STAGE_FRAGMENT_BIT) != 0 &&
+			    !ImplementationQuirks::get().force_no_subgroups &&
+			    (subgroup.supportedOperations & required_subgroup) == required_subgroup)
+			{
+				defines.emplace_back("CLUSTERING_WAVE_UNIFORM", 1);
+			}
+		}
+		defines.insert(defines.end(), extra_defines.begin(), extra_defines.end());
+		return defines;
+	};
+
 	Renderer::bind_global_parameters(cmd, *context);
 	Renderer::bind_lighting_parameters(cmd, *context);
 
@@ -215,7 +222,73 @@ void VolumetricFog::build_light_density(CommandBuffer &cmd, ImageView &light_den
 	cmd.set_texture(2, 3, fog_density, StockSampler::LinearWrap);
 	cmd.set_texture(2, 4, fog_density_low_freq, StockSampler::LinearWrap);
 
-	cmd.dispatch((width + 3) / 4, (height + 3) / 4, (depth + 3) / 4);
+	if (froxel_compaction && (flags & Renderer::POSITIONAL_LIGHT_ENABLE_BIT) != 0)
+	{
+		build_froxel_worklists(cmd, build_defines(flags));
+
+		// Froxel blocks covered by at least one positional light run the full
+		// clusterer loop, everything else takes a variant with the loop
+		// compiled out. Every froxel appears in exactly one of the two lists,
+		// so the temporal reprojection logic is unaffected by the split.
+		auto defines = build_defines(flags);
+		defines.emplace_back("WORKLIST", 1);
+		cmd.set_program("builtin://shaders/lights/fog_light_density.comp", defines);
+		cmd.set_storage_buffer(3, 0, *worklist_buffer, worklist_complex_offset, worklist_max_blocks * sizeof(uint32_t));
+		cmd.dispatch_indirect(*worklist_buffer, 4 * sizeof(uint32_t));
+
+		defines = build_defines(flags & ~(Renderer::POSITIONAL_LIGHT_ENABLE_BIT |
+		                                  Renderer::POSITIONAL_LIGHT_SHADOW_ENABLE_BIT));
+		defines.emplace_back("WORKLIST", 1);
+		cmd.set_program("builtin://shaders/lights/fog_light_density.comp", defines);
+		cmd.set_storage_buffer(3, 0, *worklist_buffer, worklist_simple_offset, worklist_max_blocks * sizeof(uint32_t));
+		cmd.dispatch_indirect(*worklist_buffer, 0);
+	}
+	else
+	{
+		cmd.set_program("builtin://shaders/lights/fog_light_density.comp", build_defines(flags));
+		cmd.dispatch((width + 3) / 4, (height + 3) / 4, (depth + 3) / 4);
+	}
+}
+
+void VolumetricFog::build_froxel_worklists(CommandBuffer &cmd, std::vector<std::pair<std::string, int>> defines)
+{
+	unsigned blocks_x = (width + 3) / 4;
+	unsigned blocks_y = (height + 3) / 4;
+	unsigned blocks_z = (depth + 3) / 4;
+	unsigned max_blocks = blocks_x * blocks_y * blocks_z;
+
+	if (!worklist_buffer || worklist_max_blocks != max_blocks)
+	{
+		worklist_max_blocks = max_blocks;
+		// Keep the list sections aligned to the worst-case storage buffer offset alignment.
+		VkDeviceSize list_size = (VkDeviceSize(max_blocks) * sizeof(uint32_t) + 255) & ~VkDeviceSize(255);
+		worklist_simple_offset = 256;
+		worklist_complex_offset = 256 + list_size;
+
+		BufferCreateInfo info = {};
+		info.domain = BufferDomain::Device;
+		info.size = worklist_complex_offset + list_size;
+		info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		             VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		             VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		worklist_buffer = cmd.get_device().create_buffer(info);
+	}
+
+	// Reset the two VkDispatchIndirectCommands. The classifier only bumps x.
+	static const uint32_t initial_counts[8] = { 0, 1, 1, 0, 0, 1, 1, 0 };
+	memcpy(cmd.update_buffer(*worklist_buffer, 0, sizeof(initial_counts)), initial_counts, sizeof(initial_counts));
+	cmd.barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	cmd.set_program("builtin://shaders/lights/fog_froxel_classify.comp", defines);
+	cmd.set_storage_buffer(3, 0, *worklist_buffer, 0, sizeof(initial_counts));
+	cmd.set_storage_buffer(3, 1, *worklist_buffer, worklist_simple_offset, worklist_max_blocks * sizeof(uint32_t));
+	cmd.set_storage_buffer(3, 2, *worklist_buffer, worklist_complex_offset, worklist_max_blocks * sizeof(uint32_t));
+	cmd.dispatch(blocks_x, blocks_y, blocks_z);
+
+	cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	            VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
 }
 
 void VolumetricFog::set_floor_lighting(const std::string &input, const FloorLighting &info)
@@ -265,7 +338,7 @@ void VolumetricFog::add_render_passes(RenderGraph &graph)
 	volume.aux_usage = VK_IMAGE_USAGE_SAMPLED_BIT;
 	volume.size_class = SizeClass::Absolute;
 
-	pass = &graph.add_pass("volumetric-fog", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+	pass = &graph.add_pass("volumetric-fog", RenderGraph::get_default_compute_queue());
 
 	auto &in_scatter_volume = pass->add_storage_texture_output("volumetric-fog-inscatter", volume);
 	auto &density_volume = pass->add_storage_texture_output("volumetric-fog-density", density);
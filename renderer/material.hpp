@@ -26,6 +26,7 @@
 #include "math.hpp"
 #include "intrusive.hpp"
 #include "texture_manager.hpp"
+#include "bindless_texture_table.hpp"
 #include "enum_cast.hpp"
 #include "sampler.hpp"
 #include "abstract_renderable.hpp"
@@ -59,8 +60,21 @@ struct Material : public Util::IntrusivePtrEnabled<Material>
 	bool two_sided = false;
 	bool needs_emissive = false;
 
+	enum : uint32_t { BindlessUnused = ~0u };
+
+	// Resolves the material's textures to stable u32 slots in a global
+	// bindless table, suitable for writing straight into a material SSBO.
+	// Unused texture channels get BindlessUnused.
+	void register_bindless(Vulkan::BindlessTextureTable &table,
+	                       uint32_t (&indices)[Util::ecast(Textures::Count)])
+	{
+		for (unsigned i = 0; i < Util::ecast(Textures::Count); i++)
+			indices[i] = textures[i] ? table.register_texture(textures[i]) : uint32_t(BindlessUnused);
+	}
+
 	void bake()
 	{
+		generation++;
 		Util::Hasher h;
 		for (auto &tex : textures)
 			h.pointer(tex);
@@ -85,8 +99,17 @@ struct Material : public Util::IntrusivePtrEnabled<Material>
 		return hash;
 	}
 
+	// Bumped on every bake(), i.e. whenever the material or its textures
+	// reload. Consumers caching material-derived state validate it with one
+	// integer compare per frame instead of re-hashing the material.
+	uint32_t get_generation() const
+	{
+		return generation;
+	}
+
 private:
 	uint64_t hash = 0;
+	uint32_t generation = 0;
 };
 
 enum MaterialTextureFlagBits
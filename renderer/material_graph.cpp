@@ -0,0 +1,565 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "material_graph.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+using namespace std;
+
+namespace Granite
+{
+MaterialGraph::NodeIndex MaterialGraph::add_node(Node node)
+{
+	nodes.push_back(move(node));
+	return NodeIndex(nodes.size() - 1);
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_constant(float value)
+{
+	return add_constant(&value, 1);
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_constant(const float *values, unsigned components)
+{
+	assert(components >= 1 && components <= 4);
+	Node node;
+	node.op = Op::Constant;
+	node.components = uint8_t(components);
+	copy(values, values + components, node.value);
+	return add_node(move(node));
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_input(const std::string &name, unsigned components)
+{
+	assert(components >= 1 && components <= 4);
+	Node node;
+	node.op = Op::Input;
+	node.components = uint8_t(components);
+	node.name = name;
+	return add_node(move(node));
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_texture(const std::string &sampler, NodeIndex coord)
+{
+	assert(coord < nodes.size());
+	Node node;
+	node.op = Op::Texture;
+	node.components = 4;
+	node.name = sampler;
+	node.a = coord;
+	return add_node(move(node));
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_unary(Op op, NodeIndex a)
+{
+	assert(op == Op::Saturate || op == Op::OneMinus || op == Op::Negate);
+	assert(a < nodes.size());
+	Node node;
+	node.op = op;
+	node.components = nodes[a].components;
+	node.a = a;
+	return add_node(move(node));
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_binary(Op op, NodeIndex a, NodeIndex b)
+{
+	assert(op == Op::Add || op == Op::Sub || op == Op::Mul || op == Op::Div || op == Op::Dot);
+	assert(a < nodes.size() && b < nodes.size());
+	Node node;
+	node.op = op;
+	node.components = op == Op::Dot ? 1 : uint8_t(max(nodes[a].components, nodes[b].components));
+	node.a = a;
+	node.b = b;
+	return add_node(move(node));
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_mix(NodeIndex a, NodeIndex b, NodeIndex t)
+{
+	assert(a < nodes.size() && b < nodes.size() && t < nodes.size());
+	Node node;
+	node.op = Op::Mix;
+	node.components = uint8_t(max(nodes[a].components, nodes[b].components));
+	node.a = a;
+	node.b = b;
+	node.c = t;
+	return add_node(move(node));
+}
+
+MaterialGraph::NodeIndex MaterialGraph::add_swizzle(NodeIndex a, const char *components)
+{
+	size_t len = strlen(components);
+	assert(a < nodes.size());
+	assert(len >= 1 && len <= 4);
+	Node node;
+	node.op = Op::Swizzle;
+	node.components = uint8_t(len);
+	node.a = a;
+	node.name = components;
+	return add_node(move(node));
+}
+
+void MaterialGraph::set_output(const std::string &name, NodeIndex node)
+{
+	assert(node < nodes.size());
+	for (auto &output : outputs)
+	{
+		if (output.first == name)
+		{
+			output.second = node;
+			return;
+		}
+	}
+	outputs.emplace_back(name, node);
+}
+
+// Component i of a constant, with scalar broadcast.
+static float const_component(const float *value, unsigned components, unsigned i)
+{
+	return components == 1 ? value[0] : value[min(i, components - 1u)];
+}
+
+static bool all_components_equal(const float *value, unsigned components, float ref)
+{
+	for (unsigned i = 0; i < components; i++)
+		if (value[i] != ref)
+			return false;
+	return true;
+}
+
+static unsigned swizzle_index(char c)
+{
+	switch (c)
+	{
+	case 'x': case 'r': return 0;
+	case 'y': case 'g': return 1;
+	case 'z': case 'b': return 2;
+	case 'w': case 'a': return 3;
+	default:
+		assert(0 && "Invalid swizzle component.");
+		return 0;
+	}
+}
+
+static void format_float(string &str, float v)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.9g", v);
+	// GLSL is stricter than C about int -> float literals in some drivers,
+	// so force a float-looking literal.
+	if (!strchr(buffer, '.') && !strchr(buffer, 'e') && !strchr(buffer, 'n') && !strchr(buffer, 'i'))
+		strcat(buffer, ".0");
+	str += buffer;
+}
+
+static const char *glsl_type(unsigned components)
+{
+	switch (components)
+	{
+	case 1: return "float";
+	case 2: return "vec2";
+	case 3: return "vec3";
+	default: return "vec4";
+	}
+}
+
+MaterialGraph::Compiled MaterialGraph::compile() const
+{
+	vector<Node> folded;
+	vector<NodeIndex> remap(nodes.size(), InvalidNode);
+	// Value-numbering for CSE: identical folded nodes collapse to one.
+	unordered_map<Util::Hash, NodeIndex> cse;
+
+	const auto node_key = [](const Node &n) -> Util::Hash {
+		Util::Hasher h;
+		h.u32(uint32_t(n.op));
+		h.u32(n.components);
+		for (unsigned i = 0; i < 4; i++)
+			h.f32(n.op == Op::Constant && i < n.components ? n.value[i] : 0.0f);
+		h.u32(n.a);
+		h.u32(n.b);
+		h.u32(n.c);
+		h.u32(uint32_t(n.name.size()));
+		h.data(reinterpret_cast<const uint8_t *>(n.name.data()), n.name.size());
+		return h.get();
+	};
+
+	const auto push_folded = [&](Node n) -> NodeIndex {
+		auto key = node_key(n);
+		auto itr = cse.find(key);
+		if (itr != end(cse))
+			return itr->second;
+		folded.push_back(move(n));
+		NodeIndex index = NodeIndex(folded.size() - 1);
+		cse[key] = index;
+		return index;
+	};
+
+	const auto make_constant = [&](const float *value, unsigned components) -> NodeIndex {
+		Node n;
+		n.op = Op::Constant;
+		n.components = uint8_t(components);
+		copy(value, value + components, n.value);
+		return push_folded(move(n));
+	};
+
+	const auto is_constant = [&](NodeIndex i) { return folded[i].op == Op::Constant; };
+	const auto is_constant_splat = [&](NodeIndex i, float ref) {
+		return is_constant(i) && all_components_equal(folded[i].value, folded[i].components, ref);
+	};
+
+	for (NodeIndex index = 0; index < NodeIndex(nodes.size()); index++)
+	{
+		Node n = nodes[index];
+		if (n.a != InvalidNode)
+			n.a = remap[n.a];
+		if (n.b != InvalidNode)
+			n.b = remap[n.b];
+		if (n.c != InvalidNode)
+			n.c = remap[n.c];
+
+		NodeIndex result = InvalidNode;
+
+		switch (n.op)
+		{
+		case Op::Constant:
+		case Op::Input:
+		case Op::Texture:
+			break;
+
+		case Op::Swizzle:
+			if (is_constant(n.a))
+			{
+				float value[4];
+				for (unsigned i = 0; i < n.components; i++)
+					value[i] = const_component(folded[n.a].value, folded[n.a].components,
+					                           swizzle_index(n.name[i]));
+				result = make_constant(value, n.components);
+			}
+			break;
+
+		case Op::Saturate:
+		case Op::OneMinus:
+		case Op::Negate:
+			if (is_constant(n.a))
+			{
+				float value[4];
+				for (unsigned i = 0; i < n.components; i++)
+				{
+					float v = const_component(folded[n.a].value, folded[n.a].components, i);
+					if (n.op == Op::Saturate)
+						value[i] = min(max(v, 0.0f), 1.0f);
+					else if (n.op == Op::OneMinus)
+						value[i] = 1.0f - v;
+					else
+						value[i] = -v;
+				}
+				result = make_constant(value, n.components);
+			}
+			break;
+
+		case Op::Add:
+		case Op::Sub:
+		case Op::Mul:
+		case Op::Div:
+		case Op::Dot:
+			if (is_constant(n.a) && is_constant(n.b))
+			{
+				float value[4] = {};
+				for (unsigned i = 0; i < max(1u, unsigned(n.components)); i++)
+				{
+					float va = const_component(folded[n.a].value, folded[n.a].components, i);
+					float vb = const_component(folded[n.b].value, folded[n.b].components, i);
+					switch (n.op)
+					{
+					case Op::Add: value[i] = va + vb; break;
+					case Op::Sub: value[i] = va - vb; break;
+					case Op::Mul: value[i] = va * vb; break;
+					case Op::Div: value[i] = va / vb; break;
+					default: break;
+					}
+				}
+
+				if (n.op == Op::Dot)
+				{
+					unsigned lanes = max(folded[n.a].components, folded[n.b].components);
+					float sum = 0.0f;
+					for (unsigned i = 0; i < lanes; i++)
+					{
+						sum += const_component(folded[n.a].value, folded[n.a].components, i) *
+						       const_component(folded[n.b].value, folded[n.b].components, i);
+					}
+					value[0] = sum;
+				}
+				result = make_constant(value, n.components);
+			}
+			else if (n.op == Op::Add)
+			{
+				// Disabled offsets fold to their surviving operand.
+				if (is_constant_splat(n.a, 0.0f))
+					result = n.b;
+				else if (is_constant_splat(n.b, 0.0f))
+					result = n.a;
+			}
+			else if (n.op == Op::Sub)
+			{
+				if (is_constant_splat(n.b, 0.0f))
+					result = n.a;
+			}
+			else if (n.op == Op::Mul)
+			{
+				// A disabled feature scale kills its whole subgraph.
+				if (is_constant_splat(n.a, 0.0f) || is_constant_splat(n.b, 0.0f))
+				{
+					float zero[4] = {};
+					result = make_constant(zero, n.components);
+				}
+				else if (is_constant_splat(n.a, 1.0f))
+					result = n.b;
+				else if (is_constant_splat(n.b, 1.0f))
+					result = n.a;
+			}
+			else if (n.op == Op::Div)
+			{
+				if (is_constant_splat(n.b, 1.0f))
+					result = n.a;
+			}
+			break;
+
+		case Op::Mix:
+			if (n.a == n.b)
+				result = n.a;
+			else if (is_constant_splat(n.c, 0.0f))
+				result = n.a;
+			else if (is_constant_splat(n.c, 1.0f))
+				result = n.b;
+			else if (is_constant(n.a) && is_constant(n.b) && is_constant(n.c))
+			{
+				float value[4];
+				for (unsigned i = 0; i < n.components; i++)
+				{
+					float va = const_component(folded[n.a].value, folded[n.a].components, i);
+					float vb = const_component(folded[n.b].value, folded[n.b].components, i);
+					float vt = const_component(folded[n.c].value, folded[n.c].components, i);
+					value[i] = va + (vb - va) * vt;
+				}
+				result = make_constant(value, n.components);
+			}
+			break;
+		}
+
+		if (result == InvalidNode)
+			result = push_folded(move(n));
+		remap[index] = result;
+	}
+
+	// Dead code elimination: only nodes reachable from an output survive.
+	vector<bool> live(folded.size(), false);
+	vector<NodeIndex> stack;
+	for (auto &output : outputs)
+		stack.push_back(remap[output.second]);
+	while (!stack.empty())
+	{
+		NodeIndex index = stack.back();
+		stack.pop_back();
+		if (live[index])
+			continue;
+		live[index] = true;
+		auto &n = folded[index];
+		if (n.a != InvalidNode)
+			stack.push_back(n.a);
+		if (n.b != InvalidNode)
+			stack.push_back(n.b);
+		if (n.c != InvalidNode)
+			stack.push_back(n.c);
+	}
+
+	// Compact indices for emission and hashing. Constants and inputs are
+	// referenced inline and never get a temporary.
+	vector<NodeIndex> emit_index(folded.size(), InvalidNode);
+	NodeIndex emit_count = 0;
+	for (NodeIndex i = 0; i < NodeIndex(folded.size()); i++)
+		if (live[i] && folded[i].op != Op::Constant && folded[i].op != Op::Input)
+			emit_index[i] = emit_count++;
+
+	Compiled compiled;
+
+	const auto ref = [&](NodeIndex index, string &str) {
+		auto &n = folded[index];
+		if (n.op == Op::Constant)
+		{
+			if (n.components == 1)
+				format_float(str, n.value[0]);
+			else
+			{
+				str += glsl_type(n.components);
+				str += "(";
+				for (unsigned i = 0; i < n.components; i++)
+				{
+					if (i)
+						str += ", ";
+					format_float(str, n.value[i]);
+				}
+				str += ")";
+			}
+		}
+		else if (n.op == Op::Input)
+			str += n.name;
+		else
+		{
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "mg_%u", emit_index[index]);
+			str += buffer;
+		}
+	};
+
+	for (NodeIndex i = 0; i < NodeIndex(folded.size()); i++)
+	{
+		if (emit_index[i] == InvalidNode)
+			continue;
+
+		auto &n = folded[i];
+		auto &str = compiled.code;
+		str += glsl_type(n.components);
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), " mg_%u = ", emit_index[i]);
+		str += buffer;
+
+		switch (n.op)
+		{
+		case Op::Texture:
+			str += "texture(";
+			str += n.name;
+			str += ", ";
+			ref(n.a, str);
+			str += ")";
+			if (find(begin(compiled.textures), end(compiled.textures), n.name) == end(compiled.textures))
+				compiled.textures.push_back(n.name);
+			break;
+
+		case Op::Add:
+		case Op::Sub:
+		case Op::Mul:
+		case Op::Div:
+			ref(n.a, str);
+			str += n.op == Op::Add ? " + " : n.op == Op::Sub ? " - " : n.op == Op::Mul ? " * " : " / ";
+			ref(n.b, str);
+			break;
+
+		case Op::Dot:
+			str += "dot(";
+			ref(n.a, str);
+			str += ", ";
+			ref(n.b, str);
+			str += ")";
+			break;
+
+		case Op::Mix:
+			str += "mix(";
+			ref(n.a, str);
+			str += ", ";
+			ref(n.b, str);
+			str += ", ";
+			ref(n.c, str);
+			str += ")";
+			break;
+
+		case Op::Saturate:
+			str += "clamp(";
+			ref(n.a, str);
+			str += ", 0.0, 1.0)";
+			break;
+
+		case Op::OneMinus:
+			str += "(1.0 - ";
+			ref(n.a, str);
+			str += ")";
+			break;
+
+		case Op::Negate:
+			str += "(-";
+			ref(n.a, str);
+			str += ")";
+			break;
+
+		case Op::Swizzle:
+			ref(n.a, str);
+			str += ".";
+			str += n.name;
+			break;
+
+		default:
+			break;
+		}
+
+		str += ";\n";
+	}
+
+	for (auto &output : outputs)
+	{
+		compiled.code += output.first;
+		compiled.code += " = ";
+		ref(remap[output.second], compiled.code);
+		compiled.code += ";\n";
+	}
+
+	// Hash the folded, live graph rather than the authored one so
+	// permutations which simplify to the same shader share a hash. Indices
+	// are compacted over live nodes so dead graph regions cannot perturb it.
+	vector<NodeIndex> live_index(folded.size(), InvalidNode);
+	NodeIndex live_count = 0;
+	for (NodeIndex i = 0; i < NodeIndex(folded.size()); i++)
+		if (live[i])
+			live_index[i] = live_count++;
+
+	Util::Hasher h;
+	for (NodeIndex i = 0; i < NodeIndex(folded.size()); i++)
+	{
+		if (!live[i])
+			continue;
+		auto &n = folded[i];
+		h.u32(uint32_t(n.op));
+		h.u32(n.components);
+		if (n.op == Op::Constant)
+			for (unsigned c = 0; c < n.components; c++)
+				h.f32(n.value[c]);
+		h.u32(n.a != InvalidNode ? live_index[n.a] : ~0u);
+		h.u32(n.b != InvalidNode ? live_index[n.b] : ~0u);
+		h.u32(n.c != InvalidNode ? live_index[n.c] : ~0u);
+		h.u32(uint32_t(n.name.size()));
+		h.data(reinterpret_cast<const uint8_t *>(n.name.data()), n.name.size());
+	}
+	for (auto &output : outputs)
+	{
+		h.u32(uint32_t(output.first.size()));
+		h.data(reinterpret_cast<const uint8_t *>(output.first.data()), output.first.size());
+		h.u32(live_index[remap[output.second]]);
+	}
+	compiled.hash = h.get();
+
+	return compiled;
+}
+}
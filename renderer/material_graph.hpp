@@ -0,0 +1,110 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "hash.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Granite
+{
+// Material permutations as a small expression DAG instead of hand-edited GLSL
+// and #ifdef ladders. A graph is built from constants, shader inputs, texture
+// taps and arithmetic, with named outputs (e.g. "BaseColor"). compile() runs
+// constant folding, algebraic simplification, common subexpression merging
+// and dead code elimination, then emits a minimal GLSL fragment: a feature
+// that folds away (a scale of 1.0, a mix with weight 0.0) generates no code
+// and drops its texture taps entirely. The emitted snippet is meant to be
+// compiled into a ShaderSuite fragment template through the shader manager's
+// include mechanism, which turns it into SPIR-V at load like any other
+// source. Compiled::hash identifies the *folded* graph, so permutations
+// which collapse to the same shader after folding share one pipeline.
+class MaterialGraph
+{
+public:
+	using NodeIndex = uint32_t;
+	enum : uint32_t { InvalidNode = ~0u };
+
+	enum class Op : uint8_t
+	{
+		Constant,
+		// A variable the surrounding template declares (vUV, vColor, ...).
+		Input,
+		// texture(<name>, coord); the template declares the sampler.
+		Texture,
+		Add,
+		Sub,
+		Mul,
+		Div,
+		Dot,
+		// mix(a, b, c)
+		Mix,
+		Saturate,
+		OneMinus,
+		Negate,
+		Swizzle
+	};
+
+	NodeIndex add_constant(float value);
+	NodeIndex add_constant(const float *values, unsigned components);
+	NodeIndex add_input(const std::string &name, unsigned components);
+	NodeIndex add_texture(const std::string &sampler, NodeIndex coord);
+	NodeIndex add_unary(Op op, NodeIndex a);
+	NodeIndex add_binary(Op op, NodeIndex a, NodeIndex b);
+	NodeIndex add_mix(NodeIndex a, NodeIndex b, NodeIndex t);
+	NodeIndex add_swizzle(NodeIndex a, const char *components);
+
+	void set_output(const std::string &name, NodeIndex node);
+
+	struct Compiled
+	{
+		// GLSL statements assigning every output, one temporary per surviving
+		// node. Constants are inlined at their use sites.
+		std::string code;
+		// Hash of the folded graph; equal hashes mean identical shaders.
+		Util::Hash hash = 0;
+		// Sampler names still referenced after folding.
+		std::vector<std::string> textures;
+	};
+
+	Compiled compile() const;
+
+private:
+	struct Node
+	{
+		Op op = Op::Constant;
+		uint8_t components = 1;
+		float value[4] = {};
+		NodeIndex a = InvalidNode;
+		NodeIndex b = InvalidNode;
+		NodeIndex c = InvalidNode;
+		std::string name;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<std::pair<std::string, NodeIndex>> outputs;
+
+	NodeIndex add_node(Node node);
+};
+}
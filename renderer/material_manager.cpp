@@ -151,6 +151,7 @@ void MaterialFile::update(std::unique_ptr<File> file)
 	if (device)
 		init_textures();
 	bake();
+	MaterialManager::get().signal_material_updated();
 }
 
 void MaterialFile::init_textures()
@@ -175,6 +176,7 @@ void MaterialFile::init_textures()
 			textures[i] = nullptr;
 	}
 	bake();
+	MaterialManager::get().signal_material_updated();
 }
 
 void MaterialFile::on_device_created(const DeviceCreatedEvent &created)
@@ -28,6 +28,7 @@
 #include "event.hpp"
 #include "scene_formats.hpp"
 #include "application_wsi_events.hpp"
+#include <atomic>
 
 namespace Granite
 {
@@ -54,8 +55,22 @@ public:
 	MaterialHandle request_material(const std::string &path);
 	static MaterialManager &get();
 
+	// Global generation, bumped whenever any material reloads. Systems holding
+	// bulk material-derived tables (material SSBOs, bindless index arrays)
+	// compare this one integer per frame to know whether to rebuild.
+	uint64_t get_generation() const
+	{
+		return generation.load(std::memory_order_acquire);
+	}
+
+	void signal_material_updated()
+	{
+		generation.fetch_add(1, std::memory_order_release);
+	}
+
 private:
 	MaterialManager() = default;
 	std::unordered_map<std::string, MaterialHandle> materials;
+	std::atomic<uint64_t> generation { 1 };
 };
 }
\ No newline at end of file
@@ -63,16 +63,32 @@ Hash StaticMesh::get_instance_key() const
 
 Hash StaticMesh::get_baked_instance_key() const
 {
-	Hasher h;
 	assert(cached_hash != 0);
+
+	// One integer compare per enqueue; only material reloads invalidate.
+	uint32_t generation = material->get_generation();
+	if (generation == baked_material_generation.load(std::memory_order_acquire))
+		return baked_instance_key.load(std::memory_order_relaxed);
+
+	Hasher h;
 	h.u64(cached_hash);
 	h.u64(material->get_hash());
-	return h.get();
+	Hash key = h.get();
+
+	baked_instance_key.store(key, std::memory_order_relaxed);
+	baked_material_generation.store(generation, std::memory_order_release);
+	return key;
 }
 
 namespace RenderFunctions
 {
-void mesh_set_state(CommandBuffer &cmd, const StaticMeshInfo &info)
+// Sentinel attribute mask which selects the generic runtime loop over
+// MeshAttributeLayout. Common layouts get dedicated instantiations below so
+// the attribute binding is fully unrolled and branch-free per draw.
+enum : uint32_t { AttributeLayoutDynamic = ~0u };
+
+template <uint32_t attribute_mask>
+static void mesh_set_state_for_layout(CommandBuffer &cmd, const StaticMeshInfo &info)
 {
 	cmd.set_program(info.program);
 
@@ -86,9 +102,18 @@ void mesh_set_state(CommandBuffer &cmd, const StaticMeshInfo &info)
 	if (info.ibo)
 		cmd.set_index_buffer(*info.ibo, 0, info.index_type);
 
-	for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
-		if (info.attributes[i].format != VK_FORMAT_UNDEFINED)
-			cmd.set_vertex_attrib(i, i == 0 ? 0 : 1, info.attributes[i].format, info.attributes[i].offset);
+	if (attribute_mask == AttributeLayoutDynamic)
+	{
+		for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
+			if (info.attributes[i].format != VK_FORMAT_UNDEFINED)
+				cmd.set_vertex_attrib(i, i == 0 ? 0 : 1, info.attributes[i].format, info.attributes[i].offset);
+	}
+	else
+	{
+		for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
+			if (attribute_mask & (1u << i))
+				cmd.set_vertex_attrib(i, i == 0 ? 0 : 1, info.attributes[i].format, info.attributes[i].offset);
+	}
 
 	auto &sampler = cmd.get_device().get_stock_sampler(info.sampler);
 	for (unsigned i = 0; i < ecast(Material::Textures::Count); i++)
@@ -103,6 +128,11 @@ void mesh_set_state(CommandBuffer &cmd, const StaticMeshInfo &info)
 		cmd.set_cull_mode(VK_CULL_MODE_NONE);
 }
 
+void mesh_set_state(CommandBuffer &cmd, const StaticMeshInfo &info)
+{
+	mesh_set_state_for_layout<AttributeLayoutDynamic>(cmd, info);
+}
+
 void debug_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
 {
 	auto *info = static_cast<const DebugMeshInfo *>(infos->render_info);
@@ -135,10 +165,11 @@ void debug_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigne
 	cmd.draw(count);
 }
 
-void static_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
+template <uint32_t attribute_mask>
+static void static_mesh_render_for_layout(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
 {
 	auto *info = static_cast<const StaticMeshInfo *>(infos->render_info);
-	mesh_set_state(cmd, *info);
+	mesh_set_state_for_layout<attribute_mask>(cmd, *info);
 
 	unsigned to_render = 0;
 	for (unsigned i = 0; i < instances; i += to_render)
@@ -156,10 +187,16 @@ void static_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsign
 	}
 }
 
-void skinned_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
+void static_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
+{
+	static_mesh_render_for_layout<AttributeLayoutDynamic>(cmd, infos, instances);
+}
+
+template <uint32_t attribute_mask>
+static void skinned_mesh_render_for_layout(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
 {
 	auto *static_info = static_cast<const StaticMeshInfo *>(infos->render_info);
-	mesh_set_state(cmd, *static_info);
+	mesh_set_state_for_layout<attribute_mask>(cmd, *static_info);
 
 	for (unsigned i = 0; i < instances; i++)
 	{
@@ -175,6 +212,47 @@ void skinned_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsig
 			cmd.draw(static_info->count, 1, static_info->vertex_offset, 0);
 	}
 }
+
+void skinned_mesh_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
+{
+	skinned_mesh_render_for_layout<AttributeLayoutDynamic>(cmd, infos, instances);
+}
+
+RenderFunc get_static_mesh_render_func(uint32_t attribute_mask)
+{
+	switch (attribute_mask)
+	{
+	case MESH_ATTRIBUTE_POSITION_BIT:
+		return static_mesh_render_for_layout<MESH_ATTRIBUTE_POSITION_BIT>;
+	case MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT:
+		return static_mesh_render_for_layout<MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT>;
+	case MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT | MESH_ATTRIBUTE_NORMAL_BIT:
+		return static_mesh_render_for_layout<MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT |
+		                                     MESH_ATTRIBUTE_NORMAL_BIT>;
+	case MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT | MESH_ATTRIBUTE_NORMAL_BIT | MESH_ATTRIBUTE_TANGENT_BIT:
+		return static_mesh_render_for_layout<MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT |
+		                                     MESH_ATTRIBUTE_NORMAL_BIT | MESH_ATTRIBUTE_TANGENT_BIT>;
+	default:
+		return static_mesh_render;
+	}
+}
+
+RenderFunc get_skinned_mesh_render_func(uint32_t attribute_mask)
+{
+	constexpr uint32_t skin = MESH_ATTRIBUTE_BONE_INDEX_BIT | MESH_ATTRIBUTE_BONE_WEIGHTS_BIT;
+	switch (attribute_mask)
+	{
+	case MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT | MESH_ATTRIBUTE_NORMAL_BIT | skin:
+		return skinned_mesh_render_for_layout<MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT |
+		                                      MESH_ATTRIBUTE_NORMAL_BIT | skin>;
+	case MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT | MESH_ATTRIBUTE_NORMAL_BIT |
+	     MESH_ATTRIBUTE_TANGENT_BIT | skin:
+		return skinned_mesh_render_for_layout<MESH_ATTRIBUTE_POSITION_BIT | MESH_ATTRIBUTE_UV_BIT |
+		                                      MESH_ATTRIBUTE_NORMAL_BIT | MESH_ATTRIBUTE_TANGENT_BIT | skin>;
+	default:
+		return skinned_mesh_render;
+	}
+}
 }
 
 void StaticMesh::fill_render_info(StaticMeshInfo &info) const
@@ -210,6 +288,41 @@ void StaticMesh::fill_render_info(StaticMeshInfo &info) const
 void StaticMesh::bake()
 {
 	cached_hash = get_instance_key();
+
+	cached_attrs = 0;
+	for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
+		if (attributes[i].format != VK_FORMAT_UNDEFINED)
+			cached_attrs |= 1u << i;
+}
+
+unsigned StaticMesh::select_lod(const RenderContext &context, const AABB &world_aabb) const
+{
+	if (num_lods < 2)
+		return 0;
+
+	// Project the simplification error (stored relative to the AABB extent)
+	// onto the viewport and take the coarsest level which stays under the
+	// threshold. Roughly two pixels at 1080p; instances too close for any
+	// simplified level fall through to full resolution.
+	const float max_screen_error = 2.0f / 1080.0f;
+
+	auto &params = context.get_render_parameters();
+	float extent = 2.0f * world_aabb.get_radius();
+	float dist = distance(world_aabb.get_center(), params.camera_position);
+	dist = muglm::max(dist - world_aabb.get_radius(), params.z_near);
+	float error_to_screen = 0.5f * params.projection[1][1] * extent / dist;
+
+	unsigned lod = 0;
+	for (unsigned i = num_lods - 1; i > 0; i--)
+	{
+		if (lods[i].error * error_to_screen <= max_screen_error)
+		{
+			lod = i;
+			break;
+		}
+	}
+
+	return lod;
 }
 
 static Queue material_to_queue(const Material &mat)
@@ -222,17 +335,25 @@ static Queue material_to_queue(const Material &mat)
 		return Queue::Opaque;
 }
 
-void StaticMesh::get_render_info(const RenderContext &context, const RenderInfoComponent *transform, RenderQueue &queue) const
+void StaticMesh::update_baked_draw_keys(bool pipe_hash_includes_textures, bool fold_emissive_bit) const
 {
+	uint32_t generation = material->get_generation();
+	if (generation == baked_key_generation.load(std::memory_order_acquire))
+		return;
+
 	auto type = material_to_queue(*material);
-	uint32_t attrs = 0;
 
-	for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
-		if (attributes[i].format != VK_FORMAT_UNDEFINED)
-			attrs |= 1u << i;
+	uint32_t textures = 0;
+	for (unsigned i = 0; i < ecast(Material::Textures::Count); i++)
+		if (material->textures[i])
+			textures |= 1u << i;
+	if (fold_emissive_bit && type == Queue::OpaqueEmissive)
+		textures |= MATERIAL_EMISSIVE_BIT;
 
 	Hasher h;
-	h.u32(attrs);
+	h.u32(cached_attrs);
+	if (pipe_hash_includes_textures)
+		h.u32(textures);
 	h.u32(ecast(material->pipeline));
 	h.u32(material->shader_variant);
 	auto pipe_hash = h.get();
@@ -240,79 +361,135 @@ void StaticMesh::get_render_info(const RenderContext &context, const RenderInfoC
 	h.u64(material->get_hash());
 	h.u64(vbo_position->get_cookie());
 
+	baked_pipe_hash.store(pipe_hash, std::memory_order_relaxed);
+	baked_draw_hash.store(h.get(), std::memory_order_relaxed);
+	baked_textures.store(textures, std::memory_order_relaxed);
+	baked_queue_type.store(ecast(type), std::memory_order_relaxed);
+	baked_key_generation.store(generation, std::memory_order_release);
+}
+
+Vulkan::Program *StaticMesh::get_cached_program(ShaderSuite &suite, uint32_t attrs, uint32_t textures) const
+{
+	Hasher h;
+	h.u64(reinterpret_cast<uintptr_t>(&suite));
+	h.u32(suite.get_generation());
+	h.u32(material->get_generation());
+	auto key = h.get();
+
+	auto &slot = program_slots[key & (ProgramSlotCount - 1)];
+	uint32_t seq = slot.seq.load(std::memory_order_acquire);
+	if ((seq & 1u) == 0 && slot.key.load(std::memory_order_relaxed) == key)
+	{
+		auto *program = slot.program.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) == seq)
+			return program;
+	}
+
+	auto *program = suite.get_program(material->pipeline, attrs, textures, material->shader_variant);
+
+	// Single-writer publish; on contention the other thread wins the slot and
+	// we just return the freshly resolved program.
+	if ((seq & 1u) == 0 &&
+	    slot.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed))
+	{
+		slot.key.store(key, std::memory_order_relaxed);
+		slot.program.store(program, std::memory_order_relaxed);
+		slot.seq.store(seq + 2, std::memory_order_release);
+	}
+	return program;
+}
+
+void StaticMesh::get_render_info(const RenderContext &context, const RenderInfoComponent *transform, RenderQueue &queue) const
+{
+	update_baked_draw_keys(false, true);
+
+	auto type = static_cast<Queue>(baked_queue_type.load(std::memory_order_relaxed));
+	uint32_t attrs = cached_attrs;
+	auto pipe_hash = baked_pipe_hash.load(std::memory_order_relaxed);
+	auto draw_hash = baked_draw_hash.load(std::memory_order_relaxed);
+
 	auto instance_key = get_baked_instance_key();
-	auto sorting_key = RenderInfo::get_sort_key(context, type, pipe_hash, h.get(), transform->world_aabb.get_center());
+	auto sorting_key = RenderInfo::get_sort_key(context, type, pipe_hash, draw_hash, transform->world_aabb.get_center());
+
+	// Each LOD draws a different index range, so instances may only merge
+	// within their level.
+	unsigned lod = select_lod(context, transform->world_aabb);
+	if (lod != 0)
+	{
+		Hasher lod_h;
+		lod_h.u64(instance_key);
+		lod_h.u32(lod);
+		instance_key = lod_h.get();
+	}
 
 	auto *t = transform->transform;
 	auto *instance_data = queue.allocate_one<StaticMeshInstanceInfo>();
+
 	instance_data->vertex.Model = t->world_transform;
 	//instance_data->vertex.Normal = t->normal_transform;
 
+	if (attributes[ecast(MeshAttribute::Position)].format == VK_FORMAT_R16G16B16A16_UNORM)
+	{
+		// Positions are unorm16 relative to the static AABB. Dequantize in
+		// mesh space rather than folding translate/scale into Model, which
+		// would skew the normal transform the vertex shader derives from it
+		// whenever the AABB extents are non-uniform.
+		instance_data->vertex.Dequant[0] =
+				vec4(static_aabb.get_maximum() - static_aabb.get_minimum(), 0.0f);
+		instance_data->vertex.Dequant[1] = vec4(static_aabb.get_minimum(), 0.0f);
+	}
+	else
+	{
+		instance_data->vertex.Dequant[0] = vec4(1.0f, 1.0f, 1.0f, 0.0f);
+		instance_data->vertex.Dequant[1] = vec4(0.0f);
+	}
+
 	auto *mesh_info = queue.push<StaticMeshInfo>(type, instance_key, sorting_key,
-	                                             RenderFunctions::static_mesh_render,
+	                                             RenderFunctions::get_static_mesh_render_func(attrs),
 	                                             instance_data);
 
 	if (mesh_info)
 	{
-		uint32_t textures = 0;
-		for (unsigned i = 0; i < ecast(Material::Textures::Count); i++)
-			if (material->textures[i])
-				textures |= 1u << i;
-
-		if (type == Queue::OpaqueEmissive)
-			textures |= MATERIAL_EMISSIVE_BIT;
-
 		fill_render_info(*mesh_info);
-		mesh_info->program = queue.get_shader_suites()[ecast(RenderableType::Mesh)].get_program(material->pipeline, attrs,
-		                                                                                        textures, material->shader_variant);
+		if (lod != 0)
+		{
+			mesh_info->ibo_offset = lods[lod].ibo_offset;
+			mesh_info->count = lods[lod].count;
+		}
+		mesh_info->program = get_cached_program(queue.get_shader_suites()[ecast(RenderableType::Mesh)], attrs,
+		                                        baked_textures.load(std::memory_order_relaxed));
 	}
 }
 
 void SkinnedMesh::get_render_info(const RenderContext &context, const RenderInfoComponent *transform, RenderQueue &queue) const
 {
-	auto type = material_to_queue(*material);
-	uint32_t attrs = 0;
-	uint32_t textures = 0;
-
-	for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
-		if (attributes[i].format != VK_FORMAT_UNDEFINED)
-			attrs |= 1u << i;
-
-	for (unsigned i = 0; i < ecast(Material::Textures::Count); i++)
-		if (material->textures[i])
-			textures |= 1u << i;
-
-	Hasher h;
-	h.u32(attrs);
-	h.u32(textures);
-	h.u32(ecast(material->pipeline));
-	h.u32(material->shader_variant);
-	auto pipe_hash = h.get();
+	update_baked_draw_keys(true, false);
 
-	h.u64(material->get_hash());
-	h.u64(vbo_position->get_cookie());
+	auto type = static_cast<Queue>(baked_queue_type.load(std::memory_order_relaxed));
+	uint32_t attrs = cached_attrs;
+	uint32_t textures = baked_textures.load(std::memory_order_relaxed);
+	auto pipe_hash = baked_pipe_hash.load(std::memory_order_relaxed);
+	auto draw_hash = baked_draw_hash.load(std::memory_order_relaxed);
 
 	auto instance_key = get_baked_instance_key() ^ 1;
-	auto sorting_key = RenderInfo::get_sort_key(context, type, pipe_hash, h.get(), transform->world_aabb.get_center());
+	auto sorting_key = RenderInfo::get_sort_key(context, type, pipe_hash, draw_hash, transform->world_aabb.get_center());
 
 	auto *instance_data = queue.allocate_one<SkinnedMeshInstanceInfo>();
 
 	unsigned num_bones = transform->skin_transform->bone_world_transforms.size();
 	instance_data->num_bones = num_bones;
-	instance_data->world_transforms = queue.allocate_many<mat4>(num_bones);
-	//instance_data->normal_transforms = queue.allocate_many<mat4>(num_bones);
-	memcpy(instance_data->world_transforms, transform->skin_transform->bone_world_transforms.data(), num_bones * sizeof(mat4));
-	//memcpy(instance_data->normal_transforms, transform->skin_transform->bone_normal_transforms.data(), num_bones * sizeof(mat4));
+	instance_data->world_transforms = transform->skin_transform->bone_world_transforms.data();
+	//instance_data->normal_transforms = transform->skin_transform->bone_normal_transforms.data();
 
 	auto *mesh_info = queue.push<StaticMeshInfo>(type, instance_key, sorting_key,
-	                                             RenderFunctions::skinned_mesh_render,
+	                                             RenderFunctions::get_skinned_mesh_render_func(attrs),
 	                                             instance_data);
 
 	if (mesh_info)
 	{
 		fill_render_info(*mesh_info);
-		mesh_info->program = queue.get_shader_suites()[ecast(RenderableType::Mesh)].get_program(material->pipeline, attrs,
-		                                                                                        textures, material->shader_variant);
+		mesh_info->program = get_cached_program(queue.get_shader_suites()[ecast(RenderableType::Mesh)], attrs, textures);
 	}
 }
 
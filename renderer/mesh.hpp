@@ -29,9 +29,11 @@
 #include "aabb.hpp"
 #include "render_queue.hpp"
 #include "limits.hpp"
+#include <atomic>
 
 namespace Granite
 {
+class ShaderSuite;
 
 enum class MeshAttribute : unsigned
 {
@@ -67,6 +69,11 @@ struct StaticMeshVertex
 {
 	mat4 Model;
 	//mat4 Normal;
+	// Position dequantization as (scale, offset), applied in mesh space
+	// before Model. Identity unless positions are unorm16 relative to the
+	// static AABB. Kept out of Model so the normal transform the vertex
+	// shader derives from it is not skewed by non-uniform AABB extents.
+	vec4 Dequant[2];
 	enum
 	{
 		max_instances = 256
@@ -102,8 +109,11 @@ struct StaticMeshInstanceInfo
 
 struct SkinnedMeshInstanceInfo
 {
-	mat4 *world_transforms = nullptr;
-	//mat4 *normal_transforms = nullptr;
+	// Points at the node's cached skin palette, which is stable for the
+	// rest of the frame, so the render function copies the palette exactly
+	// once, straight into the per-frame UBO pool allocation.
+	const mat4 *world_transforms = nullptr;
+	//const mat4 *normal_transforms = nullptr;
 	uint32_t num_bones = 0;
 };
 
@@ -140,6 +150,12 @@ void debug_mesh_render(Vulkan::CommandBuffer &cmd, const RenderQueueData *render
 void line_strip_render(Vulkan::CommandBuffer &cmd, const RenderQueueData *render, unsigned instances);
 void skinned_mesh_render(Vulkan::CommandBuffer &cmd, const RenderQueueData *render, unsigned instances);
 void mesh_set_state(Vulkan::CommandBuffer &cmd, const StaticMeshInfo &info);
+
+// Returns a render function specialized for the given attribute mask when a
+// dedicated instantiation exists for that layout, otherwise the generic
+// variant which walks MeshAttributeLayout at runtime.
+RenderFunc get_static_mesh_render_func(uint32_t attribute_mask);
+RenderFunc get_skinned_mesh_render_func(uint32_t attribute_mask);
 }
 
 struct StaticMesh : AbstractRenderable
@@ -156,6 +172,20 @@ struct StaticMesh : AbstractRenderable
 	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	bool primitive_restart = false;
 
+	// Optional simplified LOD chain sharing the VBOs; lods[0] is the full
+	// resolution geometry. num_lods == 0 means no chain, ibo_offset/count
+	// above are drawn as-is. Selection projects the simplification error
+	// (relative to the AABB extent) to screen space per draw.
+	enum { MaxLODs = 8 };
+	struct LOD
+	{
+		uint32_t ibo_offset = 0;
+		uint32_t count = 0;
+		float error = 0.0f;
+	};
+	LOD lods[MaxLODs];
+	unsigned num_lods = 0;
+
 	MeshAttributeLayout attributes[Util::ecast(MeshAttribute::Count)];
 
 	MaterialHandle material;
@@ -178,7 +208,45 @@ struct StaticMesh : AbstractRenderable
 protected:
 	void reset();
 	void fill_render_info(StaticMeshInfo &info) const;
+	unsigned select_lod(const RenderContext &context, const AABB &world_aabb) const;
 	Util::Hash cached_hash = 0;
+	// Attribute mask is fixed once the buffers are set up, baked in bake().
+	uint32_t cached_attrs = 0;
+
+	// Cache for get_baked_instance_key(), validated against the material
+	// generation with a single integer compare per enqueue. Relaxed atomics are
+	// fine here since parallel enqueue threads recompute the same value on miss.
+	mutable std::atomic<uint64_t> baked_instance_key { 0 };
+	mutable std::atomic<uint32_t> baked_material_generation { 0 };
+
+	// Static part of the per-enqueue draw state (sort-key hashes, texture
+	// mask, queue type), baked once per material generation so the enqueue
+	// path writes precomputed words instead of running Hasher chains. Same
+	// recompute-on-miss contract as above; the fields can tear only across a
+	// material reload and converge on the next enqueue.
+	mutable std::atomic<uint64_t> baked_pipe_hash { 0 };
+	mutable std::atomic<uint64_t> baked_draw_hash { 0 };
+	mutable std::atomic<uint32_t> baked_textures { 0 };
+	mutable std::atomic<uint32_t> baked_queue_type { 0 };
+	mutable std::atomic<uint32_t> baked_key_generation { 0 };
+	// The skinned path hashes the texture mask into the pipeline hash and does
+	// not fold the emissive queue bit into the mask; the flags keep both
+	// classes bit-exact with what they hashed per enqueue before.
+	void update_baked_draw_keys(bool pipe_hash_includes_textures, bool fold_emissive_bit) const;
+
+	// Pre-resolved program handles, keyed by shader suite identity and the
+	// material generation. Slots are seqlock-protected: concurrent enqueue
+	// threads either observe a consistent {key, program} pair or fall back to
+	// the suite lookup, and a contended publish is simply skipped.
+	struct ProgramSlot
+	{
+		std::atomic<uint32_t> seq { 0 };
+		std::atomic<uint64_t> key { 0 };
+		std::atomic<Vulkan::Program *> program { nullptr };
+	};
+	enum { ProgramSlotCount = 4 };
+	mutable ProgramSlot program_slots[ProgramSlotCount];
+	Vulkan::Program *get_cached_program(ShaderSuite &suite, uint32_t attrs, uint32_t textures) const;
 
 private:
 	bool has_static_aabb() const override
@@ -39,7 +39,7 @@ using namespace Granite::SceneFormats;
 namespace Granite
 {
 ImportedSkinnedMesh::ImportedSkinnedMesh(const Mesh &mesh_, const MaterialInfo &info_)
-	: mesh(mesh_), info(info_)
+	: mesh(mesh_quantize_attributes(mesh_, false)), info(info_)
 {
 	topology = mesh.topology;
 	index_type = mesh.index_type;
@@ -103,7 +103,7 @@ const SceneFormats::MaterialInfo &ImportedSkinnedMesh::get_material_info() const
 }
 
 ImportedMesh::ImportedMesh(const Mesh &mesh_, const MaterialInfo &info_)
-	: mesh(mesh_), info(info_)
+	: mesh(mesh_quantize_attributes(mesh_, true)), info(info_)
 {
 	topology = mesh.topology;
 	primitive_restart = mesh.primitive_restart;
@@ -117,6 +117,12 @@ ImportedMesh::ImportedMesh(const Mesh &mesh_, const MaterialInfo &info_)
 	vertex_offset = 0;
 	ibo_offset = 0;
 
+	num_lods = unsigned(mesh.lods.size());
+	if (num_lods > MaxLODs)
+		num_lods = MaxLODs;
+	for (unsigned i = 0; i < num_lods; i++)
+		lods[i] = { mesh.lods[i].index_offset, mesh.lods[i].count, mesh.lods[i].error };
+
 	material = Util::make_derived_handle<Material, MaterialFile>(info);
 	static_aabb = mesh.static_aabb;
 
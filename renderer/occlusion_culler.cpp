@@ -0,0 +1,167 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "occlusion_culler.hpp"
+#include "cpu_rasterizer.hpp"
+#include "simd.hpp"
+#include "abstract_renderable.hpp"
+#include <algorithm>
+#include <float.h>
+
+using namespace std;
+
+namespace Granite
+{
+void OcclusionCuller::reset(unsigned width_, unsigned height_, const mat4 &view_projection_)
+{
+	width = width_;
+	height = height_;
+	view_projection = view_projection_;
+
+	unsigned num_levels = 1;
+	while ((width >> num_levels) > 0 || (height >> num_levels) > 0)
+		num_levels++;
+
+	depth_pyramid.resize(num_levels);
+	level_resolutions.resize(num_levels);
+	for (unsigned level = 0; level < num_levels; level++)
+	{
+		uvec2 res(muglm::max(width >> level, 1u), muglm::max(height >> level, 1u));
+		level_resolutions[level] = res;
+		depth_pyramid[level].resize(res.x * res.y);
+	}
+
+	fill(begin(depth_pyramid[0]), end(depth_pyramid[0]), 1.0f);
+}
+
+void OcclusionCuller::rasterize_occluder(const vec4 *positions, unsigned num_positions,
+                                         const unsigned *indices, unsigned num_indices,
+                                         const mat4 &model)
+{
+	mat4 mvp;
+	SIMD::mul(mvp, view_projection, model);
+
+	clip_scratch.resize(num_positions);
+	Rasterizer::transform_vertices(clip_scratch.data(), positions, num_positions, mvp);
+	Rasterizer::rasterize_depth_triangles(depth_pyramid[0].data(), clip_scratch.data(),
+	                                      indices, num_indices,
+	                                      uvec2(width, height), Rasterizer::CullMode::Back);
+}
+
+void OcclusionCuller::build_depth_hierarchy()
+{
+	for (unsigned level = 1; level < unsigned(depth_pyramid.size()); level++)
+	{
+		auto prev_res = level_resolutions[level - 1];
+		auto res = level_resolutions[level];
+		const float *prev = depth_pyramid[level - 1].data();
+		float *cur = depth_pyramid[level].data();
+
+		for (unsigned y = 0; y < res.y; y++)
+		{
+			unsigned y0 = muglm::min(2 * y + 0, prev_res.y - 1);
+			unsigned y1 = muglm::min(2 * y + 1, prev_res.y - 1);
+			for (unsigned x = 0; x < res.x; x++)
+			{
+				unsigned x0 = muglm::min(2 * x + 0, prev_res.x - 1);
+				unsigned x1 = muglm::min(2 * x + 1, prev_res.x - 1);
+				float d = muglm::max(muglm::max(prev[y0 * prev_res.x + x0], prev[y0 * prev_res.x + x1]),
+				                     muglm::max(prev[y1 * prev_res.x + x0], prev[y1 * prev_res.x + x1]));
+				cur[y * res.x + x] = d;
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::test_visibility(const AABB &aabb) const
+{
+	if (depth_pyramid.empty())
+		return true;
+
+	vec2 lo(FLT_MAX);
+	vec2 hi(-FLT_MAX);
+	float min_z = FLT_MAX;
+
+	for (unsigned i = 0; i < 8; i++)
+	{
+		vec4 clip;
+		SIMD::mul(clip, view_projection, vec4(aabb.get_corner(i), 1.0f));
+
+		// Boxes crossing the near plane cannot be safely projected, keep them.
+		if (clip.w <= 0.0f)
+			return true;
+
+		float inv_w = 1.0f / clip.w;
+		vec2 uv = vec2(clip.x, clip.y) * (0.5f * inv_w) + 0.5f;
+		lo = min(lo, uv);
+		hi = max(hi, uv);
+		min_z = muglm::min(min_z, clip.z * inv_w);
+	}
+
+	min_z = clamp(min_z, 0.0f, 1.0f);
+
+	int x0 = int(lo.x * float(width));
+	int x1 = int(hi.x * float(width));
+	int y0 = int(lo.y * float(height));
+	int y1 = int(hi.y * float(height));
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, int(width) - 1);
+	y1 = std::min(y1, int(height) - 1);
+
+	// Fully off-screen, leave the decision to the frustum cull.
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	// Walk up the pyramid until the rect covers at most 2x2 texels.
+	unsigned level = 0;
+	unsigned num_levels = unsigned(depth_pyramid.size());
+	while (level + 1 < num_levels && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	auto res = level_resolutions[level];
+	const float *depth = depth_pyramid[level].data();
+	x0 >>= level;
+	x1 >>= level;
+	y0 >>= level;
+	y1 >>= level;
+
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++)
+			if (min_z < depth[y * int(res.x) + x])
+				return true;
+
+	return false;
+}
+
+void OcclusionCuller::filter_list(VisibilityList &list) const
+{
+	auto itr = remove_if(begin(list), end(list), [this](const RenderableInfo &info) {
+		if (!info.transform)
+			return false;
+		if ((info.renderable->flags & RENDERABLE_FORCE_VISIBLE_BIT) != 0)
+			return false;
+		return !test_visibility(info.transform->world_aabb);
+	});
+	list.erase(itr, end(list));
+}
+}
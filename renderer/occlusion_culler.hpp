@@ -0,0 +1,67 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "math.hpp"
+#include "aabb.hpp"
+#include "scene.hpp"
+#include <vector>
+
+namespace Granite
+{
+// Software occlusion culling against a coarse hierarchical depth buffer.
+// Rasterize simplified occluder meshes with rasterize_occluder(), build the
+// depth pyramid once, then test world-space AABBs (or filter whole visibility
+// lists) before they are pushed to the render queues.
+class OcclusionCuller
+{
+public:
+	// Typical resolutions are in the 256x144 range. Clears depth to far.
+	void reset(unsigned width, unsigned height, const mat4 &view_projection);
+
+	// Rasterizes an occluder mesh into the depth buffer.
+	// Must be called before build_depth_hierarchy().
+	void rasterize_occluder(const vec4 *positions, unsigned num_positions,
+	                        const unsigned *indices, unsigned num_indices,
+	                        const mat4 &model);
+
+	void build_depth_hierarchy();
+
+	// Conservative test. Returns true if the AABB might be visible.
+	bool test_visibility(const AABB &aabb) const;
+
+	// Removes entries from the list whose world AABB is occluded.
+	// Unbounded renderables are always kept.
+	void filter_list(VisibilityList &list) const;
+
+private:
+	mat4 view_projection;
+	unsigned width = 0;
+	unsigned height = 0;
+	// Level 0 is full resolution, every following level halves each dimension
+	// and holds the farthest depth of the corresponding texels.
+	std::vector<std::vector<float>> depth_pyramid;
+	std::vector<uvec2> level_resolutions;
+	std::vector<vec4> clip_scratch;
+};
+}
@@ -29,6 +29,11 @@
 #include "muglm/matrix_helper.hpp"
 #include <random>
 #include "timer.hpp"
+#include "fft/glfft_wisdom.hpp"
+#include "filesystem.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#include "string_helpers.hpp"
 
 using namespace std;
 
@@ -102,6 +107,14 @@ bool Ocean::on_frame_tick(const Granite::FrameTickEvent &e)
 	return true;
 }
 
+static string fft_wisdom_path(Vulkan::Device &device)
+{
+	auto &props = device.get_gpu_properties();
+	return Util::join("cache://fft_wisdom_",
+	                  props.vendorID, "_", props.deviceID, "_", props.driverVersion,
+	                  ".json");
+}
+
 void Ocean::on_device_created(const Vulkan::DeviceCreatedEvent &e)
 {
 	fft_iface = FFTInterface(&e.get_device());
@@ -113,6 +126,18 @@ void Ocean::on_device_created(const Vulkan::DeviceCreatedEvent &e)
 	options.performance =
 			GLFFT::FFTWisdom::get_static_performance_options_from_renderer(&fft_iface);
 
+	GLFFT::FFTWisdom wisdom;
+	wisdom.set_static_wisdom(GLFFT::FFTWisdom::get_static_wisdom_from_renderer(&fft_iface));
+
+	auto wisdom_path = fft_wisdom_path(e.get_device());
+	string wisdom_json;
+	bool have_wisdom = Global::filesystem()->read_file_to_string(wisdom_path, wisdom_json);
+	if (have_wisdom)
+	{
+		wisdom.extract(wisdom_json.c_str());
+		LOGI("Loaded FFT wisdom from %s.\n", wisdom_path.c_str());
+	}
+
 	Util::Timer timer;
 	timer.start();
 
@@ -122,29 +147,72 @@ void Ocean::on_device_created(const Vulkan::DeviceCreatedEvent &e)
 	                                config.fft_resolution, config.fft_resolution,
 	                                GLFFT::ComplexToReal, GLFFT::Inverse,
 	                                GLFFT::SSBO, GLFFT::ImageReal,
-	                                cache, options));
+	                                cache, options, wisdom));
 
 	displacement_fft.reset(new GLFFT::FFT(&fft_iface,
 	                                      config.fft_resolution >> config.displacement_downsample,
 	                                      config.fft_resolution >> config.displacement_downsample,
 	                                      GLFFT::ComplexToComplex, GLFFT::Inverse,
 	                                      GLFFT::SSBO, GLFFT::Image,
-	                                      cache, options));
+	                                      cache, options, wisdom));
 
 	normal_fft.reset(new GLFFT::FFT(&fft_iface,
 	                                config.fft_resolution, config.fft_resolution,
 	                                GLFFT::ComplexToComplex, GLFFT::Inverse,
 	                                GLFFT::SSBO, GLFFT::Image,
-	                                cache, options));
+	                                cache, options, wisdom));
 
 	LOGI("Creating GLFFT took %.3f ms!\n", timer.end() * 1000.0);
 
+	if (!have_wisdom)
+	{
+		// Tune the FFT subdivision strategies for this GPU in the background
+		// and persist the result, so the next startup gets tuned options
+		// without paying the benchmark cost on the critical path.
+		auto *group = Global::thread_group();
+		if (group)
+		{
+			auto *device = &e.get_device();
+			unsigned resolution = config.fft_resolution;
+			unsigned displacement_resolution = config.fft_resolution >> config.displacement_downsample;
+			auto fft_type = options.type;
+
+			wisdom_learn_task = group->create_task([device, wisdom_path, resolution, displacement_resolution, fft_type]() {
+				FFTInterface iface(device);
+				GLFFT::FFTWisdom learned;
+				learned.set_static_wisdom(GLFFT::FFTWisdom::get_static_wisdom_from_renderer(&iface));
+				learned.learn_optimal_options_exhaustive(&iface, resolution, resolution,
+				                                         GLFFT::ComplexToReal, GLFFT::SSBO, GLFFT::ImageReal, fft_type);
+				learned.learn_optimal_options_exhaustive(&iface, resolution, resolution,
+				                                         GLFFT::ComplexToComplex, GLFFT::SSBO, GLFFT::Image, fft_type);
+				if (displacement_resolution != resolution)
+				{
+					learned.learn_optimal_options_exhaustive(&iface, displacement_resolution, displacement_resolution,
+					                                         GLFFT::ComplexToComplex, GLFFT::SSBO, GLFFT::Image, fft_type);
+				}
+
+				if (Global::filesystem()->write_string_to_file(wisdom_path, learned.archive()))
+					LOGI("Saved FFT wisdom to %s.\n", wisdom_path.c_str());
+				else
+					LOGE("Failed to save FFT wisdom to %s.\n", wisdom_path.c_str());
+			});
+			wisdom_learn_task->flush();
+		}
+	}
+
 	build_buffers(e.get_device());
 	init_distributions(e.get_device());
 }
 
 void Ocean::on_device_destroyed(const Vulkan::DeviceCreatedEvent &)
 {
+	// The tuning task benchmarks against the device, so it cannot outlive it.
+	if (wisdom_learn_task)
+	{
+		wisdom_learn_task->wait();
+		wisdom_learn_task.reset();
+	}
+
 	vertex_mip_views.clear();
 	fragment_mip_views.clear();
 	normal_mip_views.clear();
@@ -187,9 +255,18 @@ void Ocean::setup_render_pass_dependencies(RenderGraph &, RenderPass &target)
 	target.add_uniform_input("ocean-lod-data", VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
 	target.add_texture_input("ocean-lods", VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
 
-	target.add_texture_input("ocean-height-displacement-output", VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
-	target.add_texture_input("ocean-gradient-jacobian-output", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-	target.add_texture_input("ocean-normal-fft-output", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	if (config.one_frame_latency)
+	{
+		target.add_history_input("ocean-height-displacement-output");
+		target.add_history_input("ocean-gradient-jacobian-output");
+		target.add_history_input("ocean-normal-fft-output");
+	}
+	else
+	{
+		target.add_texture_input("ocean-height-displacement-output", VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+		target.add_texture_input("ocean-gradient-jacobian-output", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		target.add_texture_input("ocean-normal-fft-output", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
 
 	if (!config.refraction.input.empty() && config.refraction.input_is_render_graph)
 		refraction_resource = &target.add_texture_input(config.refraction.input);
@@ -199,6 +276,14 @@ void Ocean::setup_render_pass_dependencies(RenderGraph &, RenderPass &target)
 
 void Ocean::setup_render_pass_resources(RenderGraph &graph_)
 {
+	if (&graph_.get_physical_texture_resource(*height_displacement_output) != cached_height_displacement)
+	{
+		cached_height_displacement = &graph_.get_physical_texture_resource(*height_displacement_output);
+		vertex_mip_views.clear();
+		fragment_mip_views.clear();
+		normal_mip_views.clear();
+	}
+
 	if (vertex_mip_views.empty() && fragment_mip_views.empty() && normal_mip_views.empty())
 	{
 		auto &vertex = graph_.get_physical_texture_resource(*height_displacement_output);
@@ -592,7 +677,7 @@ void Ocean::update_fft_pass(Vulkan::CommandBuffer &cmd)
 
 void Ocean::add_lod_update_pass(RenderGraph &graph_)
 {
-	auto &update_lod = graph_.add_pass("ocean-update-lods", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+	auto &update_lod = graph_.add_pass("ocean-update-lods", RenderGraph::get_default_compute_queue());
 	AttachmentInfo lod_attachment;
 	lod_attachment.format = VK_FORMAT_R16_SFLOAT;
 	lod_attachment.size_x = float(config.grid_count);
@@ -647,7 +732,7 @@ void Ocean::add_fft_update_pass(RenderGraph &graph_)
 	normal_map.aux_usage = VK_IMAGE_USAGE_SAMPLED_BIT;
 	normal_map.levels = 0;
 
-	auto &update_fft = graph_.add_pass("ocean-update-fft", RENDER_GRAPH_QUEUE_COMPUTE_BIT);
+	auto &update_fft = graph_.add_pass("ocean-update-fft", RenderGraph::get_default_compute_queue());
 
 	height_fft_input = &update_fft.add_storage_output("ocean-height-fft-input",
 	                                                  height_info);
@@ -799,9 +884,31 @@ void Ocean::get_render_info(const RenderContext &,
 	auto &ubo = graph->get_physical_buffer_resource(*lod_data);
 	auto &indirect = graph->get_physical_buffer_resource(*lod_data_counters);
 	auto &lod = graph->get_physical_texture_resource(*ocean_lod);
-	auto &normal = graph->get_physical_texture_resource(*normal_fft_output);
-	auto &height_displacement = graph->get_physical_texture_resource(*height_displacement_output);
-	auto &grad_jacobian = graph->get_physical_texture_resource(*gradient_jacobian_output);
+
+	const Vulkan::ImageView *normal_view;
+	const Vulkan::ImageView *height_displacement_view;
+	const Vulkan::ImageView *grad_jacobian_view;
+
+	if (config.one_frame_latency)
+	{
+		normal_view = graph->get_physical_history_texture_resource(*normal_fft_output);
+		height_displacement_view = graph->get_physical_history_texture_resource(*height_displacement_output);
+		grad_jacobian_view = graph->get_physical_history_texture_resource(*gradient_jacobian_output);
+
+		// First frame, there is nothing to render with yet.
+		if (!normal_view || !height_displacement_view || !grad_jacobian_view)
+			return;
+	}
+	else
+	{
+		normal_view = &graph->get_physical_texture_resource(*normal_fft_output);
+		height_displacement_view = &graph->get_physical_texture_resource(*height_displacement_output);
+		grad_jacobian_view = &graph->get_physical_texture_resource(*gradient_jacobian_output);
+	}
+
+	auto &normal = *normal_view;
+	auto &height_displacement = *height_displacement_view;
+	auto &grad_jacobian = *grad_jacobian_view;
 
 	hasher.string("ocean");
 	hasher.u64(lod.get_cookie());
@@ -28,6 +28,7 @@
 #include "fft/glfft.hpp"
 #include "glfft_granite_interface.hpp"
 #include "application_events.hpp"
+#include "thread_group.hpp"
 #include <vector>
 
 namespace Granite
@@ -58,6 +59,12 @@ struct OceanConfig
 		bool bandlimited_pixel = false;
 		bool input_is_render_graph = false;
 	} refraction;
+
+	// Renders with the previous frame's FFT results instead of waiting for this
+	// frame's. The FFT outputs get double-buffered through the render graph's
+	// history mechanism, so the async compute FFT work can overlap the whole
+	// graphics frame instead of just the passes which do not consume it.
+	bool one_frame_latency = false;
 };
 
 class Ocean : public AbstractRenderable,
@@ -91,6 +98,7 @@ private:
 	std::unique_ptr<GLFFT::FFT> displacement_fft;
 	FFTInterface fft_iface;
 	FFTDeferredCommandBuffer deferred_cmd;
+	TaskGroup wisdom_learn_task;
 
 	float frequency_bands[FrequencyBands];
 	bool freq_band_modulation = false;
@@ -121,6 +129,9 @@ private:
 	std::vector<Vulkan::ImageViewHandle> vertex_mip_views;
 	std::vector<Vulkan::ImageViewHandle> fragment_mip_views;
 	std::vector<Vulkan::ImageViewHandle> normal_mip_views;
+	// With one_frame_latency the physical images alternate every frame,
+	// so the cached views and FFT commands must track the current image.
+	const Vulkan::ImageView *cached_height_displacement = nullptr;
 
 	Vulkan::BufferHandle distribution_buffer;
 	Vulkan::BufferHandle distribution_buffer_displacement;
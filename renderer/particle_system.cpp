@@ -0,0 +1,299 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "particle_system.hpp"
+#include "render_graph.hpp"
+#include "render_context.hpp"
+#include "device.hpp"
+#include "muglm/muglm_impl.hpp"
+
+using namespace Vulkan;
+using namespace Util;
+
+namespace Granite
+{
+ParticleSystem::ParticleSystem(const ParticleSystemConfig &config_)
+	: config(config_)
+{
+	EVENT_MANAGER_REGISTER_LATCH(ParticleSystem, on_device_created, on_device_destroyed, Vulkan::DeviceCreatedEvent);
+	EVENT_MANAGER_REGISTER(ParticleSystem, on_frame_tick, FrameTickEvent);
+}
+
+ParticleSystem::Handles ParticleSystem::add_to_scene(Scene &scene, const ParticleSystemConfig &config)
+{
+	Handles handles;
+	handles.entity = scene.create_entity();
+
+	auto system = Util::make_handle<ParticleSystem>(config);
+
+	auto *rp = handles.entity->allocate_component<RenderPassComponent>();
+	rp->creator = system.get();
+
+	auto *renderable = handles.entity->allocate_component<RenderableComponent>();
+	renderable->renderable = system;
+
+	// No cached transform, which puts the system in the always-visible part of
+	// the transparent spatial list.
+	handles.entity->allocate_component<RenderInfoComponent>();
+	handles.entity->allocate_component<TransparentComponent>();
+
+	handles.system = system.get();
+	return handles;
+}
+
+unsigned ParticleSystem::add_emitter(const Emitter &emitter)
+{
+	emitters.push_back(emitter);
+	emit_accum.push_back(0.0f);
+	return unsigned(emitters.size() - 1);
+}
+
+ParticleSystem::Emitter &ParticleSystem::get_emitter(unsigned index)
+{
+	assert(index < emitters.size());
+	return emitters[index];
+}
+
+bool ParticleSystem::on_frame_tick(const FrameTickEvent &e)
+{
+	frame_time = float(e.get_frame_time());
+	return true;
+}
+
+void ParticleSystem::on_device_created(const Vulkan::DeviceCreatedEvent &)
+{
+	needs_init = true;
+}
+
+void ParticleSystem::on_device_destroyed(const Vulkan::DeviceCreatedEvent &)
+{
+	needs_init = true;
+	cached_list_cookie = 0;
+}
+
+void ParticleSystem::set_base_render_context(const RenderContext *context_)
+{
+	context = context_;
+}
+
+void ParticleSystem::add_render_passes(RenderGraph &graph_)
+{
+	graph = &graph_;
+	auto &simulate = graph_.add_pass("particle-simulate", RenderGraph::get_default_compute_queue());
+
+	BufferInfo data_info;
+	data_info.size = config.max_particles * (3 * sizeof(vec4));
+	particle_data = &simulate.add_storage_output("particle-data", data_info);
+
+	// Two ping-ponged alive lists plus the dead list, with counters up front.
+	BufferInfo list_info;
+	list_info.size = 4 * sizeof(uint32_t) + 3 * config.max_particles * sizeof(uint32_t);
+	particle_lists = &simulate.add_storage_output("particle-lists", list_info);
+
+	BufferInfo draw_info;
+	draw_info.size = 4 * sizeof(uint32_t);
+	particle_draw = &simulate.add_storage_output("particle-draw", draw_info);
+
+	simulate.set_build_render_pass([&](Vulkan::CommandBuffer &cmd) {
+		simulation_pass(cmd);
+	});
+}
+
+void ParticleSystem::setup_render_pass_dependencies(RenderGraph &, RenderPass &target)
+{
+	target.add_indirect_buffer_input("particle-draw");
+	target.add_storage_read_only_input("particle-data", VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+	target.add_storage_read_only_input("particle-lists", VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+}
+
+void ParticleSystem::setup_render_pass_resources(RenderGraph &graph_)
+{
+	// If the graph rebaked into fresh physical buffers, the free lists must be rebuilt.
+	auto &lists = graph_.get_physical_buffer_resource(*particle_lists);
+	if (lists.get_cookie() != cached_list_cookie)
+	{
+		cached_list_cookie = lists.get_cookie();
+		needs_init = true;
+	}
+}
+
+void ParticleSystem::simulation_pass(Vulkan::CommandBuffer &cmd)
+{
+	auto &data = graph->get_physical_buffer_resource(*particle_data);
+	auto &lists = graph->get_physical_buffer_resource(*particle_lists);
+	auto &draw = graph->get_physical_buffer_resource(*particle_draw);
+
+	cmd.set_storage_buffer(0, 0, data);
+	cmd.set_storage_buffer(0, 1, lists);
+	cmd.set_storage_buffer(0, 2, draw);
+
+	const std::vector<std::pair<std::string, int>> defines = {
+		{ "MAX_PARTICLES", int(config.max_particles) },
+	};
+
+	if (needs_init)
+	{
+		cmd.set_program("builtin://shaders/particles/particle_init.comp", defines);
+		cmd.dispatch((config.max_particles + 63) / 64, 1, 1);
+		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT);
+		needs_init = false;
+		frame_parity = 0;
+	}
+
+	frame_parity ^= 1u;
+	uint32_t read_list = 1u - frame_parity;
+	uint32_t write_list = frame_parity;
+
+	cmd.set_program("builtin://shaders/particles/particle_prepare.comp", defines);
+	cmd.push_constants(&write_list, 0, sizeof(write_list));
+	cmd.dispatch(1, 1, 1);
+
+	// Prepare and emit touch disjoint counters, so they can overlap.
+	for (unsigned i = 0; i < emitters.size(); i++)
+	{
+		auto &emitter = emitters[i];
+		emit_accum[i] += emitter.particles_per_second * frame_time;
+		auto count = unsigned(emit_accum[i]);
+		emit_accum[i] -= float(count);
+		if (!count)
+			continue;
+
+		struct Emit
+		{
+			alignas(16) vec3 position;
+			alignas(4) float radius;
+			alignas(16) vec3 velocity;
+			alignas(4) float velocity_spread;
+			alignas(16) vec4 color;
+			alignas(4) float size;
+			alignas(4) float lifetime;
+			alignas(4) uint32_t count;
+			alignas(4) uint32_t read_list;
+			alignas(4) uint32_t seed;
+		} push;
+
+		push.position = emitter.position;
+		push.radius = emitter.radius;
+		push.velocity = emitter.velocity;
+		push.velocity_spread = emitter.velocity_spread;
+		push.color = emitter.color;
+		push.size = emitter.size;
+		push.lifetime = emitter.lifetime;
+		push.count = count;
+		push.read_list = read_list;
+		push.seed = ++emit_seed * 0x9e3779b9u + i;
+
+		cmd.set_program("builtin://shaders/particles/particle_emit.comp", defines);
+		cmd.push_constants(&push, 0, sizeof(push));
+		cmd.dispatch((count + 63) / 64, 1, 1);
+	}
+
+	cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+	struct Simulate
+	{
+		alignas(16) vec3 gravity;
+		alignas(4) float delta_time;
+		alignas(4) float drag;
+		alignas(4) uint32_t read_list;
+		alignas(4) uint32_t write_list;
+	} sim;
+
+	sim.gravity = config.gravity;
+	sim.delta_time = frame_time;
+	sim.drag = config.drag;
+	sim.read_list = read_list;
+	sim.write_list = write_list;
+
+	cmd.set_program("builtin://shaders/particles/particle_simulate.comp", defines);
+	cmd.push_constants(&sim, 0, sizeof(sim));
+	cmd.dispatch((config.max_particles + 63) / 64, 1, 1);
+
+	cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+	cmd.set_program("builtin://shaders/particles/particle_finalize.comp", defines);
+	cmd.push_constants(&write_list, 0, sizeof(write_list));
+	cmd.dispatch(1, 1, 1);
+}
+
+struct ParticleRenderInfo
+{
+	const Buffer *data;
+	const Buffer *lists;
+	const Buffer *indirect;
+	uint32_t write_list;
+	int max_particles;
+};
+
+static void particle_render(CommandBuffer &cmd, const RenderQueueData *infos, unsigned instances)
+{
+	for (unsigned i = 0; i < instances; i++)
+	{
+		auto *info = static_cast<const ParticleRenderInfo *>(infos[i].render_info);
+
+		cmd.set_program("builtin://shaders/particles/particle.vert",
+		                "builtin://shaders/particles/particle.frag",
+		                {{ "MAX_PARTICLES", info->max_particles }});
+		cmd.set_storage_buffer(2, 0, *info->data);
+		cmd.set_storage_buffer(2, 1, *info->lists);
+		cmd.push_constants(&info->write_list, 0, sizeof(info->write_list));
+		cmd.set_primitive_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+		cmd.draw_indirect(*info->indirect, 0, 1, 4 * sizeof(uint32_t));
+	}
+}
+
+void ParticleSystem::get_render_info(const RenderContext &context_, const RenderInfoComponent *,
+                                     RenderQueue &queue) const
+{
+	if (!graph || !particle_data)
+		return;
+
+	auto &data = graph->get_physical_buffer_resource(*particle_data);
+	auto &lists = graph->get_physical_buffer_resource(*particle_lists);
+	auto &draw = graph->get_physical_buffer_resource(*particle_draw);
+
+	Hasher hasher;
+	hasher.string("particles");
+	hasher.u64(data.get_cookie());
+	hasher.u64(lists.get_cookie());
+	hasher.u64(draw.get_cookie());
+	hasher.u32(frame_parity);
+
+	auto instance_key = hasher.get();
+	auto sorting_key = RenderInfo::get_sort_key(context_, Queue::Transparent, hasher.get(), hasher.get(), vec3(0.0f));
+
+	auto *info = queue.push<ParticleRenderInfo>(Queue::Transparent, instance_key, sorting_key,
+	                                            particle_render, nullptr);
+
+	if (info)
+	{
+		info->data = &data;
+		info->lists = &lists;
+		info->indirect = &draw;
+		info->write_list = frame_parity;
+		info->max_particles = int(config.max_particles);
+	}
+}
+}
@@ -0,0 +1,127 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "abstract_renderable.hpp"
+#include "scene.hpp"
+#include "application_events.hpp"
+#include "application_wsi_events.hpp"
+#include <vector>
+
+namespace Granite
+{
+class RenderBufferResource;
+
+struct ParticleSystemConfig
+{
+	unsigned max_particles = 128 * 1024;
+	vec3 gravity = vec3(0.0f, -9.81f, 0.0f);
+	float drag = 0.1f;
+};
+
+// GPU-resident particle subsystem. All particle state lives in persistent
+// storage buffers owned by the render graph; emit, simulate and compaction run
+// as compute dispatches in a render graph pass and the result is drawn with a
+// single indirect draw, so nothing is uploaded per frame and nothing is read
+// back. The alive index lists ping-pong every frame and survivors are
+// compacted into the write list, whose count becomes the instance count.
+class ParticleSystem : public AbstractRenderable,
+                       public RenderPassCreator,
+                       public EventHandler
+{
+public:
+	ParticleSystem(const ParticleSystemConfig &config = {});
+
+	struct Handles
+	{
+		Entity *entity;
+		ParticleSystem *system;
+	};
+
+	static Handles add_to_scene(Scene &scene, const ParticleSystemConfig &config = {});
+
+	struct Emitter
+	{
+		vec3 position = vec3(0.0f);
+		float radius = 0.1f;
+		vec3 velocity = vec3(0.0f, 2.0f, 0.0f);
+		float velocity_spread = 0.5f;
+		vec4 color = vec4(1.0f);
+		float size = 0.05f;
+		float lifetime = 2.0f;
+		float particles_per_second = 1000.0f;
+	};
+
+	unsigned add_emitter(const Emitter &emitter);
+	Emitter &get_emitter(unsigned index);
+
+private:
+	ParticleSystemConfig config;
+
+	bool on_frame_tick(const FrameTickEvent &e);
+	void on_device_created(const Vulkan::DeviceCreatedEvent &e);
+	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
+
+	void get_render_info(const RenderContext &context, const RenderInfoComponent *transform,
+	                     RenderQueue &queue) const override;
+
+	void get_depth_render_info(const RenderContext &, const RenderInfoComponent *,
+	                           RenderQueue &) const override
+	{
+	}
+
+	DrawPipeline get_mesh_draw_pipeline() const override
+	{
+		return DrawPipeline::AlphaBlend;
+	}
+
+	void add_render_passes(RenderGraph &graph) override;
+	void set_base_renderer(Renderer *, Renderer *, Renderer *) override
+	{
+	}
+	void set_base_render_context(const RenderContext *context) override;
+	void setup_render_pass_dependencies(RenderGraph &graph, RenderPass &target) override;
+	void setup_render_pass_resources(RenderGraph &graph) override;
+	void set_scene(Scene *) override
+	{
+	}
+
+	void simulation_pass(Vulkan::CommandBuffer &cmd);
+
+	std::vector<Emitter> emitters;
+	// Fractional particles carried over so low emission rates still emit.
+	std::vector<float> emit_accum;
+
+	RenderBufferResource *particle_data = nullptr;
+	RenderBufferResource *particle_lists = nullptr;
+	RenderBufferResource *particle_draw = nullptr;
+	RenderGraph *graph = nullptr;
+	const RenderContext *context = nullptr;
+
+	float frame_time = 0.0f;
+	uint32_t frame_parity = 0;
+	uint32_t emit_seed = 0;
+	bool needs_init = true;
+	uint64_t cached_list_cookie = 0;
+};
+}
@@ -101,6 +101,22 @@ bool setup_after_post_chain_antialiasing(PostAAType type, RenderGraph &graph, Te
 		setup_smaa_postprocess(graph, jitter, input, input_depth, output, SMAAPreset::Ultra_T2X);
 		return true;
 
+	case PostAAType::SMAA_Low_Compute:
+		setup_smaa_postprocess(graph, jitter, input, input_depth, output, SMAAPreset::Low_Compute);
+		return true;
+
+	case PostAAType::SMAA_Medium_Compute:
+		setup_smaa_postprocess(graph, jitter, input, input_depth, output, SMAAPreset::Medium_Compute);
+		return true;
+
+	case PostAAType::SMAA_High_Compute:
+		setup_smaa_postprocess(graph, jitter, input, input_depth, output, SMAAPreset::High_Compute);
+		return true;
+
+	case PostAAType::SMAA_Ultra_Compute:
+		setup_smaa_postprocess(graph, jitter, input, input_depth, output, SMAAPreset::Ultra_Compute);
+		return true;
+
 	default:
 		return false;
 	}
@@ -122,6 +138,14 @@ PostAAType string_to_post_antialiasing_type(const char *type)
 		return PostAAType::SMAA_Ultra;
 	else if (strcmp(type, "smaaUltraT2X") == 0)
 		return PostAAType::SMAA_Ultra_T2X;
+	else if (strcmp(type, "smaaLowCompute") == 0)
+		return PostAAType::SMAA_Low_Compute;
+	else if (strcmp(type, "smaaMediumCompute") == 0)
+		return PostAAType::SMAA_Medium_Compute;
+	else if (strcmp(type, "smaaHighCompute") == 0)
+		return PostAAType::SMAA_High_Compute;
+	else if (strcmp(type, "smaaUltraCompute") == 0)
+		return PostAAType::SMAA_Ultra_Compute;
 	else if (strcmp(type, "taaLow") == 0)
 		return PostAAType::TAA_Low;
 	else if (strcmp(type, "taaMedium") == 0)
@@ -37,6 +37,10 @@ enum class PostAAType
 	SMAA_High,
 	SMAA_Ultra,
 	SMAA_Ultra_T2X,
+	SMAA_Low_Compute,
+	SMAA_Medium_Compute,
+	SMAA_High_Compute,
+	SMAA_Ultra_Compute,
 	TAA_Low,
 	TAA_Medium,
 	TAA_High,
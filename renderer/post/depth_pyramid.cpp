@@ -0,0 +1,192 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "depth_pyramid.hpp"
+#include "render_context.hpp"
+#include "quirks.hpp"
+
+using namespace std;
+
+namespace Granite
+{
+// The shader binds the pyramid as a fixed-size image array.
+// One 64x64 tile per workgroup gives 7 mips, the single-workgroup tail
+// gives 6 more, which covers sources up to 4096x4096.
+static constexpr unsigned MaxPyramidLevels = 13;
+
+void DepthPyramid::add_pass(RenderGraph &graph, const string &output, const string &input_depth,
+                            DepthReductionMode mode)
+{
+	auto &pass = graph.add_pass(output + "-pyramid", RenderGraph::get_default_compute_queue());
+
+	AttachmentInfo info;
+	info.size_class = SizeClass::InputRelative;
+	info.size_relative_name = input_depth;
+	info.format = VK_FORMAT_R32_SFLOAT;
+	info.levels = 0; // Full mip chain.
+	info.aux_usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	auto &pyramid = pass.add_storage_texture_output(output, info);
+	auto &depth = pass.add_texture_input(input_depth);
+
+	pass.set_build_render_pass([&, mode](Vulkan::CommandBuffer &cmd) {
+		build(cmd, graph, pyramid, depth, mode);
+	});
+}
+
+void DepthPyramid::build(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
+                         RenderTextureResource &pyramid, RenderTextureResource &depth,
+                         DepthReductionMode mode)
+{
+	auto &device = cmd.get_device();
+	auto &output = graph.get_physical_texture_resource(pyramid);
+	auto &input = graph.get_physical_texture_resource(depth);
+
+	unsigned levels = output.get_image().get_create_info().levels;
+	unsigned width = output.get_image().get_width();
+	unsigned height = output.get_image().get_height();
+
+	// The persistent tail workgroup covers a 64x64 region of mip 6,
+	// so past 4096x4096 only the per-tile part of the chain is produced.
+	unsigned num_mips = min(levels, MaxPyramidLevels);
+	if (width > 4096 || height > 4096)
+		num_mips = min(num_mips, 7u);
+
+	if (&output != cached_pyramid)
+	{
+		cached_pyramid = &output;
+		mip_views.clear();
+		for (unsigned i = 0; i < levels; i++)
+		{
+			Vulkan::ImageViewCreateInfo view;
+			view.image = &output.get_image();
+			view.format = output.get_format();
+			view.layers = 1;
+			view.levels = 1;
+			view.base_level = i;
+			mip_views.push_back(device.create_image_view(view));
+		}
+	}
+
+	if (!atomic_counter)
+	{
+		Vulkan::BufferCreateInfo buffer_info = {};
+		buffer_info.size = sizeof(uint32_t);
+		buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		buffer_info.domain = Vulkan::BufferDomain::Device;
+		// The shader leaves the counter back at zero after each dispatch,
+		// so zero-initializing once on creation is enough.
+		buffer_info.misc = Vulkan::BUFFER_MISC_ZERO_INITIALIZE_BIT;
+		atomic_counter = device.create_buffer(buffer_info, nullptr);
+	}
+
+	// The clustered reductions assume full subgroups of at least 16 lanes
+	// with a linear lane <-> local invocation mapping, so lock that down
+	// with subgroup size control, like clusterer binning does.
+	bool use_subgroups = false;
+	auto &features = device.get_device_features();
+	constexpr VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_CLUSTERED_BIT;
+
+	if (features.subgroup_size_control_features.subgroupSizeControl &&
+	    features.subgroup_size_control_features.computeFullSubgroups &&
+	    (features.subgroup_properties.supportedOperations & required) == required &&
+	    (features.subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+	    !Vulkan::ImplementationQuirks::get().force_no_subgroups)
+	{
+		auto &props = features.subgroup_size_control_properties;
+		if (props.minSubgroupSize <= 32 && props.maxSubgroupSize >= 32 &&
+		    (props.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0)
+		{
+			cmd.enable_subgroup_size_control(true);
+			cmd.set_subgroup_size_log2(true, 5, 5);
+			use_subgroups = true;
+		}
+		else if (props.minSubgroupSize >= 16 && props.maxSubgroupSize <= 64)
+		{
+			cmd.enable_subgroup_size_control(true);
+			cmd.set_subgroup_size_log2(true, 4, 6);
+			use_subgroups = true;
+		}
+	}
+
+	cmd.set_program("builtin://shaders/post/depth_pyramid.comp",
+	                {{ "SUBGROUPS", use_subgroups ? 1 : 0 },
+	                 { "REDUCE_MAX", mode == DepthReductionMode::Max ? 1 : 0 }});
+
+	cmd.set_texture(0, 0, input, Vulkan::StockSampler::NearestClamp);
+	cmd.set_storage_buffer(0, 1, *atomic_counter);
+
+	// The descriptor array is fixed size, pad out with the last mip.
+	// Writes beyond num_mips are rejected in the shader.
+	for (unsigned i = 0; i < MaxPyramidLevels; i++)
+		cmd.set_storage_texture(0, 2 + i, *mip_views[min(i, levels - 1)]);
+
+	struct Push
+	{
+		uint32_t resolution[2];
+		uint32_t num_workgroups[2];
+		uint32_t num_mips;
+	} push = {};
+
+	unsigned groups_x = (width + 63) / 64;
+	unsigned groups_y = (height + 63) / 64;
+	push.resolution[0] = width;
+	push.resolution[1] = height;
+	push.num_workgroups[0] = groups_x;
+	push.num_workgroups[1] = groups_y;
+	push.num_mips = num_mips;
+	cmd.push_constants(&push, 0, sizeof(push));
+
+	cmd.dispatch(groups_x, groups_y, 1);
+	cmd.enable_subgroup_size_control(false);
+}
+
+void HiZPredicate::add_pass(RenderGraph &graph, const string &output, const string &pyramid)
+{
+	auto &pass = graph.add_pass(output + "-predicate", RenderGraph::get_default_compute_queue());
+
+	BufferInfo info;
+	info.size = sizeof(uint32_t);
+	auto &predicate = pass.add_storage_output(output, info);
+	auto &depth_pyramid = pass.add_texture_input(pyramid);
+
+	pass.set_build_render_pass([&](Vulkan::CommandBuffer &cmd) {
+		cmd.set_program("builtin://shaders/hiz_predicate.comp");
+		cmd.set_texture(0, 0, graph.get_physical_texture_resource(depth_pyramid),
+		                Vulkan::StockSampler::NearestClamp);
+		cmd.set_storage_buffer(0, 1, graph.get_physical_buffer_resource(predicate));
+
+		struct Push
+		{
+			mat4 view_projection;
+			alignas(16) vec3 aabb_min;
+			alignas(16) vec3 aabb_max;
+		} push = {};
+
+		push.view_projection = context ? context->get_render_parameters().view_projection : mat4(1.0f);
+		push.aabb_min = aabb.get_minimum();
+		push.aabb_max = aabb.get_maximum();
+		cmd.push_constants(&push, 0, sizeof(push));
+		cmd.dispatch(1, 1, 1);
+	});
+}
+}
@@ -0,0 +1,91 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "render_graph.hpp"
+#include "aabb.hpp"
+
+namespace Granite
+{
+class RenderContext;
+
+enum class DepthReductionMode
+{
+	Min,
+	Max
+};
+
+// Shared single-dispatch depth pyramid generator for hi-Z occlusion, SSAO,
+// volumetric fog and other consumers which need a reduced depth mip chain.
+// The full chain is built in one compute dispatch using clustered subgroup
+// operations and shared memory where supported, so registering one pyramid
+// per depth buffer and pointing every consumer at it avoids the cost of
+// per-consumer reduction passes.
+// The instance owns cached per-mip views and must outlive graph rebakes,
+// just like Ocean and other stateful pass providers.
+class DepthPyramid
+{
+public:
+	// Registers a compute pass which renders a full R32_SFLOAT mip pyramid
+	// of input_depth into a new texture resource called output.
+	// Consumers declare add_texture_input(output) as usual.
+	void add_pass(RenderGraph &graph, const std::string &output, const std::string &input_depth,
+	              DepthReductionMode mode = DepthReductionMode::Min);
+
+private:
+	void build(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
+	           RenderTextureResource &pyramid, RenderTextureResource &depth,
+	           DepthReductionMode mode);
+
+	Vulkan::BufferHandle atomic_counter;
+	const Vulkan::ImageView *cached_pyramid = nullptr;
+	std::vector<Vulkan::ImageViewHandle> mip_views;
+};
+
+// One-workgroup compute pass which tests a world-space AABB against a
+// max-reduced depth pyramid and writes a uint32 predicate (1 = maybe visible)
+// into a new buffer resource named output. Expensive passes gate themselves on
+// it via RenderPass::add_conditional_input(output), so planar reflections,
+// refraction and similar passes cost nothing on the GPU while their proxy
+// volume is occluded or off-screen. The AABB and context can be updated per
+// frame; the instance must outlive graph rebakes like other pass providers.
+class HiZPredicate
+{
+public:
+	void add_pass(RenderGraph &graph, const std::string &output, const std::string &pyramid);
+
+	void set_aabb(const AABB &aabb_)
+	{
+		aabb = aabb_;
+	}
+
+	void set_render_context(const RenderContext *context_)
+	{
+		context = context_;
+	}
+
+private:
+	AABB aabb { vec3(0.0f), vec3(0.0f) };
+	const RenderContext *context = nullptr;
+};
+}
@@ -61,11 +61,15 @@ static void luminance_build_render_pass(RenderPass &pass, Vulkan::CommandBuffer
 	cmd.dispatch(1, 1, 1);
 }
 
-static void luminance_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
-                                    const RenderBufferResource &lum, const RenderTextureResource &d3)
+static void luminance_histogram_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
+                                              const RenderBufferResource &histogram, const RenderTextureResource &hdr)
 {
-	auto &input = graph.get_physical_texture_resource(d3);
-	auto &output = graph.get_physical_buffer_resource(lum);
+	auto &output = graph.get_physical_buffer_resource(histogram);
+	auto &input = graph.get_physical_texture_resource(hdr);
+
+	cmd.fill_buffer(output, 0);
+	cmd.barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
 
 	cmd.set_storage_buffer(0, 0, output);
 	cmd.set_texture(0, 1, input, Vulkan::StockSampler::LinearClamp);
@@ -73,21 +77,47 @@ static void luminance_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph &gra
 	unsigned half_width = input.get_image().get_create_info().width / 2;
 	unsigned half_height = input.get_image().get_create_info().height / 2;
 
-	auto *program = cmd.get_device().get_shader_manager().register_compute("builtin://shaders/post/luminance.comp");
+	auto *program = cmd.get_device().get_shader_manager().register_compute("builtin://shaders/post/luminance_histogram.comp");
 	unsigned variant = program->register_variant({});
 	cmd.set_program(program->get_program(variant));
 
 	struct Registers
 	{
 		uvec2 size;
-		float lerp;
-		float minimum;
-		float maximum;
+		vec2 inv_size;
+		float min_loglum;
+		float inv_loglum_range;
 	} push;
 	push.size = uvec2(half_width, half_height);
+	push.inv_size = vec2(1.0f / half_width, 1.0f / half_height);
+	push.min_loglum = -3.0f;
+	push.inv_loglum_range = 1.0f / (2.0f - -3.0f);
+	cmd.push_constants(&push, 0, sizeof(push));
+	cmd.dispatch((half_width + 15) / 16, (half_height + 15) / 16, 1);
+}
+
+static void luminance_histogram_resolve_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
+                                                      const RenderBufferResource &lum, const RenderBufferResource &histogram)
+{
+	auto &output = graph.get_physical_buffer_resource(lum);
+	auto &input = graph.get_physical_buffer_resource(histogram);
+
+	cmd.set_storage_buffer(0, 0, output);
+	cmd.set_storage_buffer(0, 1, input);
+
+	auto *program = cmd.get_device().get_shader_manager().register_compute("builtin://shaders/post/luminance_histogram_resolve.comp");
+	unsigned variant = program->register_variant({});
+	cmd.set_program(program->get_program(variant));
+
+	struct Registers
+	{
+		float lerp;
+		float min_loglum;
+		float loglum_range;
+	} push;
 	push.lerp = 1.0f - pow(0.5f, Global::common_renderer_data()->frame_tick.frame_time);
-	push.minimum = -3.0f;
-	push.maximum = 2.0f;
+	push.min_loglum = -3.0f;
+	push.loglum_range = 2.0f - -3.0f;
 	cmd.push_constants(&push, 0, sizeof(push));
 	cmd.dispatch(1, 1, 1);
 }
@@ -110,7 +140,8 @@ static void bloom_threshold_build_render_pass(RenderPass &pass, Vulkan::CommandB
 static void bloom_threshold_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
                                           const RenderTextureResource &threshold,
                                           const RenderTextureResource &hdr,
-                                          const RenderBufferResource *ubo_res)
+                                          const RenderBufferResource *ubo_res,
+                                          bool packed)
 {
 	auto &output = graph.get_physical_texture_resource(threshold);
 	auto &input = graph.get_physical_texture_resource(hdr);
@@ -123,7 +154,7 @@ static void bloom_threshold_build_compute(Vulkan::CommandBuffer &cmd, RenderGrap
 
 	cmd.set_program(
 			"builtin://shaders/post/bloom_threshold.comp",
-			{{ "DYNAMIC_EXPOSURE", ubo ? 1 : 0 }});
+			{{ "DYNAMIC_EXPOSURE", ubo ? 1 : 0 }, { "BLOOM_PACKED", packed ? 1 : 0 }});
 
 	struct Registers
 	{
@@ -140,7 +171,7 @@ static void bloom_threshold_build_compute(Vulkan::CommandBuffer &cmd, RenderGrap
 
 static void bloom_downsample_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
                                            const RenderTextureResource &output_res, const RenderTextureResource &input_res,
-                                           const RenderTextureResource *feedback)
+                                           const RenderTextureResource *feedback, bool packed)
 {
 	auto &output = graph.get_physical_texture_resource(output_res);
 	auto &input = graph.get_physical_texture_resource(input_res);
@@ -158,7 +189,7 @@ static void bloom_downsample_build_compute(Vulkan::CommandBuffer &cmd, RenderGra
 	}
 
 	auto *program = cmd.get_device().get_shader_manager().register_compute("builtin://shaders/post/bloom_downsample.comp");
-	unsigned variant = program->register_variant({{ "FEEDBACK", feedback ? 1 : 0 }});
+	unsigned variant = program->register_variant({{ "FEEDBACK", feedback ? 1 : 0 }, { "BLOOM_PACKED", packed ? 1 : 0 }});
 	cmd.set_program(program->get_program(variant));
 
 	struct Registers
@@ -182,7 +213,8 @@ static void bloom_downsample_build_compute(Vulkan::CommandBuffer &cmd, RenderGra
 }
 
 static void bloom_upsample_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph &graph,
-                                         const RenderTextureResource &output_res, const RenderTextureResource &input_res)
+                                         const RenderTextureResource &output_res, const RenderTextureResource &input_res,
+                                         bool packed)
 {
 	auto &output = graph.get_physical_texture_resource(output_res);
 	auto &input = graph.get_physical_texture_resource(input_res);
@@ -191,7 +223,7 @@ static void bloom_upsample_build_compute(Vulkan::CommandBuffer &cmd, RenderGraph
 	cmd.set_storage_texture(0, 1, output);
 
 	auto *program = cmd.get_device().get_shader_manager().register_compute("builtin://shaders/post/bloom_upsample.comp");
-	unsigned variant = program->register_variant({});
+	unsigned variant = program->register_variant({{ "BLOOM_PACKED", packed ? 1 : 0 }});
 	cmd.set_program(program->get_program(variant));
 
 	struct Registers
@@ -308,8 +340,17 @@ void setup_hdr_postprocess_compute(RenderGraph &graph, const std::string &input,
 	buffer_info.persistent = true;
 	buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
 
+	// RGBA16F is the safe choice, but the whole chain is bandwidth bound, so
+	// prefer 32bpp storage for the pyramid when asked for and the device can
+	// write it. Same fallback scheme as TexturePlane.
+	bool packed_bloom = options.packed_bloom &&
+	                    graph.get_device().image_format_is_supported(
+			                    VK_FORMAT_B10G11R11_UFLOAT_PACK32,
+			                    VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+			                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
 	AttachmentInfo downsample_info;
-	downsample_info.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	downsample_info.format = packed_bloom ? VK_FORMAT_B10G11R11_UFLOAT_PACK32 : VK_FORMAT_R16G16B16A16_SFLOAT;
 	downsample_info.size_x = 0.5f;
 	downsample_info.size_y = 0.5f;
 	downsample_info.size_class = SizeClass::InputRelative;
@@ -340,36 +381,52 @@ void setup_hdr_postprocess_compute(RenderGraph &graph, const std::string &input,
 	auto &d3 = bloom_pass.add_storage_texture_output("downsample-3", downsample_info3);
 
 	const RenderBufferResource *lum = nullptr;
+	const RenderBufferResource *histogram = nullptr;
 	if (options.dynamic_exposure)
+	{
 		lum = &bloom_pass.add_storage_output("average-luminance", buffer_info);
 
+		BufferInfo histogram_info;
+		histogram_info.size = 256 * sizeof(uint32_t);
+		histogram_info.persistent = false;
+		histogram_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		histogram = &bloom_pass.add_storage_output("luminance-histogram", histogram_info);
+	}
+
 	auto &hdr = bloom_pass.add_texture_input(input);
 	bloom_pass.add_history_input("downsample-3");
-	bloom_pass.set_build_render_pass([&, ubo = lum](Vulkan::CommandBuffer &cmd) {
-		bloom_threshold_build_compute(cmd, graph, t, hdr, ubo);
+	bloom_pass.set_build_render_pass([&, ubo = lum, histogram = histogram, packed_bloom](Vulkan::CommandBuffer &cmd) {
+		bloom_threshold_build_compute(cmd, graph, t, hdr, ubo, packed_bloom);
 		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
 		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
-		bloom_downsample_build_compute(cmd, graph, d0, t, nullptr);
+		bloom_downsample_build_compute(cmd, graph, d0, t, nullptr, packed_bloom);
 		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
 		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
-		bloom_downsample_build_compute(cmd, graph, d1, d0, nullptr);
+		bloom_downsample_build_compute(cmd, graph, d1, d0, nullptr, packed_bloom);
 		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
 		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
-		bloom_downsample_build_compute(cmd, graph, d2, d1, nullptr);
+		bloom_downsample_build_compute(cmd, graph, d2, d1, nullptr, packed_bloom);
 		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
 		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
-		bloom_downsample_build_compute(cmd, graph, d3, d2, &d3);
+		bloom_downsample_build_compute(cmd, graph, d3, d2, &d3, packed_bloom);
 		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
 		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
 		if (ubo)
-			luminance_build_compute(cmd, graph, *ubo, d3);
-		bloom_upsample_build_compute(cmd, graph, u2, d3);
+		{
+			// Histogram-based exposure. Samples the HDR input directly
+			// rather than reducing the bloom downsample chain.
+			luminance_histogram_build_compute(cmd, graph, *histogram, hdr);
+			cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			luminance_histogram_resolve_build_compute(cmd, graph, *ubo, *histogram);
+		}
+		bloom_upsample_build_compute(cmd, graph, u2, d3, packed_bloom);
 		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
 		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT);
-		bloom_upsample_build_compute(cmd, graph, u1, u2);
+		bloom_upsample_build_compute(cmd, graph, u1, u2, packed_bloom);
 		cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
 		            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
-		bloom_upsample_build_compute(cmd, graph, u0, u1);
+		bloom_upsample_build_compute(cmd, graph, u0, u1, packed_bloom);
 	});
 
 	{
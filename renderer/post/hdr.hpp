@@ -35,6 +35,10 @@ struct HDRDynamicExposureInterface
 struct HDROptions
 {
 	bool dynamic_exposure = true;
+	// Use B10G11R11 instead of RGBA16F for the bloom pyramid when the device
+	// supports storage writes to it. Halves the bandwidth of the bloom chain
+	// and bloom never needs alpha. Only affects the compute path.
+	bool packed_bloom = false;
 };
 
 void setup_hdr_postprocess(RenderGraph &graph, const std::string &input, const std::string &output,
@@ -33,9 +33,11 @@ namespace Granite
 {
 void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
                             const string &input, const string &input_depth,
-                            const string &output, SMAAPreset preset)
+                            const string &output, SMAAPreset preset,
+                            const string &input_velocity)
 {
 	bool t2x_enable = preset == SMAAPreset::Ultra_T2X;
+	bool use_compute = false;
 	unsigned smaa_quality = 0;
 
 	switch (preset)
@@ -56,6 +58,26 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 	case SMAAPreset::Ultra_T2X:
 		smaa_quality = 3;
 		break;
+
+	case SMAAPreset::Low_Compute:
+		smaa_quality = 0;
+		use_compute = true;
+		break;
+
+	case SMAAPreset::Medium_Compute:
+		smaa_quality = 1;
+		use_compute = true;
+		break;
+
+	case SMAAPreset::High_Compute:
+		smaa_quality = 2;
+		use_compute = true;
+		break;
+
+	case SMAAPreset::Ultra_Compute:
+		smaa_quality = 3;
+		use_compute = true;
+		break;
 	}
 
 	if (t2x_enable)
@@ -66,7 +88,9 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 	else
 		jitter.init(TemporalJitter::Type::None, vec2(1.0f));
 
-	const bool masked_edge = true;
+	// The compute path culls non-edge pixels on the edge texel itself, so the
+	// stencil masking scheme (and its depth attachment) does not apply.
+	const bool masked_edge = !use_compute;
 	graph.get_texture_resource(input).get_attachment_info().unorm_srgb_alias = true;
 
 	AttachmentInfo smaa_edge_output;
@@ -88,11 +112,15 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 	smaa_depth.size_relative_name = input;
 	smaa_depth.format = VK_FORMAT_D16_UNORM;
 
-	auto &smaa_edge = graph.add_pass("smaa-edge", RenderGraph::get_default_post_graphics_queue());
-	auto &smaa_weight = graph.add_pass("smaa-weights", RenderGraph::get_default_post_graphics_queue());
+	auto edge_weight_queue = use_compute ? RenderGraph::get_default_compute_queue() :
+	                         RenderGraph::get_default_post_graphics_queue();
+	auto &smaa_edge = graph.add_pass("smaa-edge", edge_weight_queue);
+	auto &smaa_weight = graph.add_pass("smaa-weights", edge_weight_queue);
 	auto &smaa_blend = graph.add_pass("smaa-blend", RenderGraph::get_default_post_graphics_queue());
 
-	smaa_edge.add_color_output("smaa-edge", smaa_edge_output);
+	auto &edge_output_res = use_compute ?
+	                        smaa_edge.add_storage_texture_output("smaa-edge", smaa_edge_output) :
+	                        smaa_edge.add_color_output("smaa-edge", smaa_edge_output);
 	auto &edge_input_res = smaa_edge.add_texture_input(input);
 	if (masked_edge)
 	{
@@ -107,7 +135,9 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 		});
 	}
 
-	smaa_weight.add_color_output("smaa-weights", smaa_weight_output);
+	auto &weight_output_res = use_compute ?
+	                          smaa_weight.add_storage_texture_output("smaa-weights", smaa_weight_output) :
+	                          smaa_weight.add_color_output("smaa-weights", smaa_weight_output);
 	auto &weight_input_res = smaa_weight.add_texture_input("smaa-edge");
 
 	if (masked_edge)
@@ -117,63 +147,115 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 	auto &blend_input_res = smaa_blend.add_texture_input(input);
 	auto &blend_weight_res = smaa_blend.add_texture_input("smaa-weights");
 
-	smaa_edge.set_build_render_pass([&, edge = masked_edge, q = smaa_quality](Vulkan::CommandBuffer &cmd) {
-		auto &input_image = graph.get_physical_texture_resource(edge_input_res);
-		cmd.set_unorm_texture(0, 0, input_image);
-		cmd.set_sampler(0, 0, Vulkan::StockSampler::LinearClamp);
-		vec4 rt_metrics(1.0f / input_image.get_image().get_create_info().width,
-		                1.0f / input_image.get_image().get_create_info().height,
-		                float(input_image.get_image().get_create_info().width),
-		                float(input_image.get_image().get_create_info().height));
-		cmd.push_constants(&rt_metrics, 0, sizeof(rt_metrics));
-
-		Vulkan::CommandBufferUtil::draw_fullscreen_quad_depth(cmd,
-		                                                      "builtin://shaders/post/smaa_edge_detection.vert",
-		                                                      "builtin://shaders/post/smaa_edge_detection.frag",
-		                                                      edge, edge, VK_COMPARE_OP_ALWAYS,
-		                                                      {{"SMAA_QUALITY", q}});
-	});
+	if (use_compute)
+	{
+		smaa_edge.set_build_render_pass([&, q = smaa_quality](Vulkan::CommandBuffer &cmd) {
+			auto &input_image = graph.get_physical_texture_resource(edge_input_res);
+			auto &output_image = graph.get_physical_texture_resource(edge_output_res);
+			cmd.set_unorm_texture(0, 0, input_image);
+			cmd.set_sampler(0, 0, Vulkan::StockSampler::NearestClamp);
+			cmd.set_storage_texture(0, 1, output_image);
+			vec4 rt_metrics(1.0f / input_image.get_image().get_create_info().width,
+			                1.0f / input_image.get_image().get_create_info().height,
+			                float(input_image.get_image().get_create_info().width),
+			                float(input_image.get_image().get_create_info().height));
+			cmd.push_constants(&rt_metrics, 0, sizeof(rt_metrics));
+
+			cmd.set_program("builtin://shaders/post/smaa_edge_detection.comp", {{"SMAA_QUALITY", q}});
+			cmd.dispatch((input_image.get_image().get_create_info().width + 7) / 8,
+			             (input_image.get_image().get_create_info().height + 7) / 8, 1);
+		});
 
-	smaa_edge.set_get_clear_color([](unsigned, VkClearColorValue *value) {
-		if (value)
-			memset(value, 0, sizeof(*value));
-		return true;
-	});
+		smaa_weight.set_build_render_pass([&, q = smaa_quality](Vulkan::CommandBuffer &cmd) {
+			auto &input_image = graph.get_physical_texture_resource(weight_input_res);
+			auto &output_image = graph.get_physical_texture_resource(weight_output_res);
+			cmd.set_texture(0, 0, input_image, Vulkan::StockSampler::LinearClamp);
+			cmd.set_texture(0, 1,
+			                cmd.get_device().get_texture_manager().request_texture("builtin://textures/smaa/area.gtx")->get_image()->get_view(),
+			                Vulkan::StockSampler::LinearClamp);
+			cmd.set_texture(0, 2,
+			                cmd.get_device().get_texture_manager().request_texture("builtin://textures/smaa/search.gtx")->get_image()->get_view(),
+			                Vulkan::StockSampler::LinearClamp);
+			cmd.set_storage_texture(0, 3, output_image);
+			vec4 rt_metrics(1.0f / input_image.get_image().get_create_info().width,
+			                1.0f / input_image.get_image().get_create_info().height,
+			                float(input_image.get_image().get_create_info().width),
+			                float(input_image.get_image().get_create_info().height));
+			cmd.push_constants(&rt_metrics, 0, sizeof(rt_metrics));
+
+			int subpixel_mode = 0;
+			if (jitter.get_jitter_type() == TemporalJitter::Type::SMAA_T2X)
+				subpixel_mode = 1 + jitter.get_jitter_phase();
+
+			cmd.set_program("builtin://shaders/post/smaa_blend_weight.comp",
+			                {
+					                {"SMAA_SUBPIXEL_MODE", subpixel_mode},
+					                {"SMAA_QUALITY",       q}
+			                });
+			cmd.dispatch((input_image.get_image().get_create_info().width + 7) / 8,
+			             (input_image.get_image().get_create_info().height + 7) / 8, 1);
+		});
+	}
+	else
+	{
+		smaa_edge.set_build_render_pass([&, edge = masked_edge, q = smaa_quality](Vulkan::CommandBuffer &cmd) {
+			auto &input_image = graph.get_physical_texture_resource(edge_input_res);
+			cmd.set_unorm_texture(0, 0, input_image);
+			cmd.set_sampler(0, 0, Vulkan::StockSampler::LinearClamp);
+			vec4 rt_metrics(1.0f / input_image.get_image().get_create_info().width,
+			                1.0f / input_image.get_image().get_create_info().height,
+			                float(input_image.get_image().get_create_info().width),
+			                float(input_image.get_image().get_create_info().height));
+			cmd.push_constants(&rt_metrics, 0, sizeof(rt_metrics));
+
+			Vulkan::CommandBufferUtil::draw_fullscreen_quad_depth(cmd,
+			                                                      "builtin://shaders/post/smaa_edge_detection.vert",
+			                                                      "builtin://shaders/post/smaa_edge_detection.frag",
+			                                                      edge, edge, VK_COMPARE_OP_ALWAYS,
+			                                                      {{"SMAA_QUALITY", q}});
+		});
 
-	smaa_weight.set_build_render_pass([&, edge = masked_edge, q = smaa_quality](Vulkan::CommandBuffer &cmd) {
-		auto &input_image = graph.get_physical_texture_resource(weight_input_res);
-		cmd.set_texture(0, 0, input_image, Vulkan::StockSampler::LinearClamp);
-		cmd.set_texture(0, 1,
-		                cmd.get_device().get_texture_manager().request_texture("builtin://textures/smaa/area.gtx")->get_image()->get_view(),
-		                Vulkan::StockSampler::LinearClamp);
-		cmd.set_texture(0, 2,
-		                cmd.get_device().get_texture_manager().request_texture("builtin://textures/smaa/search.gtx")->get_image()->get_view(),
-		                Vulkan::StockSampler::LinearClamp);
-		vec4 rt_metrics(1.0f / input_image.get_image().get_create_info().width,
-		                1.0f / input_image.get_image().get_create_info().height,
-		                float(input_image.get_image().get_create_info().width),
-		                float(input_image.get_image().get_create_info().height));
-		cmd.push_constants(&rt_metrics, 0, sizeof(rt_metrics));
+		smaa_edge.set_get_clear_color([](unsigned, VkClearColorValue *value) {
+			if (value)
+				memset(value, 0, sizeof(*value));
+			return true;
+		});
 
-		int subpixel_mode = 0;
-		if (jitter.get_jitter_type() == TemporalJitter::Type::SMAA_T2X)
-			subpixel_mode = 1 + jitter.get_jitter_phase();
-
-		Vulkan::CommandBufferUtil::draw_fullscreen_quad_depth(cmd,
-		                                                      "builtin://shaders/post/smaa_blend_weight.vert",
-		                                                      "builtin://shaders/post/smaa_blend_weight.frag",
-		                                                      edge, false, VK_COMPARE_OP_EQUAL,
-		                                                      {
-				                                                      {"SMAA_SUBPIXEL_MODE", subpixel_mode},
-				                                                      {"SMAA_QUALITY",       q}
-		                                                      });
-	});
+		smaa_weight.set_build_render_pass([&, edge = masked_edge, q = smaa_quality](Vulkan::CommandBuffer &cmd) {
+			auto &input_image = graph.get_physical_texture_resource(weight_input_res);
+			cmd.set_texture(0, 0, input_image, Vulkan::StockSampler::LinearClamp);
+			cmd.set_texture(0, 1,
+			                cmd.get_device().get_texture_manager().request_texture("builtin://textures/smaa/area.gtx")->get_image()->get_view(),
+			                Vulkan::StockSampler::LinearClamp);
+			cmd.set_texture(0, 2,
+			                cmd.get_device().get_texture_manager().request_texture("builtin://textures/smaa/search.gtx")->get_image()->get_view(),
+			                Vulkan::StockSampler::LinearClamp);
+			vec4 rt_metrics(1.0f / input_image.get_image().get_create_info().width,
+			                1.0f / input_image.get_image().get_create_info().height,
+			                float(input_image.get_image().get_create_info().width),
+			                float(input_image.get_image().get_create_info().height));
+			cmd.push_constants(&rt_metrics, 0, sizeof(rt_metrics));
+
+			int subpixel_mode = 0;
+			if (jitter.get_jitter_type() == TemporalJitter::Type::SMAA_T2X)
+				subpixel_mode = 1 + jitter.get_jitter_phase();
+
+			Vulkan::CommandBufferUtil::draw_fullscreen_quad_depth(cmd,
+			                                                      "builtin://shaders/post/smaa_blend_weight.vert",
+			                                                      "builtin://shaders/post/smaa_blend_weight.frag",
+			                                                      edge, false, VK_COMPARE_OP_EQUAL,
+			                                                      {
+					                                                      {"SMAA_SUBPIXEL_MODE", subpixel_mode},
+					                                                      {"SMAA_QUALITY",       q}
+			                                                      });
+		});
 
-	smaa_weight.set_get_clear_color([](unsigned, VkClearColorValue *value) {
-		if (value)
-			memset(value, 0, sizeof(*value));
-		return true;
-	});
+		smaa_weight.set_get_clear_color([](unsigned, VkClearColorValue *value) {
+			if (value)
+				memset(value, 0, sizeof(*value));
+			return true;
+		});
+	}
 
 	smaa_blend.set_build_render_pass([&, q = smaa_quality](Vulkan::CommandBuffer &cmd) {
 		auto &input_image = graph.get_physical_texture_resource(blend_input_res);
@@ -199,6 +281,9 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 		smaa_resolve.add_color_output(output, smaa_output);
 		auto &input_res = smaa_resolve.add_texture_input("smaa-sample");
 		auto &depth_res = smaa_resolve.add_texture_input(input_depth);
+		RenderTextureResource *velocity_res = nullptr;
+		if (!input_velocity.empty())
+			velocity_res = &smaa_resolve.add_texture_input(input_velocity);
 		auto &history_res = smaa_resolve.add_history_input("smaa-sample");
 
 		AttachmentInfo variance;
@@ -208,7 +293,7 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 		smaa_resolve.add_color_output("smaa-variance", variance);
 		smaa_resolve.add_history_input("smaa-variance");
 
-		smaa_resolve.set_build_render_pass([&](Vulkan::CommandBuffer &cmd) {
+		smaa_resolve.set_build_render_pass([&, velocity_res](Vulkan::CommandBuffer &cmd) {
 			auto &current = graph.get_physical_texture_resource(input_res);
 			auto *prev = graph.get_physical_history_texture_resource(history_res);
 			auto &depth = graph.get_physical_texture_resource(depth_res);
@@ -218,6 +303,8 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 			{
 				cmd.set_texture(0, 1, depth, Vulkan::StockSampler::NearestClamp);
 				cmd.set_texture(0, 2, *prev, Vulkan::StockSampler::LinearClamp);
+				if (velocity_res)
+					cmd.set_texture(0, 3, graph.get_physical_texture_resource(*velocity_res), Vulkan::StockSampler::NearestClamp);
 				cmd.set_texture(0, 4,
 				                *graph.get_physical_history_texture_resource(smaa_resolve.get_history_inputs()[1]->get_physical_index()),
 				                Vulkan::StockSampler::NearestClamp);
@@ -230,11 +317,7 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 			};
 			Push push;
 
-			push.reproj =
-				translate(vec3(0.5f, 0.5f, 0.0f)) *
-				scale(vec3(0.5f, 0.5f, 1.0f)) *
-				jitter.get_history_view_proj(1) *
-				jitter.get_history_inv_view_proj(0);
+			push.reproj = build_reprojection_matrix(jitter);
 
 			push.inv_resolution_seed = vec2(1.0f / current.get_image().get_create_info().width,
 			                                1.0f / current.get_image().get_create_info().height);
@@ -243,7 +326,8 @@ void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
 			Vulkan::CommandBufferUtil::draw_fullscreen_quad(cmd,
 			                                                "builtin://shaders/quad.vert",
 			                                                "builtin://shaders/post/smaa_t2x_resolve.frag",
-			                                                {{"REPROJECTION_HISTORY", prev ? 1 : 0}});
+			                                                {{"REPROJECTION_HISTORY", prev ? 1 : 0},
+			                                                 {"REPROJECTION_MOTION_VECTORS", velocity_res ? 1 : 0}});
 		});
 	}
 }
@@ -32,10 +32,22 @@ enum class SMAAPreset
 	Medium,
 	High,
 	Ultra,
-	Ultra_T2X
+	Ultra_T2X,
+	// Same quality tiers, but edge detection and blend weights run as compute
+	// with a workgroup-local luma tile instead of redundant per-fragment
+	// neighborhood fetches. Cheaper on bandwidth-limited GPUs; the stencil
+	// mask optimization of the fragment path does not apply.
+	Low_Compute,
+	Medium_Compute,
+	High_Compute,
+	Ultra_Compute
 };
 
+// input_velocity optionally names a velocity buffer from setup_velocity_pass;
+// T2X resolve then reprojects through the same buffer TAA uses instead of
+// re-deriving motion from depth.
 void setup_smaa_postprocess(RenderGraph &graph, TemporalJitter &jitter,
                             const std::string &input, const std::string &input_depth,
-                            const std::string &output, SMAAPreset preset);
+                            const std::string &output, SMAAPreset preset,
+                            const std::string &input_velocity = "");
 }
\ No newline at end of file
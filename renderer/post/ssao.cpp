@@ -140,6 +140,54 @@ void setup_ssao_interleaved(RenderGraph &graph, const RenderContext &context,
 	});
 }
 
+void setup_ssao_upsampled(RenderGraph &graph, const RenderContext &context,
+                          const string &output, const string &input_depth, const string &input_normal)
+{
+	setup_ssao_interleaved(graph, context, output + "-low", input_depth, input_normal);
+
+	AttachmentInfo info;
+	info.format = VK_FORMAT_R8_UNORM;
+	info.size_class = SizeClass::InputRelative;
+	info.size_relative_name = input_depth;
+	info.aux_usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	auto &upsample_pass = graph.add_pass(output + "-upsample", RENDER_GRAPH_QUEUE_ASYNC_COMPUTE_BIT);
+	auto &low_res = upsample_pass.add_texture_input(output + "-low");
+	auto &depth = upsample_pass.add_texture_input(input_depth);
+	auto &upsampled = upsample_pass.add_storage_texture_output(output, info);
+
+	upsample_pass.set_build_render_pass([&](Vulkan::CommandBuffer &cmd) {
+		auto &d = graph.get_physical_texture_resource(depth);
+		auto &low = graph.get_physical_texture_resource(low_res);
+		auto &out = graph.get_physical_texture_resource(upsampled);
+		cmd.set_texture(0, 0, d, Vulkan::StockSampler::NearestClamp);
+		cmd.set_texture(0, 1, low, Vulkan::StockSampler::NearestClamp);
+		cmd.set_storage_texture(0, 2, out);
+
+		struct Push
+		{
+			vec4 inv_z_transform;
+			vec2 inv_resolution;
+			vec2 inv_low_resolution;
+			uvec2 num_threads;
+		} push = {};
+
+		unsigned width = out.get_image().get_width();
+		unsigned height = out.get_image().get_height();
+		push.inv_z_transform = vec4(
+				context.get_render_parameters().inv_projection[2].zw(),
+				context.get_render_parameters().inv_projection[3].zw());
+		push.inv_resolution = vec2(1.0f / width, 1.0f / height);
+		push.inv_low_resolution = vec2(1.0f / low.get_image().get_width(),
+		                               1.0f / low.get_image().get_height());
+		push.num_threads = uvec2(width, height);
+		cmd.push_constants(&push, 0, sizeof(push));
+
+		cmd.set_program("builtin://shaders/post/ssao_upsample.comp");
+		cmd.dispatch((width + 7) / 8, (height + 7) / 8, 1);
+	});
+}
+
 void setup_ssao_naive(RenderGraph &graph, const RenderContext &context,
                       const string &output, const string &input_depth, const string &input_normal)
 {
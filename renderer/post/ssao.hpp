@@ -30,4 +30,8 @@ void setup_ssao_interleaved(RenderGraph &graph, const RenderContext &context,
                             const std::string &output, const std::string &input_depth, const std::string &input_normal);
 void setup_ssao_naive(RenderGraph &graph, const RenderContext &context,
                       const std::string &output, const std::string &input_depth, const std::string &input_normal);
+// Computes AO at quarter resolution with the interleaved path, then performs a
+// depth-aware bilateral upsample back to full resolution.
+void setup_ssao_upsampled(RenderGraph &graph, const RenderContext &context,
+                          const std::string &output, const std::string &input_depth, const std::string &input_normal);
 }
\ No newline at end of file
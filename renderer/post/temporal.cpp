@@ -144,28 +144,24 @@ unsigned TemporalJitter::get_unmasked_phase() const
 	return phase;
 }
 
-void setup_taa_resolve(RenderGraph &graph, TemporalJitter &jitter, const std::string &input,
-                       const std::string &input_depth, const std::string &output, TAAQuality quality)
+mat4 build_reprojection_matrix(const TemporalJitter &jitter)
 {
-	jitter.init(TemporalJitter::Type::TAA_16Phase,
-	            vec2(graph.get_backbuffer_dimensions().width,
-	                 graph.get_backbuffer_dimensions().height));
-
-	AttachmentInfo taa_output;
-	taa_output.size_class = SizeClass::InputRelative;
-	taa_output.size_relative_name = input;
-	taa_output.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-
-#define TAA_MOTION_VECTORS 0
+	return translate(vec3(0.5f, 0.5f, 0.0f)) *
+	       scale(vec3(0.5f, 0.5f, 1.0f)) *
+	       jitter.get_history_view_proj(1) *
+	       jitter.get_history_inv_view_proj(0);
+}
 
-#if TAA_MOTION_VECTORS
+void setup_velocity_pass(RenderGraph &graph, TemporalJitter &jitter,
+                         const std::string &input_depth, const std::string &output)
+{
 	AttachmentInfo mv_output;
 	mv_output.size_class = SizeClass::InputRelative;
-	mv_output.size_relative_name = input;
+	mv_output.size_relative_name = input_depth;
 	mv_output.format = VK_FORMAT_R16G16_SFLOAT;
 
-	auto &mvs = graph.add_pass("taa-motion-vectors", VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
-	mvs.add_color_output("taa-mvs", mv_output);
+	auto &mvs = graph.add_pass(output, RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+	mvs.add_color_output(output, mv_output);
 	mvs.set_depth_stencil_input(input_depth);
 	mvs.add_attachment_input(input_depth);
 
@@ -177,12 +173,7 @@ void setup_taa_resolve(RenderGraph &graph, TemporalJitter &jitter, const std::st
 			mat4 reproj;
 		};
 		Push push;
-
-		push.reproj =
-				translate(vec3(0.5f, 0.5f, 0.0f)) *
-				scale(vec3(0.5f, 0.5f, 1.0f)) *
-				jitter.get_history_view_proj(1) *
-				jitter.get_history_inv_view_proj(0);
+		push.reproj = build_reprojection_matrix(jitter);
 
 		cmd.push_constants(&push, 0, sizeof(push));
 		Vulkan::CommandBufferUtil::draw_fullscreen_quad(cmd,
@@ -191,23 +182,33 @@ void setup_taa_resolve(RenderGraph &graph, TemporalJitter &jitter, const std::st
 
 		// Technically, we should also render dynamic objects where appropriate, some day, some day ...
 	});
-#endif
+}
+
+void setup_taa_resolve(RenderGraph &graph, TemporalJitter &jitter, const std::string &input,
+                       const std::string &input_depth, const std::string &output, TAAQuality quality,
+                       const std::string &input_velocity)
+{
+	jitter.init(TemporalJitter::Type::TAA_16Phase,
+	            vec2(graph.get_backbuffer_dimensions().width,
+	                 graph.get_backbuffer_dimensions().height));
+
+	AttachmentInfo taa_output;
+	taa_output.size_class = SizeClass::InputRelative;
+	taa_output.size_relative_name = input;
+	taa_output.format = VK_FORMAT_R16G16B16A16_SFLOAT;
 
 	auto &resolve = graph.add_pass("taa-resolve", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
 	resolve.add_color_output(output, taa_output);
 	auto &input_res = resolve.add_texture_input(input);
 	auto &input_depth_res = resolve.add_texture_input(input_depth);
-#if TAA_MOTION_VECTORS
-	resolve.add_texture_input("taa-mvs");
-#endif
+	RenderTextureResource *velocity_res = nullptr;
+	if (!input_velocity.empty())
+		velocity_res = &resolve.add_texture_input(input_velocity);
 	auto &history = resolve.add_history_input(output);
 
-	resolve.set_build_render_pass([&, q = Util::ecast(quality)](Vulkan::CommandBuffer &cmd) {
+	resolve.set_build_render_pass([&, velocity_res, q = Util::ecast(quality)](Vulkan::CommandBuffer &cmd) {
 		auto &image = graph.get_physical_texture_resource(input_res);
 		auto &depth = graph.get_physical_texture_resource(input_depth_res);
-#if TAA_MOTION_VECTORS
-		auto &mvs = graph.get_physical_texture_resource(resolve.get_texture_inputs()[2]->get_physical_index());
-#endif
 		auto *prev = graph.get_physical_history_texture_resource(history);
 
 		struct Push
@@ -217,11 +218,7 @@ void setup_taa_resolve(RenderGraph &graph, TemporalJitter &jitter, const std::st
 		};
 		Push push;
 
-		push.reproj =
-				translate(vec3(0.5f, 0.5f, 0.0f)) *
-				scale(vec3(0.5f, 0.5f, 1.0f)) *
-				jitter.get_history_view_proj(1) *
-				jitter.get_history_inv_view_proj(0);
+		push.reproj = build_reprojection_matrix(jitter);
 
 		push.inv_resolution = vec4(1.0f / image.get_image().get_create_info().width,
 		                           1.0f / image.get_image().get_create_info().height,
@@ -234,15 +231,15 @@ void setup_taa_resolve(RenderGraph &graph, TemporalJitter &jitter, const std::st
 		cmd.set_texture(0, 1, depth, Vulkan::StockSampler::NearestClamp);
 		if (prev)
 			cmd.set_texture(0, 2, *prev, Vulkan::StockSampler::LinearClamp);
-#if TAA_MOTION_VECTORS
-		cmd.set_texture(0, 3, mvs, Vulkan::StockSampler::NearestClamp);
-#endif
+		if (velocity_res)
+			cmd.set_texture(0, 3, graph.get_physical_texture_resource(*velocity_res), Vulkan::StockSampler::NearestClamp);
 
 		Vulkan::CommandBufferUtil::draw_fullscreen_quad(cmd,
 		                                                "builtin://shaders/quad.vert",
 		                                                "builtin://shaders/post/taa_resolve.frag",
 		                                                {
 				                                                {"REPROJECTION_HISTORY", prev ? 1 : 0},
+				                                                {"REPROJECTION_MOTION_VECTORS", velocity_res ? 1 : 0},
 				                                                {"TAA_QUALITY",          q}
 		                                                });
 	});
@@ -283,11 +280,7 @@ void setup_fxaa_2phase_postprocess(RenderGraph &graph, TemporalJitter &jitter, c
 		};
 		Push push;
 
-		push.reproj =
-				translate(vec3(0.5f, 0.5f, 0.0f)) *
-				scale(vec3(0.5f, 0.5f, 1.0f)) *
-				jitter.get_history_view_proj(1) *
-				jitter.get_history_inv_view_proj(0);
+		push.reproj = build_reprojection_matrix(jitter);
 
 		push.inv_resolution = vec2(1.0f / fxaa.get_image().get_create_info().width,
 		                           1.0f / fxaa.get_image().get_create_info().height);
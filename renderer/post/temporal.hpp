@@ -67,6 +67,18 @@ private:
 	Type type = Type::None;
 };
 
+// Maps current-frame clip space into previous-frame UV space.
+// Every temporal consumer (TAA, SMAA T2X, FXAA 2-phase, motion vectors)
+// reprojects with this exact matrix, so it is derived in one place.
+mat4 build_reprojection_matrix(const TemporalJitter &jitter);
+
+// Registers the shared screen-space velocity pass. The buffer is derived from
+// camera reprojection of depth and registered once per graph; hand the same
+// resource name to every temporal consumer (TAA, SMAA T2X) instead of letting
+// each resolve pass re-derive motion from depth on its own.
+void setup_velocity_pass(RenderGraph &graph, TemporalJitter &jitter,
+                         const std::string &input_depth, const std::string &output);
+
 void setup_fxaa_2phase_postprocess(RenderGraph &graph, TemporalJitter &jitter, const std::string &input,
                                    const std::string &input_depth, const std::string &output);
 
@@ -79,6 +91,9 @@ enum class TAAQuality
 	Extreme,
 	Nightmare
 };
+// input_velocity optionally names a velocity buffer from setup_velocity_pass;
+// when set, the resolve reprojects through it rather than raw depth.
 void setup_taa_resolve(RenderGraph &graph, TemporalJitter &jitter, const std::string &input,
-                       const std::string &input_depth, const std::string &output, TAAQuality quality);
+                       const std::string &input_depth, const std::string &output, TAAQuality quality,
+                       const std::string &input_velocity = "");
 }
@@ -0,0 +1,186 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "probe_baker.hpp"
+#include "utils/image_utils.hpp"
+#include "transforms.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <algorithm>
+
+using namespace std;
+using namespace Vulkan;
+
+namespace Granite
+{
+ProbeBaker::ProbeBaker(Vulkan::Device &device_, Scene &scene_, Renderer &renderer_, RenderContext &context_)
+	: device(device_), scene(scene_), renderer(renderer_), context(context_), ring(&device_)
+{
+}
+
+void ProbeBaker::enqueue_probe(const Probe &probe)
+{
+	queue.push(probe);
+}
+
+void ProbeBaker::set_faces_per_iteration(unsigned count)
+{
+	faces_per_iteration = max(count, 1u);
+}
+
+void ProbeBaker::set_probe_ready_callback(function<void (const BakedProbe &)> callback)
+{
+	probe_ready_callback = move(callback);
+}
+
+void ProbeBaker::begin_probe(const Probe &probe)
+{
+	ImageCreateInfo info = ImageCreateInfo::render_target(probe.resolution, probe.resolution,
+	                                                      VK_FORMAT_R16G16B16A16_SFLOAT);
+	info.levels = 1;
+	info.layers = 6;
+	info.usage |= VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	info.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+	info.initial_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	cube = device.create_image(info, nullptr);
+	next_face = 0;
+}
+
+void ProbeBaker::render_face(Vulkan::CommandBuffer &cmd, const Probe &probe, unsigned face)
+{
+	auto &info = cube->get_create_info();
+
+	ImageViewCreateInfo view_info = {};
+	view_info.layers = 1;
+	view_info.base_layer = face;
+	view_info.format = info.format;
+	view_info.levels = 1;
+	view_info.image = cube.get();
+	auto rt_view = device.create_image_view(view_info);
+
+	mat4 proj, look;
+	compute_cube_render_transform(probe.position, face, proj, look, probe.znear, probe.zfar);
+	context.set_camera(proj, look);
+
+	RenderPassInfo rp = {};
+	rp.num_color_attachments = 1;
+	rp.color_attachments[0] = rt_view.get();
+	rp.store_attachments = 1;
+	rp.clear_attachments = 1;
+	rp.depth_stencil = &device.get_transient_attachment(info.width, info.height,
+	                                                    device.get_default_depth_format(), 0);
+	rp.op_flags = RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT;
+	rp.clear_depth_stencil.depth = 1.0f;
+	rp.clear_depth_stencil.stencil = 0;
+	rp.clear_color[0].float32[3] = 1.0f;
+	cmd.begin_render_pass(rp);
+
+	visible.clear();
+	scene.gather_visible_opaque_renderables(context.get_visibility_frustum(), visible);
+	scene.gather_unbounded_renderables(visible);
+	renderer.begin();
+	renderer.push_renderables(context, visible);
+	renderer.flush(cmd, context, Renderer::FRONT_FACE_CLOCKWISE_BIT);
+
+	cmd.end_render_pass();
+}
+
+void ProbeBaker::save_cube_async(const Vulkan::Image &image, const std::string &path)
+{
+	auto cmd = device.request_command_buffer();
+	cmd->image_barrier(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+	                   VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	device.submit(cmd);
+
+	save_image_async(ring, image, CommandBuffer::Type::Generic, path);
+
+	// The copy rides the queue in order, so the image can go straight back to
+	// being sampled by whatever consumes the BakedProbe handles.
+	cmd = device.request_command_buffer();
+	cmd->image_barrier(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                   VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+	                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	device.submit(cmd);
+}
+
+void ProbeBaker::finish_probe(const Probe &probe)
+{
+	BakedProbe baked;
+	baked.probe = probe;
+	baked.reflection = convert_cube_to_ibl_specular(device, cube->get_view());
+	baked.irradiance = convert_cube_to_ibl_diffuse(device, cube->get_view());
+
+	if (!probe.reflection_path.empty())
+		save_cube_async(*baked.reflection, probe.reflection_path);
+	if (!probe.irradiance_path.empty())
+		save_cube_async(*baked.irradiance, probe.irradiance_path);
+
+	if (probe_ready_callback)
+		probe_ready_callback(baked);
+}
+
+bool ProbeBaker::iterate()
+{
+	// Ages out readbacks from earlier iterations; the .gtx writes then run on
+	// the ThreadGroup workers.
+	ring.begin_frame();
+
+	if (queue.empty() && !cube)
+		return false;
+
+	unsigned budget = faces_per_iteration;
+	while (budget != 0 && (cube || !queue.empty()))
+	{
+		if (!cube)
+			begin_probe(queue.front());
+
+		auto &probe = queue.front();
+		auto cmd = device.request_command_buffer();
+
+		unsigned faces = min(budget, 6 - next_face);
+		for (unsigned i = 0; i < faces; i++)
+			render_face(*cmd, probe, next_face + i);
+		next_face += faces;
+		budget -= faces;
+
+		bool complete = next_face == 6;
+		if (complete)
+		{
+			cmd->image_barrier(*cube, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+		device.submit(cmd);
+
+		if (complete)
+		{
+			finish_probe(probe);
+			queue.pop();
+			cube.reset();
+			next_face = 0;
+		}
+	}
+
+	return cube || !queue.empty();
+}
+}
@@ -0,0 +1,113 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "renderer.hpp"
+#include "render_context.hpp"
+#include "scene.hpp"
+#include "readback_ring.hpp"
+#include <functional>
+#include <queue>
+#include <string>
+
+namespace Granite
+{
+// In-engine reflection probe baking. Probes are enqueued with a position and
+// target paths, and iterate() renders up to N cube faces per frame, so a
+// batch of probes spreads its GPU cost over as many frames as it needs
+// instead of hitching one. Once a probe's six faces are in, the same
+// iteration runs the specular mip chain and irradiance convolution and hands
+// the results to the readback ring, which writes the .gtx files through the
+// Filesystem off the frame loop. The cached files load through the regular
+// texture paths (e.g. an IBLComponent), so a re-bake is render + convolve +
+// write rather than a trip through the offline tools.
+//
+// The caller owns the Renderer and RenderContext and configures lighting and
+// renderer options on them up front; the baker only drives the camera. Both
+// must not be touched by other passes while a bake is in flight, same
+// contract as ViewBaker views.
+class ProbeBaker
+{
+public:
+	ProbeBaker(Vulkan::Device &device, Scene &scene, Renderer &renderer, RenderContext &context);
+
+	struct Probe
+	{
+		vec3 position = vec3(0.0f);
+		// Destination paths for the convolved cubemaps, e.g. under cache://.
+		// An empty path skips that write.
+		std::string reflection_path;
+		std::string irradiance_path;
+		unsigned resolution = 512;
+		float znear = 0.1f;
+		float zfar = 300.0f;
+	};
+
+	struct BakedProbe
+	{
+		Probe probe;
+		// Live results, usable immediately without waiting for the file
+		// writes (both are in SHADER_READ_ONLY_OPTIMAL).
+		Vulkan::ImageHandle reflection;
+		Vulkan::ImageHandle irradiance;
+	};
+
+	void enqueue_probe(const Probe &probe);
+
+	// Face budget per iterate() call, default 1. Convolution and readback of
+	// a finished probe ride the iteration which renders its last face.
+	void set_faces_per_iteration(unsigned count);
+
+	// Fired from iterate() when a probe's images are convolved, before the
+	// file writes complete.
+	void set_probe_ready_callback(std::function<void (const BakedProbe &)> callback);
+
+	// Call once per frame after the frame context has begun. Returns true
+	// while bake work remains.
+	bool iterate();
+
+	bool is_idle() const
+	{
+		return queue.empty() && !cube;
+	}
+
+private:
+	Vulkan::Device &device;
+	Scene &scene;
+	Renderer &renderer;
+	RenderContext &context;
+	Vulkan::ReadbackRing ring;
+
+	std::queue<Probe> queue;
+	Vulkan::ImageHandle cube;
+	unsigned next_face = 0;
+	unsigned faces_per_iteration = 1;
+	std::function<void (const BakedProbe &)> probe_ready_callback;
+	VisibilityList visible;
+
+	void begin_probe(const Probe &probe);
+	void render_face(Vulkan::CommandBuffer &cmd, const Probe &probe, unsigned face);
+	void finish_probe(const Probe &probe);
+	void save_cube_async(const Vulkan::Image &image, const std::string &path);
+};
+}
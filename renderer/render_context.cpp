@@ -47,7 +47,27 @@ void RenderContext::set_camera(const Camera &camera_)
 	set_camera(camera_.get_projection(), camera_.get_view());
 }
 
+void RenderContext::latch_camera(const Camera &camera_)
+{
+	latch_camera(camera_.get_projection(), camera_.get_view());
+}
+
+void RenderContext::latch_camera(const mat4 &projection, const mat4 &view)
+{
+	// Keep the culling frustum from set_camera(). With a non-zero prediction
+	// radius that frustum is conservative for the latched pose.
+	update_camera_parameters(projection, view);
+}
+
 void RenderContext::set_camera(const mat4 &projection, const mat4 &view)
+{
+	update_camera_parameters(projection, view);
+	frustum.build_planes(camera.inv_view_projection);
+	if (camera_prediction_radius > 0.0f)
+		frustum.expand(camera_prediction_radius);
+}
+
+void RenderContext::update_camera_parameters(const mat4 &projection, const mat4 &view)
 {
 	camera.projection = projection;
 	camera.view = view;
@@ -63,8 +83,6 @@ void RenderContext::set_camera(const mat4 &projection, const mat4 &view)
 	camera.local_view_projection = camera.projection * local_view;
 	camera.inv_local_view_projection = inverse(camera.local_view_projection);
 
-	frustum.build_planes(camera.inv_view_projection);
-
 	camera.camera_position = camera.inv_view[3].xyz();
 	camera.camera_up = camera.inv_view[1].xyz();
 	camera.camera_right = camera.inv_view[0].xyz();
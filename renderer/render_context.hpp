@@ -52,6 +52,21 @@ public:
 	void set_camera(const mat4 &projection, const mat4 &view);
 	void set_camera(const Camera &camera);
 
+	// Deferred-camera mode. When radius is non-zero, set_camera() expands the
+	// visibility frustum by that distance so culling done early in the frame
+	// stays conservative for a camera pose latched up to radius units away.
+	void set_camera_prediction_radius(float radius)
+	{
+		camera_prediction_radius = radius;
+	}
+
+	// Late-latches a fresh camera pose without touching the culling frustum.
+	// Call as the last CPU step before flushing render queues; the global
+	// parameter UBO is allocated at command recording time so the latched
+	// matrices flow straight into submission.
+	void latch_camera(const mat4 &projection, const mat4 &view);
+	void latch_camera(const Camera &camera);
+
 	const RenderParameters &get_render_parameters() const
 	{
 		return camera;
@@ -86,5 +101,8 @@ private:
 	RenderParameters camera;
 	const LightingParameters *lighting;
 	Frustum frustum;
+	float camera_prediction_radius = 0.0f;
+
+	void update_camera_parameters(const mat4 &projection, const mat4 &view);
 };
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include "render_graph.hpp"
 #include "type_to_string.hpp"
 #include "format.hpp"
+#include "global_managers.hpp"
 #include "quirks.hpp"
 #include "muglm/muglm_impl.hpp"
 #include <algorithm>
@@ -95,6 +96,21 @@ RenderBufferResource &RenderPass::add_indirect_buffer_input(const std::string &n
 	                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
 }
 
+RenderBufferResource &RenderPass::add_conditional_input(const std::string &name)
+{
+	// Without the extension the dependency is still declared (as a plain shader
+	// read) so pass ordering holds, but the pass runs unconditionally.
+	if (!graph.get_device().get_device_features().conditional_rendering_features.conditionalRendering)
+		return add_storage_read_only_input(name);
+
+	auto &res = add_generic_buffer_input(name,
+	                                     VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT,
+	                                     VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT,
+	                                     VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT);
+	conditional_buffer = &res;
+	return res;
+}
+
 RenderBufferResource &RenderPass::add_uniform_input(const std::string &name, VkPipelineStageFlags stages)
 {
 	if (stages == 0)
@@ -961,7 +977,7 @@ void RenderGraph::build_render_pass_info()
 						if (pass.get_clear_color(i))
 						{
 							rp.clear_attachments |= 1u << res.first;
-							physical_pass.color_clear_requests.push_back({ &pass, &rp.clear_color[res.first], i });
+							physical_pass.color_clear_requests.push_back({ pass.get_index(), &rp.clear_color[res.first], i });
 						}
 					}
 					else
@@ -1016,7 +1032,7 @@ void RenderGraph::build_render_pass_info()
 				if (res.second && pass.get_clear_depth_stencil())
 				{
 					rp.op_flags |= Vulkan::RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT;
-					physical_pass.depth_clear_request.pass = &pass;
+					physical_pass.depth_clear_request.pass = pass.get_index();
 					physical_pass.depth_clear_request.target = &rp.clear_depth_stencil;
 				}
 
@@ -1111,7 +1127,57 @@ void RenderGraph::build_physical_passes()
 		return itr != end(resource_list);
 	};
 
+	const auto should_fuse_compute = [&](const RenderPass &prev, const RenderPass &next) -> bool {
+		if (next.get_queue() != prev.get_queue())
+			return false;
+		if (!prev.is_fusable() || !next.is_fusable())
+			return false;
+
+		// Sampled inputs need a layout transition away from GENERAL,
+		// which cannot happen inside the pass.
+		for (auto &input : next.get_generic_texture_inputs())
+		{
+			if (find_attachment(prev.get_storage_texture_outputs(), input.texture))
+				return false;
+			if (find_attachment(prev.get_blit_texture_outputs(), input.texture))
+				return false;
+		}
+
+		// Transfer writes happen outside the compute stage,
+		// the in-pass barrier does not cover them.
+		for (auto &input : next.get_generic_buffer_inputs())
+			if (find_buffer(prev.get_transfer_outputs(), input.buffer))
+				return false;
+		for (auto *input : next.get_storage_inputs())
+			if (find_buffer(prev.get_transfer_outputs(), input))
+				return false;
+		// Conditional rendering reads are also not covered by the in-pass barrier.
+		if (find_buffer(prev.get_transfer_outputs(), next.get_conditional_buffer()) ||
+		    find_buffer(prev.get_storage_outputs(), next.get_conditional_buffer()))
+			return false;
+
+		// Now, see if we *should* fuse. Only bother when there is an actual
+		// producer/consumer storage relationship; unrelated passes gain
+		// nothing from fusing and only lose potential overlap.
+		for (auto *input : next.get_storage_inputs())
+			if (find_buffer(prev.get_storage_outputs(), input))
+				return true;
+		for (auto &input : next.get_generic_buffer_inputs())
+			if (find_buffer(prev.get_storage_outputs(), input.buffer))
+				return true;
+		for (auto *input : next.get_storage_texture_inputs())
+			if (find_attachment(prev.get_storage_texture_outputs(), input))
+				return true;
+
+		return false;
+	};
+
 	const auto should_merge = [&](const RenderPass &prev, const RenderPass &next) -> bool {
+		// Back-to-back compute fuses through an explicit in-pass barrier
+		// rather than subpasses.
+		if ((prev.get_queue() & compute_queues) && (next.get_queue() & compute_queues))
+			return should_fuse_compute(prev, next);
+
 		// Can only merge graphics in same queue.
 		if ((prev.get_queue() & compute_queues) || (next.get_queue() != prev.get_queue()))
 			return false;
@@ -1384,6 +1450,120 @@ void RenderGraph::log()
 	}
 }
 
+bool RenderGraph::export_graphviz(const std::string &path)
+{
+	string dot;
+	dot.reserve(16 * 1024);
+	char line[512];
+
+	dot += "digraph render_graph {\n";
+	dot += "\trankdir = LR;\n";
+	dot += "\tnode [fontname = \"monospace\"];\n\n";
+
+	for (auto &resource : physical_dimensions)
+	{
+		unsigned index = unsigned(&resource - physical_dimensions.data());
+		string label = resource.name;
+
+		if (resource.buffer_info.size)
+		{
+			snprintf(line, sizeof(line), "\\n%u bytes", unsigned(resource.buffer_info.size));
+			label += line;
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "\\n%u x %u (fmt: %u)", resource.width, resource.height, unsigned(resource.format));
+			label += line;
+		}
+
+		if (index == swapchain_physical_index)
+			label += "\\n(swapchain)";
+		if (physical_aliases[index] != RenderResource::Unused)
+		{
+			snprintf(line, sizeof(line), "\\n(aliases #%u)", physical_aliases[index]);
+			label += line;
+		}
+		if (physical_memory_alias_primary[index] != RenderResource::Unused &&
+		    physical_memory_alias_primary[index] != index)
+		{
+			snprintf(line, sizeof(line), "\\n(memory of #%u)", physical_memory_alias_primary[index]);
+			label += line;
+		}
+
+		snprintf(line, sizeof(line), "\tres%u [label = \"%s\", shape = ellipse];\n", index, label.c_str());
+		dot += line;
+	}
+	dot += "\n";
+
+	for (auto &physical_pass : physical_passes)
+	{
+		unsigned physical_index = unsigned(&physical_pass - physical_passes.data());
+
+		string pass_label;
+		for (auto &subpass : physical_pass.passes)
+		{
+			pass_label += passes[subpass]->get_name();
+			if (&subpass != &physical_pass.passes.back())
+				pass_label += " + ";
+		}
+
+		snprintf(line, sizeof(line), "\tsubgraph cluster_%u {\n", physical_index);
+		dot += line;
+
+		// The interval manager aggregates under the same tag the recording
+		// path registers, so a baked graph which has rendered some frames
+		// with enable_timestamps() gets cost attribution for free.
+		double gpu_time = 0.0;
+		if (device && enabled_timestamps)
+			gpu_time = device->get_timestamp_interval_manager().get_timestamp_tag(pass_label.c_str())->get_time_per_iteration();
+
+		if (gpu_time > 0.0)
+			snprintf(line, sizeof(line), "\t\tlabel = \"physical #%u (%.3f ms)\";\n", physical_index, gpu_time * 1e3);
+		else
+			snprintf(line, sizeof(line), "\t\tlabel = \"physical #%u\";\n", physical_index);
+		dot += line;
+
+		for (auto &subpass : physical_pass.passes)
+		{
+			snprintf(line, sizeof(line), "\t\tpass%u [label = \"%s\", shape = box];\n",
+			         subpass, passes[subpass]->get_name().c_str());
+			dot += line;
+		}
+		dot += "\t}\n";
+
+		// Invalidates are what the pass waits for, flushes are what it makes
+		// visible. Edge labels carry layout and stages so a barrier which
+		// forces serialization can be spotted directly.
+		for (auto &barrier : physical_pass.invalidate)
+		{
+			snprintf(line, sizeof(line), "\tres%u -> pass%u [label = \"%s\\n%s\"];\n",
+			         barrier.resource_index, physical_pass.passes.front(),
+			         Vulkan::layout_to_string(barrier.layout),
+			         Vulkan::stage_flags_to_string(barrier.stages).c_str());
+			dot += line;
+		}
+
+		for (auto &barrier : physical_pass.flush)
+		{
+			snprintf(line, sizeof(line), "\tpass%u -> res%u [label = \"%s\\n%s\"];\n",
+			         physical_pass.passes.back(), barrier.resource_index,
+			         Vulkan::layout_to_string(barrier.layout),
+			         Vulkan::stage_flags_to_string(barrier.stages).c_str());
+			dot += line;
+		}
+	}
+
+	dot += "}\n";
+
+	if (!Global::filesystem()->write_string_to_file(path, dot))
+	{
+		LOGE("Failed to write render graph dump to %s.\n", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 void RenderGraph::enqueue_mipmap_requests(Vulkan::CommandBuffer &cmd, const std::vector<MipmapRequests> &requests)
 {
 	if (requests.empty())
@@ -1621,6 +1801,92 @@ void RenderGraph::build_aliases()
 				physical_passes[pass_range[chain[i]].last_used_pass()].alias_transfer.push_back(make_pair(chain[i], chain[0]));
 		}
 	}
+
+	// Second pass: attachments with disjoint lifetimes whose dimensions differ
+	// cannot share a VkImage, but they can still be packed into a shared device
+	// memory allocation. This is where half-res targets, bloom chains and
+	// similar one-shot attachments reclaim most of their memory.
+	physical_memory_alias_groups.clear();
+	physical_memory_alias_primary.assign(physical_dimensions.size(), RenderResource::Unused);
+
+	const auto can_memory_alias = [&](unsigned i) -> bool {
+		auto &dim = physical_dimensions[i];
+		if (dim.buffer_info.size)
+			return false;
+		if (physical_image_has_history[i])
+			return false;
+		if (physical_aliases[i] != RenderResource::Unused || !alias_chains[i].empty())
+			return false;
+		if (dim.transient || dim.persistent || dim.is_storage_image())
+			return false;
+		if (i == swapchain_physical_index)
+			return false;
+		// Stick to single-queue resources like the VkImage aliasing path does.
+		if ((dim.queues & (dim.queues - 1)) != 0)
+			return false;
+		return pass_range[i].is_used() && pass_range[i].can_alias();
+	};
+
+	const auto estimated_size = [&](unsigned i) -> VkDeviceSize {
+		auto &dim = physical_dimensions[i];
+		return Vulkan::format_get_layer_size(dim.format, ~0u, dim.width, dim.height, dim.depth) *
+		       dim.layers * dim.samples;
+	};
+
+	for (unsigned i = 0; i < physical_dimensions.size(); i++)
+	{
+		if (!can_memory_alias(i))
+			continue;
+
+		bool placed = false;
+		for (auto &group : physical_memory_alias_groups)
+		{
+			bool disjoint = physical_dimensions[i].queues == physical_dimensions[group.front()].queues;
+			for (auto member : group)
+				if (!pass_range[i].disjoint_lifetime(pass_range[member]))
+					disjoint = false;
+
+			if (disjoint)
+			{
+				group.push_back(i);
+				placed = true;
+				break;
+			}
+		}
+
+		if (!placed)
+			physical_memory_alias_groups.push_back({ i });
+	}
+
+	// Drop singleton groups, they gain nothing.
+	auto itr = remove_if(begin(physical_memory_alias_groups), end(physical_memory_alias_groups),
+	                     [](const std::vector<unsigned> &group) { return group.size() < 2; });
+	physical_memory_alias_groups.erase(itr, end(physical_memory_alias_groups));
+
+	for (auto &group : physical_memory_alias_groups)
+	{
+		// The largest member owns the allocation, the others bind into it.
+		sort(begin(group), end(group), [&](unsigned a, unsigned b) {
+			return estimated_size(a) > estimated_size(b);
+		});
+		for (auto member : group)
+			physical_memory_alias_primary[member] = group.front();
+
+		// Aliased memory must be discarded between uses, reuse the same
+		// ownership transfer mechanism as VkImage aliases.
+		std::vector<unsigned> ordered = group;
+		sort(begin(ordered), end(ordered), [&](unsigned a, unsigned b) {
+			return pass_range[a].last_used_pass() < pass_range[b].first_used_pass();
+		});
+
+		for (unsigned i = 0; i < ordered.size(); i++)
+		{
+			if (i + 1 < ordered.size())
+				physical_passes[pass_range[ordered[i]].last_used_pass()].alias_transfer.push_back(make_pair(ordered[i], ordered[i + 1]));
+			else
+				physical_passes[pass_range[ordered[i]].last_used_pass()].alias_transfer.push_back(make_pair(ordered[i], ordered[0]));
+		}
+	}
 }
 
 bool RenderGraph::need_invalidate(const Barrier &barrier, const PipelineEvent &event)
@@ -1919,11 +2185,11 @@ void RenderGraph::enqueue_render_passes(Vulkan::Device &device_)
 		if (graphics)
 		{
 			for (auto &clear_req : physical_pass.color_clear_requests)
-				clear_req.pass->get_clear_color(clear_req.index, clear_req.target);
+				passes[clear_req.pass]->get_clear_color(clear_req.index, clear_req.target);
 
-			if (physical_pass.depth_clear_request.pass)
+			if (physical_pass.depth_clear_request.pass != RenderPass::Unused)
 			{
-				physical_pass.depth_clear_request.pass->get_clear_depth_stencil(
+				passes[physical_pass.depth_clear_request.pass]->get_clear_depth_stencil(
 					physical_pass.depth_clear_request.target);
 			}
 
@@ -1956,7 +2222,15 @@ void RenderGraph::enqueue_render_passes(Vulkan::Device &device_)
 					// This should be an extremely unlikely scenario.
 					// Either you need all subpasses or none.
 					cmd->begin_region(pass.get_name().c_str());
-					pass.build_render_pass(*cmd, layer);
+					{
+						TIMELINE_TRACE_SCOPE(device_.get_timeline_trace_file(), pass.get_name().c_str());
+						auto *conditional = pass.get_conditional_buffer();
+						if (conditional)
+							cmd->begin_conditional_rendering(get_physical_buffer_resource(*conditional));
+						pass.build_render_pass(*cmd, layer);
+						if (conditional)
+							cmd->end_conditional_rendering();
+					}
 					cmd->end_region();
 
 					if (&subpass != &physical_pass.passes.back())
@@ -1991,18 +2265,53 @@ void RenderGraph::enqueue_render_passes(Vulkan::Device &device_)
 		}
 		else
 		{
-			assert(physical_pass.passes.size() == 1);
-			auto &pass = *passes[physical_pass.passes.front()];
 			Vulkan::QueryPoolHandle start_ts, end_ts;
 			if (enabled_timestamps)
 				start_ts = cmd->write_timestamp(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-			cmd->begin_region(pass.get_name().c_str());
-			pass.build_render_pass(*cmd, 0);
-			cmd->end_region();
+
+			for (auto &subpass : physical_pass.passes)
+			{
+				auto &pass = *passes[subpass];
+				cmd->begin_region(pass.get_name().c_str());
+				{
+					TIMELINE_TRACE_SCOPE(device_.get_timeline_trace_file(), pass.get_name().c_str());
+					auto *conditional = pass.get_conditional_buffer();
+					if (conditional)
+						cmd->begin_conditional_rendering(get_physical_buffer_resource(*conditional));
+					pass.build_render_pass(*cmd, 0);
+					if (conditional)
+						cmd->end_conditional_rendering();
+				}
+				cmd->end_region();
+
+				// Fused passes only depend on each other through storage
+				// resources in GENERAL layout, so a single global barrier
+				// covers the producer/consumer hazard.
+				if (&subpass != &physical_pass.passes.back())
+				{
+					cmd->barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+					             VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+					             VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+				}
+			}
+
 			if (enabled_timestamps)
 			{
 				end_ts = cmd->write_timestamp(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-				device->register_time_interval("compute", std::move(start_ts), std::move(end_ts), pass.get_name().c_str());
+				string name;
+				if (physical_pass.passes.size() == 1)
+					name = passes[physical_pass.passes.front()]->get_name();
+				else
+				{
+					for (auto &pass : physical_pass.passes)
+					{
+						name += passes[pass]->get_name();
+						if (&pass != &physical_pass.passes.back())
+							name += " + ";
+					}
+				}
+				device->register_time_interval("compute", std::move(start_ts), std::move(end_ts), name.c_str());
 			}
 		}
 
@@ -2216,7 +2525,7 @@ void RenderGraph::setup_physical_buffer(Vulkan::Device &device_, unsigned attach
 	}
 }
 
-void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachment)
+bool RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachment, bool force_recreate)
 {
 	auto &att = physical_dimensions[attachment];
 
@@ -2225,9 +2534,12 @@ void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachm
 		physical_image_attachments[attachment] = physical_image_attachments[physical_aliases[attachment]];
 		physical_attachments[attachment] = &physical_image_attachments[attachment]->get_view();
 		physical_events[attachment] = {};
-		return;
+		return false;
 	}
 
+	unsigned memory_primary = physical_memory_alias_primary.empty() ?
+	                          RenderResource::Unused : physical_memory_alias_primary[attachment];
+
 	bool need_image = true;
 	VkImageUsageFlags usage = att.image_usage;
 	Vulkan::ImageMiscFlags misc = 0;
@@ -2238,6 +2550,17 @@ void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachm
 	if (att.is_storage_image())
 		flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
 
+	if (memory_primary == attachment)
+	{
+		// This attachment owns the shared allocation for its alias group.
+		// The ALIAS flag bumps alignment so the other members can bind at offset 0.
+		flags |= VK_IMAGE_CREATE_ALIAS_BIT;
+		misc |= Vulkan::IMAGE_MISC_FORCE_NO_DEDICATED_BIT;
+	}
+
+	if (force_recreate)
+		physical_image_attachments[attachment].reset();
+
 	if (physical_image_attachments[attachment])
 	{
 		if (att.persistent &&
@@ -2280,7 +2603,26 @@ void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachm
 		if (att.queues & RENDER_GRAPH_QUEUE_ASYNC_GRAPHICS_BIT)
 			info.misc |= Vulkan::IMAGE_MISC_CONCURRENT_QUEUE_ASYNC_GRAPHICS_BIT;
 
+		const Vulkan::DeviceAllocation *alias_allocation = nullptr;
+		if (memory_primary != RenderResource::Unused && memory_primary != attachment &&
+		    physical_image_attachments[memory_primary])
+		{
+			alias_allocation = &physical_image_attachments[memory_primary]->get_allocation();
+			info.memory_aliases = &alias_allocation;
+			info.num_memory_aliases = 1;
+		}
+
 		physical_image_attachments[attachment] = device_.create_image(info, nullptr);
+
+		if (!physical_image_attachments[attachment] && info.num_memory_aliases)
+		{
+			// The shared allocation didn't satisfy this image's requirements,
+			// fall back to a dedicated allocation.
+			info.memory_aliases = nullptr;
+			info.num_memory_aliases = 0;
+			physical_image_attachments[attachment] = device_.create_image(info, nullptr);
+		}
+
 		// Just keep storage images in GENERAL layout.
 		// There is no reason to try enabling compression.
 		if (!physical_image_attachments[attachment])
@@ -2292,6 +2634,7 @@ void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachm
 	}
 
 	physical_attachments[attachment] = &physical_image_attachments[attachment]->get_view();
+	return need_image;
 }
 
 void RenderGraph::setup_attachments(Vulkan::Device &device_, Vulkan::ImageView *swapchain)
@@ -2311,6 +2654,19 @@ void RenderGraph::setup_attachments(Vulkan::Device &device_, Vulkan::ImageView *
 	swapchain_attachment = swapchain;
 
 	unsigned num_attachments = physical_dimensions.size();
+
+	// Create memory alias group primaries up front so the other members have a
+	// shared allocation to bind into. If a primary is recreated, its members
+	// hold stale bindings and must be recreated as well.
+	std::vector<bool> force_recreate(num_attachments, false);
+	for (auto &group : physical_memory_alias_groups)
+	{
+		bool recreated = setup_physical_image(device_, group.front());
+		for (auto member : group)
+			if (member != group.front() && recreated)
+				force_recreate[member] = true;
+	}
+
 	for (unsigned i = 0; i < num_attachments; i++)
 	{
 		// Move over history attachments and events.
@@ -2334,7 +2690,7 @@ void RenderGraph::setup_attachments(Vulkan::Device &device_, Vulkan::ImageView *
 			else if (att.transient)
 				physical_attachments[i] = &device_.get_transient_attachment(att.width, att.height, att.format, i, att.samples, 1);
 			else
-				setup_physical_image(device_, i);
+				setup_physical_image(device_, i, force_recreate[i]);
 		}
 	}
 
@@ -2430,6 +2786,15 @@ void RenderGraph::traverse_dependencies(const RenderPass &pass, unsigned stack_c
 		// There might be no writers of this resource if it's used in a feedback fashion.
 		depend_passes_recursive(pass, input.buffer->get_write_passes(), stack_count, true, false, false);
 	}
+
+	for (auto *input : pass.get_history_inputs())
+	{
+		// The data consumed here was produced by the previous frame, so there is
+		// no dependency within the frame, but the writer must still be pulled into
+		// the graph even if nothing consumes its output this frame.
+		// Ignore self so a pass can consume history of its own output.
+		depend_passes_recursive(pass, input->get_write_passes(), stack_count, true, true, false);
+	}
 }
 
 void RenderGraph::depend_passes_recursive(const RenderPass &self, const std::unordered_set<unsigned> &written_passes,
@@ -2595,6 +2960,33 @@ void RenderGraph::bake()
 	if (itr == end(resource_to_index))
 		throw logic_error("Backbuffer source does not exist.");
 
+	auto &backbuffer_resource = *resources[itr->second];
+
+	if (backbuffer_resource.get_write_passes().empty())
+		throw logic_error("No pass exists which writes to resource.");
+
+	// The graph is torn down and re-declared from scratch whenever anything changes,
+	// but most rebakes end up re-declaring the exact same graph.
+	// If the structural hash matches the previous bake, the expensive analysis
+	// (dependency traversal, pass reordering and merging, barrier and alias building)
+	// would reproduce identical results, so keep the baked state and the physical
+	// resources backing it, and just rebind the freshly declared objects to it.
+	Util::Hash hash = get_structural_hash();
+	if (hash == baked_hash && !physical_passes.empty())
+	{
+		rebind_baked_state();
+		return;
+	}
+	baked_hash = hash;
+
+	// The structure changed, so derived state from the previous bake is stale.
+	physical_dimensions.clear();
+	physical_buffers.clear();
+	physical_image_attachments.clear();
+	physical_history_image_attachments.clear();
+	physical_events.clear();
+	physical_history_events.clear();
+
 	pass_stack.clear();
 
 	pass_dependencies.clear();
@@ -2603,11 +2995,6 @@ void RenderGraph::bake()
 	pass_merge_dependencies.resize(passes.size());
 
 	// Work our way back from the backbuffer, and sort out all the dependencies.
-	auto &backbuffer_resource = *resources[itr->second];
-
-	if (backbuffer_resource.get_write_passes().empty())
-		throw logic_error("No pass exists which writes to resource.");
-
 	for (auto &pass : backbuffer_resource.get_write_passes())
 		pass_stack.push_back(pass);
 
@@ -2644,6 +3031,23 @@ void RenderGraph::bake()
 
 	// Check if the swapchain needs to be blitted to in case the geometry does not match the backbuffer,
 	// or the usage of the image makes that impossible.
+	resolve_backbuffer_alias();
+
+	// Based on our render graph, figure out the barriers we actually need.
+	// Some barriers are implicit (transients), and some are redundant, i.e. same texture read in multiple passes.
+	build_physical_barriers();
+
+	// Figure out which images can alias with each other.
+	// Also build virtual "transfer" barriers. These things only copy events over to other physical resources.
+	build_aliases();
+
+	// Re-dumped on every bake, so the file tracks swapchain changes and graph edits.
+	if (const char *env = getenv("GRANITE_RENDER_GRAPH_DOT"))
+		export_graphviz(env);
+}
+
+void RenderGraph::resolve_backbuffer_alias()
+{
 	swapchain_physical_index = resources[resource_to_index[backbuffer_source]]->get_physical_index();
 
 	auto &backbuffer_dim = physical_dimensions[swapchain_physical_index];
@@ -2666,14 +3070,156 @@ void RenderGraph::bake()
 	}
 	else
 		physical_dimensions[swapchain_physical_index].transient = true;
+}
 
-	// Based on our render graph, figure out the barriers we actually need.
-	// Some barriers are implicit (transients), and some are redundant, i.e. same texture read in multiple passes.
-	build_physical_barriers();
+void RenderGraph::rebind_baked_state()
+{
+	// The declarations are fresh objects, so hand out the physical indices again.
+	// Assignment order in build_physical_resources only depends on the declarations
+	// and the retained pass_stack, so resources end up with the same physical
+	// indices as in the previous bake, and the retained physical passes, barriers
+	// and aliases remain valid as-is.
+	physical_dimensions.clear();
+	build_physical_resources();
 
-	// Figure out which images can alias with each other.
-	// Also build virtual "transfer" barriers. These things only copy events over to other physical resources.
-	build_aliases();
+	for (auto &physical_pass : physical_passes)
+	{
+		unsigned index = unsigned(&physical_pass - physical_passes.data());
+		for (auto &pass : physical_pass.passes)
+			passes[pass]->set_physical_pass_index(index);
+	}
+
+	// physical_dimensions was rebuilt from scratch, so the transient and
+	// backbuffer aliasing decisions have to be stamped onto it again.
+	build_transients();
+	resolve_backbuffer_alias();
+}
+
+Util::Hash RenderGraph::get_structural_hash()
+{
+	Util::Hasher h;
+
+	const auto hash_texture_list = [&](const std::vector<RenderTextureResource *> &list) {
+		h.u32(list.size());
+		for (auto *texture : list)
+			h.u32(texture ? texture->get_index() : RenderResource::Unused);
+	};
+
+	const auto hash_buffer_list = [&](const std::vector<RenderBufferResource *> &list) {
+		h.u32(list.size());
+		for (auto *buffer : list)
+			h.u32(buffer ? buffer->get_index() : RenderResource::Unused);
+	};
+
+	h.string(backbuffer_source);
+	h.u32(swapchain_dimensions.format);
+	h.u32(swapchain_dimensions.width);
+	h.u32(swapchain_dimensions.height);
+	h.u32(swapchain_dimensions.depth);
+	h.u32(swapchain_dimensions.layers);
+	h.u32(swapchain_dimensions.levels);
+	h.u32(swapchain_dimensions.samples);
+	h.u32(swapchain_dimensions.persistent);
+	// A scale change must invalidate the bake since aliasing and the
+	// backbuffer blit decision depend on concrete dimensions.
+	h.f32(resolution_scale);
+
+	h.u32(resources.size());
+	for (auto &resource : resources)
+	{
+		h.u32(unsigned(resource->get_type()));
+		h.string(resource->get_name());
+		h.u32(resource->get_used_queues());
+
+		if (resource->get_type() == RenderResource::Type::Texture)
+		{
+			auto &texture = static_cast<RenderTextureResource &>(*resource);
+			auto &info = texture.get_attachment_info();
+			h.u32(info.size_class);
+			h.f32(info.size_x);
+			h.f32(info.size_y);
+			h.f32(info.size_z);
+			h.u32(info.format);
+			h.string(info.size_relative_name);
+			h.u32(info.samples);
+			h.u32(info.levels);
+			h.u32(info.layers);
+			h.u32(info.aux_usage);
+			h.u32(info.persistent);
+			h.u32(info.unorm_srgb_alias);
+			h.u32(texture.get_image_usage());
+		}
+		else
+		{
+			auto &buffer = static_cast<RenderBufferResource &>(*resource);
+			auto &info = buffer.get_buffer_info();
+			h.u64(info.size);
+			h.u32(info.usage);
+			h.u32(info.persistent);
+			h.u32(buffer.get_buffer_usage());
+		}
+	}
+
+	h.u32(passes.size());
+	for (auto &pass_ptr : passes)
+	{
+		auto &pass = *pass_ptr;
+		h.string(pass.get_name());
+		h.u32(pass.get_queue());
+
+		hash_texture_list(pass.get_color_outputs());
+		hash_texture_list(pass.get_resolve_outputs());
+		hash_texture_list(pass.get_color_inputs());
+		hash_texture_list(pass.get_color_scale_inputs());
+		hash_texture_list(pass.get_storage_texture_outputs());
+		hash_texture_list(pass.get_storage_texture_inputs());
+		hash_texture_list(pass.get_blit_texture_inputs());
+		hash_texture_list(pass.get_blit_texture_outputs());
+		hash_texture_list(pass.get_attachment_inputs());
+		hash_texture_list(pass.get_history_inputs());
+		hash_buffer_list(pass.get_storage_inputs());
+		hash_buffer_list(pass.get_storage_outputs());
+		hash_buffer_list(pass.get_transfer_outputs());
+
+		h.u32(pass.get_generic_texture_inputs().size());
+		for (auto &input : pass.get_generic_texture_inputs())
+		{
+			h.u32(input.texture->get_index());
+			h.u32(input.layout);
+			h.u32(input.access);
+			h.u32(input.stages);
+		}
+
+		h.u32(pass.get_generic_buffer_inputs().size());
+		for (auto &input : pass.get_generic_buffer_inputs())
+		{
+			h.u32(input.buffer->get_index());
+			h.u32(input.layout);
+			h.u32(input.access);
+			h.u32(input.stages);
+		}
+
+		h.u32(pass.get_fake_resource_aliases().size());
+		for (auto &alias : pass.get_fake_resource_aliases())
+		{
+			h.u32(alias.first->get_index());
+			h.u32(alias.second->get_index());
+		}
+
+		auto *ds_input = pass.get_depth_stencil_input();
+		auto *ds_output = pass.get_depth_stencil_output();
+		h.u32(ds_input ? ds_input->get_index() : RenderResource::Unused);
+		h.u32(ds_output ? ds_output->get_index() : RenderResource::Unused);
+
+		// Clear-or-load decisions are baked into the render pass info,
+		// so the verdicts of the clear callbacks are structural state as well.
+		unsigned num_color_outputs = pass.get_color_outputs().size();
+		for (unsigned i = 0; i < num_color_outputs; i++)
+			h.u32(pass.get_clear_color(i));
+		h.u32(pass.get_clear_depth_stencil());
+	}
+
+	return h.get();
 }
 
 ResourceDimensions RenderGraph::get_resource_dimensions(const RenderBufferResource &resource) const
@@ -2704,8 +3250,8 @@ ResourceDimensions RenderGraph::get_resource_dimensions(const RenderTextureResou
 	switch (info.size_class)
 	{
 	case SizeClass::SwapchainRelative:
-		dim.width = std::max(unsigned(muglm::ceil(info.size_x * swapchain_dimensions.width)), 1u);
-		dim.height = std::max(unsigned(muglm::ceil(info.size_y * swapchain_dimensions.height)), 1u);
+		dim.width = std::max(unsigned(muglm::ceil(resolution_scale * info.size_x * swapchain_dimensions.width)), 1u);
+		dim.height = std::max(unsigned(muglm::ceil(resolution_scale * info.size_y * swapchain_dimensions.height)), 1u);
 		dim.depth = std::max(unsigned(muglm::ceil(info.size_z)), 1u);
 		break;
 
@@ -2784,7 +3330,7 @@ void RenderGraph::build_physical_barriers()
 
 		// Go over all physical passes, and observe their use of barriers.
 		// In multipass, only the first and last barriers need to be considered externally.
-		// Compute never has multipass.
+		// Fused compute works the same way; the in-pass barrier handles the interior.
 		unsigned subpasses = physical_pass.passes.size();
 		for (unsigned i = 0; i < subpasses; i++, ++barrier_itr)
 		{
@@ -3286,14 +3832,49 @@ void RenderGraph::reset()
 	resources.clear();
 	pass_to_index.clear();
 	resource_to_index.clear();
-	physical_passes.clear();
-	physical_dimensions.clear();
-	physical_attachments.clear();
-	physical_buffers.clear();
-	physical_image_attachments.clear();
-	physical_events.clear();
-	physical_history_events.clear();
-	physical_history_image_attachments.clear();
+
+	// The baked state and physical resources are deliberately kept alive here.
+	// bake() keeps them if the re-declared graph hashes to the same structure,
+	// and tears them down itself otherwise.
+}
+
+bool ResolutionScaleController::update(double gpu_time)
+{
+	if (gpu_time <= 0.0)
+		return false;
+
+	// Exponential moving average. A single hitched frame should not trigger
+	// a rebake, only a sustained trend.
+	if (smoothed_time <= 0.0)
+		smoothed_time = gpu_time;
+	else
+		smoothed_time += 0.1 * (gpu_time - smoothed_time);
+
+	if (hold_frames)
+	{
+		hold_frames--;
+		return false;
+	}
+
+	float new_scale = scale;
+
+	// Hysteresis. Lower resolution as soon as we clearly miss the target, but
+	// only raise it again when there is comfortable headroom, so the scale
+	// does not oscillate around the target.
+	if (smoothed_time > 1.05 * target_frame_time)
+		new_scale = scale - 0.05f;
+	else if (smoothed_time < 0.80 * target_frame_time)
+		new_scale = scale + 0.05f;
+
+	new_scale = muglm::clamp(new_scale, min_scale, max_scale);
+	if (new_scale == scale)
+		return false;
+
+	scale = new_scale;
+	hold_frames = HoldFramesAfterStep;
+	// The old average reflects the old resolution, start over.
+	smoothed_time = 0.0;
+	return true;
 }
 
 }
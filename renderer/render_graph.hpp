@@ -31,6 +31,7 @@
 #include <functional>
 #include "vulkan_headers.hpp"
 #include "device.hpp"
+#include "hash.hpp"
 #include "stack_allocator.hpp"
 #include "application_wsi_events.hpp"
 #include "quirks.hpp"
@@ -400,6 +401,14 @@ public:
 	RenderBufferResource &add_index_buffer_input(const std::string &name);
 	RenderBufferResource &add_indirect_buffer_input(const std::string &name);
 
+	// Gates execution of this pass on a 32-bit GPU predicate at the start of the
+	// named buffer, typically written by a small occlusion test pass earlier in
+	// the graph. Draws and dispatches are discarded via
+	// VK_EXT_conditional_rendering when the predicate is zero; without the
+	// extension the pass simply runs. Combine with set_need_render_pass() and a
+	// predicate readback for a CPU-side skip on one-frame-old negatives.
+	RenderBufferResource &add_conditional_input(const std::string &name);
+
 	void add_fake_resource_write_alias(const std::string &from, const std::string &to);
 
 	void make_color_input_scaled(unsigned index_)
@@ -482,6 +491,11 @@ public:
 		return generic_buffer;
 	}
 
+	RenderBufferResource *get_conditional_buffer() const
+	{
+		return conditional_buffer;
+	}
+
 	const std::vector<std::pair<RenderTextureResource *, RenderTextureResource *>> &get_fake_resource_aliases() const
 	{
 		return fake_resource_alias;
@@ -520,6 +534,22 @@ public:
 		return bool(need_render_pass_cb);
 	}
 
+	// Opt-in to compute pass fusion. Adjacent fusable compute passes in the
+	// same queue whose only dependencies are storage-to-storage (which stay in
+	// GENERAL layout) record into the same physical pass, separated by a plain
+	// compute-to-compute pipeline barrier instead of the full event and
+	// semaphore machinery. For micro-passes the inter-pass sync costs more
+	// than the dispatch itself.
+	void set_fusable(bool fusable_ = true)
+	{
+		fusable = fusable_;
+	}
+
+	bool is_fusable() const
+	{
+		return fusable;
+	}
+
 	bool get_clear_color(unsigned index_, VkClearColorValue * value = nullptr)
 	{
 		if (get_clear_color_cb)
@@ -584,6 +614,7 @@ private:
 	unsigned index;
 	unsigned physical_pass = Unused;
 	RenderGraphQueueFlagBits queue;
+	bool fusable = false;
 
 	std::function<void (Vulkan::CommandBuffer &)> build_render_pass_cb;
 	std::function<void (unsigned, Vulkan::CommandBuffer &)> build_render_pass_layered_cb;
@@ -606,6 +637,7 @@ private:
 	std::vector<RenderBufferResource *> transfer_outputs;
 	std::vector<AccessedTextureResource> generic_texture;
 	std::vector<AccessedBufferResource> generic_buffer;
+	RenderBufferResource *conditional_buffer = nullptr;
 	RenderTextureResource *depth_stencil_input = nullptr;
 	RenderTextureResource *depth_stencil_output = nullptr;
 
@@ -648,9 +680,31 @@ public:
 
 	void enable_timestamps(bool enable);
 
+	// Scales all SizeClass::SwapchainRelative resources for dynamic resolution.
+	// When the backbuffer source ends up smaller than the swapchain, the graph
+	// already falls back to a scaling blit in enqueue_render_passes(), so the
+	// final presentation stays at native resolution. A new scale takes effect
+	// on the next bake(); the scale is part of the structural hash, so a plain
+	// re-declare + bake() is enough to rebuild attachments.
+	void set_resolution_scale(float scale)
+	{
+		resolution_scale = scale;
+	}
+
+	float get_resolution_scale() const
+	{
+		return resolution_scale;
+	}
+
 	void bake();
 	void reset();
 	void log();
+	// Dumps the baked graph as graphviz dot through the filesystem protocol:
+	// logical passes clustered per physical pass, resources with their alias
+	// chains, and the external invalidate/flush barriers as labelled edges.
+	// With enable_timestamps() the cluster labels include averaged GPU time
+	// per physical pass. Call after bake().
+	bool export_graphviz(const std::string &path);
 	void setup_attachments(Vulkan::Device &device, Vulkan::ImageView *swapchain);
 	void enqueue_render_passes(Vulkan::Device &device);
 
@@ -775,18 +829,21 @@ private:
 	ResourceDimensions get_resource_dimensions(const RenderBufferResource &resource) const;
 	ResourceDimensions get_resource_dimensions(const RenderTextureResource &resource) const;
 	ResourceDimensions swapchain_dimensions;
+	float resolution_scale = 1.0f;
 
+	// Pass indices rather than pointers, so that the baked state stays valid
+	// when an identical graph is re-declared with fresh pass objects.
 	struct ColorClearRequest
 	{
-		RenderPass *pass;
+		unsigned pass;
 		VkClearColorValue *target;
 		unsigned index;
 	};
 
 	struct DepthClearRequest
 	{
-		RenderPass *pass;
-		VkClearDepthStencilValue *target;
+		unsigned pass = RenderPass::Unused;
+		VkClearDepthStencilValue *target = nullptr;
 	};
 
 	struct ScaledClearRequests
@@ -831,6 +888,14 @@ private:
 	void build_physical_barriers();
 	void build_render_pass_info();
 	void build_aliases();
+	void resolve_backbuffer_alias();
+
+	// Hash of the declared passes and resources plus backbuffer dimensions.
+	// Two declarations with equal hashes bake to identical derived state,
+	// so bake() reuses the previous bake wholesale when the hash matches.
+	Util::Hash get_structural_hash();
+	void rebind_baked_state();
+	Util::Hash baked_hash = 0;
 
 	bool enabled_timestamps = false;
 
@@ -859,6 +924,12 @@ private:
 	std::vector<bool> physical_image_has_history;
 	std::vector<unsigned> physical_aliases;
 
+	// Attachments with disjoint lifetimes but differing dimensions cannot share
+	// a VkImage, but they can still share one device memory allocation.
+	// The first member of a group owns the allocation, the rest bind into it.
+	std::vector<std::vector<unsigned>> physical_memory_alias_groups;
+	std::vector<unsigned> physical_memory_alias_primary;
+
 	Vulkan::ImageView *swapchain_attachment = nullptr;
 	unsigned swapchain_physical_index = RenderResource::Unused;
 
@@ -871,7 +942,8 @@ private:
 	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
 
 	void setup_physical_buffer(Vulkan::Device &device, unsigned attachment);
-	void setup_physical_image(Vulkan::Device &device, unsigned attachment);
+	// Returns true if the backing image was (re)created.
+	bool setup_physical_image(Vulkan::Device &device, unsigned attachment, bool force_recreate = false);
 
 	void depend_passes_recursive(const RenderPass &pass, const std::unordered_set<unsigned> &passes,
 	                             unsigned stack_count, bool no_check, bool ignore_self, bool merge_dependency);
@@ -885,4 +957,42 @@ private:
 	void reorder_passes(std::vector<unsigned> &passes);
 	static bool need_invalidate(const Barrier &barrier, const PipelineEvent &event);
 };
+
+// Drives RenderGraph::set_resolution_scale() from GPU frame time feedback.
+// Feed one GPU time sample per frame (seconds, e.g. from the timestamp
+// interval manager); when update() returns true, apply get_scale() to the
+// graph and rebake. The controller smooths samples and holds for a few
+// frames after each step so the pipeline drains before the next decision.
+class ResolutionScaleController
+{
+public:
+	void set_target_frame_time(double seconds)
+	{
+		target_frame_time = seconds;
+	}
+
+	void set_scale_range(float min_scale_, float max_scale_)
+	{
+		min_scale = min_scale_;
+		max_scale = max_scale_;
+	}
+
+	// Returns true when the scale stepped and the graph needs a rebake.
+	bool update(double gpu_time);
+
+	float get_scale() const
+	{
+		return scale;
+	}
+
+private:
+	double target_frame_time = 1.0 / 60.0;
+	double smoothed_time = 0.0;
+	float scale = 1.0f;
+	float min_scale = 0.5f;
+	float max_scale = 1.0f;
+	unsigned hold_frames = 0;
+
+	enum { HoldFramesAfterStep = 30 };
+};
 }
@@ -22,6 +22,7 @@
 
 #include "render_queue.hpp"
 #include "render_context.hpp"
+#include "thread_group.hpp"
 #include <cstring>
 #include <iterator>
 #include <algorithm>
@@ -33,14 +34,165 @@ using namespace Util;
 
 namespace Granite
 {
+// LSD radix sort over the 64-bit sorting keys. The keys are plain integers
+// designed for ordering, so this beats a comparison sort by a wide margin at
+// 30k+ draws, and it is stable by construction.
+static void radix_sort_range(RenderQueueData *data, size_t count, RenderQueueData *scratch)
+{
+	if (count < 2)
+		return;
+
+	auto *src = data;
+	auto *dst = scratch;
+
+	for (unsigned pass = 0; pass < 8; pass++)
+	{
+		unsigned shift = pass * 8;
+		size_t histogram[256] = {};
+		for (size_t i = 0; i < count; i++)
+			histogram[(src[i].sorting_key >> shift) & 0xffu]++;
+
+		// Every key shares this digit, nothing to reorder.
+		if (histogram[(src[0].sorting_key >> shift) & 0xffu] == count)
+			continue;
+
+		size_t offset = 0;
+		for (auto &h : histogram)
+		{
+			size_t tmp = h;
+			h = offset;
+			offset += tmp;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			dst[histogram[(src[i].sorting_key >> shift) & 0xffu]++] = src[i];
+		swap(src, dst);
+	}
+
+	if (src != data)
+		memcpy(data, src, count * sizeof(RenderQueueData));
+}
+
+void RenderQueue::radix_sort(std::vector<RenderQueueData> &queue)
+{
+	if (sort_scratch.size() < queue.size())
+		sort_scratch.resize(queue.size());
+	radix_sort_range(queue.data(), queue.size(), sort_scratch.data());
+}
+
+bool RenderQueue::sort_opaque_cached()
+{
+	auto &opaque = queues[ecast(Queue::Opaque)];
+
+	Util::Hasher h;
+	for (auto &e : opaque)
+		h.u64(e.sorting_key);
+	auto input_hash = h.get();
+
+	bool hit = input_hash == opaque_input_hash && !opaque.empty();
+	opaque_input_hash = input_hash;
+	if (!hit)
+	{
+		opaque_sorted_order.clear();
+		return false;
+	}
+
+	if (opaque_sorted_order.size() != opaque.size())
+	{
+		// First coherent frame. Argsort once so later frames replay the
+		// permutation without comparisons.
+		opaque_sorted_order.resize(opaque.size());
+		for (unsigned i = 0; i < unsigned(opaque.size()); i++)
+			opaque_sorted_order[i] = i;
+		stable_sort(begin(opaque_sorted_order), end(opaque_sorted_order), [&](unsigned a, unsigned b) {
+			return opaque[a].sorting_key < opaque[b].sorting_key;
+		});
+	}
+
+	if (sort_scratch.size() < opaque.size())
+		sort_scratch.resize(opaque.size());
+	size_t count = opaque.size();
+	for (size_t i = 0; i < count; i++)
+		sort_scratch[i] = opaque[opaque_sorted_order[i]];
+	memcpy(opaque.data(), sort_scratch.data(), count * sizeof(RenderQueueData));
+	return true;
+}
+
 void RenderQueue::sort()
 {
-	for (auto &queue : queues)
+	bool opaque_sorted = sort_opaque_cached();
+	for (unsigned i = 0; i < ecast(Queue::Count); i++)
+		if (!opaque_sorted || static_cast<Queue>(i) != Queue::Opaque)
+			radix_sort(queues[i]);
+}
+
+void RenderQueue::sort_parallel(ThreadGroup &workers)
+{
+	// The Opaque queue tends to dominate, split it into chunks which are radix
+	// sorted on workers, then merge. Stability holds since chunks keep their
+	// original order and merge prefers elements from the earlier chunk on ties.
+	auto &opaque = queues[ecast(Queue::Opaque)];
+
+	if (sort_opaque_cached())
+	{
+		for (unsigned i = 0; i < ecast(Queue::Count); i++)
+			if (static_cast<Queue>(i) != Queue::Opaque)
+				radix_sort(queues[i]);
+		return;
+	}
+
+	size_t count = opaque.size();
+	unsigned num_workers = std::max(1u, workers.get_num_threads());
+	constexpr size_t MinDrawsPerChunk = 4096;
+
+	unsigned num_chunks = unsigned(std::min<size_t>(num_workers, count / MinDrawsPerChunk));
+	if (num_chunks < 2)
+	{
+		// The Opaque hash was already refreshed above, sort everything inline.
+		for (auto &queue : queues)
+			radix_sort(queue);
+		return;
+	}
+
+	size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+	if (sort_scratch.size() < count)
+		sort_scratch.resize(count);
+
+	auto task = workers.create_task();
+	for (unsigned i = 0; i < num_chunks; i++)
 	{
-		stable_sort(begin(queue), end(queue), [](const RenderQueueData &a, const RenderQueueData &b) {
-			return a.sorting_key < b.sorting_key;
+		task->enqueue_task([&, i]() {
+			size_t chunk_begin = i * chunk_size;
+			size_t chunk_end = std::min(chunk_begin + chunk_size, count);
+			radix_sort_range(opaque.data() + chunk_begin, chunk_end - chunk_begin,
+			                 sort_scratch.data() + chunk_begin);
 		});
 	}
+	task->flush();
+	task->wait();
+
+	auto *src = opaque.data();
+	auto *dst = sort_scratch.data();
+	for (size_t width = chunk_size; width < count; width *= 2)
+	{
+		for (size_t lo = 0; lo < count; lo += 2 * width)
+		{
+			size_t mid = std::min(lo + width, count);
+			size_t hi = std::min(lo + 2 * width, count);
+			merge(src + lo, src + mid, src + mid, src + hi, dst + lo,
+			      [](const RenderQueueData &a, const RenderQueueData &b) {
+				      return a.sorting_key < b.sorting_key;
+			      });
+		}
+		swap(src, dst);
+	}
+	if (src != opaque.data())
+		memcpy(opaque.data(), src, count * sizeof(RenderQueueData));
+
+	// The other queues are small enough to sort inline.
+	for (unsigned i = 0; i < ecast(Queue::Count); i++)
+		if (static_cast<Queue>(i) != Queue::Opaque)
+			radix_sort(queues[i]);
 }
 
 void RenderQueue::combine_render_info(const RenderQueue &queue)
@@ -108,8 +260,32 @@ void *RenderQueue::allocate_from_block(Block &block, size_t size, size_t alignme
 		return nullptr;
 }
 
+void RenderQueue::update_peak_blocks()
+{
+	if (current != end(blocks))
+	{
+		size_t used = 1 + size_t(distance(begin(blocks), current));
+		if (used > peak_blocks)
+			peak_blocks = used;
+	}
+}
+
+void RenderQueue::reserve_peak_blocks()
+{
+	for (size_t count = blocks.size(); count < peak_blocks; count++)
+		insert_block();
+
+	if (current == end(blocks))
+	{
+		current = begin(blocks);
+		if (current != end(blocks))
+			current->reset();
+	}
+}
+
 void RenderQueue::reset()
 {
+	update_peak_blocks();
 	current = begin(blocks);
 	if (current != end(blocks))
 		current->reset();
@@ -123,6 +299,7 @@ void RenderQueue::reset()
 
 void RenderQueue::reset_and_reclaim()
 {
+	update_peak_blocks();
 	blocks.clear();
 	large_blocks.clear();
 	render_infos.clear();
@@ -36,6 +36,7 @@ namespace Granite
 {
 class ShaderSuite;
 class RenderContext;
+class ThreadGroup;
 
 enum class Queue : unsigned
 {
@@ -159,12 +160,32 @@ public:
 	void reset();
 	void reset_and_reclaim();
 
+	// Pre-grows the block chain to the high-water mark observed over earlier
+	// frames, so parallel enqueue (one RenderQueue per worker, merged with
+	// combine_render_info) never hits the global allocator mid-frame.
+	// Call from the thread which will fill the queue: zero-filling fresh blocks
+	// is the first touch, which places the pages on that worker's NUMA node.
+	void reserve_peak_blocks();
+
 	const std::vector<RenderQueueData> &get_queue_data(Queue queue) const
 	{
 		return queues[Util::ecast(queue)];
 	}
 
+	// Arena bytes held by the block chains, including oversized blocks.
+	size_t get_allocated_bytes() const
+	{
+		size_t size = 0;
+		for (auto &block : blocks)
+			size += block.buffer.size();
+		for (auto &block : large_blocks)
+			size += block.buffer.size();
+		return size;
+	}
+
 	void sort();
+	// Stable parallel variant which splits the Opaque queue across ThreadGroup tasks.
+	void sort_parallel(ThreadGroup &workers);
 	void dispatch(Queue queue, Vulkan::CommandBuffer &cmd, const Vulkan::CommandBufferSavedState *state);
 	void dispatch(Queue queue, Vulkan::CommandBuffer &cmd, const Vulkan::CommandBufferSavedState *state, size_t begin, size_t end);
 
@@ -214,9 +235,22 @@ private:
 
 	std::vector<RenderQueueData> queues[static_cast<unsigned>(Queue::Count)];
 
+	// Scratch buffer for radix sorting, reused across frames.
+	std::vector<RenderQueueData> sort_scratch;
+	void radix_sort(std::vector<RenderQueueData> &queue);
+
+	// Frame-coherence cache for the Opaque queue. When the unsorted key
+	// sequence matches the previous frame (static viewport), the sorted order
+	// is replayed as one O(n) gather instead of re-sorting.
+	Util::Hash opaque_input_hash = 0;
+	std::vector<unsigned> opaque_sorted_order;
+	bool sort_opaque_cached();
+
 	void *allocate_from_block(Block &block, size_t size, size_t alignment);
 	Chain::iterator insert_block();
 	Chain::iterator insert_large_block(size_t size, size_t alignment);
+	void update_peak_blocks();
+	size_t peak_blocks = 0;
 
 	ShaderSuite *shader_suites = nullptr;
 	Util::IntrusiveHashMapHolder<QueueDataWrappedErased> render_infos;
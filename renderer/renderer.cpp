@@ -27,6 +27,10 @@
 #include "lights/clusterer.hpp"
 #include "lights/volumetric_fog.hpp"
 #include "render_parameters.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#include "thread_id.hpp"
+#include "small_vector.hpp"
 #include <string.h>
 
 using namespace Vulkan;
@@ -128,9 +132,11 @@ void Renderer::set_mesh_renderer_options_internal(RendererOptionFlags flags)
 	point.bake_base_defines();
 
 	// Skybox renderers only depend on VOLUMETRIC_FOG.
+	// Impostors sample a pre-lit atlas, so they don't care about the lighting defines either.
 	ShaderSuite *suites[] = {
 		&suite[ecast(RenderableType::Skybox)],
 		&suite[ecast(RenderableType::SkyCylinder)],
+		&suite[ecast(RenderableType::Impostor)],
 	};
 
 	for (auto *shader_suite : suites)
@@ -187,10 +193,8 @@ vector<pair<string, int>> Renderer::build_defines_from_renderer_options(Renderer
 	if (flags & (POSITIONAL_LIGHT_SHADOW_VSM_BIT | SHADOW_VSM_BIT))
 		global_defines.emplace_back("SHADOW_RESOLVE_VSM", 1);
 
-	if (flags & SHADOW_PCF_KERNEL_WIDTH_5_BIT)
-		global_defines.emplace_back("SHADOW_MAP_PCF_KERNEL_WIDTH", 5);
-	else if (flags & SHADOW_PCF_KERNEL_WIDTH_3_BIT)
-		global_defines.emplace_back("SHADOW_MAP_PCF_KERNEL_WIDTH", 3);
+	// PCF kernel width and cluster debug are specialization constants,
+	// not defines, see flush_internal().
 
 	if (flags & ALPHA_TEST_DISABLE_BIT)
 		global_defines.emplace_back("ALPHA_TEST_DISABLE", 1);
@@ -273,6 +277,10 @@ void Renderer::on_device_destroyed(const DeviceCreatedEvent &)
 
 void Renderer::begin()
 {
+	if (device)
+		if (auto *trace = device->get_timeline_trace_file())
+			trace->push_counter("render-queue-bytes", queue.get_allocated_bytes());
+
 	queue.reset();
 	queue.set_shader_suites(suite);
 }
@@ -317,6 +325,10 @@ static void set_cluster_parameters_bindless(Vulkan::CommandBuffer &cmd, const Li
 	cmd.set_storage_buffer(0, 3, *cluster.get_cluster_transform_buffer());
 	cmd.set_storage_buffer(0, 4, *cluster.get_cluster_bitmask_buffer());
 	cmd.set_storage_buffer(0, 5, *cluster.get_cluster_range_buffer());
+
+	// Only consumed by variants which declare CLUSTERER_VOLUMES.
+	cmd.set_storage_buffer(0, 6, *cluster.get_cluster_volume_bitmask_buffer());
+	cmd.set_storage_buffer(0, 7, *cluster.get_cluster_volume_data_buffer());
 	if (cluster.get_cluster_shadow_map_bindless_set() != VK_NULL_HANDLE)
 		cmd.set_bindless(4, cluster.get_cluster_shadow_map_bindless_set());
 }
@@ -405,6 +417,56 @@ void Renderer::set_render_context_parameter_binder(RenderContextParameterBinder
 }
 
 void Renderer::flush(Vulkan::CommandBuffer &cmd, RenderContext &context, RendererFlushFlags options)
+{
+	flush_internal(cmd, context, options, false);
+}
+
+void Renderer::flush_multithreaded(Vulkan::CommandBuffer &cmd, RenderContext &context, RendererFlushFlags options)
+{
+	flush_internal(cmd, context, options, true);
+}
+
+void Renderer::dispatch_queue_multithreaded(Queue queue_type, Vulkan::CommandBuffer &cmd,
+                                            const Vulkan::CommandBufferSavedState &state)
+{
+	size_t count = queue.get_queue_data(queue_type).size();
+	if (!count)
+		return;
+
+	auto &workers = *Global::thread_group();
+	unsigned num_workers = std::max(1u, workers.get_num_threads());
+
+	// Keep enough draws per range that the fixed overhead of a secondary
+	// command buffer doesn't dominate for small queues.
+	constexpr size_t MinDrawsPerRange = 64;
+	size_t range_size = std::max<size_t>((count + num_workers - 1) / num_workers, MinDrawsPerRange);
+	unsigned num_ranges = unsigned((count + range_size - 1) / range_size);
+
+	Util::SmallVector<Vulkan::CommandBufferHandle> secondaries(num_ranges);
+	auto task = workers.create_task();
+	for (unsigned i = 0; i < num_ranges; i++)
+	{
+		task->enqueue_task([&, i]() {
+			auto secondary = cmd.request_secondary_command_buffer(Vulkan::get_current_thread_index(),
+			                                                      cmd.get_current_subpass());
+			// Secondary buffers begin with clean binding and render state,
+			// restore the state the primary set up for this queue.
+			secondary->restore_state(state);
+			queue.dispatch(queue_type, *secondary, &state,
+			               i * range_size, std::min((i + 1) * range_size, count));
+			secondaries[i] = std::move(secondary);
+		});
+	}
+	task->flush();
+	task->wait();
+
+	// Execution order must match the sorted queue order.
+	for (auto &secondary : secondaries)
+		cmd.submit_secondary(std::move(secondary));
+}
+
+void Renderer::flush_internal(Vulkan::CommandBuffer &cmd, RenderContext &context,
+                              RendererFlushFlags options, bool multithreaded)
 {
 	if (render_context_parameter_binder)
 	{
@@ -418,10 +480,27 @@ void Renderer::flush(Vulkan::CommandBuffer &cmd, RenderContext &context, Rendere
 	}
 
 	if ((options & SKIP_SORTING_BIT) == 0)
-		queue.sort();
+	{
+		if (multithreaded)
+			queue.sort_parallel(*Global::thread_group());
+		else
+			queue.sort();
+	}
 
 	cmd.set_opaque_state();
 
+	// Common toggles live in specialization constants rather than shader
+	// defines, so flipping them reuses the same SPIR-V modules and only
+	// costs a pipeline permutation. IDs 0 and 1 are left for per-shader use.
+	int pcf_width = 1;
+	if (renderer_options & SHADOW_PCF_KERNEL_WIDTH_5_BIT)
+		pcf_width = 5;
+	else if (renderer_options & SHADOW_PCF_KERNEL_WIDTH_3_BIT)
+		pcf_width = 3;
+	cmd.set_specialization_constant_mask(0xc);
+	cmd.set_specialization_constant(2, pcf_width);
+	cmd.set_specialization_constant(3, uint32_t((renderer_options & POSITIONAL_LIGHT_CLUSTER_DEBUG_BIT) != 0));
+
 	if (options & FRONT_FACE_CLOCKWISE_BIT)
 		cmd.set_front_face(VK_FRONT_FACE_CLOCKWISE);
 
@@ -455,11 +534,30 @@ void Renderer::flush(Vulkan::CommandBuffer &cmd, RenderContext &context, Rendere
 		cmd.set_stencil_reference(stencil_compare_mask, stencil_write_mask, stencil_reference);
 	}
 
+	CommandBufferSaveStateFlags save_flags = COMMAND_BUFFER_SAVED_SCISSOR_BIT |
+	                                         COMMAND_BUFFER_SAVED_VIEWPORT_BIT |
+	                                         COMMAND_BUFFER_SAVED_RENDER_STATE_BIT;
+	if (multithreaded)
+	{
+		// Descriptor bindings and push constants do not carry over into
+		// secondary command buffers, so they must be part of the restored state.
+		for (unsigned i = 0; i < VULKAN_NUM_DESCRIPTOR_SETS; i++)
+			save_flags |= COMMAND_BUFFER_SAVED_BINDINGS_0_BIT << i;
+		save_flags |= COMMAND_BUFFER_SAVED_PUSH_CONSTANT_BIT;
+	}
+
+	const auto dispatch_queue = [&](Queue queue_type, CommandBufferSavedState &state) {
+		if (multithreaded)
+			dispatch_queue_multithreaded(queue_type, cmd, state);
+		else
+			queue.dispatch(queue_type, cmd, &state);
+	};
+
 	CommandBufferSavedState state;
-	cmd.save_state(COMMAND_BUFFER_SAVED_SCISSOR_BIT | COMMAND_BUFFER_SAVED_VIEWPORT_BIT | COMMAND_BUFFER_SAVED_RENDER_STATE_BIT, state);
+	cmd.save_state(save_flags, state);
 	// No need to spend write bandwidth on writing 0 to light buffer, render opaque emissive on top.
-	queue.dispatch(Queue::Opaque, cmd, &state);
-	queue.dispatch(Queue::OpaqueEmissive, cmd, &state);
+	dispatch_queue(Queue::Opaque, state);
+	dispatch_queue(Queue::OpaqueEmissive, state);
 
 	if (type == RendererType::GeneralDeferred)
 	{
@@ -479,8 +577,8 @@ void Renderer::flush(Vulkan::CommandBuffer &cmd, RenderContext &context, Rendere
 
 		cmd.set_stencil_front_ops(VK_COMPARE_OP_EQUAL, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP);
 		cmd.set_stencil_back_ops(VK_COMPARE_OP_EQUAL, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP);
-		cmd.save_state(COMMAND_BUFFER_SAVED_SCISSOR_BIT | COMMAND_BUFFER_SAVED_VIEWPORT_BIT | COMMAND_BUFFER_SAVED_RENDER_STATE_BIT, state);
-		queue.dispatch(Queue::Light, cmd, &state);
+		cmd.save_state(save_flags, state);
+		dispatch_queue(Queue::Light, state);
 	}
 	else if (type == RendererType::GeneralForward)
 	{
@@ -490,8 +588,8 @@ void Renderer::flush(Vulkan::CommandBuffer &cmd, RenderContext &context, Rendere
 		cmd.set_blend_factors(VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA);
 		cmd.set_blend_op(VK_BLEND_OP_ADD);
 		cmd.set_depth_test(true, false);
-		cmd.save_state(COMMAND_BUFFER_SAVED_SCISSOR_BIT | COMMAND_BUFFER_SAVED_VIEWPORT_BIT | COMMAND_BUFFER_SAVED_RENDER_STATE_BIT, state);
-		queue.dispatch(Queue::Transparent, cmd, &state);
+		cmd.save_state(save_flags, state);
+		dispatch_queue(Queue::Transparent, state);
 	}
 }
 
@@ -584,6 +682,72 @@ void Renderer::push_depth_renderables(RenderContext &context, const VisibilityLi
 		vis.renderable->get_depth_render_info(context, vis.transform, queue);
 }
 
+void Renderer::push_renderables_parallel_internal(RenderContext &context, const VisibilityList &visible, bool depth)
+{
+	// Below this the task overhead eats the win.
+	constexpr size_t MinRenderablesPerChunk = 512;
+
+	auto &workers = *Global::thread_group();
+	size_t count = visible.size();
+	unsigned num_workers = std::max(1u, workers.get_num_threads());
+	unsigned num_chunks = unsigned(std::min<size_t>(num_workers, count / MinRenderablesPerChunk));
+
+	if (num_chunks < 2)
+	{
+		if (depth)
+			push_depth_renderables(context, visible);
+		else
+			push_renderables(context, visible);
+		return;
+	}
+
+	while (worker_queues.size() < num_chunks)
+		worker_queues.emplace_back(new RenderQueue);
+
+	size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+	auto task = workers.create_task();
+
+	for (unsigned i = 0; i < num_chunks; i++)
+	{
+		auto &worker_queue = *worker_queues[i];
+		worker_queue.reset();
+		worker_queue.set_shader_suites(suite);
+
+		task->enqueue_task([&worker_queue, &context, &visible, i, chunk_size, count, depth]() {
+			// First touch of fresh arena blocks happens on the filling worker.
+			worker_queue.reserve_peak_blocks();
+			size_t begin_index = i * chunk_size;
+			size_t end_index = std::min(begin_index + chunk_size, count);
+			if (depth)
+			{
+				for (size_t j = begin_index; j < end_index; j++)
+					visible[j].renderable->get_depth_render_info(context, visible[j].transform, worker_queue);
+			}
+			else
+			{
+				for (size_t j = begin_index; j < end_index; j++)
+					visible[j].renderable->get_render_info(context, visible[j].transform, worker_queue);
+			}
+		});
+	}
+
+	task->flush();
+	task->wait();
+
+	for (unsigned i = 0; i < num_chunks; i++)
+		queue.combine_render_info(*worker_queues[i]);
+}
+
+void Renderer::push_renderables_parallel(RenderContext &context, const VisibilityList &visible)
+{
+	push_renderables_parallel_internal(context, visible, false);
+}
+
+void Renderer::push_depth_renderables_parallel(RenderContext &context, const VisibilityList &visible)
+{
+	push_renderables_parallel_internal(context, visible, true);
+}
+
 void DeferredLightRenderer::render_light(Vulkan::CommandBuffer &cmd, RenderContext &context,
                                          Renderer::RendererOptionFlags flags)
 {
@@ -610,19 +774,34 @@ void DeferredLightRenderer::render_light(Vulkan::CommandBuffer &cmd, RenderConte
 		defines.emplace_back("SHADOWS", 1);
 		if (!format_has_depth_or_stencil_aspect(light.shadow_far->get_format()))
 			defines.emplace_back("DIRECTIONAL_SHADOW_VSM", 1);
-		else
-		{
-			if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_5_BIT)
-				defines.emplace_back("SHADOW_MAP_PCF_KERNEL_WIDTH", 5);
-			else if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_3_BIT)
-				defines.emplace_back("SHADOW_MAP_PCF_KERNEL_WIDTH", 3);
-		}
 	}
 	if (light.ambient_occlusion)
 		defines.emplace_back("AMBIENT_OCCLUSION", 1);
 
+	// Subgroup-uniform material classification in the resolve shader.
+	// See MATERIAL_FAST_PATHS in lighting.h.
+	auto &subgroup = device.get_device_features().subgroup_properties;
+	if ((subgroup.supportedStages & VK_SHADER_STAGE_FRAGMENT_BIT) != 0 &&
+	    !ImplementationQuirks::get().force_no_subgroups &&
+	    subgroup.subgroupSize >= 4 &&
+	    (subgroup.supportedOperations & VK_SUBGROUP_FEATURE_VOTE_BIT) != 0)
+	{
+		defines.emplace_back("SUBGROUP_VOTE", 1);
+		defines.emplace_back("MATERIAL_FAST_PATHS", 1);
+	}
+
 	unsigned variant = program->register_variant(defines);
 	cmd.set_program(program->get_program(variant));
+
+	// PCF kernel width is a specialization constant so that all widths
+	// share one module.
+	int pcf_width = 1;
+	if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_5_BIT)
+		pcf_width = 5;
+	else if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_3_BIT)
+		pcf_width = 3;
+	cmd.set_specialization_constant_mask(0x4);
+	cmd.set_specialization_constant(2, pcf_width);
 	cmd.set_depth_test(true, false);
 	cmd.set_depth_compare(VK_COMPARE_OP_GREATER);
 
@@ -719,13 +898,6 @@ void DeferredLightRenderer::render_light(Vulkan::CommandBuffer &cmd, RenderConte
 			cluster_defines.emplace_back("POSITIONAL_LIGHTS_SHADOW", 1);
 			if (light.cluster->get_shadow_type() == LightClusterer::ShadowType::VSM)
 				cluster_defines.emplace_back("POSITIONAL_SHADOW_VSM", 1);
-			else
-			{
-				if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_5_BIT)
-					cluster_defines.emplace_back("SHADOW_MAP_PCF_KERNEL_WIDTH", 5);
-				else if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_3_BIT)
-					cluster_defines.emplace_back("SHADOW_MAP_PCF_KERNEL_WIDTH", 3);
-			}
 		}
 
 		if (light.cluster->clusterer_is_bindless())
@@ -747,6 +919,15 @@ void DeferredLightRenderer::render_light(Vulkan::CommandBuffer &cmd, RenderConte
 		                "builtin://shaders/lights/clustering.frag",
 		                cluster_defines);
 
+		int cluster_pcf_width = 1;
+		if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_5_BIT)
+			cluster_pcf_width = 5;
+		else if (flags & Renderer::SHADOW_PCF_KERNEL_WIDTH_3_BIT)
+			cluster_pcf_width = 3;
+		cmd.set_specialization_constant_mask(0xc);
+		cmd.set_specialization_constant(2, cluster_pcf_width);
+		cmd.set_specialization_constant(3, uint32_t((flags & Renderer::POSITIONAL_LIGHT_CLUSTER_DEBUG_BIT) != 0));
+
 		cmd.push_constants(&cluster_push, 0, sizeof(cluster_push));
 		set_cluster_parameters(cmd, *light.cluster);
 		CommandBufferUtil::draw_fullscreen_quad(cmd);
@@ -831,6 +1012,10 @@ void ShaderSuiteResolver::init_shader_suite(Device &device, ShaderSuite &suite,
 			suite.init_graphics(&device.get_shader_manager(), "builtin://shaders/texture_plane.vert", "builtin://shaders/texture_plane.frag");
 			break;
 
+		case RenderableType::Impostor:
+			suite.init_graphics(&device.get_shader_manager(), "builtin://shaders/impostor.vert", "builtin://shaders/impostor.frag");
+			break;
+
 		default:
 			break;
 		}
@@ -37,6 +37,7 @@ enum class RenderableType
 	TexturePlane,
 	SpotLight,
 	PointLight,
+	Impostor,
 	Custom,
 	Count
 };
@@ -24,6 +24,10 @@
 #include "transforms.hpp"
 #include "lights/lights.hpp"
 #include "simd.hpp"
+#include "bitops.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#include <algorithm>
 #include <float.h>
 
 using namespace std;
@@ -64,23 +68,348 @@ Scene::~Scene()
 }
 
 template <typename T>
-static void gather_visible_renderables(const Frustum &frustum, VisibilityList &list, const T &objects)
+void Scene::update_cached_spatial_list(CachedSpatialList &spatials, const T &objects, bool snapshot)
 {
+	spatials.center_x.clear();
+	spatials.center_y.clear();
+	spatials.center_z.clear();
+	spatials.extent_x.clear();
+	spatials.extent_y.clear();
+	spatials.extent_z.clear();
+	spatials.infos.clear();
+	spatials.always_visible.clear();
+
+	spatials.center_x.reserve(objects.size());
+	spatials.center_y.reserve(objects.size());
+	spatials.center_z.reserve(objects.size());
+	spatials.extent_x.reserve(objects.size());
+	spatials.extent_y.reserve(objects.size());
+	spatials.extent_z.reserve(objects.size());
+	spatials.infos.reserve(objects.size());
+
 	for (auto &o : objects)
 	{
 		auto *transform = get_component<RenderInfoComponent>(o);
 		auto *renderable = get_component<RenderableComponent>(o);
 
-		if (transform->transform)
+		if (!transform->transform)
+		{
+			spatials.always_visible.push_back({ renderable->renderable.get(), nullptr });
+		}
+		else if ((renderable->renderable->flags & RENDERABLE_FORCE_VISIBLE_BIT) != 0)
+		{
+			spatials.always_visible.push_back({ renderable->renderable.get(), transform });
+		}
+		else
 		{
-			if ((renderable->renderable->flags & RENDERABLE_FORCE_VISIBLE_BIT) != 0 ||
-			    SIMD::frustum_cull(transform->world_aabb, frustum.get_planes()))
+			auto &aabb = transform->world_aabb;
+			vec3 center = aabb.get_center();
+			vec3 extent = 0.5f * (aabb.get_maximum() - aabb.get_minimum());
+			spatials.center_x.push_back(center.x);
+			spatials.center_y.push_back(center.y);
+			spatials.center_z.push_back(center.z);
+			spatials.extent_x.push_back(extent.x);
+			spatials.extent_y.push_back(extent.y);
+			spatials.extent_z.push_back(extent.z);
+			spatials.infos.push_back({ renderable->renderable.get(), transform });
+		}
+	}
+
+	if (snapshot)
+	{
+		// Redirect the handed-out pointers into list-owned copies. Everything
+		// is reserved up front since the entries keep raw pointers into the
+		// snapshot arrays.
+		size_t count = spatials.infos.size() + spatials.always_visible.size();
+		spatials.info_snapshot.clear();
+		spatials.transform_snapshot.clear();
+		spatials.skin_snapshot.clear();
+		spatials.info_snapshot.reserve(count);
+		spatials.transform_snapshot.reserve(count);
+		spatials.skin_snapshot.reserve(count);
+
+		const auto snap = [&spatials](RenderableInfo &info) {
+			if (!info.transform)
+				return;
+
+			spatials.info_snapshot.push_back(*info.transform);
+			auto &copy = spatials.info_snapshot.back();
+			if (copy.transform)
 			{
-				list.push_back({ renderable->renderable.get(), transform });
+				spatials.transform_snapshot.push_back(*copy.transform);
+				copy.transform = &spatials.transform_snapshot.back();
+			}
+			if (copy.skin_transform)
+			{
+				spatials.skin_snapshot.push_back(*copy.skin_transform);
+				copy.skin_transform = &spatials.skin_snapshot.back();
+			}
+			info.transform = &copy;
+		};
+
+		for (auto &info : spatials.infos)
+			snap(info);
+		for (auto &info : spatials.always_visible)
+			snap(info);
+	}
+
+	spatials.visibility.resize((spatials.infos.size() + 31) / 32);
+	update_spatial_morton_order(spatials);
+	update_spatial_bvh(spatials);
+}
+
+// Interleaves the low 10 bits of v with two zero bits between each.
+static uint32_t morton_expand_bits(uint32_t v)
+{
+	v = (v | (v << 16)) & 0x030000ffu;
+	v = (v | (v << 8)) & 0x0300f00fu;
+	v = (v | (v << 4)) & 0x030c30c3u;
+	v = (v | (v << 2)) & 0x09249249u;
+	return v;
+}
+
+void Scene::update_spatial_morton_order(CachedSpatialList &spatials)
+{
+	uint32_t count = uint32_t(spatials.infos.size());
+
+	// Tiny lists fit in cache whatever the order is.
+	if (count < 128)
+	{
+		spatials.morton_order.clear();
+		spatials.morton_countdown = 0;
+		return;
+	}
+
+	bool recompute = spatials.morton_order.size() != count;
+	if (spatials.morton_countdown)
+		spatials.morton_countdown--;
+	if (!spatials.morton_countdown)
+		recompute = true;
+
+	if (recompute)
+	{
+		// Membership can shuffle without changing the count, so refresh the key
+		// every so often even if nothing obvious happened.
+		spatials.morton_countdown = 64;
+
+		vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			vec3 c(spatials.center_x[i], spatials.center_y[i], spatials.center_z[i]);
+			lo = min(lo, c);
+			hi = max(hi, c);
+		}
+		vec3 scale = vec3(1023.0f) / max(hi - lo, vec3(1e-5f));
+
+		spatials.morton_codes.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto x = uint32_t(clamp((spatials.center_x[i] - lo.x) * scale.x, 0.0f, 1023.0f));
+			auto y = uint32_t(clamp((spatials.center_y[i] - lo.y) * scale.y, 0.0f, 1023.0f));
+			auto z = uint32_t(clamp((spatials.center_z[i] - lo.z) * scale.z, 0.0f, 1023.0f));
+			spatials.morton_codes[i] = (morton_expand_bits(x) << 2) |
+			                           (morton_expand_bits(y) << 1) |
+			                           morton_expand_bits(z);
+		}
+
+		spatials.morton_order.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			spatials.morton_order[i] = i;
+		sort(spatials.morton_order.begin(), spatials.morton_order.end(),
+		     [&spatials](uint32_t a, uint32_t b) {
+			     return spatials.morton_codes[a] < spatials.morton_codes[b];
+		     });
+	}
+
+	// Permute the SoA mirrors and the handle array. The handles are pointers into
+	// component storage, so external references are unaffected by the reorder.
+	const auto permute = [&spatials, count](std::vector<float> &v) {
+		spatials.morton_scratch.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			spatials.morton_scratch[i] = v[spatials.morton_order[i]];
+		v.swap(spatials.morton_scratch);
+	};
+	permute(spatials.center_x);
+	permute(spatials.center_y);
+	permute(spatials.center_z);
+	permute(spatials.extent_x);
+	permute(spatials.extent_y);
+	permute(spatials.extent_z);
+
+	spatials.morton_scratch_infos.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+		spatials.morton_scratch_infos[i] = spatials.infos[spatials.morton_order[i]];
+	spatials.infos.swap(spatials.morton_scratch_infos);
+}
+
+void Scene::update_spatial_bvh(CachedSpatialList &spatials)
+{
+	const uint32_t MaxLeafSize = 32;
+	uint32_t count = uint32_t(spatials.infos.size());
+
+	// Small lists are better served by the flat batched cull.
+	if (count < 32 * MaxLeafSize)
+	{
+		spatials.bvh_nodes.clear();
+		spatials.bvh_order.clear();
+		return;
+	}
+
+	// A stale permutation is still a valid partition of the boxes, so as long as
+	// the count matches we can keep the topology and just refit the bounds below.
+	// Split quality only degrades if membership churns, which also changes the count
+	// in practice.
+	if (spatials.bvh_order.size() != count)
+	{
+		spatials.bvh_order.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			spatials.bvh_order[i] = i;
+
+		spatials.bvh_nodes.clear();
+		spatials.bvh_nodes.reserve(2 * (count / MaxLeafSize));
+
+		struct Range
+		{
+			uint32_t node;
+			uint32_t first;
+			uint32_t count;
+		};
+		std::vector<Range> pending;
+		spatials.bvh_nodes.push_back({});
+		pending.push_back({ 0, 0, count });
+
+		while (!pending.empty())
+		{
+			auto range = pending.back();
+			pending.pop_back();
+
+			if (range.count <= MaxLeafSize)
+			{
+				auto &node = spatials.bvh_nodes[range.node];
+				node.first = range.first;
+				node.count = range.count;
+				continue;
+			}
+
+			// Median split along the widest axis of the centroid bounds.
+			vec3 lo(FLT_MAX), hi(-FLT_MAX);
+			for (uint32_t i = range.first; i < range.first + range.count; i++)
+			{
+				uint32_t index = spatials.bvh_order[i];
+				vec3 c(spatials.center_x[index], spatials.center_y[index], spatials.center_z[index]);
+				lo = min(lo, c);
+				hi = max(hi, c);
 			}
+
+			vec3 extent = hi - lo;
+			const float *axis_centers = spatials.center_x.data();
+			if (extent.y > extent.x && extent.y >= extent.z)
+				axis_centers = spatials.center_y.data();
+			else if (extent.z > extent.x && extent.z > extent.y)
+				axis_centers = spatials.center_z.data();
+
+			uint32_t mid = range.first + range.count / 2;
+			std::nth_element(spatials.bvh_order.begin() + range.first,
+			                 spatials.bvh_order.begin() + mid,
+			                 spatials.bvh_order.begin() + range.first + range.count,
+			                 [axis_centers](uint32_t a, uint32_t b) {
+				                 return axis_centers[a] < axis_centers[b];
+			                 });
+
+			uint32_t left = uint32_t(spatials.bvh_nodes.size());
+			spatials.bvh_nodes.push_back({});
+			spatials.bvh_nodes.push_back({});
+
+			auto &node = spatials.bvh_nodes[range.node];
+			node.children[0] = left;
+			node.children[1] = left + 1;
+			node.count = 0;
+
+			pending.push_back({ left, range.first, mid - range.first });
+			pending.push_back({ left + 1, mid, range.first + range.count - mid });
+		}
+	}
+
+	// Refit bottom-up. Children are always created after their parent,
+	// so a reverse walk sees both children before the interior node.
+	for (size_t i = spatials.bvh_nodes.size(); i; i--)
+	{
+		auto &node = spatials.bvh_nodes[i - 1];
+		if (node.count)
+		{
+			vec3 lo(FLT_MAX), hi(-FLT_MAX);
+			for (uint32_t j = node.first; j < node.first + node.count; j++)
+			{
+				uint32_t index = spatials.bvh_order[j];
+				vec3 c(spatials.center_x[index], spatials.center_y[index], spatials.center_z[index]);
+				vec3 e(spatials.extent_x[index], spatials.extent_y[index], spatials.extent_z[index]);
+				lo = min(lo, c - e);
+				hi = max(hi, c + e);
+			}
+			node.bounds = AABB(lo, hi);
 		}
 		else
-			list.push_back({ renderable->renderable.get(), nullptr});
+		{
+			node.bounds = spatials.bvh_nodes[node.children[0]].bounds;
+			node.bounds.expand(spatials.bvh_nodes[node.children[1]].bounds);
+		}
+	}
+}
+
+void Scene::gather_visible_renderables(const Frustum &frustum, VisibilityList &list, CachedSpatialList &spatials)
+{
+	for (auto &info : spatials.always_visible)
+		list.push_back(info);
+
+	size_t count = spatials.infos.size();
+	if (!count)
+		return;
+
+	if (!spatials.bvh_nodes.empty())
+	{
+		const vec4 *planes = frustum.get_planes();
+		uint32_t stack[64];
+		unsigned stack_count = 0;
+		stack[stack_count++] = 0;
+
+		while (stack_count)
+		{
+			auto &node = spatials.bvh_nodes[stack[--stack_count]];
+			if (!SIMD::frustum_cull(node.bounds, planes))
+				continue;
+
+			if (node.count)
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					uint32_t index = spatials.bvh_order[i];
+					vec3 c(spatials.center_x[index], spatials.center_y[index], spatials.center_z[index]);
+					vec3 e(spatials.extent_x[index], spatials.extent_y[index], spatials.extent_z[index]);
+					if (SIMD::frustum_cull(AABB(c - e, c + e), planes))
+						list.push_back(spatials.infos[index]);
+				}
+			}
+			else
+			{
+				stack[stack_count++] = node.children[0];
+				stack[stack_count++] = node.children[1];
+			}
+		}
+		return;
+	}
+
+	auto *visibility = spatials.visibility.data();
+	frustum.intersects_soa(visibility,
+	                       spatials.center_x.data(), spatials.center_y.data(), spatials.center_z.data(),
+	                       spatials.extent_x.data(), spatials.extent_y.data(), spatials.extent_z.data(),
+	                       count);
+
+	size_t num_words = (count + 31) / 32;
+	for (size_t word = 0; word < num_words; word++)
+	{
+		Util::for_each_bit(visibility[word], [&](uint32_t bit) {
+			list.push_back(spatials.infos[32 * word + bit]);
+		});
 	}
 }
 
@@ -171,17 +500,17 @@ void Scene::gather_visible_render_pass_sinks(const vec3 &camera_pos, VisibilityL
 
 void Scene::gather_visible_opaque_renderables(const Frustum &frustum, VisibilityList &list)
 {
-	gather_visible_renderables(frustum, list, opaque);
+	gather_visible_renderables(frustum, list, front_spatials->opaque);
 }
 
 void Scene::gather_visible_transparent_renderables(const Frustum &frustum, VisibilityList &list)
 {
-	gather_visible_renderables(frustum, list, transparent);
+	gather_visible_renderables(frustum, list, front_spatials->transparent);
 }
 
 void Scene::gather_visible_static_shadow_renderables(const Frustum &frustum, VisibilityList &list)
 {
-	gather_visible_renderables(frustum, list, static_shadowing);
+	gather_visible_renderables(frustum, list, front_spatials->static_shadowing);
 }
 
 void Scene::gather_visible_positional_lights(const Frustum &frustum, VisibilityList &list,
@@ -223,7 +552,7 @@ void Scene::gather_visible_positional_lights(const Frustum &frustum, VisibilityL
 
 void Scene::gather_visible_dynamic_shadow_renderables(const Frustum &frustum, VisibilityList &list)
 {
-	gather_visible_renderables(frustum, list, dynamic_shadowing);
+	gather_visible_renderables(frustum, list, front_spatials->dynamic_shadowing);
 	for (auto &object : render_pass_shadowing)
 		list.push_back({ get_component<RenderableComponent>(object)->renderable.get(), nullptr });
 }
@@ -266,42 +595,183 @@ void Scene::update_skinning(Node &node)
 	}
 }
 
-void Scene::update_transform_tree(Node &node, const mat4 &transform, bool parent_is_dirty)
+void Scene::rebuild_flat_hierarchy(Node &root)
 {
-	bool transform_dirty = node.get_and_clear_transform_dirty() || parent_is_dirty;
-
-	if (transform_dirty)
+	auto &h = flat_hierarchy;
+	h.nodes.clear();
+	h.parent_index.clear();
+	h.skeleton_edge.clear();
+	h.levels.clear();
+
+	h.nodes.push_back(&root);
+	h.parent_index.push_back(~0u);
+	h.skeleton_edge.push_back(0);
+
+	uint32_t level_begin = 0;
+	while (level_begin < uint32_t(h.nodes.size()))
 	{
-		compute_model_transform(node.cached_transform.world_transform,
-		                        node.transform.scale, node.transform.rotation, node.transform.translation, transform);
+		uint32_t level_end = uint32_t(h.nodes.size());
+		h.levels.push_back({ level_begin, level_end });
+
+		for (uint32_t i = level_begin; i < level_end; i++)
+		{
+			auto &node = *h.nodes[i];
+			for (auto &child : node.get_children())
+			{
+				h.nodes.push_back(child.get());
+				h.parent_index.push_back(i);
+				h.skeleton_edge.push_back(0);
+			}
+			for (auto &child : node.get_skeletons())
+			{
+				h.nodes.push_back(child.get());
+				h.parent_index.push_back(i);
+				h.skeleton_edge.push_back(1);
+			}
+		}
+
+		level_begin = level_end;
 	}
 
-	if (node.get_and_clear_child_transform_dirty() || transform_dirty)
+	h.valid = true;
+}
+
+void Scene::update_transform_tree(ThreadGroup *group, Node &root)
+{
+	auto &h = flat_hierarchy;
+	if (!h.valid || h.nodes.empty() || h.nodes.front() != &root)
+		rebuild_flat_hierarchy(root);
+
+	size_t count = h.nodes.size();
+	h.node_visited.resize(count);
+	h.node_dirty.resize(count);
+	h.children_pass.resize(count);
+
+	static const mat4 identity(1.0f);
+	std::vector<Node *> dirty_nodes;
+
+	// Processes one node from the per-frame flags of its parent, which lives in
+	// an earlier BFS level. Subtrees the recursive walk would have pruned are
+	// skipped without touching their dirty bits, so they stay pending exactly
+	// like before. The initial_transform multiply is deferred to a post-pass,
+	// so children always observe the parent's plain model transform here.
+	const auto process = [&h](uint32_t i, std::vector<Node *> &dirty) {
+		uint32_t p = h.parent_index[i];
+		bool visited;
+		bool parent_dirty;
+
+		if (p == ~0u)
+		{
+			visited = true;
+			parent_dirty = false;
+		}
+		else if (!h.node_visited[p])
+		{
+			visited = false;
+			parent_dirty = false;
+		}
+		else if (h.skeleton_edge[i])
+		{
+			// Skeleton subtrees are only walked when the owner moved,
+			// and then always as dirty.
+			visited = h.node_dirty[p] != 0;
+			parent_dirty = true;
+		}
+		else
+		{
+			visited = h.children_pass[p] != 0;
+			parent_dirty = h.node_dirty[p] != 0;
+		}
+
+		h.node_visited[i] = visited;
+		if (!visited)
+		{
+			h.node_dirty[i] = 0;
+			h.children_pass[i] = 0;
+			return;
+		}
+
+		auto &node = *h.nodes[i];
+		bool transform_dirty = node.get_and_clear_transform_dirty() || parent_dirty;
+		h.node_dirty[i] = transform_dirty;
+
+		if (transform_dirty)
+		{
+			const mat4 &parent_transform =
+			    p != ~0u ? h.nodes[p]->cached_transform.world_transform : identity;
+			compute_model_transform(node.cached_transform.world_transform,
+			                        node.transform.scale, node.transform.rotation, node.transform.translation,
+			                        parent_transform);
+			dirty.push_back(&node);
+		}
+
+		h.children_pass[i] = node.get_and_clear_child_transform_dirty() || transform_dirty;
+	};
+
+	// Only worth farming out levels with enough nodes to cover task overhead.
+	const size_t MinNodesPerTask = 256;
+
+	for (auto &level : h.levels)
 	{
-		for (auto &child : node.get_children())
-			update_transform_tree(*child, node.cached_transform.world_transform, transform_dirty);
+		size_t level_count = level.end - level.begin;
+		if (!group || level_count < 2 * MinNodesPerTask)
+		{
+			for (uint32_t i = level.begin; i < level.end; i++)
+				process(i, dirty_nodes);
+		}
+		else
+		{
+			size_t num_chunks = (level_count + MinNodesPerTask - 1) / MinNodesPerTask;
+			std::vector<std::vector<Node *>> chunk_dirty(num_chunks);
+
+			group->parallel_for(level_count, MinNodesPerTask, [&](size_t begin, size_t end) {
+				size_t chunk = begin / MinNodesPerTask;
+				for (size_t i = begin; i < end; i++)
+					process(uint32_t(level.begin + i), chunk_dirty[chunk]);
+			});
+
+			for (auto &chunk : chunk_dirty)
+				dirty_nodes.insert(std::end(dirty_nodes), std::begin(chunk), std::end(chunk));
+		}
 	}
 
-	if (transform_dirty)
-	{
-		for (auto &child : node.get_skeletons())
-			update_transform_tree(*child, node.cached_transform.world_transform, true);
+	// Apply the first transformation in the sequence, this is used for skinning.
+	const auto apply_initial = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			auto &node = *dirty_nodes[i];
+			SIMD::mul(node.cached_transform.world_transform,
+			          node.cached_transform.world_transform,
+			          node.initial_transform);
+		}
+	};
 
-		// Apply the first transformation in the sequence, this is used for skinning.
-		SIMD::mul(node.cached_transform.world_transform,
-		          node.cached_transform.world_transform,
-		          node.initial_transform);
+	// Skinning reads world transforms from the skeleton nodes, so it has to run
+	// after every dirty node has had its initial transform applied.
+	const auto apply_skinning = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			update_skinning(*dirty_nodes[i]);
+			dirty_nodes[i]->update_timestamp();
+		}
+	};
 
-		//compute_normal_transform(node.cached_transform.normal_transform, node.cached_transform.world_transform);
-		update_skinning(node);
-		node.update_timestamp();
+	if (group)
+	{
+		group->parallel_for(dirty_nodes.size(), 1024, apply_initial);
+		group->parallel_for(dirty_nodes.size(), 1024, apply_skinning);
+	}
+	else
+	{
+		apply_initial(0, dirty_nodes.size());
+		apply_skinning(0, dirty_nodes.size());
 	}
 }
 
 void Scene::update_cached_transforms()
 {
 	if (root_node)
-		update_transform_tree(*root_node, mat4(1.0f), false);
+		update_transform_tree(Global::thread_group(), *root_node);
 
 	for (auto &s : spatials)
 	{
@@ -332,6 +802,11 @@ void Scene::update_cached_transforms()
 		}
 	}
 
+	update_cached_spatial_list(back_spatials->opaque, opaque, transform_snapshotting);
+	update_cached_spatial_list(back_spatials->transparent, transparent, transform_snapshotting);
+	update_cached_spatial_list(back_spatials->static_shadowing, static_shadowing, transform_snapshotting);
+	update_cached_spatial_list(back_spatials->dynamic_shadowing, dynamic_shadowing, transform_snapshotting);
+
 	// Update camera transforms.
 	for (auto &c : cameras)
 	{
@@ -353,6 +828,31 @@ void Scene::update_cached_transforms()
 	}
 }
 
+void Scene::set_transform_snapshotting(bool enable)
+{
+	if (transform_snapshotting == enable)
+		return;
+	transform_snapshotting = enable;
+
+	if (enable)
+	{
+		// The front keeps serving the last published lists until the first
+		// publish; the next update fills the other set.
+		back_spatials = front_spatials == &spatial_lists[0] ? &spatial_lists[1] : &spatial_lists[0];
+	}
+	else
+	{
+		// Collapse back to single-buffered operation; the next update rebuilds
+		// the front set in place without the snapshot copies.
+		back_spatials = front_spatials;
+	}
+}
+
+void Scene::publish_transform_snapshot()
+{
+	std::swap(front_spatials, back_spatials);
+}
+
 Scene::NodeHandle Scene::create_node()
 {
 	return Scene::NodeHandle(node_pool.allocate(this));
@@ -419,6 +919,7 @@ void Scene::Node::add_child(NodeHandle node)
 	node->cached_transform_dirty = false;
 	node->invalidate_cached_transform();
 	children.push_back(node);
+	parent_scene->flat_hierarchy.valid = false;
 }
 
 Scene::NodeHandle Scene::Node::remove_child(Node *node)
@@ -436,6 +937,7 @@ Scene::NodeHandle Scene::Node::remove_child(Node *node)
 	});
 	assert(itr != end(children));
 	children.erase(itr, end(children));
+	parent_scene->flat_hierarchy.valid = false;
 	return handle;
 }
 
@@ -37,6 +37,7 @@ struct RenderableInfo
 using VisibilityList = std::vector<RenderableInfo>;
 
 class RenderContext;
+class ThreadGroup;
 struct EnvironmentComponent;
 
 class Scene
@@ -51,6 +52,19 @@ public:
 
 	void refresh_per_frame(RenderContext &context);
 	void update_cached_transforms();
+
+	// Snapshot isolation between update_cached_transforms() and the
+	// gather_visible_* queries, for pipelining simulation against rendering.
+	// While enabled, the spatial lists are double buffered and every transform
+	// the queries hand out points into a copy owned by the list rather than
+	// into live node state, so the render thread can keep culling and
+	// recording frame N while the simulation thread rewrites transforms for
+	// frame N + 1. update_cached_transforms() fills the back buffer;
+	// publish_transform_snapshot() flips it into view with a pointer swap and
+	// must be called at the frame sync point where the render thread is not
+	// reading. That sync point is the only synchronization the scheme needs.
+	void set_transform_snapshotting(bool enable);
+	void publish_transform_snapshot();
 	void gather_visible_opaque_renderables(const Frustum &frustum, VisibilityList &list);
 	void gather_visible_transparent_renderables(const Frustum &frustum, VisibilityList &list);
 	void gather_visible_static_shadow_renderables(const Frustum &frustum, VisibilityList &list);
@@ -177,6 +191,7 @@ public:
 	void set_root_node(NodeHandle node)
 	{
 		root_node = std::move(node);
+		flat_hierarchy.valid = false;
 	}
 
 	NodeHandle get_root_node() const
@@ -200,6 +215,49 @@ public:
 	void remove_entities_with_component(ComponentType id);
 
 private:
+	// Packed SoA mirror of the world AABBs for a renderable group, rebuilt in
+	// update_cached_transforms(), so the visibility walk batch-culls contiguous
+	// arrays and only dereferences the renderable handle for survivors.
+	struct CachedSpatialList
+	{
+		std::vector<float> center_x, center_y, center_z;
+		std::vector<float> extent_x, extent_y, extent_z;
+		std::vector<RenderableInfo> infos;
+		std::vector<RenderableInfo> always_visible;
+		std::vector<uint32_t> visibility;
+
+		// Binary BVH over the boxes above. Topology is rebuilt when the box count
+		// changes and only refitted otherwise, so movables just update bounds.
+		// Leaves reference ranges of bvh_order, count == 0 marks an interior node.
+		struct BVHNode
+		{
+			AABB bounds;
+			uint32_t children[2];
+			uint32_t first;
+			uint32_t count;
+		};
+		std::vector<BVHNode> bvh_nodes;
+		std::vector<uint32_t> bvh_order;
+
+		// Morton-order permutation applied to the arrays above so spatially
+		// adjacent boxes sit next to each other in memory and in draw order.
+		// The sort key is only recomputed periodically; a stale permutation of
+		// matching count is still valid, just less coherent.
+		std::vector<uint32_t> morton_order;
+		std::vector<uint32_t> morton_codes;
+		std::vector<float> morton_scratch;
+		std::vector<RenderableInfo> morton_scratch_infos;
+		uint32_t morton_countdown = 0;
+
+		// Snapshot mode storage. The RenderableInfo entries above point into
+		// these copies instead of the live components, so draw recording never
+		// observes a transform the simulation thread is halfway through
+		// writing. Unused (and unpaid for) outside snapshot mode.
+		std::vector<RenderInfoComponent> info_snapshot;
+		std::vector<CachedTransform> transform_snapshot;
+		std::vector<CachedSkinTransform> skin_snapshot;
+	};
+
 	EntityPool pool;
 	Util::ObjectPool<Node> node_pool;
 	NodeHandle root_node;
@@ -222,7 +280,58 @@ private:
 	Util::IntrusiveList<Entity> entities;
 	Util::IntrusiveList<Entity> queued_entities;
 	void destroy_entities(Util::IntrusiveList<Entity> &entity_list);
-	void update_transform_tree(Node &node, const mat4 &transform, bool parent_is_dirty);
+
+	// Flat BFS mirror of the node hierarchy. Nodes keep their handles; the
+	// mirror stores raw pointers plus parent indices and per-level ranges and
+	// is only rebuilt when the topology changes (add_child/remove_child/
+	// set_root_node invalidate it), so the per-frame transform walk is a
+	// linear scan over arrays instead of a pointer chase through per-node
+	// child vectors.
+	struct FlatHierarchy
+	{
+		std::vector<Node *> nodes;
+		std::vector<uint32_t> parent_index;
+		std::vector<uint8_t> skeleton_edge;
+
+		struct Level
+		{
+			uint32_t begin;
+			uint32_t end;
+		};
+		std::vector<Level> levels;
+
+		// Per-frame traversal flags, kept here to reuse the allocations.
+		std::vector<uint8_t> node_visited;
+		std::vector<uint8_t> node_dirty;
+		std::vector<uint8_t> children_pass;
+
+		bool valid = false;
+	};
+	FlatHierarchy flat_hierarchy;
+
+	void rebuild_flat_hierarchy(Node &root);
+	void update_transform_tree(ThreadGroup *group, Node &root);
+
+	struct SpatialLists
+	{
+		CachedSpatialList opaque;
+		CachedSpatialList transparent;
+		CachedSpatialList static_shadowing;
+		CachedSpatialList dynamic_shadowing;
+	};
+	// Both pointers reference the same set outside snapshot mode, so the
+	// single-threaded flow pays neither copies nor a second set of lists.
+	SpatialLists spatial_lists[2];
+	SpatialLists *front_spatials = &spatial_lists[0];
+	SpatialLists *back_spatials = &spatial_lists[0];
+	bool transform_snapshotting = false;
+
+	template <typename T>
+	static void update_cached_spatial_list(CachedSpatialList &spatials, const T &objects, bool snapshot);
+	static void update_spatial_bvh(CachedSpatialList &spatials);
+	static void update_spatial_morton_order(CachedSpatialList &spatials);
+	static void gather_visible_renderables(const Frustum &frustum, VisibilityList &list,
+	                                       CachedSpatialList &spatials);
 
 	void update_skinning(Node &node);
 };
@@ -51,6 +51,31 @@ AnimationSystem &SceneLoader::get_animation_system()
 	return *animation_system;
 }
 
+AbstractRenderableHandle SceneLoader::create_mesh_renderable(const SceneFormats::Mesh &mesh,
+                                                             const SceneFormats::MaterialInfo *materials)
+{
+	// Skinned meshes are driven by per-node palettes and never merge into
+	// instanced draws, so there is nothing to gain from sharing them.
+	bool skinned = mesh.attribute_layout[ecast(MeshAttribute::BoneIndex)].format != VK_FORMAT_UNDEFINED;
+	if (skinned)
+		return create_imported_mesh(mesh, materials);
+
+	Hasher h;
+	h.u64(SceneFormats::mesh_content_hash(mesh));
+	if (mesh.has_material)
+		h.u64(SceneFormats::material_info_hash(materials[mesh.material_index]));
+	else
+		h.u32(0);
+
+	auto itr = mesh_dedup.find(h.get());
+	if (itr != end(mesh_dedup))
+		return itr->second;
+
+	auto renderable = create_imported_mesh(mesh, materials);
+	mesh_dedup[h.get()] = renderable;
+	return renderable;
+}
+
 Scene::NodeHandle SceneLoader::load_scene_to_root_node(const std::string &path)
 {
 	auto ext = Path::ext(path);
@@ -269,8 +294,14 @@ Scene::NodeHandle SceneLoader::parse_gltf(const std::string &path)
 	subscene.parser = make_unique<GLTF::Parser>(path);
 
 	for (auto &mesh : subscene.parser->get_meshes())
-		subscene.meshes.push_back(create_imported_mesh(mesh, subscene.parser->get_materials().data()));
+		subscene.meshes.push_back(create_mesh_renderable(mesh, subscene.parser->get_materials().data()));
 
+	apply_environment(subscene);
+	return build_tree_for_subscene(subscene);
+}
+
+void SceneLoader::apply_environment(const SubsceneData &subscene)
+{
 	if (!subscene.parser->get_environments().empty())
 	{
 		auto &env = subscene.parser->get_environments().front();
@@ -306,8 +337,102 @@ Scene::NodeHandle SceneLoader::parse_gltf(const std::string &path)
 			entity->allocate_component<EnvironmentComponent>()->fog = params;
 		}
 	}
+}
 
-	return build_tree_for_subscene(subscene);
+void SceneLoader::attach_to_scene(Scene::NodeHandle node)
+{
+	auto root = scene->get_root_node();
+	if (root)
+		root->add_child(move(node));
+	else
+		scene->set_root_node(move(node));
+}
+
+void SceneLoader::load_scene_async(const std::string &path)
+{
+	if (async_load)
+	{
+		LOGE("An async scene load is already in flight, draining it first.\n");
+		while (poll_async())
+		{
+		}
+	}
+
+	async_load = make_unique<AsyncLoad>();
+	async_load->path = path;
+	async_load->parse_complete = false;
+
+	auto ext = Path::ext(path);
+	auto *group = Global::thread_group();
+
+	// The JSON scene description interleaves parsing with scene mutation,
+	// so it cannot run off-thread; degrade to a blocking load on first poll.
+	if ((ext != "gltf" && ext != "glb") || !group)
+	{
+		async_load->fallback_sync = true;
+		return;
+	}
+
+	auto *load = async_load.get();
+	async_load->parse_task = group->create_task([load]() {
+		// Pure CPU work; nothing shared is touched until the polling thread
+		// observes parse_complete.
+		load->subscene.parser = make_unique<GLTF::Parser>(load->path);
+		load->parse_complete.store(true, memory_order_release);
+	});
+	async_load->parse_task->flush();
+}
+
+bool SceneLoader::poll_async()
+{
+	if (!async_load)
+		return false;
+
+	if (async_load->fallback_sync)
+	{
+		auto path = async_load->path;
+		async_load.reset();
+		attach_to_scene(load_scene_to_root_node(path));
+		if (auto *em = Global::event_manager())
+			em->dispatch_inline(SceneLoadProgressEvent{path, 1, 1});
+		return false;
+	}
+
+	if (!async_load->parse_complete.load(memory_order_acquire))
+		return true;
+
+	// Renderable creation allocates GPU buffers, so bound the work per poll.
+	// The actual uploads ride the normal ImportedMesh paths.
+	enum { MeshesPerPoll = 16 };
+	auto &subscene = async_load->subscene;
+	auto &parser = *subscene.parser;
+	auto num_meshes = unsigned(parser.get_meshes().size());
+
+	unsigned end_mesh = std::min(num_meshes, async_load->next_mesh + unsigned(MeshesPerPoll));
+	for (; async_load->next_mesh < end_mesh; async_load->next_mesh++)
+	{
+		subscene.meshes.push_back(create_mesh_renderable(parser.get_meshes()[async_load->next_mesh],
+		                                                 parser.get_materials().data()));
+	}
+
+	// The final step builds and attaches the node hierarchy.
+	if (async_load->next_mesh < num_meshes)
+	{
+		if (auto *em = Global::event_manager())
+			em->dispatch_inline(SceneLoadProgressEvent{async_load->path, async_load->next_mesh, num_meshes + 1});
+		return true;
+	}
+
+	apply_environment(subscene);
+	attach_to_scene(build_tree_for_subscene(subscene));
+
+	async_load->parse_task->wait();
+	auto path = move(async_load->path);
+	async_load.reset();
+
+	if (auto *em = Global::event_manager())
+		em->dispatch_inline(SceneLoadProgressEvent{path, num_meshes + 1, num_meshes + 1});
+	return false;
 }
 
 Scene::NodeHandle SceneLoader::parse_scene_format(const std::string &path, const std::string &json)
@@ -327,32 +452,7 @@ Scene::NodeHandle SceneLoader::parse_scene_format(const std::string &path, const
 		auto &parser = *subscene.parser;
 
 		for (auto &mesh : parser.get_meshes())
-		{
-			SceneFormats::MaterialInfo default_material;
-			default_material.uniform_base_color = vec4(0.3f, 1.0f, 0.3f, 1.0f);
-			default_material.uniform_metallic = 0.0f;
-			default_material.uniform_roughness = 1.0f;
-			AbstractRenderableHandle renderable;
-
-			bool skinned = mesh.attribute_layout[ecast(MeshAttribute::BoneIndex)].format != VK_FORMAT_UNDEFINED;
-			if (skinned)
-			{
-				if (mesh.has_material)
-					renderable = Util::make_handle<ImportedSkinnedMesh>(mesh,
-					                                                    parser.get_materials()[mesh.material_index]);
-				else
-					renderable = Util::make_handle<ImportedSkinnedMesh>(mesh, default_material);
-			}
-			else
-			{
-				if (mesh.has_material)
-					renderable = Util::make_handle<ImportedMesh>(mesh,
-					                                             parser.get_materials()[mesh.material_index]);
-				else
-					renderable = Util::make_handle<ImportedMesh>(mesh, default_material);
-			}
-			subscene.meshes.push_back(renderable);
-		}
+			subscene.meshes.push_back(create_mesh_renderable(mesh, parser.get_materials().data()));
 	}
 
 	vector<Scene::NodeHandle> hierarchy;
@@ -25,11 +25,46 @@
 #include "scene.hpp"
 #include "gltf.hpp"
 #include "animation_system.hpp"
+#include "event.hpp"
+#include "thread_group.hpp"
+#include <atomic>
 #include <memory>
 #include <string>
 
 namespace Granite
 {
+// Fired on the polling thread while an async scene load makes progress.
+// completed == total signals that the subtree has been attached to the scene.
+class SceneLoadProgressEvent : public Event
+{
+public:
+	GRANITE_EVENT_TYPE_DECL(SceneLoadProgressEvent)
+	SceneLoadProgressEvent(std::string path_, unsigned completed_, unsigned total_)
+		: path(std::move(path_)), completed(completed_), total(total_)
+	{
+	}
+
+	const std::string &get_path() const
+	{
+		return path;
+	}
+
+	unsigned get_completed() const
+	{
+		return completed;
+	}
+
+	unsigned get_total() const
+	{
+		return total;
+	}
+
+private:
+	std::string path;
+	unsigned completed;
+	unsigned total;
+};
+
 class SceneLoader
 {
 public:
@@ -42,6 +77,24 @@ public:
 	// You must insert the node manually into the scene as appropriate.
 	Scene::NodeHandle load_scene_to_root_node(const std::string &path);
 
+	// Starts loading a GLTF/GLB subscene without blocking the caller.
+	// Parsing runs on the thread group workers; call poll_async() once per
+	// frame from the update thread. Each poll integrates a bounded slice of
+	// renderable creation and finally attaches the subtree under the scene's
+	// root node (or sets it as root when none exists), so a sector load
+	// amortizes over several frames instead of stalling one.
+	// A SceneLoadProgressEvent is dispatched inline per poll with work done.
+	// Non-GLTF scene descriptions fall back to a blocking load on first poll.
+	void load_scene_async(const std::string &path);
+
+	// Returns true while async work remains.
+	bool poll_async();
+
+	bool is_loading_async() const
+	{
+		return bool(async_load);
+	}
+
 	Scene &get_scene()
 	{
 		return *scene;
@@ -65,5 +118,27 @@ private:
 
 	Scene::NodeHandle build_tree_for_subscene(const SubsceneData &subscene);
 	void load_animation(const std::string &path, SceneFormats::Animation &animation);
+
+	// Content-addressed cache for imported static meshes. Exporters routinely
+	// bake one copy of the mesh data per node, so identical props arrive as
+	// distinct mesh entries; collapsing them onto one shared renderable gives
+	// every copy the same instance key, and the RenderQueue then folds the
+	// copies into instanced draws instead of one draw per node.
+	AbstractRenderableHandle create_mesh_renderable(const SceneFormats::Mesh &mesh,
+	                                                const SceneFormats::MaterialInfo *materials);
+	std::unordered_map<Util::Hash, AbstractRenderableHandle> mesh_dedup;
+	void apply_environment(const SubsceneData &subscene);
+	void attach_to_scene(Scene::NodeHandle node);
+
+	struct AsyncLoad
+	{
+		std::string path;
+		SubsceneData subscene;
+		TaskGroup parse_task;
+		std::atomic<bool> parse_complete;
+		unsigned next_mesh = 0;
+		bool fallback_sync = false;
+	};
+	std::unique_ptr<AsyncLoad> async_load;
 };
 }
\ No newline at end of file
@@ -23,6 +23,8 @@
 #include "shader_suite.hpp"
 #include "device.hpp"
 #include "string_helpers.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
 
 using namespace std;
 using namespace Util;
@@ -37,6 +39,7 @@ void ShaderSuite::init_graphics(ShaderManager *manager_, const std::string &vert
 	program = manager->register_graphics(vertex, fragment);
 	variants.clear();
 	base_defines.clear();
+	generation++;
 }
 
 void ShaderSuite::init_compute(Vulkan::ShaderManager *manager_, const std::string &compute)
@@ -45,6 +48,7 @@ void ShaderSuite::init_compute(Vulkan::ShaderManager *manager_, const std::strin
 	program = manager->register_compute(compute);
 	variants.clear();
 	base_defines.clear();
+	generation++;
 }
 
 void ShaderSuite::bake_base_defines()
@@ -56,6 +60,30 @@ void ShaderSuite::bake_base_defines()
 		h.s32(define.second);
 	}
 	base_define_hash = h.get();
+
+	// The base defines are not part of the packed per-variant keys, so the
+	// variant map is only valid for one baked set of them.
+	variants.clear();
+	generation++;
+}
+
+void ShaderSuite::precompile()
+{
+	if (!program)
+		return;
+
+	unsigned count = program->get_variant_count();
+	if (!count)
+		return;
+
+	auto task = Global::thread_group()->create_task();
+	for (unsigned i = 0; i < count; i++)
+	{
+		task->enqueue_task([this, i]() {
+			program->get_program(i);
+		});
+	}
+	task->flush();
 }
 
 Vulkan::Program *ShaderSuite::get_program(DrawPipeline pipeline, uint32_t attribute_mask,
@@ -67,15 +95,19 @@ Vulkan::Program *ShaderSuite::get_program(DrawPipeline pipeline, uint32_t attrib
 		return nullptr;
 	}
 
-	Hasher h;
 	assert(base_define_hash != 0);
-	h.u64(base_define_hash);
-	h.u32(pipeline == DrawPipeline::AlphaTest);
-	h.u32(attribute_mask);
-	h.u32(texture_mask);
-	h.u32(variant_id);
 
-	auto hash = h.get();
+	// Bitfield-packed variant key instead of a hash chain; this lookup runs
+	// per material per pass, so it has to be as close to a plain map find as
+	// possible. The masks sit far below these widths today; asserts keep a
+	// future bit from silently aliasing a neighbouring field.
+	assert(attribute_mask < (1u << 15));
+	assert(texture_mask < (1u << 16));
+	Hash hash = uint64_t(pipeline == DrawPipeline::AlphaTest) |
+	            (uint64_t(attribute_mask) << 1) |
+	            (uint64_t(texture_mask) << 16) |
+	            (uint64_t(variant_id) << 32);
+
 	auto *variant = variants.find(hash);
 	if (!variant)
 	{
@@ -42,8 +42,21 @@ public:
 
 	void bake_base_defines();
 
+	// Warms the pipeline cache for all registered variants on worker threads.
+	// Useful during loading screens so first use of a material does not hitch.
+	void precompile();
+
+	// Bumps whenever the suite rebakes (init or base define change), so
+	// renderables can validate cached Program pointers resolved from this
+	// suite with one integer compare.
+	uint32_t get_generation() const
+	{
+		return generation;
+	}
+
 private:
 	Util::Hash base_define_hash = 0;
+	uint32_t generation = 0;
 	Vulkan::ShaderManager *manager = nullptr;
 	Vulkan::ShaderProgram *program = nullptr;
 	Util::ThreadSafeIntrusiveHashMap<Util::IntrusivePODWrapper<unsigned>> variants;
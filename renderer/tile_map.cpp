@@ -0,0 +1,273 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tile_map.hpp"
+#include "sprite.hpp"
+#include "command_buffer_util.hpp"
+#include "enum_cast.hpp"
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+using namespace Util;
+
+namespace Granite
+{
+TileMap::TileMap(const TMXParser &parser, unsigned chunk_tiles_)
+	: tile_size(parser.get_tile_size()), chunk_tiles(chunk_tiles_)
+{
+	// The merged tilemap array is the only pixel data we need to keep
+	// around; everything else compacts to one word per non-empty tile.
+	auto &src_layout = parser.get_tilemap_image_layout();
+	tilemap_pixels.resize(src_layout.get_required_size());
+	memcpy(tilemap_pixels.data(), src_layout.data(), tilemap_pixels.size());
+	tilemap_layout.set_2d(src_layout.get_format(), src_layout.get_width(), src_layout.get_height(),
+	                      src_layout.get_layers());
+	tilemap_layout.set_buffer(tilemap_pixels.data(), tilemap_pixels.size());
+
+	auto &tiles = parser.get_tiles();
+	auto &layers = parser.get_layers();
+	float num_layers = float(layers.size());
+
+	unsigned layer_index = 0;
+	for (auto &layer : layers)
+	{
+		if (!layer.visible)
+		{
+			layer_index++;
+			continue;
+		}
+
+		unsigned chunks_x = (layer.size.x + chunk_tiles - 1) / chunk_tiles;
+		unsigned chunks_y = (layer.size.y + chunk_tiles - 1) / chunk_tiles;
+		size_t chunk_base = chunks.size();
+		chunks.resize(chunk_base + chunks_x * chunks_y);
+
+		for (unsigned cy = 0; cy < chunks_y; cy++)
+		{
+			for (unsigned cx = 0; cx < chunks_x; cx++)
+			{
+				auto &chunk = chunks[chunk_base + cy * chunks_x + cx];
+				chunk.world_min = vec2(layer.offset) + vec2(uvec2(cx, cy) * tile_size * chunk_tiles);
+				chunk.world_max = chunk.world_min + vec2(tile_size * chunk_tiles);
+				// Lower Tiled layers draw first and sit further away.
+				chunk.depth = num_layers - float(layer_index);
+				for (unsigned c = 0; c < 3; c++)
+					chunk.color[c] = 0xff;
+				chunk.color[3] = uint8_t(clamp(layer.opacity, 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+
+		for (unsigned y = 0; y < layer.size.y; y++)
+		{
+			for (unsigned x = 0; x < layer.size.x; x++)
+			{
+				int index = layer.tile_indices[y * layer.size.x + x];
+				if (index < 0)
+					continue;
+
+				auto &chunk = chunks[chunk_base + (y / chunk_tiles) * chunks_x + (x / chunk_tiles)];
+				auto pipeline = tiles[index].pipeline;
+				// Layer opacity forces blending no matter what the tile says.
+				if (chunk.color[3] != 0xff)
+					pipeline = DrawPipeline::AlphaBlend;
+
+				chunk.entries[ecast(pipeline)].push_back(
+						(x % chunk_tiles) | ((y % chunk_tiles) << 6u) | (uint32_t(index) << 12u));
+			}
+		}
+
+		layer_index++;
+	}
+
+	// Drop fully empty chunks, holes in huge maps are common.
+	auto itr = remove_if(begin(chunks), end(chunks), [](const Chunk &chunk) {
+		return chunk.entries[0].empty() && chunk.entries[1].empty() && chunk.entries[2].empty();
+	});
+	chunks.erase(itr, end(chunks));
+
+	EVENT_MANAGER_REGISTER_LATCH(TileMap, on_device_created, on_device_destroyed, Vulkan::DeviceCreatedEvent);
+}
+
+void TileMap::on_device_created(const Vulkan::DeviceCreatedEvent &e)
+{
+	device = &e.get_device();
+	auto staging = device->create_image_staging_buffer(tilemap_layout);
+	auto info = Vulkan::ImageCreateInfo::immutable_image(tilemap_layout);
+	tilemap = device->create_image_from_staging_buffer(info, &staging);
+}
+
+void TileMap::on_device_destroyed(const Vulkan::DeviceCreatedEvent &)
+{
+	tilemap.reset();
+	for (auto &chunk : chunks)
+	{
+		chunk.instances.reset();
+		chunk.idle_frames = 0;
+	}
+	device = nullptr;
+}
+
+void TileMap::upload_chunk(Chunk &chunk)
+{
+	size_t total = chunk.entries[0].size() + chunk.entries[1].size() + chunk.entries[2].size();
+	vector<QuadData> quads;
+	quads.reserve(total);
+
+	for (unsigned p = 0; p < 3; p++)
+	{
+		chunk.offsets[p] = uint32_t(quads.size());
+		for (auto entry : chunk.entries[p])
+		{
+			unsigned local_x = entry & 63u;
+			unsigned local_y = (entry >> 6u) & 63u;
+			unsigned tile = entry >> 12u;
+
+			QuadData quad = {};
+			quad.pos_off_x = chunk.world_min.x + float(local_x * tile_size.x);
+			quad.pos_off_y = chunk.world_min.y + float(local_y * tile_size.y);
+			quad.pos_scale_x = float(tile_size.x);
+			quad.pos_scale_y = float(tile_size.y);
+			quad.tex_off_x = 0.0f;
+			quad.tex_off_y = 0.0f;
+			quad.tex_scale_x = float(tile_size.x);
+			quad.tex_scale_y = float(tile_size.y);
+			quad.rotation[0] = 1.0f;
+			quad.rotation[1] = 0.0f;
+			quad.rotation[2] = 0.0f;
+			quad.rotation[3] = 1.0f;
+			for (unsigned c = 0; c < 4; c++)
+				quad.color[c] = chunk.color[c];
+			quad.layer = chunk.depth;
+			quad.array_layer = float(tile);
+			quads.push_back(quad);
+		}
+		chunk.counts[p] = uint32_t(quads.size()) - chunk.offsets[p];
+	}
+
+	Vulkan::BufferCreateInfo info = {};
+	info.domain = Vulkan::BufferDomain::Device;
+	info.size = quads.size() * sizeof(QuadData);
+	info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	chunk.instances = device->create_buffer(info, quads.data());
+}
+
+void TileMap::render(Vulkan::CommandBuffer &cmd, const vec3 &camera_pos, const vec3 &camera_size)
+{
+	if (!device || !tilemap)
+		return;
+
+	vec2 view_min = camera_pos.xy();
+	vec2 view_max = view_min + camera_size.xy();
+
+	// Same camera interface as FlatRenderer::flush.
+	struct GlobalData
+	{
+		float inv_resolution[4];
+		float pos_offset_pixels[4];
+	};
+	auto *global = static_cast<GlobalData *>(cmd.allocate_constant_data(0, 0, sizeof(GlobalData)));
+	global->inv_resolution[0] = 1.0f / camera_size.x;
+	global->inv_resolution[1] = 1.0f / camera_size.y;
+	global->inv_resolution[2] = 1.0f / camera_size.z;
+	global->inv_resolution[3] = 0.0f;
+	global->pos_offset_pixels[0] = -camera_pos.x;
+	global->pos_offset_pixels[1] = -camera_pos.y;
+	global->pos_offset_pixels[2] = -camera_pos.z;
+	global->pos_offset_pixels[3] = 0.0f;
+
+	struct TexGlobals
+	{
+		alignas(8) vec2 resolution;
+		alignas(8) vec2 inv_resolution;
+	} tex_globals;
+	tex_globals.resolution = vec2(tilemap->get_width(), tilemap->get_height());
+	tex_globals.inv_resolution = 1.0f / tex_globals.resolution;
+	*cmd.allocate_typed_constant_data<TexGlobals>(3, 0, 1) = tex_globals;
+
+	cmd.set_texture(2, 0, tilemap->get_view(), Vulkan::StockSampler::NearestWrap);
+
+	static const std::vector<std::pair<std::string, int>> base_defines = {
+		{ "HAVE_UV", 1 },
+		{ "HAVE_VERTEX_COLOR", 1 },
+		{ "HAVE_BASECOLORMAP", 1 },
+		{ "VARIANT_BIT_5", 1 },
+	};
+	static const std::vector<std::pair<std::string, int>> alpha_test_defines = {
+		{ "HAVE_UV", 1 },
+		{ "HAVE_VERTEX_COLOR", 1 },
+		{ "HAVE_BASECOLORMAP", 1 },
+		{ "VARIANT_BIT_5", 1 },
+		{ "ALPHA_TEST", 1 },
+	};
+
+	// Chunks were emitted bottom layer first and stay in that order, so a
+	// straight walk keeps blending correct without any depth buffer.
+	for (auto &chunk : chunks)
+	{
+		bool visible = chunk.world_min.x < view_max.x && chunk.world_max.x > view_min.x &&
+		               chunk.world_min.y < view_max.y && chunk.world_max.y > view_min.y;
+
+		if (!visible)
+		{
+			// Keep recently seen chunks warm so scrolling back and forth
+			// does not thrash uploads.
+			if (chunk.instances && ++chunk.idle_frames >= eviction_delay)
+				chunk.instances.reset();
+			continue;
+		}
+
+		chunk.idle_frames = 0;
+		if (!chunk.instances)
+			upload_chunk(chunk);
+
+		cmd.set_vertex_binding(1, *chunk.instances, 0, sizeof(QuadData), VK_VERTEX_INPUT_RATE_INSTANCE);
+		Vulkan::CommandBufferUtil::set_quad_vertex_state(cmd);
+		cmd.set_vertex_attrib(1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(QuadData, pos_off_x));
+		cmd.set_vertex_attrib(2, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(QuadData, tex_off_x));
+		cmd.set_vertex_attrib(3, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(QuadData, rotation));
+		cmd.set_vertex_attrib(4, 1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(QuadData, color));
+		cmd.set_vertex_attrib(5, 1, VK_FORMAT_R32_SFLOAT, offsetof(QuadData, layer));
+		cmd.set_vertex_attrib(7, 1, VK_FORMAT_R32_SFLOAT, offsetof(QuadData, array_layer));
+
+		for (unsigned p = 0; p < 3; p++)
+		{
+			if (!chunk.counts[p])
+				continue;
+
+			auto pipeline = static_cast<DrawPipeline>(p);
+			if (pipeline == DrawPipeline::AlphaBlend)
+			{
+				cmd.set_transparent_sprite_state();
+				cmd.set_blend_factors(VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA);
+				cmd.set_blend_op(VK_BLEND_OP_ADD);
+			}
+			else
+				cmd.set_opaque_sprite_state();
+
+			cmd.set_program("builtin://shaders/sprite.vert", "builtin://shaders/sprite.frag",
+			                pipeline == DrawPipeline::AlphaTest ? alpha_test_defines : base_defines);
+			cmd.draw(4, chunk.counts[p], 0, chunk.offsets[p]);
+		}
+	}
+}
+}
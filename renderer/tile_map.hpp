@@ -0,0 +1,87 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "tmx_parser.hpp"
+#include "event.hpp"
+#include "device.hpp"
+#include "math.hpp"
+#include <vector>
+
+namespace Granite
+{
+// Streams a Tiled map to the GPU in fixed-size chunks. The parser output is
+// compacted to one packed word per non-empty tile at load; a chunk only
+// expands to sprite instance data when it scrolls into view, the resulting
+// vertex buffer is cached across frames, and chunks which stay off screen
+// long enough release their buffer again. Every tile samples the merged
+// tilemap array texture, so a resident chunk costs one instanced draw per
+// draw pipeline it uses. Huge maps (512x512 with many layers) otherwise pay
+// both full expansion RAM and a per-frame instance rebuild.
+class TileMap : public EventHandler
+{
+public:
+	explicit TileMap(const TMXParser &parser, unsigned chunk_tiles = 32);
+
+	// Draws all visible layers, bottom layer first. camera_pos/camera_size
+	// follow FlatRenderer::flush, i.e. the view rect in pixels.
+	void render(Vulkan::CommandBuffer &cmd, const vec3 &camera_pos, const vec3 &camera_size);
+
+	// Frames a chunk must stay off screen before its buffer is released.
+	void set_eviction_delay(unsigned frames)
+	{
+		eviction_delay = frames;
+	}
+
+private:
+	struct Chunk
+	{
+		// local_x | local_y << 6 | tile << 12, split per DrawPipeline.
+		std::vector<uint32_t> entries[3];
+		vec2 world_min;
+		vec2 world_max;
+		float depth;
+		uint8_t color[4];
+
+		Vulkan::BufferHandle instances;
+		uint32_t counts[3] = {};
+		uint32_t offsets[3] = {};
+		unsigned idle_frames = 0;
+	};
+
+	Vulkan::Device *device = nullptr;
+	Vulkan::ImageHandle tilemap;
+
+	std::vector<Chunk> chunks;
+	std::vector<uint8_t> tilemap_pixels;
+	Vulkan::TextureFormatLayout tilemap_layout;
+
+	uvec2 tile_size;
+	unsigned chunk_tiles;
+	unsigned eviction_delay = 60;
+
+	void upload_chunk(Chunk &chunk);
+	void on_device_created(const Vulkan::DeviceCreatedEvent &e);
+	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
+};
+}
@@ -28,7 +28,13 @@
 #include "muglm/matrix_helper.hpp"
 #include "muglm/muglm_impl.hpp"
 #include "memory_mapped_texture.hpp"
+#include "filesystem.hpp"
+#include "path.hpp"
+#include "global_managers.hpp"
+#include "stb_image_write.h"
+#include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 using namespace Vulkan;
 
@@ -307,4 +313,110 @@ bool save_image_buffer_to_gtx(Vulkan::Device &device, ImageReadback &readback, c
 
 	return true;
 }
+
+static bool write_image_payload_to_gtx(const ImageCreateInfo &info, const TextureFormatLayout &layout,
+                                       const void *mapped, const std::string &path)
+{
+	SceneFormats::MemoryMappedTexture tex;
+
+	if (info.levels == 1)
+		tex.set_generate_mipmaps_on_load();
+
+	switch (info.type)
+	{
+	case VK_IMAGE_TYPE_1D:
+		tex.set_1d(info.format, info.width, info.layers, info.levels);
+		break;
+
+	case VK_IMAGE_TYPE_2D:
+		if (info.flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
+			tex.set_cube(info.format, info.width, info.layers / 6, info.levels);
+		else
+			tex.set_2d(info.format, info.width, info.height, info.layers, info.levels);
+		break;
+
+	case VK_IMAGE_TYPE_3D:
+		tex.set_3d(info.format, info.width, info.height, info.depth, info.levels);
+		break;
+
+	default:
+		return false;
+	}
+
+	if (!tex.map_write(path))
+		return false;
+
+	memcpy(tex.get_layout().data(), mapped, layout.get_required_size());
+	return true;
+}
+
+static bool write_image_payload_to_png(const ImageCreateInfo &info, const void *mapped, const std::string &path)
+{
+	bool swap_red_blue;
+	switch (info.format)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+	case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+		swap_red_blue = false;
+		break;
+
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		swap_red_blue = true;
+		break;
+
+	default:
+		LOGE("PNG capture needs an 8-bit RGBA/BGRA format (format: %u).\n", unsigned(info.format));
+		return false;
+	}
+
+	// Mip 0 / layer 0 sits at the start of the payload, tightly packed.
+	auto *src = static_cast<const uint8_t *>(mapped);
+	std::vector<uint8_t> swizzled;
+	if (swap_red_blue)
+	{
+		swizzled.resize(size_t(info.width) * info.height * 4);
+		for (size_t i = 0, n = swizzled.size(); i < n; i += 4)
+		{
+			swizzled[i + 0] = src[i + 2];
+			swizzled[i + 1] = src[i + 1];
+			swizzled[i + 2] = src[i + 0];
+			swizzled[i + 3] = src[i + 3];
+		}
+		src = swizzled.data();
+	}
+
+	int encoded_size = 0;
+	unsigned char *encoded = stbi_write_png_to_mem(src, int(info.width * 4),
+	                                               int(info.width), int(info.height), 4, &encoded_size);
+	if (!encoded)
+		return false;
+
+	bool ret = Global::filesystem()->write_buffer_to_file(path, encoded, size_t(encoded_size));
+	free(encoded);
+	return ret;
+}
+
+void save_image_async(ReadbackRing &ring, const Vulkan::Image &image,
+                      Vulkan::CommandBuffer::Type type, const std::string &path,
+                      std::function<void (bool success)> on_complete)
+{
+	// The create info has to be captured now; by the time the readback ages out
+	// the caller may well have dropped its image reference.
+	ImageCreateInfo info = image.get_create_info();
+	bool use_gtx = Path::ext(path) == "gtx";
+
+	ring.request_image_readback(
+	    image, type,
+	    [info, path, use_gtx, on_complete = std::move(on_complete)](const TextureFormatLayout &layout, const void *mapped) {
+		    bool success = use_gtx ? write_image_payload_to_gtx(info, layout, mapped, path) :
+		                             write_image_payload_to_png(info, mapped, path);
+		    if (!success)
+			    LOGE("Failed to save captured image to %s.\n", path.c_str());
+		    if (on_complete)
+			    on_complete(success);
+	    });
+}
 }
\ No newline at end of file
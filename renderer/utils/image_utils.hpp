@@ -23,6 +23,9 @@
 #pragma once
 
 #include "device.hpp"
+#include "readback_ring.hpp"
+#include <functional>
+#include <string>
 
 namespace Granite
 {
@@ -39,4 +42,16 @@ struct ImageReadback
 };
 ImageReadback save_image_to_cpu_buffer(Vulkan::Device &device, const Vulkan::Image &image, Vulkan::CommandBuffer::Type type);
 bool save_image_buffer_to_gtx(Vulkan::Device &device, ImageReadback &readback, const char *path);
+
+// Fire-and-forget capture. The GPU copy is recorded now through the deferred
+// readback ring; once it ages out, the encode and the Filesystem write run on
+// a ThreadGroup worker, so the frame loop never observes the readback or the
+// encode. A ".gtx" path dumps the raw payload with full mip/layer structure;
+// any other extension encodes a PNG of mip 0 / layer 0 and requires an 8-bit
+// four-component format (RGBA/BGRA). The image must be in TRANSFER_SRC or
+// GENERAL layout, same as the ring's contract. on_complete, when set, fires on
+// the worker after the file is written (or on failure).
+void save_image_async(Vulkan::ReadbackRing &ring, const Vulkan::Image &image,
+                      Vulkan::CommandBuffer::Type type, const std::string &path,
+                      std::function<void (bool success)> on_complete = {});
 }
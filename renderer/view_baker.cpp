@@ -0,0 +1,57 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "view_baker.hpp"
+#include <assert.h>
+
+using namespace std;
+
+namespace Granite
+{
+TaskGroup ViewBaker::bake(ThreadGroup &workers, View &view)
+{
+	assert(view.context && view.renderer && view.visible && view.gather);
+
+	// Stage 1: frustum cull against the view. The BVH walk is read-only over
+	// the cached spatial lists, so any number of views can cull concurrently.
+	auto gather = workers.create_task([&view]() {
+		view.visible->clear();
+		view.renderer->begin();
+		view.gather(view.context->get_visibility_frustum(), *view.visible);
+	});
+
+	// Stage 2: enqueue into the view's private queue and sort it, so record
+	// time only has to replay the draws with SKIP_SORTING_BIT.
+	auto enqueue = workers.create_task([&view]() {
+		if (view.depth)
+			view.renderer->push_depth_renderables(*view.context, *view.visible);
+		else
+			view.renderer->push_renderables(*view.context, *view.visible);
+		view.renderer->get_render_queue().sort();
+	});
+
+	workers.add_dependency(*enqueue, *gather);
+	gather->flush();
+	enqueue->flush();
+	return enqueue;
+}
+}
@@ -0,0 +1,66 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "renderer.hpp"
+#include "render_context.hpp"
+#include "thread_group.hpp"
+#include <functional>
+
+namespace Granite
+{
+// Bakes several independent views (main camera, shadow cascades, probe faces)
+// in parallel on the ThreadGroup. Each view gets its own task chain of
+// cull -> enqueue -> sort, independent of every other view's chain, so
+// shadow-heavy frames scale with core count instead of walking the views
+// serially. All chains read the same transform snapshot, which the caller
+// must have rebuilt with Scene::update_cached_transforms() before kicking any
+// view; the per-type spatial lists are immutable while the chains run.
+//
+// The returned TaskGroup joins a view's chain at record time: either wait()
+// on it right before recording the view, or add it as a dependency of the
+// task which records it. Since the sort already ran on the chain, record with
+// Renderer::SKIP_SORTING_BIT. Each view needs its own Renderer and
+// RenderContext; sharing one Renderer between concurrently baking views would
+// race on its RenderQueue.
+class ViewBaker
+{
+public:
+	using GatherFunc = std::function<void (const Frustum &, VisibilityList &)>;
+
+	struct View
+	{
+		RenderContext *context = nullptr;
+		Renderer *renderer = nullptr;
+		VisibilityList *visible = nullptr;
+		// Typically binds one of the Scene::gather_visible_* methods.
+		GatherFunc gather;
+		// Enqueue through get_depth_render_info rather than get_render_info.
+		bool depth = false;
+	};
+
+	// Kicks off the chain for one view. The View must stay alive until the
+	// returned group completes.
+	TaskGroup bake(ThreadGroup &workers, View &view);
+};
+}
@@ -22,6 +22,7 @@
 
 #include "camera_export.hpp"
 #include "rapidjson_wrapper.hpp"
+#include "logging.hpp"
 
 using namespace rapidjson;
 using namespace std;
@@ -71,4 +72,38 @@ string export_cameras_to_json(const vector<RecordedCamera> &recorded_cameras)
 	doc.Accept(writer);
 	return buffer.GetString();
 }
+
+vector<RecordedCamera> import_cameras_from_json(const string &json)
+{
+	vector<RecordedCamera> recorded_cameras;
+
+	Document doc;
+	doc.Parse(json);
+	if (doc.HasParseError() || !doc.HasMember("cameras"))
+	{
+		LOGE("Failed to parse camera JSON.\n");
+		return recorded_cameras;
+	}
+
+	for (auto itr = doc["cameras"].Begin(); itr != doc["cameras"].End(); ++itr)
+	{
+		auto &c = *itr;
+		RecordedCamera cam = {};
+		cam.fovy = c["fovy"].GetFloat();
+		cam.aspect = c["aspect"].GetFloat();
+		cam.znear = c["znear"].GetFloat();
+		cam.zfar = c["zfar"].GetFloat();
+
+		auto &dir = c["direction"];
+		cam.direction = vec3(dir[0].GetFloat(), dir[1].GetFloat(), dir[2].GetFloat());
+		auto &pos = c["position"];
+		cam.position = vec3(pos[0].GetFloat(), pos[1].GetFloat(), pos[2].GetFloat());
+		auto &up = c["up"];
+		cam.up = vec3(up[0].GetFloat(), up[1].GetFloat(), up[2].GetFloat());
+
+		recorded_cameras.push_back(cam);
+	}
+
+	return recorded_cameras;
+}
 }
\ No newline at end of file
@@ -37,4 +37,5 @@ struct RecordedCamera
 	float zfar;
 };
 std::string export_cameras_to_json(const std::vector<RecordedCamera> &cameras);
+std::vector<RecordedCamera> import_cameras_from_json(const std::string &json);
 }
\ No newline at end of file
@@ -26,8 +26,15 @@
 #include "mesh.hpp"
 #include <unordered_map>
 #include <algorithm>
+#include <exception>
+#include <mutex>
 #include "rapidjson_wrapper.hpp"
 #include "muglm/matrix_helper.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#include "scene_cache.hpp"
+#include "string_helpers.hpp"
+#include "hash.hpp"
 
 using namespace std;
 using namespace rapidjson;
@@ -37,9 +44,43 @@ using namespace Util;
 namespace GLTF
 {
 
+// Runs func over [0, count) on the thread group workers. Parse errors are
+// reported with exceptions, so the first one thrown by a worker is
+// forwarded to the caller.
+template <typename Func>
+static void parallel_indexed_stage(size_t count, const Func &func)
+{
+	auto *group = Global::thread_group();
+	if (!group || count < 2)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	exception_ptr eptr;
+	mutex eptr_lock;
+	group->parallel_for(count, 1, [&](size_t begin, size_t end) {
+		try
+		{
+			for (size_t i = begin; i < end; i++)
+				func(i);
+		}
+		catch (...)
+		{
+			lock_guard<mutex> holder{eptr_lock};
+			if (!eptr)
+				eptr = current_exception();
+		}
+	});
+
+	if (eptr)
+		rethrow_exception(eptr);
+}
+
 Parser::Buffer Parser::read_buffer(const string &path, uint64_t length)
 {
-	auto file = Global::filesystem()->open(path);
+	shared_ptr<File> file = Global::filesystem()->open(path);
 	if (!file)
 		throw runtime_error("Failed to open GLTF buffer.");
 
@@ -50,9 +91,9 @@ Parser::Buffer Parser::read_buffer(const string &path, uint64_t length)
 	if (!mapped)
 		throw runtime_error("Failed to map file.");
 
-	Buffer buf(length);
-	memcpy(buf.data(), mapped, length);
-	return buf;
+	// Keep the mapping alive for the parser's lifetime and read straight
+	// from it instead of copying multi-hundred-MB buffers to the heap.
+	return Buffer(move(file), static_cast<const uint8_t *>(mapped), size_t(length));
 }
 
 Parser::Buffer Parser::read_base64(const char *data, uint64_t length)
@@ -121,12 +162,56 @@ Parser::Buffer Parser::read_base64(const char *data, uint64_t length)
 	return buf;
 }
 
+// The cache is keyed on the source path and invalidated through the file's
+// size and timestamp. External .bin buffers are assumed to change together
+// with their .gltf.
+static string get_scene_cache_path(const string &path, uint64_t &validation_key)
+{
+	FileStat s;
+	if (!Global::filesystem()->stat(path, s) || s.type != PathType::File)
+		return "";
+
+	Util::Hasher key_hasher;
+	key_hasher.string(path);
+	key_hasher.u64(s.size);
+	key_hasher.u64(s.last_modified);
+	validation_key = key_hasher.get();
+
+	Util::Hasher path_hasher;
+	path_hasher.string(path);
+	return Util::join("cache://scenes/", path_hasher.get(), ".bin");
+}
+
 Parser::Parser(const std::string &path)
 {
+	// Steady-state reloads skip reading the JSON, parsing it and repacking
+	// mesh attributes entirely through the binary scene cache.
+	uint64_t validation_key = 0;
+	auto cache_path = get_scene_cache_path(path, validation_key);
+
+	if (!cache_path.empty())
+	{
+		SceneCache cache;
+		if (load_scene_cache(cache_path, validation_key, cache))
+		{
+			meshes = move(cache.meshes);
+			materials = move(cache.materials);
+			nodes = move(cache.nodes);
+			animations = move(cache.animations);
+			json_skins = move(cache.skins);
+			json_cameras = move(cache.cameras);
+			json_lights = move(cache.lights);
+			json_environments = move(cache.environments);
+			json_scenes = move(cache.scenes);
+			default_scene_index = cache.default_scene;
+			return;
+		}
+	}
+
 	string json;
 
 	{
-		auto file = Global::filesystem()->open(path, FileMode::ReadOnly);
+		shared_ptr<File> file = Global::filesystem()->open(path, FileMode::ReadOnly);
 		if (!file)
 			throw runtime_error("Failed to load GLTF file.");
 
@@ -177,15 +262,42 @@ Parser::Parser(const std::string &path)
 							"Header error, binary chunk and JSON chunk lengths do not match up with GLB size.");
 
 				// The first buffer in the JSON must be this embedded buffer.
-				Buffer buffer(reinterpret_cast<const uint8_t *>(words),
-				              reinterpret_cast<const uint8_t *>(words) + binary_length);
-				json_buffers.push_back(move(buffer));
+				// Pin the mapped GLB instead of copying the BIN chunk out.
+				json_buffers.emplace_back(file, reinterpret_cast<const uint8_t *>(words), binary_length);
 			}
 		}
 		else
 			json = string(static_cast<const char *>(mapped), static_cast<const char *>(mapped) + size);
 	}
+
 	parse(path, json);
+
+	if (!cache_path.empty())
+	{
+		SceneCache cache;
+		cache.meshes = move(meshes);
+		cache.materials = move(materials);
+		cache.nodes = move(nodes);
+		cache.animations = move(animations);
+		cache.skins = move(json_skins);
+		cache.cameras = move(json_cameras);
+		cache.lights = move(json_lights);
+		cache.environments = move(json_environments);
+		cache.scenes = move(json_scenes);
+		cache.default_scene = default_scene_index;
+
+		save_scene_cache(cache_path, validation_key, cache);
+
+		meshes = move(cache.meshes);
+		materials = move(cache.materials);
+		nodes = move(cache.nodes);
+		animations = move(cache.animations);
+		json_skins = move(cache.skins);
+		json_cameras = move(cache.cameras);
+		json_lights = move(cache.lights);
+		json_environments = move(cache.environments);
+		json_scenes = move(cache.scenes);
+	}
 }
 
 #define GL_BYTE                           0x1400
@@ -790,7 +902,8 @@ void Parser::parse(const string &original_path, const string &json)
 			if (!mapped)
 				throw runtime_error("Failed to map memory file.");
 
-			memcpy(mapped, json_buffers[view.buffer_index].data() + view.offset, view.length);
+			const auto &src_buffer = json_buffers[view.buffer_index];
+			memcpy(mapped, src_buffer.data() + view.offset, view.length);
 			json_images.emplace_back(move(fake_path));
 		}
 		else
@@ -1386,7 +1499,7 @@ void Parser::parse(const string &original_path, const string &json)
 	if (doc.HasMember("skins"))
 		iterate_elements(doc["skins"], add_skin);
 
-	const auto add_animation = [&](const Value &animation) {
+	const auto add_animation = [&](const Value &animation, unsigned animation_index) {
 		auto &samplers = animation["samplers"];
 		auto &channels = animation["channels"];
 
@@ -1485,8 +1598,8 @@ void Parser::parse(const string &original_path, const string &json)
 			combined_animation.channels.push_back(move(channel));
 		}
 		combined_animation.update_length();
-		combined_animation.name = move(json_animation_names[animations.size()]);
-		animations.push_back(move(combined_animation));
+		combined_animation.name = move(json_animation_names[animation_index]);
+		animations[animation_index] = move(combined_animation);
 	};
 
 	if (doc.HasMember("animations"))
@@ -1508,7 +1621,17 @@ void Parser::parse(const string &original_path, const string &json)
 			json_animation_names.push_back(move(name));
 			counter++;
 		}
-		iterate_elements(animation_list, add_animation);
+
+		// Channel baking is pure extraction per animation; the document and
+		// node tables are read-only by now, so bake animations in parallel.
+		vector<const Value *> animation_values;
+		for (auto itr = animation_list.Begin(); itr != animation_list.End(); ++itr)
+			animation_values.push_back(&*itr);
+
+		animations.resize(animation_values.size());
+		parallel_indexed_stage(animation_values.size(), [&](size_t i) {
+			add_animation(*animation_values[i], unsigned(i));
+		});
 	}
 
 	if (doc.HasMember("scenes"))
@@ -1546,9 +1669,8 @@ static uint32_t padded_type_size(uint32_t type_size)
 		return type_size;
 }
 
-void Parser::build_primitive(const MeshData::AttributeData &prim)
+void Parser::build_primitive(const MeshData::AttributeData &prim, Mesh &mesh)
 {
-	Mesh mesh;
 	mesh.topology = prim.topology;
 	mesh.primitive_restart = prim.primitive_restart;
 	mesh.has_material = prim.has_material;
@@ -1805,7 +1927,19 @@ void Parser::build_primitive(const MeshData::AttributeData &prim)
 	if (rebuild_tangents)
 		mesh_recompute_tangents(mesh);
 
-	meshes.push_back(move(mesh));
+	// Reorder for post-transform cache and vertex fetch locality up front.
+	// Assets which did not go through gltf-repacker tend to index in
+	// authoring order, which renders poorly. The result lands in the scene
+	// cache, so the cost is paid once per asset, not per load.
+	if (mesh.topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+	{
+		mesh = mesh_optimize_index_buffer(mesh, false);
+		// Simplified LOD chain for distance-based selection at draw time.
+		// Skinned meshes keep full resolution; collapsing vertices under a
+		// bone palette deforms visibly.
+		if (mesh.attribute_layout[ecast(MeshAttribute::BoneIndex)].format == VK_FORMAT_UNDEFINED)
+			mesh = mesh_generate_lods(mesh, 4);
+	}
 }
 
 void Parser::build_meshes()
@@ -1814,16 +1948,24 @@ void Parser::build_meshes()
 	uint32_t primitive_count = 0;
 	uint32_t mesh_count = 0;
 
+	vector<const MeshData::AttributeData *> primitives;
 	for (auto &mesh : json_meshes)
 	{
 		for (auto &prim : mesh.primitives)
 		{
 			mesh_index_to_primitives[mesh_count].push_back(primitive_count);
-			build_primitive(prim);
+			primitives.push_back(&prim);
 			primitive_count++;
 		}
 		mesh_count++;
 	}
+
+	// Primitives only read shared document state, so repacking and
+	// normal/tangent rebuilds go wide; they dominate load time on big scenes.
+	meshes.resize(primitive_count);
+	parallel_indexed_stage(primitive_count, [&](size_t i) {
+		build_primitive(*primitives[i], meshes[i]);
+	});
 }
 
 }
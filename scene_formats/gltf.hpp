@@ -24,8 +24,11 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <assert.h>
 #include "math.hpp"
 #include "scene_formats.hpp"
+#include "filesystem.hpp"
 
 namespace GLTF
 {
@@ -108,7 +111,52 @@ public:
 	}
 
 private:
-	using Buffer = std::vector<uint8_t>;
+	// A glTF binary payload. Base64 and decoded data own heap storage, while
+	// external .bin files and the GLB BIN chunk keep the mapped File alive
+	// and read straight from the mapping, so large buffers are never copied.
+	class Buffer
+	{
+	public:
+		Buffer() = default;
+
+		explicit Buffer(uint64_t size_)
+			: storage(size_t(size_))
+		{
+		}
+
+		Buffer(std::shared_ptr<Granite::File> file_, const uint8_t *mapped_, size_t mapped_size_)
+			: file(std::move(file_)), mapped(mapped_), mapped_size(mapped_size_)
+		{
+		}
+
+		const uint8_t *data() const
+		{
+			return mapped ? mapped : storage.data();
+		}
+
+		uint8_t *data()
+		{
+			// Mapped buffers are read-only.
+			assert(!mapped);
+			return storage.data();
+		}
+
+		size_t size() const
+		{
+			return mapped ? mapped_size : storage.size();
+		}
+
+		const uint8_t &operator[](size_t offset) const
+		{
+			return data()[offset];
+		}
+
+	private:
+		std::vector<uint8_t> storage;
+		std::shared_ptr<Granite::File> file;
+		const uint8_t *mapped = nullptr;
+		size_t mapped_size = 0;
+	};
 
 	struct BufferView
 	{
@@ -194,7 +242,7 @@ private:
 	uint32_t default_scene_index = 0;
 
 	void build_meshes();
-	void build_primitive(const MeshData::AttributeData &prim);
+	void build_primitive(const MeshData::AttributeData &prim, Mesh &mesh);
 
 	void extract_attribute(std::vector<float> &attributes, const Accessor &accessor);
 	void extract_attribute(std::vector<vec3> &attributes, const Accessor &accessor);
@@ -181,6 +181,49 @@ struct EmittedAnimation
 	std::vector<Channel> channels;
 };
 
+// Accumulates the GLB payload in fixed-granularity chunks rather than one
+// contiguous vector. Reallocation spikes on a multi-GB contiguous buffer
+// transiently tripled peak RSS on large worlds; chunks bound the spike to the
+// granularity, and the final writeout releases each chunk as it is copied so
+// the ceiling stays near the payload size itself.
+struct GlbPayload
+{
+	enum { chunk_granularity = 64 * 1024 * 1024 };
+	std::vector<std::vector<uint8_t>> chunks;
+	size_t total_size = 0;
+
+	size_t append(const uint8_t *data, size_t size)
+	{
+		size_t offset = (total_size + 15) & ~size_t(15);
+		size_t pad = offset - total_size;
+		if (pad)
+		{
+			chunks.back().resize(chunks.back().size() + pad);
+			total_size += pad;
+		}
+
+		if (chunks.empty() || chunks.back().size() + size > chunk_granularity)
+			chunks.emplace_back();
+
+		auto &chunk = chunks.back();
+		chunk.insert(chunk.end(), data, data + size);
+		total_size += size;
+		return offset;
+	}
+
+	void write_and_release(uint8_t *mapped)
+	{
+		size_t offset = 0;
+		for (auto &chunk : chunks)
+		{
+			memcpy(mapped + offset, chunk.data(), chunk.size());
+			offset += chunk.size();
+			std::vector<uint8_t>().swap(chunk);
+		}
+		chunks.clear();
+	}
+};
+
 struct RemapState
 {
 	const ExportOptions *options = nullptr;
@@ -213,10 +256,14 @@ struct RemapState
 	Remap<Mesh> mesh;
 	Remap<MaterialInfo> material;
 
-	vector<uint8_t> glb_buffer_data;
+	GlbPayload glb_payload;
 	HashMap<unsigned> buffer_hash;
 	vector<BufferView> buffer_views;
 
+	// Filled by a parallel pre-pass when optimize_meshes is set, released
+	// again per mesh once it has been serialized.
+	vector<Mesh> optimized_meshes;
+
 	HashMap<unsigned> accessor_hash;
 	vector<EmittedAccessor> accessor_cache;
 
@@ -331,10 +378,7 @@ unsigned RemapState::emit_buffer(ArrayView<const uint8_t> view)
 	if (itr == end(buffer_hash))
 	{
 		unsigned index = buffer_views.size();
-		size_t offset = glb_buffer_data.size();
-		offset = (offset + 15) & ~15;
-		glb_buffer_data.resize(offset + view.size());
-		memcpy(glb_buffer_data.data() + offset, view.data(), view.size());
+		size_t offset = glb_payload.append(view.data(), view.size());
 		buffer_views.push_back({offset, view.size()});
 		buffer_hash[h.get()] = index;
 		return index;
@@ -885,10 +929,7 @@ static void extract_attribute(uint8_t *output,
 
 void RemapState::emit_mesh(unsigned remapped_index)
 {
-	Mesh new_mesh;
-	if (options->optimize_meshes)
-		new_mesh = mesh_optimize_index_buffer(*mesh.info[remapped_index], options->stripify_meshes);
-	auto &output_mesh = options->optimize_meshes ? new_mesh : *mesh.info[remapped_index];
+	auto &output_mesh = options->optimize_meshes ? optimized_meshes[remapped_index] : *mesh.info[remapped_index];
 
 	mesh_cache.resize(std::max<size_t>(mesh_cache.size(), remapped_index + 1));
 
@@ -1082,6 +1123,10 @@ void RemapState::emit_mesh(unsigned remapped_index)
 			emit.attribute_accessor[i] = emit_accessor(buffer_index, remapped_format, 0, attr_count);
 		}
 	}
+
+	// The payload has been appended, so the repacked copy is dead weight now.
+	if (options->optimize_meshes)
+		optimized_meshes[remapped_index] = {};
 }
 
 unsigned RemapState::emit_meshes(ArrayView<const unsigned> meshes)
@@ -1511,7 +1556,7 @@ static shared_ptr<AnalysisResult> analyze_image(ThreadGroup &workers,
 }
 
 static void compress_image(ThreadGroup &workers, const string &target_path, shared_ptr<AnalysisResult> &result,
-                           unsigned quality, TaskSignal *signal)
+                           unsigned quality, bool supercompress, bool rdo, float rdo_lambda, TaskSignal *signal)
 {
 	FileStat src_stat, dst_stat;
 	if (Global::filesystem()->stat(result->src_path, src_stat) && Global::filesystem()->stat(target_path, dst_stat))
@@ -1531,25 +1576,15 @@ static void compress_image(ThreadGroup &workers, const string &target_path, shar
 	args.quality = quality;
 	args.mode = result->mode;
 	args.output_mapping = result->swizzle;
+	args.supercompress = supercompress;
+	args.rdo = rdo;
+	args.rdo_lambda = rdo_lambda;
 
-	auto mipgen_task = workers.create_task([=]() {
-		if (result->image->get_layout().get_levels() == 1 && result->mode != TextureMode::HDR)
-		{
-			if (result->compression == TextureCompression::PNG)
-			{
-				// Do nothing, we don't need mipmaps.
-			}
-			else if (result->compression != TextureCompression::Uncompressed)
-				*result->image = generate_mipmaps(result->image->get_layout(), result->image->get_flags());
-			else
-				*result->image = generate_mipmaps_to_file(target_path, result->image->get_layout(), result->image->get_flags());
-		}
-
-		LOGI("Mapped input texture: %u bytes.\n", unsigned(result->image->get_required_size()));
-	});
+	bool need_mipgen = result->image->get_layout().get_levels() == 1 && result->mode != TextureMode::HDR;
 
 	if (result->compression == TextureCompression::PNG)
 	{
+		// PNG does not need mipmaps.
 		auto write_task = workers.create_task([=]() {
 			if (result->image->get_layout().get_format() != VK_FORMAT_R8G8B8A8_UNORM &&
 			    result->image->get_layout().get_format() != VK_FORMAT_R8G8B8A8_SRGB)
@@ -1578,24 +1613,69 @@ static void compress_image(ThreadGroup &workers, const string &target_path, shar
 			result->image.reset();
 		});
 		write_task->set_fence_counter_signal(signal);
-		workers.add_dependency(write_task, mipgen_task);
 	}
 	else if (result->compression != TextureCompression::Uncompressed)
-		compress_texture(workers, args, result->image, mipgen_task, signal);
-	else if (result->image->get_layout().get_levels() != 1 || result->mode == TextureMode::HDR)
 	{
-		auto write_task = workers.create_task([=]() {
-			if (!result->image->copy_to_path(args.output))
-				LOGE("Failed to copy image.\n");
+		if (need_mipgen)
+		{
+			// Allocate the chain up front and generate one level per task, so
+			// the compressor can start on level N while level N + 1 is still
+			// being filtered instead of waiting for the whole chain.
+			auto &layout = result->image->get_layout();
+			unsigned levels = Vulkan::TextureFormatLayout::num_miplevels(layout.get_width(), layout.get_height());
+
+			auto alloc_task = workers.create_task([=]() {
+				*result->image = create_mipmap_chain(result->image->get_layout(), result->image->get_flags());
+				LOGI("Mapped input texture: %u bytes.\n", unsigned(result->image->get_required_size()));
+			});
+
+			std::vector<TaskGroup> level_deps(levels);
+			for (unsigned level = 1; level < levels; level++)
+			{
+				auto level_task = workers.create_task([=]() {
+					generate_mipmap_level(*result->image, level);
+				});
+				workers.add_dependency(level_task, level == 1 ? alloc_task : level_deps[level - 1]);
+				level_deps[level] = move(level_task);
+			}
 
-			LOGI("Unmapping %u bytes for texture writing.\n", unsigned(result->image->get_required_size()));
-			result->image.reset();
-		});
-		write_task->set_fence_counter_signal(signal);
-		workers.add_dependency(write_task, mipgen_task);
+			compress_texture(workers, args, result->image, alloc_task, signal, move(level_deps));
+		}
+		else
+		{
+			auto mipgen_task = workers.create_task([=]() {
+				LOGI("Mapped input texture: %u bytes.\n", unsigned(result->image->get_required_size()));
+			});
+			compress_texture(workers, args, result->image, mipgen_task, signal);
+		}
 	}
 	else
-		mipgen_task->set_fence_counter_signal(signal);
+	{
+		auto mipgen_task = workers.create_task([=]() {
+			if (need_mipgen)
+				*result->image = generate_mipmaps_to_file(target_path, result->image->get_layout(), result->image->get_flags());
+
+			LOGI("Mapped input texture: %u bytes.\n", unsigned(result->image->get_required_size()));
+		});
+
+		if (!need_mipgen)
+		{
+			auto write_task = workers.create_task([=]() {
+				bool copied = supercompress ?
+				              result->image->copy_to_path_compressed(args.output) :
+				              result->image->copy_to_path(args.output);
+				if (!copied)
+					LOGE("Failed to copy image.\n");
+
+				LOGI("Unmapping %u bytes for texture writing.\n", unsigned(result->image->get_required_size()));
+				result->image.reset();
+			});
+			write_task->set_fence_counter_signal(signal);
+			workers.add_dependency(write_task, mipgen_task);
+		}
+		else
+			mipgen_task->set_fence_counter_signal(signal);
+	}
 }
 
 bool export_scene_to_glb(const SceneInformation &scene, const string &path, const ExportOptions &options)
@@ -1628,6 +1708,18 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 	state.filter_input(state.material, scene.materials);
 	state.filter_input(state.mesh, scene.meshes);
 
+	if (options.optimize_meshes)
+	{
+		// Repacking is pure per-mesh work and dominates export time on big
+		// worlds, so fan it out across the workers up front. The serial emit
+		// pass below is then reduced to hashing and appending payload.
+		state.optimized_meshes.resize(state.mesh.info.size());
+		workers.parallel_for(state.mesh.info.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				state.optimized_meshes[i] = mesh_optimize_index_buffer(*state.mesh.info[i], options.stripify_meshes);
+		});
+	}
+
 	if (!options.environment.cube.empty())
 	{
 		state.emit_environment(options.environment.cube, options.environment.reflection, options.environment.irradiance,
@@ -1712,7 +1804,7 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 		// The baked GLB buffer.
 		Value buffers(kArrayType);
 		Value buffer(kObjectType);
-		buffer.AddMember("byteLength", uint32_t(state.glb_buffer_data.size()), allocator);
+		buffer.AddMember("byteLength", uint32_t(state.glb_payload.total_size), allocator);
 
 		auto uri = path + ".bin";
 		buffer.AddMember("uri", Path::basename(uri), allocator);
@@ -1724,14 +1816,14 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 			return false;
 		}
 
-		void *mapped = file->map_write(state.glb_buffer_data.size());
+		void *mapped = file->map_write(state.glb_payload.total_size);
 		if (!mapped)
 		{
 			LOGE("Failed to map buffer for writing.\n");
 			return false;
 		}
 
-		memcpy(mapped, state.glb_buffer_data.data(), state.glb_buffer_data.size());
+		state.glb_payload.write_and_release(static_cast<uint8_t *>(mapped));
 		buffers.PushBack(buffer, allocator);
 		doc.AddMember("buffers", buffers, allocator);
 	}
@@ -1740,7 +1832,7 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 		// The baked GLB buffer.
 		Value buffers(kArrayType);
 		Value buffer(kObjectType);
-		buffer.AddMember("byteLength", uint32_t(state.glb_buffer_data.size()), allocator);
+		buffer.AddMember("byteLength", uint32_t(state.glb_payload.total_size), allocator);
 		buffers.PushBack(buffer, allocator);
 		doc.AddMember("buffers", buffers, allocator);
 	}
@@ -1858,6 +1950,13 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 
 		TaskSignal signal;
 		unsigned max_count = 0;
+
+		// Only keep a certain number of compression jobs alive at a time to
+		// bound how many source and target textures are mapped at once, but
+		// deep enough that serial stages of one image (mipgen chains, ASTC)
+		// can overlap tile work from others on wide machines.
+		unsigned max_in_flight = std::max(4u, workers.get_num_threads() / 2u);
+
 		for (auto &image : state.image_cache)
 		{
 			Value i(kObjectType);
@@ -1866,12 +1965,14 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 
 			images.PushBack(i, allocator);
 
-			// Only keep a certain number of compression jobs alive at a time.
-			if (max_count > 3)
-				signal.wait_until_at_least(max_count - 3);
+			if (max_count >= max_in_flight)
+				signal.wait_until_at_least(max_count - max_in_flight + 1);
 
+			bool rdo = (options.rdo_texture_mask &
+			            (1u << ecast(image.loaded_image->type))) != 0;
 			compress_image(workers, Path::relpath(path, image.target_relpath),
-			               image.loaded_image, image.compression_quality, &signal);
+			               image.loaded_image, image.compression_quality,
+			               options.supercompress_textures, rdo, options.rdo_lambda, &signal);
 
 			max_count++;
 		}
@@ -2324,7 +2425,7 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 	}
 	else
 	{
-		size_t glb_size = 12 + 8 + aligned_size(buffer.GetLength()) + 8 + aligned_size(state.glb_buffer_data.size());
+		size_t glb_size = 12 + 8 + aligned_size(buffer.GetLength()) + 8 + aligned_size(state.glb_payload.total_size);
 
 		uint8_t *mapped = static_cast<uint8_t *>(file->map_write(glb_size));
 		if (!mapped)
@@ -2351,13 +2452,14 @@ bool export_scene_to_glb(const SceneInformation &scene, const string &path, cons
 		memset(mapped + buffer.GetLength(), ' ', pad_length);
 		mapped += aligned_size(buffer.GetLength());
 
-		write_u32(mapped, aligned_size(state.glb_buffer_data.size()));
+		write_u32(mapped, aligned_size(state.glb_payload.total_size));
 		mapped += 4;
 		memcpy(mapped, "BIN\0", 4);
 		mapped += 4;
-		memcpy(mapped, state.glb_buffer_data.data(), state.glb_buffer_data.size());
-		pad_length = aligned_size(state.glb_buffer_data.size()) - state.glb_buffer_data.size();
-		memset(mapped + state.glb_buffer_data.size(), 0, pad_length);
+		size_t payload_size = state.glb_payload.total_size;
+		state.glb_payload.write_and_release(mapped);
+		pad_length = aligned_size(payload_size) - payload_size;
+		memset(mapped + payload_size, 0, pad_length);
 	}
 
 	file->unmap();
@@ -72,7 +72,14 @@ struct ExportOptions
 		float intensity = 1.0f;
 	} environment;
 
+	// Texture classes (MATERIAL_TEXTURE_*_BIT) which get the RDO block merge
+	// pass, see CompressorArguments::rdo. Mostly useful together with
+	// supercompress_textures.
+	uint32_t rdo_texture_mask = 0;
+	float rdo_lambda = 2.0f;
+
 	bool quantize_attributes = false;
+	bool supercompress_textures = false;
 	bool optimize_meshes = false;
 	bool stripify_meshes = false;
 	bool gltf = false;
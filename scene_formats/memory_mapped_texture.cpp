@@ -21,6 +21,8 @@
  */
 
 #include "memory_mapped_texture.hpp"
+#include "lz4.hpp"
+#include "logging.hpp"
 #include <string.h>
 #include <stdlib.h>
 
@@ -219,6 +221,108 @@ bool MemoryMappedTexture::map_write_scratch()
 	return map_write(move(new_file), new_mapped);
 }
 
+static size_t level_payload_size(const Vulkan::TextureFormatLayout &layout, unsigned level)
+{
+	size_t end = (level + 1 < layout.get_levels()) ?
+	             layout.get_mip_info(level + 1).offset :
+	             layout.get_required_size();
+	return end - layout.get_mip_info(level).offset;
+}
+
+bool MemoryMappedTexture::copy_to_path_compressed(const std::string &path)
+{
+	if (layout.get_required_size() == 0 || !mapped)
+		return false;
+
+	unsigned levels = layout.get_levels();
+	vector<uint64_t> compressed_sizes(levels);
+	vector<uint8_t> compressed;
+	compressed.reserve(layout.get_required_size() / 2);
+
+	for (unsigned level = 0; level < levels; level++)
+	{
+		size_t level_size = level_payload_size(layout, level);
+		size_t bound = Util::LZ4::compress_bound(level_size);
+		size_t offset = compressed.size();
+		compressed.resize(offset + bound);
+		size_t size = Util::LZ4::compress(compressed.data() + offset, bound, layout.data(0, level), level_size);
+		if (!size)
+			return false;
+		compressed.resize(offset + size);
+		compressed_sizes[level] = size;
+	}
+
+	auto target_file = Global::filesystem()->open(path, FileMode::WriteOnly);
+	if (!target_file)
+		return false;
+
+	size_t total_size = sizeof(MemoryMappedHeader) + levels * sizeof(uint64_t) + compressed.size();
+	uint8_t *new_mapped = static_cast<uint8_t *>(target_file->map_write(total_size));
+	if (!new_mapped)
+		return false;
+
+	// payload_size keeps the uncompressed size so the reader can validate
+	// the inflated result against the layout.
+	MemoryMappedHeader header;
+	memcpy(&header, mapped, sizeof(header));
+	header.flags |= MEMORY_MAPPED_TEXTURE_COMPRESSED_BIT;
+	memcpy(new_mapped, &header, sizeof(header));
+	memcpy(new_mapped + sizeof(header), compressed_sizes.data(), levels * sizeof(uint64_t));
+	memcpy(new_mapped + sizeof(header) + levels * sizeof(uint64_t), compressed.data(), compressed.size());
+	target_file->unmap();
+	return true;
+}
+
+bool MemoryMappedTexture::decompress_payload()
+{
+	auto *header = reinterpret_cast<const MemoryMappedHeader *>(mapped);
+	if (header->payload_size != layout.get_required_size())
+		return false;
+
+	unsigned levels = layout.get_levels();
+	size_t table_size = levels * sizeof(uint64_t);
+	size_t file_size = file->get_size();
+	if (file_size < sizeof(MemoryMappedHeader) + table_size)
+		return false;
+
+	vector<uint64_t> compressed_sizes(levels);
+	memcpy(compressed_sizes.data(), mapped + sizeof(MemoryMappedHeader), table_size);
+
+	auto inflated_file = make_unique<ScratchFile>(nullptr, layout.get_required_size() + sizeof(MemoryMappedHeader));
+	uint8_t *inflated = static_cast<uint8_t *>(inflated_file->map());
+
+	MemoryMappedHeader new_header = *header;
+	new_header.flags &= ~MEMORY_MAPPED_TEXTURE_COMPRESSED_BIT;
+	memcpy(inflated, &new_header, sizeof(new_header));
+	uint8_t *payload = inflated + sizeof(new_header);
+
+	const uint8_t *src = mapped + sizeof(MemoryMappedHeader) + table_size;
+	size_t remaining = file_size - sizeof(MemoryMappedHeader) - table_size;
+
+	for (unsigned level = 0; level < levels; level++)
+	{
+		size_t compressed_size = compressed_sizes[level];
+		if (compressed_size > remaining)
+			return false;
+
+		if (!Util::LZ4::decompress(payload + layout.get_mip_info(level).offset,
+		                           level_payload_size(layout, level),
+		                           src, compressed_size))
+		{
+			LOGE("Failed to decompress texture payload, file is corrupt.\n");
+			return false;
+		}
+
+		src += compressed_size;
+		remaining -= compressed_size;
+	}
+
+	file = move(inflated_file);
+	mapped = inflated;
+	layout.set_buffer(payload, layout.get_required_size());
+	return true;
+}
+
 size_t MemoryMappedTexture::get_required_size() const
 {
 	return layout.get_required_size() + sizeof(MemoryMappedHeader);
@@ -316,6 +420,11 @@ bool MemoryMappedTexture::map_read(unique_ptr<Granite::File> new_file, void *map
 	swizzle.b = static_cast<VkComponentSwizzle>((header->flags >> MEMORY_MAPPED_TEXTURE_SWIZZLE_B_SHIFT) & MEMORY_MAPPED_TEXTURE_SWIZZLE_MASK);
 	swizzle.a = static_cast<VkComponentSwizzle>((header->flags >> MEMORY_MAPPED_TEXTURE_SWIZZLE_A_SHIFT) & MEMORY_MAPPED_TEXTURE_SWIZZLE_MASK);
 
+	// Supercompressed payloads are inflated into a scratch copy up front,
+	// plain payloads keep referencing the mapped file directly.
+	if (header->flags & MEMORY_MAPPED_TEXTURE_COMPRESSED_BIT)
+		return decompress_payload();
+
 	if ((layout.get_required_size() + sizeof(MemoryMappedHeader)) < file->get_size())
 		return false;
 	if (header->payload_size != layout.get_required_size())
@@ -33,6 +33,7 @@ enum MemoryMappedTextureFlagBits
 {
 	MEMORY_MAPPED_TEXTURE_CUBE_MAP_COMPATIBLE_BIT = 1 << 0,
 	MEMORY_MAPPED_TEXTURE_GENERATE_MIPMAP_ON_LOAD_BIT = 1 << 1,
+	MEMORY_MAPPED_TEXTURE_COMPRESSED_BIT = 1 << 2,
 	MEMORY_MAPPED_TEXTURE_SWIZZLE_R_SHIFT = 16,
 	MEMORY_MAPPED_TEXTURE_SWIZZLE_G_SHIFT = 19,
 	MEMORY_MAPPED_TEXTURE_SWIZZLE_B_SHIFT = 22,
@@ -58,6 +59,14 @@ public:
 	bool map_copy(const void *mapped, size_t size);
 	bool map_write_scratch();
 	bool copy_to_path(const std::string &path);
+
+	// Writes a copy where each mip level payload is LZ4-compressed
+	// (MEMORY_MAPPED_TEXTURE_COMPRESSED_BIT is set in the stored flags).
+	// map_read() detects the bit and inflates into a scratch copy, so readers
+	// always observe the plain layout; plain files keep the zero-copy mmap path.
+	// Trades decode CPU time for I/O on archive-bound deployments.
+	bool copy_to_path_compressed(const std::string &path);
+
 	void make_local_copy();
 
 	inline const Vulkan::TextureFormatLayout &get_layout() const
@@ -81,6 +90,8 @@ public:
 	}
 
 private:
+	bool decompress_payload();
+
 	Vulkan::TextureFormatLayout layout;
 	std::unique_ptr<Granite::File> file;
 	uint8_t *mapped = nullptr;
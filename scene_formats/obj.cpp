@@ -25,6 +25,9 @@
 #include "memory_mapped_texture.hpp"
 #include "texture_files.hpp"
 #include "string_helpers.hpp"
+#include "thread_group.hpp"
+#include <stdlib.h>
+#include <string.h>
 
 using namespace std;
 using namespace Util;
@@ -315,58 +318,75 @@ void Parser::emit_gltf_pbr_metallic_roughness(const std::string &metallic_path,
 	}
 }
 
-void Parser::emit_vertex(const OBJVertex * const *face)
+// Resolved face corner. Indices are absolute 0-based, -1 when absent.
+struct FaceVertex
 {
-	// Positions
-	for (unsigned i = 0; i < 3; i++)
-	{
-		auto &p = face[i]->operator[](0);
+	int p;
+	int u;
+	int n;
+};
 
-		if (!p.empty())
-		{
-			int index = stoi(p);
-			if (index < 0)
-				index = int(positions.size()) + index;
-			else
-				index--;
-
-			if (index < 0 || index >= int(positions.size()))
-				throw logic_error("Index out of bounds.");
-			current_positions.push_back(positions[index]);
-		}
+// Run of faces sharing one material binding.
+struct FaceSegment
+{
+	std::string material;
+	// false means the segment inherits whatever material was active when
+	// the chunk started; resolved during the serial stitch.
+	bool has_material = false;
+	std::vector<FaceVertex> vertices;
+};
+
+struct ParseChunk
+{
+	const char *begin = nullptr;
+	const char *end = nullptr;
 
-		if (face[i]->size() == 1)
-			continue;
+	// Pass 1 counts and their prefix sums.
+	size_t num_v = 0, num_vt = 0, num_vn = 0;
+	size_t base_v = 0, base_vt = 0, base_vn = 0;
 
-		auto &u = face[i]->operator[](1);
-		auto &n = face[i]->operator[](2);
+	std::vector<FaceSegment> segments;
+	std::vector<std::string> mtllibs;
+	// Exceptions cannot cross worker threads.
+	std::string error;
+};
 
-		if (!u.empty())
-		{
-			int index = stoi(u);
-			if (index < 0)
-				index = int(uvs.size()) + index;
-			else
-				index--;
-
-			if (index < 0 || index >= int(uvs.size()))
-				throw logic_error("Index out of bounds.");
-			current_uvs.push_back(uvs[index]);
-		}
+static const char *skip_blank(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p;
+}
 
-		if (!n.empty())
-		{
-			int index = stoi(n);
-			if (index < 0)
-				index = int(normals.size()) + index;
-			else
-				index--;
-
-			if (index < 0 || index >= int(normals.size()))
-				throw logic_error("Index out of bounds.");
-			current_normals.push_back(normals[index]);
-		}
-	}
+static const char *find_token_end(const char *p, const char *end)
+{
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+		p++;
+	return p;
+}
+
+// Trims comments, returns [ident_begin, ident_end) and advances *rest past
+// the identifier. Returns false for blank and comment-only lines.
+static bool parse_ident(const char *p, const char *&line_end, const char **rest,
+                        const char **ident_begin, const char **ident_end)
+{
+	if (auto *comment = static_cast<const char *>(memchr(p, '#', line_end - p)))
+		line_end = comment;
+
+	p = skip_blank(p, line_end);
+	if (p == line_end)
+		return false;
+
+	*ident_begin = p;
+	*ident_end = find_token_end(p, line_end);
+	*rest = *ident_end;
+	return true;
+}
+
+static bool ident_is(const char *begin, const char *end, const char *str)
+{
+	size_t len = end - begin;
+	return len == strlen(str) && memcmp(begin, str, len) == 0;
 }
 
 void Parser::load_material_library(const std::string &path)
@@ -454,68 +474,264 @@ void Parser::load_material_library(const std::string &path)
 		emit_gltf_base_color(base_color, alpha_mask);
 }
 
+// Multi-gigabyte photogrammetry OBJs are too slow to parse line by line on
+// one thread. The buffer is carved into chunks at line boundaries and parsed
+// on ThreadGroup workers in two passes: pass 1 counts v/vt/vn declarations,
+// a prefix sum over the chunk counts assigns each chunk its slice of the
+// attribute arrays, and pass 2 tokenizes in place with no per-line string
+// allocation. Faces land in per-chunk segments which a cheap serial stitch
+// walks in file order, carrying the active material across chunk boundaries.
 Parser::Parser(const std::string &path)
 {
 	string obj;
 	if (!Global::filesystem()->read_file_to_string(path, obj))
 		throw runtime_error("Failed to load OBJ.");
 
-	vector<string> lines = split_no_empty(obj, "\n");
-	for (auto &line : lines)
+	// The string's NUL terminator keeps strtof from running off the end.
+	const char *data = obj.data();
+	size_t size = obj.size();
+
+	auto *group = Global::thread_group();
+	const size_t target_chunk_size = 4 * 1024 * 1024;
+	size_t num_chunks = 1;
+	if (group && group->get_num_threads() > 1 && size > target_chunk_size)
+		num_chunks = min<size_t>(size / target_chunk_size, group->get_num_threads() * 4);
+
+	vector<ParseChunk> chunks(num_chunks);
+	size_t chunk_begin = 0;
+	for (size_t i = 0; i < num_chunks; i++)
 	{
-		line = strip_whitespace(line);
-		auto comment_index = line.find_first_of('#');
-		if (comment_index != string::npos)
-			line = line.substr(comment_index, string::npos);
+		size_t chunk_end = max(((i + 1) * size) / num_chunks, chunk_begin);
+		// Snap forward to a line boundary so no line straddles two chunks.
+		while (chunk_end < size && data[chunk_end - 1] != '\n')
+			chunk_end++;
+		if (i + 1 == num_chunks)
+			chunk_end = size;
+		chunks[i].begin = data + chunk_begin;
+		chunks[i].end = data + chunk_end;
+		chunk_begin = chunk_end;
+	}
 
-		auto elements = split_no_empty(line, " ");
-		if (elements.empty())
-			continue;
+	const auto run_parallel = [&](const function<void (ParseChunk &)> &pass) {
+		if (group && num_chunks > 1)
+		{
+			group->parallel_for(num_chunks, 1, [&](size_t begin_index, size_t end_index) {
+				for (size_t i = begin_index; i < end_index; i++)
+					pass(chunks[i]);
+			});
+		}
+		else
+			for (auto &chunk : chunks)
+				pass(chunk);
+	};
+
+	run_parallel([](ParseChunk &chunk) {
+		const char *p = chunk.begin;
+		while (p < chunk.end)
+		{
+			auto *line_end = static_cast<const char *>(memchr(p, '\n', chunk.end - p));
+			if (!line_end)
+				line_end = chunk.end;
+			const char *next = line_end + 1;
 
-		auto &ident = elements.front();
-		if (ident == "mtllib")
-			load_material_library(Path::relpath(path, elements.at(1)));
-		else if (ident == "v")
-			positions.push_back(vec3(stof(elements.at(1)), stof(elements.at(2)), stof(elements.at(3))));
-		else if (ident == "vn")
-			normals.push_back(vec3(stof(elements.at(1)), stof(elements.at(2)), stof(elements.at(3))));
-		else if (ident == "vt")
-			uvs.push_back(vec2(stof(elements.at(1)), 1.0f - stof(elements.at(2))));
-		else if (ident == "usemtl")
+			const char *rest, *ib, *ie;
+			if (parse_ident(p, line_end, &rest, &ib, &ie))
+			{
+				if (ident_is(ib, ie, "v"))
+					chunk.num_v++;
+				else if (ident_is(ib, ie, "vt"))
+					chunk.num_vt++;
+				else if (ident_is(ib, ie, "vn"))
+					chunk.num_vn++;
+			}
+			p = next;
+		}
+	});
+
+	// A serial scan over the per-chunk totals stands in for the prefix sum;
+	// with tens of chunks it is noise next to the parse itself.
+	size_t total_v = 0, total_vt = 0, total_vn = 0;
+	for (auto &chunk : chunks)
+	{
+		chunk.base_v = total_v;
+		chunk.base_vt = total_vt;
+		chunk.base_vn = total_vn;
+		total_v += chunk.num_v;
+		total_vt += chunk.num_vt;
+		total_vn += chunk.num_vn;
+	}
+	positions.resize(total_v);
+	uvs.resize(total_vt);
+	normals.resize(total_vn);
+
+	run_parallel([&](ParseChunk &chunk) {
+		size_t local_v = 0, local_vt = 0, local_vn = 0;
+		chunk.segments.emplace_back();
+
+		const char *p = chunk.begin;
+		while (p < chunk.end && chunk.error.empty())
 		{
-			auto itr = material_library.find(elements.at(1));
-			if (itr == end(material_library))
+			auto *line_end = static_cast<const char *>(memchr(p, '\n', chunk.end - p));
+			if (!line_end)
+				line_end = chunk.end;
+			const char *next = line_end + 1;
+
+			const char *rest, *ib, *ie;
+			if (!parse_ident(p, line_end, &rest, &ib, &ie))
+			{
+				p = next;
+				continue;
+			}
+
+			char *endp;
+			if (ident_is(ib, ie, "v"))
+			{
+				float x = strtof(rest, &endp);
+				float y = strtof(endp, &endp);
+				float z = strtof(endp, &endp);
+				positions[chunk.base_v + local_v++] = vec3(x, y, z);
+			}
+			else if (ident_is(ib, ie, "vt"))
+			{
+				float x = strtof(rest, &endp);
+				float y = strtof(endp, &endp);
+				uvs[chunk.base_vt + local_vt++] = vec2(x, 1.0f - y);
+			}
+			else if (ident_is(ib, ie, "vn"))
+			{
+				float x = strtof(rest, &endp);
+				float y = strtof(endp, &endp);
+				float z = strtof(endp, &endp);
+				normals[chunk.base_vn + local_vn++] = vec3(x, y, z);
+			}
+			else if (ident_is(ib, ie, "f"))
+			{
+				enum { MaxCorners = 64 };
+				FaceVertex corners[MaxCorners];
+				unsigned num_corners = 0;
+
+				const char *q = rest;
+				for (;;)
+				{
+					q = skip_blank(q, line_end);
+					if (q == line_end)
+						break;
+					if (num_corners == MaxCorners)
+					{
+						chunk.error = "Too many vertices in face.";
+						break;
+					}
+
+					FaceVertex fv = { -1, -1, -1 };
+					long pi = strtol(q, &endp, 10);
+					if (endp == q)
+					{
+						chunk.error = "Malformed face.";
+						break;
+					}
+					// Negative indices are relative to the declarations seen
+					// so far; the chunk base plus the local running count
+					// resolves them without global state.
+					fv.p = pi < 0 ? int(chunk.base_v + local_v + pi) : int(pi - 1);
+
+					if (*endp == '/')
+					{
+						const char *t = endp + 1;
+						if (*t != '/')
+						{
+							long ui = strtol(t, &endp, 10);
+							if (endp != t)
+								fv.u = ui < 0 ? int(chunk.base_vt + local_vt + ui) : int(ui - 1);
+						}
+						else
+							endp = const_cast<char *>(t);
+
+						if (*endp == '/')
+						{
+							t = endp + 1;
+							long ni = strtol(t, &endp, 10);
+							if (endp != t)
+								fv.n = ni < 0 ? int(chunk.base_vn + local_vn + ni) : int(ni - 1);
+						}
+					}
+
+					corners[num_corners++] = fv;
+					q = find_token_end(endp, line_end);
+				}
+
+				auto &segment = chunk.segments.back();
+				for (unsigned c = 2; c < num_corners; c++)
+				{
+					segment.vertices.push_back(corners[0]);
+					segment.vertices.push_back(corners[c - 1]);
+					segment.vertices.push_back(corners[c]);
+				}
+			}
+			else if (ident_is(ib, ie, "usemtl"))
+			{
+				const char *q = skip_blank(rest, line_end);
+				chunk.segments.emplace_back();
+				chunk.segments.back().has_material = true;
+				chunk.segments.back().material = string(q, find_token_end(q, line_end));
+			}
+			else if (ident_is(ib, ie, "mtllib"))
 			{
-				LOGE("Material %s does not exist!\n",
-				     elements.at(1).c_str());
-				throw runtime_error("Material does not exist.");
+				const char *q = skip_blank(rest, line_end);
+				chunk.mtllibs.push_back(string(q, find_token_end(q, line_end)));
 			}
-			int index = int(itr->second);
-			if (index != current_material)
-				flush_mesh();
-			current_material = index;
+			p = next;
 		}
-		else if (ident == "f")
+	});
+
+	for (auto &chunk : chunks)
+		if (!chunk.error.empty())
+			throw runtime_error(chunk.error);
+
+	// Material libraries load serially; they hit the filesystem and repack
+	// textures, none of which belongs on the parse workers.
+	for (auto &chunk : chunks)
+		for (auto &lib : chunk.mtllibs)
+			load_material_library(Path::relpath(path, lib));
+
+	// Serial stitch in file order, carrying the active material across
+	// chunk boundaries and gathering the referenced attributes.
+	for (auto &chunk : chunks)
+	{
+		for (auto &segment : chunk.segments)
 		{
-			if (elements.size() == 5)
+			if (segment.has_material)
 			{
-				auto v0 = split(elements.at(1), "/");
-				auto v1 = split(elements.at(2), "/");
-				auto v2 = split(elements.at(3), "/");
-				auto v3 = split(elements.at(4), "/");
-
-				const OBJVertex *f0[3] = { &v0, &v1, &v2 };
-				const OBJVertex *f1[3] = { &v0, &v2, &v3 };
-				emit_vertex(f0);
-				emit_vertex(f1);
+				auto itr = material_library.find(segment.material);
+				if (itr == end(material_library))
+				{
+					LOGE("Material %s does not exist!\n", segment.material.c_str());
+					throw runtime_error("Material does not exist.");
+				}
+				int index = int(itr->second);
+				if (index != current_material)
+					flush_mesh();
+				current_material = index;
 			}
-			else if (elements.size() == 4)
+
+			for (auto &fv : segment.vertices)
 			{
-				auto v0 = split(elements.at(1), "/");
-				auto v1 = split(elements.at(2), "/");
-				auto v2 = split(elements.at(3), "/");
-				const OBJVertex *f0[3] = { &v0, &v1, &v2 };
-				emit_vertex(f0);
+				if (fv.p < 0 || fv.p >= int(positions.size()))
+					throw logic_error("Index out of bounds.");
+				current_positions.push_back(positions[fv.p]);
+
+				if (fv.u >= 0)
+				{
+					if (fv.u >= int(uvs.size()))
+						throw logic_error("Index out of bounds.");
+					current_uvs.push_back(uvs[fv.u]);
+				}
+
+				if (fv.n >= 0)
+				{
+					if (fv.n >= int(normals.size()))
+						throw logic_error("Index out of bounds.");
+					current_normals.push_back(normals[fv.n]);
+				}
 			}
 		}
 	}
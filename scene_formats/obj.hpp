@@ -69,8 +69,6 @@ private:
 	void load_material_library(const std::string &path);
 	void flush_mesh();
 
-	using OBJVertex = std::vector<std::string>;
-	void emit_vertex(const OBJVertex * const *face);
 	void emit_gltf_pbr_metallic_roughness(const std::string &metallic, const std::string &roughness);
 	void emit_gltf_base_color(const std::string &metallic, const std::string &roughness);
 	Node root_node;
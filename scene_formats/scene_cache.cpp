@@ -0,0 +1,485 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "scene_cache.hpp"
+#include "filesystem.hpp"
+#include "logging.hpp"
+#include <string.h>
+
+using namespace std;
+
+namespace Granite
+{
+namespace SceneFormats
+{
+static const char MAGIC[16] = "GRANITE SCENE01";
+
+struct SceneCacheHeader
+{
+	char magic[16];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t validation_key;
+};
+static const uint32_t SCENE_CACHE_VERSION = 1;
+
+namespace
+{
+struct BlobWriter
+{
+	vector<uint8_t> blob;
+
+	void write_raw(const void *data, size_t size)
+	{
+		blob.insert(end(blob), static_cast<const uint8_t *>(data),
+		            static_cast<const uint8_t *>(data) + size);
+	}
+
+	template <typename T>
+	void write_pod(const T &t)
+	{
+		write_raw(&t, sizeof(t));
+	}
+
+	void write_string(const string &str)
+	{
+		write_pod(uint64_t(str.size()));
+		write_raw(str.data(), str.size());
+	}
+
+	template <typename T>
+	void write_pod_vector(const vector<T> &v)
+	{
+		write_pod(uint64_t(v.size()));
+		write_raw(v.data(), v.size() * sizeof(T));
+	}
+};
+
+struct BlobReader
+{
+	const uint8_t *ptr = nullptr;
+	const uint8_t *end_ptr = nullptr;
+
+	bool read_raw(void *data, size_t size)
+	{
+		if (size_t(end_ptr - ptr) < size)
+			return false;
+		memcpy(data, ptr, size);
+		ptr += size;
+		return true;
+	}
+
+	template <typename T>
+	bool read_pod(T &t)
+	{
+		return read_raw(&t, sizeof(t));
+	}
+
+	bool read_count(uint64_t &count, size_t element_size)
+	{
+		if (!read_pod(count))
+			return false;
+		// A truncated or corrupt blob cannot ask for more elements than
+		// there are bytes left.
+		return count <= uint64_t(end_ptr - ptr) / element_size;
+	}
+
+	bool read_string(string &str)
+	{
+		uint64_t size;
+		if (!read_count(size, 1))
+			return false;
+		str.assign(reinterpret_cast<const char *>(ptr), size_t(size));
+		ptr += size;
+		return true;
+	}
+
+	template <typename T>
+	bool read_pod_vector(vector<T> &v)
+	{
+		uint64_t count;
+		if (!read_count(count, sizeof(T)))
+			return false;
+		v.resize(size_t(count));
+		return read_raw(v.data(), size_t(count) * sizeof(T));
+	}
+};
+}
+
+static void write_mesh(BlobWriter &writer, const Mesh &mesh)
+{
+	writer.write_pod_vector(mesh.positions);
+	writer.write_pod_vector(mesh.attributes);
+	writer.write_pod(mesh.position_stride);
+	writer.write_pod(mesh.attribute_stride);
+	writer.write_pod(mesh.attribute_layout);
+	writer.write_pod_vector(mesh.indices);
+	writer.write_pod(mesh.index_type);
+	writer.write_pod(mesh.topology);
+	writer.write_pod(mesh.material_index);
+	writer.write_pod(mesh.has_material);
+	writer.write_pod(mesh.primitive_restart);
+	writer.write_pod(mesh.static_aabb);
+	writer.write_pod(mesh.count);
+}
+
+static bool read_mesh(BlobReader &reader, Mesh &mesh)
+{
+	return reader.read_pod_vector(mesh.positions) &&
+	       reader.read_pod_vector(mesh.attributes) &&
+	       reader.read_pod(mesh.position_stride) &&
+	       reader.read_pod(mesh.attribute_stride) &&
+	       reader.read_pod(mesh.attribute_layout) &&
+	       reader.read_pod_vector(mesh.indices) &&
+	       reader.read_pod(mesh.index_type) &&
+	       reader.read_pod(mesh.topology) &&
+	       reader.read_pod(mesh.material_index) &&
+	       reader.read_pod(mesh.has_material) &&
+	       reader.read_pod(mesh.primitive_restart) &&
+	       reader.read_pod(mesh.static_aabb) &&
+	       reader.read_pod(mesh.count);
+}
+
+static void write_material(BlobWriter &writer, const MaterialInfo &material)
+{
+	writer.write_string(material.base_color.path);
+	writer.write_string(material.normal.path);
+	writer.write_string(material.metallic_roughness.path);
+	writer.write_string(material.occlusion.path);
+	writer.write_string(material.emissive.path);
+	writer.write_pod(material.uniform_base_color);
+	writer.write_pod(material.uniform_emissive_color);
+	writer.write_pod(material.uniform_metallic);
+	writer.write_pod(material.uniform_roughness);
+	writer.write_pod(material.normal_scale);
+	writer.write_pod(material.pipeline);
+	writer.write_pod(material.sampler);
+	writer.write_pod(material.two_sided);
+	writer.write_pod(material.bandlimited_pixel);
+}
+
+static bool read_material(BlobReader &reader, MaterialInfo &material)
+{
+	return reader.read_string(material.base_color.path) &&
+	       reader.read_string(material.normal.path) &&
+	       reader.read_string(material.metallic_roughness.path) &&
+	       reader.read_string(material.occlusion.path) &&
+	       reader.read_string(material.emissive.path) &&
+	       reader.read_pod(material.uniform_base_color) &&
+	       reader.read_pod(material.uniform_emissive_color) &&
+	       reader.read_pod(material.uniform_metallic) &&
+	       reader.read_pod(material.uniform_roughness) &&
+	       reader.read_pod(material.normal_scale) &&
+	       reader.read_pod(material.pipeline) &&
+	       reader.read_pod(material.sampler) &&
+	       reader.read_pod(material.two_sided) &&
+	       reader.read_pod(material.bandlimited_pixel);
+}
+
+static void write_node(BlobWriter &writer, const Node &node)
+{
+	writer.write_pod_vector(node.meshes);
+	writer.write_pod_vector(node.children);
+	writer.write_pod(node.transform);
+	writer.write_pod(node.skin);
+	writer.write_pod(node.has_skin);
+	writer.write_pod(node.joint);
+}
+
+static bool read_node(BlobReader &reader, Node &node)
+{
+	return reader.read_pod_vector(node.meshes) &&
+	       reader.read_pod_vector(node.children) &&
+	       reader.read_pod(node.transform) &&
+	       reader.read_pod(node.skin) &&
+	       reader.read_pod(node.has_skin) &&
+	       reader.read_pod(node.joint);
+}
+
+static void write_channel(BlobWriter &writer, const AnimationChannel &channel)
+{
+	writer.write_pod(channel.node_index);
+	writer.write_pod(channel.type);
+	writer.write_pod_vector(channel.timestamps);
+	writer.write_pod_vector(channel.linear.values);
+	writer.write_pod_vector(channel.spherical.values);
+	writer.write_pod_vector(channel.cubic.values);
+	writer.write_pod(channel.joint_index);
+	writer.write_pod(channel.joint);
+}
+
+static bool read_channel(BlobReader &reader, AnimationChannel &channel)
+{
+	return reader.read_pod(channel.node_index) &&
+	       reader.read_pod(channel.type) &&
+	       reader.read_pod_vector(channel.timestamps) &&
+	       reader.read_pod_vector(channel.linear.values) &&
+	       reader.read_pod_vector(channel.spherical.values) &&
+	       reader.read_pod_vector(channel.cubic.values) &&
+	       reader.read_pod(channel.joint_index) &&
+	       reader.read_pod(channel.joint);
+}
+
+static void write_animation(BlobWriter &writer, const Animation &animation)
+{
+	writer.write_pod(uint64_t(animation.channels.size()));
+	for (auto &channel : animation.channels)
+		write_channel(writer, channel);
+	writer.write_string(animation.name);
+	writer.write_pod(animation.length);
+	writer.write_pod(animation.skin_compat);
+	writer.write_pod(animation.skinning);
+}
+
+static bool read_animation(BlobReader &reader, Animation &animation)
+{
+	uint64_t count;
+	if (!reader.read_count(count, 1))
+		return false;
+	animation.channels.resize(size_t(count));
+	for (auto &channel : animation.channels)
+		if (!read_channel(reader, channel))
+			return false;
+	return reader.read_string(animation.name) &&
+	       reader.read_pod(animation.length) &&
+	       reader.read_pod(animation.skin_compat) &&
+	       reader.read_pod(animation.skinning);
+}
+
+static void write_bone(BlobWriter &writer, const Skin::Bone &bone)
+{
+	writer.write_pod(bone.index);
+	writer.write_pod(uint64_t(bone.children.size()));
+	for (auto &child : bone.children)
+		write_bone(writer, child);
+}
+
+static bool read_bone(BlobReader &reader, Skin::Bone &bone)
+{
+	uint64_t count;
+	if (!reader.read_pod(bone.index) || !reader.read_count(count, 1))
+		return false;
+	bone.children.resize(size_t(count));
+	for (auto &child : bone.children)
+		if (!read_bone(reader, child))
+			return false;
+	return true;
+}
+
+static void write_skin(BlobWriter &writer, const Skin &skin)
+{
+	writer.write_pod_vector(skin.inverse_bind_pose);
+	writer.write_pod_vector(skin.joint_transforms);
+	writer.write_pod(uint64_t(skin.skeletons.size()));
+	for (auto &bone : skin.skeletons)
+		write_bone(writer, bone);
+	writer.write_pod(skin.skin_compat);
+}
+
+static bool read_skin(BlobReader &reader, Skin &skin)
+{
+	if (!reader.read_pod_vector(skin.inverse_bind_pose) ||
+	    !reader.read_pod_vector(skin.joint_transforms))
+		return false;
+	uint64_t count;
+	if (!reader.read_count(count, 1))
+		return false;
+	skin.skeletons.resize(size_t(count));
+	for (auto &bone : skin.skeletons)
+		if (!read_bone(reader, bone))
+			return false;
+	return reader.read_pod(skin.skin_compat);
+}
+
+static void write_camera(BlobWriter &writer, const CameraInfo &camera)
+{
+	writer.write_string(camera.name);
+	writer.write_pod(camera.node_index);
+	writer.write_pod(camera.type);
+	writer.write_pod(camera.aspect_ratio);
+	writer.write_pod(camera.znear);
+	writer.write_pod(camera.zfar);
+	writer.write_pod(camera.yfov);
+	writer.write_pod(camera.xmag);
+	writer.write_pod(camera.ymag);
+	writer.write_pod(camera.attached_to_node);
+}
+
+static bool read_camera(BlobReader &reader, CameraInfo &camera)
+{
+	return reader.read_string(camera.name) &&
+	       reader.read_pod(camera.node_index) &&
+	       reader.read_pod(camera.type) &&
+	       reader.read_pod(camera.aspect_ratio) &&
+	       reader.read_pod(camera.znear) &&
+	       reader.read_pod(camera.zfar) &&
+	       reader.read_pod(camera.yfov) &&
+	       reader.read_pod(camera.xmag) &&
+	       reader.read_pod(camera.ymag) &&
+	       reader.read_pod(camera.attached_to_node);
+}
+
+static void write_light(BlobWriter &writer, const LightInfo &light)
+{
+	writer.write_string(light.name);
+	writer.write_pod(light.node_index);
+	writer.write_pod(light.type);
+	writer.write_pod(light.inner_cone);
+	writer.write_pod(light.outer_cone);
+	writer.write_pod(light.color);
+	writer.write_pod(light.range);
+	writer.write_pod(light.attached_to_node);
+}
+
+static bool read_light(BlobReader &reader, LightInfo &light)
+{
+	return reader.read_string(light.name) &&
+	       reader.read_pod(light.node_index) &&
+	       reader.read_pod(light.type) &&
+	       reader.read_pod(light.inner_cone) &&
+	       reader.read_pod(light.outer_cone) &&
+	       reader.read_pod(light.color) &&
+	       reader.read_pod(light.range) &&
+	       reader.read_pod(light.attached_to_node);
+}
+
+static void write_environment(BlobWriter &writer, const EnvironmentInfo &environment)
+{
+	writer.write_string(environment.cube.path);
+	writer.write_string(environment.reflection.path);
+	writer.write_string(environment.irradiance.path);
+	writer.write_pod(environment.intensity);
+	writer.write_pod(environment.fog);
+}
+
+static bool read_environment(BlobReader &reader, EnvironmentInfo &environment)
+{
+	return reader.read_string(environment.cube.path) &&
+	       reader.read_string(environment.reflection.path) &&
+	       reader.read_string(environment.irradiance.path) &&
+	       reader.read_pod(environment.intensity) &&
+	       reader.read_pod(environment.fog);
+}
+
+static void write_scene_nodes(BlobWriter &writer, const SceneNodes &scene)
+{
+	writer.write_string(scene.name);
+	writer.write_pod_vector(scene.node_indices);
+}
+
+static bool read_scene_nodes(BlobReader &reader, SceneNodes &scene)
+{
+	return reader.read_string(scene.name) &&
+	       reader.read_pod_vector(scene.node_indices);
+}
+
+template <typename T, typename WriteFunc>
+static void write_section(BlobWriter &writer, const vector<T> &elements, const WriteFunc &func)
+{
+	writer.write_pod(uint64_t(elements.size()));
+	for (auto &element : elements)
+		func(writer, element);
+}
+
+template <typename T, typename ReadFunc>
+static bool read_section(BlobReader &reader, vector<T> &elements, const ReadFunc &func)
+{
+	uint64_t count;
+	if (!reader.read_count(count, 1))
+		return false;
+	elements.resize(size_t(count));
+	for (auto &element : elements)
+		if (!func(reader, element))
+			return false;
+	return true;
+}
+
+bool save_scene_cache(const string &path, uint64_t validation_key, const SceneCache &scene)
+{
+	BlobWriter writer;
+
+	SceneCacheHeader header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = SCENE_CACHE_VERSION;
+	header.validation_key = validation_key;
+	writer.write_pod(header);
+
+	write_section(writer, scene.meshes, write_mesh);
+	write_section(writer, scene.materials, write_material);
+	write_section(writer, scene.nodes, write_node);
+	write_section(writer, scene.animations, write_animation);
+	write_section(writer, scene.skins, write_skin);
+	write_section(writer, scene.cameras, write_camera);
+	write_section(writer, scene.lights, write_light);
+	write_section(writer, scene.environments, write_environment);
+	write_section(writer, scene.scenes, write_scene_nodes);
+	writer.write_pod(scene.default_scene);
+
+	if (!Global::filesystem()->write_buffer_to_file(path, writer.blob.data(), writer.blob.size()))
+	{
+		LOGE("Failed to write scene cache: %s\n", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool load_scene_cache(const string &path, uint64_t validation_key, SceneCache &scene)
+{
+	auto file = Global::filesystem()->open(path, FileMode::ReadOnly);
+	if (!file)
+		return false;
+
+	auto *mapped = static_cast<const uint8_t *>(file->map());
+	if (!mapped)
+		return false;
+
+	BlobReader reader;
+	reader.ptr = mapped;
+	reader.end_ptr = mapped + file->get_size();
+
+	SceneCacheHeader header;
+	if (!reader.read_pod(header))
+		return false;
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+		return false;
+	if (header.version != SCENE_CACHE_VERSION)
+		return false;
+	if (header.validation_key != validation_key)
+		return false;
+
+	bool ok = read_section(reader, scene.meshes, read_mesh) &&
+	          read_section(reader, scene.materials, read_material) &&
+	          read_section(reader, scene.nodes, read_node) &&
+	          read_section(reader, scene.animations, read_animation) &&
+	          read_section(reader, scene.skins, read_skin) &&
+	          read_section(reader, scene.cameras, read_camera) &&
+	          read_section(reader, scene.lights, read_light) &&
+	          read_section(reader, scene.environments, read_environment) &&
+	          read_section(reader, scene.scenes, read_scene_nodes) &&
+	          reader.read_pod(scene.default_scene);
+
+	if (!ok)
+		LOGE("Scene cache is corrupt, falling back to full parse: %s\n", path.c_str());
+	return ok;
+}
+}
+}
@@ -0,0 +1,59 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "scene_formats.hpp"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace Granite
+{
+namespace SceneFormats
+{
+// The fully baked output of a scene parse. Serializing this after the first
+// parse lets steady-state reloads bypass JSON parsing and attribute
+// repacking entirely, in the same spirit as memory_mapped_texture.cpp for
+// textures.
+struct SceneCache
+{
+	std::vector<Mesh> meshes;
+	std::vector<MaterialInfo> materials;
+	std::vector<Node> nodes;
+	std::vector<Animation> animations;
+	std::vector<Skin> skins;
+	std::vector<CameraInfo> cameras;
+	std::vector<LightInfo> lights;
+	std::vector<EnvironmentInfo> environments;
+	std::vector<SceneNodes> scenes;
+	uint32_t default_scene = 0;
+};
+
+// The validation key should fold in whatever identifies the source as
+// unchanged (path, size, timestamp); a key mismatch reads as a cache miss.
+// Both return false on any inconsistency, in which case the caller falls
+// back to a full parse.
+bool save_scene_cache(const std::string &path, uint64_t validation_key, const SceneCache &scene);
+bool load_scene_cache(const std::string &path, uint64_t validation_key, SceneCache &scene);
+}
+}
@@ -21,6 +21,7 @@
  */
 
 #include "scene_formats.hpp"
+#include <float.h>
 #include <string.h>
 #include <unordered_map>
 #include <unordered_set>
@@ -28,6 +29,7 @@
 #include <mikktspace/mikktspace.h>
 #include "meshoptimizer.h"
 #include "mikktspace.h"
+#include "texture_format.hpp"
 
 using namespace Util;
 using namespace std;
@@ -262,6 +264,17 @@ Mesh mesh_optimize_index_buffer(const Mesh &mesh, bool stripify)
 	meshopt_optimizeVertexCache(index_buffer.data(), index_buffer.data(), index_buffer.size(),
 	                            vertex_count);
 
+	// Reorder triangles front-to-back-ish to reduce overdraw within a small
+	// vertex cache degradation budget. Needs raw float positions, so
+	// quantized position formats skip this step.
+	auto position_format = mesh.attribute_layout[ecast(MeshAttribute::Position)].format;
+	if (position_format == VK_FORMAT_R32G32B32_SFLOAT || position_format == VK_FORMAT_R32G32B32A32_SFLOAT)
+	{
+		meshopt_optimizeOverdraw(index_buffer.data(), index_buffer.data(), index_buffer.size(),
+		                         reinterpret_cast<const float *>(optimized.positions.data()),
+		                         vertex_count, optimized.position_stride, 1.05f);
+	}
+
 	// Remap vertex fetch to get contiguous indices as much as possible.
 	vector<uint32_t> remap_table(optimized.positions.size() / optimized.position_stride);
 	meshopt_optimizeVertexFetchRemap(remap_table.data(), index_buffer.data(), index_buffer.size(), vertex_count);
@@ -325,6 +338,246 @@ Mesh mesh_optimize_index_buffer(const Mesh &mesh, bool stripify)
 	return optimized;
 }
 
+Mesh mesh_generate_lods(const Mesh &mesh, unsigned num_levels)
+{
+	if (mesh.topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST || mesh.primitive_restart)
+		return mesh;
+	if (num_levels < 2 || mesh.indices.empty() || mesh.count < 3)
+		return mesh;
+
+	// The simplifier needs raw float positions, so this has to run before
+	// attribute quantization.
+	auto position_format = mesh.attribute_layout[ecast(MeshAttribute::Position)].format;
+	if (position_format != VK_FORMAT_R32G32B32_SFLOAT && position_format != VK_FORMAT_R32G32B32A32_SFLOAT)
+		return mesh;
+
+	size_t vertex_count = mesh.positions.size() / mesh.position_stride;
+
+	vector<uint32_t> lod_indices(mesh.count);
+	if (mesh.index_type == VK_INDEX_TYPE_UINT16)
+	{
+		auto *indices = reinterpret_cast<const uint16_t *>(mesh.indices.data());
+		for (unsigned i = 0; i < mesh.count; i++)
+			lod_indices[i] = indices[i];
+	}
+	else
+		memcpy(lod_indices.data(), mesh.indices.data(), mesh.count * sizeof(uint32_t));
+
+	Mesh result = mesh;
+	result.lods.clear();
+	result.lods.push_back({ 0, mesh.count, 0.0f });
+
+	vector<uint32_t> simplified(lod_indices.size());
+
+	for (unsigned level = 1; level < num_levels; level++)
+	{
+		// Quarter the triangle count per level, with an error budget growing
+		// at the same rate.
+		size_t target_index_count = (size_t(mesh.count) >> (2 * level)) / 3 * 3;
+		if (target_index_count < 3 * 16)
+			break;
+		float target_error = 0.01f * float(1u << (2 * (level - 1)));
+
+		size_t simplified_count = meshopt_simplify(simplified.data(),
+		                                           lod_indices.data(), lod_indices.size(),
+		                                           reinterpret_cast<const float *>(mesh.positions.data()),
+		                                           vertex_count, mesh.position_stride,
+		                                           target_index_count, target_error);
+
+		// The simplifier hit a topological wall; deeper levels won't fare better.
+		if (!simplified_count || simplified_count >= lod_indices.size())
+			break;
+
+		uint32_t offset = uint32_t(result.indices.size() /
+		                           (result.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)));
+
+		if (result.index_type == VK_INDEX_TYPE_UINT16)
+		{
+			size_t base = result.indices.size();
+			result.indices.resize(base + simplified_count * sizeof(uint16_t));
+			auto *out_indices = reinterpret_cast<uint16_t *>(result.indices.data() + base);
+			for (size_t i = 0; i < simplified_count; i++)
+				out_indices[i] = uint16_t(simplified[i]);
+		}
+		else
+		{
+			size_t base = result.indices.size();
+			result.indices.resize(base + simplified_count * sizeof(uint32_t));
+			memcpy(result.indices.data() + base, simplified.data(), simplified_count * sizeof(uint32_t));
+		}
+
+		result.lods.push_back({ offset, uint32_t(simplified_count), target_error });
+		lod_indices.assign(simplified.begin(), simplified.begin() + simplified_count);
+	}
+
+	if (result.lods.size() < 2)
+		result.lods.clear();
+	return result;
+}
+
+static uint32_t quantize_attr_a2bgr10snorm(const vec4 &v)
+{
+	vec4 input = v * vec4(0x1ff, 0x1ff, 0x1ff, 1);
+	input = clamp(round(input), vec4(-0x1ff, -0x1ff, -0x1ff, -1), vec4(0x1ff, 0x1ff, 0x1ff, 1));
+	ivec4 q(input);
+	return (uint32_t(q.w & 3) << 30) |
+	       (uint32_t(q.z & 0x3ff) << 20) |
+	       (uint32_t(q.y & 0x3ff) << 10) |
+	       (uint32_t(q.x & 0x3ff) << 0);
+}
+
+Mesh mesh_quantize_attributes(const Mesh &mesh, bool quantize_positions)
+{
+	unsigned vertex_count = mesh.position_stride ? unsigned(mesh.positions.size() / mesh.position_stride) : 0;
+	if (!vertex_count)
+		return mesh;
+
+	auto position_format = mesh.attribute_layout[ecast(MeshAttribute::Position)].format;
+	quantize_positions = quantize_positions &&
+	                     (position_format == VK_FORMAT_R32G32B32_SFLOAT ||
+	                      position_format == VK_FORMAT_R32G32B32A32_SFLOAT);
+
+	// Decide target formats up front so we know if there is anything to do.
+	VkFormat target_formats[ecast(MeshAttribute::Count)];
+	for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
+	{
+		auto attr = static_cast<MeshAttribute>(i);
+		auto format = mesh.attribute_layout[i].format;
+		target_formats[i] = format;
+
+		if ((attr == MeshAttribute::Normal || attr == MeshAttribute::Tangent) &&
+		    (format == VK_FORMAT_R32G32B32_SFLOAT || format == VK_FORMAT_R32G32B32A32_SFLOAT))
+		{
+			target_formats[i] = VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+		}
+		else if (attr == MeshAttribute::UV && format == VK_FORMAT_R32G32_SFLOAT)
+		{
+			// unorm16 when UVs stay in [0, 1], snorm16 in [-1, 1], half otherwise.
+			vec2 min_uv = vec2(FLT_MAX);
+			vec2 max_uv = vec2(-FLT_MAX);
+			auto offset = mesh.attribute_layout[i].offset;
+			for (unsigned v = 0; v < vertex_count; v++)
+			{
+				vec2 uv;
+				memcpy(uv.data, mesh.attributes.data() + v * mesh.attribute_stride + offset, sizeof(vec2));
+				min_uv = min(min_uv, uv);
+				max_uv = max(max_uv, uv);
+			}
+
+			if (all(greaterThanEqual(min_uv, vec2(0.0f))) && all(lessThanEqual(max_uv, vec2(1.0f))))
+				target_formats[i] = VK_FORMAT_R16G16_UNORM;
+			else if (all(greaterThanEqual(min_uv, vec2(-1.0f))) && all(lessThanEqual(max_uv, vec2(1.0f))))
+				target_formats[i] = VK_FORMAT_R16G16_SNORM;
+			else if (all(greaterThan(min_uv, vec2(-0x8000))) && all(lessThan(max_uv, vec2(0x8000))))
+				target_formats[i] = VK_FORMAT_R16G16_SFLOAT;
+		}
+	}
+
+	bool any_attribute_changed = false;
+	for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
+		if (target_formats[i] != mesh.attribute_layout[i].format)
+			any_attribute_changed = true;
+
+	if (!quantize_positions && !any_attribute_changed)
+		return mesh;
+
+	Mesh quantized = mesh;
+
+	if (quantize_positions)
+	{
+		vec3 aabb_min = mesh.static_aabb.get_minimum();
+		vec3 extent = mesh.static_aabb.get_maximum() - aabb_min;
+		// Degenerate axes quantize to 0 and dequantize to the AABB minimum.
+		vec3 inv_extent = vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+		                       extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+		                       extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+		quantized.attribute_layout[ecast(MeshAttribute::Position)].format = VK_FORMAT_R16G16B16A16_UNORM;
+		quantized.position_stride = sizeof(u16vec4);
+		quantized.positions.resize(vertex_count * sizeof(u16vec4));
+
+		for (unsigned v = 0; v < vertex_count; v++)
+		{
+			vec3 pos;
+			memcpy(pos.data, mesh.positions.data() + v * mesh.position_stride, sizeof(vec3));
+			vec3 normalized = (pos - aabb_min) * inv_extent;
+			normalized = clamp(round(normalized * float(0xffff)), vec3(0.0f), vec3(0xffff));
+			u16vec4 packed(uint16_t(normalized.x), uint16_t(normalized.y), uint16_t(normalized.z), 0xffffu);
+			memcpy(quantized.positions.data() + v * sizeof(u16vec4), packed.data, sizeof(packed.data));
+		}
+	}
+
+	if (any_attribute_changed)
+	{
+		uint32_t new_stride = 0;
+		for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
+		{
+			if (target_formats[i] == VK_FORMAT_UNDEFINED || i == ecast(MeshAttribute::Position))
+				continue;
+			quantized.attribute_layout[i].format = target_formats[i];
+			quantized.attribute_layout[i].offset = new_stride;
+			new_stride += Vulkan::TextureFormatLayout::format_block_size(target_formats[i], 0);
+		}
+
+		quantized.attribute_stride = new_stride;
+		quantized.attributes.resize(vertex_count * new_stride);
+
+		for (unsigned i = 0; i < ecast(MeshAttribute::Count); i++)
+		{
+			if (target_formats[i] == VK_FORMAT_UNDEFINED || i == ecast(MeshAttribute::Position))
+				continue;
+
+			auto src_format = mesh.attribute_layout[i].format;
+			auto src_size = Vulkan::TextureFormatLayout::format_block_size(src_format, 0);
+			auto src_offset = mesh.attribute_layout[i].offset;
+			auto dst_offset = quantized.attribute_layout[i].offset;
+
+			for (unsigned v = 0; v < vertex_count; v++)
+			{
+				const uint8_t *src = mesh.attributes.data() + v * mesh.attribute_stride + src_offset;
+				uint8_t *dst = quantized.attributes.data() + v * new_stride + dst_offset;
+
+				if (target_formats[i] == src_format)
+				{
+					memcpy(dst, src, src_size);
+				}
+				else if (target_formats[i] == VK_FORMAT_A2B10G10R10_SNORM_PACK32)
+				{
+					vec4 input(0.0f, 0.0f, 0.0f, 1.0f);
+					memcpy(input.data, src, src_size);
+					uint32_t packed = quantize_attr_a2bgr10snorm(input);
+					memcpy(dst, &packed, sizeof(packed));
+				}
+				else if (target_formats[i] == VK_FORMAT_R16G16_UNORM)
+				{
+					vec2 input;
+					memcpy(input.data, src, sizeof(vec2));
+					input = clamp(round(input * float(0xffff)), vec2(0.0f), vec2(0xffff));
+					u16vec2 packed(input);
+					memcpy(dst, packed.data, sizeof(packed.data));
+				}
+				else if (target_formats[i] == VK_FORMAT_R16G16_SNORM)
+				{
+					vec2 input;
+					memcpy(input.data, src, sizeof(vec2));
+					input = clamp(round(input * float(0x7fff)), vec2(-0x7fff), vec2(0x7fff));
+					i16vec2 packed(input);
+					memcpy(dst, packed.data, sizeof(packed.data));
+				}
+				else if (target_formats[i] == VK_FORMAT_R16G16_SFLOAT)
+				{
+					vec2 input;
+					memcpy(input.data, src, sizeof(vec2));
+					u16vec2 packed = floatToHalf(input);
+					memcpy(dst, packed.data, sizeof(packed.data));
+				}
+			}
+		}
+	}
+
+	return quantized;
+}
+
 bool mesh_recompute_tangents(Mesh &mesh)
 {
 	if (mesh.attribute_layout[ecast(MeshAttribute::Tangent)].format != VK_FORMAT_R32G32B32A32_SFLOAT)
@@ -572,6 +825,55 @@ bool mesh_recompute_normals(Mesh &mesh)
 	return true;
 }
 
+Util::Hash mesh_content_hash(const Mesh &mesh)
+{
+	Hasher h;
+	h.data(mesh.positions.data(), mesh.positions.size());
+	h.data(mesh.attributes.data(), mesh.attributes.size());
+	h.data(mesh.indices.data(), mesh.indices.size());
+	h.u32(mesh.position_stride);
+	h.u32(mesh.attribute_stride);
+	for (auto &layout : mesh.attribute_layout)
+	{
+		h.u32(layout.format);
+		h.u32(layout.offset);
+	}
+	h.u32(mesh.index_type);
+	h.u32(mesh.topology);
+	h.u32(mesh.primitive_restart);
+	h.u32(mesh.count);
+	h.u32(uint32_t(mesh.lods.size()));
+	for (auto &lod : mesh.lods)
+	{
+		h.u32(lod.index_offset);
+		h.u32(lod.count);
+		h.f32(lod.error);
+	}
+	return h.get();
+}
+
+Util::Hash material_info_hash(const MaterialInfo &info)
+{
+	Hasher h;
+	h.string(info.base_color.path);
+	h.string(info.normal.path);
+	h.string(info.metallic_roughness.path);
+	h.string(info.occlusion.path);
+	h.string(info.emissive.path);
+	for (unsigned i = 0; i < 4; i++)
+		h.f32(info.uniform_base_color[i]);
+	for (unsigned i = 0; i < 3; i++)
+		h.f32(info.uniform_emissive_color[i]);
+	h.f32(info.uniform_metallic);
+	h.f32(info.uniform_roughness);
+	h.f32(info.normal_scale);
+	h.u32(ecast(info.pipeline));
+	h.u32(ecast(info.sampler));
+	h.u32(info.two_sided);
+	h.u32(info.bandlimited_pixel);
+	return h.get();
+}
+
 static void touch_node_children(unordered_set<uint32_t> &touched, const vector<Node> &nodes, uint32_t index)
 {
 	touched.insert(index);
@@ -68,6 +68,16 @@ struct AnimationChannel
 	}
 
 	void get_index_phase(float t, unsigned &index, float &phase, float &dt) const
+	{
+		unsigned cursor = 0;
+		get_index_phase(t, cursor, index, phase, dt);
+	}
+
+	// Variant which resumes the timeline scan from a caller-provided cursor.
+	// Resampling loops query monotonically increasing timestamps,
+	// so carrying the cursor across calls makes resampling a full channel
+	// O(n) in the number of key frames rather than O(n^2).
+	void get_index_phase(float t, unsigned &cursor, unsigned &index, float &phase, float &dt) const
 	{
 		if (t < timestamps.front() || timestamps.size() == 1)
 		{
@@ -84,9 +94,10 @@ struct AnimationChannel
 		}
 		else
 		{
-			unsigned end_target = 0;
+			unsigned end_target = cursor;
 			while (t >= timestamps[end_target])
 				end_target++;
+			cursor = end_target;
 
 			index = end_target - 1;
 			phase = (t - timestamps[index]) / (timestamps[end_target] - timestamps[index]);
@@ -227,6 +238,15 @@ struct SceneNodes
 	std::vector<uint32_t> node_indices;
 };
 
+struct MeshLOD
+{
+	// Range into the shared index buffer, in indices.
+	uint32_t index_offset = 0;
+	uint32_t count = 0;
+	// Simplification error, relative to the extent of the static AABB.
+	float error = 0.0f;
+};
+
 struct Mesh
 {
 	// Attributes
@@ -250,6 +270,11 @@ struct Mesh
 	Granite::AABB static_aabb;
 
 	uint32_t count = 0;
+
+	// Optional simplified LOD chain. All levels share the vertex buffers and
+	// live in the same index buffer; lods[0] covers the original geometry.
+	// Empty when no chain has been generated.
+	std::vector<MeshLOD> lods;
 };
 
 // A simplified mesh representation for CPU use.
@@ -280,6 +305,29 @@ bool extract_collision_mesh(CollisionMesh &collision_mesh, const Mesh &mesh);
 
 void mesh_deduplicate_vertices(Mesh &mesh);
 Mesh mesh_optimize_index_buffer(const Mesh &mesh, bool stripify);
+
+// Appends up to num_levels - 1 quadric-simplified index ranges to the index
+// buffer, each level targeting a quarter of the previous triangle count, and
+// fills in Mesh::lods. Must run after mesh_optimize_index_buffer (which
+// rewrites the index buffer) and before quantization (the simplifier needs
+// float positions). Meshes which cannot be simplified are returned unchanged
+// with an empty LOD chain.
+Mesh mesh_generate_lods(const Mesh &mesh, unsigned num_levels);
+
+// Repacks float attributes into quantized formats to cut vertex fetch
+// bandwidth: positions to unorm16 relative to static_aabb (the renderer folds
+// the dequantization into the per-instance model matrix), normals and
+// tangents to 10-bit snorm, UVs to unorm16, snorm16 or half depending on
+// range. quantize_positions should be false for skinned meshes where
+// positions feed the bone matrices directly.
+Mesh mesh_quantize_attributes(const Mesh &mesh, bool quantize_positions);
+
+// Content identity for instance batching at scene load. Two meshes with equal
+// vertex/index payloads, attribute layouts and draw state hash equal no matter
+// which glTF mesh entry they came from. Material bindings are not part of the
+// hash; combine with material_info_hash to group by (mesh, material).
+Util::Hash mesh_content_hash(const Mesh &mesh);
+Util::Hash material_info_hash(const MaterialInfo &info);
 std::unordered_set<uint32_t> build_used_nodes_in_scene(const SceneNodes &scene, const std::vector<Node> &nodes);
 }
 }
@@ -158,12 +158,13 @@ struct CompressorState : enable_shared_from_this<CompressorState>
 	unsigned block_size_y = 1;
 
 	void setup(const CompressorArguments &args);
-	void enqueue_compression(ThreadGroup &group, const CompressorArguments &args);
+	void enqueue_compression(ThreadGroup &group, const CompressorArguments &args, std::vector<TaskGroup> &level_deps);
 	void enqueue_compression_block_ispc(TaskGroup &group, const CompressorArguments &args, unsigned layer, unsigned level);
 	void enqueue_compression_block_astc(TaskGroup &group, const CompressorArguments &args, unsigned layer, unsigned level, TextureMode mode);
 	void enqueue_compression_block_rgtc(TaskGroup &group, const CompressorArguments &args, unsigned layer, unsigned level);
 	void enqueue_compression_copy_8bit(TaskGroup &group, const CompressorArguments &, unsigned layer, unsigned level);
 	void enqueue_compression_copy_16bit(TaskGroup &group, const CompressorArguments &, unsigned layer, unsigned level);
+	void enqueue_rdo_merge(TaskGroup &group, const CompressorArguments &args, unsigned layer, unsigned level);
 
 	double total_error[4] = {};
 	mutex lock;
@@ -504,9 +505,14 @@ void CompressorState::enqueue_compression_block_rgtc(TaskGroup &group, const Com
 	int height = input->get_layout().get_height(level);
 	int blocks_x = (width + block_size_x - 1) / block_size_x;
 
-	for (int y = 0; y < height; y += block_size_y)
+	// One task per 4x4 block drowns the thread group in scheduling overhead
+	// for large mips, so dispatch 32x32 tiles like the ISPC path does.
+	int grid_stride_x = (32 / block_size_x) * block_size_x;
+	int grid_stride_y = (32 / block_size_y) * block_size_y;
+
+	for (int tile_y = 0; tile_y < height; tile_y += grid_stride_y)
 	{
-		for (int x = 0; x < width; x += block_size_x)
+		for (int tile_x = 0; tile_x < width; tile_x += grid_stride_x)
 		{
 			group->enqueue_task([=, format = args.format]() {
 				auto &layout = input->get_layout();
@@ -515,88 +521,186 @@ void CompressorState::enqueue_compression_block_rgtc(TaskGroup &group, const Com
 				auto *src = static_cast<const uint8_t *>(layout.data(layer, level));
 				unsigned pixel_stride = layout.get_block_stride();
 
-				const auto get_block_data = [&](int block_size) -> uint8_t * {
-					auto *dst = static_cast<uint8_t *>(output->get_layout().data(layer, level));
-					dst += (x / block_size_x) * block_size;
-					dst += (y / block_size_y) * blocks_x * block_size;
-					return dst;
-				};
-
-				const auto get_encode_data = [&](int block_size) -> uint8_t * {
-					return get_block_data(block_size);
-				};
+				int end_x = std::min(tile_x + grid_stride_x, width);
+				int end_y = std::min(tile_y + grid_stride_y, height);
 
-				const auto get_component = [&](int sx, int sy, int c) -> uint8_t {
-					sx = std::min(sx, width - 1);
-					sy = std::min(sy, height - 1);
-					return src[pixel_stride * (sy * width + sx) + c];
-				};
+				double tile_error_red = 0.0;
+				double tile_error_green = 0.0;
 
-				for (int sy = 0; sy < 4; sy++)
+				for (int y = tile_y; y < end_y; y += block_size_y)
 				{
-					for (int sx = 0; sx < 4; sx++)
+					for (int x = tile_x; x < end_x; x += block_size_x)
 					{
-						padded_red[sy * 4 + sx] = get_component(x + sx, y + sy, 0);
-						if (pixel_stride > 1)
-							padded_green[sy * 4 + sx] = get_component(x + sx, y + sy, 1);
-					}
-				}
+						const auto get_encode_data = [&](int block_size) -> uint8_t * {
+							auto *dst = static_cast<uint8_t *>(output->get_layout().data(layer, level));
+							dst += (x / block_size_x) * block_size;
+							dst += (y / block_size_y) * blocks_x * block_size;
+							return dst;
+						};
+
+						const auto get_component = [&](int sx, int sy, int c) -> uint8_t {
+							sx = std::min(sx, width - 1);
+							sy = std::min(sy, height - 1);
+							return src[pixel_stride * (sy * width + sx) + c];
+						};
+
+						for (int sy = 0; sy < 4; sy++)
+						{
+							for (int sx = 0; sx < 4; sx++)
+							{
+								padded_red[sy * 4 + sx] = get_component(x + sx, y + sy, 0);
+								if (pixel_stride > 1)
+									padded_green[sy * 4 + sx] = get_component(x + sx, y + sy, 1);
+							}
+						}
 
-				switch (format)
-				{
-				case VK_FORMAT_BC4_UNORM_BLOCK:
-				{
-					compress_rgtc_red_block(get_encode_data(8), padded_red);
+						switch (format)
+						{
+						case VK_FORMAT_BC4_UNORM_BLOCK:
+						{
+							compress_rgtc_red_block(get_encode_data(8), padded_red);
 
 #ifdef RGTC_DEBUG
-					if (level == 0 && layer == 0)
-					{
-						uint8_t decoded_red[16];
-						decompress_rgtc_red_block(decoded_red, get_encode_data(8));
-						double error = 0.0;
-						for (int i = 0; i < 16; i++)
-							error += double((decoded_red[i] - padded_red[i]) * (decoded_red[i] - padded_red[i])) / (width * height);
-
-						lock_guard<mutex> l{lock};
-						total_error[0] += error;
-					}
+							if (level == 0 && layer == 0)
+							{
+								uint8_t decoded_red[16];
+								decompress_rgtc_red_block(decoded_red, get_encode_data(8));
+								for (int i = 0; i < 16; i++)
+									tile_error_red += double((decoded_red[i] - padded_red[i]) * (decoded_red[i] - padded_red[i])) / (width * height);
+							}
 #endif
-					break;
+							break;
+						}
+
+						case VK_FORMAT_BC5_UNORM_BLOCK:
+						{
+							compress_rgtc_red_green_block(get_encode_data(16), padded_red, padded_green);
+
+#ifdef RGTC_DEBUG
+							if (level == 0 && layer == 0)
+							{
+								uint8_t decoded_red[16];
+								uint8_t decoded_green[16];
+								decompress_rgtc_red_block(decoded_red, get_encode_data(16));
+								decompress_rgtc_red_block(decoded_green, get_encode_data(16) + 8);
+
+								for (int i = 0; i < 16; i++)
+									tile_error_red += double((decoded_red[i] - padded_red[i]) * (decoded_red[i] - padded_red[i])) / (width * height);
+								for (int i = 0; i < 16; i++)
+									tile_error_green += double((decoded_green[i] - padded_green[i]) * (decoded_green[i] - padded_green[i])) / (width * height);
+							}
+#endif
+							break;
+						}
+
+						default:
+							break;
+						}
+					}
 				}
 
-				case VK_FORMAT_BC5_UNORM_BLOCK:
+#ifdef RGTC_DEBUG
+				// Merge the error sums once per tile rather than once per block.
+				if (level == 0 && layer == 0 && (tile_error_red != 0.0 || tile_error_green != 0.0))
 				{
-					compress_rgtc_red_green_block(get_encode_data(16), padded_red, padded_green);
+					lock_guard<mutex> l{lock};
+					total_error[0] += tile_error_red;
+					total_error[1] += tile_error_green;
+				}
+#endif
+			});
+		}
+	}
+}
 
-#ifdef RGTC_DEBUG
-					if (level == 0 && layer == 0)
+// Rate-distortion pass over the encoded blocks of one mip. Works on any LDR
+// block format without decoding it: substituting block j's payload into block
+// i costs at most the distance between their source texels plus the encode
+// error, so merges are gated on source-space SSD. Identical payloads are what
+// the supercompression entropy stage feeds on, and flat or slowly varying
+// regions (skyboxes, masks, roughness maps) collapse almost entirely.
+void CompressorState::enqueue_rdo_merge(TaskGroup &group, const CompressorArguments &args, unsigned layer, unsigned level)
+{
+	group->enqueue_task([=]() {
+		auto &in_layout = input->get_layout();
+		auto &out_layout = output->get_layout();
+
+		int width = in_layout.get_width(level);
+		int height = in_layout.get_height(level);
+		int num_blocks_x = (width + block_size_x - 1) / block_size_x;
+		int num_blocks_y = (height + block_size_y - 1) / block_size_y;
+		size_t block_bytes = out_layout.get_block_stride();
+
+		auto *blocks = static_cast<uint8_t *>(out_layout.data(layer, level));
+		auto *src = static_cast<const uint8_t *>(in_layout.data(layer, level));
+		unsigned pixel_stride = in_layout.get_block_stride();
+
+		int texels_per_block = block_size_x * block_size_y;
+		// rdo_lambda is per-texel RMS, the search compares summed SSD.
+		double max_ssd = double(args.rdo_lambda) * double(args.rdo_lambda) * 4.0 * texels_per_block;
+
+		const auto block_ssd = [&](int bx_a, int by_a, int bx_b, int by_b) -> double {
+			double ssd = 0.0;
+			for (int y = 0; y < int(block_size_y) && ssd <= max_ssd; y++)
+			{
+				int ya = std::min(by_a * int(block_size_y) + y, height - 1);
+				int yb = std::min(by_b * int(block_size_y) + y, height - 1);
+				for (int x = 0; x < int(block_size_x); x++)
+				{
+					int xa = std::min(bx_a * int(block_size_x) + x, width - 1);
+					int xb = std::min(bx_b * int(block_size_x) + x, width - 1);
+					auto *pa = src + pixel_stride * (ya * width + xa);
+					auto *pb = src + pixel_stride * (yb * width + xb);
+					for (unsigned c = 0; c < 4; c++)
 					{
-						uint8_t decoded_red[16];
-						uint8_t decoded_green[16];
-						decompress_rgtc_red_block(decoded_red, get_encode_data(16));
-						decompress_rgtc_red_block(decoded_green, get_encode_data(16) + 8);
-
-						double error_red = 0.0;
-						double error_green = 0.0;
-						for (int i = 0; i < 16; i++)
-							error_red += double((decoded_red[i] - padded_red[i]) * (decoded_red[i] - padded_red[i])) / (width * height);
-						for (int i = 0; i < 16; i++)
-							error_green += double((decoded_green[i] - padded_green[i]) * (decoded_green[i] - padded_green[i])) / (width * height);
-
-						lock_guard<mutex> l{lock};
-						total_error[0] += error_red;
-						total_error[1] += error_green;
+						int d = int(pa[c]) - int(pb[c]);
+						ssd += double(d * d);
 					}
-#endif
-					break;
 				}
+			}
+			return ssd;
+		};
 
-				default:
+		enum { Window = 64 };
+		unsigned merged = 0;
+		int num_blocks = num_blocks_x * num_blocks_y;
+
+		for (int i = 1; i < num_blocks; i++)
+		{
+			int bx = i % num_blocks_x;
+			int by = i / num_blocks_x;
+
+			int best = -1;
+			double best_ssd = max_ssd;
+
+			int first = std::max(i - int(Window), 0);
+			for (int j = i - 1; j >= first; j--)
+			{
+				if (memcmp(blocks + i * block_bytes, blocks + j * block_bytes, block_bytes) == 0)
+				{
+					// Already a repeat, nothing to gain.
+					best = -1;
 					break;
 				}
-			});
+
+				double ssd = block_ssd(bx, by, j % num_blocks_x, j / num_blocks_x);
+				if (ssd < best_ssd)
+				{
+					best_ssd = ssd;
+					best = j;
+				}
+			}
+
+			if (best >= 0)
+			{
+				memcpy(blocks + i * block_bytes, blocks + best * block_bytes, block_bytes);
+				merged++;
+			}
 		}
-	}
+
+		if (merged)
+			LOGI("RDO merged %u / %d blocks (level %u, layer %u).\n", merged, num_blocks, level, layer);
+	});
 }
 
 #ifdef HAVE_ISPC
@@ -963,13 +1067,35 @@ void CompressorState::enqueue_compression_block_astc(TaskGroup &compression_task
 }
 #endif
 
-void CompressorState::enqueue_compression(ThreadGroup &group, const CompressorArguments &args)
+void CompressorState::enqueue_compression(ThreadGroup &group, const CompressorArguments &args,
+                                          std::vector<TaskGroup> &level_deps)
 {
-	auto compression_task = group.create_task();
+	// Pass down ownership to final task.
+	auto write_task = group.create_task([args, state = shared_from_this()]() {
+		if (state->total_error[0] != 0.0)
+			LOGI("Red PSNR: %.f dB\n", 10.0 * log10(255.0 * 255.0 / state->total_error[0]));
+		if (state->total_error[1] != 0.0)
+			LOGI("Green PSNR: %.f dB\n", 10.0 * log10(255.0 * 255.0 / state->total_error[1]));
 
-	for (unsigned layer = 0; layer < input->get_layout().get_layers(); layer++)
+		LOGI("Unmapping %u bytes for texture writing.\n", unsigned(state->output->get_required_size()));
+		LOGI("Unmapping %u bytes for texture reading.\n", unsigned(state->input->get_required_size()));
+
+		if (args.supercompress && !state->output->copy_to_path_compressed(args.output))
+			LOGE("Failed to write compressed texture to %s.\n", args.output.c_str());
+
+		state->output.reset();
+		state->input.reset();
+	});
+
+	// One task group per mip level so a level only waits for its own
+	// generation, not the whole chain.
+	for (unsigned level = 0; level < input->get_layout().get_levels(); level++)
 	{
-		for (unsigned level = 0; level < input->get_layout().get_levels(); level++)
+		auto compression_task = group.create_task();
+		if (level < level_deps.size() && level_deps[level])
+			group.add_dependency(compression_task, level_deps[level]);
+
+		for (unsigned layer = 0; layer < input->get_layout().get_layers(); layer++)
 		{
 			switch (args.format)
 			{
@@ -1029,27 +1155,32 @@ void CompressorState::enqueue_compression(ThreadGroup &group, const CompressorAr
 				break;
 			}
 		}
-	}
 
-	// Pass down ownership to final task.
-	auto write_task = group.create_task([args, state = shared_from_this()]() {
-		if (state->total_error[0] != 0.0)
-			LOGI("Red PSNR: %.f dB\n", 10.0 * log10(255.0 * 255.0 / state->total_error[0]));
-		if (state->total_error[1] != 0.0)
-			LOGI("Green PSNR: %.f dB\n", 10.0 * log10(255.0 * 255.0 / state->total_error[1]));
+		// RDO only applies to LDR block formats; block_size_x stays 1 for
+		// raw copies and the BC6H/ASTC HDR paths take 16-bit float input.
+		bool can_rdo = args.rdo && block_size_x > 1 &&
+		               input->get_layout().get_format() != VK_FORMAT_R16G16B16A16_SFLOAT;
 
-		LOGI("Unmapping %u bytes for texture writing.\n", unsigned(state->output->get_required_size()));
-		LOGI("Unmapping %u bytes for texture reading.\n", unsigned(state->input->get_required_size()));
+		if (can_rdo)
+		{
+			auto rdo_task = group.create_task();
+			group.add_dependency(rdo_task, compression_task);
+			for (unsigned layer = 0; layer < input->get_layout().get_layers(); layer++)
+				enqueue_rdo_merge(rdo_task, args, layer, level);
+			group.add_dependency(write_task, rdo_task);
+		}
+		else
+			group.add_dependency(write_task, compression_task);
+	}
 
-		state->output.reset();
-		state->input.reset();
-	});
-	group.add_dependency(write_task, compression_task);
+	// All dependencies are recorded now; releasing the handles flushes the
+	// per-level generation tasks so the pipeline can start.
+	level_deps.clear();
 	write_task->set_fence_counter_signal(signal);
 }
 
 bool compress_texture(ThreadGroup &group, const CompressorArguments &args, const shared_ptr<MemoryMappedTexture> &input,
-                      TaskGroup &dep, TaskSignal *signal)
+                      TaskGroup &dep, TaskSignal *signal, std::vector<TaskGroup> level_deps)
 {
 	auto output = make_shared<CompressorState>();
 	output->input = input;
@@ -1067,7 +1198,7 @@ bool compress_texture(ThreadGroup &group, const CompressorArguments &args, const
 		return false;
 	}
 
-	auto setup_task = group.create_task([&group, output, args]() {
+	auto setup_task = group.create_task([&group, output, args, level_deps = move(level_deps)]() mutable {
 		output->output = make_shared<MemoryMappedTexture>();
 		auto &layout = output->input->get_layout();
 
@@ -1092,7 +1223,13 @@ bool compress_texture(ThreadGroup &group, const CompressorArguments &args, const
 			return;
 		}
 
-		if (!output->output->map_write(args.output))
+		// Supercompressed output cannot be written in-place since the final
+		// size is unknown until the blocks exist, so compress into scratch
+		// memory and deflate to the target path in the write task.
+		bool mapped_output = args.supercompress ?
+		                     output->output->map_write_scratch() :
+		                     output->output->map_write(args.output);
+		if (!mapped_output)
 		{
 			LOGE("Failed to map output texture for writing.\n");
 			if (output->signal)
@@ -1103,7 +1240,7 @@ bool compress_texture(ThreadGroup &group, const CompressorArguments &args, const
 		LOGI("Mapping %u bytes for texture writeout.\n",
 		     unsigned(output->output->get_required_size()));
 
-		output->enqueue_compression(group, args);
+		output->enqueue_compression(group, args, level_deps);
 	});
 	group.add_dependency(setup_task, dep);
 
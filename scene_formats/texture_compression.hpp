@@ -56,10 +56,29 @@ struct CompressorArguments
 		VK_COMPONENT_SWIZZLE_A,
 	};
 	bool deferred_mipgen = false;
+	// Write the output with per-mip LZ4 compressed payloads for I/O bound
+	// archive tiers. See MemoryMappedTexture::copy_to_path_compressed().
+	bool supercompress = false;
+	// Rate-distortion pass over the encoded blocks. Blocks whose source
+	// texels are close enough reuse the exact payload of an earlier block,
+	// which turns flat and slowly varying regions into long matches for the
+	// supercompression stage. rdo_lambda is the extra per-texel RMS error
+	// (8-bit scale) a merge may introduce; higher trades more quality for
+	// smaller archives. LDR block formats only.
+	bool rdo = false;
+	float rdo_lambda = 2.0f;
 };
 
 VkFormat string_to_format(const std::string &s);
+
+// Compression of mip level N only waits for level_deps[N] (plus dep, which
+// gates the setup). Feeding per-level mip generation tasks here pipelines
+// compression of one level against generation of the next. The groups must
+// not be flushed by the caller; they are released (and thus flushed) once all
+// dependencies have been recorded. An empty vector makes every level wait for
+// dep alone, which is the right thing when the input is fully baked already.
 bool compress_texture(ThreadGroup &group, const CompressorArguments &args,
                       const std::shared_ptr<SceneFormats::MemoryMappedTexture> &input,
-                      TaskGroup &dep, TaskSignal *signal);
+                      TaskGroup &dep, TaskSignal *signal,
+                      std::vector<TaskGroup> level_deps = {});
 }
\ No newline at end of file
@@ -22,7 +22,10 @@
 
 #include "texture_decoder.hpp"
 #include "global_managers.hpp"
+#include "thread_group.hpp"
 #include "logging.hpp"
+#include <mutex>
+#include <unordered_map>
 
 namespace Granite
 {
@@ -427,76 +430,87 @@ static void setup_astc_lut_color_endpoint(Vulkan::CommandBuffer &cmd)
 	};
 
 	constexpr size_t num_modes = sizeof(potential_modes) / sizeof(potential_modes[0]);
-	size_t unquant_lut_offsets[num_modes];
-	size_t unquant_offset = 0;
 
-	uint8_t unquant_lut[2048];
-
-	for (size_t i = 0; i < num_modes; i++)
+	struct ColorEndpointLuts
 	{
-		auto value_range = astc_value_range(potential_modes[i]);
-		unquant_lut_offsets[i] = unquant_offset;
-		build_astc_unquant_endpoint_lut(unquant_lut + unquant_offset, value_range, potential_modes[i]);
-		unquant_offset += value_range;
-	}
+		uint8_t unquant_lut[2048];
+		uint16_t lut[9][128][4];
+		size_t unquant_offset;
+	};
 
-	uint16_t lut[9][128][4];
+	// The tables are pure functions of spec constants, so build them once
+	// instead of once per decoded texture.
+	static const ColorEndpointLuts luts = []() {
+		ColorEndpointLuts l = {};
+		size_t unquant_lut_offsets[num_modes];
+		size_t unquant_offset = 0;
 
-	// We can have a maximum of 9 endpoint pairs, i.e. 18 endpoint values in total.
-	for (unsigned pairs_minus_1 = 0; pairs_minus_1 < 9; pairs_minus_1++)
-	{
-		for (unsigned remaining = 0; remaining < 128; remaining++)
+		for (size_t i = 0; i < num_modes; i++)
 		{
-			bool found_mode = false;
-			for (auto &mode : potential_modes)
-			{
-				unsigned num_values = (pairs_minus_1 + 1) * 2;
-				unsigned total_bits = mode.bits * num_values +
-				                      (mode.quints * 7 * num_values + 2) / 3 +
-				                      (mode.trits * 8 * num_values + 4) / 5;
+			auto value_range = astc_value_range(potential_modes[i]);
+			unquant_lut_offsets[i] = unquant_offset;
+			build_astc_unquant_endpoint_lut(l.unquant_lut + unquant_offset, value_range, potential_modes[i]);
+			unquant_offset += value_range;
+		}
+		l.unquant_offset = unquant_offset;
 
-				if (total_bits <= remaining)
+		// We can have a maximum of 9 endpoint pairs, i.e. 18 endpoint values in total.
+		for (unsigned pairs_minus_1 = 0; pairs_minus_1 < 9; pairs_minus_1++)
+		{
+			for (unsigned remaining = 0; remaining < 128; remaining++)
+			{
+				bool found_mode = false;
+				for (auto &mode : potential_modes)
 				{
-					found_mode = true;
-					lut[pairs_minus_1][remaining][0] = mode.bits;
-					lut[pairs_minus_1][remaining][1] = mode.trits;
-					lut[pairs_minus_1][remaining][2] = mode.quints;
-					lut[pairs_minus_1][remaining][3] = unquant_lut_offsets[&mode - potential_modes];
-					break;
+					unsigned num_values = (pairs_minus_1 + 1) * 2;
+					unsigned total_bits = mode.bits * num_values +
+					                      (mode.quints * 7 * num_values + 2) / 3 +
+					                      (mode.trits * 8 * num_values + 4) / 5;
+
+					if (total_bits <= remaining)
+					{
+						found_mode = true;
+						l.lut[pairs_minus_1][remaining][0] = mode.bits;
+						l.lut[pairs_minus_1][remaining][1] = mode.trits;
+						l.lut[pairs_minus_1][remaining][2] = mode.quints;
+						l.lut[pairs_minus_1][remaining][3] = unquant_lut_offsets[&mode - potential_modes];
+						break;
+					}
 				}
-			}
 
-			if (!found_mode)
-				memset(lut[pairs_minus_1][remaining], 0, sizeof(lut[pairs_minus_1][remaining]));
+				if (!found_mode)
+					memset(l.lut[pairs_minus_1][remaining], 0, sizeof(l.lut[pairs_minus_1][remaining]));
+			}
 		}
-	}
+		return l;
+	}();
 
 	{
 		Vulkan::BufferCreateInfo info = {};
-		info.size = sizeof(lut);
+		info.size = sizeof(luts.lut);
 		info.domain = Vulkan::BufferDomain::LinkedDeviceHost;
 		info.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-		auto lut_buffer = cmd.get_device().create_buffer(info, lut);
+		auto lut_buffer = cmd.get_device().create_buffer(info, luts.lut);
 
 		Vulkan::BufferViewCreateInfo view_info = {};
 		view_info.buffer = lut_buffer.get();
 		view_info.format = VK_FORMAT_R16G16B16A16_UINT;
-		view_info.range = sizeof(lut);
+		view_info.range = sizeof(luts.lut);
 		auto lut_view = cmd.get_device().create_buffer_view(view_info);
 		cmd.set_buffer_view(1, 0, *lut_view);
 	}
 
 	{
 		Vulkan::BufferCreateInfo info = {};
-		info.size = unquant_offset;
+		info.size = luts.unquant_offset;
 		info.domain = Vulkan::BufferDomain::LinkedDeviceHost;
 		info.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-		auto unquant_buffer = cmd.get_device().create_buffer(info, unquant_lut);
+		auto unquant_buffer = cmd.get_device().create_buffer(info, luts.unquant_lut);
 
 		Vulkan::BufferViewCreateInfo view_info = {};
 		view_info.buffer = unquant_buffer.get();
 		view_info.format = VK_FORMAT_R8_UINT;
-		view_info.range = unquant_offset;
+		view_info.range = luts.unquant_offset;
 
 		auto unquant_view = cmd.get_device().create_buffer_view(view_info);
 		cmd.set_buffer_view(1, 1, *unquant_view);
@@ -525,59 +539,75 @@ static void setup_astc_lut_weights(Vulkan::CommandBuffer &cmd)
 	};
 
 	constexpr size_t num_modes = sizeof(weight_modes) / sizeof(weight_modes[0]);
-	size_t unquant_offset = 0;
-	uint8_t unquant_lut[2048];
-
-	uint8_t lut[num_modes][4];
 
-	for (size_t i = 0; i < num_modes; i++)
+	struct WeightLuts
 	{
-		auto value_range = astc_value_range(weight_modes[i]);
-		lut[i][0] = weight_modes[i].bits;
-		lut[i][1] = weight_modes[i].trits;
-		lut[i][2] = weight_modes[i].quints;
-		lut[i][3] = unquant_offset;
-		build_astc_unquant_weight_lut(unquant_lut + unquant_offset, value_range, weight_modes[i]);
-		unquant_offset += value_range;
-	}
+		uint8_t unquant_lut[2048];
+		uint8_t lut[num_modes][4];
+		size_t unquant_offset;
+	};
+
+	static const WeightLuts luts = []() {
+		WeightLuts l = {};
+		size_t unquant_offset = 0;
+
+		for (size_t i = 0; i < num_modes; i++)
+		{
+			auto value_range = astc_value_range(weight_modes[i]);
+			l.lut[i][0] = weight_modes[i].bits;
+			l.lut[i][1] = weight_modes[i].trits;
+			l.lut[i][2] = weight_modes[i].quints;
+			l.lut[i][3] = unquant_offset;
+			build_astc_unquant_weight_lut(l.unquant_lut + unquant_offset, value_range, weight_modes[i]);
+			unquant_offset += value_range;
+		}
 
-	assert(unquant_offset <= 256);
+		assert(unquant_offset <= 256);
+		l.unquant_offset = unquant_offset;
+		return l;
+	}();
 
 	{
 		Vulkan::BufferCreateInfo info = {};
-		info.size = sizeof(lut);
+		info.size = sizeof(luts.lut);
 		info.domain = Vulkan::BufferDomain::LinkedDeviceHost;
 		info.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-		auto lut_buffer = cmd.get_device().create_buffer(info, lut);
+		auto lut_buffer = cmd.get_device().create_buffer(info, luts.lut);
 
 		Vulkan::BufferViewCreateInfo view_info = {};
 		view_info.buffer = lut_buffer.get();
 		view_info.format = VK_FORMAT_R8G8B8A8_UINT;
-		view_info.range = sizeof(lut);
+		view_info.range = sizeof(luts.lut);
 		auto lut_view = cmd.get_device().create_buffer_view(view_info);
 		cmd.set_buffer_view(1, 2, *lut_view);
 	}
 
 	{
 		Vulkan::BufferCreateInfo info = {};
-		info.size = unquant_offset;
+		info.size = luts.unquant_offset;
 		info.domain = Vulkan::BufferDomain::LinkedDeviceHost;
 		info.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-		auto unquant_buffer = cmd.get_device().create_buffer(info, unquant_lut);
+		auto unquant_buffer = cmd.get_device().create_buffer(info, luts.unquant_lut);
 
 		Vulkan::BufferViewCreateInfo view_info = {};
 		view_info.buffer = unquant_buffer.get();
 		view_info.format = VK_FORMAT_R8_UINT;
-		view_info.range = unquant_offset;
+		view_info.range = luts.unquant_offset;
 
 		auto unquant_view = cmd.get_device().create_buffer_view(view_info);
 		cmd.set_buffer_view(1, 3, *unquant_view);
 	}
 }
 
-static void setup_astc_lut_trits_quints(Vulkan::CommandBuffer &cmd)
+struct ASTCTritsQuintsLut
 {
 	uint16_t trits_quints[256 + 128];
+};
+
+static ASTCTritsQuintsLut build_astc_trits_quints_lut()
+{
+	ASTCTritsQuintsLut l = {};
+	auto *trits_quints = l.trits_quints;
 
 	// From specification.
 
@@ -665,16 +695,23 @@ static void setup_astc_lut_trits_quints(Vulkan::CommandBuffer &cmd)
 		trits_quints[256 + Q] = q0 | (q1 << 3) | (q2 << 6);
 	}
 
+	return l;
+}
+
+static void setup_astc_lut_trits_quints(Vulkan::CommandBuffer &cmd)
+{
+	static const ASTCTritsQuintsLut lut = build_astc_trits_quints_lut();
+
 	Vulkan::BufferCreateInfo info = {};
-	info.size = sizeof(trits_quints);
+	info.size = sizeof(lut.trits_quints);
 	info.domain = Vulkan::BufferDomain::LinkedDeviceHost;
 	info.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-	auto lut_buffer = cmd.get_device().create_buffer(info, trits_quints);
+	auto lut_buffer = cmd.get_device().create_buffer(info, lut.trits_quints);
 
 	Vulkan::BufferViewCreateInfo view_info = {};
 	view_info.buffer = lut_buffer.get();
 	view_info.format = VK_FORMAT_R16_UINT;
-	view_info.range = sizeof(trits_quints);
+	view_info.range = sizeof(lut.trits_quints);
 	auto trits_quints_buffer = cmd.get_device().create_buffer_view(view_info);
 	cmd.set_buffer_view(1, 4, *trits_quints_buffer);
 }
@@ -763,25 +800,46 @@ static void setup_astc_lut_partition_table(Vulkan::CommandBuffer &cmd, VkFormat
 
 	unsigned lut_width = block_width * 32;
 	unsigned lut_height = block_height * 32;
-	std::vector<uint8_t> lut_buffer(lut_width * lut_height);
 
-	for (unsigned seed_y = 0; seed_y < 32; seed_y++)
+	// 1024 seeds x 3 partition counts x block area of hash evaluations adds up
+	// to a sizeable chunk of CPU time per decode for the larger block sizes.
+	// The table is a pure function of the block dimensions, so build it once
+	// per block size, fanning the seed rows out over the worker threads.
+	static std::mutex lut_lock;
+	static std::unordered_map<unsigned, std::vector<uint8_t>> lut_cache;
+
+	std::lock_guard<std::mutex> holder{lut_lock};
+	auto &lut_buffer = lut_cache[block_width | (block_height << 8)];
+
+	if (lut_buffer.empty())
 	{
-		for (unsigned seed_x = 0; seed_x < 32; seed_x++)
-		{
-			unsigned seed = seed_y * 32 + seed_x;
-			for (unsigned block_y = 0; block_y < block_height; block_y++)
+		lut_buffer.resize(lut_width * lut_height);
+		const auto build_seed_rows = [&](size_t begin, size_t end) {
+			for (unsigned seed_y = unsigned(begin); seed_y < unsigned(end); seed_y++)
 			{
-				for (unsigned block_x = 0; block_x < block_width; block_x++)
+				for (unsigned seed_x = 0; seed_x < 32; seed_x++)
 				{
-					int part2 = astc_select_partition(seed, block_x, block_y, 0, 2, small_block);
-					int part3 = astc_select_partition(seed, block_x, block_y, 0, 3, small_block);
-					int part4 = astc_select_partition(seed, block_x, block_y, 0, 4, small_block);
-					lut_buffer[(seed_y * block_height + block_y) * lut_width + (seed_x * block_width + block_x)] =
-							(part2 << 0) | (part3 << 2) | (part4 << 4);
+					unsigned seed = seed_y * 32 + seed_x;
+					for (unsigned block_y = 0; block_y < block_height; block_y++)
+					{
+						for (unsigned block_x = 0; block_x < block_width; block_x++)
+						{
+							int part2 = astc_select_partition(seed, block_x, block_y, 0, 2, small_block);
+							int part3 = astc_select_partition(seed, block_x, block_y, 0, 3, small_block);
+							int part4 = astc_select_partition(seed, block_x, block_y, 0, 4, small_block);
+							lut_buffer[(seed_y * block_height + block_y) * lut_width + (seed_x * block_width + block_x)] =
+									(part2 << 0) | (part3 << 2) | (part4 << 4);
+						}
+					}
 				}
 			}
-		}
+		};
+
+		auto *group = Global::thread_group();
+		if (group)
+			group->parallel_for(32, 1, build_seed_rows);
+		else
+			build_seed_rows(0, 32);
 	}
 
 	auto info = Vulkan::ImageCreateInfo::immutable_2d_image(lut_width, lut_height, VK_FORMAT_R8_UINT);
@@ -23,6 +23,10 @@
 #include "texture_files.hpp"
 #include "stb_image.h"
 #include "filesystem.hpp"
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#include "string_helpers.hpp"
+#include "hash.hpp"
 #include "muglm/muglm_impl.hpp"
 #include <string.h>
 
@@ -60,11 +64,20 @@ static SceneFormats::MemoryMappedTexture load_hdr(const void *data, size_t size)
 		return {};
 	tex.set_generate_mipmaps_on_load(true);
 
+	// The float to half conversion is embarrassingly parallel per row, unlike
+	// the entropy-coded decode itself.
 	auto *converted = static_cast<muglm::u16vec4 *>(tex.get_layout().data());
-	for (int i = 0; i < width * height; i++)
-	{
-		converted[i] = muglm::floatToHalf(muglm::vec4(buffer[3 * i + 0], buffer[3 * i + 1], buffer[3 * i + 2], 1.0f));
-	}
+	const auto convert_rows = [&](size_t begin, size_t end) {
+		for (size_t i = begin * width, end_pixel = end * width; i < end_pixel; i++)
+			converted[i] = muglm::floatToHalf(muglm::vec4(buffer[3 * i + 0], buffer[3 * i + 1], buffer[3 * i + 2], 1.0f));
+	};
+
+	auto *group = Global::thread_group();
+	if (group)
+		group->parallel_for(height, 64, convert_rows);
+	else
+		convert_rows(0, height);
+
 	stbi_image_free(buffer);
 	return tex;
 }
@@ -102,6 +115,25 @@ SceneFormats::MemoryMappedTexture load_texture_from_memory(const void *data, siz
 	}
 }
 
+// The decode cache stores stb-decoded payloads as .gtx blobs in the cache
+// directory, so a second load of the same PNG/JPG/HDR memory-maps the decoded
+// pixels and skips stb entirely. The key folds in size and timestamp rather
+// than a content hash, matching the scene cache; hashing the payload would
+// read the whole file on every hit.
+static std::string get_texture_cache_path(const std::string &path, ColorSpace color)
+{
+	FileStat s;
+	if (!Global::filesystem()->stat(path, s) || s.type != PathType::File)
+		return "";
+
+	Util::Hasher h;
+	h.string(path);
+	h.u64(s.size);
+	h.u64(s.last_modified);
+	h.u32(color == ColorSpace::sRGB);
+	return Util::join("cache://textures/", h.get(), ".gtx");
+}
+
 SceneFormats::MemoryMappedTexture load_texture_from_file(const std::string &path, ColorSpace color)
 {
 	auto file = Granite::Global::filesystem()->open(path, FileMode::ReadOnly);
@@ -119,6 +151,17 @@ SceneFormats::MemoryMappedTexture load_texture_from_file(const std::string &path
 		return tex;
 	}
 
-	return load_texture_from_memory(mapped, file->get_size(), color);
+	auto cache_path = get_texture_cache_path(path, color);
+	if (!cache_path.empty())
+	{
+		SceneFormats::MemoryMappedTexture cached;
+		if (cached.map_read(cache_path))
+			return cached;
+	}
+
+	auto tex = load_texture_from_memory(mapped, file->get_size(), color);
+	if (!tex.empty() && !cache_path.empty())
+		tex.copy_to_path(cache_path);
+	return tex;
 }
 }
\ No newline at end of file
@@ -127,60 +127,61 @@ struct TextureFormatRGBA8Srgb
 };
 
 template <typename Ops>
-inline void generate_mipmaps(const Vulkan::TextureFormatLayout &dst_layout,
-                             const Vulkan::TextureFormatLayout &layout, const Ops &op)
+inline void generate_mipmap_level(const Vulkan::TextureFormatLayout &dst_layout, uint32_t level, const Ops &op)
 {
-	memcpy(dst_layout.data(0, 0), layout.data(0, 0), dst_layout.get_layer_size(0) * layout.get_layers());
-
-	for (uint32_t level = 1; level < dst_layout.get_levels(); level++)
-	{
-		auto &dst_mip = dst_layout.get_mip_info(level);
-		auto &src_mip = dst_layout.get_mip_info(level - 1);
-
-		uint32_t dst_width = dst_mip.block_row_length;
-		uint32_t dst_height = dst_mip.block_image_height;
+	uint32_t dst_width = dst_mip.block_row_length;
+	uint32_t dst_height = dst_mip.block_image_height;
 
-		uint32_t src_width = src_mip.block_row_length;
-		uint32_t src_height = src_mip.block_image_height;
-		uvec2 max_coord(src_width - 1u, src_height - 1u);
+	uint32_t src_width = src_mip.block_row_length;
+	uint32_t src_height = src_mip.block_image_height;
+	uvec2 max_coord(src_width - 1u, src_height - 1u);
 
-		float src_width_f = float(src_mip.block_row_length);
-		float src_height_f = float(src_mip.block_image_height);
+	float src_width_f = float(src_mip.block_row_length);
+	float src_height_f = float(src_mip.block_image_height);
 
-		float rescale_width = src_width_f / float(dst_width);
-		float rescale_height = src_height_f / float(dst_height);
+	float rescale_width = src_width_f / float(dst_width);
+	float rescale_height = src_height_f / float(dst_height);
 
-		for (uint32_t layer = 0; layer < dst_layout.get_layers(); layer++)
+	for (uint32_t layer = 0; layer < dst_layout.get_layers(); layer++)
+	{
+		for (uint32_t y = 0; y < dst_height; y++)
 		{
-			for (uint32_t y = 0; y < dst_height; y++)
+			float coord_y = (float(y) + 0.5f) * rescale_height - 0.5f;
+			for (uint32_t x = 0; x < dst_width; x++)
 			{
-				float coord_y = (float(y) + 0.5f) * rescale_height - 0.5f;
-				for (uint32_t x = 0; x < dst_width; x++)
-				{
-					float coord_x = (float(x) + 0.5f) * rescale_width - 0.5f;
-					vec2 base_coord = vec2(coord_x, coord_y);
-					vec2 floor_coord = floor(base_coord);
-					vec2 uv = base_coord - floor_coord;
-					uvec2 c0(floor_coord);
-					uvec2 c1 = min(c0 + uvec2(1, 0), max_coord);
-					uvec2 c2 = min(c0 + uvec2(0, 1), max_coord);
-					uvec2 c3 = min(c0 + uvec2(1, 1), max_coord);
-
-					auto v0 = op.sample(dst_layout, c0, layer, level - 1);
-					auto v1 = op.sample(dst_layout, c1, layer, level - 1);
-					auto v2 = op.sample(dst_layout, c2, layer, level - 1);
-					auto v3 = op.sample(dst_layout, c3, layer, level - 1);
-
-					auto x0 = mix(v0, v1, uv.x);
-					auto x1 = mix(v2, v3, uv.x);
-					auto filtered = mix(x0, x1, uv.y);
-					op.write(dst_layout, uvec2(x, y), layer, level, filtered);
-				}
+				float coord_x = (float(x) + 0.5f) * rescale_width - 0.5f;
+				vec2 base_coord = vec2(coord_x, coord_y);
+				vec2 floor_coord = floor(base_coord);
+				vec2 uv = base_coord - floor_coord;
+				uvec2 c0(floor_coord);
+				uvec2 c1 = min(c0 + uvec2(1, 0), max_coord);
+				uvec2 c2 = min(c0 + uvec2(0, 1), max_coord);
+				uvec2 c3 = min(c0 + uvec2(1, 1), max_coord);
+
+				auto v0 = op.sample(dst_layout, c0, layer, level - 1);
+				auto v1 = op.sample(dst_layout, c1, layer, level - 1);
+				auto v2 = op.sample(dst_layout, c2, layer, level - 1);
+				auto v3 = op.sample(dst_layout, c3, layer, level - 1);
+
+				auto x0 = mix(v0, v1, uv.x);
+				auto x1 = mix(v2, v3, uv.x);
+				auto filtered = mix(x0, x1, uv.y);
+				op.write(dst_layout, uvec2(x, y), layer, level, filtered);
 			}
 		}
 	}
 }
 
+template <typename Ops>
+inline void generate_mipmaps(const Vulkan::TextureFormatLayout &dst_layout,
+                             const Vulkan::TextureFormatLayout &layout, const Ops &op)
+{
+	memcpy(dst_layout.data(0, 0), layout.data(0, 0), dst_layout.get_layer_size(0) * layout.get_layers());
+
+	for (uint32_t level = 1; level < dst_layout.get_levels(); level++)
+		generate_mipmap_level(dst_layout, level, op);
+}
+
 static void copy_dimensions(MemoryMappedTexture &mapped, const Vulkan::TextureFormatLayout &layout, MemoryMappedTextureFlags flags, unsigned levels = 0)
 {
 	switch (layout.get_image_type())
@@ -326,6 +327,46 @@ MemoryMappedTexture generate_mipmaps(const Vulkan::TextureFormatLayout &layout,
 	return mapped;
 }
 
+MemoryMappedTexture create_mipmap_chain(const Vulkan::TextureFormatLayout &layout, MemoryMappedTextureFlags flags)
+{
+	MemoryMappedTexture mapped;
+	copy_dimensions(mapped, layout, flags);
+	if (!mapped.map_write_scratch())
+		return {};
+	memcpy(mapped.get_layout().data(0, 0), layout.data(0, 0),
+	       mapped.get_layout().get_layer_size(0) * layout.get_layers());
+	return mapped;
+}
+
+void generate_mipmap_level(const MemoryMappedTexture &mapped, uint32_t level)
+{
+	auto &dst_layout = mapped.get_layout();
+
+	switch (dst_layout.get_format())
+	{
+	case VK_FORMAT_R8_UNORM:
+		generate_mipmap_level(dst_layout, level, TextureFormatUnorm8());
+		break;
+
+	case VK_FORMAT_R8G8_UNORM:
+		generate_mipmap_level(dst_layout, level, TextureFormatRG8Unorm());
+		break;
+
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		generate_mipmap_level(dst_layout, level, TextureFormatRGBA8Srgb());
+		break;
+
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+		generate_mipmap_level(dst_layout, level, TextureFormatRGBA8Unorm());
+		break;
+
+	default:
+		throw std::logic_error("Unsupported format for generate_mipmaps.");
+	}
+}
+
 MemoryMappedTexture fixup_alpha_edges(const Vulkan::TextureFormatLayout &layout, MemoryMappedTextureFlags flags)
 {
 	MemoryMappedTexture mapped;
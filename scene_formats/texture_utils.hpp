@@ -65,6 +65,14 @@ MemoryMappedTexture generate_mipmaps(const Vulkan::TextureFormatLayout &layout,
 MemoryMappedTexture generate_mipmaps_to_file(const std::string &path, const Vulkan::TextureFormatLayout &layout, MemoryMappedTextureFlags flags);
 MemoryMappedTexture fixup_alpha_edges(const Vulkan::TextureFormatLayout &layout, MemoryMappedTextureFlags flags);
 
+// Incremental variant of generate_mipmaps. create_mipmap_chain() allocates the
+// full chain and copies in level 0, then each level is filled in from the one
+// above it with generate_mipmap_level(). Generating one level per task lets
+// compression of level N overlap generation of level N + 1 instead of the
+// whole chain gating all compression work.
+MemoryMappedTexture create_mipmap_chain(const Vulkan::TextureFormatLayout &layout, MemoryMappedTextureFlags flags);
+void generate_mipmap_level(const MemoryMappedTexture &mapped, uint32_t level);
+
 bool swizzle_image(MemoryMappedTexture &texture, const VkComponentMapping &swizzle);
 
 enum class TransparencyType
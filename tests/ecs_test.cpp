@@ -7,21 +7,23 @@ using namespace std;
 struct AComponent : ComponentBase
 {
 	GRANITE_COMPONENT_TYPE_DECL(AComponent)
+	AComponent() = default;
 	AComponent(int v_)
 		: v(v_)
 	{
 	}
-	int v;
+	int v = 0;
 };
 
 struct BComponent : ComponentBase
 {
 	GRANITE_COMPONENT_TYPE_DECL(BComponent)
+	BComponent() = default;
 	BComponent(int v_)
 		: v(v_)
 	{
 	}
-	int v;
+	int v = 0;
 };
 
 struct CComponent : ComponentBase
@@ -53,4 +55,19 @@ int main()
 		LOGI("BA: %d, %d\n", get<0>(e)->v, get<1>(e)->v);
 	for (auto &e : group_bc)
 		LOGI("BC: %d\n", get<0>(e)->v);
+
+	Entity *bulk[4];
+	pool.create_entities<AComponent, BComponent>(4, bulk);
+	for (unsigned i = 0; i < 4; i++)
+	{
+		bulk[i]->get_component<AComponent>()->v = int(100 + i);
+		bulk[i]->get_component<BComponent>()->v = int(200 + i);
+	}
+
+	for (auto &e : group_ab)
+		LOGI("AB after bulk create: %d, %d\n", get<0>(e)->v, get<1>(e)->v);
+
+	pool.delete_entities(bulk, 4);
+	for (auto &e : group_ab)
+		LOGI("AB after bulk delete: %d, %d\n", get<0>(e)->v, get<1>(e)->v);
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "material_graph.hpp"
+#include "logging.hpp"
+#include <assert.h>
+#include <string.h>
+
+using namespace Granite;
+
+// A representative material: albedo tap modulated by a tint, with an optional
+// detail tap blended in by a feature weight.
+static MaterialGraph::Compiled build(float detail_weight, float tint)
+{
+	MaterialGraph graph;
+	auto uv = graph.add_input("vUV", 2);
+	auto albedo = graph.add_swizzle(graph.add_texture("uAlbedo", uv), "rgb");
+	auto detail = graph.add_swizzle(graph.add_texture("uDetail", uv), "rgb");
+	auto blended = graph.add_mix(albedo, detail, graph.add_constant(detail_weight));
+	auto tinted = graph.add_binary(MaterialGraph::Op::Mul, blended, graph.add_constant(tint));
+	graph.set_output("BaseColor", tinted);
+	return graph.compile();
+}
+
+int main()
+{
+	// Disabled detail must fold away completely: no mix, no detail tap.
+	auto disabled = build(0.0f, 1.0f);
+	assert(strstr(disabled.code.c_str(), "uDetail") == nullptr);
+	assert(strstr(disabled.code.c_str(), "mix(") == nullptr);
+	assert(disabled.textures.size() == 1 && disabled.textures[0] == "uAlbedo");
+
+	// ... and hash identically to the graph authored without the feature,
+	// so both permutations share one pipeline.
+	MaterialGraph plain;
+	auto uv = plain.add_input("vUV", 2);
+	plain.set_output("BaseColor", plain.add_swizzle(plain.add_texture("uAlbedo", uv), "rgb"));
+	auto compiled_plain = plain.compile();
+	assert(compiled_plain.hash == disabled.hash);
+	assert(compiled_plain.code == disabled.code);
+
+	// An enabled feature keeps its code and textures, and hashes differently.
+	auto enabled = build(0.5f, 1.0f);
+	assert(strstr(enabled.code.c_str(), "uDetail") != nullptr);
+	assert(enabled.textures.size() == 2);
+	assert(enabled.hash != disabled.hash);
+
+	// Pure constant subgraphs fold to literals.
+	{
+		MaterialGraph graph;
+		auto half = graph.add_constant(0.25f);
+		auto sum = graph.add_binary(MaterialGraph::Op::Add, half, half);
+		auto two = graph.add_constant(2.0f);
+		graph.set_output("Alpha", graph.add_binary(MaterialGraph::Op::Mul, sum, two));
+		auto compiled = graph.compile();
+		assert(compiled.code == "Alpha = 1.0;\n");
+		assert(compiled.textures.empty());
+	}
+
+	// Identical subexpressions merge: the two taps below share one fetch.
+	{
+		MaterialGraph graph;
+		auto uv = graph.add_input("vUV", 2);
+		auto a = graph.add_swizzle(graph.add_texture("uAlbedo", uv), "rgb");
+		auto b = graph.add_swizzle(graph.add_texture("uAlbedo", uv), "rgb");
+		graph.set_output("BaseColor", graph.add_binary(MaterialGraph::Op::Add, a, b));
+		auto compiled = graph.compile();
+		const char *tap = strstr(compiled.code.c_str(), "texture(");
+		assert(tap != nullptr);
+		assert(strstr(tap + 1, "texture(") == nullptr);
+	}
+
+	LOGI("Material graph folding OK.\n");
+}
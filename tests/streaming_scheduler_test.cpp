@@ -0,0 +1,82 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "streaming_scheduler.hpp"
+#include "logging.hpp"
+#include <assert.h>
+#include <atomic>
+
+using namespace Granite;
+
+int main()
+{
+	ThreadGroup group;
+	group.start(2);
+
+	StreamingScheduler sched(group);
+	sched.set_cpu_budget_per_frame(1e-3);
+	sched.set_upload_budget_per_frame(1024 * 1024);
+	sched.set_promote_distance(10.0f);
+
+	std::atomic<unsigned> promoted_done;
+	std::atomic<unsigned> background_done;
+	promoted_done.store(0);
+	background_done.store(0);
+
+	// Far assets, heavy enough that the initial throughput estimate cannot
+	// fit more than the forward-progress release per frame.
+	for (unsigned i = 0; i < 8; i++)
+	{
+		StreamingScheduler::JobInfo info;
+		info.cpu_bytes = 16 * 1024 * 1024;
+		info.upload_bytes = 512 * 1024;
+		info.distance = []() { return 100.0f; };
+		info.work = [&background_done]() { background_done.fetch_add(1); };
+		sched.enqueue(std::move(info));
+	}
+
+	// Imminent asset. Must release on the first frame regardless of budget.
+	{
+		StreamingScheduler::JobInfo info;
+		info.cpu_bytes = 64 * 1024 * 1024;
+		info.distance = []() { return 1.0f; };
+		info.work = [&promoted_done]() { promoted_done.fetch_add(1); };
+		sched.enqueue(std::move(info));
+	}
+
+	sched.begin_frame();
+	group.wait_idle();
+	assert(promoted_done.load() == 1);
+	assert(background_done.load() < 8);
+
+	unsigned frames = 1;
+	while (!sched.is_idle())
+	{
+		sched.begin_frame();
+		group.wait_idle();
+		frames++;
+		assert(frames < 1000);
+	}
+
+	assert(background_done.load() == 8);
+	LOGI("Streaming scheduler drained 8 background jobs over %u frames.\n", frames);
+}
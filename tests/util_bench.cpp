@@ -0,0 +1,169 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Microbenchmarks for the Util containers which back per-frame work.
+// Iteration counts are fixed so ns / op numbers are comparable across runs
+// on the same machine; run before and after touching these containers.
+
+#include "intrusive_hash_map.hpp"
+#include "object_pool.hpp"
+#include "small_vector.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <thread>
+#include <vector>
+
+using namespace Util;
+
+struct HashedEntry : IntrusiveHashMapEnabled<HashedEntry>
+{
+	explicit HashedEntry(uint64_t value_)
+		: value(value_)
+	{
+	}
+	uint64_t value;
+};
+
+static void bench_intrusive_hash_map()
+{
+	enum { Entries = 64 * 1024, Lookups = 4 * 1024 * 1024 };
+	IntrusiveHashMap<HashedEntry> hash_map;
+
+	auto start_insert = get_current_time_nsecs();
+	for (uint64_t i = 0; i < Entries; i++)
+	{
+		Hasher h;
+		h.u64(i);
+		hash_map.emplace_yield(h.get(), i);
+	}
+	auto end_insert = get_current_time_nsecs();
+
+	uint64_t sum = 0;
+	auto start_lookup = get_current_time_nsecs();
+	for (uint64_t i = 0; i < Lookups; i++)
+	{
+		Hasher h;
+		h.u64(i & (Entries - 1));
+		sum += hash_map.find(h.get())->value;
+	}
+	auto end_lookup = get_current_time_nsecs();
+
+	LOGI("IntrusiveHashMap insert: %.1f ns / op (%u ops)\n",
+	     double(end_insert - start_insert) / double(Entries), unsigned(Entries));
+	LOGI("IntrusiveHashMap lookup: %.1f ns / op (%u ops, checksum %llu)\n",
+	     double(end_lookup - start_lookup) / double(Lookups), unsigned(Lookups),
+	     static_cast<unsigned long long>(sum));
+}
+
+static void bench_object_pool()
+{
+	enum { Objects = 64 * 1024, Iterations = 64 };
+	ObjectPool<HashedEntry> pool;
+	std::vector<HashedEntry *> ptrs;
+	ptrs.reserve(Objects);
+
+	auto start = get_current_time_nsecs();
+	for (unsigned iter = 0; iter < Iterations; iter++)
+	{
+		for (uint64_t i = 0; i < Objects; i++)
+			ptrs.push_back(pool.allocate(i));
+		for (auto *ptr : ptrs)
+			pool.free(ptr);
+		ptrs.clear();
+	}
+	auto end = get_current_time_nsecs();
+
+	LOGI("ObjectPool alloc + free: %.1f ns / op (%u ops)\n",
+	     double(end - start) / double(uint64_t(Objects) * Iterations),
+	     unsigned(Objects * Iterations));
+}
+
+static void bench_thread_safe_object_pool()
+{
+	enum { Objects = 16 * 1024, Iterations = 64, Threads = 4 };
+	ThreadSafeObjectPool<HashedEntry> pool;
+
+	auto start = get_current_time_nsecs();
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < Threads; t++)
+	{
+		workers.emplace_back([&pool]() {
+			std::vector<HashedEntry *> ptrs;
+			ptrs.reserve(Objects);
+			for (unsigned iter = 0; iter < Iterations; iter++)
+			{
+				for (uint64_t i = 0; i < Objects; i++)
+					ptrs.push_back(pool.allocate(i));
+				for (auto *ptr : ptrs)
+					pool.free(ptr);
+				ptrs.clear();
+			}
+		});
+	}
+	for (auto &worker : workers)
+		worker.join();
+	auto end = get_current_time_nsecs();
+
+	LOGI("ThreadSafeObjectPool alloc + free (%u threads): %.1f ns / op (%u ops / thread)\n",
+	     unsigned(Threads),
+	     double(end - start) / double(uint64_t(Objects) * Iterations),
+	     unsigned(Objects * Iterations));
+}
+
+static void bench_small_vector()
+{
+	enum { Iterations = 1024 * 1024, InlineElements = 8, SpillElements = 64 };
+
+	uint32_t sum = 0;
+	auto start_inline = get_current_time_nsecs();
+	for (unsigned iter = 0; iter < Iterations; iter++)
+	{
+		SmallVector<uint32_t, InlineElements> v;
+		for (uint32_t i = 0; i < InlineElements; i++)
+			v.push_back(i);
+		sum += v.back();
+	}
+	auto end_inline = get_current_time_nsecs();
+
+	auto start_spill = get_current_time_nsecs();
+	for (unsigned iter = 0; iter < Iterations; iter++)
+	{
+		SmallVector<uint32_t, InlineElements> v;
+		for (uint32_t i = 0; i < SpillElements; i++)
+			v.push_back(i);
+		sum += v.back();
+	}
+	auto end_spill = get_current_time_nsecs();
+
+	LOGI("SmallVector push_back (inline): %.1f ns / op (checksum %u)\n",
+	     double(end_inline - start_inline) / double(uint64_t(Iterations) * InlineElements), sum);
+	LOGI("SmallVector push_back (spill to heap): %.1f ns / op\n",
+	     double(end_spill - start_spill) / double(uint64_t(Iterations) * SpillElements));
+}
+
+int main()
+{
+	bench_intrusive_hash_map();
+	bench_object_pool();
+	bench_thread_safe_object_pool();
+	bench_small_vector();
+}
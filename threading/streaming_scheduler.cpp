@@ -0,0 +1,196 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "streaming_scheduler.hpp"
+#include "timeline_trace_file.hpp"
+#include "timer.hpp"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+namespace Granite
+{
+StreamingScheduler::StreamingScheduler(ThreadGroup &group_)
+	: group(group_)
+{
+	in_flight.store(0, memory_order_relaxed);
+}
+
+void StreamingScheduler::enqueue(JobInfo info)
+{
+	lock_guard<mutex> holder{lock};
+	pending.push_back(move(info));
+}
+
+void StreamingScheduler::set_cpu_budget_per_frame(double seconds)
+{
+	lock_guard<mutex> holder{lock};
+	cpu_budget = seconds;
+}
+
+void StreamingScheduler::set_upload_budget_per_frame(size_t bytes)
+{
+	lock_guard<mutex> holder{lock};
+	upload_budget = bytes;
+}
+
+void StreamingScheduler::set_promote_distance(float distance)
+{
+	lock_guard<mutex> holder{lock};
+	promote_distance = distance;
+}
+
+double StreamingScheduler::estimate_cpu_time(const JobInfo &info)
+{
+	return double(info.cpu_bytes) / throughput_estimate;
+}
+
+void StreamingScheduler::submit_job(JobInfo info, TaskClass task_class)
+{
+	in_flight.fetch_add(1, memory_order_relaxed);
+
+	auto task = group.create_task([this, work = move(info.work),
+	                               bytes = double(info.cpu_bytes)]() {
+		TIMELINE_TRACE_SCOPE(group.get_timeline_trace_file(), "streaming-job");
+		auto start = Util::get_current_time_nsecs();
+		work();
+		double elapsed = 1e-9 * double(Util::get_current_time_nsecs() - start);
+
+		{
+			lock_guard<mutex> holder{stats_lock};
+			measured_time_accum += elapsed;
+			// EMA over transcode throughput. Only meaningful samples count;
+			// trivial jobs finish below timer resolution.
+			if (bytes > 0.0 && elapsed > 1e-6)
+			{
+				double sample = bytes / elapsed;
+				throughput_estimate = 0.75 * throughput_estimate + 0.25 * sample;
+			}
+		}
+
+		in_flight.fetch_sub(1, memory_order_release);
+	});
+	task->set_task_class(task_class);
+}
+
+void StreamingScheduler::begin_frame()
+{
+	vector<JobInfo> promoted;
+	vector<JobInfo> released;
+
+	{
+		lock_guard<mutex> holder{lock};
+		if (pending.empty())
+		{
+			// Budgets do not accumulate across idle frames, but keep the debt
+			// while released jobs are still running so their cost still counts.
+			if (in_flight.load(memory_order_acquire) == 0)
+			{
+				lock_guard<mutex> stats_holder{stats_lock};
+				measured_time_accum = 0.0;
+				carried_debt = 0.0;
+			}
+			return;
+		}
+
+		// Snapshot distances once; the callbacks may be Scene queries and
+		// should not run per comparison in the sort below.
+		struct Entry
+		{
+			JobInfo info;
+			float distance;
+		};
+		vector<Entry> entries;
+		entries.reserve(pending.size());
+		for (auto &job : pending)
+		{
+			float dist = job.distance ? job.distance() : numeric_limits<float>::max();
+			entries.push_back({ move(job), dist });
+		}
+		pending.clear();
+
+		// About-to-be-visible work does not wait for budget; a late asset on
+		// screen costs more than an over-budget frame.
+		if (promote_distance > 0.0f)
+		{
+			auto itr = remove_if(begin(entries), end(entries), [&](Entry &e) {
+				if (e.distance <= promote_distance)
+				{
+					promoted.push_back(move(e.info));
+					return true;
+				}
+				return false;
+			});
+			entries.erase(itr, end(entries));
+		}
+
+		stable_sort(begin(entries), end(entries),
+		            [](const Entry &a, const Entry &b) { return a.distance < b.distance; });
+
+		double cpu_avail;
+		size_t upload_avail = upload_budget;
+		{
+			lock_guard<mutex> stats_holder{stats_lock};
+			// Overruns from mispredicted jobs last frame eat into this frame.
+			carried_debt = max(carried_debt + measured_time_accum - cpu_budget, 0.0);
+			measured_time_accum = 0.0;
+			cpu_avail = max(cpu_budget - carried_debt, 0.0);
+		}
+
+		bool first = true;
+		for (auto &e : entries)
+		{
+			double est;
+			{
+				lock_guard<mutex> stats_holder{stats_lock};
+				est = estimate_cpu_time(e.info);
+			}
+
+			// Always make forward progress on the nearest job once the debt is
+			// paid off, even if it alone exceeds the budget.
+			bool fits = est <= cpu_avail && e.info.upload_bytes <= upload_avail;
+			if (fits || (first && cpu_avail > 0.0))
+			{
+				cpu_avail = max(cpu_avail - est, 0.0);
+				upload_avail -= min(e.info.upload_bytes, upload_avail);
+				released.push_back(move(e.info));
+				first = false;
+			}
+			else
+				pending.push_back(move(e.info));
+		}
+	}
+
+	for (auto &job : promoted)
+		submit_job(move(job), TaskClass::Frame);
+	for (auto &job : released)
+		submit_job(move(job), TaskClass::Background);
+}
+
+bool StreamingScheduler::is_idle()
+{
+	lock_guard<mutex> holder{lock};
+	return pending.empty() && in_flight.load(memory_order_acquire) == 0;
+}
+}
@@ -0,0 +1,101 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "thread_group.hpp"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stddef.h>
+
+namespace Granite
+{
+// Rate-limits streaming work (texture/mesh transcodes, audio decodes and
+// their uploads) so a burst of loads amortizes over many frames instead of
+// flooding the ThreadGroup in one. Jobs carry byte estimates for the CPU-side
+// transcode and the eventual PCIe upload; begin_frame() releases pending jobs
+// as background class tasks until either the per-frame CPU time budget or the
+// upload byte budget runs out. CPU cost is predicted from the byte count
+// through a running throughput estimate, and the *measured* time of released
+// jobs (also recorded into the timeline trace) is carried as debt against the
+// next frame's budget, so mispredictions cannot accumulate into a hitch.
+//
+// A job may provide a distance callback (typically a Scene distance query
+// against the camera). Jobs within the promote distance are about to be
+// visible and are released immediately at frame class, bypassing the budget:
+// a late asset on screen is worse than one over-budget frame. Everything else
+// releases nearest-first.
+class StreamingScheduler
+{
+public:
+	explicit StreamingScheduler(ThreadGroup &group);
+
+	struct JobInfo
+	{
+		// Runs on a worker thread once released.
+		std::function<void ()> work;
+		// Bytes the CPU-side transcode reads or writes; feeds the time estimate.
+		size_t cpu_bytes = 0;
+		// Bytes which will ride the bus to the GPU when the job completes.
+		size_t upload_bytes = 0;
+		// Optional. Re-evaluated in begin_frame() on the calling thread;
+		// returns the current distance from the viewer to the asset.
+		std::function<float ()> distance;
+	};
+
+	void enqueue(JobInfo info);
+
+	// Worker time per frame spent on background streaming, in seconds.
+	void set_cpu_budget_per_frame(double seconds);
+	void set_upload_budget_per_frame(size_t bytes);
+	// Jobs whose distance callback reports at most this are promoted past the
+	// budget. <= 0 disables promotion.
+	void set_promote_distance(float distance);
+
+	// Call once per frame. Evaluates distances, promotes imminent jobs and
+	// releases budgeted background work.
+	void begin_frame();
+
+	bool is_idle();
+
+private:
+	ThreadGroup &group;
+
+	std::mutex lock;
+	std::deque<JobInfo> pending;
+	double cpu_budget = 2e-3;
+	size_t upload_budget = 8 * 1024 * 1024;
+	float promote_distance = 0.0f;
+
+	// Updated by workers as released jobs retire.
+	std::mutex stats_lock;
+	double throughput_estimate = 256.0 * 1024.0 * 1024.0;
+	double measured_time_accum = 0.0;
+	double carried_debt = 0.0;
+	std::atomic<unsigned> in_flight;
+
+	double estimate_cpu_time(const JobInfo &info);
+	void submit_job(JobInfo info, TaskClass task_class);
+};
+}
@@ -0,0 +1,106 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "task_graph.hpp"
+#include <assert.h>
+
+using namespace std;
+
+namespace Granite
+{
+TaskGraphTemplate::TaskGraphTemplate(ThreadGroup &group_)
+	: group(group_)
+{
+}
+
+unsigned TaskGraphTemplate::add_node(std::string name, std::function<void ()> func, TaskClass task_class)
+{
+	Node node;
+	node.name = move(name);
+	node.func = move(func);
+	node.task_class = task_class;
+	nodes.push_back(move(node));
+	return unsigned(nodes.size() - 1);
+}
+
+void TaskGraphTemplate::add_edge(unsigned from, unsigned to)
+{
+	assert(from < nodes.size() && to < nodes.size() && from != to);
+	edges.push_back({ from, to });
+}
+
+void TaskGraphTemplate::add_cross_frame_edge(unsigned from, unsigned to)
+{
+	assert(from < nodes.size() && to < nodes.size());
+	nodes[from].has_cross_frame_dependees = true;
+	cross_frame_edges.push_back({ from, to });
+}
+
+void TaskGraphTemplate::enqueue_frame()
+{
+	// Drop last frame's handles so the TaskGroup/TaskDeps objects go back to
+	// the pools before we allocate this frame's set.
+	current_frame.clear();
+	current_frame.reserve(nodes.size());
+
+	for (auto &node : nodes)
+	{
+		auto task = group.create_task(node.func);
+		task->set_task_class(node.task_class);
+		current_frame.push_back(move(task));
+	}
+
+	for (auto &edge : edges)
+		group.add_dependency(current_frame[edge.to], current_frame[edge.from]);
+
+	// Wire last frame's latches into this frame's heads, then let them fire.
+	// The latches were deliberately left unflushed by the previous
+	// enqueue_frame() exactly so this add_dependency() is legal.
+	for (auto &edge : cross_frame_edges)
+		if (edge.from < carry.size() && carry[edge.from])
+			group.add_dependency(current_frame[edge.to], carry[edge.from]);
+
+	for (auto &latch : carry)
+		if (latch)
+			group.submit(latch);
+
+	// Fresh latches for the frame after this one.
+	carry.resize(nodes.size());
+	for (unsigned i = 0; i < unsigned(nodes.size()); i++)
+	{
+		if (nodes[i].has_cross_frame_dependees)
+		{
+			carry[i] = group.create_task();
+			group.add_dependency(carry[i], current_frame[i]);
+		}
+	}
+
+	for (auto &task : current_frame)
+		task->flush();
+}
+
+void TaskGraphTemplate::wait_frame()
+{
+	for (auto &task : current_frame)
+		task->wait();
+}
+}
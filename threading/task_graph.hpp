@@ -0,0 +1,89 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "thread_group.hpp"
+#include <string>
+
+namespace Granite
+{
+// A per-frame CPU task graph whose structure is declared once and then
+// instantiated every frame. The frame structure (update -> cull -> record and
+// friends) is identical from frame to frame, so re-declaring it with fresh
+// TaskGroups every frame only pays setup time; the template keeps the node
+// and edge lists and per-frame instantiation reduces to wiring recycled
+// Task/TaskDeps objects from the thread group's object pools.
+//
+// Cross-frame edges let frame N's tail overlap frame N + 1's head, e.g.
+// record(N) -> update(N + 1) when update touches state record still reads.
+// The edge is expressed through a small empty latch group which is kept
+// unflushed until the next frame has been wired up, so the normal
+// add_dependency() rules apply without any cross-frame special cases.
+class TaskGraphTemplate
+{
+public:
+	explicit TaskGraphTemplate(ThreadGroup &group);
+
+	// Declaration phase. Node indices are stable and returned in call order.
+	unsigned add_node(std::string name, std::function<void ()> func,
+	                  TaskClass task_class = TaskClass::Frame);
+	// from must complete before to starts, within one frame.
+	void add_edge(unsigned from, unsigned to);
+	// from in frame N must complete before to starts in frame N + 1.
+	void add_cross_frame_edge(unsigned from, unsigned to);
+
+	// Instantiates and flushes one frame of the declared structure.
+	// Returns immediately; the frame runs on the workers.
+	void enqueue_frame();
+
+	// Blocks until the most recently enqueued frame has fully completed.
+	void wait_frame();
+
+private:
+	ThreadGroup &group;
+
+	struct Node
+	{
+		std::string name;
+		std::function<void ()> func;
+		TaskClass task_class = TaskClass::Frame;
+		bool has_cross_frame_dependees = false;
+	};
+
+	struct Edge
+	{
+		unsigned from;
+		unsigned to;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Edge> edges;
+	std::vector<Edge> cross_frame_edges;
+
+	// Latch groups from the previous frame, indexed by node. Only nodes with
+	// outgoing cross-frame edges have one.
+	std::vector<TaskGroup> carry;
+	// Kept so wait_frame() has something to wait on after the flush.
+	std::vector<TaskGroup> current_frame;
+};
+}
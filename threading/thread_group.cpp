@@ -23,15 +23,24 @@
 #include "thread_group.hpp"
 #include <assert.h>
 #include <stdexcept>
+#include <algorithm>
 #include "logging.hpp"
 #include "global_managers.hpp"
 #include "thread_id.hpp"
+#include "timeline_trace_file.hpp"
+#include "spin_wait.hpp"
 
 using namespace std;
 
 namespace Granite
 {
 
+// Lets a worker which spawns follow-up tasks push them straight into its own
+// work-stealing deque instead of going through the shared queue.
+static thread_local ThreadGroup *current_worker_group = nullptr;
+static thread_local Internal::TaskDeque *current_worker_queue = nullptr;
+static thread_local TaskClass current_task_class = TaskClass::Frame;
+
 namespace Internal
 {
 TaskGroup::TaskGroup(ThreadGroup *group_)
@@ -39,6 +48,97 @@ TaskGroup::TaskGroup(ThreadGroup *group_)
 {
 }
 
+TaskDeque::Buffer::Buffer(size_t count)
+	: mask(count - 1), tasks(new std::atomic<Task *>[count])
+{
+	assert((count & (count - 1)) == 0);
+}
+
+TaskDeque::TaskDeque()
+{
+	top.store(0, memory_order_relaxed);
+	bottom.store(0, memory_order_relaxed);
+	buffer.store(new Buffer(64), memory_order_relaxed);
+}
+
+TaskDeque::~TaskDeque()
+{
+	auto *buf = buffer.load(memory_order_relaxed);
+	while (buf)
+	{
+		auto *prev = buf->prev;
+		delete buf;
+		buf = prev;
+	}
+}
+
+TaskDeque::Buffer *TaskDeque::grow(Buffer *buf, int64_t b, int64_t t)
+{
+	auto *new_buf = new Buffer((buf->mask + 1) * 2);
+	for (int64_t i = t; i < b; i++)
+		new_buf->tasks[i & new_buf->mask].store(buf->tasks[i & buf->mask].load(memory_order_relaxed),
+		                                        memory_order_relaxed);
+	new_buf->prev = buf;
+	buffer.store(new_buf, memory_order_release);
+	return new_buf;
+}
+
+void TaskDeque::push(Task *task)
+{
+	int64_t b = bottom.load(memory_order_relaxed);
+	int64_t t = top.load(memory_order_acquire);
+	auto *buf = buffer.load(memory_order_relaxed);
+
+	if (b - t > int64_t(buf->mask))
+		buf = grow(buf, b, t);
+
+	buf->tasks[b & buf->mask].store(task, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	bottom.store(b + 1, memory_order_relaxed);
+}
+
+Task *TaskDeque::pop()
+{
+	int64_t b = bottom.load(memory_order_relaxed) - 1;
+	auto *buf = buffer.load(memory_order_relaxed);
+	bottom.store(b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t t = top.load(memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Deque was empty, restore the invariant.
+		bottom.store(b + 1, memory_order_relaxed);
+		return nullptr;
+	}
+
+	Task *task = buf->tasks[b & buf->mask].load(memory_order_relaxed);
+	if (t == b)
+	{
+		// Last element, race against concurrent steals for it.
+		if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+			task = nullptr;
+		bottom.store(b + 1, memory_order_relaxed);
+	}
+	return task;
+}
+
+Task *TaskDeque::steal()
+{
+	int64_t t = top.load(memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t b = bottom.load(memory_order_acquire);
+
+	if (t >= b)
+		return nullptr;
+
+	auto *buf = buffer.load(memory_order_acquire);
+	Task *task = buf->tasks[t & buf->mask].load(memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+		return nullptr;
+	return task;
+}
+
 void TaskDeps::notify_dependees()
 {
 	if (signal)
@@ -86,16 +186,10 @@ void TaskGroup::flush()
 		throw logic_error("Cannot flush more than once.");
 	flushed = true;
 
-	if (deps->dependency_count == 0)
-	{
-		if (deps->pending_tasks.empty())
-			deps->notify_dependees();
-		else
-		{
-			group->move_to_ready_tasks(deps->pending_tasks);
-			deps->pending_tasks.clear();
-		}
-	}
+	// Satisfies the flush token dependency_count starts out with. Tasks only
+	// start once the group is flushed and all dependencies have completed,
+	// in whichever order that happens.
+	deps->dependency_satisfied();
 }
 
 void TaskGroup::wait()
@@ -125,6 +219,10 @@ void ThreadGroup::start(unsigned num_threads)
 	active = true;
 
 	thread_group.resize(num_threads);
+	worker_queues.clear();
+	worker_queues.reserve(num_threads);
+	for (unsigned i = 0; i < num_threads; i++)
+		worker_queues.push_back(make_unique<Internal::TaskDeque>());
 
 	// Make sure the worker threads have the correct global data references.
 	auto ctx = std::shared_ptr<Global::GlobalManagers>(Global::create_thread_context().release(),
@@ -160,13 +258,36 @@ void ThreadGroup::add_dependency(TaskGroup &dependee, TaskGroup &dependency)
 
 void ThreadGroup::move_to_ready_tasks(const std::vector<Internal::Task *> &list)
 {
-	lock_guard<mutex> holder{cond_lock};
 	total_tasks.fetch_add(list.size(), memory_order_relaxed);
+	queued_tasks.fetch_add(list.size(), memory_order_release);
+
+	auto task_class = list.front()->deps->task_class;
+
+	if (task_class == TaskClass::Frame && current_worker_group == this && current_worker_queue)
+	{
+		for (auto &t : list)
+			current_worker_queue->push(t);
+	}
+	else
+	{
+		if (task_class == TaskClass::RenderCritical)
+			critical_tasks.fetch_add(list.size(), memory_order_release);
+		lock_guard<mutex> holder{cond_lock};
+		for (auto &t : list)
+			ready_tasks[unsigned(task_class)].push(t);
+	}
+
+	notify_workers(list.size());
+}
 
-	for (auto &t : list)
-		ready_tasks.push(t);
+void ThreadGroup::notify_workers(size_t count)
+{
+	// Only bother taking the lock if someone is actually parked.
+	if (num_sleepers.load(memory_order_acquire) == 0)
+		return;
 
-	if (list.size() > 1)
+	lock_guard<mutex> holder{cond_lock};
+	if (count > 1)
 		cond.notify_all();
 	else
 		cond.notify_one();
@@ -194,17 +315,31 @@ void ThreadGroup::free_task_deps(Internal::TaskDeps *deps)
 
 void TaskSignal::signal_increment()
 {
+	// Take the lock so the increment cannot slip in between a waiter's counter
+	// check and its wait, but only wake when someone actually waits.
 	lock_guard<mutex> holder{lock};
-	counter++;
-	cond.notify_all();
+	counter.fetch_add(1, memory_order_release);
+	if (waiters.load(memory_order_relaxed) != 0)
+		cond.notify_all();
 }
 
-void TaskSignal::wait_until_at_least(uint64_t count)
+void TaskSignal::wait_until_at_least(uint64_t count, unsigned spin_pauses)
 {
+	// Fast path, the signal has usually fired already by the time we wait.
+	if (counter.load(memory_order_acquire) >= count)
+		return;
+
+	// Short dependencies tend to complete within microseconds, so burn a
+	// bounded spin budget in user space before paying for a context switch.
+	if (Util::spin_wait_until([&]() { return counter.load(memory_order_acquire) >= count; }, spin_pauses))
+		return;
+
 	unique_lock<mutex> holder{lock};
+	waiters.fetch_add(1, memory_order_relaxed);
 	cond.wait(holder, [&]() -> bool {
-		return counter >= count;
+		return counter.load(memory_order_acquire) >= count;
 	});
+	waiters.fetch_sub(1, memory_order_relaxed);
 }
 
 TaskGroup ThreadGroup::create_task(std::function<void()> func)
@@ -231,6 +366,13 @@ void Internal::TaskGroup::set_fence_counter_signal(TaskSignal *signal)
 	deps->signal = signal;
 }
 
+void Internal::TaskGroup::set_task_class(TaskClass task_class)
+{
+	if (flushed)
+		throw logic_error("Cannot set class on a flushed task group.");
+	deps->task_class = task_class;
+}
+
 ThreadGroup *Internal::TaskGroup::get_thread_group() const
 {
 	return group;
@@ -251,6 +393,94 @@ void ThreadGroup::enqueue_task(TaskGroup &group, std::function<void()> func)
 	group->deps->count.fetch_add(1, memory_order_relaxed);
 }
 
+namespace Internal
+{
+// Shared by all tasks of one parallel_for. Workers grab grain-sized chunks
+// with a fetch_add, so there is exactly one heap allocation per loop rather
+// than one per chunk.
+struct ParallelForState
+{
+	std::atomic<size_t> next;
+	size_t count = 0;
+	size_t grain = 0;
+	ThreadGroup *group = nullptr;
+	ThreadGroup::ParallelForFunc func;
+
+	void run()
+	{
+		for (;;)
+		{
+			size_t chunk_begin = next.fetch_add(grain, memory_order_relaxed);
+			if (chunk_begin >= count)
+				break;
+			func(chunk_begin, std::min(chunk_begin + grain, count));
+			// Chunk boundaries are the natural yield points for background loops.
+			group->maybe_yield();
+		}
+	}
+};
+}
+
+void ThreadGroup::parallel_for(size_t count, size_t grain, const ParallelForFunc &func)
+{
+	if (!count)
+		return;
+	grain = std::max<size_t>(grain, 1);
+
+	unsigned num_workers = get_num_threads();
+	size_t num_chunks = (count + grain - 1) / grain;
+	if (num_workers == 0 || num_chunks < 2)
+	{
+		func(0, count);
+		return;
+	}
+
+	auto state = make_shared<Internal::ParallelForState>();
+	state->next.store(0, memory_order_relaxed);
+	state->count = count;
+	state->grain = grain;
+	state->group = this;
+	state->func = func;
+
+	// The calling thread chews on chunks as well, so it needs one fewer task.
+	auto num_tasks = unsigned(std::min<size_t>(num_workers, num_chunks - 1));
+	auto task = create_task();
+	for (unsigned i = 0; i < num_tasks; i++)
+		task->enqueue_task([state]() { state->run(); });
+	task->flush();
+
+	state->run();
+	task->wait();
+}
+
+TaskGroup ThreadGroup::create_parallel_for_task(size_t count, size_t grain, ParallelForFunc func)
+{
+	grain = std::max<size_t>(grain, 1);
+	size_t num_chunks = count ? (count + grain - 1) / grain : 0;
+	unsigned num_workers = get_num_threads();
+
+	if (num_workers == 0 || num_chunks < 2)
+	{
+		return create_task([func = move(func), count]() {
+			if (count)
+				func(0, count);
+		});
+	}
+
+	auto state = make_shared<Internal::ParallelForState>();
+	state->next.store(0, memory_order_relaxed);
+	state->count = count;
+	state->grain = grain;
+	state->group = this;
+	state->func = move(func);
+
+	auto num_tasks = unsigned(std::min<size_t>(num_workers, num_chunks));
+	auto task = create_task();
+	for (unsigned i = 0; i < num_tasks; i++)
+		task->enqueue_task([state]() { state->run(); });
+	return task;
+}
+
 void ThreadGroup::wait_idle()
 {
 	unique_lock<mutex> holder{wait_cond_lock};
@@ -264,6 +494,80 @@ bool ThreadGroup::is_idle()
 	return total_tasks.load(memory_order_acquire) == completed_tasks.load(memory_order_acquire);
 }
 
+Internal::Task *ThreadGroup::dequeue_ready_task(TaskClass task_class)
+{
+	if (task_class == TaskClass::RenderCritical && critical_tasks.load(memory_order_acquire) == 0)
+		return nullptr;
+
+	lock_guard<mutex> holder{cond_lock};
+	auto &queue = ready_tasks[unsigned(task_class)];
+	if (queue.empty())
+		return nullptr;
+
+	auto *task = queue.front();
+	queue.pop();
+	if (task_class == TaskClass::RenderCritical)
+		critical_tasks.fetch_sub(1, memory_order_relaxed);
+	return task;
+}
+
+Internal::Task *ThreadGroup::dequeue_task(unsigned queue_index)
+{
+	// Render-critical tasks jump ahead of everything, including our own deque.
+	auto *task = dequeue_ready_task(TaskClass::RenderCritical);
+
+	// Then own deque, then steal round-robin. The deques only hold frame class.
+	if (!task)
+		task = worker_queues[queue_index]->pop();
+
+	auto count = unsigned(worker_queues.size());
+	for (unsigned i = 1; i < count && !task; i++)
+		task = worker_queues[(queue_index + i) % count]->steal();
+
+	// Shared queues take submissions from non-worker threads. Background only
+	// runs once nothing of a higher class is queued anywhere.
+	if (!task)
+		task = dequeue_ready_task(TaskClass::Frame);
+	if (!task)
+		task = dequeue_ready_task(TaskClass::Background);
+
+	if (task)
+		queued_tasks.fetch_sub(1, memory_order_relaxed);
+	return task;
+}
+
+void ThreadGroup::run_task(Internal::Task *task)
+{
+	auto prev_class = current_task_class;
+	current_task_class = task->deps->task_class;
+	if (task->func)
+		task->func();
+	current_task_class = prev_class;
+
+	task->deps->task_completed();
+	task_pool.free(task);
+
+	auto completed = completed_tasks.fetch_add(1, memory_order_relaxed) + 1;
+	if (completed == total_tasks.load(memory_order_relaxed))
+	{
+		lock_guard<mutex> holder{wait_cond_lock};
+		wait_cond.notify_one();
+	}
+}
+
+void ThreadGroup::maybe_yield()
+{
+	if (current_task_class != TaskClass::Background || current_worker_group != this)
+		return;
+
+	Internal::Task *task;
+	while ((task = dequeue_ready_task(TaskClass::RenderCritical)) != nullptr)
+	{
+		queued_tasks.fetch_sub(1, memory_order_relaxed);
+		run_task(task);
+	}
+}
+
 void ThreadGroup::thread_looper(unsigned index)
 {
 #ifdef GRANITE_VULKAN_MT
@@ -272,39 +576,34 @@ void ThreadGroup::thread_looper(unsigned index)
 	(void)index;
 #endif
 
+	{
+		char tid[32];
+		snprintf(tid, sizeof(tid), "worker-%u", index);
+		Util::TimelineTraceFile::set_tid(tid);
+	}
+
+	current_worker_group = this;
+	current_worker_queue = worker_queues[index - 1].get();
+
 	for (;;)
 	{
-		Internal::Task *task = nullptr;
+		Internal::Task *task = dequeue_task(index - 1);
 
+		if (!task)
 		{
 			unique_lock<mutex> holder{cond_lock};
+			num_sleepers.fetch_add(1, memory_order_release);
 			cond.wait(holder, [&]() {
-				return dead || !ready_tasks.empty();
+				return dead || queued_tasks.load(memory_order_acquire) != 0;
 			});
+			num_sleepers.fetch_sub(1, memory_order_relaxed);
 
-			if (dead && ready_tasks.empty())
+			if (dead && queued_tasks.load(memory_order_relaxed) == 0)
 				break;
-
-			task = ready_tasks.front();
-			ready_tasks.pop();
+			continue;
 		}
 
-		if (task->func)
-			task->func();
-
-		task->deps->task_completed();
-		task_pool.free(task);
-
-		{
-			auto completed = completed_tasks.fetch_add(1, memory_order_relaxed) + 1;
-			//LOGI("Task completed (%u / %u)!\n", completed, total_tasks.load(memory_order_relaxed));
-
-			if (completed == total_tasks.load(memory_order_relaxed))
-			{
-				lock_guard<mutex> holder{wait_cond_lock};
-				wait_cond.notify_one();
-			}
-		}
+		run_task(task);
 	}
 }
 
@@ -313,8 +612,12 @@ ThreadGroup::ThreadGroup()
 #ifdef GRANITE_VULKAN_MT
 	Vulkan::register_thread_index(0);
 #endif
+	Util::TimelineTraceFile::set_tid("main");
 	total_tasks.store(0);
 	completed_tasks.store(0);
+	queued_tasks.store(0);
+	critical_tasks.store(0);
+	num_sleepers.store(0);
 }
 
 ThreadGroup::~ThreadGroup()
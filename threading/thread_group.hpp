@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
@@ -33,6 +34,11 @@
 #include "variant.hpp"
 #include "intrusive.hpp"
 
+namespace Util
+{
+class TimelineTraceFile;
+}
+
 namespace Granite
 {
 class ThreadGroup;
@@ -41,10 +47,36 @@ struct TaskSignal
 {
 	std::condition_variable cond;
 	std::mutex lock;
-	uint64_t counter = 0;
+	std::atomic<uint64_t> counter;
+	std::atomic<uint32_t> waiters;
+
+	TaskSignal()
+	{
+		counter.store(0, std::memory_order_relaxed);
+		waiters.store(0, std::memory_order_relaxed);
+	}
 
 	void signal_increment();
-	void wait_until_at_least(uint64_t count);
+
+	// Spin budget in pause iterations before parking in the kernel. The
+	// render thread's short waits on culling/record tasks usually complete
+	// within the default budget; pass 0 for waits known to be long.
+	enum : unsigned { DefaultSpinPauses = 1024 };
+	void wait_until_at_least(uint64_t count, unsigned spin_pauses = DefaultSpinPauses);
+};
+
+// Scheduling class for a TaskGroup. Workers drain higher classes first:
+// render-critical tasks jump ahead of everything including the work-stealing
+// deques, frame tasks are the default, and background tasks only run when
+// nothing of a higher class is queued anywhere. Long-running background tasks
+// can cooperate further by calling ThreadGroup::maybe_yield() between natural
+// chunk boundaries; parallel_for chunks do this automatically.
+enum class TaskClass : unsigned
+{
+	RenderCritical = 0,
+	Frame,
+	Background,
+	Count
 };
 
 namespace Internal
@@ -69,7 +101,10 @@ struct TaskDeps : Util::IntrusivePtrEnabled<TaskDeps, TaskDepsDeleter, Util::Mul
 	    : group(group_)
 	{
 		count.store(0, std::memory_order_relaxed);
-		dependency_count.store(0, std::memory_order_relaxed);
+		// One implicit dependency which TaskGroup::flush() satisfies, so
+		// externally completed dependencies (e.g. async IO gates) cannot
+		// start or retire the group before it has been flushed.
+		dependency_count.store(1, std::memory_order_relaxed);
 	}
 
 	ThreadGroup *group;
@@ -79,6 +114,8 @@ struct TaskDeps : Util::IntrusivePtrEnabled<TaskDeps, TaskDepsDeleter, Util::Mul
 	std::vector<Task *> pending_tasks;
 	TaskSignal *signal = nullptr;
 	std::atomic_uint dependency_count;
+	// Set before flush() and read when the tasks become ready, so no atomics.
+	TaskClass task_class = TaskClass::Frame;
 
 	void task_completed();
 	void dependency_satisfied();
@@ -101,6 +138,7 @@ struct TaskGroup : Util::IntrusivePtrEnabled<TaskGroup, TaskGroupDeleter, Util::
 	TaskDepsHandle deps;
 	void enqueue_task(std::function<void ()> func);
 	void set_fence_counter_signal(TaskSignal *signal);
+	void set_task_class(TaskClass task_class);
 	ThreadGroup *get_thread_group() const;
 
 	unsigned id = 0;
@@ -119,6 +157,41 @@ struct Task
 	TaskDepsHandle deps;
 	std::function<void ()> func;
 };
+
+// Chase-Lev work-stealing deque. The owning worker pushes and pops at the
+// bottom without taking locks, other workers steal from the top with a CAS.
+class TaskDeque
+{
+public:
+	TaskDeque();
+	~TaskDeque();
+	TaskDeque(const TaskDeque &) = delete;
+	void operator=(const TaskDeque &) = delete;
+
+	// Owner thread only.
+	void push(Task *task);
+	Task *pop();
+
+	// Any thread.
+	Task *steal();
+
+private:
+	struct Buffer
+	{
+		explicit Buffer(size_t count);
+		size_t mask;
+		std::unique_ptr<std::atomic<Task *>[]> tasks;
+		// Retired buffers are kept alive until the deque dies so in-flight
+		// steals never read freed memory.
+		Buffer *prev = nullptr;
+	};
+
+	std::atomic<int64_t> top;
+	std::atomic<int64_t> bottom;
+	std::atomic<Buffer *> buffer;
+
+	Buffer *grow(Buffer *buf, int64_t b, int64_t t);
+};
 }
 
 using TaskGroup = Util::IntrusivePtr<Internal::TaskGroup>;
@@ -144,6 +217,17 @@ public:
 	TaskGroup create_task(std::function<void ()> func);
 	TaskGroup create_task();
 
+	using ParallelForFunc = std::function<void (size_t begin, size_t end)>;
+
+	// Partitions [0, count) into grain-sized chunks and runs func over them on
+	// the workers. The calling thread participates and the call blocks until
+	// the whole range is done. Small ranges run inline without scheduling.
+	void parallel_for(size_t count, size_t grain, const ParallelForFunc &func);
+
+	// Deferred variant which returns a TaskGroup so the loop can be chained
+	// into dependency graphs with add_dependency() like any other task.
+	TaskGroup create_parallel_for_task(size_t count, size_t grain, ParallelForFunc func);
+
 	void move_to_ready_tasks(const std::vector<Internal::Task *> &list);
 
 	void add_dependency(TaskGroup &dependee, TaskGroup &dependency);
@@ -155,25 +239,57 @@ public:
 	void wait_idle();
 	bool is_idle();
 
+	// Cooperative yield point for long background tasks. If the calling task
+	// is background class and render-critical tasks are pending, they run
+	// inline here before the background work resumes. Higher classes never
+	// yield downwards, so this is free to call unconditionally.
+	void maybe_yield();
+
+	// Non-owning. Lets task code record CPU zones into the device trace with
+	// TIMELINE_TRACE_SCOPE without threading the file through every system.
+	void set_timeline_trace_file(Util::TimelineTraceFile *file)
+	{
+		timeline_trace_file = file;
+	}
+
+	Util::TimelineTraceFile *get_timeline_trace_file() const
+	{
+		return timeline_trace_file;
+	}
+
 private:
 	Util::ThreadSafeObjectPool<Internal::Task> task_pool;
 	Util::ThreadSafeObjectPool<Internal::TaskGroup> task_group_pool;
 	Util::ThreadSafeObjectPool<Internal::TaskDeps> task_deps_pool;
 
-	std::queue<Internal::Task *> ready_tasks;
+	// Per-class fallback queues. The deques only ever hold frame class tasks
+	// pushed by the workers themselves; everything else (submissions from
+	// non-worker threads, render-critical, background) goes through here.
+	std::queue<Internal::Task *> ready_tasks[unsigned(TaskClass::Count)];
+	std::vector<std::unique_ptr<Internal::TaskDeque>> worker_queues;
 
 	std::vector<std::unique_ptr<std::thread>> thread_group;
 	std::mutex cond_lock;
 	std::condition_variable cond;
 
 	void thread_looper(unsigned self_index);
+	Internal::Task *dequeue_task(unsigned queue_index);
+	Internal::Task *dequeue_ready_task(TaskClass task_class);
+	void run_task(Internal::Task *task);
+	void notify_workers(size_t count);
 
 	bool active = false;
 	bool dead = false;
+	Util::TimelineTraceFile *timeline_trace_file = nullptr;
 
 	std::condition_variable wait_cond;
 	std::mutex wait_cond_lock;
 	std::atomic_uint total_tasks;
 	std::atomic_uint completed_tasks;
+	std::atomic_uint queued_tasks;
+	// Cheap hint so the common dequeue path can skip the lock when no
+	// render-critical work is pending.
+	std::atomic_uint critical_tasks;
+	std::atomic_uint num_sleepers;
 };
 }
\ No newline at end of file
@@ -11,27 +11,43 @@ def main():
                         help = 'Path to place the Blob',
                         required = True)
     parser.add_argument('--input', metavar = ('path', 'blob-path'), type = str, nargs = 2, action = 'append')
+    parser.add_argument('--align', type = int, default = 1,
+                        help = 'Align each member to this many bytes in the file, e.g. 4096 so mmapped members start page-aligned.')
 
     args = parser.parse_args()
     if len(args.input) == 0:
         raise AssertionError('Need at least one input file.')
+    if args.align < 1 or (args.align & (args.align - 1)) != 0:
+        raise AssertionError('Alignment must be a power of two.')
 
-    byte_offset = 0
-    archive_files = []
-
+    input_files = []
     for input in args.input:
         if os.path.isfile(input[0]):
-            size = os.path.getsize(input[0])
-            archive_files.append((input[0], input[1], byte_offset, size))
-            byte_offset += size
+            input_files.append((input[0], input[1], os.path.getsize(input[0])))
         else:
             for root, dirs, files in os.walk(input[0]):
                 for file in files:
                     fullpath = os.path.join(root, file)
                     size = os.path.getsize(fullpath)
                     rpath = os.path.relpath(fullpath, input[0])
-                    archive_files.append((fullpath, os.path.join(input[1], rpath), byte_offset, size))
-                    byte_offset += size
+                    input_files.append((fullpath, os.path.join(input[1], rpath), size))
+
+    # Offsets are stored relative to the DATA payload, but alignment must
+    # hold for the absolute file offset, so lay out members knowing where
+    # the payload starts. The header size does not depend on the offsets.
+    data_base = 8
+    for entry in input_files:
+        data_base += 4 + 1 + len(entry[1].encode('utf-8')) + 16
+    data_base += 4
+
+    byte_offset = 0
+    archive_files = []
+    for entry in input_files:
+        rem = (data_base + byte_offset) % args.align
+        if rem != 0:
+            byte_offset += args.align - rem
+        archive_files.append((entry[0], entry[1], byte_offset, entry[2]))
+        byte_offset += entry[2]
 
     with open(args.output, 'wb') as f:
         f.write('BLOBBY01'.encode('ascii'))
@@ -45,11 +61,16 @@ def main():
             f.write(struct.pack('<Q', entry[2]))
             f.write(struct.pack('<Q', entry[3]))
         f.write('DATA'.encode('ascii'))
+        current_offset = 0
         for entry in archive_files:
+            if entry[2] != current_offset:
+                f.write(b'\x00' * (entry[2] - current_offset))
+                current_offset = entry[2]
             with open(entry[0], 'rb') as fr:
                 bytes = fr.read()
                 f.write(bytes)
+                current_offset += len(bytes)
 
 
 if __name__ == '__main__':
-    main()
\ No newline at end of file
+    main()
@@ -60,6 +60,9 @@ static void print_help()
 	LOGI("[--optimize-meshes]\n");
 	LOGI("[--stripify-meshes]\n");
 	LOGI("[--quantize-attributes]\n");
+	LOGI("[--supercompress-textures]\n");
+	LOGI("[--texcomp-rdo <all|basecolor,normal,metallicroughness,occlusion,emissive>]\n");
+	LOGI("[--texcomp-rdo-lambda <max extra RMS error per texel>]\n");
 	LOGI("[--flip-tangent-w]\n");
 	LOGI("[--renormalize-normals]\n");
 	LOGI("[--gltf]\n");
@@ -116,6 +119,40 @@ int main(int argc, char *argv[])
 		options.quantize_attributes = true;
 	});
 
+	cbs.add("--supercompress-textures", [&](CLIParser &) {
+		options.supercompress_textures = true;
+	});
+
+	cbs.add("--texcomp-rdo", [&](CLIParser &parser) {
+		string classes = parser.next_string();
+		size_t offset = 0;
+		while (offset < classes.size())
+		{
+			auto comma = classes.find(',', offset);
+			auto cls = classes.substr(offset, comma == string::npos ? string::npos : comma - offset);
+			offset = comma == string::npos ? classes.size() : comma + 1;
+
+			if (cls == "all")
+				options.rdo_texture_mask = ~0u;
+			else if (cls == "basecolor")
+				options.rdo_texture_mask |= MATERIAL_TEXTURE_BASE_COLOR_BIT;
+			else if (cls == "normal")
+				options.rdo_texture_mask |= MATERIAL_TEXTURE_NORMAL_BIT;
+			else if (cls == "metallicroughness")
+				options.rdo_texture_mask |= MATERIAL_TEXTURE_METALLIC_ROUGHNESS_BIT;
+			else if (cls == "occlusion")
+				options.rdo_texture_mask |= MATERIAL_TEXTURE_OCCLUSION_BIT;
+			else if (cls == "emissive")
+				options.rdo_texture_mask |= MATERIAL_TEXTURE_EMISSIVE_BIT;
+			else
+				LOGE("Unknown texture class for RDO: %s\n", cls.c_str());
+		}
+	});
+
+	cbs.add("--texcomp-rdo-lambda", [&](CLIParser &parser) {
+		options.rdo_lambda = float(parser.next_double());
+	});
+
 	cbs.add("--optimize-meshes", [&](CLIParser &) {
 		options.optimize_meshes = true;
 	});
@@ -22,6 +22,7 @@
 
 #include "logging.hpp"
 #include "memory_mapped_texture.hpp"
+#include "hash_cache.hpp"
 #include <string.h>
 #include <vector>
 #include <utility>
@@ -31,9 +32,20 @@ using namespace Granite::SceneFormats;
 
 int main(int argc, char *argv[])
 {
+	HashCache cache;
+	bool use_cache = false;
+
+	if (argc >= 3 && strcmp(argv[1], "--hash-cache") == 0)
+	{
+		cache.load(argv[2]);
+		use_cache = true;
+		argv += 2;
+		argc -= 2;
+	}
+
 	if (argc < 4)
 	{
-		LOGE("Usage: %s <output> <cube|2D> <inputs>...\n", argv[0]);
+		LOGE("Usage: %s [--hash-cache <cache.txt>] <output> <cube|2D> <inputs>...\n", argv[0]);
 		return 1;
 	}
 
@@ -52,10 +64,32 @@ int main(int argc, char *argv[])
 	bool type_2d = strcmp(argv[2], "2D") == 0;
 	if (!type_2d && !cube)
 	{
-		LOGE("Usage: %s <output> <cube|2D> <inputs>...\n", argv[0]);
+		LOGE("Usage: %s [--hash-cache <cache.txt>] <output> <cube|2D> <inputs>...\n", argv[0]);
 		return 1;
 	}
 
+	Util::Hash hash = 0;
+	if (use_cache)
+	{
+		Util::Hasher h;
+		h.u32(uint32_t(cube));
+		for (int i = 3; i < argc; i++)
+		{
+			if (!hash_file(h, argv[i]))
+			{
+				LOGE("Failed to read texture: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		hash = h.get();
+
+		if (cache.is_up_to_date(argv[1], hash))
+		{
+			LOGI("%s is up to date.\n", argv[1]);
+			return 0;
+		}
+	}
+
 	for (int i = 3; i < argc; i++)
 	{
 		MemoryMappedTexture tex;
@@ -161,5 +195,11 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (use_cache)
+	{
+		cache.update(argv[1], hash);
+		cache.save();
+	}
+
 	return 0;
 }
\ No newline at end of file
@@ -26,6 +26,10 @@
 #include "texture_compression.hpp"
 #include "memory_mapped_texture.hpp"
 #include "texture_utils.hpp"
+#include "hash_cache.hpp"
+#include <chrono>
+#include <vector>
+#include <stdio.h>
 
 using namespace std;
 using namespace Granite;
@@ -39,13 +43,21 @@ static void print_help()
 	     "\t[--fixup-alpha]\n"
 	     "\t[--alpha]\n"
 	     "\t[--deferred-mipgen]\n"
+	     "\t[--supercompress]\n"
 	     "\t[--quality [1-5]]\n"
 	     "\t[--format <format>]\n"
 	     "\t[--swizzle <rgba01>x4]\n"
 	     "\t[--normal-la]\n"
 	     "\t[--mask-la]\n"
+	     "\t[--hash-cache <cache.txt>]\n"
+	     "\t[--batch <list.txt>]\n"
 	     "\t--output <out.gtx>\n"
-	     "\t<in.gtx>\n");
+	     "\t<in.gtx>\n"
+	     "\n"
+	     "With --hash-cache, inputs whose content and conversion arguments match the\n"
+	     "sidecar database are skipped. With --batch, each line of the list file is\n"
+	     "\"<input> <output>\" and all entries convert with the shared arguments,\n"
+	     "in parallel on the process thread pool.\n");
 }
 
 static VkComponentSwizzle parse_swizzle(const char c)
@@ -97,6 +109,74 @@ static VkComponentMapping parse_swizzle(const char *str)
 	};
 }
 
+static Util::Hash hash_arguments(const CompressorArguments &args, const VkComponentMapping &swizzle,
+                                 bool generate_mipmap, bool fixup_alpha)
+{
+	Util::Hasher h;
+	h.u32(args.format);
+	h.u32(args.quality);
+	h.u32(uint32_t(args.mode));
+	h.u32(uint32_t(args.deferred_mipgen));
+	h.u32(uint32_t(args.supercompress));
+	h.u32(uint32_t(generate_mipmap));
+	h.u32(uint32_t(fixup_alpha));
+	h.u32(swizzle.r);
+	h.u32(swizzle.g);
+	h.u32(swizzle.b);
+	h.u32(swizzle.a);
+	return h.get();
+}
+
+static bool queue_conversion(ThreadGroup &group, const CompressorArguments &args, const string &input_path,
+                             const VkComponentMapping &swizzle, bool generate_mipmap, bool fixup_alpha)
+{
+	Granite::ColorSpace color = Vulkan::format_is_srgb(args.format) ?
+	                            Granite::ColorSpace::sRGB : Granite::ColorSpace::Linear;
+
+	auto input = make_shared<MemoryMappedTexture>(Granite::load_texture_from_file(input_path, color));
+
+	if (input->get_layout().get_required_size() == 0)
+	{
+		LOGE("Failed to load texture %s.\n", input_path.c_str());
+		return false;
+	}
+
+	if (generate_mipmap)
+	{
+		*input = generate_mipmaps(input->get_layout(), input->get_flags());
+		if (input->get_layout().get_required_size() == 0)
+		{
+			LOGE("Failed to generate mipmaps for: %s\n", input_path.c_str());
+			return false;
+		}
+	}
+
+	if (fixup_alpha)
+	{
+		*input = fixup_alpha_edges(input->get_layout(), input->get_flags());
+		if (input->get_layout().get_required_size() == 0)
+		{
+			LOGE("Failed to fixup alpha for: %s\n", input_path.c_str());
+			return false;
+		}
+	}
+
+	auto patched_args = args;
+	if (input->get_layout().get_format() == VK_FORMAT_R16G16B16A16_SFLOAT)
+		patched_args.mode = TextureMode::HDR;
+
+	if (!swizzle_image(*input, swizzle))
+	{
+		LOGE("Failed to swizzle image: %s\n", input_path.c_str());
+		return false;
+	}
+
+	auto dummy = group.create_task();
+	bool ret = compress_texture(group, patched_args, input, dummy, nullptr);
+	dummy->flush();
+	return ret;
+}
+
 int main(int argc, char *argv[])
 {
 	Global::init(Global::MANAGER_FEATURE_THREAD_GROUP_BIT |
@@ -104,6 +184,8 @@ int main(int argc, char *argv[])
 	             Global::MANAGER_FEATURE_EVENT_BIT);
 
 	string input_path;
+	string hash_cache_path;
+	string batch_path;
 	bool generate_mipmap = false;
 	bool deferred_generate_mipmap = false;
 	bool fixup_alpha = false;
@@ -129,7 +211,10 @@ int main(int argc, char *argv[])
 	cbs.add("--fixup-alpha", [&](CLIParser &) { fixup_alpha = true; });
 	cbs.add("--mipgen", [&](CLIParser &) { generate_mipmap = true; });
 	cbs.add("--deferred-mipgen", [&](CLIParser &) { deferred_generate_mipmap = true; });
+	cbs.add("--supercompress", [&](CLIParser &) { args.supercompress = true; });
 	cbs.add("--swizzle", [&](CLIParser &parser) { swizzle = parse_swizzle(parser.next_string()); });
+	cbs.add("--hash-cache", [&](CLIParser &parser) { hash_cache_path = parser.next_string(); });
+	cbs.add("--batch", [&](CLIParser &parser) { batch_path = parser.next_string(); });
 	cbs.default_handler = [&](const char *arg) { input_path = arg; };
 	cbs.error_handler = []() { print_help(); };
 	CLIParser parser(move(cbs), argc - 1, argv + 1);
@@ -145,58 +230,96 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	if (args.output.empty() || input_path.empty())
+	if (batch_path.empty() && (args.output.empty() || input_path.empty()))
 	{
 		LOGE("Must provide input and output paths.\n");
 		return 1;
 	}
 
-	Granite::ColorSpace color = Vulkan::format_is_srgb(args.format) ?
-	                            Granite::ColorSpace::sRGB : Granite::ColorSpace::Linear;
-
-	auto input = make_shared<MemoryMappedTexture>(Granite::load_texture_from_file(input_path, color));
+	args.deferred_mipgen = deferred_generate_mipmap;
 
-	if (input->get_layout().get_required_size() == 0)
+	struct Job
 	{
-		LOGE("Failed to load texture %s.\n", input_path.c_str());
-		return 1;
-	}
-
-	args.deferred_mipgen = deferred_generate_mipmap;
+		string input;
+		string output;
+		Util::Hash hash;
+	};
+	vector<Job> jobs;
 
-	if (generate_mipmap)
+	if (!batch_path.empty())
 	{
-		*input = generate_mipmaps(input->get_layout(), input->get_flags());
-		if (input->get_layout().get_required_size() == 0)
+		FILE *file = fopen(batch_path.c_str(), "r");
+		if (!file)
 		{
-			LOGE("Failed to save texture: %s\n", args.output.c_str());
+			LOGE("Failed to open batch list: %s\n", batch_path.c_str());
 			return 1;
 		}
+
+		char line[8 * 1024];
+		while (fgets(line, sizeof(line), file))
+		{
+			char in[4 * 1024], out[4 * 1024];
+			if (sscanf(line, "%s %s", in, out) == 2)
+				jobs.push_back({ in, out, 0 });
+		}
+		fclose(file);
 	}
+	else
+		jobs.push_back({ input_path, args.output, 0 });
 
-	if (fixup_alpha)
+	HashCache cache;
+	if (!hash_cache_path.empty())
+		cache.load(hash_cache_path);
+
+	Util::Hash arg_hash = hash_arguments(args, swizzle, generate_mipmap, fixup_alpha);
+	ThreadGroup &group = *Global::thread_group();
+
+	unsigned skipped = 0;
+	unsigned converted = 0;
+	unsigned failed = 0;
+	auto start_time = chrono::steady_clock::now();
+	vector<const Job *> queued;
+
+	for (auto &job : jobs)
 	{
-		*input = fixup_alpha_edges(input->get_layout(), input->get_flags());
-		if (input->get_layout().get_required_size() == 0)
+		Util::Hasher h(arg_hash);
+		if (!hash_file(h, job.input))
 		{
-			LOGE("Failed to save texture: %s\n", args.output.c_str());
-			return 1;
+			LOGE("Failed to read input: %s\n", job.input.c_str());
+			failed++;
+			continue;
 		}
+		job.hash = h.get();
+
+		if (!hash_cache_path.empty() && cache.is_up_to_date(job.output, job.hash))
+		{
+			skipped++;
+			continue;
+		}
+
+		auto job_args = args;
+		job_args.output = job.output;
+		if (queue_conversion(group, job_args, job.input, swizzle, generate_mipmap, fixup_alpha))
+			queued.push_back(&job);
+		else
+			failed++;
 	}
 
-	if (input->get_layout().get_format() == VK_FORMAT_R16G16B16A16_SFLOAT)
-		args.mode = TextureMode::HDR;
+	group.wait_idle();
 
-	if (!swizzle_image(*input, swizzle))
+	for (auto *job : queued)
 	{
-		LOGE("Failed to swizzle image.\n");
-		return 1;
+		cache.update(job->output, job->hash);
+		converted++;
 	}
 
-	ThreadGroup &group = *Global::thread_group();
+	if (!hash_cache_path.empty())
+		cache.save();
 
-	auto dummy = group.create_task();
-	compress_texture(group, args, input, dummy, nullptr);
-	dummy->flush();
-	group.wait_idle();
+	auto end_time = chrono::steady_clock::now();
+	LOGI("Converted %u, skipped %u up-to-date, %u failed in %.2f s.\n",
+	     converted, skipped, failed,
+	     chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count() * 1e-3);
+
+	return failed ? 1 : 0;
 }
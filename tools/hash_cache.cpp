@@ -0,0 +1,116 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "hash_cache.hpp"
+#include "logging.hpp"
+#include <inttypes.h>
+#include <stdio.h>
+
+using namespace std;
+
+namespace Granite
+{
+bool HashCache::load(const string &path)
+{
+	db_path = path;
+	entries.clear();
+
+	FILE *file = fopen(path.c_str(), "r");
+	if (!file)
+		return true;
+
+	char line[8 * 1024];
+	while (fgets(line, sizeof(line), file))
+	{
+		uint64_t hash;
+		int offset = 0;
+		if (sscanf(line, "%" SCNx64 " %n", &hash, &offset) != 1 || offset == 0)
+		{
+			LOGE("Malformed hash cache line in %s, ignoring rest of file.\n", path.c_str());
+			break;
+		}
+
+		string output = line + offset;
+		while (!output.empty() && (output.back() == '\n' || output.back() == '\r'))
+			output.pop_back();
+		if (!output.empty())
+			entries[output] = hash;
+	}
+
+	fclose(file);
+	return true;
+}
+
+bool HashCache::save() const
+{
+	if (db_path.empty())
+		return false;
+
+	FILE *file = fopen(db_path.c_str(), "w");
+	if (!file)
+	{
+		LOGE("Failed to save hash cache: %s\n", db_path.c_str());
+		return false;
+	}
+
+	for (auto &entry : entries)
+		fprintf(file, "%016" PRIx64 " %s\n", entry.second, entry.first.c_str());
+
+	fclose(file);
+	return true;
+}
+
+bool HashCache::is_up_to_date(const string &output, Util::Hash hash) const
+{
+	auto itr = entries.find(output);
+	if (itr == end(entries) || itr->second != hash)
+		return false;
+
+	// The database can outlive the outputs, e.g. after a clean.
+	FILE *file = fopen(output.c_str(), "rb");
+	if (!file)
+		return false;
+	fclose(file);
+	return true;
+}
+
+void HashCache::update(const string &output, Util::Hash hash)
+{
+	entries[output] = hash;
+}
+
+bool hash_file(Util::Hasher &hasher, const string &path)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	uint8_t buffer[64 * 1024];
+	size_t ret;
+	while ((ret = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		hasher.data(buffer, ret);
+
+	bool success = ferror(file) == 0;
+	fclose(file);
+	return success;
+}
+}
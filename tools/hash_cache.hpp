@@ -0,0 +1,54 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "hash.hpp"
+#include <string>
+#include <unordered_map>
+
+namespace Granite
+{
+// Sidecar hash database for incremental asset cooks. Maps an output path to
+// the hash of the inputs and arguments which produced it, so a cook can skip
+// outputs whose sources did not change. Plain text, one entry per line, safe
+// to delete at any time to force a full rebuild.
+class HashCache
+{
+public:
+	// A missing database file is fine, it just means nothing can be skipped.
+	bool load(const std::string &path);
+	bool save() const;
+
+	// True if the recorded hash matches and the output still exists on disk.
+	bool is_up_to_date(const std::string &output, Util::Hash hash) const;
+	void update(const std::string &output, Util::Hash hash);
+
+private:
+	std::string db_path;
+	std::unordered_map<std::string, Util::Hash> entries;
+};
+
+// Folds the raw bytes of the file into the hasher. Returns false if the file
+// cannot be read.
+bool hash_file(Util::Hasher &hasher, const std::string &path);
+}
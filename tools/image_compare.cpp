@@ -31,11 +31,16 @@
 #include "stb_image_write.h"
 #include "muglm/muglm_impl.hpp"
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace Util;
 using namespace Granite;
 using namespace std;
 
+enum { TileSize = 64 };
+
 static void save_diff_image(const string &path,
                             const SceneFormats::MemoryMappedTexture &a,
                             const SceneFormats::MemoryMappedTexture &b)
@@ -76,26 +81,127 @@ static void save_diff_image(const string &path,
 		LOGE("Failed to save diff-png to %s.\n", path.c_str());
 }
 
-static double compare_images(const SceneFormats::MemoryMappedTexture &a, const SceneFormats::MemoryMappedTexture &b)
+// Sum of squared RGB differences over a row segment, alpha masked out.
+static uint64_t accumulate_error_energy(const uint8_t *a, const uint8_t *b, int pixels)
+{
+	uint64_t energy = 0;
+
+#if defined(__SSE2__)
+	__m128i mask = _mm_set1_epi32(0x00ffffff);
+	__m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+
+	for (; pixels >= 4; pixels -= 4, a += 16, b += 16)
+	{
+		__m128i va = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a)), mask);
+		__m128i vb = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b)), mask);
+
+		__m128i d_lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+		__m128i d_hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+		__m128i sq = _mm_add_epi32(_mm_madd_epi16(d_lo, d_lo), _mm_madd_epi16(d_hi, d_hi));
+
+		acc = _mm_add_epi64(acc, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+	}
+
+	alignas(16) uint64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+	energy = lanes[0] + lanes[1];
+#endif
+
+	for (; pixels > 0; pixels--, a += 4, b += 4)
+	{
+		int diff_r = a[0] - b[0];
+		int diff_g = a[1] - b[1];
+		int diff_b = a[2] - b[2];
+		energy += uint64_t(diff_r * diff_r + diff_g * diff_g + diff_b * diff_b);
+	}
+
+	return energy;
+}
+
+struct TileStats
+{
+	uint64_t error_energy;
+	double ssim;
+};
+
+static TileStats compare_tile(const uint8_t *src_a, const uint8_t *src_b, int stride_pixels,
+                              int width, int height)
+{
+	TileStats stats = {};
+
+	double sum_a = 0.0, sum_b = 0.0;
+	double sum_aa = 0.0, sum_bb = 0.0, sum_ab = 0.0;
+
+	for (int y = 0; y < height; y++)
+	{
+		auto *row_a = src_a + 4 * y * stride_pixels;
+		auto *row_b = src_b + 4 * y * stride_pixels;
+		stats.error_energy += accumulate_error_energy(row_a, row_b, width);
+
+		for (int x = 0; x < width; x++)
+		{
+			double la = 0.2126 * row_a[4 * x + 0] + 0.7152 * row_a[4 * x + 1] + 0.0722 * row_a[4 * x + 2];
+			double lb = 0.2126 * row_b[4 * x + 0] + 0.7152 * row_b[4 * x + 1] + 0.0722 * row_b[4 * x + 2];
+			sum_a += la;
+			sum_b += lb;
+			sum_aa += la * la;
+			sum_bb += lb * lb;
+			sum_ab += la * lb;
+		}
+	}
+
+	// SSIM on luma with the tile as the window.
+	double n = double(width) * double(height);
+	double mean_a = sum_a / n;
+	double mean_b = sum_b / n;
+	double var_a = max(sum_aa / n - mean_a * mean_a, 0.0);
+	double var_b = max(sum_bb / n - mean_b * mean_b, 0.0);
+	double covar = sum_ab / n - mean_a * mean_b;
+
+	const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+	const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+	stats.ssim = ((2.0 * mean_a * mean_b + c1) * (2.0 * covar + c2)) /
+	             ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+	return stats;
+}
+
+struct CompareResult
 {
+	double psnr;
+	double ssim;
+	vector<TileStats> tiles;
+	int tiles_x;
+	int tiles_y;
+};
+
+// Compares per tile so the work parallelizes and per-tile results can feed a
+// failure heatmap. Tiles fan out over workers when provided; folder mode is
+// already parallel per image pair and passes nullptr.
+static CompareResult compare_images(const SceneFormats::MemoryMappedTexture &a,
+                                    const SceneFormats::MemoryMappedTexture &b,
+                                    ThreadGroup *workers)
+{
+	CompareResult result = {};
+
 	if (a.get_layout().get_format() != b.get_layout().get_format())
 	{
 		LOGE("Format mismatch.\n");
-		return 0.0;
+		return result;
 	}
 
 	if (a.get_layout().get_format() != VK_FORMAT_R8G8B8A8_SRGB &&
 	    a.get_layout().get_format() != VK_FORMAT_R8G8B8A8_UNORM)
 	{
 		LOGE("Unsupported format.\n");
-		return 0.0;
+		return result;
 	}
 
 	if (a.get_layout().get_width() != b.get_layout().get_width() ||
 	    a.get_layout().get_height() != b.get_layout().get_height())
 	{
 		LOGE("Dimension mismatch.\n");
-		return 0.0;
+		return result;
 	}
 
 	int width = a.get_layout().get_width();
@@ -104,19 +210,67 @@ static double compare_images(const SceneFormats::MemoryMappedTexture &a, const S
 	auto *src_a = static_cast<const uint8_t *>(a.get_layout().data());
 	auto *src_b = static_cast<const uint8_t *>(b.get_layout().data());
 
+	result.tiles_x = (width + TileSize - 1) / TileSize;
+	result.tiles_y = (height + TileSize - 1) / TileSize;
+	result.tiles.resize(result.tiles_x * result.tiles_y);
+
+	const auto compare_tile_row = [&](int ty) {
+		for (int tx = 0; tx < result.tiles_x; tx++)
+		{
+			int x0 = tx * TileSize;
+			int y0 = ty * TileSize;
+			result.tiles[ty * result.tiles_x + tx] =
+					compare_tile(src_a + 4 * (y0 * width + x0), src_b + 4 * (y0 * width + x0),
+					             width, min(TileSize, width - x0), min(TileSize, height - y0));
+		}
+	};
+
+	if (workers)
+	{
+		auto task = workers->create_task();
+		for (int ty = 0; ty < result.tiles_y; ty++)
+			task->enqueue_task([&compare_tile_row, ty]() { compare_tile_row(ty); });
+		task->flush();
+		task->wait();
+	}
+	else
+	{
+		for (int ty = 0; ty < result.tiles_y; ty++)
+			compare_tile_row(ty);
+	}
+
+	uint64_t error_energy = 0;
+	double ssim = 0.0;
+	for (auto &tile : result.tiles)
+	{
+		error_energy += tile.error_energy;
+		ssim += tile.ssim;
+	}
+
 	double peak_energy = 255.0 * 255.0 * width * height * 3.0;
-	double error_energy = 0.0;
-	for (int pix = 0; pix < width * height; pix++, src_a += 4, src_b += 4)
+	result.psnr = 10.0 * muglm::log10(peak_energy / double(error_energy));
+	result.ssim = ssim / double(result.tiles.size());
+	return result;
+}
+
+// One pixel per tile. Red encodes RMSE, green encodes SSIM loss.
+static void save_heatmap(const string &path, const CompareResult &result)
+{
+	vector<uint8_t> buffer(result.tiles_x * result.tiles_y * 4);
+	auto *dst = buffer.data();
+
+	for (auto &tile : result.tiles)
 	{
-		int diff_r = src_a[0] - src_b[0];
-		int diff_g = src_a[1] - src_b[1];
-		int diff_b = src_a[2] - src_b[2];
-		error_energy += diff_r * diff_r;
-		error_energy += diff_g * diff_g;
-		error_energy += diff_b * diff_b;
+		double rmse = muglm::sqrt(double(tile.error_energy) / (3.0 * TileSize * TileSize));
+		dst[0] = uint8_t(min(int(rmse * 16.0), 255));
+		dst[1] = uint8_t(min(int((1.0 - tile.ssim) * 1024.0), 255));
+		dst[2] = 0;
+		dst[3] = 255;
+		dst += 4;
 	}
 
-	return 10.0 * muglm::log10(peak_energy / error_energy);
+	if (!stbi_write_png(path.c_str(), result.tiles_x, result.tiles_y, 4, buffer.data(), result.tiles_x * 4))
+		LOGE("Failed to save heatmap to %s.\n", path.c_str());
 }
 
 int main(int argc, char *argv[])
@@ -125,16 +279,24 @@ int main(int argc, char *argv[])
 	{
 		vector<string> inputs;
 		string diff;
+		string heatmap;
 		double threshold = -1.0;
+		double ssim_threshold = -1.0;
 	} args;
 	CLICallbacks cbs;
 
 	cbs.add("--threshold", [&](CLIParser &parser) {
 		args.threshold = parser.next_double();
 	});
+	cbs.add("--ssim-threshold", [&](CLIParser &parser) {
+		args.ssim_threshold = parser.next_double();
+	});
 	cbs.add("--diff", [&](CLIParser &parser) {
 		args.diff = parser.next_string();
 	});
+	cbs.add("--heatmap", [&](CLIParser &parser) {
+		args.heatmap = parser.next_string();
+	});
 	cbs.default_handler = [&](const char *arg) {
 		args.inputs.push_back(arg);
 	};
@@ -172,46 +334,61 @@ int main(int argc, char *argv[])
 			return 1;
 		}
 
-		vector<double> psnrs(a_list.size());
+		vector<CompareResult> results(a_list.size());
 		vector<bool> ignore(a_list.size());
 
 		auto task = workers.create_task();
 
 		for (unsigned i = 0; i < a_list.size(); i++)
 		{
-			task->enqueue_task([&a_list, &b_list, &psnrs, &ignore, i]() {
+			task->enqueue_task([&a_list, &b_list, &results, &ignore, i]() {
 				auto a = load_texture_from_file(a_list[i].path);
 				auto b = load_texture_from_file(b_list[i].path);
 				if (a.empty() || b.empty())
 				{
-					psnrs[i] = 0.0;
 					ignore[i] = true;
+					return;
 				}
 
-				psnrs[i] = compare_images(a, b);
-
+				results[i] = compare_images(a, b, nullptr);
 			});
 		}
 
 		task->flush();
 		task->wait();
 
+		bool failed = false;
 		for (unsigned i = 0; i < a_list.size(); i++)
 		{
 			if (ignore[i])
 				continue;
 
-			LOGI("%s | %s | PSNR: %.f dB\n", a_list[i].path.c_str(), b_list[i].path.c_str(), psnrs[i]);
+			LOGI("%s | %s | PSNR: %.f dB | SSIM: %.4f\n",
+			     a_list[i].path.c_str(), b_list[i].path.c_str(), results[i].psnr, results[i].ssim);
 
-			if (args.threshold >= 0.0)
+			bool pair_failed = false;
+			if (args.threshold >= 0.0 && results[i].psnr < args.threshold)
 			{
-				if (psnrs[i] < args.threshold)
-				{
-					LOGE("PSNR is too low, failure!\n");
-					return 1;
-				}
+				LOGE("PSNR is too low, failure!\n");
+				pair_failed = true;
+			}
+
+			if (args.ssim_threshold >= 0.0 && results[i].ssim < args.ssim_threshold)
+			{
+				LOGE("SSIM is too low, failure!\n");
+				pair_failed = true;
+			}
+
+			if (pair_failed)
+			{
+				if (!args.heatmap.empty())
+					save_heatmap(args.heatmap + "." + to_string(i) + ".png", results[i]);
+				failed = true;
 			}
 		}
+
+		if (failed)
+			return 1;
 	}
 	else
 	{
@@ -235,16 +412,27 @@ int main(int argc, char *argv[])
 			save_diff_image(args.diff, a, b);
 		}
 
-		double psnr = compare_images(a, b);
-		LOGI("PSNR: %.f dB\n", psnr);
+		auto result = compare_images(a, b, &workers);
+		LOGI("PSNR: %.f dB | SSIM: %.4f\n", result.psnr, result.ssim);
 
-		if (args.threshold >= 0.0)
+		bool failed = false;
+		if (args.threshold >= 0.0 && result.psnr < args.threshold)
 		{
-			if (psnr < args.threshold)
-			{
-				LOGE("PSNR is too low, failure!\n");
-				return 1;
-			}
+			LOGE("PSNR is too low, failure!\n");
+			failed = true;
+		}
+
+		if (args.ssim_threshold >= 0.0 && result.ssim < args.ssim_threshold)
+		{
+			LOGE("SSIM is too low, failure!\n");
+			failed = true;
+		}
+
+		if (failed)
+		{
+			if (!args.heatmap.empty())
+				save_heatmap(args.heatmap, result);
+			return 1;
 		}
 	}
 
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+
+import sys
+import os
+import argparse
+import struct
+
+def fnv1a(data):
+    h = 0xcbf29ce484222325
+    for b in data:
+        h = ((h ^ b) * 0x100000001b3) & 0xffffffffffffffff
+    return h
+
+def main():
+    parser = argparse.ArgumentParser(description = 'Script for building a filesystem manifest.')
+    parser.add_argument('--output',
+                        help = 'Path to place the manifest',
+                        required = True)
+    parser.add_argument('--input',
+                        help = 'Asset root to index',
+                        required = True)
+
+    args = parser.parse_args()
+
+    entries = []
+    for root, dirs, files in os.walk(args.input):
+        for file in files:
+            fullpath = os.path.join(root, file)
+            rpath = os.path.relpath(fullpath, args.input).replace(os.sep, '/')
+            size = os.path.getsize(fullpath)
+            mtime = int(os.path.getmtime(fullpath))
+            with open(fullpath, 'rb') as fr:
+                digest = fnv1a(fr.read())
+            entries.append((rpath, size, mtime, digest))
+
+    with open(args.output, 'wb') as f:
+        f.write('MANIFS01'.encode('ascii'))
+        for entry in entries:
+            f.write('ENTR'.encode('ascii'))
+            encoded_path = entry[0].encode('utf-8')
+            if len(encoded_path) > 255:
+                raise RuntimeError('Path has max length of 255.')
+            f.write(struct.pack('B', len(encoded_path)))
+            f.write(encoded_path)
+            f.write(struct.pack('<Q', entry[1]))
+            f.write(struct.pack('<Q', entry[2]))
+            f.write(struct.pack('<Q', entry[3]))
+
+
+if __name__ == '__main__':
+    main()
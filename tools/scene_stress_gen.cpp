@@ -0,0 +1,267 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Procedurally generates stress-test scenes so renderer scaling runs do not
+// depend on hand-authored content. The output is a plain GLB which the
+// headless benchmark consumes like any other scene, so renderable count,
+// light count and draw-call distribution can be swept from a script.
+
+#include "gltf_export.hpp"
+#include "logging.hpp"
+#include "cli_parser.hpp"
+#include <cmath>
+
+using namespace std;
+using namespace Util;
+using namespace Granite;
+
+static void print_help()
+{
+	LOGI("Usage: --output <out.glb>\n"
+	     "\t[--grid-width <count>] [--grid-depth <count>] [--spacing <distance>]\n"
+	     "\t[--unique-meshes <count>] [--materials <count>]\n"
+	     "\t[--point-lights <count>] [--spot-lights <count>]\n"
+	     "\t[--animated-nodes <count>]\n");
+}
+
+// Distinct-ish colors for any material count without dragging in an RNG,
+// so a given set of arguments always produces the exact same scene.
+static vec3 color_from_index(unsigned index)
+{
+	float h = float(index) * 0.618034f;
+	h = (h - floor(h)) * 6.0f;
+	float r = fabs(h - 3.0f) - 1.0f;
+	float g = 2.0f - fabs(h - 2.0f);
+	float b = 2.0f - fabs(h - 4.0f);
+	return clamp(vec3(r, g, b), vec3(0.0f), vec3(1.0f));
+}
+
+static SceneFormats::Mesh create_cube_mesh(uint32_t material_index)
+{
+	static const vec3 face_normals[] = {
+		vec3(1.0f, 0.0f, 0.0f),
+		vec3(-1.0f, 0.0f, 0.0f),
+		vec3(0.0f, 1.0f, 0.0f),
+		vec3(0.0f, -1.0f, 0.0f),
+		vec3(0.0f, 0.0f, 1.0f),
+		vec3(0.0f, 0.0f, -1.0f),
+	};
+
+	vector<vec3> positions;
+	vector<vec3> normals;
+	vector<uint16_t> indices;
+
+	for (auto &n : face_normals)
+	{
+		vec3 t = fabs(n.y) > 0.5f ? vec3(1.0f, 0.0f, 0.0f) : normalize(cross(vec3(0.0f, 1.0f, 0.0f), n));
+		vec3 b = cross(n, t);
+
+		auto base = uint16_t(positions.size());
+		for (int y = -1; y <= 1; y += 2)
+		{
+			for (int x = -1; x <= 1; x += 2)
+			{
+				positions.push_back(0.5f * (n + float(x) * t + float(y) * b));
+				normals.push_back(n);
+			}
+		}
+
+		static const uint16_t quad_indices[] = { 0, 1, 2, 3, 2, 1 };
+		for (auto i : quad_indices)
+			indices.push_back(base + i);
+	}
+
+	SceneFormats::Mesh mesh;
+	mesh.positions.resize(positions.size() * sizeof(vec3));
+	memcpy(mesh.positions.data(), positions.data(), mesh.positions.size());
+	mesh.position_stride = sizeof(vec3);
+	mesh.attribute_layout[ecast(MeshAttribute::Position)].format = VK_FORMAT_R32G32B32_SFLOAT;
+
+	mesh.attributes.resize(normals.size() * sizeof(vec3));
+	memcpy(mesh.attributes.data(), normals.data(), mesh.attributes.size());
+	mesh.attribute_stride = sizeof(vec3);
+	mesh.attribute_layout[ecast(MeshAttribute::Normal)].format = VK_FORMAT_R32G32B32_SFLOAT;
+
+	mesh.indices.resize(indices.size() * sizeof(uint16_t));
+	memcpy(mesh.indices.data(), indices.data(), mesh.indices.size());
+	mesh.index_type = VK_INDEX_TYPE_UINT16;
+	mesh.count = unsigned(indices.size());
+
+	mesh.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	mesh.static_aabb = AABB(vec3(-0.5f), vec3(0.5f));
+	mesh.material_index = material_index;
+	mesh.has_material = true;
+	return mesh;
+}
+
+int main(int argc, char *argv[])
+{
+	struct Arguments
+	{
+		string output;
+		unsigned grid_width = 16;
+		unsigned grid_depth = 16;
+		float spacing = 2.0f;
+		unsigned unique_meshes = 1;
+		unsigned materials = 8;
+		unsigned point_lights = 0;
+		unsigned spot_lights = 0;
+		unsigned animated_nodes = 0;
+	} args;
+
+	CLICallbacks cbs;
+	cbs.add("--output", [&](CLIParser &parser) { args.output = parser.next_string(); });
+	cbs.add("--grid-width", [&](CLIParser &parser) { args.grid_width = parser.next_uint(); });
+	cbs.add("--grid-depth", [&](CLIParser &parser) { args.grid_depth = parser.next_uint(); });
+	cbs.add("--spacing", [&](CLIParser &parser) { args.spacing = float(parser.next_double()); });
+	cbs.add("--unique-meshes", [&](CLIParser &parser) { args.unique_meshes = parser.next_uint(); });
+	cbs.add("--materials", [&](CLIParser &parser) { args.materials = parser.next_uint(); });
+	cbs.add("--point-lights", [&](CLIParser &parser) { args.point_lights = parser.next_uint(); });
+	cbs.add("--spot-lights", [&](CLIParser &parser) { args.spot_lights = parser.next_uint(); });
+	cbs.add("--animated-nodes", [&](CLIParser &parser) { args.animated_nodes = parser.next_uint(); });
+	cbs.add("--help", [](CLIParser &parser) { print_help(); parser.end(); });
+	CLIParser cli_parser(move(cbs), argc - 1, argv + 1);
+	if (!cli_parser.parse())
+		return 1;
+	else if (cli_parser.is_ended_state())
+		return 0;
+
+	if (args.output.empty() || !args.grid_width || !args.grid_depth)
+	{
+		print_help();
+		return 1;
+	}
+
+	args.materials = std::max(args.materials, 1u);
+	args.unique_meshes = std::max(args.unique_meshes, 1u);
+
+	vector<SceneFormats::MaterialInfo> materials;
+	materials.reserve(args.materials);
+	for (unsigned i = 0; i < args.materials; i++)
+	{
+		SceneFormats::MaterialInfo material;
+		material.uniform_base_color = vec4(color_from_index(i), 1.0f);
+		material.uniform_metallic = 0.0f;
+		material.uniform_roughness = 0.25f + 0.75f * (float(i) / float(args.materials));
+		materials.push_back(move(material));
+	}
+
+	// Few unique meshes over many nodes exercises instancing-friendly
+	// batching, one mesh per node exercises raw draw-call throughput.
+	vector<SceneFormats::Mesh> meshes;
+	meshes.reserve(args.unique_meshes);
+	for (unsigned i = 0; i < args.unique_meshes; i++)
+		meshes.push_back(create_cube_mesh(i % args.materials));
+
+	vector<SceneFormats::Node> nodes;
+	nodes.reserve(size_t(args.grid_width) * args.grid_depth + args.point_lights + args.spot_lights);
+
+	float half_width = 0.5f * args.spacing * float(args.grid_width - 1);
+	float half_depth = 0.5f * args.spacing * float(args.grid_depth - 1);
+
+	for (unsigned z = 0; z < args.grid_depth; z++)
+	{
+		for (unsigned x = 0; x < args.grid_width; x++)
+		{
+			unsigned index = z * args.grid_width + x;
+			SceneFormats::Node node;
+			node.meshes.push_back(index % args.unique_meshes);
+			node.transform.translation = vec3(args.spacing * float(x) - half_width,
+			                                  0.0f,
+			                                  args.spacing * float(z) - half_depth);
+			nodes.push_back(move(node));
+		}
+	}
+
+	// Scatter lights over the grid on a golden-angle spiral so any count
+	// covers the scene roughly uniformly.
+	vector<SceneFormats::LightInfo> lights;
+	lights.reserve(size_t(args.point_lights) + args.spot_lights);
+	const auto add_light = [&](SceneFormats::LightInfo::Type type, unsigned index, unsigned count) {
+		float t = (float(index) + 0.5f) / float(count);
+		float angle = 2.399963f * float(index);
+		float radius = sqrt(t) * std::min(half_width, half_depth);
+
+		SceneFormats::Node node;
+		node.transform.translation = vec3(radius * cos(angle), 2.0f, radius * sin(angle));
+		if (type == SceneFormats::LightInfo::Type::Spot)
+			node.transform.rotation = angleAxis(-half_pi<float>(), vec3(1.0f, 0.0f, 0.0f));
+
+		SceneFormats::LightInfo light;
+		light.type = type;
+		light.node_index = uint32_t(nodes.size());
+		light.attached_to_node = true;
+		light.color = 4.0f * color_from_index(index);
+
+		nodes.push_back(move(node));
+		lights.push_back(move(light));
+	};
+
+	for (unsigned i = 0; i < args.point_lights; i++)
+		add_light(SceneFormats::LightInfo::Type::Point, i, args.point_lights);
+	for (unsigned i = 0; i < args.spot_lights; i++)
+		add_light(SceneFormats::LightInfo::Type::Spot, i, args.spot_lights);
+
+	// Spin the first N mesh nodes so the sweep can also measure the cost of
+	// per-frame transform updates, not just static draw submission.
+	vector<SceneFormats::Animation> animations;
+	unsigned animated_nodes = std::min(args.animated_nodes, args.grid_width * args.grid_depth);
+	if (animated_nodes)
+	{
+		SceneFormats::Animation animation;
+		animation.name = "stress-rotate";
+		for (unsigned i = 0; i < animated_nodes; i++)
+		{
+			SceneFormats::AnimationChannel channel;
+			channel.node_index = i;
+			channel.type = SceneFormats::AnimationChannel::Type::Rotation;
+			for (unsigned k = 0; k <= 4; k++)
+			{
+				channel.timestamps.push_back(float(k));
+				channel.spherical.values.push_back(angleAxis(half_pi<float>() * float(k),
+				                                             vec3(0.0f, 1.0f, 0.0f)));
+			}
+			animation.channels.push_back(move(channel));
+		}
+		animation.update_length();
+		animations.push_back(move(animation));
+	}
+
+	SceneFormats::SceneInformation info;
+	info.materials = materials;
+	info.meshes = meshes;
+	info.lights = lights;
+	info.nodes = nodes;
+	info.animations = animations;
+
+	SceneFormats::ExportOptions options;
+	if (!SceneFormats::export_scene_to_glb(info, args.output, options))
+	{
+		LOGE("Failed to export scene to GLB.\n");
+		return 1;
+	}
+
+	LOGI("Exported %u nodes, %u meshes, %u materials, %u lights, %u animated nodes to %s.\n",
+	     unsigned(nodes.size()), unsigned(meshes.size()), unsigned(materials.size()),
+	     unsigned(lights.size()), animated_nodes, args.output.c_str());
+	return 0;
+}
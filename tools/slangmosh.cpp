@@ -36,13 +36,26 @@
 #include <string>
 #include <vector>
 #include <assert.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 using namespace Util;
 using namespace Granite;
 
 static void print_help()
 {
-	LOGE("slangmosh <desc.json> [-O] [--strip] [--vk11] [--output header.hpp] [--help]\n");
+	LOGE("slangmosh <desc.json> [-O] [--strip] [--vk11] [--output header.hpp]\n"
+	     "\t[--daemon] [--port <port>] [--help]\n"
+	     "\n"
+	     "In daemon mode, several banks can be given as <desc.json>=<header.hpp>.\n"
+	     "The daemon watches all referenced shaders and rebakes dirtied banks when\n"
+	     "a client connects to the trigger port, replying OK or FAIL.\n");
 }
 
 struct ShaderVariant
@@ -373,23 +386,229 @@ static std::string generate_header(const std::vector<Shader> &shaders,
 	return str.str();
 }
 
-static int main_inner(int argc, char **argv)
+struct Bank
+{
+	std::string input;
+	std::string output;
+	bool dirty = true;
+	std::vector<std::pair<Filesystem::PathID, FileNotifyHandle>> watches;
+};
+
+struct BakeOptions
 {
-	std::string output_path;
-	std::string input_path;
 	std::string generated_namespace;
-	bool strip = false;
+	Target target = Target::Vulkan10;
 	bool opt = false;
+	bool strip = false;
+};
+
+// Rewatches the desc file and every shader it references. The shader list can
+// change between bakes, so the old watches go away first.
+static void refresh_watches(Bank &bank, const std::vector<Shader> &shaders)
+{
+	auto &fs = *Global::filesystem();
+	for (auto &watch : bank.watches)
+	{
+		auto *backend = fs.get_backend_for_path(watch.first);
+		if (backend)
+			backend->uninstall_notification(watch.second);
+	}
+	bank.watches.clear();
+
+	const auto add_watch = [&](const std::string &path) {
+		auto id = fs.intern_path(path);
+		auto handle = fs.install_notification(id, [&bank](const FileNotifyInfo &) {
+			bank.dirty = true;
+		});
+		if (handle >= 0)
+			bank.watches.push_back({ id, handle });
+		else
+			LOGE("Failed to watch path: %s\n", path.c_str());
+	};
+
+	add_watch(bank.input);
+	for (auto &shader : shaders)
+		add_watch(shader.path);
+}
+
+// Bakes every dirty bank. All permutations across all banks are queued on the
+// thread group before a single wait, so different banks compile in parallel.
+static bool bake_banks(std::vector<Bank> &banks, const BakeOptions &options, bool watch)
+{
+	struct Pending
+	{
+		Bank *bank;
+		std::vector<Shader> shaders;
+		std::vector<std::vector<std::vector<uint32_t>>> spirv;
+	};
+	std::vector<Pending> pending;
+
+	bool ok = true;
+	for (auto &bank : banks)
+	{
+		if (!bank.dirty)
+			continue;
+
+		Pending p;
+		p.bank = &bank;
+		p.shaders = parse_shaders(bank.input);
+		if (p.shaders.empty())
+		{
+			LOGE("Failed to parse shaders: %s\n", bank.input.c_str());
+			ok = false;
+			continue;
+		}
+		pending.push_back(std::move(p));
+	}
+
+	// Dispatch only once the Pending list is stable; the compile tasks point
+	// back into the parsed shaders.
+	for (auto &p : pending)
+	{
+		p.spirv.resize(p.shaders.size());
+		for (size_t shader_index = 0; shader_index < p.shaders.size(); shader_index++)
+		{
+			auto &shader_variants = p.spirv[shader_index];
+			auto &parsed_shader = p.shaders[shader_index];
+			shader_variants.resize(parsed_shader.total_permutations());
+			parsed_shader.dispatch_variants(shader_variants.data(), options.target, options.opt, options.strip);
+		}
+	}
+
+	Global::thread_group()->wait_idle();
+
+	for (auto &p : pending)
+	{
+		bool bank_ok = true;
+		for (auto &shader : p.spirv)
+			for (auto &perm : shader)
+				if (perm.empty())
+					bank_ok = false;
+
+		if (watch)
+			refresh_watches(*p.bank, p.shaders);
+
+		if (!bank_ok)
+		{
+			ok = false;
+			continue;
+		}
+
+		auto generated_code = generate_header(p.shaders, p.spirv, options.generated_namespace);
+
+		if (p.bank->output.empty())
+			printf("%s\n", generated_code.c_str());
+		else if (!Global::filesystem()->write_string_to_file(p.bank->output, generated_code))
+		{
+			LOGE("Failed to write to file: %s.\n", p.bank->output.c_str());
+			ok = false;
+			continue;
+		}
+
+		p.bank->dirty = false;
+	}
+
+	return ok;
+}
+
+#ifndef _WIN32
+static int create_listen_socket(uint16_t port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	if (::bind(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd, 16) < 0)
+	{
+		::close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// Stays resident with warm compiler state. A build step connects, the daemon
+// rebakes whichever banks were dirtied since the last trigger, and the reply
+// (OK or FAIL) unblocks the client, so e.g. "nc localhost <port>" works as a
+// synchronous build rule.
+static int run_daemon(std::vector<Bank> &banks, const BakeOptions &options, uint16_t port)
+{
+	int listen_fd = create_listen_socket(port);
+	if (listen_fd < 0)
+	{
+		LOGE("Failed to listen on port %u.\n", unsigned(port));
+		return EXIT_FAILURE;
+	}
+
+	bake_banks(banks, options, true);
+	LOGI("slangmosh daemon listening on port %u.\n", unsigned(port));
+
+	for (;;)
+	{
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(listen_fd, &fds);
+		timeval tv = { 0, 500 * 1000 };
+
+		int ret = select(listen_fd + 1, &fds, nullptr, nullptr, &tv);
+		if (ret < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		Global::filesystem()->poll_notifications();
+
+		if (ret > 0 && FD_ISSET(listen_fd, &fds))
+		{
+			int client = ::accept(listen_fd, nullptr, nullptr);
+			if (client < 0)
+				continue;
+
+			// Catch writes which raced the trigger.
+			Global::filesystem()->poll_notifications();
+			bool ok = bake_banks(banks, options, true);
+
+			const char *reply = ok ? "OK\n" : "FAIL\n";
+			if (::write(client, reply, strlen(reply)) < 0)
+				LOGE("Failed to write daemon reply.\n");
+			::close(client);
+		}
+	}
+
+	::close(listen_fd);
+	return EXIT_FAILURE;
+}
+#endif
+
+static int main_inner(int argc, char **argv)
+{
+	std::string output_path;
+	std::vector<std::string> inputs;
+	BakeOptions options;
 	bool vk11 = false;
+	bool daemon = false;
+	uint16_t port = 23450;
 
 	CLICallbacks cbs;
 	cbs.add("--help", [](CLIParser &parser) { parser.end(); });
 	cbs.add("--output", [&](CLIParser &parser) { output_path = parser.next_string(); });
-	cbs.add("-O", [&](CLIParser &) { opt = true; });
-	cbs.add("--strip", [&](CLIParser &) { strip = true; });
+	cbs.add("-O", [&](CLIParser &) { options.opt = true; });
+	cbs.add("--strip", [&](CLIParser &) { options.strip = true; });
 	cbs.add("--vk11", [&](CLIParser &) { vk11 = true; });
-	cbs.add("--namespace", [&](CLIParser &parser) { generated_namespace = parser.next_string(); });
-	cbs.default_handler = [&](const char *str) { input_path = str; };
+	cbs.add("--namespace", [&](CLIParser &parser) { options.generated_namespace = parser.next_string(); });
+	cbs.add("--daemon", [&](CLIParser &) { daemon = true; });
+	cbs.add("--port", [&](CLIParser &parser) { port = uint16_t(parser.next_uint()); });
+	cbs.default_handler = [&](const char *str) { inputs.push_back(str); };
 
 	CLIParser parser(std::move(cbs), argc - 1, argv + 1);
 	if (!parser.parse())
@@ -400,52 +619,52 @@ static int main_inner(int argc, char **argv)
 		return EXIT_SUCCESS;
 	}
 
-	if (input_path.empty())
+	if (inputs.empty())
 	{
 		LOGE("Need input path.\n");
 		print_help();
 		return EXIT_FAILURE;
 	}
 
-	auto parsed_shaders = parse_shaders(input_path);
-	if (parsed_shaders.empty())
+	if (vk11)
+		options.target = Target::Vulkan11;
+
+	std::vector<Bank> banks;
+	for (auto &input : inputs)
 	{
-		LOGE("Failed to parse shaders.\n");
-		return EXIT_FAILURE;
+		// Daemon mode serves several banks, given as <desc.json>=<header.hpp>.
+		Bank bank;
+		auto split = input.find('=');
+		if (split != std::string::npos)
+		{
+			bank.input = input.substr(0, split);
+			bank.output = input.substr(split + 1);
+		}
+		else
+		{
+			bank.input = input;
+			bank.output = output_path;
+		}
+		banks.push_back(std::move(bank));
 	}
 
-	std::vector<std::vector<std::vector<uint32_t>>> spirv_for_shaders_and_variants;
-	spirv_for_shaders_and_variants.resize(parsed_shaders.size());
-
-	for (size_t shader_index = 0; shader_index < parsed_shaders.size(); shader_index++)
+	if (banks.size() > 1 && !daemon)
 	{
-		auto &shader_variants = spirv_for_shaders_and_variants[shader_index];
-		auto &parsed_shader = parsed_shaders[shader_index];
-		shader_variants.resize(parsed_shader.total_permutations());
-		parsed_shader.dispatch_variants(shader_variants.data(), vk11 ? Target::Vulkan11 : Target::Vulkan10, opt, strip);
+		LOGE("Multiple banks are only supported with --daemon.\n");
+		return EXIT_FAILURE;
 	}
 
-	Global::thread_group()->wait_idle();
-
-	for (auto &shader : spirv_for_shaders_and_variants)
-		for (auto &perm : shader)
-			if (perm.empty())
-				return EXIT_FAILURE;
-
-	auto generated_code = generate_header(parsed_shaders, spirv_for_shaders_and_variants, generated_namespace);
-
-	if (output_path.empty())
-		printf("%s\n", generated_code.c_str());
-	else
+	if (daemon)
 	{
-		if (!Global::filesystem()->write_string_to_file(output_path, generated_code))
-		{
-			LOGE("Failed to write to file: %s.\n", output_path.c_str());
-			return EXIT_FAILURE;
-		}
+#ifndef _WIN32
+		return run_daemon(banks, options, port);
+#else
+		LOGE("Daemon mode is not supported on this platform.\n");
+		return EXIT_FAILURE;
+#endif
 	}
 
-	return EXIT_SUCCESS;
+	return bake_banks(banks, options, false) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int main(int argc, char **argv)
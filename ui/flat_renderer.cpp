@@ -296,4 +296,9 @@ void FlatRenderer::push_sprites(const SpriteList &visible)
 		vis.sprite->get_sprite_render_info(vis.transform, queue);
 }
 
+void FlatRenderer::push_sprite_instances(const Sprite &sprite, const SpriteTransformInfo *transforms, unsigned count)
+{
+	sprite.get_instanced_sprite_render_info(transforms, count, queue);
+}
+
 }
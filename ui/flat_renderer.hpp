@@ -78,6 +78,11 @@ public:
 	void push_sprite(const SpriteInfo &info);
 	void push_sprites(const SpriteList &visible);
 
+	// Fast path for 2D-heavy scenes. All instances of one sprite are pushed
+	// as a single contiguous queue entry which dispatches as one instanced
+	// draw per atlas page, instead of one queue push per sprite.
+	void push_sprite_instances(const Sprite &sprite, const SpriteTransformInfo *transforms, unsigned count);
+
 	void render_quad(const vec3 &offset, const vec2 &size, const vec4 &color);
 
 	void render_textured_quad(const Vulkan::ImageView &view, const vec3 &offset, const vec2 &size,
@@ -74,21 +74,35 @@ Font::Font(const std::string &path, unsigned size)
 	EVENT_MANAGER_REGISTER_LATCH(Font, on_device_created, on_device_destroyed, DeviceCreatedEvent);
 }
 
-vec2 Font::get_text_geometry(const char *text, float) const
+const Font::ShapedRun &Font::get_shaped_run(const char *text) const
 {
-	if (!*text)
-		return vec2(0);
+	Hasher hasher;
+	hasher.string(text);
+	auto hash = hasher.get();
+
+	auto *run = shaped_runs.find(hash);
+	if (run)
+		return *run;
+
+	// Rapidly changing text (counters and similar) would otherwise grow the
+	// cache without bound, so just start over when it gets large.
+	if (shaped_run_count >= MaxShapedRuns)
+	{
+		shaped_runs.clear();
+		shaped_run_count = 0;
+	}
 
-	vec2 off = vec2(0.0f);
-	off.y += font_height;
+	run = shaped_runs.emplace_yield(hash);
+	shaped_run_count++;
+	run->quads.reserve(strlen(text));
 
+	vec2 off = vec2(0.0f, float(font_height));
 	vec2 cached = off;
 	vec2 minimum = vec2(FLT_MAX);
 	vec2 maximum = vec2(-FLT_MAX);
 
 	while (*text)
 	{
-		stbtt_aligned_quad q;
 		if (*text == '\n')
 		{
 			cached.y += font_height;
@@ -96,16 +110,26 @@ vec2 Font::get_text_geometry(const char *text, float) const
 		}
 		else if (*text >= 32)
 		{
+			stbtt_aligned_quad q;
 			stbtt_GetBakedQuad(baked_chars, width, height, *text - 32, &off.x, &off.y, &q, 1);
+			run->quads.push_back(q);
 			minimum = min(minimum, vec2(q.x0, q.y0));
-			minimum = min(minimum, vec2(q.x1, q.y1));
-			maximum = max(maximum, vec2(q.x0, q.y0));
 			maximum = max(maximum, vec2(q.x1, q.y1));
 		}
 		text++;
 	}
 
-	return ceil(vec2(maximum.x, cached.y));
+	run->geometry = ceil(vec2(maximum.x, cached.y));
+	run->min_rect = minimum;
+	run->max_rect = maximum;
+	return *run;
+}
+
+vec2 Font::get_text_geometry(const char *text, float) const
+{
+	if (!*text)
+		return vec2(0);
+	return get_shaped_run(text).geometry;
 }
 
 vec2 Font::get_aligned_offset(Alignment alignment, vec2 text_geometry, vec2 target_geometry) const
@@ -161,65 +185,43 @@ void Font::render_text(RenderQueue &queue, const char *text, const vec3 &offset,
 	if (!*text)
 		return;
 
-	vec2 geometry = get_text_geometry(text, scale);
-	vec2 alignment_offset = get_aligned_offset(alignment, geometry, size);
+	auto &run = get_shaped_run(text);
+	vec2 alignment_offset = get_aligned_offset(alignment, run.geometry, size);
+	vec2 total_offset = offset.xy() + alignment_offset;
 
-	size_t len = strlen(text);
+	size_t count = run.quads.size();
 	SpriteRenderInfo sprite;
 	sprite.textures[0] = &texture->get_view();
 	sprite.sampler = StockSampler::LinearWrap;
 
 	auto *instance_data = queue.allocate_one<SpriteInstanceInfo>();
-	auto *quads = queue.allocate_many<QuadData>(len);
+	auto *quads = queue.allocate_many<QuadData>(count);
 	instance_data->quads = quads;
-	instance_data->count = 0; // Will be accumulated in the loop.
-
-	vec2 off = offset.xy();
-	off.y += font_height;
-	vec2 cached = off;
-
-	vec2 min_rect = vec2(FLT_MAX);
-	vec2 max_rect = vec2(-FLT_MAX);
+	instance_data->count = unsigned(count);
 
-	while (*text)
+	for (size_t i = 0; i < count; i++)
 	{
-		stbtt_aligned_quad q;
-		if (*text == '\n')
-		{
-			cached.y += font_height;
-			off = cached;
-		}
-		else if (*text >= 32)
-		{
-			stbtt_GetBakedQuad(baked_chars, width, height, *text - 32, &off.x, &off.y, &q, 1);
-
-			q.x0 += alignment_offset.x;
-			q.x1 += alignment_offset.x;
-			q.y0 += alignment_offset.y;
-			q.y1 += alignment_offset.y;
-
-			auto &quad = quads[instance_data->count++];
-			quantize_color(quad.color, color);
-			quad.rotation[0] = 1.0f;
-			quad.rotation[1] = 0.0f;
-			quad.rotation[2] = 0.0f;
-			quad.rotation[3] = 1.0f;
-			quad.layer = offset.z;
-			quad.pos_off_x = q.x0;
-			quad.pos_off_y = q.y0;
-			quad.pos_scale_x = q.x1 - q.x0;
-			quad.pos_scale_y = q.y1 - q.y0;
-			quad.tex_off_x = muglm::round(q.s0 * width);
-			quad.tex_off_y = muglm::round(q.t0 * height);
-			quad.tex_scale_x = muglm::round(q.s1 * width) - quad.tex_off_x;
-			quad.tex_scale_y = muglm::round(q.t1 * height) - quad.tex_off_y;
-
-			max_rect = max(max_rect, vec2(q.x1, q.y1));
-			min_rect = min(min_rect, vec2(q.x0, q.y0));
-		}
-		text++;
+		auto &q = run.quads[i];
+		auto &quad = quads[i];
+		quantize_color(quad.color, color);
+		quad.rotation[0] = 1.0f;
+		quad.rotation[1] = 0.0f;
+		quad.rotation[2] = 0.0f;
+		quad.rotation[3] = 1.0f;
+		quad.layer = offset.z;
+		quad.pos_off_x = q.x0 + total_offset.x;
+		quad.pos_off_y = q.y0 + total_offset.y;
+		quad.pos_scale_x = q.x1 - q.x0;
+		quad.pos_scale_y = q.y1 - q.y0;
+		quad.tex_off_x = muglm::round(q.s0 * width);
+		quad.tex_off_y = muglm::round(q.t0 * height);
+		quad.tex_scale_x = muglm::round(q.s1 * width) - quad.tex_off_x;
+		quad.tex_scale_y = muglm::round(q.t1 * height) - quad.tex_off_y;
 	}
 
+	vec2 min_rect = run.min_rect + total_offset;
+	vec2 max_rect = run.max_rect + total_offset;
+
 	if (any(lessThan(min_rect, clip_offset)) || any(greaterThan(max_rect, clip_offset + clip_size)))
 		sprite.clip_quad = ivec4(ivec2(clip_offset), ivec2(clip_size));
 
@@ -26,6 +26,7 @@
 #include "renderer.hpp"
 #include "render_queue.hpp"
 #include "event.hpp"
+#include "intrusive_hash_map.hpp"
 
 namespace Granite
 {
@@ -67,5 +68,20 @@ private:
 	std::vector<uint8_t> bitmap;
 	unsigned width = 0, height = 0;
 	unsigned font_height = 0;
+
+	// Shaping through stb_truetype is cached since HUD text tends to be
+	// static from frame to frame. Runs are shaped in local space and
+	// translated when quads are emitted.
+	struct ShapedRun : Util::IntrusiveHashMapEnabled<ShapedRun>
+	{
+		std::vector<stbtt_aligned_quad> quads;
+		vec2 geometry;
+		vec2 min_rect;
+		vec2 max_rect;
+	};
+	const ShapedRun &get_shaped_run(const char *text) const;
+	mutable Util::IntrusiveHashMap<ShapedRun> shaped_runs;
+	mutable unsigned shaped_run_count = 0;
+	enum { MaxShapedRuns = 1024 };
 };
 }
\ No newline at end of file
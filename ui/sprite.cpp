@@ -137,6 +137,15 @@ void sprite_render(Vulkan::CommandBuffer &cmd, const RenderQueueData *infos, uns
 
 void Sprite::get_sprite_render_info(const SpriteTransformInfo &transform, RenderQueue &queue) const
 {
+	get_instanced_sprite_render_info(&transform, 1, queue);
+}
+
+void Sprite::get_instanced_sprite_render_info(const SpriteTransformInfo *transforms, unsigned count,
+                                              RenderQueue &queue) const
+{
+	if (!count)
+		return;
+
 	bool transparent = pipeline == DrawPipeline::AlphaBlend;
 	auto queue_type = transparent ? Queue::Transparent : Queue::Opaque;
 	SpriteRenderInfo sprite;
@@ -148,27 +157,35 @@ void Sprite::get_sprite_render_info(const SpriteTransformInfo &transform, Render
 	sprite.sampler = sampler;
 
 	auto *instance_data = queue.allocate_one<SpriteInstanceInfo>();
-	auto *quads = queue.allocate_one<QuadData>();
+	auto *quads = queue.allocate_many<QuadData>(count);
 	instance_data->quads = quads;
-	instance_data->count = 1;
-
-	for (unsigned i = 0; i < 4; i++)
-		quads->color[i] = color[i];
-
-	quads->pos_off_x = transform.position.x;
-	quads->pos_off_y = transform.position.y;
-	quads->pos_scale_x = size.x * transform.scale.x;
-	quads->pos_scale_y = size.y * transform.scale.y;
-	quads->tex_off_x = tex_offset.x;
-	quads->tex_off_y = tex_offset.y;
-	quads->tex_scale_x = size.x;
-	quads->tex_scale_y = size.y;
-	quads->rotation[0] = transform.rotation[0].x;
-	quads->rotation[1] = transform.rotation[0].y;
-	quads->rotation[2] = transform.rotation[1].x;
-	quads->rotation[3] = transform.rotation[1].y;
-	quads->layer = transform.position.z;
-	quads->blend_factor = texture_blending_factor;
+	instance_data->count = count;
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto &transform = transforms[i];
+		auto &quad = quads[i];
+
+		for (unsigned c = 0; c < 4; c++)
+			quad.color[c] = color[c];
+
+		quad.pos_off_x = transform.position.x;
+		quad.pos_off_y = transform.position.y;
+		quad.pos_scale_x = size.x * transform.scale.x;
+		quad.pos_scale_y = size.y * transform.scale.y;
+		quad.tex_off_x = tex_offset.x;
+		quad.tex_off_y = tex_offset.y;
+		quad.tex_scale_x = size.x;
+		quad.tex_scale_y = size.y;
+		quad.rotation[0] = transform.rotation[0].x;
+		quad.rotation[1] = transform.rotation[0].y;
+		quad.rotation[2] = transform.rotation[1].x;
+		quad.rotation[3] = transform.rotation[1].y;
+		quad.layer = transform.position.z;
+		quad.blend_factor = texture_blending_factor;
+	}
+
+	auto &transform = transforms[0];
 	sprite.clip_quad = transform.clip;
 
 	Util::Hasher hasher;
@@ -86,6 +86,15 @@ struct Sprite : AbstractRenderable
 	bool clear_alpha_to_zero = false;
 
 	void get_sprite_render_info(const SpriteTransformInfo &transform, RenderQueue &queue) const override;
+
+	// Instanced fast path for 2D-heavy scenes. Emits count instances of this
+	// sprite as a single contiguous queue entry, so the whole batch costs one
+	// hash + push and dispatches as one instanced draw together with any other
+	// batches sharing the same atlas page. All instances share the clip rect
+	// and sorting depth of the first transform.
+	void get_instanced_sprite_render_info(const SpriteTransformInfo *transforms, unsigned count,
+	                                      RenderQueue &queue) const;
+
 	void get_render_info(const RenderContext &, const RenderInfoComponent *, RenderQueue &) const override
 	{
 	}
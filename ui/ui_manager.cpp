@@ -30,17 +30,30 @@ namespace Granite
 namespace UI
 {
 UIManager::UIManager()
+{
+	EVENT_MANAGER_REGISTER_LATCH(UIManager, on_device_created, on_device_destroyed, Vulkan::DeviceCreatedEvent);
+}
+
+void UIManager::on_device_created(const Vulkan::DeviceCreatedEvent &)
+{
+	// The retained render queue holds programs from the old device.
+	force_redraw = true;
+}
+
+void UIManager::on_device_destroyed(const Vulkan::DeviceCreatedEvent &)
 {
 }
 
 void UIManager::add_child(WidgetHandle handle)
 {
 	widgets.push_back(handle);
+	force_redraw = true;
 }
 
 void UIManager::reset_children()
 {
 	widgets.clear();
+	force_redraw = true;
 }
 
 void UIManager::remove_child(Widget *widget)
@@ -49,50 +62,76 @@ void UIManager::remove_child(Widget *widget)
 		return handle.get() == widget;
 	});
 	widgets.erase(itr, end(widgets));
+	force_redraw = true;
 }
 
-void UIManager::render(Vulkan::CommandBuffer &cmd)
+bool UIManager::needs_redraw() const
 {
-	renderer.begin();
-
-	const float max_layers = 20000.0f; // Roughly for D16 with some headroom for quantization errors.
+	if (force_redraw)
+		return true;
 
-	float minimum_layer = max_layers - 1.0f;
 	for (auto &widget : widgets)
-	{
-		auto *window = static_cast<Window *>(widget.get());
-		if (!window->get_visible())
-			continue;
+		if (widget->get_needs_redraw())
+			return true;
 
-		widget->reconfigure_geometry();
+	return false;
+}
+
+void UIManager::render(Vulkan::CommandBuffer &cmd)
+{
+	const float max_layers = 20000.0f; // Roughly for D16 with some headroom for quantization errors.
+	vec2 canvas_size(cmd.get_viewport().width, cmd.get_viewport().height);
 
-		vec2 window_size;
-		vec2 window_pos;
+	// Retained rendering. The built queue only references persistent data
+	// (the queue's own allocators, textures and programs), while per-frame GPU
+	// data is allocated at dispatch, so undamaged frames skip the reconfigure
+	// and queue build entirely and just replay the retained queue.
+	if (needs_redraw() || canvas_size.x != cached_canvas_size.x || canvas_size.y != cached_canvas_size.y)
+	{
+		renderer.begin();
 
-		if (window->is_fullscreen())
-		{
-			window_size.x = cmd.get_viewport().width;
-			window_size.y = cmd.get_viewport().height;
-			widget->reconfigure_geometry_to_canvas(vec2(0.0f),
-			                                       vec2(cmd.get_viewport().width, cmd.get_viewport().height));
-			window_pos = vec2(0.0f);
-		}
-		else
+		float minimum_layer = max_layers - 1.0f;
+		for (auto &widget : widgets)
 		{
-			widget->reconfigure_geometry_to_canvas(window->get_floating_position(), window->get_minimum_geometry());
-			window_size = max(widget->get_target_geometry(), widget->get_minimum_geometry());
-			window_pos = window->get_floating_position();
+			auto *window = static_cast<Window *>(widget.get());
+			if (!window->get_visible())
+				continue;
+
+			widget->reconfigure_geometry();
+
+			vec2 window_size;
+			vec2 window_pos;
+
+			if (window->is_fullscreen())
+			{
+				window_size = canvas_size;
+				widget->reconfigure_geometry_to_canvas(vec2(0.0f), canvas_size);
+				window_pos = vec2(0.0f);
+			}
+			else
+			{
+				widget->reconfigure_geometry_to_canvas(window->get_floating_position(), window->get_minimum_geometry());
+				window_size = max(widget->get_target_geometry(), widget->get_minimum_geometry());
+				window_pos = window->get_floating_position();
+			}
+
+			renderer.push_scissor(window->get_floating_position(), window_size);
+			float min_layer = widget->render(renderer, minimum_layer, window_pos, window_size);
+			renderer.pop_scissor();
+
+			minimum_layer = min(min_layer, minimum_layer);
 		}
 
-		renderer.push_scissor(window->get_floating_position(), window_size);
-		float min_layer = widget->render(renderer, minimum_layer, window_pos, window_size);
-		renderer.pop_scissor();
+		for (auto &widget : widgets)
+			widget->clear_needs_redraw();
 
-		minimum_layer = min(min_layer, minimum_layer);
+		cached_minimum_layer = minimum_layer;
+		cached_canvas_size = canvas_size;
+		force_redraw = false;
 	}
 
-	renderer.flush(cmd, vec3(0.0f, 0.0f, minimum_layer),
-	               vec3(cmd.get_viewport().width, cmd.get_viewport().height, max_layers));
+	renderer.flush(cmd, vec3(0.0f, 0.0f, cached_minimum_layer),
+	               vec3(canvas_size.x, canvas_size.y, max_layers));
 }
 
 Font& UIManager::get_font(FontSize size)
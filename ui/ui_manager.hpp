@@ -70,12 +70,26 @@ public:
 	void reset_children();
 	void remove_child(Widget *widget);
 
+	// Returns true if any widget has reported damage since the last render(),
+	// i.e. if the next render() has to rebuild the render queue rather than
+	// replay the retained one. A standalone UI which renders to its own target
+	// can skip the render pass when this returns false, as long as the target
+	// itself is unchanged.
+	bool needs_redraw() const;
+
 private:
 	FlatRenderer renderer;
 	std::vector<WidgetHandle> widgets;
 	std::unique_ptr<Font> fonts[Util::ecast(FontSize::Count)];
 	//Font::Alignment alignment = Font::Alignment::Center;
 
+	void on_device_created(const Vulkan::DeviceCreatedEvent &e);
+	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
+
+	vec2 cached_canvas_size = vec2(0.0f);
+	float cached_minimum_layer = 0.0f;
+	bool force_redraw = true;
+
 	Widget *drag_receiver = nullptr;
 	vec2 drag_receiver_base = vec2(0.0f);
 
@@ -84,7 +84,8 @@ void Widget::add_child(Util::IntrusivePtr<Widget> widget)
 	children.push_back({ vec2(0), vec2(0), widget });
 	assert(widget->parent == nullptr);
 	widget->parent = this;
-	geometry_changed();
+	// Mark the child as well so a freshly added widget gets its first reconfigure().
+	widget->geometry_changed();
 }
 
 Util::IntrusivePtr<Widget> Widget::remove_child(const Widget &widget)
@@ -116,6 +117,13 @@ bool Widget::get_needs_redraw() const
 	return false;
 }
 
+void Widget::clear_needs_redraw()
+{
+	needs_redraw = false;
+	for (auto &child : children)
+		child.widget->clear_needs_redraw();
+}
+
 void Widget::geometry_changed()
 {
 	needs_redraw = true;
@@ -126,6 +134,11 @@ void Widget::geometry_changed()
 
 void Widget::reconfigure_geometry()
 {
+	// geometry_changed() marks every parent up to the root,
+	// so a subtree which is not marked is clean all the way down.
+	if (!needs_reconfigure)
+		return;
+
 	for (auto &child : children)
 		child.widget->reconfigure_geometry();
 	reconfigure();
@@ -136,6 +136,7 @@ public:
 	}
 
 	bool get_needs_redraw() const;
+	void clear_needs_redraw();
 	void reconfigure_geometry();
 	void reconfigure_geometry_to_canvas(vec2 offset, vec2 size);
 
@@ -0,0 +1,271 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "alloc_tracker.hpp"
+#include "message_queue.hpp"
+#include "logging.hpp"
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <new>
+
+#ifdef GRANITE_ALLOC_TRACKER
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ALLOC_TRACKER_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define ALLOC_TRACKER_RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+#endif
+
+namespace Util
+{
+namespace AllocTracker
+{
+#ifdef GRANITE_ALLOC_TRACKER
+static std::atomic<bool> tracking;
+static std::atomic<uint32_t> frame_allocs;
+static std::atomic<uint32_t> overflow_allocs;
+static std::atomic<uint32_t> baseline { UINT32_MAX };
+static std::atomic<LockFreeMessageQueue *> report_queue;
+
+// Fixed-size open-addressed table keyed by call site.
+// The hook itself must never allocate, so on overflow we just lump
+// the remainder into a shared overflow counter.
+struct Site
+{
+	std::atomic<uintptr_t> addr;
+	std::atomic<uint32_t> count;
+};
+static const unsigned SiteTableSize = 4 * 1024;
+static const unsigned SiteMaxProbes = 16;
+static Site site_table[SiteTableSize];
+
+void note_allocation(void *call_site)
+{
+	if (!tracking.load(std::memory_order_relaxed))
+		return;
+
+	frame_allocs.fetch_add(1, std::memory_order_relaxed);
+
+	auto addr = uintptr_t(call_site);
+	auto index = unsigned((addr * 0x9e3779b97f4a7c15ull) >> 32u) & (SiteTableSize - 1);
+	for (unsigned probe = 0; probe < SiteMaxProbes; probe++)
+	{
+		auto &site = site_table[(index + probe) & (SiteTableSize - 1)];
+		uintptr_t existing = site.addr.load(std::memory_order_relaxed);
+		if (existing == 0)
+		{
+			// Claim the slot. On a race, fall through and re-test whoever won.
+			if (!site.addr.compare_exchange_strong(existing, addr, std::memory_order_relaxed))
+				if (existing != addr)
+					continue;
+			site.count.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else if (existing == addr)
+		{
+			site.count.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	overflow_allocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void report(const char *msg)
+{
+	auto *queue = report_queue.load(std::memory_order_acquire);
+	if (queue)
+	{
+		size_t size = strlen(msg) + 1;
+		auto payload = queue->allocate_write_payload(size);
+		if (payload)
+		{
+			memcpy(static_cast<char *>(payload.get_payload_data()), msg, size);
+			queue->push_written_payload(std::move(payload));
+		}
+	}
+	else
+		LOGI("%s\n", msg);
+}
+
+void begin_frame()
+{
+	tracking.store(false, std::memory_order_relaxed);
+	for (auto &site : site_table)
+	{
+		site.addr.store(0, std::memory_order_relaxed);
+		site.count.store(0, std::memory_order_relaxed);
+	}
+	frame_allocs.store(0, std::memory_order_relaxed);
+	overflow_allocs.store(0, std::memory_order_relaxed);
+	tracking.store(true, std::memory_order_release);
+}
+
+bool end_frame()
+{
+	tracking.store(false, std::memory_order_release);
+
+	uint32_t total = frame_allocs.load(std::memory_order_relaxed);
+	if (total == 0)
+		return true;
+
+	char msg[256];
+	for (auto &site : site_table)
+	{
+		uint32_t count = site.count.load(std::memory_order_relaxed);
+		if (count == 0)
+			continue;
+		snprintf(msg, sizeof(msg), "alloc-tracker: call site %p allocated %u time(s) this frame.",
+		         reinterpret_cast<void *>(site.addr.load(std::memory_order_relaxed)), count);
+		report(msg);
+	}
+
+	uint32_t overflow = overflow_allocs.load(std::memory_order_relaxed);
+	if (overflow != 0)
+	{
+		snprintf(msg, sizeof(msg), "alloc-tracker: %u allocation(s) from untracked call sites (table overflow).",
+		         overflow);
+		report(msg);
+	}
+
+	uint32_t limit = baseline.load(std::memory_order_relaxed);
+	if (total > limit)
+	{
+		snprintf(msg, sizeof(msg), "alloc-tracker: %u per-frame allocations exceed baseline of %u.",
+		         total, limit);
+		report(msg);
+		return false;
+	}
+
+	return true;
+}
+
+void set_message_queue(LockFreeMessageQueue *queue)
+{
+	report_queue.store(queue, std::memory_order_release);
+}
+
+void set_baseline(uint32_t max_allocations)
+{
+	baseline.store(max_allocations, std::memory_order_relaxed);
+}
+
+uint32_t get_frame_allocation_count()
+{
+	return frame_allocs.load(std::memory_order_relaxed);
+}
+#else
+void begin_frame()
+{
+}
+
+bool end_frame()
+{
+	return true;
+}
+
+void set_message_queue(LockFreeMessageQueue *)
+{
+}
+
+void set_baseline(uint32_t)
+{
+}
+
+uint32_t get_frame_allocation_count()
+{
+	return 0;
+}
+#endif
+}
+}
+
+#ifdef GRANITE_ALLOC_TRACKER
+// Global allocation hooks. Only the counting is instrumented,
+// the allocations themselves go straight to malloc/free.
+void *operator new(size_t size)
+{
+	void *ptr = malloc(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	Util::AllocTracker::note_allocation(ALLOC_TRACKER_RETURN_ADDRESS());
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	void *ptr = malloc(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	Util::AllocTracker::note_allocation(ALLOC_TRACKER_RETURN_ADDRESS());
+	return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	void *ptr = malloc(size);
+	if (ptr)
+		Util::AllocTracker::note_allocation(ALLOC_TRACKER_RETURN_ADDRESS());
+	return ptr;
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	void *ptr = malloc(size);
+	if (ptr)
+		Util::AllocTracker::note_allocation(ALLOC_TRACKER_RETURN_ADDRESS());
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	free(ptr);
+}
+#endif
@@ -0,0 +1,61 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Util
+{
+class LockFreeMessageQueue;
+
+// Heap allocation audit mode for per-frame hot paths.
+// When the library is built with GRANITE_ALLOC_TRACKER, global operator new/delete
+// are instrumented, and allocations which happen between begin_frame() and end_frame()
+// are counted per call site (return address of the allocating code).
+// Without the build option every entry point is a no-op and end_frame() always passes,
+// so callers can leave the markers in unconditionally.
+namespace AllocTracker
+{
+// Marks the start of a frame. Resets the allocation counter and the
+// per-call-site table and starts tracking.
+void begin_frame();
+
+// Marks the end of a frame and stops tracking.
+// Reports per-call-site allocation counts through the message queue registered with
+// set_message_queue() (falls back to the normal logging path if no queue is set).
+// Returns false if the frame exceeded the baseline set with set_baseline(),
+// which is the CI assertion mode: run a few frames, fail the job on a false return.
+bool end_frame();
+
+// Per-site reports are pushed to this queue as plain text payloads,
+// same consumer model as the async logging queue. May be nullptr.
+void set_message_queue(LockFreeMessageQueue *queue);
+
+// Checked-in baseline for CI. A frame with more than max_allocations heap
+// allocations makes end_frame() return false. Default is no limit.
+void set_baseline(uint32_t max_allocations);
+
+// Number of allocations observed so far in the current frame.
+uint32_t get_frame_allocation_count();
+}
+}
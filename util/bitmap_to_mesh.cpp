@@ -24,6 +24,8 @@
 #include "muglm/muglm_impl.hpp"
 #include "meshoptimizer.h"
 #include "hash.hpp"
+#include "simd_headers.hpp"
+#include "thread_group.hpp"
 #include <assert.h>
 #include <list>
 #include <algorithm>
@@ -701,23 +703,75 @@ static void compute_normals(vector<vec3> &normals, const vector<vec3> &positions
 	}
 }
 
+// Thresholds one row into one 0 / 0xff occupancy byte per pixel.
+// "component >= 128" is exactly the unsigned MSB, which the SIMD paths
+// test for 16 pixels per op when the source is tightly packed.
+static void scan_occupancy_row(uint8_t *occupancy, const uint8_t *row, unsigned pixel_stride, unsigned width)
+{
+	unsigned x = 0;
+
+	if (pixel_stride == 1)
+	{
+#if defined(__SSE3__)
+		__m128i zero = _mm_setzero_si128();
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+			// Signed 0 > v iff the MSB of v is set.
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(occupancy + x), _mm_cmpgt_epi8(zero, v));
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 16 <= width; x += 16)
+			vst1q_u8(occupancy + x, vcgeq_u8(vld1q_u8(row + x), vdupq_n_u8(128)));
+#endif
+	}
+
+	for (; x < width; x++)
+		occupancy[x] = row[x * pixel_stride] >= 128 ? 0xffu : 0u;
+}
+
+static void scan_occupancy(uint8_t *occupancy, const uint8_t *components, unsigned component, unsigned pixel_stride,
+                           unsigned width, unsigned height, unsigned row_stride, ThreadGroup *thread_group)
+{
+	const auto scan_rows = [=](unsigned start_y, unsigned end_y) {
+		for (unsigned y = start_y; y < end_y; y++)
+			scan_occupancy_row(occupancy + y * width, components + component + y * row_stride, pixel_stride, width);
+	};
+
+	// Each task writes its own rows, so the result is bit-identical to the
+	// serial scan no matter how the tasks are scheduled.
+	constexpr unsigned RowsPerTask = 64;
+	if (thread_group && height >= 2 * RowsPerTask)
+	{
+		auto task = thread_group->create_task();
+		for (unsigned y = 0; y < height; y += RowsPerTask)
+		{
+			unsigned end_y = std::min(y + RowsPerTask, height);
+			task->enqueue_task([=]() { scan_rows(y, end_y); });
+		}
+		task->flush();
+		task->wait();
+	}
+	else
+		scan_rows(0, height);
+}
+
 bool voxelize_bitmap(VoxelizedBitmap &bitmap, const uint8_t *components, unsigned component, unsigned pixel_stride,
                      unsigned width, unsigned height, unsigned row_stride, const VoxelizeBitmapOptions &options)
 {
 	bitmap = {};
 
+	vector<uint8_t> occupancy(width * height);
+	scan_occupancy(occupancy.data(), components, component, pixel_stride,
+	               width, height, row_stride, options.thread_group);
+
 	vector<StateBitmap> state_mipmap;
 	{
 		StateBitmap state(width, height);
 		for (unsigned y = 0; y < height; y++)
-		{
 			for (unsigned x = 0; x < width; x++)
-			{
-				bool active = components[component + pixel_stride * x + y * row_stride] >= 128;
-				if (active)
+				if (occupancy[y * width + x])
 					state.add_pending(x, y);
-			}
-		}
 		state_mipmap.push_back(std::move(state));
 	}
 
@@ -26,6 +26,8 @@
 
 namespace Granite
 {
+class ThreadGroup;
+
 struct VoxelizedBitmap
 {
 	std::vector<vec3> positions;
@@ -36,6 +38,9 @@ struct VoxelizedBitmap
 struct VoxelizeBitmapOptions
 {
 	bool depth = true;
+	// When set, the occupancy scan is split row-wise across worker threads.
+	// The output mesh is identical to the single-threaded path.
+	ThreadGroup *thread_group = nullptr;
 };
 
 bool voxelize_bitmap(VoxelizedBitmap &bitmap, const uint8_t *components, unsigned component, unsigned pixel_stride,
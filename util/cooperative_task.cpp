@@ -21,6 +21,9 @@
  */
 
 #include "cooperative_task.hpp"
+#include "thread_group.hpp"
+#include "timer.hpp"
+#include <atomic>
 #include <stack>
 #include <stdexcept>
 #include <exception>
@@ -122,4 +125,154 @@ bool CooperativeTaskRunnable::is_complete() const
 {
 	return complete;
 }
+
+bool CooperativeTaskRunnable::is_awaiting() const
+{
+	return awaiting;
+}
+
+void CooperativeTaskRunnable::set_scheduled_task(Internal::ScheduledCooperativeTask *task_)
+{
+	scheduled_task = task_;
+}
+
+CooperativeTaskRunnable::Awaiter CooperativeTaskRunnable::get_awaiter() const
+{
+	assert(scheduled_task);
+	Awaiter awaiter;
+	awaiter.task = scheduled_task;
+	return awaiter;
+}
+
+void CooperativeTaskRunnable::yield_await()
+{
+	assert(scheduled_task);
+	awaiting = true;
+	yield_cothread();
+	awaiting = false;
+}
+
+bool CooperativeTask::task_is_awaiting() const
+{
+	return task->is_awaiting();
+}
+
+CooperativeTaskRunnable &CooperativeTask::get_runnable()
+{
+	return *task;
+}
+
+namespace Internal
+{
+struct ScheduledCooperativeTask
+{
+	ScheduledCooperativeTask(CooperativeTaskScheduler *sched_, unique_ptr<CooperativeTaskRunnable> runnable)
+		: sched(sched_), task(move(runnable))
+	{
+		task.get_runnable().set_scheduled_task(this);
+	}
+
+	enum State : uint32_t
+	{
+		Running = 0,
+		Suspended,
+		Signalled
+	};
+
+	void requeue()
+	{
+		sched->enqueue(this);
+	}
+
+	CooperativeTaskScheduler *sched;
+	CooperativeTask task;
+	std::atomic<uint32_t> state{Running};
+};
+}
+
+void CooperativeTaskRunnable::Awaiter::signal()
+{
+	// If the task got all the way to sleep, it's our job to re-enqueue it.
+	// Otherwise the scheduler observes the signal when the task unwinds out
+	// of yield_await() and re-enqueues it there.
+	auto prev = task->state.exchange(Internal::ScheduledCooperativeTask::Signalled, std::memory_order_acq_rel);
+	if (prev == Internal::ScheduledCooperativeTask::Suspended)
+	{
+		task->state.store(Internal::ScheduledCooperativeTask::Running, std::memory_order_relaxed);
+		task->requeue();
+	}
+}
+
+CooperativeTaskScheduler::CooperativeTaskScheduler(Granite::ThreadGroup &group_)
+	: group(group_)
+{
+}
+
+CooperativeTaskScheduler::~CooperativeTaskScheduler()
+{
+	wait_idle();
+}
+
+void CooperativeTaskScheduler::submit(unique_ptr<CooperativeTaskRunnable> runnable)
+{
+	auto *task = new Internal::ScheduledCooperativeTask(this, move(runnable));
+	{
+		lock_guard<mutex> holder{idle_lock};
+		live_tasks++;
+	}
+	enqueue(task);
+}
+
+void CooperativeTaskScheduler::enqueue(Internal::ScheduledCooperativeTask *task)
+{
+	// The returned handle flushes on destruction, which enqueues the task.
+	group.create_task([task]() {
+		task->sched->step(task);
+	});
+}
+
+void CooperativeTaskScheduler::step(Internal::ScheduledCooperativeTask *task)
+{
+	task->task.resume(double(get_current_time_nsecs()) * 1e-9);
+
+	if (task->task.task_is_complete())
+	{
+		finish(task);
+	}
+	else if (task->task.task_is_awaiting())
+	{
+		// The completion may have fired before we finished unwinding out of
+		// yield_await(), in which case we re-enqueue right away.
+		auto prev = task->state.exchange(Internal::ScheduledCooperativeTask::Suspended, std::memory_order_acq_rel);
+		if (prev == Internal::ScheduledCooperativeTask::Signalled)
+		{
+			task->state.store(Internal::ScheduledCooperativeTask::Running, std::memory_order_relaxed);
+			enqueue(task);
+		}
+	}
+	else
+	{
+		// Plain yield, round-robin with other queued tasks. Timed sleeps are
+		// not implemented here; suspend on an Awaiter signalled by a timer
+		// instead of using yield_and_delay().
+		enqueue(task);
+	}
+}
+
+void CooperativeTaskScheduler::finish(Internal::ScheduledCooperativeTask *task)
+{
+	delete task;
+	lock_guard<mutex> holder{idle_lock};
+	assert(live_tasks != 0);
+	if (--live_tasks == 0)
+		idle_cond.notify_all();
+}
+
+void CooperativeTaskScheduler::wait_idle()
+{
+	unique_lock<mutex> holder{idle_lock};
+	idle_cond.wait(holder, [this]() {
+		return live_tasks == 0;
+	});
+}
 }
\ No newline at end of file
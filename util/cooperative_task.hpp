@@ -23,9 +23,21 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+
+namespace Granite
+{
+class ThreadGroup;
+}
 
 namespace Util
 {
+namespace Internal
+{
+struct ScheduledCooperativeTask;
+}
+
 class CooperativeTaskRunnable
 {
 public:
@@ -35,18 +47,45 @@ public:
 	void set_current_time(double time);
 	void yield_complete();
 	bool is_complete() const;
+	bool is_awaiting() const;
+	void set_scheduled_task(Internal::ScheduledCooperativeTask *task);
 
 	virtual void run() noexcept = 0;
 
+	// Handle used to resume a task which has suspended in yield_await().
+	// Valid from submission to a scheduler until run() returns.
+	class Awaiter
+	{
+	public:
+		// Called from any thread, e.g. an IO completion callback. Safe to
+		// call before the task has finished suspending. Each yield_await()
+		// must be paired with exactly one signal().
+		void signal();
+
+	private:
+		friend class CooperativeTaskRunnable;
+		Internal::ScheduledCooperativeTask *task = nullptr;
+	};
+
 protected:
 	double get_current_time() const;
 	void yield();
 	void yield_and_delay(double time);
 
+	// Grab the awaiter and hand it to an async operation *before* calling
+	// yield_await(). Only valid while running on a CooperativeTaskScheduler.
+	Awaiter get_awaiter() const;
+
+	// Suspends the task and releases the worker thread until the Awaiter is
+	// signalled.
+	void yield_await();
+
 private:
 	double current_time = 0.0;
 	double sleep_until = 0.0;
 	bool complete = false;
+	bool awaiting = false;
+	Internal::ScheduledCooperativeTask *scheduled_task = nullptr;
 };
 
 class CooperativeTask
@@ -61,10 +100,45 @@ public:
 	void resume(double current_time);
 	bool task_is_runnable(double current_time) const;
 	bool task_is_complete() const;
+	bool task_is_awaiting() const;
+	CooperativeTaskRunnable &get_runnable();
 
 private:
 	std::unique_ptr<CooperativeTaskRunnable> task;
 	void *cothread = nullptr;
 };
+
+// Runs cooperative tasks on ThreadGroup workers. A task which suspends in
+// yield_await() releases its worker, and signalling its Awaiter re-enqueues
+// it, so hundreds of IO-bound tasks can share the worker pool instead of
+// each stalling a thread. A task may resume on a different worker than the
+// one it suspended on; the cothread context lives on the task's own stack,
+// so this is fine.
+class CooperativeTaskScheduler
+{
+public:
+	explicit CooperativeTaskScheduler(Granite::ThreadGroup &group);
+	~CooperativeTaskScheduler();
+
+	CooperativeTaskScheduler(const CooperativeTaskScheduler &) = delete;
+	void operator=(const CooperativeTaskScheduler &) = delete;
+
+	void submit(std::unique_ptr<CooperativeTaskRunnable> runnable);
+
+	// Blocks until every submitted task has run to completion, including
+	// tasks which are currently suspended.
+	void wait_idle();
+
+private:
+	friend struct Internal::ScheduledCooperativeTask;
+	Granite::ThreadGroup &group;
+	unsigned live_tasks = 0;
+	std::mutex idle_lock;
+	std::condition_variable idle_cond;
+
+	void enqueue(Internal::ScheduledCooperativeTask *task);
+	void step(Internal::ScheduledCooperativeTask *task);
+	void finish(Internal::ScheduledCooperativeTask *task);
+};
 }
 
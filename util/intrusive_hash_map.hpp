@@ -100,7 +100,9 @@ public:
 		auto masked = hash & hash_mask;
 		for (unsigned i = 0; i < load_count; i++)
 		{
-			if (values[masked] && get_hash(values[masked]) == hash)
+			// Keys are mirrored in a flat array so the probe sequence reads
+			// contiguous memory. The node itself is only touched on a match.
+			if (hashes[masked] == hash && values[masked])
 				return values[masked];
 			masked = (masked + 1) & hash_mask;
 		}
@@ -136,7 +138,7 @@ public:
 
 		for (unsigned i = 0; i < load_count; i++)
 		{
-			if (values[masked] && get_hash(values[masked]) == hash)
+			if (values[masked] && hashes[masked] == hash)
 			{
 				T *ret = value;
 				value = values[masked];
@@ -145,6 +147,7 @@ public:
 			else if (!values[masked])
 			{
 				values[masked] = value;
+				hashes[masked] = hash;
 				list.insert_front(value);
 				return nullptr;
 			}
@@ -166,7 +169,7 @@ public:
 
 		for (unsigned i = 0; i < load_count; i++)
 		{
-			if (values[masked] && get_hash(values[masked]) == hash)
+			if (values[masked] && hashes[masked] == hash)
 			{
 				std::swap(values[masked], value);
 				list.erase(value);
@@ -177,6 +180,7 @@ public:
 			{
 				assert(!values[masked]);
 				values[masked] = value;
+				hashes[masked] = hash;
 				list.insert_front(value);
 				return nullptr;
 			}
@@ -194,7 +198,7 @@ public:
 
 		for (unsigned i = 0; i < load_count; i++)
 		{
-			if (values[masked] && get_hash(values[masked]) == hash)
+			if (values[masked] && hashes[masked] == hash)
 			{
 				auto *value = values[masked];
 				list.erase(value);
@@ -215,6 +219,7 @@ public:
 	{
 		list.clear();
 		values.clear();
+		hashes.clear();
 		load_count = 0;
 	}
 
@@ -261,6 +266,7 @@ private:
 			if (!values[masked])
 			{
 				values[masked] = value;
+				hashes[masked] = hash;
 				return true;
 			}
 			masked = (masked + 1) & hash_mask;
@@ -288,6 +294,7 @@ private:
 				//LOGI("Growing hashmap to %u elements.\n", unsigned(values.size()));
 				load_count++;
 			}
+			hashes.resize(values.size());
 
 			// Re-insert.
 			success = true;
@@ -303,6 +310,10 @@ private:
 	}
 
 	std::vector<T *> values;
+	// Mirrors the key of each occupied slot in values. Probing a lookup only
+	// needs the keys, and reading them from a flat array avoids chasing a
+	// node pointer per probe. Only valid where values is non-null.
+	std::vector<Hash> hashes;
 	IntrusiveList<T> list;
 	unsigned load_count = 0;
 };
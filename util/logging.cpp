@@ -0,0 +1,119 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "logging.hpp"
+#include "message_queue.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <stdarg.h>
+#include <string.h>
+
+namespace Util
+{
+// The backend formats on the calling thread, pushes the string through a
+// lock-free MessageQueue and lets a single IO thread write it out. The
+// stream is flushed once per drained batch rather than once per message.
+struct AsyncLogger
+{
+	MessageQueue queue;
+	std::thread io_thread;
+	FILE *file = nullptr;
+
+	void looper()
+	{
+		MessageQueuePayload payloads[64];
+		size_t count;
+
+		// Returns 0 when the queue is corked in stop_async_logging().
+		while ((count = queue.wait_read_messages(payloads, 64)) != 0)
+			write_batch(payloads, count);
+		while ((count = queue.read_messages(payloads, 64)) != 0)
+			write_batch(payloads, count);
+		fflush(file);
+	}
+
+	void write_batch(MessageQueuePayload *payloads, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			fputs(static_cast<const char *>(payloads[i].get_payload_data()), file);
+			queue.recycle_payload(std::move(payloads[i]));
+		}
+		fflush(file);
+	}
+};
+
+static std::unique_ptr<AsyncLogger> async_logger;
+static std::atomic<AsyncLogger *> active_async_logger;
+
+bool start_async_logging(FILE *file)
+{
+	if (!file || async_logger)
+		return false;
+
+	async_logger.reset(new AsyncLogger);
+	async_logger->file = file;
+	async_logger->queue.uncork();
+	async_logger->io_thread = std::thread(&AsyncLogger::looper, async_logger.get());
+	active_async_logger.store(async_logger.get(), std::memory_order_release);
+	return true;
+}
+
+void stop_async_logging()
+{
+	if (!async_logger)
+		return;
+
+	active_async_logger.store(nullptr, std::memory_order_release);
+	async_logger->queue.cork();
+	async_logger->io_thread.join();
+	async_logger.reset();
+}
+
+bool log_message_async(const char *tag, const char *fmt, ...)
+{
+	auto *logger = active_async_logger.load(std::memory_order_acquire);
+	if (!logger)
+		return false;
+
+	// Thread-local so concurrent loggers never contend on the scratch space.
+	static thread_local char message_buffer[16 * 1024];
+	size_t tag_len = strlen(tag);
+	memcpy(message_buffer, tag, tag_len);
+	va_list va;
+	va_start(va, fmt);
+	vsnprintf(message_buffer + tag_len, sizeof(message_buffer) - tag_len, fmt, va);
+	va_end(va);
+
+	size_t message_size = strlen(message_buffer) + 1;
+	auto payload = logger->queue.allocate_write_payload(message_size);
+	if (payload)
+	{
+		memcpy(static_cast<char *>(payload.get_payload_data()), message_buffer, message_size);
+		// If the backlog is full the message is dropped,
+		// same policy as the queued logging path.
+		logger->queue.push_written_payload(std::move(payload));
+	}
+	return true;
+}
+}
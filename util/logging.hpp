@@ -23,6 +23,20 @@
 #pragma once
 #include <stdio.h>
 
+namespace Util
+{
+// Opt-in asynchronous logging backend. While active, LOG* formats on the
+// calling thread into a recycled payload and a background thread flushes
+// batches to the target stream, so hot paths never block on file IO.
+// Start and stop from a single thread while no other thread is logging.
+bool start_async_logging(FILE *file);
+void stop_async_logging();
+
+// Returns false if the async backend is not active, in which case the
+// caller falls back to synchronous logging.
+bool log_message_async(const char *tag, const char *fmt, ...);
+}
+
 #ifdef GRANITE_LOGGING_QUEUE
 #include "global_managers.hpp"
 #include "message_queue.hpp"
@@ -120,27 +134,56 @@ extern retro_log_printf_t libretro_log;
 #define LOGW(...) do { __android_log_print(ANDROID_LOG_WARN, "Granite", __VA_ARGS__); QUEUED_LOGW(__VA_ARGS__); } while(0)
 #define LOGI(...) do { __android_log_print(ANDROID_LOG_INFO, "Granite", __VA_ARGS__); QUEUED_LOGI(__VA_ARGS__); } while(0)
 #else
-#define LOGE(...)                                 \
-	do                                            \
-	{                                             \
-		fprintf(stderr, "[ERROR]: " __VA_ARGS__); \
-		fflush(stderr);                           \
-		QUEUED_LOGE(__VA_ARGS__);                 \
+#define LOGE(...)                                                 \
+	do                                                            \
+	{                                                             \
+		if (!::Util::log_message_async("[ERROR]: ", __VA_ARGS__)) \
+		{                                                         \
+			fprintf(stderr, "[ERROR]: " __VA_ARGS__);             \
+			fflush(stderr);                                       \
+		}                                                         \
+		QUEUED_LOGE(__VA_ARGS__);                                 \
 	} while (false)
 
-#define LOGW(...)                                \
-	do                                           \
-	{                                            \
-		fprintf(stderr, "[WARN]: " __VA_ARGS__); \
-		fflush(stderr);                          \
-		QUEUED_LOGW(__VA_ARGS__);                \
+#define LOGW(...)                                                \
+	do                                                           \
+	{                                                            \
+		if (!::Util::log_message_async("[WARN]: ", __VA_ARGS__)) \
+		{                                                        \
+			fprintf(stderr, "[WARN]: " __VA_ARGS__);             \
+			fflush(stderr);                                      \
+		}                                                        \
+		QUEUED_LOGW(__VA_ARGS__);                                \
 	} while (false)
 
-#define LOGI(...)                                \
-	do                                           \
-	{                                            \
-		fprintf(stderr, "[INFO]: " __VA_ARGS__); \
-		fflush(stderr);                          \
-		QUEUED_LOGI(__VA_ARGS__);                \
+#define LOGI(...)                                                \
+	do                                                           \
+	{                                                            \
+		if (!::Util::log_message_async("[INFO]: ", __VA_ARGS__)) \
+		{                                                        \
+			fprintf(stderr, "[INFO]: " __VA_ARGS__);             \
+			fflush(stderr);                                      \
+		}                                                        \
+		QUEUED_LOGI(__VA_ARGS__);                                \
 	} while (false)
 #endif
+
+// Compile-time log level. Messages below the level compile to nothing, so
+// verbose logging in hot paths has zero codegen cost in tuned builds.
+// 3 = info and up (default), 2 = warnings and up, 1 = errors only, 0 = off.
+#ifndef GRANITE_LOG_LEVEL
+#define GRANITE_LOG_LEVEL 3
+#endif
+
+#if GRANITE_LOG_LEVEL < 3
+#undef LOGI
+#define LOGI(...) ((void)0)
+#endif
+#if GRANITE_LOG_LEVEL < 2
+#undef LOGW
+#define LOGW(...) ((void)0)
+#endif
+#if GRANITE_LOG_LEVEL < 1
+#undef LOGE
+#define LOGE(...) ((void)0)
+#endif
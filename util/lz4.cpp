@@ -0,0 +1,231 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lz4.hpp"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace Util
+{
+namespace LZ4
+{
+enum : size_t
+{
+	MinMatch = 4,
+	// The block format forbids matches from running into the last 5 bytes,
+	// and match search stops 12 bytes before the end.
+	LastLiterals = 5,
+	MatchSearchMargin = 12,
+	MaxOffset = 65535,
+	HashLog = 16
+};
+
+size_t compress_bound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t hash_u32(uint32_t v)
+{
+	// Fibonacci hash over the 4 bytes at the cursor.
+	return (v * 2654435761u) >> (32 - HashLog);
+}
+
+static uint8_t *write_length(uint8_t *out, const uint8_t *out_end, size_t len)
+{
+	// Lengths >= 15 continue in bytes of 255 plus a terminator byte.
+	while (len >= 255)
+	{
+		if (out == out_end)
+			return nullptr;
+		*out++ = 255;
+		len -= 255;
+	}
+	if (out == out_end)
+		return nullptr;
+	*out++ = uint8_t(len);
+	return out;
+}
+
+static uint8_t *write_sequence(uint8_t *out, const uint8_t *out_end,
+                               const uint8_t *literals, size_t literal_len,
+                               size_t offset, size_t match_len)
+{
+	if (out == out_end)
+		return nullptr;
+	uint8_t *token = out++;
+	*token = uint8_t((literal_len < 15 ? literal_len : 15) << 4);
+	if (literal_len >= 15 && !(out = write_length(out, out_end, literal_len - 15)))
+		return nullptr;
+
+	if (size_t(out_end - out) < literal_len)
+		return nullptr;
+	if (literal_len)
+	{
+		memcpy(out, literals, literal_len);
+		out += literal_len;
+	}
+
+	// The final sequence is literals only.
+	if (!match_len)
+		return out;
+
+	if (size_t(out_end - out) < 2)
+		return nullptr;
+	*out++ = uint8_t(offset >> 0);
+	*out++ = uint8_t(offset >> 8);
+
+	size_t encoded_match = match_len - MinMatch;
+	*token |= uint8_t(encoded_match < 15 ? encoded_match : 15);
+	if (encoded_match >= 15 && !(out = write_length(out, out_end, encoded_match - 15)))
+		return nullptr;
+
+	return out;
+}
+
+size_t compress(void *dst_, size_t dst_size, const void *src_, size_t src_size)
+{
+	auto *src = static_cast<const uint8_t *>(src_);
+	auto *dst = static_cast<uint8_t *>(dst_);
+	auto *dst_end = dst + dst_size;
+	auto *out = dst;
+
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	const uint8_t *iend = src + src_size;
+	const uint8_t *match_search_end = src_size > MatchSearchMargin ? iend - MatchSearchMargin : src;
+	const uint8_t *match_end_limit = src_size > LastLiterals ? iend - LastLiterals : src;
+
+	// Most recent position of each 4-byte hash, offset by one so 0 means empty.
+	std::vector<uint32_t> table(size_t(1) << HashLog);
+
+	while (ip < match_search_end)
+	{
+		uint32_t h = hash_u32(read_u32(ip));
+		const uint8_t *candidate = table[h] ? src + table[h] - 1 : nullptr;
+		table[h] = uint32_t(ip - src) + 1;
+
+		if (!candidate || size_t(ip - candidate) > MaxOffset || read_u32(candidate) != read_u32(ip))
+		{
+			ip++;
+			continue;
+		}
+
+		const uint8_t *p = ip + MinMatch;
+		const uint8_t *mp = candidate + MinMatch;
+		while (p < match_end_limit && *p == *mp)
+		{
+			p++;
+			mp++;
+		}
+
+		out = write_sequence(out, dst_end, anchor, ip - anchor, ip - candidate, p - ip);
+		if (!out)
+			return 0;
+		ip = p;
+		anchor = p;
+	}
+
+	out = write_sequence(out, dst_end, anchor, iend - anchor, 0, 0);
+	return out ? out - dst : 0;
+}
+
+bool decompress(void *dst_, size_t dst_size, const void *src_, size_t src_size)
+{
+	auto *ip = static_cast<const uint8_t *>(src_);
+	auto *iend = ip + src_size;
+	auto *dst = static_cast<uint8_t *>(dst_);
+	auto *op = dst;
+	auto *oend = op + dst_size;
+
+	while (ip < iend)
+	{
+		uint8_t token = *ip++;
+
+		size_t literal_len = token >> 4;
+		if (literal_len == 15)
+		{
+			uint8_t v;
+			do
+			{
+				if (ip == iend)
+					return false;
+				v = *ip++;
+				literal_len += v;
+			} while (v == 255);
+		}
+
+		if (size_t(iend - ip) < literal_len || size_t(oend - op) < literal_len)
+			return false;
+		if (literal_len)
+		{
+			memcpy(op, ip, literal_len);
+			op += literal_len;
+			ip += literal_len;
+		}
+
+		// The final sequence carries no match.
+		if (ip == iend)
+			break;
+
+		if (size_t(iend - ip) < 2)
+			return false;
+		size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+		ip += 2;
+		if (!offset || offset > size_t(op - dst))
+			return false;
+
+		size_t match_len = token & 15;
+		if (match_len == 15)
+		{
+			uint8_t v;
+			do
+			{
+				if (ip == iend)
+					return false;
+				v = *ip++;
+				match_len += v;
+			} while (v == 255);
+		}
+		match_len += MinMatch;
+
+		if (size_t(oend - op) < match_len)
+			return false;
+
+		// Byte-wise copy, the match may overlap its own output.
+		const uint8_t *mp = op - offset;
+		while (match_len--)
+			*op++ = *mp++;
+	}
+
+	return op == oend;
+}
+}
+}
@@ -0,0 +1,46 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+namespace Util
+{
+// Self-contained implementation of the LZ4 block format
+// (greedy parse, byte-exact with the reference block layout).
+// Used for transport compression where pulling in a dependency
+// is not worth it; favors simplicity over peak encode speed.
+namespace LZ4
+{
+// Worst case compressed size for incompressible input.
+size_t compress_bound(size_t size);
+
+// Compresses src into dst, returns the compressed size,
+// or 0 if dst_size is too small (pass compress_bound() to avoid this).
+size_t compress(void *dst, size_t dst_size, const void *src, size_t src_size);
+
+// Decompresses a block which must expand to exactly dst_size bytes.
+// Fully bounds-checked, returns false on malformed input.
+bool decompress(void *dst, size_t dst_size, const void *src, size_t src_size);
+}
+}
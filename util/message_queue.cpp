@@ -103,11 +103,33 @@ MessageQueuePayload LockFreeMessageQueue::allocate_write_payload(size_t size) no
 MessageQueue::MessageQueue()
 {
 	corked.store(true);
+	sleeping.store(false);
+
+	for (unsigned i = 0; i < 8; i++)
+		payload_capacity[i] = 256u << i;
+	for (unsigned i = 0; i < 8; i++)
+		write_ring[i].reset((16u * 1024u) >> i);
+	read_ring.reset(32 * 1024);
+
+	// Pre-fill the rings.
+	for (unsigned i = 0; i < 8; i++)
+	{
+		unsigned count = 512u >> i;
+		for (unsigned j = 0; j < count; j++)
+		{
+			MessageQueuePayload payload;
+			payload.set_payload_data(memalign_calloc(64, payload_capacity[i]), payload_capacity[i]);
+			recycle_payload(std::move(payload));
+		}
+	}
 }
 
 void MessageQueue::cork()
 {
 	corked.store(true, std::memory_order_relaxed);
+	// Kick a blocked consumer loose, the queue is shutting down.
+	std::lock_guard<std::mutex> holder{lock};
+	cond.notify_all();
 }
 
 void MessageQueue::uncork()
@@ -124,31 +146,85 @@ MessageQueuePayload MessageQueue::allocate_write_payload(size_t size) noexcept
 {
 	if (corked.load(std::memory_order_relaxed))
 		return {};
-	std::lock_guard<std::mutex> holder{lock};
-	return LockFreeMessageQueue::allocate_write_payload(size);
+
+	MessageQueuePayload payload;
+	for (unsigned i = 0; i < 8; i++)
+	{
+		if (size <= payload_capacity[i])
+		{
+			if (!write_ring[i].read_and_move(payload))
+				payload.set_payload_data(memalign_calloc(64, payload_capacity[i]), payload_capacity[i]);
+			return payload;
+		}
+	}
+
+	payload.set_payload_data(memalign_calloc(64, size), size);
+	return payload;
 }
 
 bool MessageQueue::push_written_payload(MessageQueuePayload payload) noexcept
 {
-	std::lock_guard<std::mutex> holder{lock};
-	return LockFreeMessageQueue::push_written_payload(std::move(payload));
+	if (!read_ring.write_and_move(std::move(payload)))
+		return false;
+
+	// Dekker-style handshake with wait_read_messages(). The fence orders the
+	// ring publish before the sleeping check, so either we observe the
+	// consumer going to sleep and wake it, or its recheck sees our message.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		cond.notify_one();
+	}
+	return true;
 }
 
 size_t MessageQueue::available_read_messages() const noexcept
 {
-	std::lock_guard<std::mutex> holder{lock};
-	return LockFreeMessageQueue::available_read_messages();
+	return read_ring.read_avail();
 }
 
 MessageQueuePayload MessageQueue::read_message() noexcept
 {
-	std::lock_guard<std::mutex> holder{lock};
-	return LockFreeMessageQueue::read_message();
+	MessageQueuePayload payload;
+	read_ring.read_and_move(payload);
+	return payload;
+}
+
+size_t MessageQueue::read_messages(MessageQueuePayload *payloads, size_t count) noexcept
+{
+	size_t ret = 0;
+	while (ret < count && read_ring.read_and_move(payloads[ret]))
+		ret++;
+	return ret;
+}
+
+size_t MessageQueue::wait_read_messages(MessageQueuePayload *payloads, size_t count) noexcept
+{
+	size_t ret = read_messages(payloads, count);
+	if (ret)
+		return ret;
+
+	std::unique_lock<std::mutex> holder{lock};
+	sleeping.store(true, std::memory_order_relaxed);
+	cond.wait(holder, [&]() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		ret = read_messages(payloads, count);
+		return ret != 0 || corked.load(std::memory_order_relaxed);
+	});
+	sleeping.store(false, std::memory_order_relaxed);
+	return ret;
 }
 
 void MessageQueue::recycle_payload(MessageQueuePayload payload) noexcept
 {
-	std::lock_guard<std::mutex> holder{lock};
-	return LockFreeMessageQueue::recycle_payload(std::move(payload));
+	for (unsigned i = 0; i < 8; i++)
+	{
+		if (payload.get_capacity() == payload_capacity[i])
+		{
+			write_ring[i].write_and_move(std::move(payload));
+			return;
+		}
+	}
 }
 }
@@ -133,6 +133,99 @@ private:
 	std::vector<T> ring;
 };
 
+// Bounded Vyukov-style ring with a sequence number per slot. Supports any
+// number of concurrent readers and writers; the fast path is one CAS on the
+// shared position counter per operation, with no locks anywhere.
+template <typename T>
+class LockFreeMPMCRingBuffer
+{
+public:
+	LockFreeMPMCRingBuffer()
+	{
+		reset(1);
+	}
+
+	void reset(size_t count)
+	{
+		assert((count & (count - 1)) == 0);
+		slots.reset(new Slot[count]);
+		mask = count - 1;
+		for (size_t i = 0; i < count; i++)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		enqueue_pos.store(0, std::memory_order_relaxed);
+		dequeue_pos.store(0, std::memory_order_relaxed);
+	}
+
+	size_t read_avail() const noexcept
+	{
+		return enqueue_pos.load(std::memory_order_acquire) -
+		       dequeue_pos.load(std::memory_order_relaxed);
+	}
+
+	bool write_and_move(T value) noexcept
+	{
+		Slot *slot;
+		size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot = &slots[pos & mask];
+			size_t seq = slot->sequence.load(std::memory_order_acquire);
+			intptr_t diff = intptr_t(seq) - intptr_t(pos);
+			if (diff == 0)
+			{
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+
+		slot->data = std::move(value);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool read_and_move(T &value) noexcept
+	{
+		Slot *slot;
+		size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot = &slots[pos & mask];
+			size_t seq = slot->sequence.load(std::memory_order_acquire);
+			intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+			if (diff == 0)
+			{
+				if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = dequeue_pos.load(std::memory_order_relaxed);
+		}
+
+		value = std::move(slot->data);
+		slot->sequence.store(pos + mask + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask = 0;
+	// Keep the producer and consumer counters on separate cache lines.
+	alignas(64) std::atomic<size_t> enqueue_pos;
+	alignas(64) std::atomic<size_t> dequeue_pos;
+};
+
 struct MessageQueuePayloadDeleter
 {
 	void operator()(void *ptr);
@@ -213,7 +306,11 @@ private:
 	size_t payload_capacity[8] = {};
 };
 
-class MessageQueue : private LockFreeMessageQueue
+// Fully lock-free many-producers, one-consumer queue. Producers push from any
+// thread without taking locks; the consumer can poll with read_messages() or
+// block in wait_read_messages(). The lock and condition variable below only
+// back the sleep/wake path, never the message fast path.
+class MessageQueue
 {
 public:
 	MessageQueue();
@@ -227,11 +324,25 @@ public:
 
 	size_t available_read_messages() const noexcept;
 	MessageQueuePayload read_message() noexcept;
+
+	// Drains up to count messages into payloads and returns how many were
+	// read, so bursts are consumed without per-message wakeup checks.
+	size_t read_messages(MessageQueuePayload *payloads, size_t count) noexcept;
+
+	// Blocks until at least one message is available, then drains like
+	// read_messages(). Returns 0 if the queue is corked while waiting.
+	size_t wait_read_messages(MessageQueuePayload *payloads, size_t count) noexcept;
+
 	void recycle_payload(MessageQueuePayload payload) noexcept;
 
 private:
+	LockFreeMPMCRingBuffer<MessageQueuePayload> read_ring;
+	LockFreeMPMCRingBuffer<MessageQueuePayload> write_ring[8];
+	size_t payload_capacity[8] = {};
+
 	mutable std::mutex lock;
 	mutable std::condition_variable cond;
 	std::atomic_bool corked;
+	std::atomic_bool sleeping;
 };
 }
\ No newline at end of file
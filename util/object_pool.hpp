@@ -22,10 +22,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <vector>
 #include <algorithm>
+#include <stdint.h>
 #include <stdlib.h>
 #include "aligned_alloc.hpp"
 
@@ -41,19 +43,8 @@ public:
 	T *allocate(P &&... p)
 	{
 #ifndef OBJECT_POOL_DEBUG
-		if (vacants.empty())
-		{
-			unsigned num_objects = 64u << memory.size();
-			T *ptr = static_cast<T *>(memalign_alloc(std::max(size_t(64), alignof(T)),
-			                                         num_objects * sizeof(T)));
-			if (!ptr)
-				return nullptr;
-
-			for (unsigned i = 0; i < num_objects; i++)
-				vacants.push_back(&ptr[i]);
-
-			memory.emplace_back(ptr);
-		}
+		if (vacants.empty() && !grow_vacants())
+			return nullptr;
 
 		T *ptr = vacants.back();
 		vacants.pop_back();
@@ -84,6 +75,21 @@ public:
 
 protected:
 #ifndef OBJECT_POOL_DEBUG
+	bool grow_vacants()
+	{
+		unsigned num_objects = 64u << memory.size();
+		T *ptr = static_cast<T *>(memalign_alloc(std::max(size_t(64), alignof(T)),
+		                                         num_objects * sizeof(T)));
+		if (!ptr)
+			return false;
+
+		for (unsigned i = 0; i < num_objects; i++)
+			vacants.push_back(&ptr[i]);
+
+		memory.emplace_back(ptr);
+		return true;
+	}
+
 	std::vector<T *> vacants;
 
 	struct MallocDeleter
@@ -98,35 +104,122 @@ protected:
 #endif
 };
 
+// Each thread caches a small magazine of objects per pool, so the common
+// allocate/free path never takes the lock. Magazines exchange objects with
+// the shared free list half a magazine at a time, amortizing the lock to one
+// acquisition per MagazineSize / 2 operations. The caches are looked up by a
+// process-unique pool ID which is never reused, so a stale thread-local entry
+// for a destroyed pool can never match. Objects sitting in the magazine of an
+// exited thread are not recycled until the pool dies, which is fine for the
+// long-lived worker threads these pools are used from.
 template<typename T>
 class ThreadSafeObjectPool : private ObjectPool<T>
 {
 public:
+	ThreadSafeObjectPool()
+	{
+#ifndef OBJECT_POOL_DEBUG
+		static std::atomic<uint64_t> pool_ids{1};
+		pool_id = pool_ids.fetch_add(1, std::memory_order_relaxed);
+#endif
+	}
+
 	template<typename... P>
 	T *allocate(P &&... p)
 	{
-		std::lock_guard<std::mutex> holder{lock};
-		return ObjectPool<T>::allocate(std::forward<P>(p)...);
+#ifndef OBJECT_POOL_DEBUG
+		auto &mag = get_magazine();
+		if (mag.count == 0)
+			refill(mag);
+		if (mag.count == 0)
+			return nullptr;
+
+		T *ptr = mag.objects[--mag.count];
+		new(ptr) T(std::forward<P>(p)...);
+		return ptr;
+#else
+		return new T(std::forward<P>(p)...);
+#endif
 	}
 
 	void free(T *ptr)
 	{
 #ifndef OBJECT_POOL_DEBUG
 		ptr->~T();
-		std::lock_guard<std::mutex> holder{lock};
-		this->vacants.push_back(ptr);
+		auto &mag = get_magazine();
+		if (mag.count == MagazineSize)
+			flush_half(mag);
+		mag.objects[mag.count++] = ptr;
 #else
 		delete ptr;
 #endif
 	}
 
+	// Like the base class, clearing requires that no other thread touches the
+	// pool concurrently.
 	void clear()
 	{
+#ifndef OBJECT_POOL_DEBUG
 		std::lock_guard<std::mutex> holder{lock};
+		for (auto &mag : magazines)
+			mag->count = 0;
 		ObjectPool<T>::clear();
+#endif
 	}
 
 private:
+#ifndef OBJECT_POOL_DEBUG
+	enum { MagazineSize = 32 };
+
+	struct Magazine
+	{
+		T *objects[MagazineSize];
+		unsigned count = 0;
+	};
+
+	Magazine &get_magazine()
+	{
+		// Only a handful of pools of a given type exist (e.g. the handle
+		// pools in the device), so a tiny linear cache per thread is enough.
+		static thread_local std::vector<std::pair<uint64_t, Magazine *>> tls_magazines;
+		for (auto &m : tls_magazines)
+			if (m.first == pool_id)
+				return *m.second;
+
+		auto mag = std::unique_ptr<Magazine>(new Magazine);
+		auto *ret = mag.get();
+		{
+			std::lock_guard<std::mutex> holder{lock};
+			magazines.push_back(std::move(mag));
+		}
+		tls_magazines.emplace_back(pool_id, ret);
+		return *ret;
+	}
+
+	void refill(Magazine &mag)
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		if (this->vacants.empty() && !this->grow_vacants())
+			return;
+
+		auto count = std::min<size_t>(MagazineSize / 2, this->vacants.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			mag.objects[mag.count++] = this->vacants.back();
+			this->vacants.pop_back();
+		}
+	}
+
+	void flush_half(Magazine &mag)
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		for (unsigned i = 0; i < MagazineSize / 2; i++)
+			this->vacants.push_back(mag.objects[--mag.count]);
+	}
+
+	std::vector<std::unique_ptr<Magazine>> magazines;
+	uint64_t pool_id;
+#endif
 	std::mutex lock;
 };
 }
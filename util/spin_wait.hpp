@@ -0,0 +1,58 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Util
+{
+static inline void spin_pause()
+{
+#ifdef __SSE2__
+	_mm_pause();
+#endif
+}
+
+// Polls pred with exponentially growing batches of pause hints in between,
+// spending roughly max_pauses pause iterations in total. Returns true if
+// pred succeeded while spinning; the caller then parks in the kernel.
+// Waits which usually complete within a few microseconds stay entirely in
+// user space this way, avoiding the context switch on the common path.
+template <typename Pred>
+inline bool spin_wait_until(const Pred &pred, unsigned max_pauses)
+{
+	unsigned batch = 1;
+	for (unsigned pauses = 0; pauses < max_pauses; pauses += batch)
+	{
+		if (pred())
+			return true;
+		for (unsigned i = 0; i < batch; i++)
+			spin_pause();
+		if (batch < 64)
+			batch *= 2;
+	}
+	return pred();
+}
+}
@@ -0,0 +1,271 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "timeline_trace_file.hpp"
+#include "timer.hpp"
+#include "logging.hpp"
+#include <atomic>
+#include <string.h>
+
+namespace Util
+{
+static thread_local char trace_tid[32];
+
+static const char *get_tid()
+{
+	if (trace_tid[0] == '\0')
+	{
+		static std::atomic_uint tid_counter;
+		unsigned index = tid_counter.fetch_add(1, std::memory_order_relaxed);
+		snprintf(trace_tid, sizeof(trace_tid), "thread-%u", index);
+	}
+	return trace_tid;
+}
+
+void TimelineTraceFile::set_tid(const char *tid)
+{
+	snprintf(trace_tid, sizeof(trace_tid), "%s", tid);
+}
+
+void TimelineTraceFile::Event::set_desc(const char *desc_)
+{
+	snprintf(desc, sizeof(desc), "%s", desc_);
+}
+
+void TimelineTraceFile::Event::set_tid(const char *tid_)
+{
+	snprintf(tid, sizeof(tid), "%s", tid_);
+}
+
+TimelineTraceFile::TimelineTraceFile(const std::string &path)
+{
+	file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		LOGE("Failed to open timeline trace file: %s\n", path.c_str());
+		return;
+	}
+
+	// Use the Chrome tracing format. It's trivial to emit and we get a frontend for free :)
+	fprintf(file, "[");
+
+	// The queue starts out corked so producers drop their events
+	// if we never got a file to write them to.
+	queue.uncork();
+	io_thread = std::thread(&TimelineTraceFile::looper, this);
+}
+
+TimelineTraceFile::TimelineTraceFile()
+{
+	// Monitor-only: no file, but the events still drain through the IO thread
+	// so zone budgets are checked.
+	queue.uncork();
+	io_thread = std::thread(&TimelineTraceFile::looper, this);
+}
+
+void TimelineTraceFile::set_zone_budget(const char *desc, uint64_t budget_ns,
+                                        unsigned breach_count, unsigned recovery_count)
+{
+	std::lock_guard<std::mutex> holder{budget_lock};
+	if (!budget_ns)
+	{
+		budgets.erase(desc);
+		has_budgets.store(!budgets.empty(), std::memory_order_relaxed);
+		return;
+	}
+
+	auto &budget = budgets[desc];
+	budget.budget_ns = budget_ns;
+	budget.breach_count = breach_count;
+	budget.recovery_count = recovery_count;
+	budget.over = 0;
+	budget.under = 0;
+	budget.armed = true;
+	has_budgets.store(true, std::memory_order_relaxed);
+}
+
+void TimelineTraceFile::set_budget_breach_callback(BudgetCallback callback)
+{
+	std::lock_guard<std::mutex> holder{budget_lock};
+	budget_callback = std::move(callback);
+}
+
+void TimelineTraceFile::check_budget(const Event &e)
+{
+	uint64_t duration_ns = e.end_ns - e.start_ns;
+	uint64_t budget_ns = 0;
+	BudgetCallback fire;
+
+	{
+		std::lock_guard<std::mutex> holder{budget_lock};
+		auto itr = budgets.find(e.desc);
+		if (itr == budgets.end())
+			return;
+
+		auto &budget = itr->second;
+		if (duration_ns > budget.budget_ns)
+		{
+			budget.under = 0;
+			budget.over++;
+			if (budget.armed && budget.over >= budget.breach_count)
+			{
+				budget.armed = false;
+				budget_ns = budget.budget_ns;
+				fire = budget_callback;
+			}
+		}
+		else
+		{
+			budget.over = 0;
+			if (!budget.armed && ++budget.under >= budget.recovery_count)
+			{
+				budget.armed = true;
+				budget.under = 0;
+			}
+		}
+	}
+
+	// Fire outside the lock so the callback is free to adjust budgets.
+	if (fire)
+		fire(e.desc, budget_ns, duration_ns);
+}
+
+void TimelineTraceFile::push_event(const char *tid, const char *desc, uint32_t pid,
+                                   uint64_t start_ns, uint64_t end_ns)
+{
+	auto payload = queue.allocate_write_payload(sizeof(Event));
+	if (!payload)
+		return;
+
+	auto &e = *static_cast<Event *>(payload.get_payload_data());
+	e.set_desc(desc);
+	e.set_tid(tid);
+	e.pid = pid;
+	e.type = Event::Type::Complete;
+	e.start_ns = start_ns;
+	e.end_ns = end_ns;
+	queue.push_written_payload(std::move(payload));
+}
+
+void TimelineTraceFile::push_counter(const char *desc, uint64_t value)
+{
+	auto payload = queue.allocate_write_payload(sizeof(Event));
+	if (!payload)
+		return;
+
+	auto &e = *static_cast<Event *>(payload.get_payload_data());
+	e.set_desc(desc);
+	e.set_tid(get_tid());
+	e.pid = 0;
+	e.type = Event::Type::Counter;
+	e.start_ns = uint64_t(get_current_time_nsecs());
+	e.end_ns = value;
+	queue.push_written_payload(std::move(payload));
+}
+
+TimelineTraceFile::ScopedEvent::ScopedEvent(TimelineTraceFile *file_, const char *desc)
+{
+	if (!file_)
+		return;
+
+	payload = file_->queue.allocate_write_payload(sizeof(Event));
+	if (!payload)
+		return;
+
+	file = file_;
+	auto &e = *static_cast<Event *>(payload.get_payload_data());
+	e.set_desc(desc);
+	e.set_tid(get_tid());
+	e.pid = 0;
+	e.type = Event::Type::Complete;
+	e.start_ns = uint64_t(get_current_time_nsecs());
+}
+
+TimelineTraceFile::ScopedEvent::~ScopedEvent()
+{
+	if (!file)
+		return;
+
+	auto &e = *static_cast<Event *>(payload.get_payload_data());
+	e.end_ns = uint64_t(get_current_time_nsecs());
+	file->queue.push_written_payload(std::move(payload));
+}
+
+void TimelineTraceFile::write_event(const Event &e)
+{
+	if (e.type == Event::Type::Counter)
+	{
+		fprintf(file, "\t{ \"name\": \"%s\", \"ph\": \"C\", \"pid\": \"%u\", \"ts\": %lld, \"args\": { \"value\": %llu } },\n",
+		        e.desc, e.pid,
+		        static_cast<long long>(e.start_ns / 1000),
+		        static_cast<unsigned long long>(e.end_ns));
+		return;
+	}
+
+	// Complete events keep the file half the size of begin/end pairs.
+	fprintf(file, "\t{ \"name\": \"%s\", \"ph\": \"X\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %lld, \"dur\": %lld },\n",
+	        e.desc, e.tid, e.pid,
+	        static_cast<long long>(e.start_ns / 1000),
+	        static_cast<long long>((e.end_ns - e.start_ns) / 1000));
+}
+
+void TimelineTraceFile::looper()
+{
+	set_tid("trace-io");
+
+	MessageQueuePayload payloads[64];
+	size_t count;
+
+	const auto handle_event = [this](MessageQueuePayload &payload) {
+		auto &e = *static_cast<Event *>(payload.get_payload_data());
+		if (e.type == Event::Type::Complete && has_budgets.load(std::memory_order_relaxed))
+			check_budget(e);
+		if (file)
+			write_event(e);
+		queue.recycle_payload(std::move(payload));
+	};
+
+	// wait_read_messages() returns 0 when the queue is corked, which only
+	// happens in the destructor after all producers are done.
+	while ((count = queue.wait_read_messages(payloads, 64)) != 0)
+		for (size_t i = 0; i < count; i++)
+			handle_event(payloads[i]);
+
+	// Final drain of anything still sitting in the ring.
+	while ((count = queue.read_messages(payloads, 64)) != 0)
+		for (size_t i = 0; i < count; i++)
+			handle_event(payloads[i]);
+}
+
+TimelineTraceFile::~TimelineTraceFile()
+{
+	if (io_thread.joinable())
+	{
+		queue.cork();
+		io_thread.join();
+	}
+
+	// Intentionally truncate the JSON so that we can emit "," after the last element.
+	if (file)
+		fclose(file);
+}
+}
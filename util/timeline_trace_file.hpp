@@ -0,0 +1,158 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "message_queue.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <stdio.h>
+#include <stdint.h>
+
+namespace Util
+{
+// Writes a Chrome tracing format JSON file (chrome://tracing / Perfetto).
+// Any thread can record events; they are pushed through a lock-free
+// MessageQueue and serialized to disk by a dedicated IO thread, so
+// instrumented code never blocks on file IO.
+// All timestamps are in the CLOCK_MONOTONIC domain in nanoseconds
+// (Util::get_current_time_nsecs()), so CPU zones and externally converted
+// GPU timestamps line up on the same timeline.
+class TimelineTraceFile
+{
+public:
+	explicit TimelineTraceFile(const std::string &path);
+
+	// Monitor-only mode. No file is written, but the event stream still runs
+	// so zone budgets are checked, letting production builds keep alarms
+	// armed without the cost of writing a trace.
+	TimelineTraceFile();
+
+	~TimelineTraceFile();
+
+	TimelineTraceFile(const TimelineTraceFile &) = delete;
+	void operator=(const TimelineTraceFile &) = delete;
+
+	bool is_active() const
+	{
+		return file != nullptr;
+	}
+
+	// Sets the thread name used for events recorded by the calling thread.
+	// Defaults to "thread-N" in order of first use.
+	static void set_tid(const char *tid);
+
+	struct Event
+	{
+		enum class Type : uint32_t
+		{
+			Complete,
+			// Named counter sample. start_ns holds the timestamp,
+			// end_ns holds the sampled value.
+			Counter
+		};
+
+		char desc[64];
+		char tid[32];
+		uint32_t pid;
+		Type type;
+		uint64_t start_ns, end_ns;
+
+		void set_desc(const char *desc);
+		void set_tid(const char *tid);
+	};
+
+	// For producers which already know their timestamps, e.g. GPU timestamps
+	// which have been converted to the monotonic domain.
+	void push_event(const char *tid, const char *desc, uint32_t pid,
+	                uint64_t start_ns, uint64_t end_ns);
+
+	// Records a counter sample at the current time. Shows up as a counter
+	// track in the trace viewer, e.g. per-frame pool memory watermarks.
+	void push_counter(const char *desc, uint64_t value);
+
+	// Declares a timing budget for a zone. desc must match the zone descriptor
+	// exactly. Budgets are checked on the IO thread as the events drain, so
+	// instrumented code pays nothing. The alarm fires once breach_count
+	// consecutive occurrences run over budget and re-arms after recovery_count
+	// consecutive occurrences back in budget, so one-off spikes and
+	// breach/recover flapping do not spam the callback. A budget of 0 removes
+	// the zone's budget.
+	void set_zone_budget(const char *desc, uint64_t budget_ns,
+	                     unsigned breach_count = 3, unsigned recovery_count = 60);
+
+	// Runs on the IO thread when an armed budget breaches. Typical use is to
+	// fire telemetry, or to request a detailed capture of an upcoming frame
+	// (e.g. enable GPU timestamps or start a full trace) now that the engine
+	// knows it is over budget. Set before events start flowing.
+	using BudgetCallback = std::function<void (const char *desc, uint64_t budget_ns, uint64_t duration_ns)>;
+	void set_budget_breach_callback(BudgetCallback callback);
+
+	// RAII scoped CPU zone. A null file is a no-op, so instrumentation can
+	// stay in place when tracing is disabled.
+	struct ScopedEvent
+	{
+		ScopedEvent(TimelineTraceFile *file, const char *desc);
+		~ScopedEvent();
+
+		ScopedEvent(const ScopedEvent &) = delete;
+		void operator=(const ScopedEvent &) = delete;
+
+	private:
+		TimelineTraceFile *file = nullptr;
+		MessageQueuePayload payload;
+	};
+
+private:
+	void looper();
+	void write_event(const Event &e);
+	void check_budget(const Event &e);
+
+	FILE *file = nullptr;
+	MessageQueue queue;
+	std::thread io_thread;
+
+	struct Budget
+	{
+		uint64_t budget_ns;
+		unsigned breach_count;
+		unsigned recovery_count;
+		unsigned over = 0;
+		unsigned under = 0;
+		bool armed = true;
+	};
+	std::mutex budget_lock;
+	std::unordered_map<std::string, Budget> budgets;
+	BudgetCallback budget_callback;
+	// Cheap gate so the drain loop skips the lock when no budgets exist.
+	std::atomic_bool has_budgets{false};
+};
+
+#define TIMELINE_TRACE_SCOPE_CONCAT_INNER(a, b) a##b
+#define TIMELINE_TRACE_SCOPE_CONCAT(a, b) TIMELINE_TRACE_SCOPE_CONCAT_INNER(a, b)
+#define TIMELINE_TRACE_SCOPE(file, desc) \
+	::Util::TimelineTraceFile::ScopedEvent TIMELINE_TRACE_SCOPE_CONCAT(timeline_trace_scope_, __COUNTER__){file, desc}
+}
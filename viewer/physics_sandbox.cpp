@@ -50,7 +50,7 @@ struct PhysicsSandboxApplication : Application, EventHandler
 		init_scene();
 		EVENT_MANAGER_REGISTER_LATCH(PhysicsSandboxApplication, on_swapchain_created, on_swapchain_destroyed, Vulkan::SwapchainParameterEvent);
 		EVENT_MANAGER_REGISTER(PhysicsSandboxApplication, on_key, KeyboardEvent);
-		EVENT_MANAGER_REGISTER(PhysicsSandboxApplication, on_collision, CollisionEvent);
+		EVENT_MANAGER_REGISTER(PhysicsSandboxApplication, on_collision, CollisionBatchEvent);
 		EVENT_MANAGER_REGISTER(PhysicsSandboxApplication, on_mouse, MouseButtonEvent);
 		EVENT_MANAGER_REGISTER(PhysicsSandboxApplication, on_input_state, InputStateEvent);
 		EVENT_MANAGER_REGISTER(PhysicsSandboxApplication, on_touch_down, TouchDownEvent);
@@ -131,13 +131,19 @@ struct PhysicsSandboxApplication : Application, EventHandler
 		return true;
 	}
 
-	bool on_collision(const CollisionEvent &e)
+	bool on_collision(const CollisionBatchEvent &e)
 	{
-		auto pos = e.get_world_contact();
-		auto n = e.get_world_normal();
+		auto *contacts = e.get_contacts();
+		size_t count = e.get_count();
 
-		LOGI("Pos: %f, %f, %f\n", pos.x, pos.y, pos.z);
-		LOGI("N: %f, %f, %f\n", n.x, n.y, n.z);
+		for (size_t i = 0; i < count; i++)
+		{
+			auto pos = contacts[i].get_world_contact();
+			auto n = contacts[i].get_world_normal();
+
+			LOGI("Pos: %f, %f, %f\n", pos.x, pos.y, pos.z);
+			LOGI("N: %f, %f, %f\n", n.x, n.y, n.z);
+		}
 
 		return true;
 	}
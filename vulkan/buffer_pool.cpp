@@ -37,6 +37,27 @@ void BufferPool::init(Device *device_, VkDeviceSize block_size_,
 	alignment = alignment_;
 	usage = usage_;
 	need_device_local = need_device_local_;
+	max_retained_block_size = block_size;
+}
+
+void BufferPool::set_max_retained_block_size(VkDeviceSize max_size)
+{
+	max_retained_block_size = max_size;
+}
+
+void BufferPool::begin_frame()
+{
+	if (frame_usage > block_size && block_size < max_retained_block_size)
+	{
+		VkDeviceSize new_size = block_size;
+		while (new_size < frame_usage && new_size < max_retained_block_size)
+			new_size *= 2;
+		block_size = min(new_size, max_retained_block_size);
+
+		// Retained blocks have the old size and cannot be reused.
+		blocks.clear();
+	}
+	frame_usage = 0;
 }
 
 void BufferPool::set_spill_region_size(VkDeviceSize spill_size_)
@@ -99,6 +120,8 @@ BufferBlock BufferPool::allocate_block(VkDeviceSize size)
 
 BufferBlock BufferPool::request_block(VkDeviceSize minimum_size)
 {
+	frame_usage += max(block_size, minimum_size);
+
 	if ((minimum_size > block_size) || blocks.empty())
 	{
 		return allocate_block(max(block_size, minimum_size));
@@ -116,7 +139,9 @@ BufferBlock BufferPool::request_block(VkDeviceSize minimum_size)
 
 void BufferPool::recycle_block(BufferBlock &&block)
 {
-	VK_ASSERT(block.size == block_size);
+	// Blocks allocated before an adaptive resize have a stale size, just free those.
+	if (block.size != block_size)
+		return;
 	blocks.push_back(move(block));
 }
 
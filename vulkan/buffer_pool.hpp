@@ -79,11 +79,34 @@ public:
 	// and we need to make sure we don't allocate beyond the block.
 	void set_spill_region_size(VkDeviceSize spill_size);
 
+	// Bounds how far the block size is allowed to grow in begin_frame().
+	void set_max_retained_block_size(VkDeviceSize max_size);
+
+	// Called once per frame context. Grows the block size in power-of-two steps
+	// towards the previous frame's high-water mark, so heavy streaming ends up in
+	// one large persistently mapped block instead of churning through many small ones.
+	void begin_frame();
+
 	VkDeviceSize get_block_size() const
 	{
 		return block_size;
 	}
 
+	// Bytes requested through request_block() this frame context.
+	VkDeviceSize get_frame_usage() const
+	{
+		return frame_usage;
+	}
+
+	// Bytes held in the recycle list, i.e. memory pinned between frames.
+	VkDeviceSize get_retained_size() const
+	{
+		VkDeviceSize size = 0;
+		for (auto &block : blocks)
+			size += block.size;
+		return size;
+	}
+
 	BufferBlock request_block(VkDeviceSize minimum_size);
 	void recycle_block(BufferBlock &&block);
 
@@ -92,6 +115,8 @@ private:
 	VkDeviceSize block_size = 0;
 	VkDeviceSize alignment = 0;
 	VkDeviceSize spill_size = 0;
+	VkDeviceSize max_retained_block_size = 0;
+	VkDeviceSize frame_usage = 0;
 	VkBufferUsageFlags usage = 0;
 	std::vector<BufferBlock> blocks;
 	BufferBlock allocate_block(VkDeviceSize size);
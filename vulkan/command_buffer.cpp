@@ -57,6 +57,7 @@ CommandBuffer::~CommandBuffer()
 	VK_ASSERT(ibo_block.mapped == nullptr);
 	VK_ASSERT(ubo_block.mapped == nullptr);
 	VK_ASSERT(staging_block.mapped == nullptr);
+	VK_ASSERT(indirect_block.mapped == nullptr);
 }
 
 void CommandBuffer::fill_buffer(const Buffer &dst, uint32_t value)
@@ -452,6 +453,7 @@ void CommandBuffer::blit_image(const Image &dst, const Image &src,
 void CommandBuffer::begin_context()
 {
 	dirty = ~0u;
+	pipeline_state_generation++;
 	dirty_sets = ~0u;
 	dirty_vbos = ~0u;
 	current_pipeline = VK_NULL_HANDLE;
@@ -465,6 +467,8 @@ void CommandBuffer::begin_context()
 
 	if (debug_channel_buffer)
 		set_storage_buffer(VULKAN_NUM_DESCRIPTOR_SETS - 1, VULKAN_NUM_BINDINGS - 1, *debug_channel_buffer);
+	if (aggregate_channel_buffer)
+		set_storage_buffer(VULKAN_NUM_DESCRIPTOR_SETS - 1, VULKAN_NUM_BINDINGS - 2, *aggregate_channel_buffer);
 }
 
 void CommandBuffer::begin_compute()
@@ -1001,7 +1005,12 @@ VkPipeline CommandBuffer::build_graphics_pipeline(Device *device, const Deferred
 
 bool CommandBuffer::flush_compute_pipeline(bool synchronous)
 {
-	update_hash_compute_pipeline(pipeline_state);
+	if (pipeline_state_generation != hashed_pipeline_state_generation)
+	{
+		update_hash_compute_pipeline(pipeline_state);
+		hashed_pipeline_state_generation = pipeline_state_generation;
+	}
+
 	current_pipeline = pipeline_state.program->get_pipeline(pipeline_state.hash);
 	if (current_pipeline == VK_NULL_HANDLE && synchronous)
 		current_pipeline = build_compute_pipeline(device, pipeline_state);
@@ -1086,7 +1095,12 @@ void CommandBuffer::update_hash_graphics_pipeline(DeferredPipelineCompile &compi
 
 bool CommandBuffer::flush_graphics_pipeline(bool synchronous)
 {
-	update_hash_graphics_pipeline(pipeline_state, active_vbos);
+	if (pipeline_state_generation != hashed_pipeline_state_generation)
+	{
+		update_hash_graphics_pipeline(pipeline_state, active_vbos);
+		hashed_pipeline_state_generation = pipeline_state_generation;
+	}
+
 	current_pipeline = pipeline_state.program->get_pipeline(pipeline_state.hash);
 
 	if (current_pipeline == VK_NULL_HANDLE && synchronous)
@@ -2049,15 +2063,52 @@ void CommandBuffer::flush_descriptor_sets()
 	dirty_sets_dynamic &= ~dynamic_set_update;
 }
 
+bool CommandBuffer::flush_draw_state()
+{
+#ifdef GRANITE_VULKAN_MT
+	if (allow_async_compile)
+	{
+		if (flush_render_state(false))
+			return true;
+
+		// Missed the pipeline cache. Kick the compile to a worker thread and drop the draw.
+		DeferredPipelineCompile compile;
+		extract_pipeline_state(compile);
+		if (compile.program)
+			device->request_async_pipeline_compile(compile, true);
+		return false;
+	}
+#endif
+	return flush_render_state(true);
+}
+
+bool CommandBuffer::flush_dispatch_state()
+{
+#ifdef GRANITE_VULKAN_MT
+	if (allow_async_compile)
+	{
+		if (flush_compute_state(false))
+			return true;
+
+		DeferredPipelineCompile compile;
+		extract_pipeline_state(compile);
+		if (compile.program)
+			device->request_async_pipeline_compile(compile, false);
+		return false;
+	}
+#endif
+	return flush_compute_state(true);
+}
+
 void CommandBuffer::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
 {
 	VK_ASSERT(!is_compute);
-	if (flush_render_state(true))
+	if (flush_draw_state())
 	{
 		set_backtrace_checkpoint();
 		table.vkCmdDraw(cmd, vertex_count, instance_count, first_vertex, first_instance);
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, draw call will be dropped.\n");
 }
 
@@ -2066,12 +2117,12 @@ void CommandBuffer::draw_indexed(uint32_t index_count, uint32_t instance_count,
 {
 	VK_ASSERT(!is_compute);
 	VK_ASSERT(index_state.buffer != VK_NULL_HANDLE);
-	if (flush_render_state(true))
+	if (flush_draw_state())
 	{
 		set_backtrace_checkpoint();
 		table.vkCmdDrawIndexed(cmd, index_count, instance_count, first_index, vertex_offset, first_instance);
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, draw call will be dropped.\n");
 }
 
@@ -2079,12 +2130,12 @@ void CommandBuffer::draw_indirect(const Vulkan::Buffer &buffer,
                                   uint32_t offset, uint32_t draw_count, uint32_t stride)
 {
 	VK_ASSERT(!is_compute);
-	if (flush_render_state(true))
+	if (flush_draw_state())
 	{
 		set_backtrace_checkpoint();
 		table.vkCmdDrawIndirect(cmd, buffer.get_buffer(), offset, draw_count, stride);
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, draw call will be dropped.\n");
 }
 
@@ -2098,14 +2149,14 @@ void CommandBuffer::draw_multi_indirect(const Buffer &buffer, uint32_t offset, u
 		return;
 	}
 
-	if (flush_render_state(true))
+	if (flush_draw_state())
 	{
 		set_backtrace_checkpoint();
 		table.vkCmdDrawIndirectCountKHR(cmd, buffer.get_buffer(), offset,
 		                                count.get_buffer(), count_offset,
 		                                draw_count, stride);
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, draw call will be dropped.\n");
 }
 
@@ -2119,14 +2170,14 @@ void CommandBuffer::draw_indexed_multi_indirect(const Buffer &buffer, uint32_t o
 		return;
 	}
 
-	if (flush_render_state(true))
+	if (flush_draw_state())
 	{
 		set_backtrace_checkpoint();
 		table.vkCmdDrawIndexedIndirectCountKHR(cmd, buffer.get_buffer(), offset,
 		                                       count.get_buffer(), count_offset,
 		                                       draw_count, stride);
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, draw call will be dropped.\n");
 }
 
@@ -2134,36 +2185,73 @@ void CommandBuffer::draw_indexed_indirect(const Vulkan::Buffer &buffer,
                                           uint32_t offset, uint32_t draw_count, uint32_t stride)
 {
 	VK_ASSERT(!is_compute);
-	if (flush_render_state(true))
+	if (flush_draw_state())
 	{
 		table.vkCmdDrawIndexedIndirect(cmd, buffer.get_buffer(), offset, draw_count, stride);
 		set_backtrace_checkpoint();
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, draw call will be dropped.\n");
 }
 
+VkDrawIndexedIndirectCommand *CommandBuffer::draw_indexed_indirect_allocated(uint32_t draw_count)
+{
+	VK_ASSERT(!is_compute);
+	VK_ASSERT(draw_count <= 1 || get_device().get_device_features().enabled_features.multiDrawIndirect);
+
+	VkDeviceSize size = draw_count * sizeof(VkDrawIndexedIndirectCommand);
+	auto data = indirect_block.allocate(size);
+	if (!data.host)
+	{
+		device->request_indirect_block(indirect_block, size);
+		data = indirect_block.allocate(size);
+	}
+
+	draw_indexed_indirect(*indirect_block.gpu, uint32_t(data.offset), draw_count,
+	                      sizeof(VkDrawIndexedIndirectCommand));
+	return reinterpret_cast<VkDrawIndexedIndirectCommand *>(data.host);
+}
+
 void CommandBuffer::dispatch_indirect(const Buffer &buffer, uint32_t offset)
 {
 	VK_ASSERT(is_compute);
-	if (flush_compute_state(true))
+	if (flush_dispatch_state())
 	{
 		set_backtrace_checkpoint();
 		table.vkCmdDispatchIndirect(cmd, buffer.get_buffer(), offset);
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, dispatch will be dropped.\n");
 }
 
+void CommandBuffer::begin_conditional_rendering(const Buffer &buffer, VkDeviceSize offset, bool inverted)
+{
+	if (!device->get_device_features().conditional_rendering_features.conditionalRendering)
+		return;
+
+	VkConditionalRenderingBeginInfoEXT info = { VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT };
+	info.buffer = buffer.get_buffer();
+	info.offset = offset;
+	info.flags = inverted ? VK_CONDITIONAL_RENDERING_INVERTED_BIT_EXT : 0;
+	table.vkCmdBeginConditionalRenderingEXT(cmd, &info);
+}
+
+void CommandBuffer::end_conditional_rendering()
+{
+	if (!device->get_device_features().conditional_rendering_features.conditionalRendering)
+		return;
+	table.vkCmdEndConditionalRenderingEXT(cmd);
+}
+
 void CommandBuffer::dispatch(uint32_t groups_x, uint32_t groups_y, uint32_t groups_z)
 {
 	VK_ASSERT(is_compute);
-	if (flush_compute_state(true))
+	if (flush_dispatch_state())
 	{
 		set_backtrace_checkpoint();
 		table.vkCmdDispatch(cmd, groups_x, groups_y, groups_z);
 	}
-	else
+	else if (!allow_async_compile)
 		LOGE("Failed to flush render state, dispatch will be dropped.\n");
 }
 
@@ -2176,6 +2264,7 @@ void CommandBuffer::clear_render_state()
 
 void CommandBuffer::set_opaque_state()
 {
+	auto saved_state = pipeline_state.static_state.state;
 	clear_render_state();
 	auto &state = pipeline_state.static_state.state;
 	state.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
@@ -2189,11 +2278,13 @@ void CommandBuffer::set_opaque_state()
 	state.stencil_test = false;
 	state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	state.write_mask = ~0u;
-	set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
+	if (memcmp(&saved_state, &state, sizeof(state)) != 0)
+		set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
 }
 
 void CommandBuffer::set_quad_state()
 {
+	auto saved_state = pipeline_state.static_state.state;
 	clear_render_state();
 	auto &state = pipeline_state.static_state.state;
 	state.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
@@ -2203,11 +2294,13 @@ void CommandBuffer::set_quad_state()
 	state.depth_write = false;
 	state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
 	state.write_mask = ~0u;
-	set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
+	if (memcmp(&saved_state, &state, sizeof(state)) != 0)
+		set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
 }
 
 void CommandBuffer::set_opaque_sprite_state()
 {
+	auto saved_state = pipeline_state.static_state.state;
 	clear_render_state();
 	auto &state = pipeline_state.static_state.state;
 	state.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
@@ -2218,11 +2311,13 @@ void CommandBuffer::set_opaque_sprite_state()
 	state.depth_write = true;
 	state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
 	state.write_mask = ~0u;
-	set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
+	if (memcmp(&saved_state, &state, sizeof(state)) != 0)
+		set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
 }
 
 void CommandBuffer::set_transparent_sprite_state()
 {
+	auto saved_state = pipeline_state.static_state.state;
 	clear_render_state();
 	auto &state = pipeline_state.static_state.state;
 	state.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
@@ -2240,7 +2335,8 @@ void CommandBuffer::set_transparent_sprite_state()
 	                  VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA);
 	set_blend_op(VK_BLEND_OP_ADD);
 
-	set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
+	if (memcmp(&saved_state, &state, sizeof(state)) != 0)
+		set_dirty(COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT);
 }
 
 void CommandBuffer::restore_state(const CommandBufferSavedState &state)
@@ -2365,6 +2461,7 @@ void CommandBuffer::set_backtrace_checkpoint()
 void CommandBuffer::end()
 {
 	VK_ASSERT(!debug_channel_buffer);
+	VK_ASSERT(!aggregate_channel_buffer);
 
 	if (table.vkEndCommandBuffer(cmd) != VK_SUCCESS)
 		LOGE("Failed to end command buffer.\n");
@@ -2377,6 +2474,8 @@ void CommandBuffer::end()
 		device->request_uniform_block_nolock(ubo_block, 0);
 	if (staging_block.mapped)
 		device->request_staging_block_nolock(staging_block, 0);
+	if (indirect_block.mapped)
+		device->request_indirect_block_nolock(indirect_block, 0);
 }
 
 void CommandBuffer::begin_region(const char *name, const float *color)
@@ -2484,6 +2583,52 @@ void CommandBuffer::end_debug_channel()
 	debug_channel_interface = nullptr;
 }
 
+void CommandBuffer::begin_aggregate_channel(DebugChannelInterface *iface, const char *tag, VkDeviceSize size)
+{
+	if (aggregate_channel_buffer)
+		end_aggregate_channel();
+
+	aggregate_channel_tag = tag;
+	aggregate_channel_interface = iface;
+
+	BufferCreateInfo info = {};
+	info.size = size;
+	info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	info.domain = BufferDomain::Device;
+	aggregate_channel_buffer = device->create_buffer(info);
+
+	fill_buffer(*aggregate_channel_buffer, 0);
+	barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+	        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	set_storage_buffer(VULKAN_NUM_DESCRIPTOR_SETS - 1, VULKAN_NUM_BINDINGS - 2, *aggregate_channel_buffer);
+}
+
+void CommandBuffer::end_aggregate_channel()
+{
+	if (!aggregate_channel_buffer)
+		return;
+
+	BufferCreateInfo info = {};
+	info.size = aggregate_channel_buffer->get_create_info().size;
+	info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.domain = BufferDomain::CachedHost;
+	auto aggregate_channel_readback = device->create_buffer(info);
+	barrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	copy_buffer(*aggregate_channel_readback, *aggregate_channel_buffer);
+	barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+	aggregate_channel_buffer.reset();
+	device->add_debug_channel_buffer(aggregate_channel_interface, std::move(aggregate_channel_tag),
+	                                 std::move(aggregate_channel_readback), true);
+	aggregate_channel_readback = {};
+	aggregate_channel_tag = {};
+	aggregate_channel_interface = nullptr;
+}
+
 #ifdef GRANITE_VULKAN_FILESYSTEM
 void CommandBufferUtil::set_quad_vertex_state(CommandBuffer &cmd)
 {
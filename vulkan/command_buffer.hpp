@@ -408,6 +408,21 @@ public:
 	                                 const Buffer &count, uint32_t count_offset);
 	void dispatch_indirect(const Buffer &buffer, uint32_t offset);
 
+	// Wraps VK_EXT_conditional_rendering. Draws, dispatches and attachment
+	// clears recorded between begin and end are discarded by the GPU when the
+	// 32-bit predicate at offset in buffer is zero (non-zero with inverted).
+	// No-ops when the extension is unavailable, so gated passes degrade to
+	// running unconditionally.
+	void begin_conditional_rendering(const Buffer &buffer, VkDeviceSize offset = 0, bool inverted = false);
+	void end_conditional_rendering();
+
+	// Issues vkCmdDrawIndexedIndirect over draw_count tightly packed commands
+	// allocated from the per-frame indirect buffer pool and returns the host
+	// pointer to fill in. The commands may be written any time before the
+	// command buffer is submitted. draw_count > 1 requires the
+	// multiDrawIndirect feature.
+	VkDrawIndexedIndirectCommand *draw_indexed_indirect_allocated(uint32_t draw_count);
+
 	void set_opaque_state();
 	void set_quad_state();
 	void set_opaque_sprite_state();
@@ -650,12 +665,30 @@ public:
 	void begin_debug_channel(DebugChannelInterface *iface, const char *tag, VkDeviceSize size);
 	void end_debug_channel();
 
+	// Structured aggregate telemetry. Binds a zero-initialized counter table
+	// SSBO at set 7, binding 14 (see assets/shaders/inc/telemetry_channel.h);
+	// shaders bump fixed counter slots with atomics (overdraw, cluster
+	// occupancy, LOD histograms). The table is read back stall-free through
+	// the same frame-context aging as the debug channel and delivered to
+	// DebugChannelInterface::aggregate().
+	void begin_aggregate_channel(DebugChannelInterface *iface, const char *tag, VkDeviceSize size);
+	void end_aggregate_channel();
+
 	void extract_pipeline_state(DeferredPipelineCompile &compile) const;
 	static VkPipeline build_graphics_pipeline(Device *device, const DeferredPipelineCompile &compile);
 	static VkPipeline build_compute_pipeline(Device *device, const DeferredPipelineCompile &compile);
 
 	bool flush_pipeline_state_without_blocking();
 
+	// When enabled, draws and dispatches which would have to compile a new pipeline
+	// are dropped instead. The compile is kicked to a ThreadGroup worker and the
+	// draw will come through in a later frame once the pipeline is in the cache.
+	// Only useful with GRANITE_VULKAN_MT, otherwise draws compile synchronously as normal.
+	void set_allow_async_compile(bool enable)
+	{
+		allow_async_compile = enable;
+	}
+
 private:
 	friend class Util::ObjectPool<CommandBuffer>;
 	CommandBuffer(Device *device, VkCommandBuffer cmd, VkPipelineCache cache, Type type);
@@ -692,9 +725,21 @@ private:
 	bool uses_swapchain = false;
 	bool is_compute = true;
 	bool is_secondary = false;
+	bool allow_async_compile = false;
+
+	// Generation counter over every input which feeds the pipeline hash.
+	// flush_graphics_pipeline / flush_compute_pipeline skip rehashing when the
+	// counter matches the last hashed generation, so redundant invalidations
+	// between consecutive draws stay hash-free.
+	uint64_t pipeline_state_generation = 1;
+	uint64_t hashed_pipeline_state_generation = 0;
 
 	void set_dirty(CommandBufferDirtyFlags flags)
 	{
+		if (flags & (COMMAND_BUFFER_DIRTY_STATIC_STATE_BIT |
+		             COMMAND_BUFFER_DIRTY_PIPELINE_BIT |
+		             COMMAND_BUFFER_DIRTY_STATIC_VERTEX_BIT))
+			pipeline_state_generation++;
 		dirty |= flags;
 	}
 
@@ -714,6 +759,8 @@ private:
 
 	bool flush_render_state(bool synchronous);
 	bool flush_compute_state(bool synchronous);
+	bool flush_draw_state();
+	bool flush_dispatch_state();
 	void clear_render_state();
 
 	bool flush_graphics_pipeline(bool synchronous);
@@ -729,6 +776,7 @@ private:
 	BufferBlock ibo_block;
 	BufferBlock ubo_block;
 	BufferBlock staging_block;
+	BufferBlock indirect_block;
 
 	void set_texture(unsigned set, unsigned binding, VkImageView float_view, VkImageView integer_view,
 	                 VkImageLayout layout,
@@ -740,6 +788,9 @@ private:
 	std::string debug_channel_tag;
 	Vulkan::BufferHandle debug_channel_buffer;
 	DebugChannelInterface *debug_channel_interface = nullptr;
+	std::string aggregate_channel_tag;
+	Vulkan::BufferHandle aggregate_channel_buffer;
+	DebugChannelInterface *aggregate_channel_interface = nullptr;
 
 	static void update_hash_graphics_pipeline(DeferredPipelineCompile &compile, uint32_t &active_vbos);
 	static void update_hash_compute_pipeline(DeferredPipelineCompile &compile);
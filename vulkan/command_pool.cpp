@@ -56,6 +56,12 @@ CommandPool &CommandPool::operator=(CommandPool &&other) noexcept
 		std::swap(buffers, other.buffers);
 		index = other.index;
 		other.index = 0;
+		peak_index = other.peak_index;
+		other.peak_index = 0;
+		peak_secondary_index = other.peak_secondary_index;
+		other.peak_secondary_index = 0;
+		trim_countdown = other.trim_countdown;
+		other.trim_countdown = TrimFrameInterval;
 #ifdef VULKAN_DEBUG
 		in_flight.clear();
 		std::swap(in_flight, other.in_flight);
@@ -144,13 +150,49 @@ VkCommandBuffer CommandPool::request_command_buffer()
 	}
 }
 
+void CommandPool::trim()
+{
+	// Only called from begin() where nothing is in flight, so the tail buffers
+	// beyond the observed peak can be freed safely.
+	table->vkResetCommandPool(device->get_device(), pool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+
+	if (peak_index < buffers.size())
+	{
+		table->vkFreeCommandBuffers(device->get_device(), pool,
+		                            buffers.size() - peak_index, buffers.data() + peak_index);
+		buffers.resize(peak_index);
+	}
+
+	if (peak_secondary_index < secondary_buffers.size())
+	{
+		table->vkFreeCommandBuffers(device->get_device(), pool,
+		                            secondary_buffers.size() - peak_secondary_index,
+		                            secondary_buffers.data() + peak_secondary_index);
+		secondary_buffers.resize(peak_secondary_index);
+	}
+
+	peak_index = 0;
+	peak_secondary_index = 0;
+}
+
 void CommandPool::begin()
 {
 #ifdef VULKAN_DEBUG
 	VK_ASSERT(in_flight.empty());
 #endif
-	if (index > 0 || secondary_index > 0)
+	if (index > peak_index)
+		peak_index = index;
+	if (secondary_index > peak_secondary_index)
+		peak_secondary_index = secondary_index;
+
+	if (--trim_countdown == 0)
+	{
+		trim();
+		trim_countdown = TrimFrameInterval;
+	}
+	else if (index > 0 || secondary_index > 0)
 		table->vkResetCommandPool(device->get_device(), pool, 0);
+
 	index = 0;
 	secondary_index = 0;
 }
@@ -45,7 +45,19 @@ public:
 	VkCommandBuffer request_secondary_command_buffer();
 	void signal_submitted(VkCommandBuffer cmd);
 
+	// Command buffers currently retained by the pool, counting both
+	// primary and secondary.
+	unsigned get_allocated_count() const
+	{
+		return unsigned(buffers.size() + secondary_buffers.size());
+	}
+
 private:
+	// Periodically frees command buffers which have not been used for
+	// TrimFrameInterval frames, so spike frames don't pin memory forever.
+	enum { TrimFrameInterval = 64 };
+	void trim();
+
 	Device *device;
 	const VolkDeviceTable *table;
 	VkCommandPool pool = VK_NULL_HANDLE;
@@ -56,5 +68,8 @@ private:
 #endif
 	unsigned index = 0;
 	unsigned secondary_index = 0;
+	unsigned peak_index = 0;
+	unsigned peak_secondary_index = 0;
+	unsigned trim_countdown = TrimFrameInterval;
 };
 }
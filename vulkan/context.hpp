@@ -57,6 +57,7 @@ struct DeviceFeatures
 	bool supports_draw_parameters = false;
 	bool supports_driver_properties = false;
 	bool supports_calibrated_timestamps = false;
+	bool supports_memory_budget = false;
 	VkPhysicalDeviceSubgroupProperties subgroup_properties = {};
 	VkPhysicalDevice8BitStorageFeaturesKHR storage_8bit_features = {};
 	VkPhysicalDevice16BitStorageFeaturesKHR storage_16bit_features = {};
@@ -78,6 +79,7 @@ struct DeviceFeatures
 	VkPhysicalDeviceConservativeRasterizationPropertiesEXT conservative_rasterization_properties = {};
 	VkPhysicalDevicePerformanceQueryFeaturesKHR performance_query_features = {};
 	VkPhysicalDeviceSamplerYcbcrConversionFeaturesKHR sampler_ycbcr_conversion_features = {};
+	VkPhysicalDeviceConditionalRenderingFeaturesEXT conditional_rendering_features = {};
 	VkPhysicalDeviceDriverPropertiesKHR driver_properties = {};
 };
 
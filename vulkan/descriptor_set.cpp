@@ -244,10 +244,7 @@ VkDescriptorPool DescriptorSetAllocator::allocate_bindless_pool(unsigned num_set
 void DescriptorSetAllocator::begin_frame()
 {
 	if (!bindless)
-	{
-		for (auto &thr : per_thread)
-			thr->should_begin = true;
-	}
+		frame_counter.fetch_add(1, std::memory_order_relaxed);
 }
 
 pair<VkDescriptorSet, bool> DescriptorSetAllocator::find(unsigned thread_index, Hash hash)
@@ -255,10 +252,11 @@ pair<VkDescriptorSet, bool> DescriptorSetAllocator::find(unsigned thread_index,
 	VK_ASSERT(!bindless);
 
 	auto &state = *per_thread[thread_index];
-	if (state.should_begin)
+	uint64_t current_frame = frame_counter.load(std::memory_order_relaxed);
+	if (state.frame_cookie != current_frame)
 	{
 		state.set_nodes.begin_frame();
-		state.should_begin = false;
+		state.frame_cookie = current_frame;
 	}
 
 	auto *node = state.set_nodes.request(hash);
@@ -28,6 +28,7 @@
 #include "vulkan_headers.hpp"
 #include "sampler.hpp"
 #include "limits.hpp"
+#include <atomic>
 #include <utility>
 #include <vector>
 #include "cookie.hpp"
@@ -132,6 +133,16 @@ public:
 		return set_layout;
 	}
 
+	// Descriptor pools allocated across all threads. Only meaningful to call
+	// from the frame boundary when workers are quiesced.
+	size_t get_allocated_pool_count() const
+	{
+		size_t count = 0;
+		for (auto &thread : per_thread)
+			count += thread->pools.size();
+		return count;
+	}
+
 	void clear();
 
 	bool is_bindless() const
@@ -161,9 +172,13 @@ private:
 	{
 		Util::TemporaryHashmap<DescriptorSetNode, VULKAN_DESCRIPTOR_RING_SIZE, true> set_nodes;
 		std::vector<VkDescriptorPool> pools;
-		bool should_begin = true;
+		uint64_t frame_cookie = 0;
 	};
 	std::vector<std::unique_ptr<PerThread>> per_thread;
+	// Bumped on frame boundaries. Threads observe the new value lazily in
+	// find() and recycle their ring, so begin_frame() never has to touch
+	// per-thread state.
+	std::atomic<uint64_t> frame_counter{1};
 	std::vector<VkDescriptorPoolSize> pool_size;
 	bool bindless = false;
 };
@@ -39,6 +39,8 @@
 #endif
 
 #ifdef GRANITE_VULKAN_MT
+#include "thread_group.hpp"
+#include "global_managers.hpp"
 #include "thread_id.hpp"
 static unsigned get_thread_index()
 {
@@ -739,6 +741,16 @@ void Device::set_context(const Context &context)
 	managers.staging.init(this, 64 * 1024, std::max<VkDeviceSize>(16u, gpu_props.limits.optimalBufferCopyOffsetAlignment),
 	                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 	                      false);
+	managers.indirect.init(this, 4 * 1024, 16, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+	                       ImplementationQuirks::get().staging_need_device_local);
+
+	// Let the streaming pools grow towards previous-frame high-water marks, so heavy
+	// procedural streaming settles into one large persistently mapped block per frame.
+	managers.vbo.set_max_retained_block_size(4 * 1024 * 1024);
+	managers.ibo.set_max_retained_block_size(4 * 1024 * 1024);
+	managers.ubo.set_max_retained_block_size(2 * 1024 * 1024);
+	managers.staging.set_max_retained_block_size(16 * 1024 * 1024);
+	managers.indirect.set_max_retained_block_size(1 * 1024 * 1024);
 
 	graphics.performance_query_pool.init_device(this, graphics_queue_family_index);
 	if (graphics_queue_family_index != compute_queue_family_index)
@@ -988,6 +1000,17 @@ void Device::request_staging_block_nolock(BufferBlock &block, VkDeviceSize size)
 	request_block(*this, block, size, managers.staging, nullptr, frame().staging_blocks);
 }
 
+void Device::request_indirect_block(BufferBlock &block, VkDeviceSize size)
+{
+	LOCK();
+	request_indirect_block_nolock(block, size);
+}
+
+void Device::request_indirect_block_nolock(BufferBlock &block, VkDeviceSize size)
+{
+	request_block(*this, block, size, managers.indirect, &dma.indirect, frame().indirect_blocks);
+}
+
 void Device::submit(CommandBufferHandle &cmd, Fence *fence, unsigned semaphore_count, Semaphore *semaphores)
 {
 	cmd->end_debug_channel();
@@ -1251,7 +1274,7 @@ void Device::submit_empty_inner(CommandBuffer::Type type, InternalFence *fence,
 		fence->fence = cleared_fence;
 
 	QueryPoolHandle start_ts, end_ts;
-	if (json_timestamp_origin)
+	if (timeline_trace_file)
 		start_ts = write_calibrated_timestamp_nolock();
 
 	if (queue_lock_callback)
@@ -1267,7 +1290,7 @@ void Device::submit_empty_inner(CommandBuffer::Type type, InternalFence *fence,
 	if (queue_unlock_callback)
 		queue_unlock_callback();
 
-	if (json_timestamp_origin)
+	if (timeline_trace_file)
 	{
 		end_ts = write_calibrated_timestamp_nolock();
 		register_time_interval_nolock("CPU", std::move(start_ts), std::move(end_ts), "submit", "");
@@ -1403,6 +1426,12 @@ void Device::submit_staging(CommandBufferHandle &cmd, VkBufferUsageFlags usage,
 	}
 }
 
+// Command buffers handed to submit() are queued up per queue type and only
+// hit vkQueueSubmit here, in one batched call per flush. When timeline
+// semaphores are available, one timeline signal per batch replaces both the
+// per-submit fence and the binary semaphores handed out to callers; the
+// binary semaphore / FenceManager path below only remains as the fallback
+// for implementations without VK_KHR_timeline_semaphore.
 void Device::submit_queue(CommandBuffer::Type type, InternalFence *fence,
                           unsigned semaphore_count, Semaphore *semaphores, int profiling_iteration)
 {
@@ -1647,7 +1676,7 @@ void Device::submit_queue(CommandBuffer::Type type, InternalFence *fence,
 	}
 
 	QueryPoolHandle start_ts, end_ts;
-	if (json_timestamp_origin)
+	if (timeline_trace_file)
 		start_ts = write_calibrated_timestamp_nolock();
 
 	if (queue_lock_callback)
@@ -1662,7 +1691,7 @@ void Device::submit_queue(CommandBuffer::Type type, InternalFence *fence,
 	if (queue_unlock_callback)
 		queue_unlock_callback();
 
-	if (json_timestamp_origin)
+	if (timeline_trace_file)
 	{
 		end_ts = write_calibrated_timestamp_nolock();
 		register_time_interval_nolock("CPU", std::move(start_ts), std::move(end_ts), "submit", "");
@@ -1724,7 +1753,7 @@ void Device::flush_frame(CommandBuffer::Type type)
 
 void Device::sync_buffer_blocks()
 {
-	if (dma.vbo.empty() && dma.ibo.empty() && dma.ubo.empty())
+	if (dma.vbo.empty() && dma.ibo.empty() && dma.ubo.empty() && dma.indirect.empty())
 		return;
 
 	VkBufferUsageFlags usage = 0;
@@ -1754,9 +1783,17 @@ void Device::sync_buffer_blocks()
 		usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
 	}
 
+	for (auto &block : dma.indirect)
+	{
+		VK_ASSERT(block.offset != 0);
+		cmd->copy_buffer(*block.gpu, 0, *block.cpu, 0, block.offset);
+		usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	}
+
 	dma.vbo.clear();
 	dma.ibo.clear();
 	dma.ubo.clear();
+	dma.indirect.clear();
 
 	cmd->end_region();
 
@@ -1980,6 +2017,27 @@ void Device::submit_secondary(CommandBuffer &primary, CommandBuffer &secondary)
 	table->vkCmdExecuteCommands(primary.get_command_buffer(), 1, &secondary_cmd);
 }
 
+#ifdef GRANITE_VULKAN_MT
+void Device::request_async_pipeline_compile(const DeferredPipelineCompile &compile, bool is_graphics)
+{
+	{
+		std::lock_guard<std::mutex> holder{async_pipeline_lock};
+		if (!async_pending_pipelines.insert(compile.hash).second)
+			return;
+	}
+
+	Granite::Global::thread_group()->create_task([this, compile, is_graphics]() {
+		if (is_graphics)
+			CommandBuffer::build_graphics_pipeline(this, compile);
+		else
+			CommandBuffer::build_compute_pipeline(this, compile);
+
+		std::lock_guard<std::mutex> holder{async_pipeline_lock};
+		async_pending_pipelines.erase(compile.hash);
+	});
+}
+#endif
+
 CommandBufferHandle Device::request_secondary_command_buffer_for_thread(unsigned thread_index,
                                                                         const Framebuffer *framebuffer,
                                                                         unsigned subpass,
@@ -2040,6 +2098,11 @@ Device::~Device()
 {
 	wait_idle();
 
+#ifdef GRANITE_VULKAN_FOSSILIZE
+	// Worker threads may still be replaying pipelines against this device.
+	wait_pipeline_state_replay();
+#endif
+
 	managers.timestamps.log_simple();
 
 	wsi.acquire.reset();
@@ -2427,12 +2490,14 @@ void Device::wait_idle_nolock()
 	managers.ubo.reset();
 	managers.ibo.reset();
 	managers.staging.reset();
+	managers.indirect.reset();
 	for (auto &frame : per_frame)
 	{
 		frame->vbo_blocks.clear();
 		frame->ibo_blocks.clear();
 		frame->ubo_blocks.clear();
 		frame->staging_blocks.clear();
+		frame->indirect_blocks.clear();
 	}
 
 	framebuffer_allocator.clear();
@@ -2448,33 +2513,147 @@ void Device::wait_idle_nolock()
 	}
 }
 
+void Device::execute_teardown(PerFrame::Teardown &teardown)
+{
+	for (auto &framebuffer : teardown.framebuffers)
+		table->vkDestroyFramebuffer(device, framebuffer, nullptr);
+	for (auto &sampler : teardown.samplers)
+		table->vkDestroySampler(device, sampler, nullptr);
+	for (auto &pipeline : teardown.pipelines)
+		table->vkDestroyPipeline(device, pipeline, nullptr);
+	for (auto &view : teardown.image_views)
+		table->vkDestroyImageView(device, view, nullptr);
+	for (auto &view : teardown.buffer_views)
+		table->vkDestroyBufferView(device, view, nullptr);
+	for (auto &image : teardown.images)
+		table->vkDestroyImage(device, image, nullptr);
+	for (auto &buffer : teardown.buffers)
+		table->vkDestroyBuffer(device, buffer, nullptr);
+	for (auto &semaphore : teardown.semaphores)
+		table->vkDestroySemaphore(device, semaphore, nullptr);
+	for (auto &pool : teardown.descriptor_pools)
+		table->vkDestroyDescriptorPool(device, pool, nullptr);
+
+	// Group frees by memory type so the allocator's per-type locks and free
+	// lists are hit in runs rather than ping-ponged on streaming-heavy frames.
+	sort(begin(teardown.allocations), end(teardown.allocations),
+	     [](const DeviceAllocation &a, const DeviceAllocation &b) {
+		     return a.memory_type < b.memory_type;
+	     });
+	for (auto &alloc : teardown.allocations)
+		alloc.free_immediate(managers.memory);
+}
+
+void Device::report_frame_telemetry_nolock()
+{
+	uint64_t descriptor_pools = 0;
+	for (auto &allocator : descriptor_set_allocators)
+		descriptor_pools += allocator.get_allocated_pool_count();
+
+	uint64_t command_buffers = 0;
+	for (auto &f : per_frame)
+	{
+		for (auto &pool : f->graphics_cmd_pool)
+			command_buffers += pool.get_allocated_count();
+		for (auto &pool : f->compute_cmd_pool)
+			command_buffers += pool.get_allocated_count();
+		for (auto &pool : f->transfer_cmd_pool)
+			command_buffers += pool.get_allocated_count();
+	}
+
+	const struct
+	{
+		const char *name;
+		uint64_t value;
+	} counters[NumPoolTelemetryCounters] = {
+		{ "vbo-frame-bytes", managers.vbo.get_frame_usage() },
+		{ "ibo-frame-bytes", managers.ibo.get_frame_usage() },
+		{ "ubo-frame-bytes", managers.ubo.get_frame_usage() },
+		{ "staging-frame-bytes", managers.staging.get_frame_usage() },
+		{ "indirect-frame-bytes", managers.indirect.get_frame_usage() },
+		{ "buffer-pool-retained-bytes",
+		  managers.vbo.get_retained_size() + managers.ibo.get_retained_size() +
+		  managers.ubo.get_retained_size() + managers.staging.get_retained_size() +
+		  managers.indirect.get_retained_size() },
+		{ "descriptor-pools", descriptor_pools },
+		{ "command-buffers", command_buffers },
+	};
+
+	for (unsigned i = 0; i < NumPoolTelemetryCounters; i++)
+	{
+		if (timeline_trace_file)
+			timeline_trace_file->push_counter(counters[i].name, counters[i].value);
+
+		// Watermark delta: when an hour-long session slowly leaks frame
+		// memory, this names the subsystem which grew and by how much.
+		if (counters[i].value > pool_watermarks[i])
+		{
+			if (pool_watermarks[i] != 0)
+			{
+				LOGI("Pool watermark: %s grew %llu -> %llu.\n", counters[i].name,
+				     static_cast<unsigned long long>(pool_watermarks[i]),
+				     static_cast<unsigned long long>(counters[i].value));
+			}
+			pool_watermarks[i] = counters[i].value;
+		}
+	}
+}
+
 void Device::next_frame_context()
 {
-	DRAIN_FRAME_LOCK();
+	PerFrame::Teardown teardown;
 
-	if (frame_context_begin_ts)
 	{
-		auto frame_context_end_ts = write_calibrated_timestamp_nolock();
-		register_time_interval_nolock("CPU", std::move(frame_context_begin_ts), std::move(frame_context_end_ts), "command submissions", "");
-		frame_context_begin_ts = {};
-	}
+		DRAIN_FRAME_LOCK();
 
-	// Flush the frame here as we might have pending staging command buffers from init stage.
-	end_frame_nolock();
+		if (frame_context_begin_ts)
+		{
+			auto frame_context_end_ts = write_calibrated_timestamp_nolock();
+			register_time_interval_nolock("CPU", std::move(frame_context_begin_ts), std::move(frame_context_end_ts), "command submissions", "");
+			frame_context_begin_ts = {};
+		}
 
-	framebuffer_allocator.begin_frame();
-	transient_allocator.begin_frame();
-	for (auto &allocator : descriptor_set_allocators)
-		allocator.begin_frame();
+		// Flush the frame here as we might have pending staging command buffers from init stage.
+		end_frame_nolock();
+
+#ifdef GRANITE_VULKAN_SHADER_MANAGER_RUNTIME_COMPILER
+		// Drain batched hot-reload recompiles here so all reloaded pipelines swap in together
+		// at the frame boundary rather than mid-frame as notifications trickle in.
+		shader_manager.recompile_pending_shaders();
+#endif
+
+		report_frame_telemetry_nolock();
+
+		framebuffer_allocator.begin_frame();
+		transient_allocator.begin_frame();
+		for (auto &allocator : descriptor_set_allocators)
+			allocator.begin_frame();
+
+		managers.vbo.begin_frame();
+		managers.ibo.begin_frame();
+		managers.ubo.begin_frame();
+		managers.staging.begin_frame();
+		managers.indirect.begin_frame();
+		managers.memory.begin_frame_context();
+
+		VK_ASSERT(!per_frame.empty());
+		frame_context_index++;
+		if (frame_context_index >= per_frame.size())
+			frame_context_index = 0;
+
+		frame().begin(&teardown);
+		recalibrate_timestamps();
+		frame_context_begin_ts = write_calibrated_timestamp_nolock();
+	}
 
-	VK_ASSERT(!per_frame.empty());
-	frame_context_index++;
-	if (frame_context_index >= per_frame.size())
-		frame_context_index = 0;
+	// Execute the drained destruction batch outside the lock so submission and
+	// streaming threads aren't serialized against heavy teardown frames.
+	execute_teardown(teardown);
+}
 
-	frame().begin();
-	recalibrate_timestamps();
-	frame_context_begin_ts = write_calibrated_timestamp_nolock();
+void Device::get_memory_budget(HeapBudget *budget)
+{
+	managers.memory.get_memory_budget(budget);
 }
 
 QueryPoolHandle Device::write_timestamp(VkCommandBuffer cmd, VkPipelineStageFlagBits stage)
@@ -2496,7 +2675,7 @@ QueryPoolHandle Device::write_calibrated_timestamp()
 
 QueryPoolHandle Device::write_calibrated_timestamp_nolock()
 {
-	if (!json_trace_file)
+	if (!timeline_trace_file)
 		return {};
 
 	auto handle = QueryPoolHandle(handle_pool.query.allocate(this));
@@ -2613,7 +2792,7 @@ bool Device::resample_calibrated_timestamps()
 void Device::recalibrate_timestamps()
 {
 	// Don't bother recalibrating timestamps if we're not tracing.
-	if (!json_trace_file)
+	if (!timeline_trace_file)
 		return;
 
 	// Recalibrate every once in a while ...
@@ -2674,12 +2853,12 @@ void Device::decrement_frame_counter_nolock()
 #endif
 }
 
-void Device::PerFrame::begin()
+void Device::PerFrame::begin(Teardown *out_teardown)
 {
 	VkDevice vkdevice = device.get_device();
 
 	Vulkan::QueryPoolHandle wait_fence_ts;
-	if (!in_destructor && device.json_timestamp_origin)
+	if (!in_destructor && device.timeline_trace_file)
 		wait_fence_ts = device.write_calibrated_timestamp_nolock();
 
 	if (device.get_device_features().timeline_semaphore_features.timelineSemaphore &&
@@ -2721,7 +2900,7 @@ void Device::PerFrame::begin()
 		wait_fences.clear();
 	}
 
-	if (!in_destructor && device.json_timestamp_origin)
+	if (!in_destructor && device.timeline_trace_file)
 		device.register_time_interval_nolock("CPU", std::move(wait_fence_ts), device.write_calibrated_timestamp_nolock(), "fence", "");
 
 	// If we're using timeline semaphores, these paths should never be hit.
@@ -2751,24 +2930,21 @@ void Device::PerFrame::begin()
 	// Free the debug channel buffers here, and they will immediately be recycled by the destroyed_buffers right below.
 	debug_channels.clear();
 
-	for (auto &framebuffer : destroyed_framebuffers)
-		table.vkDestroyFramebuffer(vkdevice, framebuffer, nullptr);
-	for (auto &sampler : destroyed_samplers)
-		table.vkDestroySampler(vkdevice, sampler, nullptr);
-	for (auto &pipeline : destroyed_pipelines)
-		table.vkDestroyPipeline(vkdevice, pipeline, nullptr);
-	for (auto &view : destroyed_image_views)
-		table.vkDestroyImageView(vkdevice, view, nullptr);
-	for (auto &view : destroyed_buffer_views)
-		table.vkDestroyBufferView(vkdevice, view, nullptr);
-	for (auto &image : destroyed_images)
-		table.vkDestroyImage(vkdevice, image, nullptr);
-	for (auto &buffer : destroyed_buffers)
-		table.vkDestroyBuffer(vkdevice, buffer, nullptr);
-	for (auto &semaphore : destroyed_semaphores)
-		table.vkDestroySemaphore(vkdevice, semaphore, nullptr);
-	for (auto &pool : destroyed_descriptor_pools)
-		table.vkDestroyDescriptorPool(vkdevice, pool, nullptr);
+	// Drain the destruction queues into a local batch. The vkDestroy calls and
+	// allocation frees don't need the device lock, so when the caller asks for
+	// the batch it can execute it after unlocking.
+	Teardown teardown;
+	teardown.framebuffers = std::move(destroyed_framebuffers);
+	teardown.samplers = std::move(destroyed_samplers);
+	teardown.pipelines = std::move(destroyed_pipelines);
+	teardown.image_views = std::move(destroyed_image_views);
+	teardown.buffer_views = std::move(destroyed_buffer_views);
+	teardown.images = std::move(destroyed_images);
+	teardown.buffers = std::move(destroyed_buffers);
+	teardown.semaphores = std::move(destroyed_semaphores);
+	teardown.descriptor_pools = std::move(destroyed_descriptor_pools);
+	teardown.allocations = std::move(allocations);
+
 	for (auto &semaphore : recycled_semaphores)
 	{
 #if defined(VULKAN_DEBUG) && defined(SUBMIT_DEBUG)
@@ -2778,8 +2954,11 @@ void Device::PerFrame::begin()
 	}
 	for (auto &event : recycled_events)
 		managers.event.recycle(event);
-	for (auto &alloc : allocations)
-		alloc.free_immediate(managers.memory);
+
+	if (out_teardown)
+		*out_teardown = std::move(teardown);
+	else
+		device.execute_teardown(teardown);
 
 	for (auto &block : vbo_blocks)
 		managers.vbo.recycle_block(move(block));
@@ -2789,10 +2968,13 @@ void Device::PerFrame::begin()
 		managers.ubo.recycle_block(move(block));
 	for (auto &block : staging_blocks)
 		managers.staging.recycle_block(move(block));
+	for (auto &block : indirect_blocks)
+		managers.indirect.recycle_block(move(block));
 	vbo_blocks.clear();
 	ibo_blocks.clear();
 	ubo_blocks.clear();
 	staging_blocks.clear();
+	indirect_blocks.clear();
 
 	destroyed_framebuffers.clear();
 	destroyed_samplers.clear();
@@ -2807,8 +2989,8 @@ void Device::PerFrame::begin()
 	recycled_events.clear();
 	allocations.clear();
 
-	int64_t min_timestamp_us = std::numeric_limits<int64_t>::max();
-	int64_t max_timestamp_us = 0;
+	int64_t min_timestamp_ns = std::numeric_limits<int64_t>::max();
+	int64_t max_timestamp_ns = 0;
 
 	for (auto &ts : timestamp_intervals)
 	{
@@ -2819,10 +3001,10 @@ void Device::PerFrame::begin()
 			device.write_json_timestamp_range(frame_index, ts.tid.c_str(), ts.timestamp_tag->get_tag().c_str(),
 			                                  ts.extra.c_str(),
 			                                  ts.start_ts->get_timestamp_ticks(), ts.end_ts->get_timestamp_ticks(),
-			                                  min_timestamp_us, max_timestamp_us);
+			                                  min_timestamp_ns, max_timestamp_ns);
 		}
 	}
-	device.write_json_timestamp_range_us(frame_index, "CPU + GPU", "full frame lifetime", min_timestamp_us, max_timestamp_us);
+	device.write_json_timestamp_range_ns(frame_index, "CPU + GPU", "full frame lifetime", min_timestamp_ns, max_timestamp_ns);
 	managers.timestamps.mark_end_of_frame_context();
 	timestamp_intervals.clear();
 }
@@ -3898,6 +4080,10 @@ ImageHandle Device::create_image_from_staging_buffer(const ImageCreateInfo &crea
 	}
 
 	// Copy initial data to texture.
+	// The copy itself runs on the dedicated transfer queue when there is one,
+	// so large uploads overlap rendering; the graphics queue only picks up a
+	// semaphore wait (plus an ownership acquire barrier and optional mipgen)
+	// and stalls at the consuming stages, not at submit.
 	if (staging_buffer)
 	{
 		VK_ASSERT(create_info.domain != ImageDomain::Transient);
@@ -4798,11 +4984,12 @@ bool Device::acquire_profiling()
 	return true;
 }
 
-void Device::add_debug_channel_buffer(DebugChannelInterface *iface, std::string tag, Vulkan::BufferHandle buffer)
+void Device::add_debug_channel_buffer(DebugChannelInterface *iface, std::string tag, Vulkan::BufferHandle buffer,
+                                      bool aggregate)
 {
 	buffer->set_internal_sync_object();
 	LOCK();
-	frame().debug_channels.push_back({ iface, std::move(tag), std::move(buffer) });
+	frame().debug_channels.push_back({ iface, std::move(tag), std::move(buffer), aggregate });
 }
 
 void Device::parse_debug_channel(const PerFrame::DebugChannel &channel)
@@ -4812,6 +4999,15 @@ void Device::parse_debug_channel(const PerFrame::DebugChannel &channel)
 
 	auto *words = static_cast<const DebugChannelInterface::Word *>(map_host_buffer(*channel.buffer, MEMORY_ACCESS_READ_BIT));
 
+	if (channel.aggregate)
+	{
+		// Aggregate channels are a flat counter table, no parsing required.
+		auto count = uint32_t(channel.buffer->get_create_info().size / sizeof(uint32_t));
+		channel.iface->aggregate(channel.tag, count, &words[0].u32);
+		unmap_host_buffer(*channel.buffer, MEMORY_ACCESS_READ_BIT);
+		return;
+	}
+
 	size_t size = channel.buffer->get_create_info().size;
 	if (size <= sizeof(uint32_t))
 	{
@@ -4862,76 +5058,56 @@ double Device::convert_timestamp_delta(uint64_t start_ticks, uint64_t end_ticks)
 	return double(int64_t(ticks_delta)) * gpu_props.limits.timestampPeriod * 1e-9;
 }
 
-uint64_t Device::update_wrapped_base_timestamp(uint64_t end_ticks)
-{
-	json_base_timestamp_value += convert_to_signed_delta(json_base_timestamp_value, end_ticks, timestamp_valid_bits);
-	return json_base_timestamp_value;
-}
-
 bool Device::init_timestamp_trace(const char *path)
 {
-	// Use the Chrome tracing format. It's trivial to emit and we get a frontend for free :)
-	json_trace_file.reset();
-	json_trace_file.reset(fopen(path, "w"));
-	if (json_trace_file)
-		fprintf(json_trace_file.get(), "[");
-	return bool(json_trace_file);
+	timeline_trace_file.reset();
+	timeline_trace_file.reset(new Util::TimelineTraceFile(path));
+	if (!timeline_trace_file->is_active())
+		timeline_trace_file.reset();
+	return bool(timeline_trace_file);
 }
 
-int64_t Device::convert_timestamp_to_absolute_usec(uint64_t ts)
+int64_t Device::convert_timestamp_to_absolute_nsec(uint64_t ts)
 {
-	// Ensure that we deal with timestamp wraparound correctly.
+	// Rebase GPU ticks onto CLOCK_MONOTONIC through the most recent
+	// calibration pair, so GPU ranges land on the same timeline as CPU zones.
+	// The signed delta deals with timestamp wraparound correctly.
 	// On some hardware, we have < 64 valid bits and the timestamp counters will wrap around at some interval.
-	// As long as timestamps come in at a reasonably steady pace, we can deal with wraparound cleanly.
-	ts = update_wrapped_base_timestamp(ts);
-	if (json_timestamp_origin == 0)
-		json_timestamp_origin = ts;
-
-	auto delta_ts = int64_t(ts - json_timestamp_origin);
-	auto us = int64_t(double(int64_t(delta_ts)) * gpu_props.limits.timestampPeriod * 1e-3);
-	return us;
+	// As long as we recalibrate at a reasonably steady pace, we can deal with wraparound cleanly.
+	int64_t ticks_delta = convert_to_signed_delta(calibrated_timestamp_device, ts, timestamp_valid_bits);
+	return calibrated_timestamp_host + int64_t(double(ticks_delta) * gpu_props.limits.timestampPeriod);
 }
 
 void Device::write_json_timestamp_range(unsigned frame_index, const char *tid,
                                         const char *name, const char *extra,
                                         uint64_t start_ts, uint64_t end_ts,
-                                        int64_t &min_us, int64_t &max_us)
+                                        int64_t &min_ns, int64_t &max_ns)
 {
-	if (!json_trace_file)
+	if (!timeline_trace_file)
 		return;
 
-	int64_t absolute_start = convert_timestamp_to_absolute_usec(start_ts);
-	int64_t absolute_end = convert_timestamp_to_absolute_usec(end_ts);
+	int64_t absolute_start = convert_timestamp_to_absolute_nsec(start_ts);
+	int64_t absolute_end = convert_timestamp_to_absolute_nsec(end_ts);
 
 	VK_ASSERT(absolute_start <= absolute_end);
 
-	min_us = std::min(absolute_start, min_us);
-	max_us = std::max(absolute_end, max_us);
+	min_ns = std::min(absolute_start, min_ns);
+	max_ns = std::max(absolute_end, max_ns);
 
-	fprintf(json_trace_file.get(), "\t{ \"name\": \"%s%s%s\", \"ph\": \"B\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %lld },\n",
-	        name, *extra != '\0' ? " " : "", extra, tid, frame_index, static_cast<long long>(absolute_start));
-	fprintf(json_trace_file.get(), "\t{ \"name\": \"%s%s%s\", \"ph\": \"E\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %lld },\n",
-	        name, *extra != '\0' ? " " : "", extra, tid, frame_index, static_cast<long long>(absolute_end));
+	char desc[64];
+	snprintf(desc, sizeof(desc), "%s%s%s", name, *extra != '\0' ? " " : "", extra);
+	timeline_trace_file->push_event(tid, desc, frame_index,
+	                                uint64_t(absolute_start), uint64_t(absolute_end));
 }
 
-void Device::write_json_timestamp_range_us(unsigned frame_index, const char *tid, const char *name, int64_t start_us, int64_t end_us)
+void Device::write_json_timestamp_range_ns(unsigned frame_index, const char *tid, const char *name, int64_t start_ns, int64_t end_ns)
 {
-	if (!json_trace_file)
+	if (!timeline_trace_file)
 		return;
-	if (start_us > end_us)
+	if (start_ns > end_ns)
 		return;
 
-	fprintf(json_trace_file.get(), "\t{ \"name\": \"%s\", \"ph\": \"B\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %lld },\n",
-	        name, tid, frame_index, static_cast<long long>(start_us));
-	fprintf(json_trace_file.get(), "\t{ \"name\": \"%s\", \"ph\": \"E\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %lld },\n",
-	        name, tid, frame_index, static_cast<long long>(end_us));
-}
-
-void Device::JSONTraceFileDeleter::operator()(FILE *file)
-{
-	// Intentionally truncate the JSON so that we can emit "," after the last element.
-	if (file)
-		fclose(file);
+	timeline_trace_file->push_event(tid, name, frame_index, uint64_t(start_ns), uint64_t(end_ns));
 }
 
 #ifdef GRANITE_VULKAN_FILESYSTEM
@@ -38,10 +38,12 @@
 #include "context.hpp"
 #include "query_pool.hpp"
 #include "buffer_pool.hpp"
+#include "timeline_trace_file.hpp"
 #include <memory>
 #include <vector>
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <stdio.h>
 
 #ifdef GRANITE_VULKAN_FILESYSTEM
@@ -106,6 +108,17 @@ public:
 	};
 	virtual void message(const std::string &tag, uint32_t code, uint32_t x, uint32_t y, uint32_t z,
 	                     uint32_t word_count, const Word *words) = 0;
+
+	// Receives the resolved counter table of an aggregate telemetry channel
+	// (see CommandBuffer::begin_aggregate_channel()), one call per frame the
+	// channel was active. Slot layout is a contract between the shaders and
+	// the consumer. Default no-op so message-only consumers are unaffected.
+	virtual void aggregate(const std::string &tag, uint32_t num_counters, const uint32_t *counters)
+	{
+		(void)tag;
+		(void)num_counters;
+		(void)counters;
+	}
 };
 
 class Device
@@ -175,6 +188,13 @@ public:
 	                                          const VkPerformanceCounterDescriptionKHR **desc);
 	bool init_timestamp_trace(const char *path);
 
+	// Non-null if GRANITE_TIMESTAMP_TRACE is active. CPU zones recorded here
+	// end up in the same trace as the GPU timestamps.
+	Util::TimelineTraceFile *get_timeline_trace_file()
+	{
+		return timeline_trace_file.get();
+	}
+
 	ImageView &get_swapchain_view();
 	ImageView &get_swapchain_view(unsigned index);
 	unsigned get_num_swapchain_images() const;
@@ -223,6 +243,13 @@ public:
 	void register_time_interval(std::string tid, QueryPoolHandle start_ts, QueryPoolHandle end_ts,
 	                            std::string tag, std::string extra = {});
 
+	// Aggregated GPU timing intervals (render graph passes and other
+	// registered tags) with min/max/avg per frame context.
+	TimestampIntervalManager &get_timestamp_interval_manager()
+	{
+		return managers.timestamps;
+	}
+
 	// Request shaders and programs. These objects are owned by the Device.
 	Shader *request_shader(const uint32_t *code, size_t size);
 	Shader *request_shader_by_hash(Util::Hash hash);
@@ -304,6 +331,11 @@ public:
 		return mem_props;
 	}
 
+	// One entry per memory heap, in VkPhysicalDeviceMemoryProperties order.
+	// See HeapBudget for what counts as budget with and without
+	// VK_EXT_memory_budget.
+	void get_memory_budget(HeapBudget *budget);
+
 	const VkPhysicalDeviceProperties &get_gpu_properties() const
 	{
 		return gpu_props;
@@ -339,6 +371,22 @@ public:
 	// Writes a timestamp on host side, which is calibrated to the GPU timebase.
 	QueryPoolHandle write_calibrated_timestamp();
 
+#ifdef GRANITE_VULKAN_FOSSILIZE
+	// init_pipeline_state() hands pipeline compilation from the Fossilize
+	// archive to worker threads and returns while they churn, so replay
+	// overlaps asset loading. Poll progress to gate first render, or block
+	// until the whole archive has replayed.
+	void query_pipeline_replay_progress(unsigned &completed, unsigned &total) const;
+	void wait_pipeline_state_replay();
+
+	// Rewrites the Fossilize archive on a worker thread so the calling thread
+	// only pays for serialization. The recorder is hash-keyed, so the rewrite
+	// both dedups and compacts; call this at natural breaks (level loads)
+	// to keep replay-based prewarm from paying for stale archive growth.
+	// At most one rewrite is in flight; extra calls while one runs are no-ops.
+	void flush_pipeline_state_background();
+#endif
+
 private:
 	VkInstance instance = VK_NULL_HANDLE;
 	VkPhysicalDevice gpu = VK_NULL_HANDLE;
@@ -363,6 +411,7 @@ private:
 	void request_index_block(BufferBlock &block, VkDeviceSize size);
 	void request_uniform_block(BufferBlock &block, VkDeviceSize size);
 	void request_staging_block(BufferBlock &block, VkDeviceSize size);
+	void request_indirect_block(BufferBlock &block, VkDeviceSize size);
 
 	QueryPoolHandle write_timestamp(VkCommandBuffer cmd, VkPipelineStageFlagBits stage);
 
@@ -383,16 +432,12 @@ private:
 	void init_bindless();
 	void deinit_timeline_semaphores();
 
-	struct JSONTraceFileDeleter { void operator()(FILE *file); };
-	std::unique_ptr<FILE, JSONTraceFileDeleter> json_trace_file;
-	int64_t json_base_timestamp_value = 0;
-	int64_t json_timestamp_origin = 0;
-	int64_t convert_timestamp_to_absolute_usec(uint64_t ts);
-	uint64_t update_wrapped_base_timestamp(uint64_t ts);
+	std::unique_ptr<Util::TimelineTraceFile> timeline_trace_file;
+	int64_t convert_timestamp_to_absolute_nsec(uint64_t ts);
 	void write_json_timestamp_range(unsigned frame_index, const char *tid, const char *name, const char *extra,
 	                                uint64_t start_ts, uint64_t end_ts,
-	                                int64_t &min_us, int64_t &max_us);
-	void write_json_timestamp_range_us(unsigned frame_index, const char *tid, const char *name, int64_t start_us, int64_t end_us);
+	                                int64_t &min_ns, int64_t &max_ns);
+	void write_json_timestamp_range_ns(unsigned frame_index, const char *tid, const char *name, int64_t start_ns, int64_t end_ns);
 
 	QueryPoolHandle write_timestamp_nolock(VkCommandBuffer cmd, VkPipelineStageFlagBits stage);
 	QueryPoolHandle write_calibrated_timestamp_nolock();
@@ -420,7 +465,7 @@ private:
 		FenceManager fence;
 		SemaphoreManager semaphore;
 		EventManager event;
-		BufferPool vbo, ibo, ubo, staging;
+		BufferPool vbo, ibo, ubo, staging, indirect;
 		TimestampIntervalManager timestamps;
 	};
 	Managers managers;
@@ -441,7 +486,26 @@ private:
 		void operator=(const PerFrame &) = delete;
 		PerFrame(const PerFrame &) = delete;
 
-		void begin();
+		// Deferred destruction drained out of the per-frame queues.
+		// Collected under the device lock, executed outside it so heavy
+		// teardown frames don't serialize against submission threads.
+		struct Teardown
+		{
+			std::vector<VkFramebuffer> framebuffers;
+			std::vector<VkSampler> samplers;
+			std::vector<VkPipeline> pipelines;
+			std::vector<VkImageView> image_views;
+			std::vector<VkBufferView> buffer_views;
+			std::vector<VkImage> images;
+			std::vector<VkBuffer> buffers;
+			std::vector<VkSemaphore> semaphores;
+			std::vector<VkDescriptorPool> descriptor_pools;
+			std::vector<DeviceAllocation> allocations;
+		};
+
+		// If out_teardown is non-null the destruction work is handed to the caller,
+		// otherwise it is executed inline as before.
+		void begin(Teardown *out_teardown = nullptr);
 
 		Device &device;
 		unsigned frame_index;
@@ -456,6 +520,7 @@ private:
 		std::vector<BufferBlock> ibo_blocks;
 		std::vector<BufferBlock> ubo_blocks;
 		std::vector<BufferBlock> staging_blocks;
+		std::vector<BufferBlock> indirect_blocks;
 
 		VkSemaphore graphics_timeline_semaphore;
 		VkSemaphore compute_timeline_semaphore;
@@ -489,6 +554,7 @@ private:
 			DebugChannelInterface *iface;
 			std::string tag;
 			BufferHandle buffer;
+			bool aggregate;
 		};
 		std::vector<DebugChannel> debug_channels;
 
@@ -542,6 +608,7 @@ private:
 		std::vector<BufferBlock> vbo;
 		std::vector<BufferBlock> ibo;
 		std::vector<BufferBlock> ubo;
+		std::vector<BufferBlock> indirect;
 	} dma;
 
 	void submit_queue(CommandBuffer::Type type, InternalFence *fence,
@@ -654,6 +721,7 @@ private:
 	void request_index_block_nolock(BufferBlock &block, VkDeviceSize size);
 	void request_uniform_block_nolock(BufferBlock &block, VkDeviceSize size);
 	void request_staging_block_nolock(BufferBlock &block, VkDeviceSize size);
+	void request_indirect_block_nolock(BufferBlock &block, VkDeviceSize size);
 
 	CommandBufferHandle request_secondary_command_buffer_for_thread(unsigned thread_index,
 	                                                                const Framebuffer *framebuffer,
@@ -664,8 +732,17 @@ private:
 	void submit_secondary(CommandBuffer &primary, CommandBuffer &secondary);
 	void wait_idle_nolock();
 	void end_frame_nolock();
+	void execute_teardown(PerFrame::Teardown &teardown);
+
+#ifdef GRANITE_VULKAN_MT
+	// Kicks a pipeline compile to a ThreadGroup worker unless one is already
+	// in flight for the same pipeline hash. Used by command buffers in
+	// async-compile mode to avoid hitching on first use of a material.
+	void request_async_pipeline_compile(const DeferredPipelineCompile &compile, bool is_graphics);
+#endif
 
-	void add_debug_channel_buffer(DebugChannelInterface *iface, std::string tag, BufferHandle buffer);
+	void add_debug_channel_buffer(DebugChannelInterface *iface, std::string tag, BufferHandle buffer,
+	                              bool aggregate = false);
 	void parse_debug_channel(const PerFrame::DebugChannel &channel);
 
 	Fence request_legacy_fence();
@@ -700,21 +777,43 @@ private:
 
 	struct
 	{
+		// The replayer owns the parsed create infos referenced by in-flight
+		// pipeline tasks, so it must stay alive until the replay has joined.
+		std::unique_ptr<Fossilize::StateReplayer> replayer;
 		std::unordered_map<VkShaderModule, Shader *> shader_map;
 		std::unordered_map<VkRenderPass, RenderPass *> render_pass_map;
+		std::atomic<uint32_t> completed_pipelines{0};
+		uint32_t total_pipelines = 0;
 #ifdef GRANITE_VULKAN_MT
 		Granite::TaskGroup pipeline_group;
+		std::vector<Granite::TaskGroup> flushed_groups;
 #endif
 	} replayer_state;
 
 	void init_pipeline_state();
 	void flush_pipeline_state();
+	void write_pipeline_state(const uint8_t *serialized, size_t serialized_size);
+#ifdef GRANITE_VULKAN_MT
+	Granite::TaskGroup fossilize_flush_group;
+	std::atomic<bool> fossilize_flush_pending{false};
+#endif
 #endif
 
 	ImplementationWorkarounds workarounds;
 	void init_workarounds();
 	void report_checkpoints();
 
+	// Pushes per-frame pool sizes as trace counters and logs watermark growth
+	// per subsystem. Called once per frame context, before the pools reset.
+	enum { NumPoolTelemetryCounters = 8 };
+	uint64_t pool_watermarks[NumPoolTelemetryCounters] = {};
+	void report_frame_telemetry_nolock();
+
+#ifdef GRANITE_VULKAN_MT
+	std::mutex async_pipeline_lock;
+	std::unordered_set<Util::Hash> async_pending_pipelines;
+#endif
+
 	void fill_buffer_sharing_indices(VkBufferCreateInfo &create_info, uint32_t *sharing_indices);
 
 	bool allocate_image_memory(DeviceAllocation *allocation, const ImageCreateInfo &info,
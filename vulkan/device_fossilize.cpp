@@ -22,6 +22,10 @@
 
 #include "device.hpp"
 #include "timer.hpp"
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 using namespace std;
 
@@ -73,10 +77,12 @@ bool Device::enqueue_create_shader_module(Fossilize::Hash hash, const VkShaderMo
 void Device::notify_replayed_resources_for_type()
 {
 #ifdef GRANITE_VULKAN_MT
+	// Kick the pipelines enqueued for this resource type off to the workers
+	// and keep parsing. wait_pipeline_state_replay() joins with them later.
 	if (replayer_state.pipeline_group)
 	{
-		replayer_state.pipeline_group->wait();
-		replayer_state.pipeline_group.reset();
+		replayer_state.pipeline_group->flush();
+		replayer_state.flushed_groups.push_back(std::move(replayer_state.pipeline_group));
 	}
 #endif
 }
@@ -145,14 +151,18 @@ bool Device::enqueue_create_graphics_pipeline(Fossilize::Hash hash,
 	if (!replayer_state.pipeline_group)
 		replayer_state.pipeline_group = Granite::Global::thread_group()->create_task();
 
+	replayer_state.total_pipelines++;
 	replayer_state.pipeline_group->enqueue_task([this, info = *create_info, hash, pipeline]() mutable {
 		*pipeline = fossilize_create_graphics_pipeline(hash, info);
+		replayer_state.completed_pipelines.fetch_add(1, std::memory_order_release);
 	});
 
 	return true;
 #else
 	auto info = *create_info;
+	replayer_state.total_pipelines++;
 	*pipeline = fossilize_create_graphics_pipeline(hash, info);
+	replayer_state.completed_pipelines.fetch_add(1, std::memory_order_release);
 	return *pipeline != VK_NULL_HANDLE;
 #endif
 }
@@ -165,14 +175,18 @@ bool Device::enqueue_create_compute_pipeline(Fossilize::Hash hash,
 	if (!replayer_state.pipeline_group)
 		replayer_state.pipeline_group = Granite::Global::thread_group()->create_task();
 
+	replayer_state.total_pipelines++;
 	replayer_state.pipeline_group->enqueue_task([this, info = *create_info, hash, pipeline]() mutable {
 		*pipeline = fossilize_create_compute_pipeline(hash, info);
+		replayer_state.completed_pipelines.fetch_add(1, std::memory_order_release);
 	});
 
 	return true;
 #else
 	auto info = *create_info;
+	replayer_state.total_pipelines++;
 	*pipeline = fossilize_create_compute_pipeline(hash, info);
+	replayer_state.completed_pipelines.fetch_add(1, std::memory_order_release);
 	return *pipeline != VK_NULL_HANDLE;
 #endif
 }
@@ -226,37 +240,149 @@ void Device::init_pipeline_state()
 	}
 
 	LOGI("Replaying cached state.\n");
-	Fossilize::StateReplayer replayer;
+	replayer_state.replayer.reset(new Fossilize::StateReplayer);
 	auto start = Util::get_current_time_nsecs();
-	replayer.parse(*this, nullptr, static_cast<const char *>(mapped), file->get_size());
+	replayer_state.replayer->parse(*this, nullptr, static_cast<const char *>(mapped), file->get_size());
 	auto end = Util::get_current_time_nsecs();
-	LOGI("Completed replaying cached state in %.3f ms.\n", (end - start) * 1e-6);
-	replayer_state = {};
+	LOGI("Parsed cached state in %.3f ms, replaying %u pipelines on worker threads.\n",
+	     (end - start) * 1e-6, replayer_state.total_pipelines);
+
+#ifdef GRANITE_VULKAN_MT
+	// Flush any pipelines enqueued since the last resource type notification
+	// so every compile is in flight before we return.
+	if (replayer_state.pipeline_group)
+	{
+		replayer_state.pipeline_group->flush();
+		replayer_state.flushed_groups.push_back(std::move(replayer_state.pipeline_group));
+	}
+#else
+	wait_pipeline_state_replay();
+#endif
 }
 
-void Device::flush_pipeline_state()
+void Device::query_pipeline_replay_progress(unsigned &completed, unsigned &total) const
+{
+	completed = replayer_state.completed_pipelines.load(std::memory_order_acquire);
+	total = replayer_state.total_pipelines;
+}
+
+void Device::wait_pipeline_state_replay()
+{
+#ifdef GRANITE_VULKAN_MT
+	for (auto &group : replayer_state.flushed_groups)
+		group->wait();
+	replayer_state.flushed_groups.clear();
+
+	if (replayer_state.pipeline_group)
+	{
+		replayer_state.pipeline_group->wait();
+		replayer_state.pipeline_group.reset();
+	}
+#endif
+
+	if (replayer_state.replayer)
+	{
+		LOGI("Replayed %u pipelines from cached state.\n", replayer_state.total_pipelines);
+		replayer_state.replayer.reset();
+	}
+	replayer_state.shader_map.clear();
+	replayer_state.render_pass_map.clear();
+}
+
+void Device::write_pipeline_state(const uint8_t *serialized, size_t serialized_size)
 {
+	auto &fs = *Granite::Global::filesystem();
+
+	// Write to a sibling temp file and rename over the archive, so a crash
+	// mid-write never leaves a truncated pipelines.json behind. Backends
+	// without a native filesystem path cannot rename, so they get the old
+	// in-place write.
+	auto target_path = fs.get_filesystem_path("cache://pipelines.json");
+	bool atomic_replace = !target_path.empty();
+	const char *write_path = atomic_replace ? "cache://pipelines.json.tmp" : "cache://pipelines.json";
+
+	auto file = fs.open(write_path, Granite::FileMode::WriteOnly);
+	if (!file)
+	{
+		LOGE("Failed to open %s for writing.\n", write_path);
+		return;
+	}
+
+	auto *data = static_cast<uint8_t *>(file->map_write(serialized_size));
+	if (!data)
+	{
+		LOGE("Failed to serialize pipeline data.\n");
+		return;
+	}
+
+	memcpy(data, serialized, serialized_size);
+	file->unmap();
+	file.reset();
+
+	if (atomic_replace)
+	{
+		auto tmp_path = fs.get_filesystem_path("cache://pipelines.json.tmp");
+#ifdef _WIN32
+		if (!MoveFileExA(tmp_path.c_str(), target_path.c_str(), MOVEFILE_REPLACE_EXISTING))
+			LOGE("Failed to replace pipelines.json.\n");
+#else
+		if (rename(tmp_path.c_str(), target_path.c_str()) != 0)
+			LOGE("Failed to replace pipelines.json.\n");
+#endif
+	}
+}
+
+void Device::flush_pipeline_state_background()
+{
+#ifdef GRANITE_VULKAN_MT
+	bool expected = false;
+	if (!fossilize_flush_pending.compare_exchange_strong(expected, true))
+		return;
+
+	// The recorder is hash-keyed, so serializing the live state both dedups
+	// and compacts; entries which fell out of the recorder never hit disk
+	// again. Serialization stays on the calling thread, only the file I/O
+	// (the slow part for large archives) moves to a worker.
 	uint8_t *serialized = nullptr;
 	size_t serialized_size = 0;
 	if (!state_recorder.serialize(&serialized, &serialized_size))
 	{
 		LOGE("Failed to serialize Fossilize state.\n");
+		fossilize_flush_pending.store(false, std::memory_order_release);
 		return;
 	}
 
-	auto file = Granite::Global::filesystem()->open("cache://pipelines.json", Granite::FileMode::WriteOnly);
-	if (file)
+	fossilize_flush_group = Granite::Global::thread_group()->create_task([this, serialized, serialized_size]() {
+		write_pipeline_state(serialized, serialized_size);
+		state_recorder.free_serialized(serialized);
+		fossilize_flush_pending.store(false, std::memory_order_release);
+	});
+	fossilize_flush_group->flush();
+#else
+	flush_pipeline_state();
+#endif
+}
+
+void Device::flush_pipeline_state()
+{
+#ifdef GRANITE_VULKAN_MT
+	// Join any background rewrite so we don't race on the temp file.
+	if (fossilize_flush_group)
 	{
-		auto *data = static_cast<uint8_t *>(file->map_write(serialized_size));
-		if (data)
-		{
-			memcpy(data, serialized, serialized_size);
-			file->unmap();
-		}
-		else
-			LOGE("Failed to serialize pipeline data.\n");
+		fossilize_flush_group->wait();
+		fossilize_flush_group.reset();
+	}
+#endif
 
+	uint8_t *serialized = nullptr;
+	size_t serialized_size = 0;
+	if (!state_recorder.serialize(&serialized, &serialized_size))
+	{
+		LOGE("Failed to serialize Fossilize state.\n");
+		return;
 	}
+
+	write_pipeline_state(serialized, serialized_size);
 	state_recorder.free_serialized(serialized);
 }
 }
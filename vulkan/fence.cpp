@@ -22,6 +22,7 @@
 
 #include "fence.hpp"
 #include "device.hpp"
+#include "spin_wait.hpp"
 
 namespace Vulkan
 {
@@ -53,9 +54,25 @@ void FenceHolder::wait()
 	if (observed_wait)
 		return;
 
+	// The fence has often signalled by the time anyone waits on it, so poll
+	// a bounded number of times with backoff before entering a kernel wait.
+	// The poll budget is small since each poll is a driver call.
+	enum { SpinPauses = 128 };
+
 	if (timeline_value != 0)
 	{
 		VK_ASSERT(timeline_semaphore);
+
+		if (Util::spin_wait_until([&]() {
+			    uint64_t value = 0;
+			    return table.vkGetSemaphoreCounterValueKHR(device->get_device(), timeline_semaphore, &value) == VK_SUCCESS &&
+			           value >= timeline_value;
+		    }, SpinPauses))
+		{
+			observed_wait = true;
+			return;
+		}
+
 		VkSemaphoreWaitInfoKHR info = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR };
 		info.semaphoreCount = 1;
 		info.pSemaphores = &timeline_semaphore;
@@ -67,6 +84,14 @@ void FenceHolder::wait()
 	}
 	else
 	{
+		if (Util::spin_wait_until([&]() {
+			    return table.vkGetFenceStatus(device->get_device(), fence) == VK_SUCCESS;
+		    }, SpinPauses))
+		{
+			observed_wait = true;
+			return;
+		}
+
 		if (table.vkWaitForFences(device->get_device(), 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
 			LOGE("Failed to wait for fence!\n");
 		else
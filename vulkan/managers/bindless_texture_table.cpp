@@ -0,0 +1,100 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bindless_texture_table.hpp"
+#include "device.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace Vulkan
+{
+BindlessTextureTable::BindlessTextureTable(Device *device_)
+	: device(device_)
+{
+}
+
+uint32_t BindlessTextureTable::register_texture(Texture *texture)
+{
+	auto itr = slots.find(texture);
+	if (itr != end(slots))
+		return itr->second;
+
+	auto slot = uint32_t(textures.size());
+	textures.push_back(texture);
+	cookies.push_back(0);
+	slots[texture] = slot;
+	dirty = true;
+	return slot;
+}
+
+VkDescriptorSet BindlessTextureTable::update()
+{
+	if (!device->get_device_features().supports_descriptor_indexing)
+		return VK_NULL_HANDLE;
+
+	// Resolving the view here rather than at registration time means a
+	// Texture which hot-swapped its image (file reload, mip-streamed load)
+	// is picked up without any explicit invalidation from the owner.
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		auto *image = textures[i]->get_image();
+		if (image->get_cookie() != cookies[i])
+		{
+			cookies[i] = image->get_cookie();
+			dirty = true;
+		}
+	}
+
+	if (!dirty)
+		return desc_set;
+
+	if (!pool)
+		pool = device->create_bindless_descriptor_pool(BindlessResourceType::ImageFP, 16, VULKAN_NUM_BINDINGS_BINDLESS);
+
+	unsigned count = std::max(1u, get_count());
+	if (!pool->allocate_descriptors(count))
+	{
+		pool = device->create_bindless_descriptor_pool(BindlessResourceType::ImageFP, 16, VULKAN_NUM_BINDINGS_BINDLESS);
+		if (!pool->allocate_descriptors(count))
+			LOGE("Failed to allocate descriptors on a fresh descriptor pool!\n");
+	}
+
+	desc_set = pool->get_descriptor_set();
+
+	for (size_t i = 0; i < textures.size(); i++)
+		pool->set_texture(unsigned(i), textures[i]->get_image()->get_view());
+
+	dirty = false;
+	return desc_set;
+}
+
+void BindlessTextureTable::reset()
+{
+	textures.clear();
+	cookies.clear();
+	slots.clear();
+	pool.reset();
+	desc_set = VK_NULL_HANDLE;
+	dirty = false;
+}
+}
@@ -0,0 +1,73 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "texture_manager.hpp"
+#include "descriptor_set.hpp"
+#include <unordered_map>
+#include <vector>
+
+namespace Vulkan
+{
+// Maintains one global sampled-image table for bindless access
+// (VK_EXT_descriptor_indexing). Each registered texture gets a stable u32
+// slot, so indices recorded in material buffers remain valid across frames
+// and across hot reloads; update() resolves the current image view of every
+// slot per frame, which also tracks mip-streamed handle replacement for free.
+// Bind the resulting set with CommandBuffer::set_bindless() and index with
+// nonuniformEXT in the shader.
+class BindlessTextureTable
+{
+public:
+	explicit BindlessTextureTable(Device *device);
+
+	// Returns the stable slot for this texture, allocating one on first use.
+	uint32_t register_texture(Texture *texture);
+
+	// (Re)builds the descriptor set when slots were added or any registered
+	// texture swapped its image. Call once per frame before binding the set.
+	// Returns VK_NULL_HANDLE when descriptor indexing is not supported.
+	VkDescriptorSet update();
+
+	VkDescriptorSet get_descriptor_set() const
+	{
+		return desc_set;
+	}
+
+	uint32_t get_count() const
+	{
+		return uint32_t(textures.size());
+	}
+
+	void reset();
+
+private:
+	Device *device;
+	BindlessDescriptorPoolHandle pool;
+	std::vector<Texture *> textures;
+	std::vector<uint64_t> cookies;
+	std::unordered_map<Texture *, uint32_t> slots;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	bool dirty = false;
+};
+}
@@ -0,0 +1,159 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "readback_ring.hpp"
+#ifdef GRANITE_VULKAN_MT
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#endif
+
+using namespace std;
+
+namespace Vulkan
+{
+ReadbackRing::ReadbackRing(Device *device_)
+	: device(device_)
+{
+}
+
+ReadbackRing::~ReadbackRing()
+{
+	wait_all();
+}
+
+BufferHandle ReadbackRing::create_readback_buffer(VkDeviceSize size)
+{
+	BufferCreateInfo info;
+	info.size = size;
+	info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.domain = BufferDomain::CachedHost;
+	return device->create_buffer(info, nullptr);
+}
+
+void ReadbackRing::request_image_readback(const Image &image, CommandBuffer::Type type, ImageCallback callback)
+{
+	Pending entry = {};
+	auto &info = image.get_create_info();
+
+	switch (info.type)
+	{
+	case VK_IMAGE_TYPE_1D:
+		entry.layout.set_1d(image.get_format(), info.width, info.layers, info.levels);
+		break;
+
+	case VK_IMAGE_TYPE_2D:
+		entry.layout.set_2d(image.get_format(), info.width, info.height, info.layers, info.levels);
+		break;
+
+	case VK_IMAGE_TYPE_3D:
+		entry.layout.set_3d(image.get_format(), info.width, info.height, info.depth, info.levels);
+		break;
+
+	default:
+		LOGE("Unsupported image type for readback.\n");
+		return;
+	}
+
+	Util::SmallVector<VkBufferImageCopy, 32> blits;
+	entry.layout.build_buffer_image_copies(blits);
+
+	entry.buffer = create_readback_buffer(entry.layout.get_required_size());
+	entry.image_callback = move(callback);
+	entry.remaining_contexts = device->get_num_frame_contexts();
+
+	auto cmd = device->request_command_buffer(type);
+	cmd->copy_image_to_buffer(*entry.buffer, image, blits.size(), blits.data());
+	cmd->barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	             VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	device->submit(cmd);
+
+	pending.push_back(move(entry));
+}
+
+void ReadbackRing::request_buffer_readback(const Buffer &buffer, CommandBuffer::Type type, BufferCallback callback)
+{
+	Pending entry = {};
+	entry.buffer = create_readback_buffer(buffer.get_create_info().size);
+	entry.buffer_callback = move(callback);
+	entry.remaining_contexts = device->get_num_frame_contexts();
+
+	auto cmd = device->request_command_buffer(type);
+	cmd->copy_buffer(*entry.buffer, buffer);
+	cmd->barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	             VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	device->submit(cmd);
+
+	pending.push_back(move(entry));
+}
+
+void ReadbackRing::dispatch(Pending entry, bool async)
+{
+	const auto resolve = [this, entry]() {
+		void *mapped = device->map_host_buffer(*entry.buffer, MEMORY_ACCESS_READ_BIT);
+		if (entry.image_callback)
+			entry.image_callback(entry.layout, mapped);
+		else if (entry.buffer_callback)
+			entry.buffer_callback(mapped, entry.buffer->get_create_info().size);
+		device->unmap_host_buffer(*entry.buffer, MEMORY_ACCESS_READ_BIT);
+	};
+
+#ifdef GRANITE_VULKAN_MT
+	if (async)
+	{
+		Granite::Global::thread_group()->create_task(resolve);
+		return;
+	}
+#else
+	(void)async;
+#endif
+	resolve();
+}
+
+void ReadbackRing::begin_frame()
+{
+	auto itr = pending.begin();
+	while (itr != pending.end())
+	{
+		// When the frame context which carried the copy has cycled all the
+		// way around, Device has waited out its submission fences, so the
+		// buffer contents are safe to read without a fence of our own.
+		if (--itr->remaining_contexts == 0)
+		{
+			dispatch(move(*itr), true);
+			itr = pending.erase(itr);
+		}
+		else
+			++itr;
+	}
+}
+
+void ReadbackRing::wait_all()
+{
+	if (pending.empty())
+		return;
+
+	device->wait_idle();
+	for (auto &entry : pending)
+		dispatch(move(entry), false);
+	pending.clear();
+}
+}
@@ -0,0 +1,79 @@
+/* Copyright (c) 2017-2020 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "device.hpp"
+#include "texture_format.hpp"
+#include <functional>
+#include <vector>
+
+namespace Vulkan
+{
+// Deferred, fence-free readback of GPU resources for screenshots and
+// telemetry captures. request_*_readback() records a copy into a host-cached
+// buffer and returns immediately. Completion is resolved by frame-context
+// aging instead of fence waits: once as many frame contexts have begun as the
+// device cycles through, the submission which recorded the copy has provably
+// retired, and the callback is dispatched on the ThreadGroup workers.
+class ReadbackRing
+{
+public:
+	explicit ReadbackRing(Device *device);
+	~ReadbackRing();
+
+	using ImageCallback = std::function<void (const TextureFormatLayout &layout, const void *mapped)>;
+	using BufferCallback = std::function<void (const void *mapped, VkDeviceSize size)>;
+
+	// Records a GPU copy of the image (expected to be in
+	// VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL or GENERAL) on the given queue
+	// type. The callback receives the packed texture layout and mapped data.
+	void request_image_readback(const Image &image, CommandBuffer::Type type, ImageCallback callback);
+
+	// Same, for a raw buffer.
+	void request_buffer_readback(const Buffer &buffer, CommandBuffer::Type type, BufferCallback callback);
+
+	// Call once per frame right after Device::next_frame_context().
+	// Dispatches callbacks for readbacks which have aged out.
+	void begin_frame();
+
+	// Resolves every pending readback, draining the GPU as required.
+	// Callbacks run synchronously on the calling thread.
+	void wait_all();
+
+private:
+	Device *device;
+
+	struct Pending
+	{
+		BufferHandle buffer;
+		TextureFormatLayout layout;
+		ImageCallback image_callback;
+		BufferCallback buffer_callback;
+		unsigned remaining_contexts;
+	};
+	std::vector<Pending> pending;
+
+	void dispatch(Pending entry, bool async);
+	BufferHandle create_readback_buffer(VkDeviceSize size);
+};
+}
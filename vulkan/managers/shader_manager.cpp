@@ -27,6 +27,11 @@
 #include "device.hpp"
 #include "rapidjson_wrapper.hpp"
 
+#ifdef GRANITE_VULKAN_MT
+#include "thread_group.hpp"
+#include "global_managers.hpp"
+#endif
+
 using namespace std;
 using namespace Util;
 
@@ -41,12 +46,17 @@ namespace Vulkan
 ShaderTemplate::ShaderTemplate(Device *device_, const std::string &shader_path,
                                PrecomputedShaderCache &cache_,
                                Util::Hash path_hash_,
-                               const std::vector<std::string> &include_directories_)
+                               const std::vector<std::string> &include_directories_,
+                               Granite::IncludeCache *include_cache_)
 	: device(device_), path(shader_path), cache(cache_), path_hash(path_hash_)
 #ifdef GRANITE_VULKAN_SHADER_MANAGER_RUNTIME_COMPILER
 	, include_directories(include_directories_)
+	, include_cache(include_cache_)
 #endif
 {
+#ifndef GRANITE_VULKAN_SHADER_MANAGER_RUNTIME_COMPILER
+	(void)include_cache_;
+#endif
 }
 
 bool ShaderTemplate::init()
@@ -55,6 +65,7 @@ bool ShaderTemplate::init()
 	compiler = make_unique<Granite::GLSLCompiler>();
 	if (device->get_device_features().supports_vulkan_11_device)
 		compiler->set_target(Granite::Target::Vulkan11);
+	compiler->set_include_cache(include_cache);
 	if (!compiler->set_source_from_file(path))
 		return false;
 	compiler->set_include_directories(&include_directories);
@@ -131,6 +142,7 @@ void ShaderTemplate::recompile()
 	auto newcompiler = make_unique<Granite::GLSLCompiler>();
 	if (device->get_device_features().supports_vulkan_11_device)
 		newcompiler->set_target(Granite::Target::Vulkan11);
+	newcompiler->set_include_cache(include_cache);
 	if (!newcompiler->set_source_from_file(path))
 		return;
 	newcompiler->set_include_directories(&include_directories);
@@ -139,21 +151,45 @@ void ShaderTemplate::recompile()
 		LOGE("Failed to preprocess updated shader: %s\n", path.c_str());
 		return;
 	}
-	compiler = move(newcompiler);
 
-	for (auto &variant : variants)
+	// A notification for one include can fan out to every template which depends on it.
+	// If the include graph still resolves to identical contents, the current variants remain valid.
+	if (compiler && newcompiler->get_source_hash() == compiler->get_source_hash())
 	{
-		auto newspirv = compiler->compile(&variant.defines);
+		compiler = move(newcompiler);
+		return;
+	}
+	compiler = move(newcompiler);
+
+	const auto compile_variant = [this](Variant &variant) {
+		std::string error;
+		auto newspirv = compiler->compile(error, &variant.defines);
 		if (newspirv.empty())
 		{
-			LOGE("Failed to compile shader: %s\n%s\n", path.c_str(), compiler->get_error_message().c_str());
+			LOGE("Failed to compile shader: %s\n%s\n", path.c_str(), error.c_str());
 			for (auto &define : variant.defines)
 				LOGE("  Define: %s = %d\n", define.first.c_str(), define.second);
-			continue;
+			return;
 		}
 
 		variant.spirv = move(newspirv);
 		variant.instance++;
+	};
+
+#ifdef GRANITE_VULKAN_MT
+	auto *group = Granite::Global::thread_group();
+	if (group)
+	{
+		auto task = group->create_task();
+		for (auto &variant : variants)
+			task->enqueue_task([&compile_variant, &variant]() { compile_variant(variant); });
+		task->wait();
+	}
+	else
+#endif
+	{
+		for (auto &variant : variants)
+			compile_variant(variant);
 	}
 }
 
@@ -319,6 +355,18 @@ unsigned ShaderProgram::register_variant(const std::vector<std::pair<std::string
 	return index;
 }
 
+unsigned ShaderProgram::get_variant_count()
+{
+#ifdef GRANITE_VULKAN_MT
+	variant_lock.lock_read();
+#endif
+	auto count = unsigned(variants.size());
+#ifdef GRANITE_VULKAN_MT
+	variant_lock.unlock_read();
+#endif
+	return count;
+}
+
 ShaderProgram *ShaderManager::register_compute(const std::string &compute)
 {
 	auto *tmpl = get_template(compute);
@@ -344,7 +392,11 @@ ShaderTemplate *ShaderManager::get_template(const std::string &path)
 	auto *ret = shaders.find(hash);
 	if (!ret)
 	{
-		auto *shader = shaders.allocate(device, path, shader_cache, hasher.get(), include_directories);
+#ifdef GRANITE_VULKAN_SHADER_MANAGER_RUNTIME_COMPILER
+		auto *shader = shaders.allocate(device, path, shader_cache, hasher.get(), include_directories, &include_cache);
+#else
+		auto *shader = shaders.allocate(device, path, shader_cache, hasher.get(), include_directories, nullptr);
+#endif
 		if (!shader->init())
 		{
 			shaders.free(shader);
@@ -409,8 +461,26 @@ void ShaderManager::recompile(const Granite::FileNotifyInfo &info)
 	if (info.type == Granite::FileNotifyType::FileDeleted)
 		return;
 
-	auto &deps = dependees[info.path];
-	for (auto &dep : deps)
+	// Editors tend to fire several notifications per save, and one header can fan
+	// out to dozens of templates. Defer to the frame boundary and recompile once.
+	pending_recompiles.insert(info.path);
+}
+
+void ShaderManager::recompile_pending_shaders()
+{
+	DEPENDENCY_LOCK();
+	if (pending_recompiles.empty())
+		return;
+
+	std::unordered_set<ShaderTemplate *> affected;
+	for (auto &path : pending_recompiles)
+	{
+		auto &deps = dependees[path];
+		affected.insert(begin(deps), end(deps));
+	}
+	pending_recompiles.clear();
+
+	for (auto &dep : affected)
 	{
 		dep->recompile();
 		dep->register_dependencies(*this);
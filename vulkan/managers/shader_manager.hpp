@@ -38,6 +38,11 @@
 #include "read_write_lock.hpp"
 #endif
 
+namespace Granite
+{
+class IncludeCache;
+}
+
 namespace Vulkan
 {
 using PrecomputedShaderCache = VulkanCache<Util::IntrusivePODWrapper<Util::Hash>>;
@@ -48,7 +53,8 @@ class ShaderTemplate : public Util::IntrusiveHashMapEnabled<ShaderTemplate>
 {
 public:
 	ShaderTemplate(Device *device, const std::string &shader_path, PrecomputedShaderCache &cache, Util::Hash path_hash,
-	               const std::vector<std::string> &include_directories);
+	               const std::vector<std::string> &include_directories,
+	               Granite::IncludeCache *include_cache);
 
 	bool init();
 
@@ -78,6 +84,7 @@ private:
 #ifdef GRANITE_VULKAN_SHADER_MANAGER_RUNTIME_COMPILER
 	std::unique_ptr<Granite::GLSLCompiler> compiler;
 	const std::vector<std::string> &include_directories;
+	Granite::IncludeCache *include_cache;
 #endif
 	VulkanCache<Variant> variants;
 };
@@ -101,6 +108,7 @@ public:
 	Vulkan::Program *get_program(unsigned variant);
 	void set_stage(Vulkan::ShaderStage stage, ShaderTemplate *shader);
 	unsigned register_variant(const std::vector<std::pair<std::string, int>> &defines);
+	unsigned get_variant_count();
 
 private:
 	Device *device;
@@ -144,6 +152,11 @@ public:
 #ifdef GRANITE_VULKAN_SHADER_MANAGER_RUNTIME_COMPILER
 	void register_dependency(ShaderTemplate *shader, const std::string &dependency);
 	void register_dependency_nolock(ShaderTemplate *shader, const std::string &dependency);
+
+	// Filesystem notifications only queue up paths. The actual recompiles run here,
+	// called from the frame boundary, so a burst of saves turns into one batch and
+	// every reloaded pipeline swaps in on the same frame.
+	void recompile_pending_shaders();
 #endif
 
 	bool get_shader_hash_by_variant_hash(Util::Hash variant_hash, Util::Hash &shader_hash);
@@ -165,7 +178,9 @@ private:
 	ShaderTemplate *get_template(const std::string &source);
 
 #ifdef GRANITE_VULKAN_SHADER_MANAGER_RUNTIME_COMPILER
+	Granite::IncludeCache include_cache;
 	std::unordered_map<std::string, std::unordered_set<ShaderTemplate *>> dependees;
+	std::unordered_set<std::string> pending_recompiles;
 #ifdef GRANITE_VULKAN_MT
 	std::mutex dependency_lock;
 #endif
@@ -118,6 +118,17 @@ void Texture::update_checkerboard()
 	replace_image(image);
 }
 
+static unsigned streaming_base_level(const TextureFormatLayout &layout)
+{
+	// The tail of the chain at 256x256 and below is enough to bind something
+	// presentable while the full payload pages in behind it.
+	unsigned base = 0;
+	while (base + 1 < layout.get_levels() &&
+	       (layout.get_width(base) > 256 || layout.get_height(base) > 256))
+		base++;
+	return base;
+}
+
 void Texture::update_gtx(const Granite::SceneFormats::MemoryMappedTexture &mapped_file)
 {
 	if (mapped_file.empty())
@@ -169,6 +180,34 @@ void Texture::update_gtx(const Granite::SceneFormats::MemoryMappedTexture &mappe
 			return;
 		}
 
+		unsigned base_level = streaming_base_level(layout);
+		if (layout.get_levels() > 1 && base_level > 0 &&
+		    layout.get_required_size() >= 1024 * 1024)
+		{
+			// Mip-streamed load: publish the low-resolution tail of the chain
+			// immediately so callers blocking on the handle can bind without
+			// waiting for the full payload; the full-resolution upload below
+			// replaces the handle once it lands.
+			ImageCreateInfo lo_info = info;
+			lo_info.width = layout.get_width(base_level);
+			lo_info.height = layout.get_height(base_level);
+			lo_info.depth = layout.get_depth(base_level);
+			lo_info.levels = layout.get_levels() - base_level;
+
+			std::vector<ImageInitialData> initial(lo_info.levels * layout.get_layers());
+			unsigned index = 0;
+			for (unsigned level = base_level; level < layout.get_levels(); level++)
+				for (unsigned layer = 0; layer < layout.get_layers(); layer++, index++)
+					initial[index] = { layout.data(layer, level), 0, 0 };
+
+			auto lo_image = device->create_image(lo_info, initial.data());
+			if (lo_image)
+			{
+				device->set_name(*lo_image, path.c_str());
+				replace_image(lo_image);
+			}
+		}
+
 		auto staging = device->create_image_staging_buffer(layout);
 		image = device->create_image_from_staging_buffer(info, &staging);
 	}
@@ -125,6 +125,15 @@ bool ClassAllocator::allocate(uint32_t size, AllocationTiling tiling, DeviceAllo
 	uint32_t masked_tiling_mode = tiling_mask & tiling;
 	auto &m = tiling_modes[masked_tiling_mode];
 
+	auto &vacants = slab_cache[masked_tiling_mode][num_blocks - 1];
+	if (!vacants.empty())
+	{
+		*alloc = vacants.back();
+		vacants.pop_back();
+		alloc->hierarchical = hierarchical;
+		return true;
+	}
+
 	uint32_t index = trailing_zeroes(m.heap_availability_mask & ~size_mask);
 
 	if (index < Block::NumSubBlocks)
@@ -223,9 +232,51 @@ ClassAllocator::~ClassAllocator()
 		LOGE("Memory leaked in class allocator!\n");
 }
 
+bool ClassAllocator::cache_slab(DeviceAllocation *alloc)
+{
+	if (alloc->size > SlabCacheMaxAllocSize)
+		return false;
+
+	// Only pristine sub-allocations can be recycled as-is. Allocator::allocate
+	// bumps the offset for alignments above the sub-block size; those have to
+	// go through the normal buddy free.
+	uint32_t block_offset = trailing_zeroes(alloc->mask) << sub_block_size_log2;
+	if (alloc->offset != block_offset + alloc->heap->allocation.offset)
+		return false;
+
+	unsigned num_blocks = alloc->size >> sub_block_size_log2;
+	auto &vacants = slab_cache[alloc->tiling][num_blocks - 1];
+	if (vacants.size() >= SlabCacheMaxEntriesPerBin)
+		return false;
+
+	vacants.push_back(*alloc);
+	return true;
+}
+
+void ClassAllocator::flush_slab_cache()
+{
+	ALLOCATOR_LOCK();
+	for (auto &mode : slab_cache)
+	{
+		for (auto &vacants : mode)
+		{
+			for (auto &vacant : vacants)
+				free_nolock(&vacant);
+			vacants.clear();
+		}
+	}
+}
+
 void ClassAllocator::free(DeviceAllocation *alloc)
 {
 	ALLOCATOR_LOCK();
+	if (cache_slab(alloc))
+		return;
+	free_nolock(alloc);
+}
+
+void ClassAllocator::free_nolock(DeviceAllocation *alloc)
+{
 	auto *heap = &*alloc->heap;
 	auto &block = heap->heap;
 	bool was_full = block.full();
@@ -351,6 +402,30 @@ Allocator::Allocator()
 	    .set_sub_block_size(64 * Block::NumSubBlocks * Block::NumSubBlocks * Block::NumSubBlocks); // 2M
 }
 
+Allocator::~Allocator()
+{
+	flush_slab_caches();
+}
+
+void Allocator::flush_slab_caches()
+{
+	// Flush from small to large so cached sub-allocations which pin
+	// hierarchical mini-heaps drain into their parent class in order.
+	for (auto &c : classes)
+		c.flush_slab_cache();
+}
+
+void Allocator::begin_frame_context()
+{
+	// Reuse within a handful of frames is what matters for churn; beyond that
+	// the cache would just pin dead mini-heaps.
+	if (++slab_cache_age >= 8)
+	{
+		slab_cache_age = 0;
+		flush_slab_caches();
+	}
+}
+
 void DeviceAllocator::init(Device *device_)
 {
 	device = device_;
@@ -418,6 +493,11 @@ void DeviceAllocator::Heap::garbage_collect(Device *device_)
 
 DeviceAllocator::~DeviceAllocator()
 {
+	// Cached slabs can pin mini-heaps whose superblocks recycle through the
+	// heaps below, so they must drain before the final garbage collect.
+	for (auto &allocator : allocators)
+		allocator->flush_slab_caches();
+
 	for (auto &heap : heaps)
 		heap.garbage_collect(device);
 }
@@ -426,7 +506,7 @@ void DeviceAllocator::free(uint32_t size, uint32_t memory_type, VkDeviceMemory m
 {
 	ALLOCATOR_LOCK();
 	auto &heap = heaps[mem_props.memoryTypes[memory_type].heapIndex];
-	heap.blocks.push_back({ memory, host_memory, size, memory_type });
+	heap.blocks.push_back({ memory, host_memory, size, memory_type, frame_context_counter });
 }
 
 void DeviceAllocator::free_no_recycle(uint32_t size, uint32_t memory_type, VkDeviceMemory memory, uint8_t *host_memory)
@@ -446,6 +526,101 @@ void DeviceAllocator::garbage_collect()
 		heap.garbage_collect(device);
 }
 
+void DeviceAllocator::get_memory_budget(HeapBudget *budget)
+{
+	bool supports_budget = device->get_device_features().supports_memory_budget;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props =
+			{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+	if (supports_budget)
+	{
+		VkPhysicalDeviceMemoryProperties2KHR props = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR };
+		props.pNext = &budget_props;
+		if (device->get_device_features().supports_vulkan_11_instance &&
+		    device->get_device_features().supports_vulkan_11_device)
+			vkGetPhysicalDeviceMemoryProperties2(device->get_physical_device(), &props);
+		else
+			vkGetPhysicalDeviceMemoryProperties2KHR(device->get_physical_device(), &props);
+	}
+
+	ALLOCATOR_LOCK();
+	for (uint32_t i = 0; i < mem_props.memoryHeapCount; i++)
+	{
+		budget[i].max_size = mem_props.memoryHeaps[i].size;
+		budget[i].tracked_usage = heaps[i].size;
+		if (supports_budget)
+		{
+			budget[i].budget_size = budget_props.heapBudget[i];
+			budget[i].device_usage = budget_props.heapUsage[i];
+		}
+		else
+		{
+			// Drivers and window systems typically carve out some of the heap,
+			// so don't pretend the full raw size is usable.
+			budget[i].budget_size = mem_props.memoryHeaps[i].size -
+			                        mem_props.memoryHeaps[i].size / 5;
+			budget[i].device_usage = heaps[i].size;
+		}
+	}
+}
+
+void DeviceAllocator::begin_frame_context()
+{
+	// Flushing slab caches can free superblocks back through our recycle path,
+	// so this must happen before we take our own lock.
+	for (auto &allocator : allocators)
+		allocator->begin_frame_context();
+
+	// How many frame contexts a recycled block survives without being reused.
+	// Needs to comfortably cover temporary dips in working set, e.g. while the
+	// streaming system rebuilds its resident set after a camera cut.
+	constexpr uint64_t retain_frame_contexts = 256;
+	// vkFreeMemory can be surprisingly expensive on some implementations,
+	// so spread the reclaim over multiple frames.
+	constexpr unsigned max_frees_per_context = 2;
+
+	// Once a heap runs up against its budget, holding on to recycled blocks
+	// only forces the driver to demote live resources to system memory, which
+	// hurts far more than a re-allocation would. Shrink the window hard.
+	constexpr uint64_t pressured_retain_frame_contexts = 8;
+	constexpr unsigned pressured_max_frees_per_context = 16;
+
+	// get_memory_budget takes the allocator lock itself.
+	HeapBudget budget[VK_MAX_MEMORY_HEAPS];
+	get_memory_budget(budget);
+
+	ALLOCATOR_LOCK();
+	frame_context_counter++;
+
+	for (uint32_t heap_index = 0; heap_index < mem_props.memoryHeapCount; heap_index++)
+	{
+		auto &heap = heaps[heap_index];
+		bool pressured = budget[heap_index].budget_size != 0 &&
+		                 budget[heap_index].device_usage >=
+		                 budget[heap_index].budget_size - budget[heap_index].budget_size / 10;
+
+		uint64_t retain = pressured ? pressured_retain_frame_contexts : retain_frame_contexts;
+		unsigned max_frees = pressured ? pressured_max_frees_per_context : max_frees_per_context;
+
+		unsigned frees = 0;
+		auto itr = begin(heap.blocks);
+		while (itr != end(heap.blocks) && frees < max_frees)
+		{
+			if (frame_context_counter - itr->last_use >= retain)
+			{
+				if (itr->host_memory)
+					table->vkUnmapMemory(device->get_device(), itr->memory);
+				table->vkFreeMemory(device->get_device(), itr->memory, nullptr);
+				heap.size -= itr->size;
+				itr = heap.blocks.erase(itr);
+				frees++;
+			}
+			else
+				++itr;
+		}
+	}
+}
+
 void *DeviceAllocator::map_memory(const DeviceAllocation &alloc, MemoryAccessFlags flags,
                                   VkDeviceSize offset, VkDeviceSize length)
 {
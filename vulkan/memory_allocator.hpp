@@ -273,15 +273,36 @@ private:
 	{
 		parent = allocator;
 	}
+
+	// Slab-style recycle cache in front of the buddy path. Freed, pristine
+	// sub-allocations up to 64 KiB are parked in per-(tiling, block-count)
+	// bins and handed back in O(1) without touching the heap lists, which is
+	// where the per-frame churn of small, uniformly sized allocations spends
+	// its time under the lock.
+	enum
+	{
+		SlabCacheMaxAllocSize = 64 * 1024,
+		SlabCacheMaxEntriesPerBin = 8
+	};
+	std::vector<DeviceAllocation> slab_cache[ALLOCATION_TILING_COUNT][Block::NumSubBlocks];
+	bool cache_slab(DeviceAllocation *alloc);
+	void flush_slab_cache();
+	void free_nolock(DeviceAllocation *alloc);
 };
 
 class Allocator
 {
 public:
 	Allocator();
+	~Allocator();
 	void operator=(const Allocator &) = delete;
 	Allocator(const Allocator &) = delete;
 
+	// Periodically drops the per-class slab caches so they cannot pin dead
+	// mini-heaps for long. Called once per frame context.
+	void begin_frame_context();
+	void flush_slab_caches();
+
 	bool allocate(uint32_t size, uint32_t alignment, AllocationTiling tiling, DeviceAllocation *alloc);
 	bool allocate_global(uint32_t size, DeviceAllocation *alloc);
 	bool allocate_dedicated(uint32_t size, DeviceAllocation *alloc, VkImage image);
@@ -313,6 +334,24 @@ private:
 	ClassAllocator classes[MEMORY_CLASS_COUNT];
 	DeviceAllocator *global_allocator = nullptr;
 	uint32_t memory_type = 0;
+	unsigned slab_cache_age = 0;
+};
+
+// Per-heap memory budget as seen by the allocator. With VK_EXT_memory_budget
+// the budget and usage come from the driver and account for other processes
+// and internal driver allocations; without it they fall back to a conservative
+// fraction of the raw heap size and what this allocator has handed out.
+struct HeapBudget
+{
+	// Raw size of the heap.
+	VkDeviceSize max_size = 0;
+	// How much the process can allocate from the heap before the driver
+	// starts demoting or failing allocations.
+	VkDeviceSize budget_size = 0;
+	// Process-wide usage of the heap as reported by the driver.
+	VkDeviceSize device_usage = 0;
+	// Bytes currently held by this allocator, including recycled blocks.
+	VkDeviceSize tracked_usage = 0;
 };
 
 class DeviceAllocator
@@ -334,6 +373,23 @@ public:
 	bool allocate_global(uint32_t size, uint32_t memory_type, DeviceAllocation *alloc);
 
 	void garbage_collect();
+
+	// Incremental, budgeted variant of garbage_collect() intended to be called
+	// once per frame context. Recycled blocks which have not been reused for a
+	// number of frame contexts are freed back to the system, a few blocks at a
+	// time, so long-running sessions with streaming churn do not hold on to
+	// large amounts of dead device memory. A copying defragmentation pass is
+	// not possible here since resource memory bindings are immutable in Vulkan
+	// and DeviceAllocation hands out raw offsets. Heaps which are close to
+	// their budget drop the retain window and reclaim far more aggressively.
+	void begin_frame_context();
+
+	// Fills one HeapBudget per memory heap (VkPhysicalDeviceMemoryProperties
+	// order, at most VK_MAX_MEMORY_HEAPS entries). Caches which scale with
+	// content (shadow maps, streamed textures) should size themselves against
+	// budget_size rather than hardcoded constants.
+	void get_memory_budget(HeapBudget *budget);
+
 	void *map_memory(const DeviceAllocation &alloc, MemoryAccessFlags flags, VkDeviceSize offset, VkDeviceSize length);
 	void unmap_memory(const DeviceAllocation &alloc, MemoryAccessFlags flags, VkDeviceSize offset, VkDeviceSize length);
 
@@ -358,6 +414,7 @@ private:
 		uint8_t *host_memory;
 		uint32_t size;
 		uint32_t type;
+		uint64_t last_use;
 	};
 
 	struct Heap
@@ -368,6 +425,7 @@ private:
 	};
 
 	std::vector<Heap> heaps;
+	uint64_t frame_context_counter = 0;
 };
 }
 
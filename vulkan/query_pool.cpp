@@ -411,6 +411,15 @@ void TimestampInterval::mark_end_of_frame_context()
 {
 	if (total_time > 0.0)
 		total_frame_iterations++;
+
+	if (time_this_iteration > 0.0)
+	{
+		if (min_time == 0.0 || time_this_iteration < min_time)
+			min_time = time_this_iteration;
+		if (time_this_iteration > max_time)
+			max_time = time_this_iteration;
+		time_this_iteration = 0.0;
+	}
 }
 
 uint64_t TimestampInterval::get_total_accumulations() const
@@ -431,9 +440,20 @@ double TimestampInterval::get_total_time() const
 void TimestampInterval::accumulate_time(double t)
 {
 	total_time += t;
+	time_this_iteration += t;
 	total_accumulations++;
 }
 
+double TimestampInterval::get_min_time_per_iteration() const
+{
+	return min_time;
+}
+
+double TimestampInterval::get_max_time_per_iteration() const
+{
+	return max_time;
+}
+
 double TimestampInterval::get_time_per_iteration() const
 {
 	if (total_frame_iterations)
@@ -473,9 +493,18 @@ void TimestampIntervalManager::log_simple()
 		if (timestamp.get_total_frame_iterations())
 		{
 			LOGI("  %.3f ms / frame context\n", 1000.0 * timestamp.get_time_per_iteration());
+			LOGI("  %.3f / %.3f ms min / max per frame context\n",
+			     1000.0 * timestamp.get_min_time_per_iteration(),
+			     1000.0 * timestamp.get_max_time_per_iteration());
 			LOGI("  %.3f iterations / frame context\n",
 			     double(timestamp.get_total_accumulations()) / double(timestamp.get_total_frame_iterations()));
 		}
 	}
 }
+
+void TimestampIntervalManager::enumerate_intervals(const std::function<void(const TimestampInterval &)> &func)
+{
+	for (auto &timestamp : timestamps)
+		func(timestamp);
+}
 }
\ No newline at end of file
@@ -25,6 +25,7 @@
 #include "vulkan_headers.hpp"
 #include "vulkan_common.hpp"
 #include "object_pool.hpp"
+#include <functional>
 
 namespace Vulkan
 {
@@ -143,9 +144,17 @@ public:
 	uint64_t get_total_frame_iterations() const;
 	uint64_t get_total_accumulations() const;
 
+	// Extremes over frame contexts where the tag was active.
+	// Suitable for budget checks which must catch spikes, not just averages.
+	double get_min_time_per_iteration() const;
+	double get_max_time_per_iteration() const;
+
 private:
 	std::string tag;
 	double total_time = 0.0;
+	double time_this_iteration = 0.0;
+	double min_time = 0.0;
+	double max_time = 0.0;
 	uint64_t total_frame_iterations = 0;
 	uint64_t total_accumulations = 0;
 };
@@ -158,6 +167,10 @@ public:
 
 	void log_simple();
 
+	// Invokes func for every registered interval.
+	// The intervals aggregate across all frames since startup.
+	void enumerate_intervals(const std::function<void(const TimestampInterval &)> &func);
+
 private:
 	Util::IntrusiveHashMap<TimestampInterval> timestamps;
 };
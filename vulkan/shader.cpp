@@ -24,10 +24,16 @@
 #include "device.hpp"
 #include "spirv_cross.hpp"
 
-#ifdef GRANITE_SPIRV_DUMP
+#if defined(GRANITE_SPIRV_DUMP) || defined(GRANITE_VULKAN_FILESYSTEM)
 #include "filesystem.hpp"
 #endif
 
+#ifdef GRANITE_VULKAN_FILESYSTEM
+#include "global_managers.hpp"
+#include "string_helpers.hpp"
+#include <string.h>
+#endif
+
 using namespace std;
 using namespace spirv_cross;
 using namespace Util;
@@ -328,6 +334,54 @@ void Shader::update_array_info(const SPIRType &type, unsigned set, unsigned bind
 	}
 }
 
+#ifdef GRANITE_VULKAN_FILESYSTEM
+// ResourceLayout is plain data, so the reflection cache is just the struct
+// prefixed with a version. Bump the version when ResourceLayout or
+// DescriptorSetLayout changes layout.
+static const uint32_t reflection_cache_version = 1;
+
+static string reflection_cache_path(Hash hash)
+{
+	return Util::join("cache://reflection/", to_string(hash), ".bin");
+}
+
+static bool load_reflection_cache(Hash hash, ResourceLayout &layout)
+{
+	auto file = Granite::Global::filesystem()->open(reflection_cache_path(hash), Granite::FileMode::ReadOnly);
+	if (!file)
+		return false;
+
+	if (file->get_size() != sizeof(reflection_cache_version) + sizeof(ResourceLayout))
+		return false;
+
+	auto *mapped = static_cast<const uint8_t *>(file->map());
+	if (!mapped)
+		return false;
+
+	uint32_t version;
+	memcpy(&version, mapped, sizeof(version));
+	if (version != reflection_cache_version)
+		return false;
+
+	memcpy(&layout, mapped + sizeof(version), sizeof(layout));
+	return true;
+}
+
+static void store_reflection_cache(Hash hash, const ResourceLayout &layout)
+{
+	auto file = Granite::Global::filesystem()->open(reflection_cache_path(hash), Granite::FileMode::WriteOnly);
+	if (!file)
+		return;
+
+	auto *mapped = static_cast<uint8_t *>(file->map_write(sizeof(reflection_cache_version) + sizeof(layout)));
+	if (!mapped)
+		return;
+
+	memcpy(mapped, &reflection_cache_version, sizeof(reflection_cache_version));
+	memcpy(mapped + sizeof(reflection_cache_version), &layout, sizeof(layout));
+}
+#endif
+
 Shader::Shader(Hash hash, Device *device_, const uint32_t *data, size_t size)
 	: IntrusiveHashMapEnabled<Shader>(hash)
 	, device(device_)
@@ -352,6 +406,13 @@ Shader::Shader(Hash hash, Device *device_, const uint32_t *data, size_t size)
 	device->register_shader_module(module, get_hash(), info);
 #endif
 
+#ifdef GRANITE_VULKAN_FILESYSTEM
+	// Reflection only depends on the SPIR-V and the hash covers the full
+	// binary, so warm starts can skip spirv-cross entirely.
+	if (load_reflection_cache(get_hash(), layout))
+		return;
+#endif
+
 	Compiler compiler(data, size / sizeof(uint32_t));
 
 	auto resources = compiler.get_shader_resources();
@@ -497,6 +558,10 @@ Shader::Shader(Hash hash, Device *device_, const uint32_t *data, size_t size)
 
 		layout.spec_constant_mask |= 1u << c.constant_id;
 	}
+
+#ifdef GRANITE_VULKAN_FILESYSTEM
+	store_reflection_cache(get_hash(), layout);
+#endif
 }
 
 Shader::~Shader()
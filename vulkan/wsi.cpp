@@ -22,6 +22,7 @@
 
 #include "wsi.hpp"
 #include "quirks.hpp"
+#include <chrono>
 #include <thread>
 
 using namespace std;
@@ -96,6 +97,11 @@ bool WSI::init_external_context(unique_ptr<Context> fresh_context)
 	// Need to have a dummy swapchain in place before we issue create device events.
 	device.reset(new Device);
 	device->set_context(*context);
+	// Async present may have been enabled before the device existed; the new
+	// device must take the present thread's queue lock from the start, or the
+	// off-thread present could overlap queue submission.
+	if (present_thread.active)
+		register_present_queue_lock();
 	device->init_external_swapchain({ ImageHandle(nullptr) });
 	platform->event_device_created(device.get());
 	table = &context->get_device_table();
@@ -146,6 +152,8 @@ bool WSI::init(unsigned num_thread_indices)
 
 	device.reset(new Device);
 	device->set_context(*context);
+	if (present_thread.active)
+		register_present_queue_lock();
 	table = &context->get_device_table();
 
 	platform->event_device_created(device.get());
@@ -187,6 +195,9 @@ void WSI::init_surface_and_swapchain(VkSurfaceKHR new_surface)
 
 void WSI::drain_swapchain()
 {
+	// Any in-flight async present must retire before the swapchain can be
+	// drained or torn down. Its result no longer matters at this point.
+	sync_async_present();
 	release_semaphores.clear();
 	device->set_acquire_semaphore(0, Semaphore{});
 	device->consume_release_semaphore();
@@ -265,6 +276,8 @@ bool WSI::begin_frame()
 	if (frame_is_external)
 		return begin_frame_external();
 
+	pace_frame_start();
+
 #ifdef VULKAN_WSI_TIMING_DEBUG
 	auto next_frame_start = Util::get_current_time_nsecs();
 #endif
@@ -293,6 +306,29 @@ bool WSI::begin_frame()
 
 	external_release.reset();
 
+	// The previous frame's async present retires here, just before we need
+	// externally synchronized access to the swapchain again. Errors are
+	// handled exactly like a failed acquire below.
+	VkResult async_result = sync_async_present();
+#ifdef ANDROID
+	if (async_result == VK_SUBOPTIMAL_KHR)
+		async_result = VK_SUCCESS;
+#endif
+	if (async_result == VK_SUBOPTIMAL_KHR || async_result == VK_ERROR_OUT_OF_DATE_KHR ||
+	    async_result == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
+	{
+		tear_down_swapchain();
+		if (!blocking_init_swapchain(swapchain_width, swapchain_height))
+			return false;
+		device->init_swapchain(swapchain_images, swapchain_width, swapchain_height, swapchain_format);
+	}
+	else if (async_result != VK_SUCCESS)
+	{
+		LOGE("Async vkQueuePresentKHR failed.\n");
+		tear_down_swapchain();
+		return false;
+	}
+
 	VkResult result;
 	do
 	{
@@ -303,13 +339,15 @@ bool WSI::begin_frame()
 		// which means we will never get sub-frame latency on some implementations,
 		// so block on that first.
 		Fence fence;
-		if (timing.get_options().latency_limiter == LatencyLimiter::AdaptiveLowLatency)
+		if (timing.get_options().latency_limiter == LatencyLimiter::AdaptiveLowLatency || pacing_active())
 			fence = device->request_legacy_fence();
 
 #ifdef VULKAN_WSI_TIMING_DEBUG
 		auto acquire_start = Util::get_current_time_nsecs();
 #endif
 
+		int64_t pace_acquire_begin = pacing_active() ? Util::get_current_time_nsecs() : 0;
+
 		auto acquire_ts = device->write_calibrated_timestamp();
 		result = table->vkAcquireNextImageKHR(context->get_device(), swapchain, UINT64_MAX, acquire->get_semaphore(),
 		                                      fence ? fence->get_fence() : VK_NULL_HANDLE, &swapchain_index);
@@ -325,6 +363,9 @@ bool WSI::begin_frame()
 		if (result == VK_SUCCESS && fence)
 			fence->wait();
 
+		if (result == VK_SUCCESS && pace_acquire_begin)
+			update_frame_pacing(Util::get_current_time_nsecs() - pace_acquire_begin);
+
 		if (result == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
 		{
 			LOGE("Lost exclusive full-screen ...\n");
@@ -392,6 +433,17 @@ bool WSI::begin_frame()
 	return true;
 }
 
+// Errors which indicate the device rather than one particular swapchain,
+// and thus remain fatal even when a batched present reports them for an
+// auxiliary entry. Surface or swapchain level errors (OUT_OF_DATE,
+// SURFACE_LOST) are attributed through the per-swapchain results instead.
+static bool present_result_is_device_error(VkResult result)
+{
+	return result == VK_ERROR_OUT_OF_HOST_MEMORY ||
+	       result == VK_ERROR_OUT_OF_DEVICE_MEMORY ||
+	       result == VK_ERROR_DEVICE_LOST;
+}
+
 bool WSI::end_frame()
 {
 	device->end_frame_context();
@@ -407,76 +459,174 @@ bool WSI::end_frame()
 	}
 	else
 	{
-		if (!device->swapchain_touched())
+		if (!device->swapchain_touched() && auxiliary_presents.empty())
 			return true;
 
-		has_acquired_swapchain_index = false;
+		bool present_main = device->swapchain_touched();
+		Semaphore release;
+		VkSemaphore release_semaphore = VK_NULL_HANDLE;
 
-		auto release = device->consume_release_semaphore();
-		VK_ASSERT(release);
-		VK_ASSERT(release->is_signalled());
-		auto release_semaphore = release->get_semaphore();
-		VK_ASSERT(release_semaphore != VK_NULL_HANDLE);
+		if (present_main)
+		{
+			has_acquired_swapchain_index = false;
 
-		VkResult result = VK_SUCCESS;
-		VkPresentInfoKHR info = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
-		info.waitSemaphoreCount = 1;
-		info.pWaitSemaphores = &release_semaphore;
-		info.swapchainCount = 1;
-		info.pSwapchains = &swapchain;
-		info.pImageIndices = &swapchain_index;
-		info.pResults = &result;
-
-		VkPresentTimeGOOGLE present_time;
-		VkPresentTimesInfoGOOGLE present_timing = { VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE };
-		present_timing.swapchainCount = 1;
-		present_timing.pTimes = &present_time;
+			release = device->consume_release_semaphore();
+			VK_ASSERT(release);
+			VK_ASSERT(release->is_signalled());
+			release_semaphore = release->get_semaphore();
+			VK_ASSERT(release_semaphore != VK_NULL_HANDLE);
+		}
 
-		if (using_display_timing && timing.fill_present_info_timing(present_time))
+		if (present_thread.active)
 		{
-			info.pNext = &present_timing;
+			// Hand the composed frame off to the present thread and return so
+			// the next frame starts immediately. The result retires in the
+			// next begin_frame().
+			PresentRequest req;
+			req.present_main = present_main;
+			if (present_main)
+			{
+				req.wait_semaphores.push_back(release_semaphore);
+				req.swapchains.push_back(swapchain);
+				req.image_indices.push_back(swapchain_index);
+				req.out_results.push_back(nullptr);
+			}
+
+			auxiliary_retired.clear();
+			for (auto &aux : auxiliary_presents)
+			{
+				VK_ASSERT(aux.release && aux.release->is_signalled());
+				req.wait_semaphores.push_back(aux.release->get_semaphore());
+				req.swapchains.push_back(aux.swapchain);
+				req.image_indices.push_back(aux.index);
+				req.out_results.push_back(aux.out_result);
+				req.keep_alive.push_back(aux.release);
+				aux.release->wait_external();
+				auxiliary_retired.push_back(std::move(aux.release));
+			}
+			auxiliary_presents.clear();
+
+			// pTimes must match swapchainCount, so display timing only applies
+			// to the plain single-swapchain path.
+			if (using_display_timing && req.swapchains.size() == 1 && present_main)
+				req.has_present_time = timing.fill_present_info_timing(req.present_time);
+
+			if (present_main)
+			{
+				release->wait_external();
+				// Cannot release the WSI wait semaphore until we observe that
+				// the image has been waited on again.
+				release_semaphores[swapchain_index] = release;
+				req.keep_alive.push_back(std::move(release));
+			}
+
+			push_async_present(std::move(req));
 		}
+		else
+		{
+			// Fold any queued auxiliary swapchains into the same present batch.
+			Util::SmallVector<VkSemaphore> wait_semaphores;
+			Util::SmallVector<VkSwapchainKHR> swapchains;
+			Util::SmallVector<uint32_t> image_indices;
+			if (present_main)
+			{
+				wait_semaphores.push_back(release_semaphore);
+				swapchains.push_back(swapchain);
+				image_indices.push_back(swapchain_index);
+			}
+			for (auto &aux : auxiliary_presents)
+			{
+				VK_ASSERT(aux.release && aux.release->is_signalled());
+				wait_semaphores.push_back(aux.release->get_semaphore());
+				swapchains.push_back(aux.swapchain);
+				image_indices.push_back(aux.index);
+			}
+			Util::SmallVector<VkResult> results(swapchains.size());
+
+			VkPresentInfoKHR info = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+			info.waitSemaphoreCount = uint32_t(wait_semaphores.size());
+			info.pWaitSemaphores = wait_semaphores.data();
+			info.swapchainCount = uint32_t(swapchains.size());
+			info.pSwapchains = swapchains.data();
+			info.pImageIndices = image_indices.data();
+			info.pResults = results.data();
+
+			VkPresentTimeGOOGLE present_time;
+			VkPresentTimesInfoGOOGLE present_timing = { VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE };
+			present_timing.swapchainCount = 1;
+			present_timing.pTimes = &present_time;
+
+			// pTimes must match swapchainCount, so display timing only applies to
+			// the plain single-swapchain path.
+			if (using_display_timing && swapchains.size() == 1 && present_main &&
+			    timing.fill_present_info_timing(present_time))
+			{
+				info.pNext = &present_timing;
+			}
 
 #ifdef VULKAN_WSI_TIMING_DEBUG
-		auto present_start = Util::get_current_time_nsecs();
+			auto present_start = Util::get_current_time_nsecs();
 #endif
 
-		auto present_ts = device->write_calibrated_timestamp();
-		VkResult overall = table->vkQueuePresentKHR(context->get_graphics_queue(), &info);
-		device->register_time_interval("WSI", std::move(present_ts), device->write_calibrated_timestamp(), "present");
+			auto present_ts = device->write_calibrated_timestamp();
+			VkResult overall = table->vkQueuePresentKHR(context->get_graphics_queue(), &info);
+			device->register_time_interval("WSI", std::move(present_ts), device->write_calibrated_timestamp(), "present");
+
+			VkResult result = present_main ? results.front() : VK_SUCCESS;
+			// The batched result is the worst result across all swapchains, so a
+			// routine failure on an auxiliary entry (e.g. OUT_OF_DATE from a resized
+			// window) leaks into it. Only device-level errors remain fatal from it;
+			// otherwise the main swapchain is judged by its own result below.
+			if (present_result_is_device_error(overall))
+				result = overall;
+
+			// Report per-swapchain results to the auxiliary owners and retire their
+			// semaphores. Auxiliary failures are the owner's problem to handle;
+			// they must not tear down the main swapchain.
+			auxiliary_retired.clear();
+			for (size_t i = 0; i < auxiliary_presents.size(); i++)
+			{
+				auto &aux = auxiliary_presents[i];
+				if (aux.out_result)
+					*aux.out_result = results[i + (present_main ? 1 : 0)];
+				aux.release->wait_external();
+				auxiliary_retired.push_back(std::move(aux.release));
+			}
+			auxiliary_presents.clear();
 
 #ifdef ANDROID
-		// Android 10 can return suboptimal here, only because of pre-transform.
-		// We don't care about that, and treat this as success.
-		if (overall == VK_SUBOPTIMAL_KHR)
-			overall = VK_SUCCESS;
-		if (result == VK_SUBOPTIMAL_KHR)
-			result = VK_SUCCESS;
+			// Android 10 can return suboptimal here, only because of pre-transform.
+			// We don't care about that, and treat this as success.
+			if (overall == VK_SUBOPTIMAL_KHR)
+				overall = VK_SUCCESS;
+			if (result == VK_SUBOPTIMAL_KHR)
+				result = VK_SUCCESS;
 #endif
 
-		if (overall == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT ||
-		    result == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
-		{
-			LOGE("Lost exclusive full-screen ...\n");
-		}
+			if (overall == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT ||
+			    result == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
+			{
+				LOGE("Lost exclusive full-screen ...\n");
+			}
 
 #ifdef VULKAN_WSI_TIMING_DEBUG
-		auto present_end = Util::get_current_time_nsecs();
-		LOGI("vkQueuePresentKHR took %.3f ms.\n", (present_end - present_start) * 1e-6);
+			auto present_end = Util::get_current_time_nsecs();
+			LOGI("vkQueuePresentKHR took %.3f ms.\n", (present_end - present_start) * 1e-6);
 #endif
 
-		if (overall != VK_SUCCESS || result != VK_SUCCESS)
-		{
-			LOGE("vkQueuePresentKHR failed.\n");
-			tear_down_swapchain();
-			return false;
-		}
-		else
-		{
-			release->wait_external();
-			// Cannot release the WSI wait semaphore until we observe that the image has been
-			// waited on again.
-			release_semaphores[swapchain_index] = release;
+			if (result != VK_SUCCESS)
+			{
+				LOGE("vkQueuePresentKHR failed.\n");
+				tear_down_swapchain();
+				return false;
+			}
+			else if (present_main)
+			{
+				release->wait_external();
+				// Cannot release the WSI wait semaphore until we observe that the image has been
+				// waited on again.
+				release_semaphores[swapchain_index] = release;
+			}
 		}
 
 		// Re-init swapchain.
@@ -491,6 +641,147 @@ bool WSI::end_frame()
 	return true;
 }
 
+void WSI::set_async_present(bool enable)
+{
+	if (enable == present_thread.active)
+		return;
+
+	if (enable)
+	{
+		present_thread.dead = false;
+		present_thread.has_request = false;
+		present_thread.has_result = false;
+		present_thread.busy = false;
+		present_thread.active = true;
+		if (device)
+			register_present_queue_lock();
+		present_thread.thread = std::thread(&WSI::present_thread_loop, this);
+	}
+	else
+	{
+		sync_async_present();
+		{
+			lock_guard<mutex> holder{present_thread.lock};
+			present_thread.dead = true;
+		}
+		present_thread.cond.notify_all();
+		present_thread.thread.join();
+		present_thread.active = false;
+		if (device)
+			device->set_queue_lock({}, {});
+	}
+}
+
+void WSI::register_present_queue_lock()
+{
+	device->set_queue_lock([this]() { present_thread.queue_lock.lock(); },
+	                       [this]() { present_thread.queue_lock.unlock(); });
+}
+
+void WSI::push_async_present(PresentRequest req)
+{
+	{
+		lock_guard<mutex> holder{present_thread.lock};
+		VK_ASSERT(!present_thread.has_request && !present_thread.busy);
+		present_thread.request = move(req);
+		present_thread.has_request = true;
+		present_thread.busy = true;
+	}
+	present_thread.cond.notify_all();
+}
+
+VkResult WSI::sync_async_present()
+{
+	if (!present_thread.active)
+		return VK_SUCCESS;
+
+	unique_lock<mutex> holder{present_thread.lock};
+	present_thread.cond.wait(holder, [this]() {
+		return !present_thread.has_request && !present_thread.busy;
+	});
+
+	VkResult result = VK_SUCCESS;
+	if (present_thread.has_result)
+	{
+		result = present_thread.result;
+		present_thread.has_result = false;
+	}
+	return result;
+}
+
+void WSI::present_thread_loop()
+{
+	for (;;)
+	{
+		PresentRequest req;
+		{
+			unique_lock<mutex> holder{present_thread.lock};
+			present_thread.cond.wait(holder, [this]() {
+				return present_thread.has_request || present_thread.dead;
+			});
+			if (!present_thread.has_request)
+				return;
+			req = move(present_thread.request);
+			present_thread.has_request = false;
+		}
+
+		Util::SmallVector<VkResult> results(req.swapchains.size());
+
+		VkPresentInfoKHR info = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+		info.waitSemaphoreCount = uint32_t(req.wait_semaphores.size());
+		info.pWaitSemaphores = req.wait_semaphores.data();
+		info.swapchainCount = uint32_t(req.swapchains.size());
+		info.pSwapchains = req.swapchains.data();
+		info.pImageIndices = req.image_indices.data();
+		info.pResults = results.data();
+
+		VkPresentTimesInfoGOOGLE present_timing = { VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE };
+		present_timing.swapchainCount = 1;
+		present_timing.pTimes = &req.present_time;
+		if (req.has_present_time)
+			info.pNext = &present_timing;
+
+		VkResult overall;
+		{
+			// This is the Device queue lock while the present thread runs, so
+			// the present cannot overlap a queue submission on other threads.
+			lock_guard<mutex> holder{present_thread.queue_lock};
+			overall = table->vkQueuePresentKHR(context->get_graphics_queue(), &info);
+		}
+
+		for (size_t i = 0; i < req.out_results.size(); i++)
+			if (req.out_results[i])
+				*req.out_results[i] = results[i];
+
+		// Auxiliary failures are the owner's problem; only the main swapchain
+		// result and genuinely device-level errors feed back into the render
+		// thread, since the batched overall result is the worst across all
+		// swapchains in the request.
+		VkResult result = req.present_main ? results.front() : VK_SUCCESS;
+		if (present_result_is_device_error(overall))
+			result = overall;
+
+		// Semaphores can be released now that the presentation engine has
+		// taken its waits.
+		req.keep_alive.clear();
+
+		{
+			lock_guard<mutex> holder{present_thread.lock};
+			present_thread.result = result;
+			present_thread.has_result = true;
+			present_thread.busy = false;
+		}
+		present_thread.cond.notify_all();
+	}
+}
+
+void WSI::queue_auxiliary_present(VkSwapchainKHR aux_swapchain, uint32_t image_index,
+                                  Semaphore release_semaphore, VkResult *out_result)
+{
+	VK_ASSERT(aux_swapchain != VK_NULL_HANDLE);
+	auxiliary_presents.push_back({ aux_swapchain, image_index, std::move(release_semaphore), out_result });
+}
+
 void WSI::update_framebuffer(unsigned width, unsigned height)
 {
 	if (context && device)
@@ -523,6 +814,8 @@ void WSI::set_backbuffer_srgb(bool enable)
 
 void WSI::deinit_external()
 {
+	set_async_present(false);
+
 	if (platform)
 		platform->release_resources();
 
@@ -968,6 +1261,45 @@ WSI::SwapchainError WSI::init_swapchain(unsigned width, unsigned height)
 	return SwapchainError::None;
 }
 
+void WSI::set_low_latency_mode(bool enable)
+{
+	pacer.enable = enable;
+	pacer.sleep_ns = 0.0;
+}
+
+bool WSI::pacing_active() const
+{
+	// The display timing path has its own latency limiters with real present
+	// feedback, let it win when it is running.
+	return pacer.enable && !using_display_timing && current_present_mode == PresentMode::SyncToVBlank;
+}
+
+void WSI::pace_frame_start()
+{
+	if (!pacing_active() || pacer.sleep_ns < 1e5)
+		return;
+	std::this_thread::sleep_for(std::chrono::nanoseconds(int64_t(pacer.sleep_ns)));
+}
+
+void WSI::update_frame_pacing(int64_t acquire_block_ns)
+{
+	// The time spent blocked on acquire (fenced, so it observes the real
+	// backbuffer handover) is exactly how early the CPU started this frame.
+	// Move most of it into the pre-frame sleep so input is sampled that much
+	// later, keeping a margin so we never start too late and miss vblank.
+	// Ramp up slowly and back off fast when the margin is eaten into.
+	const double margin_ns = 1e6;
+	double error = double(acquire_block_ns) - margin_ns;
+	pacer.sleep_ns += (error > 0.0 ? 0.1 : 0.5) * error;
+
+	double refresh = get_estimated_refresh_interval();
+	double max_sleep_ns = refresh > 0.0 ? refresh * 1e9 : 50e6;
+	if (pacer.sleep_ns < 0.0)
+		pacer.sleep_ns = 0.0;
+	else if (pacer.sleep_ns > max_sleep_ns)
+		pacer.sleep_ns = max_sleep_ns;
+}
+
 double WSI::get_estimated_refresh_interval() const
 {
 	uint64_t interval = timing.get_refresh_interval();
@@ -27,7 +27,10 @@
 #include "vulkan_headers.hpp"
 #include "timer.hpp"
 #include "wsi_timing.hpp"
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace Vulkan
@@ -155,6 +158,15 @@ public:
 
 	bool begin_frame();
 	bool end_frame();
+
+	// Auxiliary swapchains for multi-viewport deployments (editor windows).
+	// The application acquires and renders the extra swapchains itself and
+	// queues them here each frame; end_frame() folds them into the same
+	// vkQueuePresentKHR as the main swapchain so all viewports present in one
+	// batch instead of one queue submission per window. The per-swapchain
+	// VkResult is written to out_result when non-null.
+	void queue_auxiliary_present(VkSwapchainKHR aux_swapchain, uint32_t image_index,
+	                             Semaphore release_semaphore, VkResult *out_result = nullptr);
 	void set_external_frame(unsigned index, Vulkan::Semaphore acquire_semaphore, double frame_time);
 	Vulkan::Semaphore consume_external_release_semaphore();
 
@@ -175,6 +187,24 @@ public:
 
 	double get_estimated_refresh_interval() const;
 
+	// Moves vkQueuePresentKHR to a dedicated present thread. end_frame() hands
+	// the composed frame off and returns immediately, so the render thread
+	// starts recording the next frame while the driver presents; some mobile
+	// drivers block for several ms in present. begin_frame() syncs with the
+	// previous hand-off before acquiring, so present errors are observed one
+	// frame late and handled like a failed acquire. While active, WSI owns the
+	// Device queue lock to order the off-thread present against concurrent
+	// queue submissions. Auxiliary present results are written by the present
+	// thread and must only be read after the next begin_frame(). Call after
+	// init().
+	void set_async_present(bool enable);
+
+	// Cross-platform low-latency frame pacing. Delays the CPU frame start so
+	// input is sampled as late as possible while the present queue stays
+	// drained, based on how long the acquire blocked last frame.
+	// The GOOGLE_display_timing latency limiters take precedence when active.
+	void set_low_latency_mode(bool enable);
+
 	WSITiming &get_timing()
 	{
 		return timing;
@@ -212,6 +242,18 @@ private:
 	uint32_t swapchain_index = 0;
 	bool has_acquired_swapchain_index = false;
 
+	struct AuxiliaryPresent
+	{
+		VkSwapchainKHR swapchain;
+		uint32_t index;
+		Semaphore release;
+		VkResult *out_result;
+	};
+	std::vector<AuxiliaryPresent> auxiliary_presents;
+	// Keeps last frame's auxiliary release semaphores alive until the
+	// presentation engine has had a chance to wait on them.
+	std::vector<Semaphore> auxiliary_retired;
+
 	WSIPlatform *platform = nullptr;
 
 	std::vector<Vulkan::ImageHandle> external_swapchain_images;
@@ -234,6 +276,54 @@ private:
 
 	WSITiming timing;
 
+	struct PresentRequest
+	{
+		std::vector<VkSemaphore> wait_semaphores;
+		std::vector<VkSwapchainKHR> swapchains;
+		std::vector<uint32_t> image_indices;
+		std::vector<VkResult *> out_results;
+		// Keeps the release semaphores alive until the presentation engine has
+		// taken its wait on them.
+		std::vector<Semaphore> keep_alive;
+		VkPresentTimeGOOGLE present_time = {};
+		bool has_present_time = false;
+		bool present_main = false;
+	};
+
+	struct PresentThread
+	{
+		std::thread thread;
+		std::mutex lock;
+		std::condition_variable cond;
+		// Registered as the Device queue lock while the thread runs, so the
+		// off-thread vkQueuePresentKHR cannot overlap a queue submission.
+		std::mutex queue_lock;
+		PresentRequest request;
+		bool active = false;
+		bool has_request = false;
+		bool busy = false;
+		bool has_result = false;
+		bool dead = false;
+		VkResult result = VK_SUCCESS;
+	} present_thread;
+	void present_thread_loop();
+	void push_async_present(PresentRequest req);
+	// Hooks the Device queue lock up to the present thread. Must be called
+	// whenever a Device is (re)created while async present is active.
+	void register_present_queue_lock();
+	// Blocks until the in-flight async present (if any) has retired and
+	// returns its result. A no-op when the present thread is not running.
+	VkResult sync_async_present();
+
+	struct FramePacer
+	{
+		bool enable = false;
+		double sleep_ns = 0.0;
+	} pacer;
+	bool pacing_active() const;
+	void pace_frame_start();
+	void update_frame_pacing(int64_t acquire_block_ns);
+
 	void tear_down_swapchain();
 	void drain_swapchain();
 };